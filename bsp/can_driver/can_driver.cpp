@@ -22,106 +22,2933 @@
  */
 #include "can_driver.hpp"
 
+// FDCAN 后端的实现见 fdcan_driver.cpp
+#if !defined(HAL_FDCAN_MODULE_ENABLED)
+
+#include "MpscQueue.hpp"
 #include "RingBuffer.hpp"
+#include "can_log.hpp"
 #include "isr_lock.h"
 
-#include <cassert>
-#include <cstring>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+
+static_assert(CAN_MAX_ID_CALLBACK_NUM < 0xFF, "CAN_MAX_ID_CALLBACK_NUM must fit in uint8_t");
+static_assert(CAN_EXT_ID_TABLE_SIZE >= 2 && (CAN_EXT_ID_TABLE_SIZE & (CAN_EXT_ID_TABLE_SIZE - 1)) == 0,
+              "CAN_EXT_ID_TABLE_SIZE must be a power of 2");
+
+constexpr uint32_t CAN_STD_ID_NUM  = 0x800;
+constexpr uint32_t CAN_STD_ID_MASK = 0x7FF;
+constexpr uint32_t CAN_EXT_ID_MASK = 0x1FFFFFFF;
+
+#if CAN_TX_LOCK_PRIORITY > 0
+#    if defined(__CORTEX_M) && (__CORTEX_M < 3U)
+#        error "CAN_TX_LOCK_PRIORITY requires BASEPRI, which is not available on Cortex-M0/M0+"
+#    endif
+static_assert(CAN_TX_LOCK_PRIORITY < (1U << __NVIC_PRIO_BITS), "CAN_TX_LOCK_PRIORITY exceeds NVIC priority bits");
+#endif
+
+static_assert(CAN_TX_QUEUE_SIZE >= 1 && CAN_TX_QUEUE_SIZE < 0xFF, "CAN_TX_QUEUE_SIZE must fit in uint8_t");
+static_assert(CAN_TX_STATUS_HISTORY_SIZE >= 1 && (CAN_TX_STATUS_HISTORY_SIZE & (CAN_TX_STATUS_HISTORY_SIZE - 1)) == 0,
+              "CAN_TX_STATUS_HISTORY_SIZE must be a power of 2");
+
+/*
+ * 硬件访问层
+ *
+ * CAN_FAST_PATH 为 1 时直接读写邮箱寄存器，省去 HAL 的状态检查、参数断言和逐字段转换。
+ * 寄存器只经由 hcan->Instance 访问，把 Instance 指向一块模拟的 CAN_TypeDef 即可在主机上测试
+ */
+
+/**
+ * 获取空闲发送邮箱数量
+ */
+uint32_t hw_tx_free_level(CAN_HandleTypeDef* hcan)
+{
+#if CAN_FAST_PATH
+    const uint32_t tsr = hcan->Instance->TSR;
+    return ((tsr & CAN_TSR_TME0) ? 1U : 0U) + ((tsr & CAN_TSR_TME1) ? 1U : 0U) + ((tsr & CAN_TSR_TME2) ? 1U : 0U);
+#else
+    return HAL_CAN_GetTxMailboxesFreeLevel(hcan);
+#endif
+}
+
+/**
+ * 把一帧写入空闲发送邮箱并请求发送
+ * @param mailbox 输出所用邮箱（CAN_TX_MAILBOXx）
+ * @return 成功返回 true，没有空闲邮箱时返回 false
+ */
+bool hw_add_tx(CAN_HandleTypeDef* hcan, const CAN_TxHeaderTypeDef* header, const uint8_t data[8], uint32_t* mailbox)
+{
+#if CAN_FAST_PATH
+    CAN_TypeDef*   can = hcan->Instance;
+    const uint32_t tsr = can->TSR;
+    if ((tsr & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)) == 0)
+        return false;
+
+    // CODE 字段给出下一个空闲邮箱
+    const uint32_t index = (tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    *mailbox             = 1U << index;
+
+    CAN_TxMailBox_TypeDef* box = &can->sTxMailBox[index];
+    const uint32_t         tir = header->IDE == CAN_ID_STD
+                                     ? (header->StdId << CAN_TI0R_STID_Pos) | header->RTR
+                                     : (header->ExtId << CAN_TI0R_EXID_Pos) | header->IDE | header->RTR;
+    box->TDTR = header->DLC;
+    box->TDLR = static_cast<uint32_t>(data[3]) << 24 | static_cast<uint32_t>(data[2]) << 16 |
+                static_cast<uint32_t>(data[1]) << 8 | data[0];
+    box->TDHR = static_cast<uint32_t>(data[7]) << 24 | static_cast<uint32_t>(data[6]) << 16 |
+                static_cast<uint32_t>(data[5]) << 8 | data[4];
+    // 最后写入 TIR 并置位 TXRQ，邮箱内容此时已完整
+    box->TIR = tir | CAN_TI0R_TXRQ;
+    return true;
+#else
+    return HAL_CAN_AddTxMessage(hcan, header, data, mailbox) == HAL_OK;
+#endif
+}
+
+/**
+ * 中止所有邮箱中的待发送帧，中止完成后由 HAL 调用各邮箱的中止回调
+ */
+void hw_abort_tx(CAN_HandleTypeDef* hcan)
+{
+#if CAN_FAST_PATH
+    hcan->Instance->TSR = CAN_TSR_ABRQ0 | CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2;
+#else
+    (void) HAL_CAN_AbortTxRequest(hcan, CAN_TX_MAILBOX0 | CAN_TX_MAILBOX1 | CAN_TX_MAILBOX2);
+#endif
+}
+
+/**
+ * 中止一个邮箱的发送请求，调用前需处于临界区内
+ *
+ * 直接写 TSR：HAL_CAN_AbortTxRequest 以读-改-写置位 ABRQ，会把其他邮箱尚未处理的 RQCP 一并清除
+ * @return 帧尚未开始发送、已被中止时返回 true，此时已清除该邮箱的 RQCP，不会再进入中止回调；
+ *         正在发送或已经发完时返回 false，结果仍由发送完成 / 中止回调给出
+ */
+bool hw_abort_mailbox(CAN_HandleTypeDef* hcan, const size_t index)
+{
+    const uint32_t shift = 8 * index;
+    hcan->Instance->TSR  = CAN_TSR_ABRQ0 << shift;
+
+    const uint32_t tsr = hcan->Instance->TSR;
+    if ((tsr & (CAN_TSR_TME0 << index)) == 0 || (tsr & (CAN_TSR_TXOK0 << shift)) != 0)
+        return false;
+    hcan->Instance->TSR = CAN_TSR_RQCP0 << shift;
+    return true;
+}
+
+/**
+ * 获取接收 FIFO 中的帧数
+ */
+uint32_t hw_rx_fill_level(CAN_HandleTypeDef* hcan, const uint32_t fifo)
+{
+#if CAN_FAST_PATH
+    return fifo == CAN_RX_FIFO0 ? (hcan->Instance->RF0R & CAN_RF0R_FMP0) : (hcan->Instance->RF1R & CAN_RF1R_FMP1);
+#else
+    return HAL_CAN_GetRxFifoFillLevel(hcan, fifo);
+#endif
+}
+
+/**
+ * 从接收 FIFO 读出一帧并释放该 FIFO 输出邮箱
+ *
+ * 调用前需确认 FIFO 非空
+ * @return 成功返回 true
+ */
+bool hw_get_rx(CAN_HandleTypeDef* hcan, const uint32_t fifo, CAN_RxHeaderTypeDef* header, uint8_t data[8])
+{
+#if CAN_FAST_PATH
+    CAN_TypeDef*                   can = hcan->Instance;
+    const CAN_FIFOMailBox_TypeDef* box = &can->sFIFOMailBox[fifo];
+
+    const uint32_t rir  = box->RIR;
+    const uint32_t rdtr = box->RDTR;
+    header->IDE         = rir & CAN_RI0R_IDE;
+    header->RTR         = rir & CAN_RI0R_RTR;
+    if (header->IDE == CAN_ID_STD)
+        header->StdId = (rir & CAN_RI0R_STID) >> CAN_RI0R_STID_Pos;
+    else
+        header->ExtId = (rir & (CAN_RI0R_EXID | CAN_RI0R_STID)) >> CAN_RI0R_EXID_Pos;
+    header->DLC              = (rdtr & CAN_RDT0R_DLC) >> CAN_RDT0R_DLC_Pos;
+    header->FilterMatchIndex = (rdtr & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos;
+    header->Timestamp        = (rdtr & CAN_RDT0R_TIME) >> CAN_RDT0R_TIME_Pos;
+
+    // 总是取满 8 字节，省去按 DLC 分支
+    const uint32_t low  = box->RDLR;
+    const uint32_t high = box->RDHR;
+    data[0]             = static_cast<uint8_t>(low);
+    data[1]             = static_cast<uint8_t>(low >> 8);
+    data[2]             = static_cast<uint8_t>(low >> 16);
+    data[3]             = static_cast<uint8_t>(low >> 24);
+    data[4]             = static_cast<uint8_t>(high);
+    data[5]             = static_cast<uint8_t>(high >> 8);
+    data[6]             = static_cast<uint8_t>(high >> 16);
+    data[7]             = static_cast<uint8_t>(high >> 24);
+
+    // 直接写 RFOM 而非读-改-写，避免误清 FULL / FOVR 标志
+    if (fifo == CAN_RX_FIFO0)
+        can->RF0R = CAN_RF0R_RFOM0;
+    else
+        can->RF1R = CAN_RF1R_RFOM1;
+    return true;
+#else
+    return HAL_CAN_GetRxMessage(hcan, fifo, header, data) == HAL_OK;
+#endif
+}
+
+#if CAN_ENABLE_RECORDER || CAN_ENABLE_BUS_LOAD
+/**
+ * 读回发送邮箱中的帧：发送结束后邮箱寄存器仍保留该帧，HAL 没有对应接口，两种路径都直接读寄存器
+ * @param index 邮箱下标
+ */
+void hw_get_tx(const CAN_HandleTypeDef* hcan, const size_t index, CAN_TxHeaderTypeDef* header, uint8_t data[8])
+{
+    const CAN_TxMailBox_TypeDef* box = &hcan->Instance->sTxMailBox[index];
+
+    const uint32_t tir = box->TIR;
+    header->IDE        = tir & CAN_TI0R_IDE;
+    header->RTR        = tir & CAN_TI0R_RTR;
+    if (header->IDE == CAN_ID_STD)
+        header->StdId = (tir & CAN_TI0R_STID) >> CAN_TI0R_STID_Pos;
+    else
+        header->ExtId = (tir & (CAN_TI0R_EXID | CAN_TI0R_STID)) >> CAN_TI0R_EXID_Pos;
+    header->DLC = (box->TDTR & CAN_TDT0R_DLC) >> CAN_TDT0R_DLC_Pos;
+
+    const uint32_t low  = box->TDLR;
+    const uint32_t high = box->TDHR;
+    for (size_t i = 0; i < 4; i++)
+    {
+        data[i]     = static_cast<uint8_t>(low >> (8 * i));
+        data[i + 4] = static_cast<uint8_t>(high >> (8 * i));
+    }
+}
+#endif
+
+/**
+ * 计算 CAN 帧的仲裁优先级，数值越小越优先
+ *
+ * 与总线仲裁顺序一致：先比较 11 位基本 ID；基本 ID 相同时标准帧优先于扩展帧；
+ * 再比较扩展帧低 18 位；最后数据帧优先于远程帧
+ */
+uint32_t arbitration_key(const CAN_TxHeaderTypeDef* header)
+{
+    const uint32_t rtr = header->RTR == CAN_RTR_REMOTE ? 1U : 0U;
+    if (header->IDE == CAN_ID_STD)
+        return (header->StdId & CAN_STD_ID_MASK) << 20 | rtr;
+    const uint32_t ext_id = header->ExtId & CAN_EXT_ID_MASK;
+    return (ext_id >> 18) << 20 | 1U << 19 | (ext_id & 0x3FFFF) << 1 | rtr;
+}
+
+/**
+ * 按仲裁优先级排序的有界发送队列
+ *
+ * 以小根堆实现，堆中只保存槽位下标，入队 / 出队时不搬移报文本身。
+ * 相同 ID 的帧按入队顺序发送
+ */
+class CAN_TxQueue
+{
+public:
+    CAN_TxQueue()
+    {
+        for (size_t i = 0; i < CAN_TX_QUEUE_SIZE; i++)
+            free_[i] = static_cast<uint8_t>(i);
+    }
+
+    /**
+     * 入队一帧
+     * @param policy 队列已满时的处理策略
+     * @param ticket 该帧的发送票据
+     * @param latest 是否允许被 replace_latest 覆盖
+     * @param evicted 返回 Evicted 时写入被丢弃帧的票据
+     */
+    enum class PushResult : uint8_t
+    {
+        Queued,  ///< 入队成功
+        Evicted, ///< 入队成功，但丢弃了一帧优先级更低的帧
+        Rejected ///< 新帧被拒绝
+    };
+
+    PushResult push(const CAN_TxHeaderTypeDef* header,
+                    const uint8_t              data[],
+                    const CAN_TxDropPolicy     policy,
+                    const CAN_TxTicket         ticket,
+                    const bool                 latest,
+                    CAN_TxTicket*              evicted,
+                    const uint32_t             stamp_us)
+    {
+        const uint32_t key    = arbitration_key(header);
+        PushResult     result = PushResult::Queued;
+        if (size_ == CAN_TX_QUEUE_SIZE)
+        {
+            if (policy == CAN_TX_REJECT_NEW)
+                return PushResult::Rejected;
+            // 丢弃优先级最低的一帧；如果新帧本身就是最低的，则拒绝新帧
+            const size_t worst = find_worst();
+            if (!less(key, next_seq_, slots_[heap_[worst]]))
+                return PushResult::Rejected;
+            *evicted = slots_[heap_[worst]].ticket;
+            remove_at(worst);
+            result = PushResult::Evicted;
+        }
+
+        const uint8_t slot = free_[CAN_TX_QUEUE_SIZE - 1 - size_];
+        Entry&        e    = slots_[slot];
+        e.key              = key;
+        e.seq              = next_seq_++;
+        e.ticket           = ticket;
+        e.latest           = latest;
+        fill(e, header, data);
+#if CAN_ENABLE_STATS
+        e.stamp_us = stamp_us;
+#else
+        (void) stamp_us;
+#endif
+
+        heap_[size_] = slot;
+        sift_up(size_++);
+        return result;
+    }
+
+    /**
+     * 用新帧覆盖队列中同 ID 的待发送帧
+     *
+     * 只覆盖通过 latest 方式入队的帧；被覆盖的帧保持原有的发送顺位，票据换成新帧的票据
+     * @return 被覆盖帧的票据；未找到时返回 CAN_TX_TICKET_INVALID，需要调用 push 入队
+     */
+    CAN_TxTicket replace_latest(const CAN_TxHeaderTypeDef* header,
+                                const uint8_t              data[],
+                                const CAN_TxTicket         ticket,
+                                const uint32_t             stamp_us)
+    {
+        const uint32_t key = arbitration_key(header);
+        for (size_t i = 0; i < size_; i++)
+        {
+            Entry& e = slots_[heap_[i]];
+            if (e.latest && e.key == key)
+            {
+                const CAN_TxTicket replaced = e.ticket;
+                e.ticket                    = ticket;
+                fill(e, header, data);
+                // 发出的是新值，延迟从新值提交时算起
+#if CAN_ENABLE_STATS
+                e.stamp_us = stamp_us;
+#else
+                (void) stamp_us;
+#endif
+                return replaced;
+            }
+        }
+        return CAN_TX_TICKET_INVALID;
+    }
+
+    /**
+     * 查看优先级最高的一帧（不出队）
+     * @return 队列为空时返回 nullptr
+     */
+    [[nodiscard]] const CAN_MessageDef* top() const { return size_ == 0 ? nullptr : &slots_[heap_[0]].msg; }
+    [[nodiscard]] CAN_TxTicket top_ticket() const { return size_ == 0 ? CAN_TX_TICKET_INVALID : slots_[heap_[0]].ticket; }
+    [[nodiscard]] bool         top_latest() const { return size_ != 0 && slots_[heap_[0]].latest; }
+#if CAN_ENABLE_STATS
+    [[nodiscard]] uint32_t top_stamp_us() const { return size_ == 0 ? 0 : slots_[heap_[0]].stamp_us; }
+#else
+    [[nodiscard]] uint32_t top_stamp_us() const { return 0; }
+#endif
+
+    [[nodiscard]] bool contains(const CAN_TxTicket ticket) const
+    {
+        for (size_t i = 0; i < size_; i++)
+            if (slots_[heap_[i]].ticket == ticket)
+                return true;
+        return false;
+    }
+
+    /**
+     * 弹出优先级最高的一帧
+     */
+    void pop()
+    {
+        if (size_ > 0)
+            remove_at(0);
+    }
+
+    /**
+     * 移除所有满足条件的帧
+     * @param pred 以 (latest, ticket) 调用，返回 true 表示移除
+     * @param removed 写入被移除帧的票据，至少 CAN_TX_QUEUE_SIZE 个
+     * @return 移除的帧数
+     */
+    template <typename Pred> size_t remove_if(Pred pred, CAN_TxTicket* removed)
+    {
+        const size_t old_size = size_;
+        size_t       kept     = 0;
+        size_t       count    = 0;
+        for (size_t i = 0; i < old_size; i++)
+        {
+            const uint8_t slot = heap_[i];
+            if (pred(slots_[slot].latest, slots_[slot].ticket))
+            {
+                removed[count]                           = slots_[slot].ticket;
+                free_[CAN_TX_QUEUE_SIZE - old_size + count] = slot;
+                count++;
+            }
+            else
+            {
+                heap_[kept++] = slot;
+            }
+        }
+        // 重新建堆
+        size_ = kept;
+        for (size_t i = size_ / 2; i-- > 0;)
+            sift_down(i);
+        return count;
+    }
+
+    [[nodiscard]] bool   empty() const { return size_ == 0; }
+    [[nodiscard]] size_t size() const { return size_; }
+
+private:
+    struct Entry
+    {
+        uint32_t       key;
+        uint32_t       seq;
+        CAN_TxTicket   ticket;
+        bool           latest; // 是否只保留最新值
+        CAN_MessageDef msg;
+#if CAN_ENABLE_STATS
+        uint32_t stamp_us; // 提交时间，用于统计发送延迟
+#endif
+    };
+
+    static void fill(Entry& e, const CAN_TxHeaderTypeDef* header, const uint8_t data[])
+    {
+        assert(header->DLC <= 8);
+
+        e.msg.header = *header;
+        // 分两次 memcpy 保证 data 的数据都有效
+        memcpy(e.msg.data, data, header->DLC);
+        memset(e.msg.data + header->DLC, 0, 8 - header->DLC);
+    }
+
+    // a 是否比 b 更优先；seq 使用差值比较，回卷后仍保持先入先出
+    static bool less(const uint32_t key, const uint32_t seq, const Entry& b)
+    {
+        if (key != b.key)
+            return key < b.key;
+        return static_cast<int32_t>(seq - b.seq) < 0;
+    }
+    bool less(const size_t i, const size_t j) const
+    {
+        const Entry& a = slots_[heap_[i]];
+        return less(a.key, a.seq, slots_[heap_[j]]);
+    }
+
+    void swap(const size_t i, const size_t j)
+    {
+        const uint8_t t = heap_[i];
+        heap_[i]        = heap_[j];
+        heap_[j]        = t;
+    }
+
+    void sift_up(size_t i)
+    {
+        while (i > 0 && less(i, (i - 1) / 2))
+        {
+            swap(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void sift_down(size_t i)
+    {
+        while (true)
+        {
+            const size_t l    = 2 * i + 1;
+            const size_t r    = l + 1;
+            size_t       best = i;
+            if (l < size_ && less(l, best))
+                best = l;
+            if (r < size_ && less(r, best))
+                best = r;
+            if (best == i)
+                return;
+            swap(i, best);
+            i = best;
+        }
+    }
+
+    // 优先级最低的一帧一定在叶子上，只需扫描后半部分
+    size_t find_worst() const
+    {
+        size_t worst = size_ / 2;
+        for (size_t i = worst + 1; i < size_; i++)
+            if (less(worst, i))
+                worst = i;
+        return worst;
+    }
+
+    void remove_at(const size_t i)
+    {
+        // 归还槽位，再用堆尾填补空位
+        free_[CAN_TX_QUEUE_SIZE - size_] = heap_[i];
+        heap_[i]                         = heap_[--size_];
+        if (i < size_)
+        {
+            sift_up(i);
+            sift_down(i);
+        }
+    }
+
+    Entry    slots_[CAN_TX_QUEUE_SIZE]{};
+    uint8_t  heap_[CAN_TX_QUEUE_SIZE]{};
+    // 空闲槽位栈，free_[0, CAN_TX_QUEUE_SIZE - size_) 为空闲槽位
+    uint8_t  free_[CAN_TX_QUEUE_SIZE]{};
+    size_t   size_{ 0 };
+    uint32_t next_seq_{ 0 };
+};
+
+#if CAN_ENABLE_STATS
+/**
+ * 统计计数器，除发送延迟的累计值外全部为原子变量，中断与线程均可直接更新
+ */
+struct CAN_StatsCounters
+{
+    std::atomic<uint32_t> tx_direct{ 0 };
+    std::atomic<uint32_t> tx_queued{ 0 };
+    std::atomic<uint32_t> tx_dropped{ 0 };
+    std::atomic<uint32_t> tx_rate_limited{ 0 };
+    std::atomic<uint32_t> tx_queue_high_water{ 0 };
+    std::atomic<uint32_t> rx_fifo[2]{};
+    std::atomic<uint32_t> rx_overrun[2]{};
+    std::atomic<uint32_t> rx_pool_empty{ 0 };
+    std::atomic<uint32_t> error_events{ 0 };
+    std::atomic<uint32_t> error_warning_events{ 0 };
+    std::atomic<uint32_t> error_passive_events{ 0 };
+    std::atomic<uint32_t> bus_off_events{ 0 };
+    std::atomic<uint32_t> bus_off_recoveries{ 0 };
+    std::atomic<uint32_t> recovery_ms_last{ 0 };
+    std::atomic<uint32_t> recovery_ms_max{ 0 };
+    std::atomic<uint32_t> isr_max_cycles{ 0 };
+    std::atomic<uint32_t> tx_latency_us_max{ 0 };
+    // 发送延迟的累计值与样本数，只在 CAN_Guard 内读写
+    uint64_t tx_latency_us_total{ 0 };
+    uint32_t tx_latency_count{ 0 };
+};
+
+void stat_max(std::atomic<uint32_t>& counter, const uint32_t value)
+{
+    uint32_t current = counter.load(std::memory_order_relaxed);
+    while (value > current &&
+           !counter.compare_exchange_weak(current, value, std::memory_order_relaxed, std::memory_order_relaxed))
+    {
+    }
+}
+
+#    define CAN_STAT_INC(map, field) (map)->stats.field.fetch_add(1, std::memory_order_relaxed)
+#    define CAN_STAT_MAX(map, field, value) stat_max((map)->stats.field, (value))
+#    define CAN_STAT_SET(map, field, value) (map)->stats.field.store((value), std::memory_order_relaxed)
+#else
+#    define CAN_STAT_INC(map, field) ((void) 0)
+#    define CAN_STAT_MAX(map, field, value) ((void) 0)
+#    define CAN_STAT_SET(map, field, value) ((void) 0)
+#endif
+
+// 中断耗时统计依赖 DWT CYCCNT，Cortex-M0/M0+ 没有该计数器
+#if CAN_ENABLE_STATS && defined(DWT_CTRL_CYCCNTENA_Msk)
+#    define CAN_ISR_CYCLES_BEGIN() const uint32_t isr_begin_cycles = DWT->CYCCNT
+#    define CAN_ISR_CYCLES_END(map) CAN_STAT_MAX(map, isr_max_cycles, DWT->CYCCNT - isr_begin_cycles)
+#else
+#    define CAN_ISR_CYCLES_BEGIN() ((void) 0)
+#    define CAN_ISR_CYCLES_END(map) ((void) 0)
+#endif
+
+#if CAN_TX_LOCK_PRIORITY > 0
+// 发送状态锁：持有者是唯一能修改发送队列、邮箱票据和错误状态的上下文
+std::atomic_flag tx_lock = ATOMIC_FLAG_INIT;
+// 持有者的嵌套深度，只由持有者修改
+uint32_t tx_lock_depth = 0;
+
+void flush_submissions();
+#endif
+
+#if CAN_ENABLE_STATS && defined(DWT_CTRL_CYCCNTENA_Msk)
+// 临界区最长持续时间，所有 CAN 共用
+std::atomic<uint32_t> lock_max_cycles{ 0 };
+#endif
+
+/**
+ * 驱动发送状态的临界区，可以嵌套
+ *
+ * CAN_TX_LOCK_PRIORITY 为 0 时与 ISRGuard 相同。否则只把 BASEPRI 提升到 CAN 中断的优先级，
+ * 并持有 tx_lock：优先级更高的中断照常响应，它们发送的帧进入提交队列，由最外层临界区退出时转入发送队列
+ */
+class CAN_Guard
+{
+public:
+    CAN_Guard()
+    {
+#if CAN_TX_LOCK_PRIORITY > 0
+        basepri_ = __get_BASEPRI();
+        __set_BASEPRI_MAX(CAN_TX_LOCK_PRIORITY << (8U - __NVIC_PRIO_BITS));
+        // 先取锁再记录深度：两步之间被更高优先级中断打断时，它会取锁并在返回前释放
+        if (tx_lock_depth == 0)
+            (void) tx_lock.test_and_set(std::memory_order_acquire);
+        tx_lock_depth++;
+#else
+        primask_ = isr_lock();
+#endif
+#if CAN_ENABLE_STATS && defined(DWT_CTRL_CYCCNTENA_Msk)
+        begin_cycles_ = DWT->CYCCNT;
+#endif
+    }
+
+    ~CAN_Guard()
+    {
+#if CAN_TX_LOCK_PRIORITY > 0
+        if (--tx_lock_depth == 0)
+        {
+            tx_lock.clear(std::memory_order_release);
+            // 持有期间被更高优先级中断提交的帧
+            flush_submissions();
+        }
+#endif
+#if CAN_ENABLE_STATS && defined(DWT_CTRL_CYCCNTENA_Msk)
+        stat_max(lock_max_cycles, DWT->CYCCNT - begin_cycles_);
+#endif
+#if CAN_TX_LOCK_PRIORITY > 0
+        __set_BASEPRI(basepri_);
+#else
+        isr_unlock(primask_);
+#endif
+    }
+
+    CAN_Guard(const CAN_Guard&)            = delete;
+    CAN_Guard& operator=(const CAN_Guard&) = delete;
+
+private:
+#if CAN_TX_LOCK_PRIORITY > 0
+    uint32_t basepri_;
+#else
+    uint32_t primask_;
+#endif
+#if CAN_ENABLE_STATS && defined(DWT_CTRL_CYCCNTENA_Msk)
+    uint32_t begin_cycles_;
+#endif
+};
+
+/**
+ * 只屏蔽中断、不持有 tx_lock 的临界区，保护与发送状态无关、只在 CAN 中断及更低优先级访问的数据（如时基）
+ *
+ * CAN_TX_LOCK_PRIORITY 为 0 时与 ISRGuard 相同，否则只把 BASEPRI 提升到 CAN 中断的优先级
+ */
+class CAN_MaskGuard
+{
+public:
+#if CAN_TX_LOCK_PRIORITY > 0
+    CAN_MaskGuard() : basepri_(__get_BASEPRI()) { __set_BASEPRI_MAX(CAN_TX_LOCK_PRIORITY << (8U - __NVIC_PRIO_BITS)); }
+    ~CAN_MaskGuard() { __set_BASEPRI(basepri_); }
+#else
+    CAN_MaskGuard() : primask_(isr_lock()) {}
+    ~CAN_MaskGuard() { isr_unlock(primask_); }
+#endif
+
+    CAN_MaskGuard(const CAN_MaskGuard&)            = delete;
+    CAN_MaskGuard& operator=(const CAN_MaskGuard&) = delete;
+
+private:
+#if CAN_TX_LOCK_PRIORITY > 0
+    uint32_t basepri_;
+#else
+    uint32_t primask_;
+#endif
+};
+
+#if CAN_TX_LOCK_PRIORITY > 0
+/**
+ * 当前是否处于优先级高于 CAN_TX_LOCK_PRIORITY 的中断中
+ *
+ * 这类上下文不能等待 tx_lock，发送时只能经提交队列转交
+ */
+bool above_tx_lock_priority()
+{
+    const uint32_t ipsr = __get_IPSR();
+    if (ipsr == 0)
+        return false;
+    const auto irqn = static_cast<IRQn_Type>(static_cast<int32_t>(ipsr) - 16);
+    // NMI 与 HardFault 的优先级固定高于所有可配置中断
+    if (irqn < MemoryManagement_IRQn)
+        return true;
+    return NVIC_GetPriority(irqn) < CAN_TX_LOCK_PRIORITY;
+}
+
+/**
+ * 高于 CAN_TX_LOCK_PRIORITY 的中断提交的一帧
+ */
+struct CAN_TxSubmission
+{
+    CAN_TxHeaderTypeDef header;
+    uint8_t             data[8];
+    CAN_TxTicket        ticket;
+    bool                latest;
+};
+#endif
+
+/**
+ * 估算一帧在总线上占用的位数（按最坏情况的位填充）
+ *
+ * 参与位填充的部分：标准帧 SOF 到 CRC 共 34 + 8n 位，扩展帧 54 + 8n 位，最坏每 4 位插入一个填充位；
+ * 另加 CRC 界定符、ACK、EOF 与帧间隔共 13 位
+ */
+template <typename Header> uint32_t frame_bits(const Header* header)
+{
+    const uint32_t data_bits = header->RTR == CAN_RTR_REMOTE ? 0 : 8 * (header->DLC > 8 ? 8 : header->DLC);
+    const uint32_t stuffed   = (header->IDE == CAN_ID_STD ? 34 : 54) + data_bits;
+    return stuffed + 13 + (stuffed - 1) / 4;
+}
+
+#if CAN_ENABLE_BUS_LOAD
+/**
+ * 总线负载估计
+ *
+ * 按 HAL_GetTick 把收发帧的位数累加到 10 ms 的桶中，保留最近 1 s；
+ * 查询时对已结束的桶求和，再除以该时间段内总线可传输的位数
+ */
+class CAN_BusLoad
+{
+public:
+    static constexpr uint32_t BUCKET_MS  = 10;
+    static constexpr uint32_t WINDOW_MAX = 1000 / BUCKET_MS;
+
+    void set_bitrate(const uint32_t bitrate) { bitrate_ = bitrate; }
+
+    /**
+     * 累加一帧的位数，可在中断中调用
+     */
+    void add(const uint32_t bits)
+    {
+        CAN_Guard guard;
+        advance(HAL_GetTick() / BUCKET_MS);
+        bits_[current_ % BUCKET_NUM] += bits;
+    }
+
+    /**
+     * 最近 window_ms 内的总线利用率，不含当前尚未结束的桶
+     */
+    float utilization(const uint32_t window_ms)
+    {
+        if (bitrate_ == 0)
+            return 0.0f;
+
+        uint32_t buckets = window_ms / BUCKET_MS;
+        if (buckets == 0)
+            buckets = 1;
+        if (buckets > WINDOW_MAX)
+            buckets = WINDOW_MAX;
+
+        uint32_t bits = 0;
+        {
+            CAN_Guard guard;
+            advance(HAL_GetTick() / BUCKET_MS);
+            for (uint32_t i = 1; i <= buckets; i++)
+                bits += bits_[(current_ - i) % BUCKET_NUM];
+        }
+        return static_cast<float>(bits) / (static_cast<float>(bitrate_) * (buckets * BUCKET_MS) / 1000.0f);
+    }
+
+private:
+    // 多一个桶存放当前尚未结束的时间段
+    static constexpr uint32_t BUCKET_NUM = WINDOW_MAX + 1;
+
+    // 前进到 bucket，跳过的桶清零
+    void advance(const uint32_t bucket)
+    {
+        const uint32_t steps = bucket - current_;
+        if (steps == 0)
+            return;
+        if (steps >= BUCKET_NUM)
+        {
+            memset(bits_, 0, sizeof(bits_));
+        }
+        else
+        {
+            for (uint32_t i = 1; i <= steps; i++)
+                bits_[(current_ + i) % BUCKET_NUM] = 0;
+        }
+        current_ = bucket;
+    }
+
+    uint32_t bits_[BUCKET_NUM]{};
+    uint32_t current_{ 0 };
+    uint32_t bitrate_{ 0 };
+};
+
+#    define CAN_BUS_LOAD_ADD(map, header) (map)->bus_load.add(frame_bits(header))
+#else
+#    define CAN_BUS_LOAD_ADD(map, header) ((void) 0)
+#endif
+
+/**
+ * 发送限速规则（令牌桶），令牌以 1/1000 帧为单位
+ */
+struct CAN_RateLimit
+{
+    uint32_t ide;
+    uint32_t id_low;
+    uint32_t id_high;
+    uint32_t rate;   // 帧 / s，即每 ms 补充 rate 个 1/1000 帧
+    uint32_t burst;  // 令牌桶容量，单位 1/1000 帧
+    uint32_t tokens; // 当前令牌，单位 1/1000 帧
+    uint32_t last_tick;
+};
+
+#if CAN_ENABLE_RX_TIMESTAMP && !defined(DWT_CTRL_CYCCNTENA_Msk)
+#    error "CAN_ENABLE_RX_TIMESTAMP requires DWT CYCCNT"
+#endif
+
+// 接收时间戳、最新值缓存的帧龄、收发记录与发送延迟统计使用微秒时基；没有 DWT 时后三者退化为 HAL_GetTick
+#if CAN_ENABLE_RX_TIMESTAMP ||                                                                                          \
+        ((CAN_ENABLE_RX_LATEST || CAN_ENABLE_RECORDER || CAN_ENABLE_STATS) && defined(DWT_CTRL_CYCCNTENA_Msk))
+#    define CAN_TIME_BASE_ENABLED (1)
+#else
+#    define CAN_TIME_BASE_ENABLED (0)
+#endif
+
+#if CAN_TIME_BASE_ENABLED
+/**
+ * 64 位单调微秒时基
+ *
+ * 由 DWT CYCCNT 的增量累加得到。CYCCNT 每 2^32 个周期回绕一次（168 MHz 下约 25 s），
+ * 两次读取间隔超过半个回绕周期时改用 HAL_GetTick 的增量推进（这一段精度退化为 1 ms），
+ * 因此长时间没有 CAN 中断也不会漏掉回绕
+ *
+ * 更新由 CAN_MaskGuard 保护，写入备用的一份状态后再切换发布。CAN_TX_LOCK_PRIORITY 非 0 时，
+ * 更高优先级的中断（处理提交队列时）可能打断正在更新的上下文，它们只从已发布的状态推算、不写回
+ */
+class CAN_TimeBase
+{
+public:
+    uint64_t now_us() { return now_us(nullptr); }
+
+    /**
+     * 读取当前时间，同时给出同一时刻的 HAL_GetTick
+     */
+    uint64_t now_us(uint32_t* tick)
+    {
+#    if CAN_TX_LOCK_PRIORITY > 0
+        if (above_tx_lock_priority())
+        {
+            State scratch;
+            return advance(state_[published_.load(std::memory_order_acquire)], scratch, tick);
+        }
+#    endif
+        CAN_MaskGuard  guard;
+        const uint32_t current = published_.load(std::memory_order_relaxed);
+        const uint64_t us      = advance(state_[current], state_[current ^ 1U], tick);
+        published_.store(current ^ 1U, std::memory_order_release);
+        return us;
+    }
+
+private:
+    struct State
+    {
+        uint64_t us{ 0 };
+        uint32_t remainder{ 0 };
+        uint32_t last_cycles{ 0 };
+        uint32_t last_tick{ 0 };
+    };
+
+    /**
+     * 从 from 推进到当前时刻，结果写入 to
+     */
+    static uint64_t advance(const State& from, State& to, uint32_t* tick)
+    {
+        const uint32_t cycles        = DWT->CYCCNT;
+        const uint32_t now_tick      = HAL_GetTick();
+        const uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+
+        to = from;
+        if (now_tick - from.last_tick > 0xFFFFFFFFU / SystemCoreClock * 500U)
+        {
+            to.us += static_cast<uint64_t>(now_tick - from.last_tick) * 1000U;
+            to.remainder = 0;
+        }
+        else
+        {
+            // 拆成商和余数累加，全部为 32 位运算
+            const uint32_t delta = cycles - from.last_cycles;
+            to.us += delta / cycles_per_us;
+            to.remainder += delta % cycles_per_us;
+            if (to.remainder >= cycles_per_us)
+            {
+                to.remainder -= cycles_per_us;
+                to.us++;
+            }
+        }
+        to.last_cycles = cycles;
+        to.last_tick   = now_tick;
+        if (tick != nullptr)
+            *tick = now_tick;
+        return to.us;
+    }
+
+    State                 state_[2];
+    std::atomic<uint32_t> published_{ 0 };
+};
+#endif
+
+#if CAN_ENABLE_RX_TIMESTAMP
+/**
+ * TTCM 时间戳扩展
+ *
+ * 时间触发模式下 bxCAN 在每帧的 SOF 采样点锁存一个 16 位、以位时间为单位的计数，
+ * 与 CPU 时钟同源，不会漂移。这里把相邻帧的计数差累加成 64 位，并以第一帧的中断时刻为起点换算为微秒；
+ * 两次中断间隔超过半个计数回绕周期时无法判断回绕次数，以当次中断时刻重新对齐
+ */
+class CAN_TtcmClock
+{
+public:
+    void set_bitrate(const uint32_t bitrate)
+    {
+        bit_ns_ = bitrate == 0 ? 0 : 1000000000U / bitrate;
+        valid_  = false;
+    }
+
+    /**
+     * 换算一帧的时间戳
+     * @param time RDTR.TIME
+     * @param isr_us 本次中断的时刻
+     */
+    uint64_t stamp(const uint16_t time, const uint64_t isr_us)
+    {
+        const uint64_t half_wrap_us = 0x8000ULL * bit_ns_ / 1000U;
+        if (!valid_ || isr_us - last_isr_us_ > half_wrap_us)
+        {
+            anchor_us_ = isr_us;
+            bits_      = 0;
+            valid_     = true;
+        }
+        else
+        {
+            bits_ += static_cast<uint16_t>(time - last_time_);
+        }
+        last_time_   = time;
+        last_isr_us_ = isr_us;
+
+        // 帧不可能晚于中断到达：超出时说明起点取晚了，把起点前移。
+        // 起点因此逐步收敛到中断延迟的下包络，之后各帧的时间戳只差一个最小中断延迟
+        const uint64_t timestamp = anchor_us_ + bits_ * bit_ns_ / 1000U;
+        if (timestamp <= isr_us)
+            return timestamp;
+        anchor_us_ -= timestamp - isr_us;
+        return isr_us;
+    }
+
+private:
+    uint32_t bit_ns_{ 0 };
+    bool     valid_{ false };
+    uint16_t last_time_{ 0 };
+    uint64_t last_isr_us_{ 0 };
+    uint64_t anchor_us_{ 0 };
+    uint64_t bits_{ 0 };
+};
+#endif
+
+#if CAN_ENABLE_RX_LATEST
+/**
+ * 一个 ID 的最新值
+ *
+ * 双缓冲加序号：写者总是写入未发布的那一份，写完再递增序号发布；读者拷贝已发布的那一份，
+ * 拷贝前后序号不变即为完整的快照。读者不会读到写了一半的帧，也不需要关中断，
+ * 即使在更高优先级的中断中打断写者读取也不会等待。每个 ID 只允许一个写者（该 CAN 的接收中断或 CAN_Poll）
+ */
+struct CAN_LatestSlot
+{
+    struct Entry
+    {
+        CAN_RxHeaderTypeDef header;
+        uint8_t             data[8];
+        uint64_t            stamp_us;
+    };
+
+    uint32_t              id{ 0 };
+    uint32_t              ide{ CAN_ID_STD };
+    std::atomic<uint32_t> sequence{ 0 }; // 已发布的帧数，0 表示尚未收到
+    Entry                 entries[2]{};
+
+    void write(const CAN_RxHeaderTypeDef* header, const uint8_t* data, const uint64_t stamp_us)
+    {
+        const uint32_t next  = sequence.load(std::memory_order_relaxed) + 1;
+        Entry&         entry = entries[next & 1];
+        entry.header         = *header;
+        memcpy(entry.data, data, sizeof(entry.data));
+        entry.stamp_us = stamp_us;
+        sequence.store(next, std::memory_order_release);
+    }
+
+    /**
+     * @return 尚未收到过该 ID 时返回 false
+     */
+    bool read(CAN_LatestFrame* frame, uint64_t* stamp_us) const
+    {
+        while (true)
+        {
+            const uint32_t seq = sequence.load(std::memory_order_acquire);
+            if (seq == 0)
+                return false;
+            const Entry& entry = entries[seq & 1];
+            frame->header      = entry.header;
+            memcpy(frame->data, entry.data, sizeof(frame->data));
+            *stamp_us = entry.stamp_us;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // 拷贝期间写者发布了新帧，它可能已经开始改写这一份
+            if (sequence.load(std::memory_order_relaxed) == seq)
+            {
+                frame->sequence = seq;
+                return true;
+            }
+        }
+    }
+};
+#endif
+
+static_assert(CAN_RX_POOL_SIZE >= 1 && CAN_RX_POOL_SIZE < 0xFFFF, "CAN_RX_POOL_SIZE must fit in uint16_t");
+
+/**
+ * 接收帧池
+ *
+ * 中断把硬件 FIFO 中的帧直接读进池中的槽位，回调拿到的 header / data 就指向该槽位；
+ * 需要保留帧的使用者通过 CAN_RetainFrame 增加引用，用完后 CAN_ReleaseFrame 归还，全程不再拷贝。
+ *
+ * 空闲槽位以无锁栈（Treiber stack）管理，栈顶高 16 位为修改计数，用于避免 ABA，
+ * 中断和线程可以同时分配 / 释放
+ */
+class CAN_RxFramePool
+{
+public:
+    CAN_RxFramePool()
+    {
+        for (uint16_t i = 0; i < CAN_RX_POOL_SIZE; i++)
+            frames_[i].next.store(i + 1 < CAN_RX_POOL_SIZE ? i + 1 : NIL, std::memory_order_relaxed);
+        head_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * 分配一个槽位，引用计数初始化为 1
+     * @return 池已空时返回 nullptr
+     */
+    CAN_RxFrame* allocate()
+    {
+        uint32_t head = head_.load(std::memory_order_acquire);
+        while (true)
+        {
+            const uint16_t index = head & 0xFFFF;
+            if (index == NIL)
+                return nullptr;
+            // 读到的 next 可能已过期，此时 head 的修改计数必然变化，CAS 会失败并重试
+            const uint32_t next    = frames_[index].next.load(std::memory_order_relaxed);
+            const uint32_t desired = ((head & 0xFFFF0000) + 0x10000) | next;
+            if (head_.compare_exchange_weak(head, desired, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                frames_[index].refs.store(1, std::memory_order_relaxed);
+                return &frames_[index];
+            }
+        }
+    }
+
+    static void retain(const CAN_RxFrame* frame) { frame->refs.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * 释放一个引用，最后一个引用释放时归还槽位
+     */
+    void release(const CAN_RxFrame* frame)
+    {
+        if (frame->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        const auto index = static_cast<uint16_t>(frame - frames_);
+        uint32_t   head  = head_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            frames_[index].next.store(head & 0xFFFF, std::memory_order_relaxed);
+            const uint32_t desired = ((head & 0xFFFF0000) + 0x10000) | index;
+            if (head_.compare_exchange_weak(head, desired, std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    /**
+     * 根据回调拿到的 header 指针反查所在槽位
+     * @return header 不属于帧池（例如帧池耗尽时的栈上临时帧）时返回 nullptr
+     */
+    const CAN_RxFrame* from_header(const CAN_RxHeaderTypeDef* header) const
+    {
+        // header 是 CAN_RxFrame 的第一个成员，地址与槽位相同
+        const auto addr = reinterpret_cast<uintptr_t>(header);
+        const auto base = reinterpret_cast<uintptr_t>(frames_);
+        if (addr < base || addr >= base + sizeof(frames_) || (addr - base) % sizeof(CAN_RxFrame) != 0)
+            return nullptr;
+        return reinterpret_cast<const CAN_RxFrame*>(header);
+    }
+
+private:
+    static constexpr uint16_t NIL = 0xFFFF;
+
+    CAN_RxFrame           frames_[CAN_RX_POOL_SIZE];
+    std::atomic<uint32_t> head_{ NIL };
+};
+
+/**
+ * 已结束发送的帧状态记录
+ */
+struct CAN_TxStatusRecord
+{
+    CAN_TxTicket ticket;
+    CAN_TxStatus status;
+};
+
+/**
+ * 按 ID 分发的回调项
+ */
+struct CAN_IdHandler
+{
+    CAN_IdCallback_t callback;
+    void*            ctx;
+};
+
+/**
+ * 过滤器组在寄存器中的位置
+ *
+ * 双 CAN 芯片的过滤器寄存器全部位于 CAN1，由 CAN2SB 把过滤器组划分给两个实例
+ */
+struct CAN_FilterBankRange
+{
+    CAN_TypeDef* can_ip;
+    uint32_t     first;
+    uint32_t     last; // 不含
+};
+
+/**
+ * 扩展帧 ID 哈希表槽位，handler 为 0 表示空槽
+ */
+struct CAN_ExtIdSlot
+{
+    uint32_t id;
+    uint8_t  handler;
+};
+
+/**
+ * CAN 回调函数表
+ *
+ * @note 由于 HAL 只允许将一个函数作为回调函数，如果想在一条总线上处理不同种类的
+ *       信息（有多个不同的回调函数），就必须要通过一个主回调函数进行分发
+ *
+ * @note 广播回调会收到该总线上的每一帧，需要自行按 StdId 过滤；按 ID 注册的回调
+ *       通过直接索引表（标准帧）或开放寻址哈希表（扩展帧）查找，每帧分发代价为 O(1)，
+ *       与注册数量无关。标准帧索引表每条总线占用 2 KiB
+ *
+ * @note STM32 的 CAN mailbox 数量往往有限，但是在很短的时间内可能连续发送多条消息
+ *       自带的 mailbox 无法满足要求，故需要做一个软件缓冲区来临时储存溢出的消息
+ */
+struct CAN_CallbackMap
+{
+    CAN_HandleTypeDef*        hcan{ nullptr };
+    CAN_FifoReceiveCallback_t callbacks[CAN_MAX_CALLBACK_NUM]{};
+    uint32_t                  callback_count{ 0 };
+
+    CAN_IdHandler id_handlers[CAN_MAX_ID_CALLBACK_NUM]{};
+    uint32_t      id_handler_count{ 0 };
+    // 标准帧 ID -> id_handlers 下标 + 1，0 表示未注册
+    uint8_t       std_id_table[CAN_STD_ID_NUM]{};
+    CAN_ExtIdSlot ext_id_table[CAN_EXT_ID_TABLE_SIZE]{};
+    // 硬件过滤器编号（FMI）-> 回调，由 CAN_ConfigFilterRoutes 填写
+    CAN_IdHandler fmi_handlers[2][CAN_FMI_TABLE_SIZE]{};
+
+    // 按仲裁优先级排序的发送队列，队列长度 CAN_TX_QUEUE_SIZE
+    // 邮箱空出时总是先装入 ID 最小的帧
+    CAN_TxQueue      tx_queue;
+    CAN_TxDropPolicy tx_drop_policy{ CAN_TX_DROP_LOWEST_PRIORITY };
+
+#if CAN_TX_LOCK_PRIORITY > 0
+    // 高于 CAN_TX_LOCK_PRIORITY 的中断提交的帧，由 tx_lock 的持有者转入发送队列
+    MpscQueue<CAN_TxSubmission, CAN_TX_SUBMIT_QUEUE_SIZE> tx_submit;
+#endif
+
+    // 发送票据：各邮箱中帧的票据，以及按 ticket % CAN_TX_STATUS_HISTORY_SIZE 存放的结束状态
+    std::atomic<CAN_TxTicket> next_ticket{ 1 };
+    CAN_TxTicket              mailbox_tickets[3]{};
+    // 各邮箱中帧的仲裁优先级、是否以 latest 方式发送，以及是否因被新值覆盖而请求了中止
+    uint32_t mailbox_keys[3]{};
+    bool     mailbox_latest[3]{};
+    bool     mailbox_replaced[3]{};
+#if CAN_ENABLE_STATS
+    // 各邮箱中帧的提交时间，用于统计发送延迟
+    uint32_t mailbox_stamp_us[3]{};
+#endif
+    CAN_TxStatusRecord        tx_history[CAN_TX_STATUS_HISTORY_SIZE]{};
+    CAN_TxCompleteCallback_t  tx_complete_callback{ nullptr };
+    void*                     tx_complete_ctx{ nullptr };
+
+    // 错误状态，在错误中断与发送完成时更新
+    volatile CAN_ErrorState error_state{ CAN_ERROR_ACTIVE };
+    CAN_RecoveryPolicy      recovery_policy{ CAN_RECOVERY_REPLAY };
+    uint32_t                bus_off_tick{ 0 };
+
+    // 发送限速规则，按设置顺序匹配第一条
+    CAN_RateLimit rate_limits[CAN_MAX_RATE_LIMIT_NUM]{};
+    uint32_t      rate_limit_count{ 0 };
+
+#if CAN_ENABLE_STATS
+    CAN_StatsCounters stats;
+#endif
+
+#if CAN_ENABLE_BUS_LOAD
+    CAN_BusLoad bus_load;
+#endif
+
+#if CAN_ENABLE_RX_TIMESTAMP
+    CAN_TtcmClock ttcm;
+#endif
+
+#if CAN_ENABLE_RX_LATEST
+    CAN_LatestSlot latest[CAN_MAX_LATEST_NUM];
+    uint32_t       latest_count{ 0 };
+#endif
+
+#if CAN_ENABLE_RX_DEFERRED
+    // 延迟接收队列：中断为唯一生产者，CAN_Poll 为唯一消费者，队列满时丢弃新帧
+    // 队列中只保存帧池槽位的指针，帧数据不会被拷贝
+    libs::RingBuffer<CAN_RxFrame*, CAN_RX_QUEUE_SIZE, false> rx_queue;
+    volatile bool                                           rx_deferred{ false };
+    std::atomic<uint32_t>                                   rx_dropped{ 0 };
+#endif
+};
+
+// 根据 CAN 实例的数量定义回调表
+// CAN 实例的数量取决于芯片型号，且无法在编译器预知，故在 .hpp 内通过宏定义
+CAN_CallbackMap maps[CAN_NUM];
+size_t          map_size = 0;
+
+// 所有 CAN 共用一个接收帧池
+CAN_RxFramePool rx_pool;
+
+#if CAN_TIME_BASE_ENABLED
+// 所有 CAN 共用一个时基
+CAN_TimeBase time_base;
+#endif
+
+#if CAN_ENABLE_RX_LATEST || CAN_ENABLE_RECORDER || CAN_ENABLE_STATS
+/**
+ * 当前时间，单位微秒；没有 DWT 时精度为 1 ms
+ */
+uint64_t time_now_us()
+{
+#    if CAN_TIME_BASE_ENABLED
+    return time_base.now_us();
+#    else
+    return static_cast<uint64_t>(HAL_GetTick()) * 1000U;
+#    endif
+}
+#endif
+
+/**
+ * 帧提交（装入邮箱或入队）的时间，只保留低 32 位，差值在回绕后仍然正确；用于统计发送延迟
+ */
+uint32_t tx_stamp_us()
+{
+#if CAN_ENABLE_STATS
+    return static_cast<uint32_t>(time_now_us());
+#else
+    return 0;
+#endif
+}
+
+#if CAN_ENABLE_RX_LATEST || CAN_ENABLE_RECORDER
+/**
+ * 接收帧的到达时间：开启接收时间戳时取帧的时间戳，否则取当前时间
+ */
+uint64_t frame_time_us(const CAN_RxHeaderTypeDef* header)
+{
+#    if CAN_ENABLE_RX_TIMESTAMP
+    // 驱动交给回调的 header 总是 CAN_RxFrame 的第一个成员
+    return reinterpret_cast<const CAN_RxFrame*>(header)->timestamp_us;
+#    else
+    (void) header;
+    return time_now_us();
+#    endif
+}
+#endif
+
+#if CAN_ENABLE_RECORDER
+static_assert(CAN_RECORDER_BUFFER_SIZE >= can_log::BLOCK_HEADER_SIZE + can_log::MAX_RECORD_SIZE &&
+                      CAN_RECORDER_BUFFER_SIZE <= 0xFFFF,
+              "CAN_RECORDER_BUFFER_SIZE must hold at least one record and fit in uint16_t");
+
+/**
+ * 收发记录器
+ *
+ * 两块缓冲区交替使用：当前块写满后交给输出回调，切换到另一块继续记录。
+ * 另一块尚未归还时新帧被丢弃并计数，丢弃数写入下一块的块头，解码时可以看出记录的缺口
+ */
+class CAN_Recorder
+{
+public:
+    void start(const CAN_RecorderSink_t sink, void* ctx)
+    {
+        CAN_Guard guard;
+        sink_          = sink;
+        ctx_           = ctx;
+        used_          = 0;
+        block_dropped_ = 0;
+        // 不清除 pending_：上一次交给输出回调的块直到 CAN_RecorderRelease 之前都不能被改写
+        dropped_.store(0, std::memory_order_relaxed);
+    }
+
+    void stop()
+    {
+        CAN_Guard guard;
+        sink_ = nullptr;
+    }
+
+    /**
+     * 记录一帧，可在中断中调用
+     */
+    void record(const can_log::Record& record)
+    {
+        const uint8_t*     ready      = nullptr;
+        size_t             ready_size = 0;
+        CAN_RecorderSink_t sink       = nullptr;
+        void*              ctx        = nullptr;
+        {
+            CAN_Guard guard;
+            if (sink_ == nullptr)
+                return;
+            if (used_ == 0)
+                begin_block(record.time_us);
+
+            uint8_t encoded[can_log::MAX_RECORD_SIZE];
+            size_t  size = can_log::encode_record(encoded, record, last_us_);
+            if (used_ + size > CAN_RECORDER_BUFFER_SIZE)
+            {
+                if (pending_.load(std::memory_order_acquire))
+                {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    block_dropped_++;
+                    return;
+                }
+                ready = hand_off(&ready_size);
+                begin_block(record.time_us);
+                size = can_log::encode_record(encoded, record, last_us_);
+            }
+            memcpy(buffers_[active_] + used_, encoded, size);
+            used_ += size;
+            // 延迟分发的接收帧可能早于已记录的发送帧，时间差为负，解码后仍是原始时间
+            last_us_ = record.time_us;
+            sink = sink_;
+            ctx  = ctx_;
+        }
+        // 在临界区外输出，输出期间另一块可以继续记录
+        if (ready != nullptr)
+            sink(ready, ready_size, ctx);
+    }
+
+    /**
+     * 输出当前未写满的块
+     * @return 当前块为空、上一块尚未归还或未启动时返回 false
+     */
+    bool flush()
+    {
+        const uint8_t*     ready      = nullptr;
+        size_t             ready_size = 0;
+        CAN_RecorderSink_t sink       = nullptr;
+        void*              ctx        = nullptr;
+        {
+            CAN_Guard guard;
+            if (sink_ == nullptr || used_ <= can_log::BLOCK_HEADER_SIZE || pending_.load(std::memory_order_acquire))
+                return false;
+            ready = hand_off(&ready_size);
+            sink  = sink_;
+            ctx   = ctx_;
+        }
+        sink(ready, ready_size, ctx);
+        return true;
+    }
+
+    void release() { pending_.store(false, std::memory_order_release); }
+
+    [[nodiscard]] uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    void begin_block(const uint64_t time_us)
+    {
+        const uint16_t dropped = block_dropped_ > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(block_dropped_);
+        used_                  = can_log::encode_block_header(buffers_[active_], time_us, dropped);
+        block_dropped_         = 0;
+        last_us_               = time_us;
+    }
+
+    // 结束当前块并切换到另一块，调用前需处于临界区内且另一块已归还
+    const uint8_t* hand_off(size_t* size)
+    {
+        uint8_t* block = buffers_[active_];
+        can_log::set_block_length(block, used_);
+        *size = used_;
+        pending_.store(true, std::memory_order_relaxed);
+        active_ ^= 1;
+        used_ = 0;
+        return block;
+    }
+
+    uint8_t               buffers_[2][CAN_RECORDER_BUFFER_SIZE]{};
+    uint8_t               active_{ 0 };
+    size_t                used_{ 0 }; // 当前块已写入的字节数，0 表示块头尚未写入
+    uint64_t              last_us_{ 0 };
+    uint32_t              block_dropped_{ 0 };
+    std::atomic<bool>     pending_{ false }; // 另一块已交给输出回调，尚未归还
+    std::atomic<uint32_t> dropped_{ 0 };
+    CAN_RecorderSink_t    sink_{ nullptr };
+    void*                 ctx_{ nullptr };
+};
+
+// 所有 CAN 共用一个记录器
+CAN_Recorder recorder;
+
+/**
+ * 把一帧交给记录器，总线编号为该 CAN 在回调表中的位置
+ */
+template <typename Header>
+void record_frame(const CAN_CallbackMap* map,
+                  const Header*          header,
+                  const uint8_t*         data,
+                  const bool             tx,
+                  const uint64_t         time_us)
+{
+    can_log::Record record{};
+    record.time_us = time_us;
+    record.ext     = header->IDE != CAN_ID_STD;
+    record.id      = record.ext ? header->ExtId : header->StdId;
+    record.rtr     = header->RTR != CAN_RTR_DATA;
+    record.tx      = tx;
+    record.bus     = static_cast<uint8_t>(map - maps);
+    record.dlc     = static_cast<uint8_t>(header->DLC > 8 ? 8 : header->DLC);
+    memcpy(record.data, data, record.dlc);
+    recorder.record(record);
+}
+#endif
+
+#if CAN_ENABLE_RX_WORKER
+constexpr uint32_t CAN_RX_WORKER_FLAG = 1U << 0;
+
+osThreadId_t rx_worker = nullptr;
+#endif
+
+// 根据 can handle 的指针查找 can map
+CAN_CallbackMap* get_map(const CAN_HandleTypeDef* hcan)
+{
+    for (size_t i = 0; i < map_size; i++)
+        if (maps[i].hcan == hcan)
+            return &maps[i];
+
+    return nullptr;
+}
+
+// 查找 can map，不存在时新建一个
+CAN_CallbackMap* get_or_create_map(CAN_HandleTypeDef* hcan)
+{
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map != nullptr)
+        return map;
+
+    if (map_size >= CAN_NUM)
+    {
+        // 仅当 CAN_NUM 配置错误时可能触发，此时进入死循环
+        Error_Handler();
+        return nullptr;
+    }
+    // maps 为静态存储，其余字段已经零初始化
+    map       = &maps[map_size++];
+    map->hcan = hcan;
+    return map;
+}
+
+uint32_t ext_id_hash(const uint32_t ext_id)
+{
+    // 乘法哈希，取高位作为下标
+    return ((ext_id * 0x9E3779B1U) >> 16) & (CAN_EXT_ID_TABLE_SIZE - 1);
+}
+
+// 根据帧头查找按 ID 注册的回调，未注册时返回 nullptr
+const CAN_IdHandler* find_id_handler(const CAN_CallbackMap* map, const CAN_RxHeaderTypeDef* header)
+{
+    uint8_t handler = 0;
+    if (header->IDE == CAN_ID_STD)
+    {
+        handler = map->std_id_table[header->StdId & CAN_STD_ID_MASK];
+    }
+    else
+    {
+        // 线性探测，遇到空槽即说明未注册
+        for (uint32_t i = 0, h = ext_id_hash(header->ExtId); i < CAN_EXT_ID_TABLE_SIZE;
+             i++, h = (h + 1) & (CAN_EXT_ID_TABLE_SIZE - 1))
+        {
+            const CAN_ExtIdSlot& slot = map->ext_id_table[h];
+            if (slot.handler == 0)
+                break;
+            if (slot.id == header->ExtId)
+            {
+                handler = slot.handler;
+                break;
+            }
+        }
+    }
+    return handler == 0 ? nullptr : &map->id_handlers[handler - 1];
+}
+
+// 向回调表末尾追加一个按 ID 分发的回调，返回 下标 + 1，表满时返回 0
+uint8_t add_id_handler(CAN_CallbackMap* map, const CAN_IdCallback_t callback, void* ctx)
+{
+    if (map->id_handler_count >= CAN_MAX_ID_CALLBACK_NUM)
+        return 0;
+    map->id_handlers[map->id_handler_count] = { callback, ctx };
+    return static_cast<uint8_t>(++map->id_handler_count);
+}
+
+// 获取过滤器寄存器所在的实例及本实例可使用的过滤器组范围
+CAN_FilterBankRange get_filter_bank_range(const CAN_HandleTypeDef* hcan, const uint32_t slave_start_bank)
+{
+#if defined(CAN3)
+    if (hcan->Instance == CAN3)
+        return { CAN3, 0, 14 };
+#endif
+#if defined(CAN2)
+    if (hcan->Instance == CAN2)
+        return { CAN1, slave_start_bank, 28 };
+    return { CAN1, 0, slave_start_bank };
+#else
+    (void) slave_start_bank;
+    return { hcan->Instance, 0, 14 };
+#endif
+}
+
+/**
+ * 计算某个过滤器组第一个过滤器的编号（FMI）
+ *
+ * bxCAN 的过滤器编号按 FIFO 分别从 0 开始，依次累加分配给该 FIFO 的所有过滤器组，
+ * 与过滤器组是否激活无关：32 位 mask 占 1 个编号，32 位 list 和 16 位 mask 占 2 个，
+ * 16 位 list 占 4 个。因此这里直接读寄存器统计，而不假设前面的过滤器组处于何种配置
+ */
+uint32_t get_filter_number_base(const CAN_FilterBankRange& range, const uint32_t bank, const uint32_t fifo)
+{
+    uint32_t base = 0;
+    for (uint32_t i = range.first; i < bank; i++)
+    {
+        if (((range.can_ip->FFA1R >> i) & 1U) != fifo)
+            continue;
+        const bool scale32 = (range.can_ip->FS1R >> i) & 1U;
+        const bool list    = (range.can_ip->FM1R >> i) & 1U;
+        base += (scale32 ? 1U : 2U) * (list ? 2U : 1U);
+    }
+    return base;
+}
+
+// 转换为 32 位过滤器寄存器格式：STID[31:21] / EXID[31:3] IDE[2] RTR[1]
+uint32_t filter_id_reg(const uint32_t id, const uint32_t ide)
+{
+    return ide == CAN_ID_STD ? (id & CAN_STD_ID_MASK) << 21 : ((id & CAN_EXT_ID_MASK) << 3) | CAN_ID_EXT;
+}
+
+// 掩码同样要求 IDE 位匹配，避免标准帧与扩展帧互相误命中
+uint32_t filter_mask_reg(const uint32_t mask, const uint32_t ide)
+{
+    return ide == CAN_ID_STD ? (mask & CAN_STD_ID_MASK) << 21 | CAN_ID_EXT
+                             : ((mask & CAN_EXT_ID_MASK) << 3) | CAN_ID_EXT;
+}
+
+bool is_exact_route(const CAN_FilterRoute& route)
+{
+    const uint32_t full = route.ide == CAN_ID_STD ? CAN_STD_ID_MASK : CAN_EXT_ID_MASK;
+    return (route.mask & full) == full;
+}
+
+/**
+ * 配置一个 32 位过滤器组，并把其过滤器编号登记到分发表
+ *
+ * a 与 b 相同且为 mask 模式时占用一个编号；list 模式下 a、b 各占一个编号
+ */
+bool config_route_bank(CAN_HandleTypeDef*     hcan,
+                       CAN_CallbackMap*       map,
+                       const uint32_t         bank,
+                       const uint32_t         slave_start_bank,
+                       const CAN_FilterRoute& a,
+                       const CAN_FilterRoute& b,
+                       const bool             list)
+{
+    const CAN_FilterBankRange range = get_filter_bank_range(hcan, slave_start_bank);
+    if (bank < range.first || bank >= range.last)
+        return false;
+
+    // 先确认 FMI 表放得下再写硬件，否则过滤器组已激活、命中的帧却没有对应的回调
+    const uint32_t fmi = get_filter_number_base(range, bank, a.fifo);
+    if (fmi + (list ? 1 : 0) >= CAN_FMI_TABLE_SIZE)
+        return false;
+
+    const uint32_t id_reg   = filter_id_reg(a.id, a.ide);
+    const uint32_t mask_reg = list ? filter_id_reg(b.id, b.ide) : filter_mask_reg(a.mask, a.ide);
+
+    const CAN_FilterTypeDef filter{
+        .FilterIdHigh         = id_reg >> 16,
+        .FilterIdLow          = id_reg & 0xFFFF,
+        .FilterMaskIdHigh     = mask_reg >> 16,
+        .FilterMaskIdLow      = mask_reg & 0xFFFF,
+        .FilterFIFOAssignment = a.fifo == CAN_RX_FIFO0 ? CAN_FILTER_FIFO0 : CAN_FILTER_FIFO1,
+        .FilterBank           = bank,
+        .FilterMode           = list ? CAN_FILTERMODE_IDLIST : CAN_FILTERMODE_IDMASK,
+        .FilterScale          = CAN_FILTERSCALE_32BIT,
+        .FilterActivation     = CAN_FILTER_ENABLE,
+        .SlaveStartFilterBank = slave_start_bank,
+    };
+    if (HAL_CAN_ConfigFilter(hcan, &filter) != HAL_OK)
+        return false;
+
+    map->fmi_handlers[a.fifo][fmi] = { a.callback, a.ctx };
+    if (list)
+        map->fmi_handlers[a.fifo][fmi + 1] = { b.callback, b.ctx };
+    return true;
+}
+
+/**
+ * 把一帧分发到回调函数
+ *
+ * 先按硬件过滤器编号或 ID 查表调用对应回调，再依次调用广播回调
+ */
+void dispatch_frame(CAN_HandleTypeDef*         hcan,
+                    const CAN_CallbackMap*     map,
+                    const uint32_t             fifo,
+                    const CAN_RxHeaderTypeDef* header,
+                    const uint8_t*             data)
+{
+#if CAN_ENABLE_RECORDER
+    record_frame(map, header, data, false, frame_time_us(header));
+#endif
+
+    // 优先按硬件过滤器编号分发，命中时无需再做软件过滤
+    const CAN_IdHandler* handler = nullptr;
+    if (header->FilterMatchIndex < CAN_FMI_TABLE_SIZE &&
+        map->fmi_handlers[fifo][header->FilterMatchIndex].callback != nullptr)
+        handler = &map->fmi_handlers[fifo][header->FilterMatchIndex];
+    else
+        handler = find_id_handler(map, header);
+
+    if (handler != nullptr)
+        handler->callback(hcan, header, data, handler->ctx);
+
+    // 依次调用所有的广播回调函数
+    for (size_t i = 0; i < map->callback_count; i++)
+        map->callbacks[i](hcan, header, data);
+}
+
+#if CAN_ENABLE_RX_TIMESTAMP
+/**
+ * 计算一帧的到达时间：开启时间触发模式时使用硬件时间戳，否则使用中断时刻
+ */
+uint64_t rx_timestamp(const CAN_HandleTypeDef*   hcan,
+                      CAN_CallbackMap*           map,
+                      const CAN_RxHeaderTypeDef* header,
+                      const uint64_t             isr_us)
+{
+    if (hcan->Init.TimeTriggeredMode == ENABLE)
+        return map->ttcm.stamp(static_cast<uint16_t>(header->Timestamp), isr_us);
+    return isr_us;
+}
+
+// 进入接收中断时取一次时间，同一次中断取出的帧共用
+#    define CAN_RX_TIME_BEGIN() const uint64_t isr_us = time_base.now_us()
+#    define CAN_RX_STAMP(hcan, map, frame)                                                                    \
+            ((frame)->timestamp_us = rx_timestamp((hcan), (map), &(frame)->header, isr_us))
+#else
+#    define CAN_RX_TIME_BEGIN() ((void) 0)
+#    define CAN_RX_STAMP(hcan, map, frame) ((void) 0)
+#endif
+
+#if CAN_ENABLE_RX_DEFERRED
+/**
+ * 延迟接收模式下清空指定 FIFO
+ *
+ * 中断里只把帧直接读进接收队列的槽位，不调用任何回调
+ * @return 是否有新帧入队
+ */
+bool enqueue_fifo(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map, const uint32_t fifo)
+{
+    CAN_RX_TIME_BEGIN();
+    bool enqueued = false;
+    while (hw_rx_fill_level(hcan, fifo) > 0)
+    {
+        CAN_RxFrame* frame = rx_pool.allocate();
+        if (frame == nullptr)
+        {
+            // 帧池已空，仍需取出数据以清空 FIFO
+            CAN_RxFrame scratch;
+            if (!hw_get_rx(hcan, fifo, &scratch.header, scratch.data))
+            {
+                Error_Handler();
+                return enqueued;
+            }
+            CAN_STAT_INC(map, rx_fifo[fifo]);
+            CAN_STAT_INC(map, rx_pool_empty);
+            CAN_BUS_LOAD_ADD(map, &scratch.header);
+            map->rx_dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // 直接读进帧池槽位，队列里只传递指针
+        if (!hw_get_rx(hcan, fifo, &frame->header, frame->data))
+        {
+            rx_pool.release(frame);
+            Error_Handler();
+            return enqueued;
+        }
+        frame->fifo = static_cast<uint8_t>(fifo);
+        CAN_RX_STAMP(hcan, map, frame);
+        CAN_STAT_INC(map, rx_fifo[fifo]);
+        CAN_BUS_LOAD_ADD(map, &frame->header);
+
+        if (!map->rx_queue.push(frame))
+        {
+            rx_pool.release(frame);
+            map->rx_dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        enqueued = true;
+    }
+    return enqueued;
+}
+#endif
+
+/**
+ * 清空指定 FIFO 并分发到回调函数
+ */
+void receive_fifo(CAN_HandleTypeDef* hcan, const uint32_t fifo)
+{
+    // 查找回调函数表
+    CAN_CallbackMap* map = get_map(hcan);
+    CAN_ISR_CYCLES_BEGIN();
+
+#if CAN_ENABLE_RX_DEFERRED
+    if (map != nullptr && map->rx_deferred)
+    {
+        const bool enqueued = enqueue_fifo(hcan, map, fifo);
+#    if CAN_ENABLE_RX_WORKER
+        if (enqueued && rx_worker != nullptr)
+            (void) osThreadFlagsSet(rx_worker, CAN_RX_WORKER_FLAG);
+#    else
+        (void) enqueued;
+#    endif
+        CAN_ISR_CYCLES_END(map);
+        return;
+    }
+#endif
+
+    CAN_RX_TIME_BEGIN();
+
+    // 采用 while 循环来确保清空队列
+    while (hw_rx_fill_level(hcan, fifo) > 0)
+    {
+        // 帧池耗尽时退化为栈上临时帧，此时回调无法 CAN_RetainFrame
+        CAN_RxFrame  scratch;
+        CAN_RxFrame* frame = rx_pool.allocate();
+        if (frame == nullptr)
+        {
+            frame = &scratch;
+            if (map != nullptr)
+                CAN_STAT_INC(map, rx_pool_empty);
+        }
+
+        // 从 FIFO 中获取一帧，直接读进帧池槽位
+        if (!hw_get_rx(hcan, fifo, &frame->header, frame->data))
+        {
+            Error_Handler();
+            return;
+        }
+        frame->fifo = static_cast<uint8_t>(fifo);
+
+        // 如果该 CAN 未被注册，仍需取出数据以清空 FIFO
+        if (map != nullptr)
+        {
+            CAN_RX_STAMP(hcan, map, frame);
+            CAN_STAT_INC(map, rx_fifo[fifo]);
+            CAN_BUS_LOAD_ADD(map, &frame->header);
+            dispatch_frame(hcan, map, fifo, &frame->header, frame->data);
+        }
+
+        // 释放中断自身持有的引用，回调中 retain 过的帧会保留到使用者释放
+        if (frame != &scratch)
+            rx_pool.release(frame);
+    }
+
+    if (map != nullptr)
+        CAN_ISR_CYCLES_END(map);
+}
+
+/**
+ * 分配一个发送票据，可在任意上下文调用
+ */
+CAN_TxTicket new_ticket(CAN_CallbackMap* map)
+{
+    CAN_TxTicket ticket = map->next_ticket.fetch_add(1, std::memory_order_relaxed);
+    if (ticket == CAN_TX_TICKET_INVALID)
+        ticket = map->next_ticket.fetch_add(1, std::memory_order_relaxed);
+    return ticket;
+}
+
+/**
+ * CAN_TX_MAILBOXx 转换为邮箱下标
+ */
+size_t mailbox_index(const uint32_t mailbox)
+{
+    return mailbox == CAN_TX_MAILBOX0 ? 0 : mailbox == CAN_TX_MAILBOX1 ? 1 : 2;
+}
+
+/**
+ * 记录一帧的结束状态并通知发送结束回调
+ */
+void finish_tx(CAN_CallbackMap* map, const CAN_TxTicket ticket, const CAN_TxStatus status)
+{
+    if (ticket == CAN_TX_TICKET_INVALID)
+        return;
+    map->tx_history[ticket & (CAN_TX_STATUS_HISTORY_SIZE - 1)] = { ticket, status };
+    if (map->tx_complete_callback != nullptr)
+        map->tx_complete_callback(map->hcan, ticket, status, map->tx_complete_ctx);
+}
+
+/**
+ * 按限速规则检查一帧能否发送，调用前需处于临界区内
+ *
+ * 超出限速时记录 CAN_TX_STATUS_RATE_LIMITED
+ * @return 允许发送返回 true
+ */
+bool rate_limit_allow(CAN_CallbackMap* map, const CAN_TxHeaderTypeDef* header, const CAN_TxTicket ticket)
+{
+    const uint32_t id = header->IDE == CAN_ID_STD ? header->StdId : header->ExtId;
+    for (uint32_t i = 0; i < map->rate_limit_count; i++)
+    {
+        CAN_RateLimit& limit = map->rate_limits[i];
+        if (limit.ide != header->IDE || id < limit.id_low || id > limit.id_high)
+            continue;
+
+        // 补充令牌
+        const uint32_t now     = HAL_GetTick();
+        const uint64_t refill  = static_cast<uint64_t>(now - limit.last_tick) * limit.rate + limit.tokens;
+        limit.tokens           = refill > limit.burst ? limit.burst : static_cast<uint32_t>(refill);
+        limit.last_tick        = now;
+        if (limit.tokens >= 1000)
+        {
+            limit.tokens -= 1000;
+            return true;
+        }
+        CAN_STAT_INC(map, tx_rate_limited);
+        finish_tx(map, ticket, CAN_TX_STATUS_RATE_LIMITED);
+        return false;
+    }
+    return true;
+}
+
+#if CAN_ENABLE_BUS_LOAD || CAN_ENABLE_RX_TIMESTAMP
+/**
+ * 根据 BTR 计算 CAN 的波特率
+ */
+uint32_t can_bitrate(const CAN_HandleTypeDef* hcan)
+{
+    const uint32_t btr = hcan->Instance->BTR;
+    const uint32_t brp = (btr & CAN_BTR_BRP) + 1;
+    const uint32_t ts1 = ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) + 1;
+    const uint32_t ts2 = ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos) + 1;
+    return HAL_RCC_GetPCLK1Freq() / (brp * (1 + ts1 + ts2));
+}
+#endif
+
+/**
+ * 记录装入邮箱的帧
+ */
+void track_mailbox(CAN_CallbackMap*           map,
+                   const uint32_t             mailbox,
+                   const CAN_TxHeaderTypeDef* header,
+                   const CAN_TxTicket         ticket,
+                   const bool                 latest,
+                   const uint32_t             stamp_us)
+{
+    const size_t index           = mailbox_index(mailbox);
+    map->mailbox_tickets[index]  = ticket;
+    map->mailbox_keys[index]     = arbitration_key(header);
+    map->mailbox_latest[index]   = latest;
+    map->mailbox_replaced[index] = false;
+#if CAN_ENABLE_STATS
+    map->mailbox_stamp_us[index] = stamp_us;
+#else
+    (void) stamp_us;
+#endif
+}
+
+/**
+ * 已确认有空闲邮箱时，新帧能否直接装入下一个空闲邮箱（TSR.CODE），调用前需处于临界区内
+ *
+ * 以下两种情况新帧需要在队列中等待，由该邮箱的发送完成回调补入：
+ * - 下一个空闲邮箱的票据尚未结束：HAL 已清除 RQCP、发送完成回调还没有执行，此时装入新帧会被该回调当作已发完；
+ * - TXFP = 0 时相同 ID 的邮箱按邮箱编号而不是装入顺序发送，下一个空闲邮箱的编号小于邮箱中同 ID 的帧时，
+ *   新帧会先于它发出（ISO-TP 连续帧等依赖提交顺序）。
+ * 所有邮箱的票据都已结束时不访问寄存器
+ */
+bool mailbox_accepts(CAN_HandleTypeDef* hcan, const CAN_CallbackMap* map, const uint32_t key)
+{
+    if (map == nullptr)
+        return true;
+    bool tracked = false;
+    for (const CAN_TxTicket t : map->mailbox_tickets)
+        tracked = tracked || t != CAN_TX_TICKET_INVALID;
+    if (!tracked)
+        return true;
+
+    const uint32_t next = (hcan->Instance->TSR & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    if (map->mailbox_tickets[next] != CAN_TX_TICKET_INVALID)
+        return false;
+    for (size_t i = next + 1; i < 3; i++)
+        if (map->mailbox_tickets[i] != CAN_TX_TICKET_INVALID && map->mailbox_keys[i] == key)
+            return false;
+    return true;
+}
+
+/**
+ * 取出已结束发送的邮箱的票据，记录发出的帧并统计发送延迟，调用前需处于临界区内
+ * @param index 邮箱下标
+ * @param status 发送结果；因被新值覆盖而中止的帧改为 CAN_TX_STATUS_REPLACED
+ * @return 邮箱中帧的票据
+ */
+CAN_TxTicket take_mailbox(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map, const size_t index, CAN_TxStatus* status)
+{
+    const CAN_TxTicket ticket   = map->mailbox_tickets[index];
+    map->mailbox_tickets[index] = CAN_TX_TICKET_INVALID;
+    // 因被新值覆盖而请求中止、且最终没有发出的帧
+    if (*status == CAN_TX_STATUS_ABORTED && map->mailbox_replaced[index])
+        *status = CAN_TX_STATUS_REPLACED;
+    map->mailbox_replaced[index] = false;
+
+#if CAN_ENABLE_RECORDER || CAN_ENABLE_BUS_LOAD
+    // 邮箱随后会被重新装入，先读回刚发出的帧；被中止或失败的帧没有占满总线，不计入负载
+    if (*status == CAN_TX_STATUS_SENT)
+    {
+        CAN_TxHeaderTypeDef header{};
+        uint8_t             data[8];
+        hw_get_tx(hcan, index, &header, data);
+        CAN_BUS_LOAD_ADD(map, &header);
+#    if CAN_ENABLE_RECORDER
+        record_frame(map, &header, data, true, time_now_us());
+#    endif
+    }
+#else
+    (void) hcan;
+#endif
+
+#if CAN_ENABLE_STATS
+    if (*status == CAN_TX_STATUS_SENT)
+    {
+        const uint32_t latency_us = tx_stamp_us() - map->mailbox_stamp_us[index];
+        CAN_STAT_MAX(map, tx_latency_us_max, latency_us);
+        map->stats.tx_latency_us_total += latency_us;
+        map->stats.tx_latency_count++;
+    }
+#endif
+    return ticket;
+}
+
+/**
+ * 结束已经发完、但发送完成中断还没有处理的邮箱，调用前需处于临界区内
+ *
+ * 中断被 CAN_Guard / isr_lock 屏蔽时邮箱可能已空出而票据还没有结束，直接装入新帧会覆盖旧票据，
+ * 随后的完成中断又会把旧帧的结果记到新帧上。RQCP 仍置位的邮箱在这里按 TXOK 结束并清除 RQCP，
+ * 完成中断随后不会再处理它
+ * @param reaped 输出结束的票据与状态，由调用方在补满邮箱后通知
+ * @return 结束的邮箱数
+ */
+size_t reap_mailboxes(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map, CAN_TxStatusRecord reaped[3])
+{
+    bool tracked = false;
+    for (const CAN_TxTicket t : map->mailbox_tickets)
+        tracked = tracked || t != CAN_TX_TICKET_INVALID;
+    if (!tracked)
+        return 0;
+
+    const uint32_t tsr   = hcan->Instance->TSR;
+    size_t         count = 0;
+    for (size_t i = 0; i < 3; i++)
+    {
+        const uint32_t shift = 8 * i;
+        if (map->mailbox_tickets[i] == CAN_TX_TICKET_INVALID || (tsr & (CAN_TSR_RQCP0 << shift)) == 0)
+            continue;
+        // 直接写 1 清除本邮箱的 RQCP（连同 TXOK / ALST / TERR），不影响其他邮箱
+        hcan->Instance->TSR = CAN_TSR_RQCP0 << shift;
+        CAN_TxStatus status = (tsr & (CAN_TSR_TXOK0 << shift)) != 0 ? CAN_TX_STATUS_SENT : CAN_TX_STATUS_ABORTED;
+        const CAN_TxTicket ticket = take_mailbox(hcan, map, i, &status);
+        reaped[count++]           = { ticket, status };
+    }
+    return count;
+}
+
+/**
+ * 把一帧直接装入空闲邮箱，调用前需确认有空闲邮箱并处于临界区内
+ * @return mailbox
+ */
+uint32_t add_tx_message(CAN_HandleTypeDef*         hcan,
+                        CAN_CallbackMap*           map,
+                        const CAN_TxHeaderTypeDef* header,
+                        const uint8_t              data[],
+                        const CAN_TxTicket         ticket,
+                        const bool                 latest = false)
+{
+    uint32_t mailbox = CAN_SEND_FAILED;
+    if (!hw_add_tx(hcan, header, data, &mailbox))
+    {
+        // TODO: 这里理应有更好的办法，而不是直接进入死循环
+        Error_Handler();
+    }
+    if (map != nullptr)
+    {
+        track_mailbox(map, mailbox, header, ticket, latest, tx_stamp_us());
+        CAN_STAT_INC(map, tx_direct);
+    }
+    return mailbox;
+}
+
+/**
+ * 把一帧放入软件发送队列，调用前需处于临界区内；队列满时按 tx_drop_policy 处理
+ * @return 新帧是否入队
+ */
+bool queue_tx_message(CAN_CallbackMap*           map,
+                      const CAN_TxHeaderTypeDef* header,
+                      const uint8_t              data[],
+                      const CAN_TxTicket         ticket,
+                      const bool                 latest)
+{
+    CAN_TxTicket evicted = CAN_TX_TICKET_INVALID;
+    const auto   result  = map->tx_queue.push(header, data, map->tx_drop_policy, ticket, latest, &evicted, tx_stamp_us());
+    if (result == CAN_TxQueue::PushResult::Rejected)
+    {
+        CAN_STAT_INC(map, tx_dropped);
+        finish_tx(map, ticket, CAN_TX_STATUS_DROPPED);
+        return false;
+    }
+    if (result == CAN_TxQueue::PushResult::Evicted)
+    {
+        CAN_STAT_INC(map, tx_dropped);
+        finish_tx(map, evicted, CAN_TX_STATUS_DROPPED);
+    }
+    CAN_STAT_INC(map, tx_queued);
+    CAN_STAT_MAX(map, tx_queue_high_water, map->tx_queue.size());
+    return true;
+}
+
+/**
+ * 中止邮箱中同 ID、以 latest 方式发送的旧值，调用前需处于临界区内
+ *
+ * 尚未开始发送的旧帧立即以 CAN_TX_STATUS_REPLACED 结束；正在发送的旧帧无法中止，
+ * 发送成功时照常以 SENT 结束，失败时在中止回调中以 REPLACED 结束
+ * @return 是否已中止邮箱中的旧帧
+ */
+bool replace_mailbox_latest(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map, const CAN_TxHeaderTypeDef* header)
+{
+    const uint32_t key = arbitration_key(header);
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (map->mailbox_tickets[i] == CAN_TX_TICKET_INVALID || !map->mailbox_latest[i] ||
+            map->mailbox_replaced[i] || map->mailbox_keys[i] != key)
+            continue;
+
+        if (!hw_abort_mailbox(hcan, i))
+        {
+            map->mailbox_replaced[i] = true;
+            return false;
+        }
+        const CAN_TxTicket replaced = map->mailbox_tickets[i];
+        map->mailbox_tickets[i]     = CAN_TX_TICKET_INVALID;
+        finish_tx(map, replaced, CAN_TX_STATUS_REPLACED);
+        return true;
+    }
+    return false;
+}
+
+void refill_mailboxes(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map);
+void update_error_state(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map);
+
+/**
+ * 发送一帧：有空闲邮箱时直接装入，否则进入软件发送队列，调用前需处于临界区内
+ * @param latest 是否以“最新值”方式发送，见 CAN_SendLatest
+ * @return mailbox / CAN_SEND_QUEUED / CAN_SEND_FAILED
+ */
+uint32_t send_locked(CAN_HandleTypeDef*         hcan,
+                     CAN_CallbackMap*           map,
+                     const CAN_TxHeaderTypeDef* header,
+                     const uint8_t              data[],
+                     const CAN_TxTicket         ticket,
+                     const bool                 latest)
+{
+    if (map != nullptr)
+    {
+        // 先结束完成中断尚未处理的邮箱，并让队列中等待的帧优先装入
+        refill_mailboxes(hcan, map);
+
+        // 队列中已有同 ID 的旧值时必须覆盖它，否则旧值会在新值之后被发出
+        bool replaced_mailbox = false;
+        if (latest)
+        {
+            const CAN_TxTicket replaced = map->tx_queue.replace_latest(header, data, ticket, tx_stamp_us());
+            if (replaced != CAN_TX_TICKET_INVALID)
+            {
+                finish_tx(map, replaced, CAN_TX_STATUS_REPLACED);
+                return CAN_SEND_QUEUED;
+            }
+            // 总线繁忙时旧值可能还停在邮箱里，同样要中止，新值随后装入空出的邮箱
+            replaced_mailbox = replace_mailbox_latest(hcan, map, header);
+        }
+
+        // 覆盖旧值不增加总线上的帧数，只有新增的帧才受限速约束
+        if (!replaced_mailbox && !rate_limit_allow(map, header, ticket))
+            return CAN_SEND_FAILED;
+    }
+
+    // 直接执行发送；下一个空闲邮箱还在等待完成回调，或装入后会越过邮箱中同 ID 的帧时排队
+    if (hw_tx_free_level(hcan) > 0 && mailbox_accepts(hcan, map, arbitration_key(header)))
+        return add_tx_message(hcan, map, header, data, ticket, latest);
+    // 已满，加入队列
+    if (map != nullptr && queue_tx_message(map, header, data, ticket, latest))
+        return CAN_SEND_QUEUED;
+    return CAN_SEND_FAILED;
+}
+
+#if CAN_TX_LOCK_PRIORITY > 0
+/**
+ * 把提交队列中的帧转入发送队列，调用前需持有 tx_lock
+ */
+void drain_submissions(CAN_CallbackMap* map)
+{
+    CAN_TxSubmission submission;
+    while (map->tx_submit.pop(submission))
+        (void) send_locked(map->hcan, map, &submission.header, submission.data, submission.ticket, submission.latest);
+}
+
+bool submissions_pending()
+{
+    for (size_t i = 0; i < map_size; i++)
+        if (!maps[i].tx_submit.empty())
+            return true;
+    return false;
+}
+
+/**
+ * 尝试取得 tx_lock 并处理所有提交队列，可在任意上下文调用
+ *
+ * 取锁失败说明持有者尚未退出，它释放锁时会再次调用本函数，提交的帧不会滞留
+ */
+void flush_submissions()
+{
+    while (submissions_pending() && !tx_lock.test_and_set(std::memory_order_acquire))
+    {
+        tx_lock_depth = 1;
+        for (size_t i = 0; i < map_size; i++)
+            drain_submissions(&maps[i]);
+        tx_lock_depth = 0;
+        tx_lock.clear(std::memory_order_release);
+    }
+}
+
+/**
+ * 在高于 CAN_TX_LOCK_PRIORITY 的中断中发送：无锁提交，再尝试立即处理
+ * @return CAN_SEND_QUEUED；提交队列已满时为 CAN_SEND_FAILED
+ */
+uint32_t submit_tx_message(CAN_HandleTypeDef*         hcan,
+                           const CAN_TxHeaderTypeDef* header,
+                           const uint8_t              data[],
+                           CAN_TxTicket*              ticket,
+                           const bool                 latest)
+{
+    if (ticket != nullptr)
+        *ticket = CAN_TX_TICKET_INVALID;
+
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return CAN_SEND_FAILED;
+
+    CAN_TxSubmission submission{ *header, {}, new_ticket(map), latest };
+    memcpy(submission.data, data, header->DLC > 8 ? 8 : header->DLC);
+    if (!map->tx_submit.push(submission))
+    {
+        CAN_STAT_INC(map, tx_dropped);
+        return CAN_SEND_FAILED;
+    }
+    if (ticket != nullptr)
+        *ticket = submission.ticket;
+
+    flush_submissions();
+    return CAN_SEND_QUEUED;
+}
+#endif
+
+/**
+ * 从 ESR 读取错误状态
+ */
+CAN_ErrorState read_error_state(const CAN_HandleTypeDef* hcan)
+{
+    const uint32_t esr = hcan->Instance->ESR;
+    if (esr & CAN_ESR_BOFF)
+        return CAN_BUS_OFF;
+    if (esr & CAN_ESR_EPVF)
+        return CAN_ERROR_PASSIVE;
+    if (esr & CAN_ESR_EWGF)
+        return CAN_ERROR_WARNING;
+    return CAN_ERROR_ACTIVE;
+}
+
+/**
+ * 用软件队列中最紧急的帧填满空闲邮箱，调用前需处于临界区内
+ *
+ * 先结束已发完但完成中断尚未处理的邮箱（见 reap_mailboxes），补满邮箱后再通知它们的结果
+ */
+void refill_mailboxes(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map)
+{
+    CAN_TxStatusRecord reaped[3];
+    const size_t       reaped_count = reap_mailboxes(hcan, map, reaped);
+    for (size_t i = 0; i < reaped_count; i++)
+    {
+        // 与 complete_mailbox 相同：没有从 bus-off / error passive 恢复的中断，只能在有帧发送成功时检查
+        if (reaped[i].status == CAN_TX_STATUS_SENT && map->error_state != CAN_ERROR_ACTIVE)
+        {
+            update_error_state(hcan, map);
+            break;
+        }
+    }
+
+    // 每次都装入当前最紧急的一帧；装入后会越过邮箱中同 ID 的帧时，等该邮箱发完
+    while (!map->tx_queue.empty() && hw_tx_free_level(hcan) > 0)
+    {
+        uint32_t   mailbox = CAN_SEND_FAILED;
+        const auto msg     = map->tx_queue.top();
+        if (!mailbox_accepts(hcan, map, arbitration_key(&msg->header)))
+            break;
+        if (!hw_add_tx(hcan, &msg->header, msg->data, &mailbox))
+        {
+            Error_Handler();
+        }
+        track_mailbox(map,
+                      mailbox,
+                      &msg->header,
+                      map->tx_queue.top_ticket(),
+                      map->tx_queue.top_latest(),
+                      map->tx_queue.top_stamp_us());
+        map->tx_queue.pop();
+    }
+
+    for (size_t i = 0; i < reaped_count; i++)
+        finish_tx(map, reaped[i].ticket, reaped[i].status);
+}
+
+/**
+ * 进入 bus-off 时按 recovery_policy 处理待发送帧，调用前需处于临界区内
+ */
+void apply_recovery_policy(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map)
+{
+    if (map->recovery_policy == CAN_RECOVERY_REPLAY)
+        return;
+
+    const bool   keep_latest = map->recovery_policy == CAN_RECOVERY_LATEST_ONLY;
+    CAN_TxTicket removed[CAN_TX_QUEUE_SIZE + 3];
+    size_t       count =
+            map->tx_queue.remove_if([keep_latest](const bool latest, CAN_TxTicket) { return !(keep_latest && latest); },
+                                    removed);
+
+    // 邮箱中的帧在恢复后会最先发出，丢弃时一并中止
+    if (map->recovery_policy == CAN_RECOVERY_FLUSH)
+    {
+        hw_abort_tx(hcan);
+    }
+    else
+    {
+        // 只中止非 latest 的帧，空出的邮箱由队列中保留的最新值补入；
+        // 中止未能立即完成的帧由中止回调以 ABORTED 结束
+        for (size_t i = 0; i < 3; i++)
+        {
+            if (map->mailbox_tickets[i] == CAN_TX_TICKET_INVALID || map->mailbox_latest[i])
+                continue;
+            if (hw_abort_mailbox(hcan, i))
+            {
+                removed[count++]        = map->mailbox_tickets[i];
+                map->mailbox_tickets[i] = CAN_TX_TICKET_INVALID;
+            }
+        }
+        refill_mailboxes(hcan, map);
+    }
+
+    // 队列已整理完毕再通知，回调中重新发送是安全的
+    for (size_t i = 0; i < count; i++)
+    {
+        CAN_STAT_INC(map, tx_dropped);
+        finish_tx(map, removed[i], CAN_TX_STATUS_DROPPED);
+    }
+}
+
+/**
+ * 根据 ESR 更新错误状态并统计状态变化，调用前需处于临界区内
+ */
+void update_error_state(CAN_HandleTypeDef* hcan, CAN_CallbackMap* map)
+{
+    const CAN_ErrorState state = read_error_state(hcan);
+    const CAN_ErrorState prev  = map->error_state;
+    if (state == prev)
+        return;
+    map->error_state = state;
+
+    if (state == CAN_BUS_OFF)
+    {
+        map->bus_off_tick = HAL_GetTick();
+        CAN_STAT_INC(map, bus_off_events);
+        apply_recovery_policy(hcan, map);
+        return;
+    }
+
+    if (prev == CAN_BUS_OFF)
+    {
+        const uint32_t recovery_ms = HAL_GetTick() - map->bus_off_tick;
+        (void) recovery_ms;
+        CAN_STAT_INC(map, bus_off_recoveries);
+        CAN_STAT_SET(map, recovery_ms_last, recovery_ms);
+        CAN_STAT_MAX(map, recovery_ms_max, recovery_ms);
+    }
+    else if (state == CAN_ERROR_WARNING && prev < state)
+    {
+        CAN_STAT_INC(map, error_warning_events);
+    }
+    else if (state == CAN_ERROR_PASSIVE && prev < state)
+    {
+        CAN_STAT_INC(map, error_passive_events);
+    }
+}
+
+/**
+ * 一个邮箱结束发送：记录结束状态，并用队列中最紧急的帧填充空闲邮箱
+ * @param index 邮箱下标
+ * @param status CAN_TX_STATUS_SENT / CAN_TX_STATUS_ABORTED
+ */
+void complete_mailbox(CAN_HandleTypeDef* hcan, const size_t index, CAN_TxStatus status)
+{
+    const auto map = get_map(hcan);
+    if (map == nullptr)
+        return;
+
+    CAN_ISR_CYCLES_BEGIN();
+
+    // 接收回调可能在更高优先级的中断中发送，这里同样需要临界区
+    CAN_Guard guard;
+
+    // 票据已由 reap_mailboxes 结束，或邮箱已经装入了新帧：HAL 在屏蔽中断前读到的是旧的 RQCP，回调已过时
+    if (map->mailbox_tickets[index] == CAN_TX_TICKET_INVALID ||
+        (hcan->Instance->TSR & (CAN_TSR_TME0 << index)) == 0)
+    {
+        refill_mailboxes(hcan, map);
+        CAN_ISR_CYCLES_END(map);
+        return;
+    }
+
+    const CAN_TxTicket ticket = take_mailbox(hcan, map, index, &status);
+
+    // 没有从 bus-off / error passive 恢复的中断，只能在有帧发送成功时检查
+    if (status == CAN_TX_STATUS_SENT && map->error_state != CAN_ERROR_ACTIVE)
+        update_error_state(hcan, map);
+
+    refill_mailboxes(hcan, map);
+
+    // 先补满邮箱再通知，回调中发送的下一帧不会越过队列中已在等待的帧
+    finish_tx(map, ticket, status);
+
+    CAN_ISR_CYCLES_END(map);
+}
+
+#if CAN_ENABLE_RX_LATEST
+/**
+ * 最新值缓存的按 ID 回调，ctx 为 CAN_LatestSlot
+ */
+void latest_store(const CAN_HandleTypeDef* /*hcan*/,
+                  const CAN_RxHeaderTypeDef* header,
+                  const uint8_t*             data,
+                  void*                      ctx)
+{
+    static_cast<CAN_LatestSlot*>(ctx)->write(header, data, frame_time_us(header));
+}
+#endif
+
+#if CAN_ENABLE_RX_WORKER
+void rx_worker_entry(void* /*argument*/)
+{
+    while (true)
+    {
+        (void) osThreadFlagsWait(CAN_RX_WORKER_FLAG, osFlagsWaitAny, osWaitForever);
+        for (size_t i = 0; i < map_size; i++)
+            CAN_Poll(maps[i].hcan, 0);
+    }
+}
+#endif
+} // namespace
+
+/**
+ * 发送一条 CAN 消息
+ *
+ * 有空闲邮箱时直接装入邮箱，否则按仲裁优先级进入软件发送队列，
+ * 邮箱空出时总是先发送队列中 ID 最小的帧
+ * @param hcan can handle
+ * @param header CAN_TxHeaderTypeDef
+ * @param data 数据
+ * @param ticket 可为 nullptr；否则写入该帧的发送票据，可用于 CAN_GetTxStatus 查询，
+ *               未调用 CAN_InitMainCallback 时为 CAN_TX_TICKET_INVALID
+ * @note 本函数是线程安全的，可在任意优先级的中断中调用。CAN_TX_LOCK_PRIORITY 非 0 时，
+ *       在优先级高于 CAN 的中断中调用不会等待临界区：帧经无锁提交队列转交，总是返回 CAN_SEND_QUEUED
+ *       （提交队列已满时返回 CAN_SEND_FAILED），发送结果通过票据查询
+ * @return mailbox；CAN_SEND_QUEUED 表示已进入软件发送队列；CAN_SEND_FAILED 表示发送失败
+ */
+uint32_t CAN_SendMessage(CAN_HandleTypeDef*         hcan,
+                         const CAN_TxHeaderTypeDef* header,
+                         const uint8_t              data[],
+                         CAN_TxTicket*              ticket)
+{
+#if CAN_TX_LOCK_PRIORITY > 0
+    if (above_tx_lock_priority())
+        return submit_tx_message(hcan, header, data, ticket, false);
+#endif
+
+    // 屏蔽 CAN 及更低优先级的中断，同时也无法进行任务调度. 裸机与 RTOS 都适用
+    CAN_Guard          guard;
+    CAN_CallbackMap*   map = get_map(hcan);
+    const CAN_TxTicket t   = map != nullptr ? new_ticket(map) : CAN_TX_TICKET_INVALID;
+    if (ticket != nullptr)
+        *ticket = t;
+
+    return send_locked(hcan, map, header, data, t, false);
+}
+
+/**
+ * 批量发送 CAN 消息
+ *
+ * 整批只进入一次临界区：先按顺序装满所有空闲邮箱，其余帧进入软件发送队列。
+ * 控制周期内需要连续发送多帧时，比逐帧调用 CAN_SendMessage 关中断的次数和总时长都更少
+ * @param hcan can handle
+ * @param msgs 待发送的消息数组
+ * @param count 消息数量
+ * @param mailboxes 可为 nullptr；否则逐帧写入与 CAN_SendMessage 相同含义的返回值
+ * @param tickets 可为 nullptr；否则逐帧写入发送票据
+ * @note 本函数是线程安全的；在优先级高于 CAN_TX_LOCK_PRIORITY 的中断中调用时逐帧提交，见 CAN_SendMessage
+ * @return 成功装入邮箱或进入队列的帧数
+ */
+size_t CAN_SendBatch(CAN_HandleTypeDef*    hcan,
+                     const CAN_MessageDef* msgs,
+                     const size_t          count,
+                     uint32_t*             mailboxes,
+                     CAN_TxTicket*         tickets)
+{
+    assert(msgs != nullptr || count == 0);
+
+    size_t accepted = 0;
+
+#if CAN_TX_LOCK_PRIORITY > 0
+    if (above_tx_lock_priority())
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            CAN_TxTicket   ticket  = CAN_TX_TICKET_INVALID;
+            const uint32_t mailbox = submit_tx_message(hcan, &msgs[i].header, msgs[i].data, &ticket, false);
+            if (mailbox != CAN_SEND_FAILED)
+                accepted++;
+            if (mailboxes != nullptr)
+                mailboxes[i] = mailbox;
+            if (tickets != nullptr)
+                tickets[i] = ticket;
+        }
+        return accepted;
+    }
+#endif
+
+    CAN_Guard        guard;
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map != nullptr)
+        refill_mailboxes(hcan, map);
+    // 空闲邮箱数只查询一次，之后本地递减
+    uint32_t free_level = hw_tx_free_level(hcan);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t           mailbox = CAN_SEND_FAILED;
+        const CAN_TxTicket ticket  = map != nullptr ? new_ticket(map) : CAN_TX_TICKET_INVALID;
+        if (map != nullptr && !rate_limit_allow(map, &msgs[i].header, ticket))
+        {
+            // 被限速，不占用邮箱
+        }
+        else if (free_level > 0 && mailbox_accepts(hcan, map, arbitration_key(&msgs[i].header)))
+        {
+            mailbox = add_tx_message(hcan, map, &msgs[i].header, msgs[i].data, ticket);
+            free_level--;
+            accepted++;
+        }
+        else if (map != nullptr && queue_tx_message(map, &msgs[i].header, msgs[i].data, ticket, false))
+        {
+            mailbox = CAN_SEND_QUEUED;
+            accepted++;
+        }
+        if (mailboxes != nullptr)
+            mailboxes[i] = mailbox;
+        if (tickets != nullptr)
+            tickets[i] = ticket;
+    }
+    return accepted;
+}
+
+/**
+ * 以“最新值”方式发送一条 CAN 消息
+ *
+ * 适用于周期性的设定值帧（如电机电流指令）：每条 CAN 上每个 ID 最多只有一帧在等待发送，
+ * 新帧直接覆盖尚未发出的旧帧，而不是再次排队。旧帧在软件队列中时原位覆盖；已装入硬件邮箱但尚未
+ * 开始发送时中止该邮箱，新帧重新装入。总线过载时不会积压过期指令，也不会因为队列被旧指令占满而丢掉新指令
+ * @param hcan can handle
+ * @param header CAN_TxHeaderTypeDef
+ * @param data 数据
+ * @param ticket 可为 nullptr；否则写入新帧的发送票据，被覆盖的旧帧以 CAN_TX_STATUS_REPLACED 结束
+ * @note 本函数是线程安全的，在高优先级中断中的行为与 CAN_SendMessage 相同；正在总线上发送的旧帧无法中止，
+ *       会先于新帧发出
+ * @note 同一 ID 请不要混用 CAN_SendMessage 与本函数，前者入队的帧不会被覆盖
+ * @return mailbox；CAN_SEND_QUEUED 表示已入队或已覆盖队列中的旧值；CAN_SEND_FAILED 表示发送失败
+ */
+uint32_t CAN_SendLatest(CAN_HandleTypeDef*         hcan,
+                        const CAN_TxHeaderTypeDef* header,
+                        const uint8_t              data[],
+                        CAN_TxTicket*              ticket)
+{
+#if CAN_TX_LOCK_PRIORITY > 0
+    if (above_tx_lock_priority())
+        return submit_tx_message(hcan, header, data, ticket, true);
+#endif
+
+    CAN_Guard          guard;
+    CAN_CallbackMap*   map = get_map(hcan);
+    const CAN_TxTicket t   = map != nullptr ? new_ticket(map) : CAN_TX_TICKET_INVALID;
+    if (ticket != nullptr)
+        *ticket = t;
+
+    return send_locked(hcan, map, header, data, t, true);
+}
+
+/**
+ * 为一段 ID 设置发送限速
+ *
+ * 令牌桶限速：平均不超过 frames_per_second 帧 / s，允许连续突发 burst 帧。
+ * 超出限速的帧直接拒绝（返回 CAN_SEND_FAILED，状态为 CAN_TX_STATUS_RATE_LIMITED），
+ * 不进入发送队列，因此遥测等低优先级流量不会挤占控制帧的邮箱与队列。
+ * 一帧按设置顺序匹配第一条规则，未匹配任何规则的帧不受限制
+ * @attention 本函数非线程安全，请在开始发送前完成设置
+ * @param hcan can handle
+ * @param ide CAN_ID_STD / CAN_ID_EXT
+ * @param id_low ID 下限（含）
+ * @param id_high ID 上限（含）
+ * @param frames_per_second 平均速率，单位 帧 / s
+ * @param burst 最大突发帧数，至少为 1
+ * @return 规则表已满或参数无效时返回 false
+ */
+bool CAN_SetRateLimit(CAN_HandleTypeDef* hcan,
+                      const uint32_t     ide,
+                      const uint32_t     id_low,
+                      const uint32_t     id_high,
+                      const uint32_t     frames_per_second,
+                      const uint32_t     burst)
+{
+    if (id_low > id_high || burst == 0 || burst > UINT32_MAX / 1000)
+        return false;
+
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr || map->rate_limit_count >= CAN_MAX_RATE_LIMIT_NUM)
+        return false;
+
+    // 初始时令牌桶是满的
+    map->rate_limits[map->rate_limit_count++] = { ide,
+                                                  id_low,
+                                                  id_high,
+                                                  frames_per_second,
+                                                  burst * 1000,
+                                                  burst * 1000,
+                                                  HAL_GetTick() };
+    return true;
+}
+
+#if CAN_ENABLE_RX_TIMESTAMP
+/**
+ * 获取接收帧的到达时间
+ *
+ * 开启时间触发模式（hcan->Init.TimeTriggeredMode）时由硬件在 SOF 锁存的时间戳换算而来，
+ * 否则为接收中断的进入时刻，二者都与 CAN_GetTimeUs 为同一时基
+ * @param header 接收回调收到的 header（或 CAN_RetainFrame 保留的帧的 header），不能是自行拷贝的帧头
+ * @return 到达时间，单位微秒
+ */
+uint64_t CAN_GetRxTimestamp(const CAN_RxHeaderTypeDef* header)
+{
+    // 驱动交给回调的 header 总是 CAN_RxFrame 的第一个成员（帧池槽位或帧池耗尽时的栈上临时帧）
+    return reinterpret_cast<const CAN_RxFrame*>(header)->timestamp_us;
+}
+
+/**
+ * 获取当前时间，与接收时间戳为同一时基
+ *
+ * 用当前时间减去帧的时间戳即可得到该帧从到达至今的延迟，用于滤波器的延迟补偿
+ * @return 单调递增的时间，单位微秒
+ * @note 本函数是线程安全的，可在任意优先级的中断中调用
+ */
+uint64_t CAN_GetTimeUs()
+{
+    return time_base.now_us();
+}
+
+/**
+ * 把接收时间戳换算到 HAL_GetTick 时基
+ *
+ * RTOS 的 tick 与 HAL tick 不同源时，可用 CAN_GetTimeUs() - timestamp_us 得到的延迟自行换算
+ * @param timestamp_us 接收时间戳
+ * @return 该时刻对应的 HAL_GetTick 值（四舍五入到毫秒）
+ * @note 本函数是线程安全的，可在任意优先级的中断中调用
+ */
+uint32_t CAN_TimestampToTick(const uint64_t timestamp_us)
+{
+    uint32_t       tick   = 0;
+    const uint64_t now_us = time_base.now_us(&tick);
+    if (timestamp_us >= now_us)
+        return tick;
+    return tick - static_cast<uint32_t>((now_us - timestamp_us + 500U) / 1000U);
+}
+#endif
+
+#if CAN_ENABLE_RX_LATEST
+/**
+ * 为一个 ID 开启最新值缓存
+ *
+ * 之后该 ID 的每一帧都会覆盖缓存，任意线程可随时用 CAN_ReadLatest 读取最近一帧，不需要编写接收回调。
+ * 缓存借用按 ID 分发的回调实现：占用一个回调表项，并与同一 ID 的其他按 ID 回调冲突；
+ * 经 CAN_ConfigFilterRoutes 按过滤器编号分发的帧不会进入缓存
+ * @attention 本函数非线程安全，请在开始接收前完成注册
+ * @param hcan can handle
+ * @param id 标准帧或扩展帧 ID（精确匹配）
+ * @param ide CAN_ID_STD / CAN_ID_EXT
+ * @return 缓存已满、回调表已满或该 ID 已注册回调时返回 false
+ */
+bool CAN_RegisterLatest(CAN_HandleTypeDef* hcan, const uint32_t id, const uint32_t ide)
+{
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr || map->latest_count >= CAN_MAX_LATEST_NUM)
+        return false;
+
+    CAN_LatestSlot& slot = map->latest[map->latest_count];
+    slot.id              = ide == CAN_ID_STD ? id & CAN_STD_ID_MASK : id & CAN_EXT_ID_MASK;
+    slot.ide             = ide;
+    const bool ok        = ide == CAN_ID_STD ? CAN_RegisterIdCallback(hcan, slot.id, CAN_STD_ID_MASK, latest_store, &slot)
+                                             : CAN_RegisterExtIdCallback(hcan, slot.id, latest_store, &slot);
+    if (ok)
+        map->latest_count++;
+    return ok;
+}
+
+/**
+ * 读取一个 ID 最近收到的一帧
+ *
+ * 无锁读取，可在任意线程或中断中调用，得到的总是同一帧的完整快照
+ * @param hcan can handle
+ * @param id 注册时的 ID
+ * @param frame 输出
+ * @param age_us 可为 nullptr；否则写入该帧到达至今的时间，单位微秒，超过 UINT32_MAX 时饱和。
+ *               开启 CAN_ENABLE_RX_TIMESTAMP 时按接收时间戳计算，否则按分发时刻计算
+ *               （延迟接收时为 CAN_Poll 处理该帧的时刻）；没有 DWT 的芯片上精度为 1 ms
+ * @param ide CAN_ID_STD / CAN_ID_EXT
+ * @return 该 ID 未注册或尚未收到过帧时返回 false
+ */
+bool CAN_ReadLatest(const CAN_HandleTypeDef* hcan,
+                    const uint32_t           id,
+                    CAN_LatestFrame*         frame,
+                    uint32_t*                age_us,
+                    const uint32_t           ide)
+{
+    assert(frame != nullptr);
+
+    const CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return false;
+
+    for (uint32_t i = 0; i < map->latest_count; i++)
+    {
+        const CAN_LatestSlot& slot = map->latest[i];
+        if (slot.id != id || slot.ide != ide)
+            continue;
+
+        uint64_t stamp_us = 0;
+        if (!slot.read(frame, &stamp_us))
+            return false;
+        if (age_us != nullptr)
+        {
+            const uint64_t now_us = time_now_us();
+            const uint64_t age    = now_us > stamp_us ? now_us - stamp_us : 0;
+            *age_us               = age > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(age);
+        }
+        return true;
+    }
+    return false;
+}
+#endif
+
+#if CAN_ENABLE_RECORDER
+/**
+ * 启动收发记录
+ *
+ * 记录所有已注册 CAN 上分发的接收帧与成功发送的帧，连同微秒时间戳按 can_log.hpp 的格式写入双缓冲，
+ * 每写满一块调用一次 sink。日志中的总线编号为各 CAN 调用 CAN_InitMainCallback 的顺序，
+ * 主机端用 tools/can_log_tool.cpp 解码或回放
+ * @attention 本函数非线程安全，请勿与 CAN_RecorderStop 并发调用
+ * @param sink 输出回调
+ * @param ctx 用户上下文，回调时原样传回
+ */
+void CAN_RecorderStart(const CAN_RecorderSink_t sink, void* ctx)
+{
+    assert(sink != nullptr);
+    recorder.start(sink, ctx);
+}
+
+/**
+ * 停止收发记录，未写满的块通过 sink 输出（上一块尚未归还时丢弃）
+ */
+void CAN_RecorderStop()
+{
+    (void) recorder.flush();
+    recorder.stop();
+}
+
+/**
+ * 立即输出当前未写满的块，例如检测到异常时保存现场
+ * @return 当前块为空、上一块尚未归还或记录器未启动时返回 false
+ */
+bool CAN_RecorderFlush()
+{
+    return recorder.flush();
+}
+
+/**
+ * 归还 sink 收到的缓冲区
+ * @note 可在任意上下文调用，包括 DMA 传输完成中断
+ */
+void CAN_RecorderRelease()
+{
+    recorder.release();
+}
+
+/**
+ * 获取因缓冲区未及时归还而丢弃的帧数
+ */
+uint32_t CAN_RecorderGetDropped()
+{
+    return recorder.dropped();
+}
+#endif
+
+#if CAN_ENABLE_BUS_LOAD
+/**
+ * 获取总线利用率
+ *
+ * 统计本节点发送成功与收到的帧（按最坏情况的位填充估算位数），被中止或发送失败的帧不计入；
+ * 对于总线上本节点未接收的帧无法统计。
+ * 波特率在 CAN_Start 时从 BTR 读取。统计以 10 ms 为粒度，不含当前尚未结束的 10 ms
+ * @param hcan can handle
+ * @param window_ms 统计窗口，单位 ms，常用 10 / 100 / 1000，最大 1000
+ * @return 利用率，1.0 表示 100%
+ */
+float CAN_GetBusLoad(const CAN_HandleTypeDef* hcan, const uint32_t window_ms)
+{
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return 0.0f;
+    return map->bus_load.utilization(window_ms);
+}
+#endif
+
+/**
+ * 获取 CAN 控制器的错误状态
+ *
+ * 同时刷新驱动内部记录的状态：从 error passive / bus-off 恢复没有中断，调用本函数也会记录恢复事件
+ * @param hcan can handle
+ * @param tec 可为 nullptr；否则写入发送错误计数
+ * @param rec 可为 nullptr；否则写入接收错误计数
+ * @return 错误状态
+ */
+CAN_ErrorState CAN_GetErrorState(CAN_HandleTypeDef* hcan, uint8_t* tec, uint8_t* rec)
+{
+    const uint32_t esr = hcan->Instance->ESR;
+    if (tec != nullptr)
+        *tec = static_cast<uint8_t>((esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos);
+    if (rec != nullptr)
+        *rec = static_cast<uint8_t>((esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos);
+
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return read_error_state(hcan);
+
+    CAN_Guard guard;
+    update_error_state(hcan, map);
+    return map->error_state;
+}
+
+/**
+ * 设置 bus-off 恢复方式
+ *
+ * 直接修改 MCR.ABOM，同时同步 hcan->Init.AutoBusOff，之后重新初始化 CAN 时保持一致
+ * @param hcan can handle
+ * @param recovery CAN_BUS_OFF_RECOVERY_AUTO / CAN_BUS_OFF_RECOVERY_MANUAL
+ */
+void CAN_SetBusOffRecovery(CAN_HandleTypeDef* hcan, const CAN_BusOffRecovery recovery)
+{
+    if (recovery == CAN_BUS_OFF_RECOVERY_AUTO)
+    {
+        hcan->Instance->MCR |= CAN_MCR_ABOM;
+        hcan->Init.AutoBusOff = ENABLE;
+    }
+    else
+    {
+        hcan->Instance->MCR &= ~CAN_MCR_ABOM;
+        hcan->Init.AutoBusOff = DISABLE;
+    }
+}
+
+/**
+ * 设置进入 bus-off 时对待发送帧的处理策略
+ *
+ * 默认 CAN_RECOVERY_REPLAY；对周期性控制帧，建议使用 CAN_RECOVERY_LATEST_ONLY 或 CAN_RECOVERY_FLUSH，
+ * 避免恢复瞬间把过期指令集中发出
+ * @param hcan can handle
+ * @param policy 处理策略
+ */
+void CAN_SetRecoveryPolicy(CAN_HandleTypeDef* hcan, const CAN_RecoveryPolicy policy)
+{
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return;
+
+    CAN_Guard guard;
+    map->recovery_policy = policy;
+}
+
+/**
+ * 手动从 bus-off 恢复
+ *
+ * 按参考手册要求进入再退出初始化模式，之后硬件检测到 128 × 11 个隐性位即重新加入总线。
+ * 仅在 CAN_BUS_OFF_RECOVERY_MANUAL 下需要调用
+ * @attention 会阻塞等待初始化模式切换，请勿在中断中调用
+ * @param hcan can handle
+ * @return 当前不处于 bus-off 或重新启动失败时返回 false
+ */
+bool CAN_RecoverBusOff(CAN_HandleTypeDef* hcan)
+{
+    if (read_error_state(hcan) != CAN_BUS_OFF)
+        return false;
+    if (HAL_CAN_Stop(hcan) != HAL_OK)
+        return false;
+    return HAL_CAN_Start(hcan) == HAL_OK;
+}
+
+/**
+ * 查询一帧的发送状态
+ *
+ * 结束发送（SENT / ABORTED / DROPPED / REPLACED）的状态只保留最近 CAN_TX_STATUS_HISTORY_SIZE 个票据，
+ * 更早的票据返回 CAN_TX_STATUS_UNKNOWN
+ * @param hcan can handle
+ * @param ticket 发送时获得的票据
+ * @note 本函数是线程安全的，但 CAN_TX_LOCK_PRIORITY 非 0 时不能在优先级高于 CAN 的中断中调用
+ * @return 发送状态
+ */
+CAN_TxStatus CAN_GetTxStatus(const CAN_HandleTypeDef* hcan, const CAN_TxTicket ticket)
+{
+    if (ticket == CAN_TX_TICKET_INVALID)
+        return CAN_TX_STATUS_UNKNOWN;
+
+    CAN_Guard        guard;
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return CAN_TX_STATUS_UNKNOWN;
 
-namespace
-{
+    for (const CAN_TxTicket t : map->mailbox_tickets)
+        if (t == ticket)
+            return CAN_TX_STATUS_PENDING;
+    if (map->tx_queue.contains(ticket))
+        return CAN_TX_STATUS_QUEUED;
+
+    const CAN_TxStatusRecord& record = map->tx_history[ticket & (CAN_TX_STATUS_HISTORY_SIZE - 1)];
+    return record.ticket == ticket ? record.status : CAN_TX_STATUS_UNKNOWN;
+}
 
 /**
- * 储存于软件缓冲区的 CAN 消息类型
- *
- * 包括 TxHeader 和 至多 8 bytes 的数据
+ * 查询一帧是否已成功发送
+ * @param hcan can handle
+ * @param ticket 发送时获得的票据
+ * @return 已成功发送返回 true
  */
-struct CAN_MessageDef
+bool CAN_IsSent(const CAN_HandleTypeDef* hcan, const CAN_TxTicket ticket)
 {
-    CAN_TxHeaderTypeDef header;
-    uint8_t             data[8];
-};
+    return CAN_GetTxStatus(hcan, ticket) == CAN_TX_STATUS_SENT;
+}
 
 /**
- * CAN 回调函数表
- *
- * @note 由于 HAL 只允许将一个函数作为回调函数，如果想在一条总线上处理不同种类的
- *       信息（有多个不同的回调函数），就必须要通过一个主回调函数进行分发
+ * 设置帧发送结束回调
  *
- * @note STM32 的 CAN mailbox 数量往往有限，但是在很短的时间内可能连续发送多条消息
- *       自带的 mailbox 无法满足要求，故需要做一个软件缓冲区来临时储存溢出的消息
+ * 回调在帧成功发送、被中止、被丢弃或被覆盖时调用，可用于测量实际发送延迟或做发送背压
+ * @param hcan can handle
+ * @param callback 回调函数，nullptr 表示取消
+ * @param ctx 用户上下文，回调时原样传回
  */
-struct CAN_CallbackMap
+void CAN_SetTxCompleteCallback(CAN_HandleTypeDef* hcan, const CAN_TxCompleteCallback_t callback, void* ctx)
 {
-    CAN_HandleTypeDef*        hcan{ nullptr };
-    CAN_FifoReceiveCallback_t callbacks[CAN_MAX_CALLBACK_NUM]{};
-    uint32_t                  callback_count{ 0 };
-    // 使用环形缓冲区实现发送队列，队列长度 CAN_TX_QUEUE_SIZE，Overwrite=true
-    // 当队列满时会丢弃最早的帧
-    libs::RingBuffer<CAN_MessageDef, CAN_TX_QUEUE_SIZE, true> buffer;
-};
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return;
 
-// 根据 CAN 实例的数量定义回调表
-// CAN 实例的数量取决于芯片型号，且无法在编译器预知，故在 .hpp 内通过宏定义
-CAN_CallbackMap maps[CAN_NUM];
-size_t          map_size = 0;
+    CAN_Guard guard;
+    map->tx_complete_callback = callback;
+    map->tx_complete_ctx      = ctx;
+}
 
-// 根据 can handle 的指针查找 can map
-CAN_CallbackMap* get_map(const CAN_HandleTypeDef* hcan)
+/**
+ * 获取当前的帧发送结束回调，用于在接管回调时保留原有的回调
+ * @param hcan can handle
+ * @param callback 写入回调函数，未设置时为 nullptr
+ * @param ctx 写入用户上下文
+ */
+void CAN_GetTxCompleteCallback(const CAN_HandleTypeDef* hcan, CAN_TxCompleteCallback_t* callback, void** ctx)
 {
-    for (size_t i = 0; i < map_size; i++)
-        if (maps[i].hcan == hcan)
-            return &maps[i];
+    *callback = nullptr;
+    *ctx      = nullptr;
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return;
 
-    return nullptr;
+    CAN_Guard guard;
+    *callback = map->tx_complete_callback;
+    *ctx      = map->tx_complete_ctx;
 }
-} // namespace
 
 /**
- * 发送一条 CAN 消息
+ * 设置发送队列已满时的处理策略
+ *
  * @param hcan can handle
- * @param header CAN_TxHeaderTypeDef
- * @param data 数据
- * @note 本函数是线程安全的
- * @return mailbox, 0xFFFF 表示发送失败
+ * @param policy CAN_TX_DROP_LOWEST_PRIORITY（默认）/ CAN_TX_REJECT_NEW
  */
-uint32_t CAN_SendMessage(CAN_HandleTypeDef*         hcan,
-                         const CAN_TxHeaderTypeDef* header,
-                         const uint8_t              data[])
+void CAN_SetTxDropPolicy(CAN_HandleTypeDef* hcan, const CAN_TxDropPolicy policy)
 {
-    // 储存发送该条消息使用的 CAN mailbox
-    uint32_t mailbox = CAN_SEND_FAILED;
-
-    // 直接锁定中断，这里锁定了中断就无法进行任务调度. 裸机与 RTOS 都适用
-    ISRGuard guard;
-    if (HAL_CAN_GetTxMailboxesFreeLevel(hcan) > 0)
-    {
-        // 直接执行发送
-        if (HAL_CAN_AddTxMessage(hcan, header, data, &mailbox) != HAL_OK)
-        {
-            // TODO: 这里理应有更好的办法，而不是直接进入死循环
-            Error_Handler();
-        }
-    }
-    else
+    if (CAN_CallbackMap* map = get_or_create_map(hcan); map != nullptr)
     {
-        // TODO: fix bug: 当总线未注册回调函数，但连续发送进入该分支时出现 UB
-        // 已满，加入队列
-        get_map(hcan)->buffer.push(
-                // 这里通过构造工厂函数的方式来避免额外值拷贝
-                [&](CAN_MessageDef& msg)
-                {
-                    assert(header->DLC <= 8);
-
-                    msg.header = *header;
-                    // 分两次 memcpy 保证 data 的数据都有效
-                    memcpy(msg.data, data, header->DLC);
-                    memset(msg.data + header->DLC, 0, 8 - header->DLC);
-                });
+        CAN_Guard guard;
+        map->tx_drop_policy = policy;
     }
-    // 返回邮箱
-    // TODO: 修复在邮箱已满后加入队列发送的 bug
-    return mailbox;
 }
 
 /**
@@ -139,10 +2966,170 @@ void CAN_Start(CAN_HandleTypeDef* hcan, const uint32_t ActiveITs)
 
     // 开启 CAN 中断
     // 使用 FIFO0 / FIFO1 由用户决定；发送队列实现依赖 TX 中断，所以必须开启
-    if (HAL_CAN_ActivateNotification(hcan, ActiveITs | CAN_IT_TX_MAILBOX_EMPTY) != HAL_OK)
+    uint32_t its = ActiveITs | CAN_IT_TX_MAILBOX_EMPTY;
+    // 错误状态跟踪需要错误中断；不开启 LEC 中断，避免噪声较大的总线上中断过于频繁
+    its |= CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF | CAN_IT_ERROR;
+#if CAN_ENABLE_STATS
+    if (ActiveITs & CAN_IT_RX_FIFO0_MSG_PENDING)
+        its |= CAN_IT_RX_FIFO0_OVERRUN;
+    if (ActiveITs & CAN_IT_RX_FIFO1_MSG_PENDING)
+        its |= CAN_IT_RX_FIFO1_OVERRUN;
+#endif
+    if (HAL_CAN_ActivateNotification(hcan, its) != HAL_OK)
     {
         Error_Handler();
     }
+
+#if CAN_ENABLE_BUS_LOAD || CAN_ENABLE_RX_TIMESTAMP
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map != nullptr)
+    {
+#    if CAN_ENABLE_BUS_LOAD
+        map->bus_load.set_bitrate(can_bitrate(hcan));
+#    endif
+#    if CAN_ENABLE_RX_TIMESTAMP
+        map->ttcm.set_bitrate(can_bitrate(hcan));
+#    endif
+    }
+#endif
+
+#if (CAN_ENABLE_STATS || CAN_TIME_BASE_ENABLED) && defined(DWT_CTRL_CYCCNTENA_Msk)
+    // 打开 DWT CYCCNT 用于统计中断耗时与微秒时基
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+#if CAN_ENABLE_STATS
+/**
+ * 获取 CAN 统计信息快照
+ *
+ * 各计数器分别原子读取，彼此之间不保证严格同一时刻
+ * @param hcan can handle
+ * @param stats 输出
+ * @return 该 CAN 是否已注册
+ */
+bool CAN_GetStats(const CAN_HandleTypeDef* hcan, CAN_Stats* stats)
+{
+    assert(stats != nullptr);
+
+    const CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return false;
+
+    const CAN_StatsCounters& c = map->stats;
+    stats->tx_direct           = c.tx_direct.load(std::memory_order_relaxed);
+    stats->tx_queued           = c.tx_queued.load(std::memory_order_relaxed);
+    stats->tx_dropped          = c.tx_dropped.load(std::memory_order_relaxed);
+    stats->tx_queue_high_water = c.tx_queue_high_water.load(std::memory_order_relaxed);
+    stats->tx_rate_limited     = c.tx_rate_limited.load(std::memory_order_relaxed);
+    stats->tx_latency_us_max   = c.tx_latency_us_max.load(std::memory_order_relaxed);
+    {
+        CAN_Guard guard;
+        stats->tx_latency_us_avg =
+                c.tx_latency_count == 0 ? 0 : static_cast<uint32_t>(c.tx_latency_us_total / c.tx_latency_count);
+    }
+    for (size_t i = 0; i < 2; i++)
+    {
+        stats->rx_fifo[i]    = c.rx_fifo[i].load(std::memory_order_relaxed);
+        stats->rx_overrun[i] = c.rx_overrun[i].load(std::memory_order_relaxed);
+    }
+    stats->rx_pool_empty = c.rx_pool_empty.load(std::memory_order_relaxed);
+#    if CAN_ENABLE_RX_DEFERRED
+    stats->rx_dropped = map->rx_dropped.load(std::memory_order_relaxed);
+#    else
+    stats->rx_dropped = 0;
+#    endif
+    stats->error_events   = c.error_events.load(std::memory_order_relaxed);
+    stats->error_warning_events = c.error_warning_events.load(std::memory_order_relaxed);
+    stats->error_passive_events = c.error_passive_events.load(std::memory_order_relaxed);
+    stats->bus_off_events       = c.bus_off_events.load(std::memory_order_relaxed);
+    stats->bus_off_recoveries   = c.bus_off_recoveries.load(std::memory_order_relaxed);
+    stats->recovery_ms_last     = c.recovery_ms_last.load(std::memory_order_relaxed);
+    stats->recovery_ms_max      = c.recovery_ms_max.load(std::memory_order_relaxed);
+    stats->isr_max_cycles = c.isr_max_cycles.load(std::memory_order_relaxed);
+#    if defined(DWT_CTRL_CYCCNTENA_Msk)
+    stats->lock_max_cycles = lock_max_cycles.load(std::memory_order_relaxed);
+#    else
+    stats->lock_max_cycles = 0;
+#    endif
+    return true;
+}
+
+/**
+ * 清零 CAN 统计信息
+ * @param hcan can handle
+ */
+void CAN_ResetStats(const CAN_HandleTypeDef* hcan)
+{
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return;
+
+    CAN_StatsCounters& c = map->stats;
+    c.tx_direct.store(0, std::memory_order_relaxed);
+    c.tx_queued.store(0, std::memory_order_relaxed);
+    c.tx_dropped.store(0, std::memory_order_relaxed);
+    c.tx_queue_high_water.store(0, std::memory_order_relaxed);
+    c.tx_rate_limited.store(0, std::memory_order_relaxed);
+    c.tx_latency_us_max.store(0, std::memory_order_relaxed);
+    {
+        CAN_Guard guard;
+        c.tx_latency_us_total = 0;
+        c.tx_latency_count    = 0;
+    }
+    for (size_t i = 0; i < 2; i++)
+    {
+        c.rx_fifo[i].store(0, std::memory_order_relaxed);
+        c.rx_overrun[i].store(0, std::memory_order_relaxed);
+    }
+    c.rx_pool_empty.store(0, std::memory_order_relaxed);
+    c.error_events.store(0, std::memory_order_relaxed);
+    c.error_warning_events.store(0, std::memory_order_relaxed);
+    c.error_passive_events.store(0, std::memory_order_relaxed);
+    c.bus_off_events.store(0, std::memory_order_relaxed);
+    c.bus_off_recoveries.store(0, std::memory_order_relaxed);
+    c.recovery_ms_last.store(0, std::memory_order_relaxed);
+    c.recovery_ms_max.store(0, std::memory_order_relaxed);
+    c.isr_max_cycles.store(0, std::memory_order_relaxed);
+#    if defined(DWT_CTRL_CYCCNTENA_Msk)
+    lock_max_cycles.store(0, std::memory_order_relaxed);
+#    endif
+}
+#endif
+
+/**
+ * HAL CAN 错误中断回调
+ *
+ * 跟踪错误状态，统计错误，并结束因仲裁丢失 / 发送错误而失败的邮箱（只在关闭自动重传时出现）
+ * @param hcan can handle
+ */
+void CAN_ErrorCallback(CAN_HandleTypeDef* hcan)
+{
+    const uint32_t error = HAL_CAN_GetError(hcan);
+    (void) HAL_CAN_ResetError(hcan);
+
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return;
+
+    CAN_STAT_INC(map, error_events);
+    if (error & (HAL_CAN_ERROR_EWG | HAL_CAN_ERROR_EPV | HAL_CAN_ERROR_BOF))
+    {
+        CAN_Guard guard;
+        update_error_state(hcan, map);
+    }
+    if (error & HAL_CAN_ERROR_RX_FOV0)
+        CAN_STAT_INC(map, rx_overrun[0]);
+    if (error & HAL_CAN_ERROR_RX_FOV1)
+        CAN_STAT_INC(map, rx_overrun[1]);
+
+    constexpr uint32_t tx_errors[3] = { HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_TERR0,
+                                        HAL_CAN_ERROR_TX_ALST1 | HAL_CAN_ERROR_TX_TERR1,
+                                        HAL_CAN_ERROR_TX_ALST2 | HAL_CAN_ERROR_TX_TERR2 };
+    for (size_t i = 0; i < 3; i++)
+        if (error & tx_errors[i])
+            complete_mailbox(hcan, i, CAN_TX_STATUS_ABORTED);
 }
 
 /**
@@ -154,22 +3141,11 @@ void CAN_Start(CAN_HandleTypeDef* hcan, const uint32_t ActiveITs)
  */
 void CAN_RegisterCallback(CAN_HandleTypeDef* hcan, const CAN_FifoReceiveCallback_t callback)
 {
-    // 查找回调函数表
-    CAN_CallbackMap* map = get_map(hcan);
-
+    // 查找回调函数表，如果表未创建则新建一个
+    CAN_CallbackMap* map = get_or_create_map(hcan);
     if (map == nullptr)
-    {
-        if (map_size >= CAN_NUM)
-        {
-            // 仅当 CAN_NUM 配置错误时可能触发，此时进入死循环
-            Error_Handler();
-            return;
-        }
-        // 如果表未创建则新建一个
-        maps[map_size] = (CAN_CallbackMap){ .hcan = hcan, .callbacks = {}, .callback_count = 0 };
-        map            = &maps[map_size];
-        map_size++;
-    }
+        return;
+
     // 如果回调函数表未满，则将回调函数注册到末尾
     if (map->callback_count < CAN_MAX_CALLBACK_NUM)
         map->callbacks[map->callback_count++] = callback;
@@ -177,6 +3153,93 @@ void CAN_RegisterCallback(CAN_HandleTypeDef* hcan, const CAN_FifoReceiveCallback
         Error_Handler();
 }
 
+/**
+ * 按标准帧 ID 注册 CAN Fifo 处理回调
+ *
+ * 所有满足 (StdId & mask) == (id & mask) 的标准帧都会分发到该回调，
+ * 分发时直接查表，不会调用其他 ID 的回调
+ *
+ * @attention 本函数非线程安全，调用时请注意
+ * @note 每个标准帧 ID 只能对应一个回调；mask 越宽，注册时展开的 ID 越多
+ * @param hcan can handle
+ * @param id 标准帧 ID
+ * @param mask ID 掩码，0x7FF 表示精确匹配
+ * @param callback 回调函数指针
+ * @param ctx 用户上下文，回调时原样传回
+ * @return 是否注册成功；回调表已满或与已注册的 ID 冲突时返回 false
+ */
+bool CAN_RegisterIdCallback(CAN_HandleTypeDef*     hcan,
+                            const uint32_t         id,
+                            uint32_t               mask,
+                            const CAN_IdCallback_t callback,
+                            void*                  ctx)
+{
+    assert(callback != nullptr);
+
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return false;
+
+    mask &= CAN_STD_ID_MASK;
+    const uint32_t match = id & mask;
+
+    // 先检查冲突，再写表，避免注册失败时留下一半的表项
+    for (uint32_t i = 0; i < CAN_STD_ID_NUM; i++)
+        if ((i & mask) == match && map->std_id_table[i] != 0)
+            return false;
+
+    const uint8_t handler = add_id_handler(map, callback, ctx);
+    if (handler == 0)
+        return false;
+
+    for (uint32_t i = 0; i < CAN_STD_ID_NUM; i++)
+        if ((i & mask) == match)
+            map->std_id_table[i] = handler;
+    return true;
+}
+
+/**
+ * 按扩展帧 ID 注册 CAN Fifo 处理回调（精确匹配）
+ *
+ * @attention 本函数非线程安全，调用时请注意
+ * @param hcan can handle
+ * @param ext_id 扩展帧 ID
+ * @param callback 回调函数指针
+ * @param ctx 用户上下文，回调时原样传回
+ * @return 是否注册成功；回调表或哈希表已满、ID 已注册时返回 false
+ */
+bool CAN_RegisterExtIdCallback(CAN_HandleTypeDef*     hcan,
+                               uint32_t               ext_id,
+                               const CAN_IdCallback_t callback,
+                               void*                  ctx)
+{
+    assert(callback != nullptr);
+
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return false;
+
+    ext_id &= CAN_EXT_ID_MASK;
+    for (uint32_t i = 0, h = ext_id_hash(ext_id); i < CAN_EXT_ID_TABLE_SIZE;
+         i++, h = (h + 1) & (CAN_EXT_ID_TABLE_SIZE - 1))
+    {
+        CAN_ExtIdSlot& slot = map->ext_id_table[h];
+        if (slot.handler != 0)
+        {
+            if (slot.id == ext_id)
+                return false;
+            continue;
+        }
+        const uint8_t handler = add_id_handler(map, callback, ctx);
+        if (handler == 0)
+            return false;
+        slot = { ext_id, handler };
+        return true;
+    }
+    // 哈希表已满
+    return false;
+}
+
 // 由于一般不会取消注册，不提供取消注册功能
 // 后人可以实现
 /**
@@ -194,79 +3257,259 @@ void CAN_RegisterCallback(CAN_HandleTypeDef* hcan, const CAN_FifoReceiveCallback
 // }
 
 /**
- * CAN Fifo0 接收处理函数
+ * 根据路由表配置硬件过滤器，并按过滤器编号（FMI）分发
  *
- * 本函数将会根据 hcan 和 rx_header 内部的 filter_id 来调用对应的回调函数
+ * 从 start_bank 开始依次占用过滤器组：相邻的两项同 FIFO 精确匹配合并为一个 list 模式组，
+ * 其余每项占用一个 mask 模式组。未命中任何过滤器的帧由硬件直接丢弃，不会进入中断；
+ * 命中的帧在中断中通过 FilterMatchIndex 查表即可找到回调，不需要任何软件过滤
+ *
+ * @attention 本函数非线程安全，调用时请注意
+ * @note list 模式要求 RTR 位也匹配，因此精确匹配的路由只接收数据帧
+ * @note 需保证 start_bank 之前的过滤器组在调用之后不再被修改，否则已计算的 FMI 会失效
  * @param hcan can handle
+ * @param routes 路由表
+ * @param count 路由表长度
+ * @param start_bank 起始过滤器组编号（CAN2 应从 slave_start_bank 开始）
+ * @param slave_start_bank CAN2 起始过滤器组编号，双 CAN 芯片上所有调用需保持一致，通常为 14
+ * @return 是否配置成功；过滤器组不足或 FMI 超出 CAN_FMI_TABLE_SIZE 时返回 false
  */
-void CAN_Fifo0ReceiveCallback(CAN_HandleTypeDef* hcan)
+bool CAN_ConfigFilterRoutes(CAN_HandleTypeDef*     hcan,
+                            const CAN_FilterRoute* routes,
+                            const size_t           count,
+                            const uint32_t         start_bank,
+                            const uint32_t         slave_start_bank)
 {
-    // 采用 while 循环来确保清空队列
-    while (HAL_CAN_GetRxFifoFillLevel(hcan, CAN_RX_FIFO0) > 0)
+    assert(routes != nullptr || count == 0);
+
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return false;
+
+    uint32_t bank = start_bank;
+    // 每个 FIFO 尚未配对的精确匹配项
+    const CAN_FilterRoute* pending[2]{};
+
+    for (size_t i = 0; i < count; i++)
     {
-        CAN_RxHeaderTypeDef header;
-        uint8_t             data[8];
-        // 从 FIFO 中获取一帧
-        if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &header, data) != HAL_OK)
+        const CAN_FilterRoute& route = routes[i];
+        assert(route.callback != nullptr);
+        assert(route.fifo == CAN_RX_FIFO0 || route.fifo == CAN_RX_FIFO1);
+
+        if (is_exact_route(route) && pending[route.fifo] == nullptr)
         {
-            Error_Handler();
-            return;
+            pending[route.fifo] = &route;
+            continue;
         }
-        // 查找回调函数表
-        const CAN_CallbackMap* map = get_map(hcan);
 
-        // 如果该 CAN 被注册
-        if (map != nullptr)
-            // 依次调用所有的回调函数
-            for (size_t i = 0; i < map->callback_count; i++)
-                map->callbacks[i](hcan, &header, data);
+        const bool             list  = is_exact_route(route);
+        const CAN_FilterRoute& first = list ? *pending[route.fifo] : route;
+        if (!config_route_bank(hcan, map, bank, slave_start_bank, first, route, list))
+            return false;
+        if (list)
+            pending[route.fifo] = nullptr;
+        bank++;
     }
+
+    // 落单的精确匹配项：list 模式的两个 ID 填成同一个
+    for (const CAN_FilterRoute* route : pending)
+    {
+        if (route == nullptr)
+            continue;
+        if (!config_route_bank(hcan, map, bank, slave_start_bank, *route, *route, true))
+            return false;
+        bank++;
+    }
+    return true;
 }
+
+#if CAN_ENABLE_RX_DEFERRED
 /**
- * CAN Fifo1 接收处理函数
+ * 设置 CAN 是否使用延迟接收模式
+ *
+ * 延迟接收模式下中断只负责把硬件 FIFO 拷贝进接收队列，所有回调都在 CAN_Poll()
+ * （或接收线程）中执行，慢回调不会再拉长中断时间
  *
- * 本函数将会根据 hcan 和 rx_header 内部的 filter_id 来调用对应的回调函数
+ * @attention 本函数非线程安全，切换前应确保队列已被 CAN_Poll() 取空
  * @param hcan can handle
+ * @param deferred 是否开启
  */
-void CAN_Fifo1ReceiveCallback(CAN_HandleTypeDef* hcan)
+void CAN_SetRxDeferred(CAN_HandleTypeDef* hcan, const bool deferred)
+{
+    if (CAN_CallbackMap* map = get_or_create_map(hcan); map != nullptr)
+        map->rx_deferred = deferred;
+}
+
+/**
+ * 分发延迟接收队列中的帧
+ *
+ * @attention 每条 CAN 只能有一个线程调用本函数（接收队列为单消费者）
+ * @param hcan can handle
+ * @param max_frames 本次最多分发的帧数，0 表示取空队列
+ * @return 本次分发的帧数
+ */
+size_t CAN_Poll(CAN_HandleTypeDef* hcan, const size_t max_frames)
 {
-    while (HAL_CAN_GetRxFifoFillLevel(hcan, CAN_RX_FIFO0) > 0)
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return 0;
+
+    size_t count = 0;
+    while (max_frames == 0 || count < max_frames)
     {
-        CAN_RxHeaderTypeDef header;
-        uint8_t             data[8];
-        if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO1, &header, data) != HAL_OK)
-        {
-            Error_Handler();
-            return;
-        }
-        const CAN_CallbackMap* map = get_map(hcan);
-        if (map != nullptr)
-            for (size_t i = 0; i < map->callback_count; i++)
-                map->callbacks[i](hcan, &header, data);
+        CAN_RxFrame* frame = nullptr;
+        if (!map->rx_queue.pop(frame))
+            break;
+        dispatch_frame(hcan, map, frame->fifo, &frame->header, frame->data);
+        rx_pool.release(frame);
+        count++;
     }
+    return count;
+}
+
+/**
+ * 获取延迟接收队列因已满而丢弃的帧数
+ * @param hcan can handle
+ * @return 累计丢帧数
+ */
+uint32_t CAN_GetRxDropCount(const CAN_HandleTypeDef* hcan)
+{
+    const CAN_CallbackMap* map = get_map(hcan);
+    return map == nullptr ? 0 : map->rx_dropped.load(std::memory_order_relaxed);
+}
+#endif
+
+#if CAN_ENABLE_RX_WORKER
+/**
+ * 启动接收线程
+ *
+ * 接收线程在中断入队后被线程标志唤醒，批量分发所有延迟接收模式 CAN 的队列
+ * @param priority 线程优先级
+ * @return 线程是否创建成功
+ */
+bool CAN_StartRxWorker(const osPriority_t priority)
+{
+    if (rx_worker != nullptr)
+        return true;
+
+    const osThreadAttr_t attr{
+        .name       = "CANRx",
+        .stack_size = CAN_RX_WORKER_STACK_SIZE,
+        .priority   = priority,
+    };
+    rx_worker = osThreadNew(rx_worker_entry, nullptr, &attr);
+    return rx_worker != nullptr;
+}
+#endif
+
+/**
+ * 保留当前正在分发的接收帧
+ *
+ * 在接收回调中调用，传入回调参数中的 header，即可在回调返回后继续持有该帧而无需拷贝，
+ * 用完后必须调用 CAN_ReleaseFrame 归还，否则帧池会被耗尽
+ * @param header 接收回调收到的 header 指针
+ * @return 帧句柄；帧池耗尽导致该帧未存放在帧池中时返回 nullptr，此时只能自行拷贝
+ */
+const CAN_RxFrame* CAN_RetainFrame(const CAN_RxHeaderTypeDef* header)
+{
+    const CAN_RxFrame* frame = rx_pool.from_header(header);
+    if (frame != nullptr)
+        CAN_RxFramePool::retain(frame);
+    return frame;
+}
+
+/**
+ * 释放通过 CAN_RetainFrame 保留的接收帧
+ *
+ * 可在中断或线程中调用
+ * @param frame 帧句柄
+ */
+void CAN_ReleaseFrame(const CAN_RxFrame* frame)
+{
+    if (frame != nullptr)
+        rx_pool.release(frame);
 }
 
 /**
- * HAL CAN TX 中断回调
+ * CAN Fifo0 接收处理函数
+ *
+ * 本函数将会根据 hcan 和 rx_header 内部的 ID 来调用对应的回调函数
+ * @param hcan can handle
+ */
+void CAN_Fifo0ReceiveCallback(CAN_HandleTypeDef* hcan)
+{
+    receive_fifo(hcan, CAN_RX_FIFO0);
+}
+/**
+ * CAN Fifo1 接收处理函数
+ *
+ * 本函数将会根据 hcan 和 rx_header 内部的 ID 来调用对应的回调函数
  * @param hcan can handle
  */
-void CAN_TxMailboxCpltCallback(CAN_HandleTypeDef* hcan)
+void CAN_Fifo1ReceiveCallback(CAN_HandleTypeDef* hcan)
 {
-    // 当上一帧发送完成
-    // 获取当前函数的函数表
+    receive_fifo(hcan, CAN_RX_FIFO1);
+}
 
-    // TODO: fixbug 当表未注册使可能产生 UB
-    auto map = get_map(hcan);
-    while (HAL_CAN_GetTxMailboxesFreeLevel(hcan) > 0 && !map->buffer.empty())
+#if CAN_FAST_PATH
+/**
+ * 接收 FIFO 中断的直接入口
+ *
+ * 在 CANx_RX0_IRQHandler / CANx_RX1_IRQHandler 中代替 HAL_CAN_IRQHandler 调用，省去 HAL 对 IER、TSR、
+ * 另一个 FIFO、MSR 与 ESR 的逐项检查，每帧只剩 FIFO 本身的寄存器访问。
+ * FULL / FOVR 标志在这里清除，溢出计入 rx_overrun；发送与错误中断仍交给 HAL_CAN_IRQHandler
+ * @param hcan can handle
+ * @param fifo CAN_RX_FIFO0 或 CAN_RX_FIFO1
+ */
+void CAN_RxFifoIRQHandler(CAN_HandleTypeDef* hcan, const uint32_t fifo)
+{
+    // RF1R 的 FULL1 / FOVR1 与 RF0R 位置相同
+    auto&          rfr   = fifo == CAN_RX_FIFO0 ? hcan->Instance->RF0R : hcan->Instance->RF1R;
+    const uint32_t flags = rfr & (CAN_RF0R_FULL0 | CAN_RF0R_FOVR0);
+    if (flags != 0)
     {
-        uint32_t mailbox = CAN_SEND_FAILED;
-        // 从 buffer 内提取一帧
-        const auto msg = map->buffer.pop();
-        if (HAL_CAN_AddTxMessage(hcan, &msg->header, msg->data, &mailbox) != HAL_OK)
-        {
-            Error_Handler();
-        }
+        // 写 1 清除，RFOM 写 0 不释放邮箱
+        rfr = flags;
+#    if CAN_ENABLE_STATS
+        if (CAN_CallbackMap* map = get_map(hcan); map != nullptr && (flags & CAN_RF0R_FOVR0) != 0)
+            CAN_STAT_INC(map, rx_overrun[fifo]);
+#    endif
     }
+    receive_fifo(hcan, fifo);
+}
+#endif
+
+/**
+ * HAL CAN TX 邮箱发送完成回调
+ * @param hcan can handle
+ */
+void CAN_TxMailbox0CpltCallback(CAN_HandleTypeDef* hcan)
+{
+    complete_mailbox(hcan, 0, CAN_TX_STATUS_SENT);
+}
+void CAN_TxMailbox1CpltCallback(CAN_HandleTypeDef* hcan)
+{
+    complete_mailbox(hcan, 1, CAN_TX_STATUS_SENT);
+}
+void CAN_TxMailbox2CpltCallback(CAN_HandleTypeDef* hcan)
+{
+    complete_mailbox(hcan, 2, CAN_TX_STATUS_SENT);
+}
+
+/**
+ * HAL CAN TX 邮箱发送中止回调
+ * @param hcan can handle
+ */
+void CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef* hcan)
+{
+    complete_mailbox(hcan, 0, CAN_TX_STATUS_ABORTED);
+}
+void CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef* hcan)
+{
+    complete_mailbox(hcan, 1, CAN_TX_STATUS_ABORTED);
+}
+void CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef* hcan)
+{
+    complete_mailbox(hcan, 2, CAN_TX_STATUS_ABORTED);
 }
 
 /**
@@ -277,9 +3520,18 @@ void CAN_InitMainCallback(CAN_HandleTypeDef* hcan)
 {
     assert(hcan != nullptr);
 
+    // 发送队列挂在回调函数表上，未注册接收回调的总线也需要建表
+    (void) get_or_create_map(hcan);
+
     HAL_CAN_RegisterCallback(hcan, HAL_CAN_RX_FIFO0_MSG_PENDING_CB_ID, CAN_Fifo0ReceiveCallback);
     HAL_CAN_RegisterCallback(hcan, HAL_CAN_RX_FIFO1_MSG_PENDING_CB_ID, CAN_Fifo1ReceiveCallback);
-    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX0_COMPLETE_CB_ID, CAN_TxMailboxCpltCallback);
-    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX1_COMPLETE_CB_ID, CAN_TxMailboxCpltCallback);
-    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX2_COMPLETE_CB_ID, CAN_TxMailboxCpltCallback);
-}
\ No newline at end of file
+    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX0_COMPLETE_CB_ID, CAN_TxMailbox0CpltCallback);
+    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX1_COMPLETE_CB_ID, CAN_TxMailbox1CpltCallback);
+    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX2_COMPLETE_CB_ID, CAN_TxMailbox2CpltCallback);
+    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX0_ABORT_CB_ID, CAN_TxMailbox0AbortCallback);
+    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX1_ABORT_CB_ID, CAN_TxMailbox1AbortCallback);
+    HAL_CAN_RegisterCallback(hcan, HAL_CAN_TX_MAILBOX2_ABORT_CB_ID, CAN_TxMailbox2AbortCallback);
+    HAL_CAN_RegisterCallback(hcan, HAL_CAN_ERROR_CB_ID, CAN_ErrorCallback);
+}
+
+#endif // !HAL_FDCAN_MODULE_ENABLED
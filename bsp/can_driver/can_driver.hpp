@@ -26,31 +26,150 @@
 
 #include "main.h"
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
 #if !defined(HAL_CAN_MODULE_ENABLED) && !defined(HAL_FDCAN_MODULE_ENABLED)
 #    error "REQUIRE_HAL_CAN is set but neither HAL_CAN_MODULE_ENABLED nor HAL_FDCAN_MODULE_ENABLED is enabled"
 #endif
 
 #if defined(HAL_FDCAN_MODULE_ENABLED)
-#    error "this can_driver do not support FDCAN"
-#endif
+// STM32G4 / H7 等芯片的 FDCAN 外设使用接口相同的 FDCAN 后端
+#    include "fdcan_driver.hpp"
+#else
 
 #if !(USE_HAL_CAN_REGISTER_CALLBACKS)
 #    error "CAN driver requires HAL CAN RegisterCallback enabled. Please enable it in CubeMX: Project Manager -> Advanced Settings -> Register Callbacks -> CAN"
 #endif
 
 #define CAN_SEND_FAILED (0xFFFF)
+#define CAN_SEND_QUEUED (0xFFFE) ///< 未直接装入邮箱，已进入软件发送队列
+
+#define CAN_TX_TICKET_INVALID (0)
+
+// 每条 CAN 保存最近结束发送的帧状态的条数（2 的幂），超出后 CAN_GetTxStatus 返回 CAN_TX_STATUS_UNKNOWN
+#ifndef CAN_TX_STATUS_HISTORY_SIZE
+#    define CAN_TX_STATUS_HISTORY_SIZE (16)
+#endif
 
 // 一条 CAN 最多注册的回调数量
 #ifndef CAN_MAX_CALLBACK_NUM
 #    define CAN_MAX_CALLBACK_NUM (14)
 #endif
 
+// 一条 CAN 最多注册的按 ID 分发回调数量（不超过 254）
+#ifndef CAN_MAX_ID_CALLBACK_NUM
+#    define CAN_MAX_ID_CALLBACK_NUM (16)
+#endif
+
+// 扩展帧 ID 哈希表大小，必须为 2 的幂，且应大于扩展帧 ID 回调数量以保证查找效率
+#ifndef CAN_EXT_ID_TABLE_SIZE
+#    define CAN_EXT_ID_TABLE_SIZE (16)
+#endif
+
+// 每个 FIFO 可按过滤器编号（FMI）直接分发的表项数量
+#ifndef CAN_FMI_TABLE_SIZE
+#    define CAN_FMI_TABLE_SIZE (28)
+#endif
+
+// 延迟接收模式：中断只把帧拷贝进每条 CAN 的 SPSC 队列，由 CAN_Poll() 或接收线程分发
+#ifndef CAN_ENABLE_RX_DEFERRED
+#    define CAN_ENABLE_RX_DEFERRED (0)
+#endif
+
+// 延迟接收模式下由 CMSIS-RTOS v2 线程自动分发（需同时开启 CAN_ENABLE_RX_DEFERRED）
+#ifndef CAN_ENABLE_RX_WORKER
+#    define CAN_ENABLE_RX_WORKER (0)
+#endif
+
+// 接收帧池大小（所有 CAN 共用），需覆盖中断中同时在用、被回调保留以及延迟接收队列中的帧
+#ifndef CAN_RX_POOL_SIZE
+#    define CAN_RX_POOL_SIZE (16)
+#endif
+
+// 延迟接收队列大小，实际可缓存 CAN_RX_QUEUE_SIZE - 1 帧
+#ifndef CAN_RX_QUEUE_SIZE
+#    define CAN_RX_QUEUE_SIZE (32)
+#endif
+
+// 接收线程栈大小，单位 byte
+#ifndef CAN_RX_WORKER_STACK_SIZE
+#    define CAN_RX_WORKER_STACK_SIZE (512 * 4)
+#endif
+
+#if CAN_ENABLE_RX_WORKER && !CAN_ENABLE_RX_DEFERRED
+#    error "CAN_ENABLE_RX_WORKER requires CAN_ENABLE_RX_DEFERRED"
+#endif
+
+#if CAN_ENABLE_RX_WORKER
+#    include "cmsis_os2.h"
+#endif
+
+// 统计信息（CAN_GetStats），关闭时所有计数代码都不会被编译
+#ifndef CAN_ENABLE_STATS
+#    define CAN_ENABLE_STATS (0)
+#endif
+
+// 接收帧到达时间戳（CAN_GetRxTimestamp），需要 DWT CYCCNT
+#ifndef CAN_ENABLE_RX_TIMESTAMP
+#    define CAN_ENABLE_RX_TIMESTAMP (0)
+#endif
+
+// 按 ID 的最新值缓存（CAN_RegisterLatest / CAN_ReadLatest）
+#ifndef CAN_ENABLE_RX_LATEST
+#    define CAN_ENABLE_RX_LATEST (0)
+#endif
+
+// 每条 CAN 最多缓存最新值的 ID 数量
+#ifndef CAN_MAX_LATEST_NUM
+#    define CAN_MAX_LATEST_NUM (8)
+#endif
+
+// 收发记录（CAN_RecorderStart），日志格式见 can_log.hpp
+#ifndef CAN_ENABLE_RECORDER
+#    define CAN_ENABLE_RECORDER (0)
+#endif
+
+// 记录缓冲区大小（单块日志的字节数，不超过 65535），双缓冲共占用两倍
+#ifndef CAN_RECORDER_BUFFER_SIZE
+#    define CAN_RECORDER_BUFFER_SIZE (512)
+#endif
+
+// 总线负载估计（CAN_GetBusLoad），关闭时不会统计收发帧的位数
+#ifndef CAN_ENABLE_BUS_LOAD
+#    define CAN_ENABLE_BUS_LOAD (0)
+#endif
+
+// 一条 CAN 最多设置的发送限速规则数量
+#ifndef CAN_MAX_RATE_LIMIT_NUM
+#    define CAN_MAX_RATE_LIMIT_NUM (4)
+#endif
+
+// 收发直接读写 bxCAN 寄存器，绕过 HAL_CAN_AddTxMessage / HAL_CAN_GetRxMessage 的状态检查与逐字段转换
+#ifndef CAN_FAST_PATH
+#    define CAN_FAST_PATH (0)
+#endif
+
+// 发送路径临界区屏蔽的中断优先级，与 CAN 中断的 NVIC 抢占优先级相同（按 NVIC_PRIORITYGROUP_4）
+// 0 表示用 PRIMASK 关闭全部中断；非 0 时用 BASEPRI 只屏蔽不高于 CAN 的中断，更高优先级的中断不受影响，
+// 它们调用发送函数时经无锁提交队列转交（需要 Cortex-M3 及以上）。非 0 时这些中断只能调用发送函数与
+// CAN_GetTimeUs / CAN_TimestampToTick
+#ifndef CAN_TX_LOCK_PRIORITY
+#    define CAN_TX_LOCK_PRIORITY (0)
+#endif
+
+// 高于 CAN_TX_LOCK_PRIORITY 的中断提交发送的无锁队列长度（2 的幂），每条 CAN 一个
+#ifndef CAN_TX_SUBMIT_QUEUE_SIZE
+#    define CAN_TX_SUBMIT_QUEUE_SIZE (8)
+#endif
+
 // CAN 数量
 #ifndef CAN_NUM
 #    define CAN_NUM (2)
 #endif
 
-// CAN 发送 软件缓冲区大小
+// CAN 发送 软件缓冲区大小（按仲裁优先级排序，不超过 254）
 #ifndef CAN_TX_QUEUE_SIZE
 #    define CAN_TX_QUEUE_SIZE (8)
 #endif
@@ -59,11 +178,264 @@ typedef void (*CAN_FifoReceiveCallback_t)(const CAN_HandleTypeDef*   hcan,
                                           const CAN_RxHeaderTypeDef* header,
                                           const uint8_t*             data);
 
-// TODO: 增加更完善的错误返回逻辑
+/**
+ * 发送票据
+ *
+ * 每条提交发送的帧都会获得一个单调递增的编号（每条 CAN 独立计数，跳过 CAN_TX_TICKET_INVALID），
+ * 用于查询该帧的发送状态或在发送结束回调中识别该帧
+ */
+typedef uint32_t CAN_TxTicket;
+
+typedef enum
+{
+    CAN_TX_STATUS_UNKNOWN = 0, ///< 无效票据，或状态记录已被新帧覆盖
+    CAN_TX_STATUS_QUEUED,      ///< 在软件发送队列中等待
+    CAN_TX_STATUS_PENDING,     ///< 已装入硬件邮箱，等待总线发送
+    CAN_TX_STATUS_SENT,        ///< 已成功发送
+    CAN_TX_STATUS_ABORTED,     ///< 发送请求被中止，或关闭自动重传时仲裁丢失 / 发送错误
+    CAN_TX_STATUS_DROPPED,     ///< 队列已满未能入队，或在队列中被更高优先级的帧挤出
+    CAN_TX_STATUS_REPLACED,    ///< 在队列或邮箱中被 CAN_SendLatest 的新值覆盖
+    CAN_TX_STATUS_RATE_LIMITED ///< 超出 CAN_SetRateLimit 设置的速率，未发送
+} CAN_TxStatus;
+
+/**
+ * 帧发送结束回调，在帧进入 SENT / ABORTED / DROPPED / REPLACED 状态时调用
+ * @attention 可能在中断或发送函数的临界区中调用，请尽量简短；可以在回调中发送下一帧
+ */
+typedef void (*CAN_TxCompleteCallback_t)(const CAN_HandleTypeDef* hcan,
+                                         CAN_TxTicket             ticket,
+                                         CAN_TxStatus             status,
+                                         void*                    ctx);
+
+/**
+ * 接收帧池中的一帧
+ *
+ * 接收回调收到的 header / data 指向帧池槽位，通过 CAN_RetainFrame 可在回调返回后继续持有
+ */
+struct CAN_RxFrame
+{
+    CAN_RxHeaderTypeDef header;  ///< 帧头，必须为第一个成员
+    uint8_t             data[8]; ///< 数据
+    uint8_t             fifo;    ///< 接收该帧的 FIFO
+#if CAN_ENABLE_RX_TIMESTAMP
+    uint64_t timestamp_us; ///< 到达时间，单位微秒，与 CAN_GetTimeUs 为同一时基
+#endif
+
+    mutable std::atomic<uint16_t> refs{ 0 }; ///< 引用计数，由驱动维护
+    std::atomic<uint16_t>         next{ 0 }; ///< 空闲链表，由驱动维护
+};
+
+#if CAN_ENABLE_RECORDER
+/**
+ * 记录输出回调，一块日志写满（或 CAN_RecorderFlush）时调用
+ *
+ * 输出完成后调用 CAN_RecorderRelease 归还缓冲区，归还之前 data 必须保持有效；
+ * 同步输出（如写入 RAM）可以在回调中直接归还，异步输出（如 UART DMA）在传输完成中断中归还
+ * @attention 在收发中断或 CAN_Poll 中调用，请尽量简短
+ * @param data 一整块日志
+ * @param size 字节数
+ * @param ctx 启动时传入的用户上下文
+ */
+typedef void (*CAN_RecorderSink_t)(const uint8_t* data, size_t size, void* ctx);
+#endif
+
+#if CAN_ENABLE_RX_LATEST
+/**
+ * 最新值缓存中一个 ID 的快照
+ */
+typedef struct
+{
+    CAN_RxHeaderTypeDef header;   ///< 帧头
+    uint8_t             data[8];  ///< 数据
+    uint32_t            sequence; ///< 该 ID 累计收到的帧数，两次读取之间不变说明没有新帧
+} CAN_LatestFrame;
+#endif
+
+/**
+ * 按 ID 分发的接收回调
+ *
+ * @param ctx 注册时传入的用户上下文
+ */
+typedef void (*CAN_IdCallback_t)(const CAN_HandleTypeDef*   hcan,
+                                 const CAN_RxHeaderTypeDef* header,
+                                 const uint8_t*             data,
+                                 void*                      ctx);
+
+/**
+ * CAN 发送消息类型
+ *
+ * 包括 TxHeader 和 至多 8 bytes 的数据，同时也是软件发送队列的储存格式
+ */
+typedef struct
+{
+    CAN_TxHeaderTypeDef header;
+    uint8_t             data[8];
+} CAN_MessageDef;
+
+/*
+ * 与后端无关的句柄、帧头类型与帧头访问，FDCAN 后端提供同名同义的版本；
+ * CanIsoTp 等建立在本驱动之上的协议只通过它们构造与解析帧头
+ */
+typedef CAN_HandleTypeDef   CAN_Handle;
+typedef CAN_TxHeaderTypeDef CAN_TxHeader;
+typedef CAN_RxHeaderTypeDef CAN_RxHeader;
+
+/**
+ * 构造一个经典 CAN 数据帧的帧头
+ * @param id 标准帧或扩展帧 ID
+ * @param extended 是否为扩展帧
+ * @param length 数据长度，超过 8 按 8 处理
+ */
+inline CAN_TxHeader CAN_MakeDataHeader(const uint32_t id, const bool extended, const size_t length)
+{
+    CAN_TxHeader header{};
+    header.IDE = extended ? CAN_ID_EXT : CAN_ID_STD;
+    header.RTR = CAN_RTR_DATA;
+    header.DLC = length > 8 ? 8 : static_cast<uint32_t>(length);
+    if (extended)
+        header.ExtId = id;
+    else
+        header.StdId = id;
+    return header;
+}
+
+/// 是否为数据帧（不是远程帧）
+inline bool CAN_IsDataFrame(const CAN_RxHeader* header)
+{
+    return header->RTR == CAN_RTR_DATA;
+}
+
+/// 数据长度，0 ~ 8
+inline size_t CAN_GetDataLength(const CAN_RxHeader* header)
+{
+    return header->DLC > 8 ? 8 : header->DLC;
+}
+
+/**
+ * 软件发送队列已满时的处理策略
+ */
+typedef enum
+{
+    CAN_TX_DROP_LOWEST_PRIORITY, ///< 丢弃队列中 ID 最大的帧；新帧本身优先级最低时丢弃新帧
+    CAN_TX_REJECT_NEW,           ///< 拒绝新帧
+} CAN_TxDropPolicy;
+
+/**
+ * CAN 控制器错误状态，按严重程度递增
+ */
+typedef enum
+{
+    CAN_ERROR_ACTIVE = 0, ///< 正常
+    CAN_ERROR_WARNING,    ///< TEC 或 REC 达到 96
+    CAN_ERROR_PASSIVE,    ///< TEC 或 REC 达到 128，只能发送隐性错误帧
+    CAN_BUS_OFF,          ///< TEC 超过 255，已脱离总线
+} CAN_ErrorState;
+
+/**
+ * bus-off 恢复方式
+ */
+typedef enum
+{
+    CAN_BUS_OFF_RECOVERY_AUTO,   ///< 硬件在检测到 128 × 11 个隐性位后自动恢复（ABOM）
+    CAN_BUS_OFF_RECOVERY_MANUAL, ///< 需要调用 CAN_RecoverBusOff 恢复
+} CAN_BusOffRecovery;
+
+/**
+ * 进入 bus-off 时对待发送帧的处理策略，决定恢复后哪些帧会被发出
+ */
+typedef enum
+{
+    CAN_RECOVERY_REPLAY,      ///< 保留所有待发送帧，恢复后按优先级继续发送
+    CAN_RECOVERY_FLUSH,       ///< 丢弃软件队列并中止邮箱中的帧，恢复后不会发出过期帧
+    CAN_RECOVERY_LATEST_ONLY, ///< 只保留 CAN_SendLatest 发送的帧（每个 ID 的最新值），队列与邮箱中的其余帧丢弃
+} CAN_RecoveryPolicy;
+
+#if CAN_ENABLE_STATS
+/**
+ * CAN 统计信息快照，计数均为累计值，按时间差分即可得到速率
+ */
+typedef struct
+{
+    uint32_t tx_direct;           ///< 直接装入邮箱的帧数
+    uint32_t tx_queued;           ///< 进入软件发送队列的帧数
+    uint32_t tx_dropped;          ///< 因队列已满被丢弃（含被挤出）的帧数
+    uint32_t tx_queue_high_water; ///< 软件发送队列最高水位
+    uint32_t tx_rate_limited;     ///< 因超出限速被拒绝的帧数
+    uint32_t tx_latency_us_max;   ///< 帧从提交（装入邮箱或入队）到发送成功的最长耗时，单位微秒（没有 DWT 时精度为 1 ms）
+    uint32_t tx_latency_us_avg;   ///< 帧从提交到发送成功的平均耗时，单位微秒
+    uint32_t rx_fifo[2];          ///< FIFO0 / FIFO1 接收帧数
+    uint32_t rx_overrun[2];       ///< FIFO0 / FIFO1 硬件溢出次数
+    uint32_t rx_dropped;          ///< 延迟接收队列已满或帧池耗尽被丢弃的帧数
+    uint32_t rx_pool_empty;       ///< 接收时帧池已耗尽的次数
+    uint32_t error_events;        ///< 错误中断次数
+    uint32_t error_warning_events; ///< 进入 error warning（TEC / REC ≥ 96）的次数
+    uint32_t error_passive_events; ///< 进入 error passive（TEC / REC ≥ 128）的次数
+    uint32_t bus_off_events;      ///< 进入 bus-off 的次数
+    uint32_t bus_off_recoveries;  ///< 从 bus-off 恢复的次数
+    uint32_t recovery_ms_last;    ///< 最近一次 bus-off 恢复耗时，单位毫秒
+    uint32_t recovery_ms_max;     ///< bus-off 恢复最长耗时，单位毫秒
+    uint32_t isr_max_cycles;      ///< 接收 / 发送中断的最长耗时，单位 CPU 周期（需要 DWT）
+    uint32_t lock_max_cycles;     ///< 驱动临界区的最长持续时间，单位 CPU 周期（需要 DWT，所有 CAN 共用）
+} CAN_Stats;
+#endif
+
+/**
+ * 硬件过滤路由表项
+ *
+ * 每一项对应 bxCAN 的一个硬件过滤器，命中后按 FilterMatchIndex 直接分发到 callback。
+ * mask 为全 1 时视为精确匹配，两项精确匹配会合并进同一个 32 位 list 模式过滤器组；
+ * 其余情况占用一个 32 位 mask 模式过滤器组
+ */
+typedef struct
+{
+    uint32_t         id;       ///< 标准帧或扩展帧 ID
+    uint32_t         mask;     ///< ID 掩码，标准帧 0x7FF / 扩展帧 0x1FFFFFFF 表示精确匹配
+    uint32_t         ide;      ///< CAN_ID_STD / CAN_ID_EXT
+    uint32_t         fifo;     ///< CAN_RX_FIFO0 / CAN_RX_FIFO1
+    CAN_IdCallback_t callback; ///< 命中后调用的回调函数
+    void*            ctx;      ///< 用户上下文，回调时原样传回
+} CAN_FilterRoute;
 
 uint32_t CAN_SendMessage(CAN_HandleTypeDef*         hcan,
                          const CAN_TxHeaderTypeDef* header,
-                         const uint8_t              data[]);
+                         const uint8_t              data[],
+                         CAN_TxTicket*              ticket = nullptr);
+
+size_t CAN_SendBatch(CAN_HandleTypeDef*    hcan,
+                     const CAN_MessageDef* msgs,
+                     size_t                count,
+                     uint32_t*             mailboxes,
+                     CAN_TxTicket*         tickets = nullptr);
+
+uint32_t CAN_SendLatest(CAN_HandleTypeDef*         hcan,
+                        const CAN_TxHeaderTypeDef* header,
+                        const uint8_t              data[],
+                        CAN_TxTicket*              ticket = nullptr);
+
+bool CAN_SetRateLimit(CAN_HandleTypeDef* hcan,
+                      uint32_t           ide,
+                      uint32_t           id_low,
+                      uint32_t           id_high,
+                      uint32_t           frames_per_second,
+                      uint32_t           burst);
+
+CAN_ErrorState CAN_GetErrorState(CAN_HandleTypeDef* hcan, uint8_t* tec, uint8_t* rec);
+
+void CAN_SetBusOffRecovery(CAN_HandleTypeDef* hcan, CAN_BusOffRecovery recovery);
+
+void CAN_SetRecoveryPolicy(CAN_HandleTypeDef* hcan, CAN_RecoveryPolicy policy);
+
+bool CAN_RecoverBusOff(CAN_HandleTypeDef* hcan);
+
+CAN_TxStatus CAN_GetTxStatus(const CAN_HandleTypeDef* hcan, CAN_TxTicket ticket);
+
+bool CAN_IsSent(const CAN_HandleTypeDef* hcan, CAN_TxTicket ticket);
+
+void CAN_SetTxCompleteCallback(CAN_HandleTypeDef* hcan, CAN_TxCompleteCallback_t callback, void* ctx);
+
+void CAN_GetTxCompleteCallback(const CAN_HandleTypeDef* hcan, CAN_TxCompleteCallback_t* callback, void** ctx);
+
+void CAN_SetTxDropPolicy(CAN_HandleTypeDef* hcan, CAN_TxDropPolicy policy);
 
 void CAN_InitMainCallback(CAN_HandleTypeDef* hcan);
 
@@ -71,6 +443,104 @@ void CAN_Start(CAN_HandleTypeDef* hcan, uint32_t ActiveITs);
 
 void CAN_RegisterCallback(CAN_HandleTypeDef* hcan, CAN_FifoReceiveCallback_t callback);
 
+bool CAN_RegisterIdCallback(CAN_HandleTypeDef* hcan,
+                            uint32_t           id,
+                            uint32_t           mask,
+                            CAN_IdCallback_t   callback,
+                            void*              ctx);
+
+bool CAN_RegisterExtIdCallback(CAN_HandleTypeDef* hcan,
+                               uint32_t           ext_id,
+                               CAN_IdCallback_t   callback,
+                               void*              ctx);
+
+bool CAN_ConfigFilterRoutes(CAN_HandleTypeDef*     hcan,
+                            const CAN_FilterRoute* routes,
+                            size_t                 count,
+                            uint32_t               start_bank,
+                            uint32_t               slave_start_bank);
+
+const CAN_RxFrame* CAN_RetainFrame(const CAN_RxHeaderTypeDef* header);
+
+void CAN_ReleaseFrame(const CAN_RxFrame* frame);
+
+#if CAN_ENABLE_RX_DEFERRED
+void CAN_SetRxDeferred(CAN_HandleTypeDef* hcan, bool deferred);
+
+size_t CAN_Poll(CAN_HandleTypeDef* hcan, size_t max_frames);
+
+uint32_t CAN_GetRxDropCount(const CAN_HandleTypeDef* hcan);
+#endif
+
+#if CAN_ENABLE_RX_WORKER
+bool CAN_StartRxWorker(osPriority_t priority);
+#endif
+
+#if CAN_ENABLE_RX_TIMESTAMP
+uint64_t CAN_GetRxTimestamp(const CAN_RxHeaderTypeDef* header);
+
+uint64_t CAN_GetTimeUs();
+
+uint32_t CAN_TimestampToTick(uint64_t timestamp_us);
+#endif
+
+#if CAN_ENABLE_RX_LATEST
+bool CAN_RegisterLatest(CAN_HandleTypeDef* hcan, uint32_t id, uint32_t ide = CAN_ID_STD);
+
+bool CAN_ReadLatest(const CAN_HandleTypeDef* hcan,
+                    uint32_t                 id,
+                    CAN_LatestFrame*         frame,
+                    uint32_t*                age_us,
+                    uint32_t                 ide = CAN_ID_STD);
+#endif
+
+#if CAN_ENABLE_RECORDER
+void CAN_RecorderStart(CAN_RecorderSink_t sink, void* ctx);
+
+void CAN_RecorderStop();
+
+bool CAN_RecorderFlush();
+
+void CAN_RecorderRelease();
+
+uint32_t CAN_RecorderGetDropped();
+#endif
+
+#if CAN_ENABLE_BUS_LOAD
+float CAN_GetBusLoad(const CAN_HandleTypeDef* hcan, uint32_t window_ms);
+#endif
+
+#if CAN_ENABLE_STATS
+bool CAN_GetStats(const CAN_HandleTypeDef* hcan, CAN_Stats* stats);
+
+void CAN_ResetStats(const CAN_HandleTypeDef* hcan);
+#endif
+
+/*
+ * HAL 中断回调入口
+ *
+ * CAN_InitMainCallback 会把它们注册到 HAL；不经过 HAL 中断分发时（例如在主机上用模拟的外设驱动本驱动）
+ * 可以直接调用，行为与对应的中断完全相同
+ */
+void CAN_Fifo0ReceiveCallback(CAN_HandleTypeDef* hcan);
+void CAN_Fifo1ReceiveCallback(CAN_HandleTypeDef* hcan);
+void CAN_TxMailbox0CpltCallback(CAN_HandleTypeDef* hcan);
+void CAN_TxMailbox1CpltCallback(CAN_HandleTypeDef* hcan);
+void CAN_TxMailbox2CpltCallback(CAN_HandleTypeDef* hcan);
+void CAN_TxMailbox0AbortCallback(CAN_HandleTypeDef* hcan);
+void CAN_TxMailbox1AbortCallback(CAN_HandleTypeDef* hcan);
+void CAN_TxMailbox2AbortCallback(CAN_HandleTypeDef* hcan);
+void CAN_ErrorCallback(CAN_HandleTypeDef* hcan);
+
+#if CAN_FAST_PATH
+/*
+ * 接收中断的直接入口，在 CANx_RX0_IRQHandler / CANx_RX1_IRQHandler 中代替 HAL_CAN_IRQHandler：
+ *
+ * void CAN1_RX0_IRQHandler() { CAN_RxFifoIRQHandler(&hcan1, CAN_RX_FIFO0); }
+ */
+void CAN_RxFifoIRQHandler(CAN_HandleTypeDef* hcan, uint32_t fifo);
+#endif
+
 // void CAN_UnregisterCallback(CAN_HandleTypeDef* hcan, uint32_t filter_match_index);
-// void CAN_Fifo0ReceiveCallback(CAN_HandleTypeDef* hcan);
-// void CAN_Fifo1ReceiveCallback(CAN_HandleTypeDef* hcan);
+
+#endif // HAL_FDCAN_MODULE_ENABLED
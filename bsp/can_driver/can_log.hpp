@@ -0,0 +1,229 @@
+/**
+ * @file    can_log.hpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   CAN 收发记录的二进制日志格式。
+ *
+ * can_driver 的记录器（CAN_RecorderStart）按本格式写出，主机端工具（tools/can_log_tool.cpp）按本格式解码。
+ * 本文件不依赖 HAL，固件与主机共用。
+ *
+ * 日志由若干块（block）顺序拼接而成，每块对应记录器的一个缓冲区：
+ *
+ * | 偏移 | 大小 | 内容                                   |
+ * | ---- | ---- | -------------------------------------- |
+ * | 0    | 2    | 魔数 0x4C43（"CL"，小端）              |
+ * | 2    | 1    | 版本 can_log::VERSION                  |
+ * | 3    | 1    | 保留，为 0                             |
+ * | 4    | 2    | 块内记录区的字节数                     |
+ * | 6    | 2    | 上一块之后丢弃的帧数（饱和）           |
+ * | 8    | 8    | 块起始时间，单位微秒                   |
+ *
+ * 之后是连续的帧记录，多字节字段均为小端：
+ *
+ * - 2 字节标记：bit0 ~ 10 为标准帧 ID（扩展帧为 ID 的低 11 位），bit11 扩展帧，bit12 发送（0 为接收），
+ *   bit13 ~ 14 总线编号，bit15 为 1 时后跟 1 字节 DLC / RTR，为 0 时表示 DLC 为 8 的数据帧
+ * - [1 字节] bit0 ~ 3 DLC，bit4 远程帧
+ * - [3 字节] 扩展帧 ID 的高 18 位
+ * - 与上一条记录（块内第一条为块起始时间）的时间差，单位微秒，有符号数按 zigzag 映射后 LEB128 变长编码；
+ *   延迟分发的接收帧按到达时间记录，可能早于上一条记录，差值为负
+ * - 数据，DLC 字节（远程帧没有数据）
+ *
+ * 常见的 8 字节标准帧占 10 + 时间差 字节，帧间隔在 8 ms 以内时不超过 12 字节
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace can_log
+{
+
+constexpr uint16_t MAGIC             = 0x4C43;
+constexpr uint8_t  VERSION           = 2;
+constexpr size_t   BLOCK_HEADER_SIZE = 16;
+// 标记 2 + DLC 1 + 扩展 ID 3 + 时间差 10 + 数据 8
+constexpr size_t MAX_RECORD_SIZE = 24;
+
+/**
+ * 一条帧记录
+ */
+struct Record
+{
+    uint64_t time_us; ///< 时间，单位微秒
+    uint32_t id;      ///< 标准帧或扩展帧 ID
+    bool     ext;     ///< 扩展帧
+    bool     rtr;     ///< 远程帧
+    bool     tx;      ///< 本节点发送（否则为接收）
+    uint8_t  bus;     ///< 总线编号 0 ~ 3
+    uint8_t  dlc;     ///< 数据长度 0 ~ 8
+    uint8_t  data[8]; ///< 数据
+};
+
+/**
+ * 块头
+ */
+struct BlockHeader
+{
+    uint16_t length;  ///< 记录区字节数
+    uint16_t dropped; ///< 上一块之后丢弃的帧数
+    uint64_t base_us; ///< 块起始时间
+};
+
+namespace detail
+{
+inline void put_le(uint8_t* out, uint64_t value, const size_t size)
+{
+    for (size_t i = 0; i < size; i++, value >>= 8)
+        out[i] = static_cast<uint8_t>(value);
+}
+
+inline uint64_t get_le(const uint8_t* in, const size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = size; i > 0; i--)
+        value = value << 8 | in[i - 1];
+    return value;
+}
+} // namespace detail
+
+/**
+ * 写入块头，记录区长度先写 0，块结束时用 set_block_length 补上
+ * @return 写入的字节数，恒为 BLOCK_HEADER_SIZE
+ */
+inline size_t encode_block_header(uint8_t* out, const uint64_t base_us, const uint16_t dropped)
+{
+    detail::put_le(out, MAGIC, 2);
+    out[2] = VERSION;
+    out[3] = 0;
+    detail::put_le(out + 4, 0, 2);
+    detail::put_le(out + 6, dropped, 2);
+    detail::put_le(out + 8, base_us, 8);
+    return BLOCK_HEADER_SIZE;
+}
+
+/**
+ * 补写块的记录区长度
+ * @param block 块起始地址
+ * @param size 整块字节数（含块头）
+ */
+inline void set_block_length(uint8_t* block, const size_t size)
+{
+    detail::put_le(block + 4, size - BLOCK_HEADER_SIZE, 2);
+}
+
+/**
+ * 编码一条记录
+ * @param out 至少 MAX_RECORD_SIZE 字节
+ * @param prev_us 上一条记录的时间，record.time_us 可以早于它
+ * @return 写入的字节数
+ */
+inline size_t encode_record(uint8_t* out, const Record& record, const uint64_t prev_us)
+{
+    const uint8_t dlc        = record.dlc > 8 ? 8 : record.dlc;
+    const bool    short_form = dlc == 8 && !record.rtr;
+
+    uint16_t tag = static_cast<uint16_t>(record.id & 0x7FF);
+    tag |= record.ext ? 1U << 11 : 0;
+    tag |= record.tx ? 1U << 12 : 0;
+    tag |= static_cast<uint16_t>((record.bus & 0x3) << 13);
+    tag |= short_form ? 0 : 1U << 15;
+
+    size_t n = 0;
+    detail::put_le(out, tag, 2);
+    n += 2;
+    if (!short_form)
+        out[n++] = static_cast<uint8_t>(dlc | (record.rtr ? 1U << 4 : 0));
+    if (record.ext)
+    {
+        detail::put_le(out + n, (record.id & 0x1FFFFFFF) >> 11, 3);
+        n += 3;
+    }
+
+    const auto delta_us = static_cast<int64_t>(record.time_us - prev_us);
+    uint64_t   delta    = static_cast<uint64_t>(delta_us) << 1 ^ static_cast<uint64_t>(delta_us >> 63);
+    do
+    {
+        const auto byte = static_cast<uint8_t>(delta & 0x7F);
+        delta >>= 7;
+        out[n++] = delta != 0 ? byte | 0x80 : byte;
+    } while (delta != 0);
+
+    if (!record.rtr)
+        for (size_t i = 0; i < dlc; i++)
+            out[n++] = record.data[i];
+    return n;
+}
+
+/**
+ * 解码块头
+ * @return 魔数或版本不符、长度不足时返回 false
+ */
+inline bool decode_block_header(const uint8_t* in, const size_t size, BlockHeader& header)
+{
+    if (size < BLOCK_HEADER_SIZE || detail::get_le(in, 2) != MAGIC || in[2] != VERSION)
+        return false;
+    header.length  = static_cast<uint16_t>(detail::get_le(in + 4, 2));
+    header.dropped = static_cast<uint16_t>(detail::get_le(in + 6, 2));
+    header.base_us = detail::get_le(in + 8, 8);
+    return true;
+}
+
+/**
+ * 解码一条记录
+ * @param prev_us 上一条记录的时间，成功时更新为本条记录的时间
+ * @return 消耗的字节数；数据不完整或格式错误时返回 0
+ */
+inline size_t decode_record(const uint8_t* in, const size_t size, uint64_t& prev_us, Record& record)
+{
+    if (size < 2)
+        return 0;
+    const auto tag = static_cast<uint16_t>(detail::get_le(in, 2));
+    size_t     n   = 2;
+
+    record.id  = tag & 0x7FF;
+    record.ext = tag & (1U << 11);
+    record.tx  = tag & (1U << 12);
+    record.bus = static_cast<uint8_t>((tag >> 13) & 0x3);
+    record.dlc = 8;
+    record.rtr = false;
+    if (tag & (1U << 15))
+    {
+        if (n >= size)
+            return 0;
+        record.dlc = in[n] & 0xF;
+        record.rtr = in[n] & (1U << 4);
+        n++;
+        if (record.dlc > 8)
+            return 0;
+    }
+    if (record.ext)
+    {
+        if (n + 3 > size)
+            return 0;
+        record.id |= static_cast<uint32_t>(detail::get_le(in + n, 3)) << 11;
+        n += 3;
+    }
+
+    uint64_t delta = 0;
+    for (unsigned shift = 0;; shift += 7)
+    {
+        if (n >= size || shift > 63)
+            return 0;
+        const uint8_t byte = in[n++];
+        delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+
+    const size_t data_size = record.rtr ? 0 : record.dlc;
+    if (n + data_size > size)
+        return 0;
+    for (size_t i = 0; i < data_size; i++)
+        record.data[i] = in[n++];
+
+    prev_us += static_cast<uint64_t>(static_cast<int64_t>(delta >> 1) ^ -static_cast<int64_t>(delta & 1));
+    record.time_us = prev_us;
+    return n;
+}
+
+} // namespace can_log
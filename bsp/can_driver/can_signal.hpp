@@ -0,0 +1,298 @@
+/**
+ * @file    can_signal.hpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   编译期 CAN 信号打包 / 解包模板库（DBC 风格）。
+ *
+ * 用起始位、长度、字节序、有无符号、缩放和偏移描述一个信号，位置参数全部是模板参数，
+ * 解包就是一次整帧加载加上常量移位、掩码和符号扩展，没有分支也没有循环；
+ * 多个信号组成 Message 后按结构体成员一次解出整帧，8 字节只加载一次。
+ *
+ * 起始位沿用 DBC 约定：Intel（小端）为信号最低位的位置，Motorola（大端）为信号最高位的位置，
+ * 位编号均为 字节下标 * 8 + 字节内位号（0 为最低位）。
+ *
+ * 下面以常见的电机反馈帧为例（大端，依次为 16 位角度、16 位有符号转速、16 位有符号电流、8 位温度）：
+ *
+ * ```cpp
+ * using Angle   = can_signal::Signal<7, 16, can_signal::ByteOrder::Motorola>;
+ * using Speed   = can_signal::Signal<23, 16, can_signal::ByteOrder::Motorola, true>;
+ * using Current = can_signal::Signal<39, 16, can_signal::ByteOrder::Motorola, true, std::ratio<20, 16384>>;
+ * using Temp    = can_signal::Signal<55, 8, can_signal::ByteOrder::Motorola>;
+ *
+ * struct Feedback
+ * {
+ *     uint16_t angle;
+ *     int16_t  rpm;
+ *     float    current; // 单位 A
+ *     uint8_t  temperature;
+ * };
+ *
+ * using FeedbackFrame = can_signal::Message<can_signal::Field<&Feedback::angle, Angle>,
+ *                                           can_signal::Field<&Feedback::rpm, Speed>,
+ *                                           can_signal::Field<&Feedback::current, Current>,
+ *                                           can_signal::Field<&Feedback::temperature, Temp>>;
+ *
+ * void callback(const CAN_HandleTypeDef*, const CAN_RxHeaderTypeDef*, const uint8_t* data, void* ctx)
+ * {
+ *     FeedbackFrame::unpack(data, *static_cast<Feedback*>(ctx));
+ * }
+ * ```
+ *
+ * 整数成员且信号没有缩放和偏移时直接写入原始值，不经过浮点运算。
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ratio>
+#include <type_traits>
+
+namespace can_signal
+{
+
+/**
+ * 信号字节序
+ */
+enum class ByteOrder : uint8_t
+{
+    Intel,    ///< 小端，低字节在前
+    Motorola, ///< 大端，高字节在前
+};
+
+namespace detail
+{
+// 按小端把 8 字节拼成一个字，编译器会合并为一次（非对齐）加载
+constexpr uint64_t load_le(const uint8_t* data)
+{
+    return static_cast<uint64_t>(data[0]) | static_cast<uint64_t>(data[1]) << 8 |
+           static_cast<uint64_t>(data[2]) << 16 | static_cast<uint64_t>(data[3]) << 24 |
+           static_cast<uint64_t>(data[4]) << 32 | static_cast<uint64_t>(data[5]) << 40 |
+           static_cast<uint64_t>(data[6]) << 48 | static_cast<uint64_t>(data[7]) << 56;
+}
+
+constexpr void store_le(uint8_t* data, const uint64_t word)
+{
+    for (size_t i = 0; i < 8; ++i)
+        data[i] = static_cast<uint8_t>(word >> (8 * i));
+}
+
+// 字节反转，编译为 REV 指令。GCC 不会把下面的循环识别为字节反转，逐字段各展开一遍，
+// 所以有内建函数时直接使用（它在常量表达式中同样可用）
+constexpr uint64_t byte_swap(const uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap64(word);
+#else
+    uint64_t r = 0;
+    for (size_t i = 0; i < 8; ++i)
+        r |= ((word >> (8 * i)) & 0xFF) << (8 * (7 - i));
+    return r;
+#endif
+}
+
+// 把小端加载的字转换为信号字节序下的字：Motorola 信号在字节反转后的字中是连续的位段
+template <ByteOrder Order> constexpr uint64_t to_order(const uint64_t le_word)
+{
+    if constexpr (Order == ByteOrder::Intel)
+        return le_word;
+    else
+        return byte_swap(le_word);
+}
+
+template <typename Ratio, typename T = float> constexpr T ratio_value()
+{
+    return static_cast<T>(Ratio::num) / static_cast<T>(Ratio::den);
+}
+} // namespace detail
+
+/**
+ * 一个 CAN 信号
+ *
+ * @tparam StartBit 起始位，Intel 为最低位位置，Motorola 为最高位位置（DBC 约定）
+ * @tparam Length 位数，1 ~ 64
+ * @tparam Order 字节序
+ * @tparam Signed 是否为二进制补码有符号数
+ * @tparam Scale 缩放系数 std::ratio，物理值 = 原始值 * Scale + Offset
+ * @tparam Offset 偏移 std::ratio
+ */
+template <unsigned StartBit,
+          unsigned Length,
+          ByteOrder Order  = ByteOrder::Intel,
+          bool      Signed = false,
+          typename Scale   = std::ratio<1>,
+          typename Offset  = std::ratio<0>>
+struct Signal
+{
+    static_assert(Length >= 1 && Length <= 64, "signal length must be 1 ~ 64 bits");
+    static_assert(StartBit < 64, "signal must be inside an 8-byte frame");
+
+    // Motorola 起始位在字节反转后的字中的位置
+    static constexpr unsigned msb_swapped = (7 - StartBit / 8) * 8 + StartBit % 8;
+
+    static_assert(Order == ByteOrder::Intel ? StartBit + Length <= 64 : msb_swapped + 1 >= Length,
+                  "signal must be inside an 8-byte frame");
+
+    static constexpr ByteOrder order = Order;
+    // 信号最低位在（按信号字节序加载的）字中的位置
+    static constexpr unsigned lsb = Order == ByteOrder::Intel ? StartBit : msb_swapped + 1 - Length;
+    static constexpr uint64_t mask = Length == 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << Length) - 1;
+
+    static constexpr float scale  = detail::ratio_value<Scale>();
+    static constexpr float offset = detail::ratio_value<Offset>();
+    // 没有缩放和偏移时，原始值就是物理值
+    static constexpr bool identity = std::ratio_equal_v<Scale, std::ratio<1>> && Offset::num == 0;
+
+    // 不超过 32 位的信号使用 32 位原始值，避免在 Cortex-M 上做 64 位运算
+    using raw_type = std::conditional_t<Length <= 32,
+                                        std::conditional_t<Signed, int32_t, uint32_t>,
+                                        std::conditional_t<Signed, int64_t, uint64_t>>;
+
+    static constexpr raw_type raw_min = Signed ? -static_cast<raw_type>(mask >> 1) - 1 : 0;
+    static constexpr raw_type raw_max = static_cast<raw_type>(Signed ? mask >> 1 : mask);
+
+    /**
+     * 从已按本信号字节序加载的字中取出原始值
+     */
+    static constexpr raw_type extract(const uint64_t word)
+    {
+        uint64_t value = (word >> lsb) & mask;
+        if constexpr (Signed)
+        {
+            // 符号扩展：翻转符号位再减去它
+            constexpr uint64_t sign = uint64_t{ 1 } << (Length - 1);
+            value                   = (value ^ sign) - sign;
+        }
+        return static_cast<raw_type>(value);
+    }
+
+    /**
+     * 把原始值写入已按本信号字节序加载的字，其余位保持不变
+     */
+    static constexpr uint64_t insert(const uint64_t word, const raw_type raw)
+    {
+        return (word & ~(mask << lsb)) | ((static_cast<uint64_t>(raw) & mask) << lsb);
+    }
+
+    static constexpr float to_physical(const raw_type raw)
+    {
+        if constexpr (identity)
+            return static_cast<float>(raw);
+        else if constexpr (Offset::num == 0)
+            return static_cast<float>(raw) * scale;
+        else
+            return static_cast<float>(raw) * scale + offset;
+    }
+
+    // to_raw 的计算类型：float 只在原始值小于 2^23 时能精确表示整数并正确加 0.5 舍入，
+    // 更长的信号改用 double（Cortex-M4F 上为软件浮点，只有这些信号付出这个代价）
+    using calc_type = std::conditional_t<(Length <= 23), float, double>;
+
+    /**
+     * 物理值转换为原始值：四舍五入，超出范围时饱和，NaN 得到 raw_min
+     */
+    static constexpr raw_type to_raw(const float value)
+    {
+        constexpr calc_type scale_c  = detail::ratio_value<Scale, calc_type>();
+        constexpr calc_type offset_c = detail::ratio_value<Offset, calc_type>();
+        // raw_max 转成 calc_type 时可能向上取整（例如 2^32 - 1 转 float 得 2^32），
+        // 所以先舍入再与边界比较，只有严格落在边界之内的值才做整数转换，转换不会越界
+        const calc_type r = identity ? static_cast<calc_type>(value)
+                                     : (static_cast<calc_type>(value) - offset_c) / scale_c;
+        const calc_type rounded = r + (r < 0 ? calc_type(-0.5) : calc_type(0.5));
+        if (!(rounded > static_cast<calc_type>(raw_min)))
+            return raw_min;
+        if (rounded >= static_cast<calc_type>(raw_max))
+            return raw_max;
+        return static_cast<raw_type>(rounded);
+    }
+
+    /**
+     * 从 8 字节数据中解出原始值
+     */
+    static constexpr raw_type unpack_raw(const uint8_t data[8])
+    {
+        return extract(detail::to_order<Order>(detail::load_le(data)));
+    }
+
+    /**
+     * 把原始值写入 8 字节数据，其余信号保持不变
+     */
+    static constexpr void pack_raw(uint8_t data[8], const raw_type raw)
+    {
+        const uint64_t word = insert(detail::to_order<Order>(detail::load_le(data)), raw);
+        detail::store_le(data, detail::to_order<Order>(word));
+    }
+
+    /**
+     * 从 8 字节数据中解出物理值
+     */
+    static constexpr float unpack(const uint8_t data[8]) { return to_physical(unpack_raw(data)); }
+
+    /**
+     * 把物理值写入 8 字节数据，其余信号保持不变
+     */
+    static constexpr void pack(uint8_t data[8], const float value) { pack_raw(data, to_raw(value)); }
+};
+
+/**
+ * 结构体成员与信号的对应关系，用于 Message
+ *
+ * @tparam Member 成员指针，例如 &Feedback::rpm
+ * @tparam Sig Signal
+ */
+template <auto Member, typename Sig> struct Field
+{
+    using signal = Sig;
+
+    template <typename T> static constexpr void unpack(const uint64_t le_word, T& out)
+    {
+        using member_type = std::remove_reference_t<decltype(out.*Member)>;
+
+        const auto raw = Sig::extract(detail::to_order<Sig::order>(le_word));
+        if constexpr (std::is_integral_v<member_type> && Sig::identity)
+            out.*Member = static_cast<member_type>(raw);
+        else
+            out.*Member = static_cast<member_type>(Sig::to_physical(raw));
+    }
+
+    template <typename T> static constexpr uint64_t pack(const uint64_t le_word, const T& in)
+    {
+        using member_type = std::remove_cv_t<std::remove_reference_t<decltype(in.*Member)>>;
+
+        typename Sig::raw_type raw{};
+        if constexpr (std::is_integral_v<member_type> && Sig::identity)
+            raw = static_cast<typename Sig::raw_type>(in.*Member);
+        else
+            raw = Sig::to_raw(static_cast<float>(in.*Member));
+        return detail::to_order<Sig::order>(Sig::insert(detail::to_order<Sig::order>(le_word), raw));
+    }
+};
+
+/**
+ * 一帧报文：由若干 Field 组成的整帧解码 / 编码器
+ *
+ * 整帧只加载（或写回）一次，各字段的移位与掩码在编译期展开
+ */
+template <typename... Fields> struct Message
+{
+    /**
+     * 从 8 字节数据中解出所有字段
+     */
+    template <typename T> static constexpr void unpack(const uint8_t data[8], T& out)
+    {
+        const uint64_t word = detail::load_le(data);
+        (Fields::unpack(word, out), ...);
+    }
+
+    /**
+     * 把所有字段写入 8 字节数据，未被任何字段覆盖的位保持不变
+     */
+    template <typename T> static constexpr void pack(const T& in, uint8_t data[8])
+    {
+        uint64_t word = detail::load_le(data);
+        ((word = Fields::pack(word, in)), ...);
+        detail::store_le(data, word);
+    }
+};
+
+} // namespace can_signal
@@ -0,0 +1,1418 @@
+/**
+ * @file    fdcan_driver.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   can_driver 的 FDCAN 后端
+ *
+ * --------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Project repository: https://github.com/HITSZ-WTRobot-Packages/BasicComponents
+ */
+#include "can_driver.hpp"
+
+// bxCAN 后端的实现见 can_driver.cpp
+#if defined(HAL_FDCAN_MODULE_ENABLED)
+
+#    include "isr_lock.h"
+
+#    include <cassert>
+#    include <cstring>
+
+namespace
+{
+
+static_assert(CAN_MAX_ID_CALLBACK_NUM < 0xFF, "CAN_MAX_ID_CALLBACK_NUM must fit in uint8_t");
+static_assert(CAN_EXT_ID_TABLE_SIZE >= 2 && (CAN_EXT_ID_TABLE_SIZE & (CAN_EXT_ID_TABLE_SIZE - 1)) == 0,
+              "CAN_EXT_ID_TABLE_SIZE must be a power of 2");
+static_assert(CAN_TX_STATUS_HISTORY_SIZE >= 1 && (CAN_TX_STATUS_HISTORY_SIZE & (CAN_TX_STATUS_HISTORY_SIZE - 1)) == 0,
+              "CAN_TX_STATUS_HISTORY_SIZE must be a power of 2");
+static_assert(CAN_FD_TX_BUFFER_NUM >= 1 && CAN_FD_TX_BUFFER_NUM <= 32, "CAN_FD_TX_BUFFER_NUM must be 1 ~ 32");
+static_assert(CAN_TX_QUEUE_SIZE >= 1 && CAN_TX_QUEUE_SIZE < 0xFF, "CAN_TX_QUEUE_SIZE must fit in uint8_t");
+
+constexpr uint32_t CAN_STD_ID_NUM  = 0x800;
+constexpr uint32_t CAN_STD_ID_MASK = 0x7FF;
+constexpr uint32_t CAN_EXT_ID_MASK = 0x1FFFFFFF;
+
+// 所有 TX Buffer 的位掩码，用于开启发送完成 / 中止中断
+constexpr uint32_t CAN_TX_BUFFER_ALL =
+        CAN_FD_TX_BUFFER_NUM >= 32 ? 0xFFFFFFFFU : (1U << CAN_FD_TX_BUFFER_NUM) - 1U;
+
+// FDCAN_DLC_BYTES_x 在 H7 与早期 G4 HAL 中位于 [19:16]，在新版 G4 HAL 中位于 [3:0]
+constexpr uint32_t CAN_DLC_SHIFT = FDCAN_DLC_BYTES_64 > 0xFU ? 16 : 0;
+
+// DLC 编码 -> 数据长度
+constexpr uint8_t CAN_DLC_LENGTH[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+/**
+ * 计算 CAN 帧的仲裁优先级，数值越小越优先
+ *
+ * 与总线仲裁顺序一致：先比较 11 位基本 ID；基本 ID 相同时标准帧优先于扩展帧；
+ * 再比较扩展帧低 18 位；最后数据帧优先于远程帧。CAN FD 帧没有远程帧，仲裁段与经典帧相同
+ */
+uint32_t arbitration_key(const FDCAN_TxHeaderTypeDef* header)
+{
+    const uint32_t rtr = header->TxFrameType == FDCAN_REMOTE_FRAME ? 1U : 0U;
+    if (header->IdType == FDCAN_STANDARD_ID)
+        return (header->Identifier & CAN_STD_ID_MASK) << 20 | rtr;
+    const uint32_t ext_id = header->Identifier & CAN_EXT_ID_MASK;
+    return (ext_id >> 18) << 20 | 1U << 19 | (ext_id & 0x3FFFF) << 1 | rtr;
+}
+
+/**
+ * 按仲裁优先级排序的有界发送队列，与 bxCAN 后端相同
+ *
+ * 以小根堆实现，堆中只保存槽位下标，入队 / 出队时不搬移报文本身。
+ * 相同 ID 的帧按入队顺序发送
+ */
+class CAN_TxQueue
+{
+public:
+    CAN_TxQueue()
+    {
+        for (size_t i = 0; i < CAN_TX_QUEUE_SIZE; i++)
+            free_[i] = static_cast<uint8_t>(i);
+    }
+
+    /**
+     * 入队一帧
+     * @param policy 队列已满时的处理策略
+     * @param ticket 该帧的发送票据
+     * @param latest 是否允许被 replace_latest 覆盖
+     * @param evicted 返回 Evicted 时写入被丢弃帧的票据
+     */
+    enum class PushResult : uint8_t
+    {
+        Queued,  ///< 入队成功
+        Evicted, ///< 入队成功，但丢弃了一帧优先级更低的帧
+        Rejected ///< 新帧被拒绝
+    };
+
+    PushResult push(const FDCAN_TxHeaderTypeDef* header,
+                    const uint8_t                data[],
+                    const CAN_TxDropPolicy       policy,
+                    const CAN_TxTicket           ticket,
+                    const bool                   latest,
+                    CAN_TxTicket*                evicted)
+    {
+        const uint32_t key    = arbitration_key(header);
+        PushResult     result = PushResult::Queued;
+        if (size_ == CAN_TX_QUEUE_SIZE)
+        {
+            if (policy == CAN_TX_REJECT_NEW)
+                return PushResult::Rejected;
+            // 丢弃优先级最低的一帧；如果新帧本身就是最低的，则拒绝新帧
+            const size_t worst = find_worst();
+            if (!less(key, next_seq_, slots_[heap_[worst]]))
+                return PushResult::Rejected;
+            *evicted = slots_[heap_[worst]].ticket;
+            remove_at(worst);
+            result = PushResult::Evicted;
+        }
+
+        const uint8_t slot = free_[CAN_TX_QUEUE_SIZE - 1 - size_];
+        Entry&        e    = slots_[slot];
+        e.key              = key;
+        e.seq              = next_seq_++;
+        e.ticket           = ticket;
+        e.latest           = latest;
+        fill(e, header, data);
+
+        heap_[size_] = slot;
+        sift_up(size_++);
+        return result;
+    }
+
+    /**
+     * 用新帧覆盖队列中同 ID 的待发送帧
+     *
+     * 只覆盖通过 latest 方式入队的帧；被覆盖的帧保持原有的发送顺位，票据换成新帧的票据
+     * @return 被覆盖帧的票据；未找到时返回 CAN_TX_TICKET_INVALID，需要调用 push 入队
+     */
+    CAN_TxTicket replace_latest(const FDCAN_TxHeaderTypeDef* header, const uint8_t data[], const CAN_TxTicket ticket)
+    {
+        const uint32_t key = arbitration_key(header);
+        for (size_t i = 0; i < size_; i++)
+        {
+            Entry& e = slots_[heap_[i]];
+            if (e.latest && e.key == key)
+            {
+                const CAN_TxTicket replaced = e.ticket;
+                e.ticket                    = ticket;
+                fill(e, header, data);
+                return replaced;
+            }
+        }
+        return CAN_TX_TICKET_INVALID;
+    }
+
+    /**
+     * 查看优先级最高的一帧（不出队）
+     * @return 队列为空时返回 nullptr
+     */
+    [[nodiscard]] const CAN_MessageDef* top() const { return size_ == 0 ? nullptr : &slots_[heap_[0]].msg; }
+    [[nodiscard]] CAN_TxTicket top_ticket() const { return size_ == 0 ? CAN_TX_TICKET_INVALID : slots_[heap_[0]].ticket; }
+    [[nodiscard]] bool         top_latest() const { return size_ != 0 && slots_[heap_[0]].latest; }
+
+    [[nodiscard]] bool contains(const CAN_TxTicket ticket) const
+    {
+        for (size_t i = 0; i < size_; i++)
+            if (slots_[heap_[i]].ticket == ticket)
+                return true;
+        return false;
+    }
+
+    /**
+     * 弹出优先级最高的一帧
+     */
+    void pop()
+    {
+        if (size_ > 0)
+            remove_at(0);
+    }
+
+    [[nodiscard]] bool   empty() const { return size_ == 0; }
+    [[nodiscard]] size_t size() const { return size_; }
+
+private:
+    struct Entry
+    {
+        uint32_t       key;
+        uint32_t       seq;
+        CAN_TxTicket   ticket;
+        bool           latest; // 是否只保留最新值
+        CAN_MessageDef msg;
+    };
+
+    static void fill(Entry& e, const FDCAN_TxHeaderTypeDef* header, const uint8_t data[])
+    {
+        const size_t length = CAN_DlcToLength(header->DataLength);
+        assert(length <= CAN_MAX_DATA_LENGTH);
+
+        e.msg.header = *header;
+        // 分两次 memcpy 保证 data 的数据都有效
+        memcpy(e.msg.data, data, length);
+        memset(e.msg.data + length, 0, CAN_MAX_DATA_LENGTH - length);
+    }
+
+    // a 是否比 b 更优先；seq 使用差值比较，回卷后仍保持先入先出
+    static bool less(const uint32_t key, const uint32_t seq, const Entry& b)
+    {
+        if (key != b.key)
+            return key < b.key;
+        return static_cast<int32_t>(seq - b.seq) < 0;
+    }
+    bool less(const size_t i, const size_t j) const
+    {
+        const Entry& a = slots_[heap_[i]];
+        return less(a.key, a.seq, slots_[heap_[j]]);
+    }
+
+    void swap(const size_t i, const size_t j)
+    {
+        const uint8_t t = heap_[i];
+        heap_[i]        = heap_[j];
+        heap_[j]        = t;
+    }
+
+    void sift_up(size_t i)
+    {
+        while (i > 0 && less(i, (i - 1) / 2))
+        {
+            swap(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void sift_down(size_t i)
+    {
+        while (true)
+        {
+            const size_t l    = 2 * i + 1;
+            const size_t r    = l + 1;
+            size_t       best = i;
+            if (l < size_ && less(l, best))
+                best = l;
+            if (r < size_ && less(r, best))
+                best = r;
+            if (best == i)
+                return;
+            swap(i, best);
+            i = best;
+        }
+    }
+
+    // 优先级最低的一帧一定在叶子上，只需扫描后半部分
+    size_t find_worst() const
+    {
+        size_t worst = size_ / 2;
+        for (size_t i = worst + 1; i < size_; i++)
+            if (less(worst, i))
+                worst = i;
+        return worst;
+    }
+
+    void remove_at(const size_t i)
+    {
+        // 归还槽位，再用堆尾填补空位
+        free_[CAN_TX_QUEUE_SIZE - size_] = heap_[i];
+        heap_[i]                         = heap_[--size_];
+        if (i < size_)
+        {
+            sift_up(i);
+            sift_down(i);
+        }
+    }
+
+    Entry    slots_[CAN_TX_QUEUE_SIZE]{};
+    uint8_t  heap_[CAN_TX_QUEUE_SIZE]{};
+    // 空闲槽位栈，free_[0, CAN_TX_QUEUE_SIZE - size_) 为空闲槽位
+    uint8_t  free_[CAN_TX_QUEUE_SIZE]{};
+    size_t   size_{ 0 };
+    uint32_t next_seq_{ 0 };
+};
+
+/**
+ * 发送限速规则（令牌桶），令牌以 1/1000 帧为单位
+ */
+struct CAN_RateLimit
+{
+    uint32_t ide;
+    uint32_t id_low;
+    uint32_t id_high;
+    uint32_t rate;   // 帧 / s，即每 ms 补充 rate 个 1/1000 帧
+    uint32_t burst;  // 令牌桶容量，单位 1/1000 帧
+    uint32_t tokens; // 当前令牌，单位 1/1000 帧
+    uint32_t last_tick;
+};
+
+/**
+ * 一帧结束发送的状态记录
+ */
+struct CAN_TxStatusRecord
+{
+    CAN_TxTicket ticket;
+    CAN_TxStatus status;
+};
+
+/**
+ * 按 ID 分发的回调项
+ */
+struct CAN_IdHandler
+{
+    CAN_IdCallback_t callback;
+    void*            ctx;
+};
+
+/**
+ * 扩展帧 ID 哈希表槽位，handler 为 0 表示空槽
+ */
+struct CAN_ExtIdSlot
+{
+    uint32_t id;
+    uint8_t  handler;
+};
+
+/**
+ * CAN 回调函数表
+ *
+ * @note 分发方式与 bxCAN 后端相同：先按过滤器元素编号查表，再按 ID 查表（标准帧直接索引表，扩展帧开放寻址哈希表），
+ *       最后调用广播回调
+ *
+ * @note TX Buffer 数量有限（G4 只有 3 个），短时间内连续发送的帧在 Buffer 占满后进入软件发送队列，
+ *       Buffer 空出时总是先装入队列中 ID 最小的帧
+ */
+struct CAN_CallbackMap
+{
+    FDCAN_HandleTypeDef*      hcan{ nullptr };
+    CAN_FifoReceiveCallback_t callbacks[CAN_MAX_CALLBACK_NUM]{};
+    uint32_t                  callback_count{ 0 };
+
+    CAN_IdHandler id_handlers[CAN_MAX_ID_CALLBACK_NUM]{};
+    uint32_t      id_handler_count{ 0 };
+    // 标准帧 ID -> id_handlers 下标 + 1，0 表示未注册
+    uint8_t       std_id_table[CAN_STD_ID_NUM]{};
+    CAN_ExtIdSlot ext_id_table[CAN_EXT_ID_TABLE_SIZE]{};
+    // 过滤器元素编号（FilterIndex）-> 回调，由 CAN_ConfigFilterRoutes 填写
+    CAN_IdHandler std_filter_handlers[CAN_FD_STD_FILTER_NUM]{};
+    CAN_IdHandler ext_filter_handlers[CAN_FD_EXT_FILTER_NUM]{};
+
+    // 按仲裁优先级排序的发送队列，队列长度 CAN_TX_QUEUE_SIZE
+    CAN_TxQueue      tx_queue;
+    CAN_TxDropPolicy tx_drop_policy{ CAN_TX_DROP_LOWEST_PRIORITY };
+
+    // 发送票据：各 TX Buffer 中帧的票据，以及按 ticket % CAN_TX_STATUS_HISTORY_SIZE 存放的结束状态
+    CAN_TxTicket next_ticket{ 1 };
+    CAN_TxTicket buffer_tickets[CAN_FD_TX_BUFFER_NUM]{};
+    // 各 TX Buffer 中帧的仲裁优先级、是否以 latest 方式发送，以及是否因被新值覆盖而请求了取消
+    uint32_t                 buffer_keys[CAN_FD_TX_BUFFER_NUM]{};
+    bool                     buffer_latest[CAN_FD_TX_BUFFER_NUM]{};
+    bool                     buffer_replaced[CAN_FD_TX_BUFFER_NUM]{};
+    CAN_TxStatusRecord       tx_history[CAN_TX_STATUS_HISTORY_SIZE]{};
+    CAN_TxCompleteCallback_t tx_complete_callback{ nullptr };
+    void*                    tx_complete_ctx{ nullptr };
+
+    // 发送限速规则，按设置顺序匹配第一条
+    CAN_RateLimit rate_limits[CAN_MAX_RATE_LIMIT_NUM]{};
+    uint32_t      rate_limit_count{ 0 };
+
+    CAN_BusOffRecovery bus_off_recovery{ CAN_BUS_OFF_RECOVERY_AUTO };
+};
+
+CAN_CallbackMap maps[CAN_NUM];
+size_t          map_size = 0;
+
+// 根据 can handle 的指针查找 can map
+CAN_CallbackMap* get_map(const FDCAN_HandleTypeDef* hcan)
+{
+    for (size_t i = 0; i < map_size; i++)
+        if (maps[i].hcan == hcan)
+            return &maps[i];
+
+    return nullptr;
+}
+
+// 查找 can map，不存在时新建一个
+CAN_CallbackMap* get_or_create_map(FDCAN_HandleTypeDef* hcan)
+{
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map != nullptr)
+        return map;
+
+    if (map_size >= CAN_NUM)
+    {
+        // 仅当 CAN_NUM 配置错误时可能触发，此时进入死循环
+        Error_Handler();
+        return nullptr;
+    }
+    // maps 为静态存储，其余字段已经零初始化
+    map       = &maps[map_size++];
+    map->hcan = hcan;
+    return map;
+}
+
+uint32_t ext_id_hash(const uint32_t ext_id)
+{
+    // 乘法哈希，取高位作为下标
+    return ((ext_id * 0x9E3779B1U) >> 16) & (CAN_EXT_ID_TABLE_SIZE - 1);
+}
+
+// 根据帧头查找按 ID 注册的回调，未注册时返回 nullptr
+const CAN_IdHandler* find_id_handler(const CAN_CallbackMap* map, const FDCAN_RxHeaderTypeDef* header)
+{
+    uint8_t handler = 0;
+    if (header->IdType == FDCAN_STANDARD_ID)
+    {
+        handler = map->std_id_table[header->Identifier & CAN_STD_ID_MASK];
+    }
+    else
+    {
+        // 线性探测，遇到空槽即说明未注册
+        for (uint32_t i = 0, h = ext_id_hash(header->Identifier); i < CAN_EXT_ID_TABLE_SIZE;
+             i++, h = (h + 1) & (CAN_EXT_ID_TABLE_SIZE - 1))
+        {
+            const CAN_ExtIdSlot& slot = map->ext_id_table[h];
+            if (slot.handler == 0)
+                break;
+            if (slot.id == header->Identifier)
+            {
+                handler = slot.handler;
+                break;
+            }
+        }
+    }
+    return handler == 0 ? nullptr : &map->id_handlers[handler - 1];
+}
+
+// 根据帧头中的过滤器元素编号查找 CAN_ConfigFilterRoutes 配置的回调，未命中过滤器元素或未配置时返回 nullptr
+const CAN_IdHandler* find_filter_handler(const CAN_CallbackMap* map, const FDCAN_RxHeaderTypeDef* header)
+{
+    // IsFilterMatchingFrame 为 1 表示未命中任何过滤器元素，是按全局过滤接收的帧
+    if (header->IsFilterMatchingFrame != 0)
+        return nullptr;
+    const CAN_IdHandler* handler = nullptr;
+    if (header->IdType == FDCAN_STANDARD_ID && header->FilterIndex < CAN_FD_STD_FILTER_NUM)
+        handler = &map->std_filter_handlers[header->FilterIndex];
+    else if (header->IdType == FDCAN_EXTENDED_ID && header->FilterIndex < CAN_FD_EXT_FILTER_NUM)
+        handler = &map->ext_filter_handlers[header->FilterIndex];
+    return handler != nullptr && handler->callback != nullptr ? handler : nullptr;
+}
+
+// 向回调表末尾追加一个按 ID 分发的回调，返回 下标 + 1，表满时返回 0
+uint8_t add_id_handler(CAN_CallbackMap* map, const CAN_IdCallback_t callback, void* ctx)
+{
+    if (map->id_handler_count >= CAN_MAX_ID_CALLBACK_NUM)
+        return 0;
+    map->id_handlers[map->id_handler_count] = { callback, ctx };
+    return static_cast<uint8_t>(++map->id_handler_count);
+}
+
+/**
+ * 清空指定 FIFO 并分发到回调函数
+ *
+ * 新消息中断与水位中断都走这里，一次中断取完 FIFO 中的所有帧
+ */
+void receive_fifo(FDCAN_HandleTypeDef* hcan, const uint32_t fifo)
+{
+    const CAN_CallbackMap* map = get_map(hcan);
+
+    while (HAL_FDCAN_GetRxFifoFillLevel(hcan, fifo) > 0)
+    {
+        // 未开启 CAN_FD_ENABLE 时外设工作在经典 CAN 模式，不会收到超过 8 字节的帧
+        FDCAN_RxHeaderTypeDef header;
+        uint8_t               data[CAN_MAX_DATA_LENGTH];
+        if (HAL_FDCAN_GetRxMessage(hcan, fifo, &header, data) != HAL_OK)
+        {
+            Error_Handler();
+            return;
+        }
+
+        // 如果该 CAN 未被注册，仍需取出数据以清空 FIFO
+        if (map == nullptr)
+            continue;
+
+        // 优先按过滤器元素编号分发，命中时无需再做软件过滤
+        const CAN_IdHandler* handler = find_filter_handler(map, &header);
+        if (handler == nullptr)
+            handler = find_id_handler(map, &header);
+        if (handler != nullptr)
+            handler->callback(hcan, &header, data, handler->ctx);
+
+        // 依次调用所有的广播回调函数
+        for (size_t i = 0; i < map->callback_count; i++)
+            map->callbacks[i](hcan, &header, data);
+    }
+}
+
+/**
+ * 分配一个发送票据，调用前需处于临界区内
+ */
+CAN_TxTicket new_ticket(CAN_CallbackMap* map)
+{
+    const CAN_TxTicket ticket = map->next_ticket++;
+    if (map->next_ticket == CAN_TX_TICKET_INVALID)
+        map->next_ticket++;
+    return ticket;
+}
+
+/**
+ * TX Buffer 位掩码（只有一位）转换为下标
+ */
+size_t buffer_index(const uint32_t buffer)
+{
+    return static_cast<size_t>(__builtin_ctz(buffer));
+}
+
+/**
+ * 记录一帧的结束状态并通知发送结束回调
+ */
+void finish_tx(CAN_CallbackMap* map, const CAN_TxTicket ticket, const CAN_TxStatus status)
+{
+    if (ticket == CAN_TX_TICKET_INVALID)
+        return;
+    map->tx_history[ticket & (CAN_TX_STATUS_HISTORY_SIZE - 1)] = { ticket, status };
+    if (map->tx_complete_callback != nullptr)
+        map->tx_complete_callback(map->hcan, ticket, status, map->tx_complete_ctx);
+}
+
+/**
+ * 按限速规则检查一帧能否发送，调用前需处于临界区内
+ *
+ * 超出限速时记录 CAN_TX_STATUS_RATE_LIMITED
+ * @return 允许发送返回 true
+ */
+bool rate_limit_allow(CAN_CallbackMap* map, const FDCAN_TxHeaderTypeDef* header, const CAN_TxTicket ticket)
+{
+    const uint32_t id = header->Identifier;
+    for (uint32_t i = 0; i < map->rate_limit_count; i++)
+    {
+        CAN_RateLimit& limit = map->rate_limits[i];
+        if (limit.ide != header->IdType || id < limit.id_low || id > limit.id_high)
+            continue;
+
+        // 补充令牌
+        const uint32_t now    = HAL_GetTick();
+        const uint64_t refill = static_cast<uint64_t>(now - limit.last_tick) * limit.rate + limit.tokens;
+        limit.tokens          = refill > limit.burst ? limit.burst : static_cast<uint32_t>(refill);
+        limit.last_tick       = now;
+        if (limit.tokens >= 1000)
+        {
+            limit.tokens -= 1000;
+            return true;
+        }
+        finish_tx(map, ticket, CAN_TX_STATUS_RATE_LIMITED);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 硬件 TX FIFO / Queue 是否已满
+ *
+ * 不能用 TFFL 判断，Queue 模式下 TFFL 总是读为 0
+ */
+bool tx_fifo_full(const FDCAN_HandleTypeDef* hcan)
+{
+    return (hcan->Instance->TXFQS & FDCAN_TXFQS_TFQF) != 0;
+}
+
+/**
+ * 新帧能否装入下一个空闲 TX Buffer（TXFQS.TFQPI），调用前需处于临界区内
+ *
+ * Queue 模式下相同 ID 的 Buffer 按编号而不是请求顺序发送，下一个空闲 Buffer 的编号小于 Buffer 中同 ID 的帧时，
+ * 新帧会先于它发出（ISO-TP 连续帧等依赖提交顺序），此时新帧需要在队列中等待该 Buffer 发完。
+ * FIFO 模式按请求顺序发送，总是可以装入
+ */
+bool buffer_accepts(const FDCAN_HandleTypeDef* hcan, const CAN_CallbackMap* map, const uint32_t key)
+{
+    if (map == nullptr || (hcan->Instance->TXBC & FDCAN_TXBC_TFQM) == 0)
+        return true;
+    const uint32_t put = (hcan->Instance->TXFQS & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+    for (size_t i = put + 1; i < CAN_FD_TX_BUFFER_NUM; i++)
+        if (map->buffer_tickets[i] != CAN_TX_TICKET_INVALID && map->buffer_keys[i] == key)
+            return false;
+    return true;
+}
+
+/**
+ * 取出一组 TX Buffer 中尚未结束的票据，调用前需处于临界区内
+ * @param status 发送结果；因被新值覆盖而取消的帧改为 CAN_TX_STATUS_REPLACED
+ * @param records 输出票据与状态
+ * @return 取出的票据数
+ */
+size_t take_buffers(CAN_CallbackMap* map, const uint32_t buffers, const CAN_TxStatus status, CAN_TxStatusRecord records[])
+{
+    size_t count = 0;
+    for (size_t i = 0; i < CAN_FD_TX_BUFFER_NUM; i++)
+    {
+        if (!(buffers & (1U << i)) || map->buffer_tickets[i] == CAN_TX_TICKET_INVALID)
+            continue;
+        const bool replaced     = status == CAN_TX_STATUS_ABORTED && map->buffer_replaced[i];
+        records[count++]        = { map->buffer_tickets[i], replaced ? CAN_TX_STATUS_REPLACED : status };
+        map->buffer_tickets[i]  = CAN_TX_TICKET_INVALID;
+        map->buffer_replaced[i] = false;
+    }
+    return count;
+}
+
+/**
+ * 取出已结束发送、但还没有处理的 TX Buffer 的票据，调用前需处于临界区内
+ *
+ * 以 TXBTO / TXBCF 为准，而不是发送完成 / 中止中断传入的 Buffer：中断被屏蔽时 Buffer 可能已经发完而票据还没有结束，
+ * 写 TXBAR 会清除该 Buffer 的 TXBTO / TXBCF，之后的中断再也看不到这一帧，新票据还会覆盖旧票据；
+ * 反过来 HAL 在屏蔽中断前读到的 Buffer 可能已经装入了新帧。
+ * 取消请求到达时帧已在总线上发送的，发送成功后 TXBTO 与 TXBCF 同时置位，按发送成功处理
+ * （TXBTO 在 Buffer 重新请求发送时才清除，所以置位的就是这一帧）
+ * @param reaped 输出结束的票据与状态，由调用方在补满 Buffer 后通知，至少 CAN_FD_TX_BUFFER_NUM 项
+ * @return 结束的 Buffer 数
+ */
+size_t reap_buffers(const FDCAN_HandleTypeDef* hcan, CAN_CallbackMap* map, CAN_TxStatusRecord reaped[])
+{
+    bool tracked = false;
+    for (const CAN_TxTicket t : map->buffer_tickets)
+        tracked = tracked || t != CAN_TX_TICKET_INVALID;
+    if (!tracked)
+        return 0;
+
+    const uint32_t transmitted = hcan->Instance->TXBTO;
+    const size_t   count       = take_buffers(map, transmitted, CAN_TX_STATUS_SENT, reaped);
+    return count + take_buffers(map, hcan->Instance->TXBCF & ~transmitted, CAN_TX_STATUS_ABORTED, reaped + count);
+}
+
+/**
+ * 把一帧装入下一个空闲 TX Buffer，调用前需确认 FIFO 未满并处于临界区内
+ * @return TX Buffer 位掩码；CAN_SEND_FAILED 表示外设未启动
+ */
+uint32_t add_tx_message(FDCAN_HandleTypeDef*         hcan,
+                        CAN_CallbackMap*             map,
+                        const FDCAN_TxHeaderTypeDef* header,
+                        const uint8_t                data[],
+                        const CAN_TxTicket           ticket,
+                        const bool                   latest = false)
+{
+    if (HAL_FDCAN_AddMessageToTxFifoQ(hcan, header, data) != HAL_OK)
+        return CAN_SEND_FAILED;
+    const uint32_t buffer = HAL_FDCAN_GetLatestTxFifoQRequestBuffer(hcan);
+    if (map != nullptr && buffer != 0)
+    {
+        const size_t index          = buffer_index(buffer);
+        map->buffer_tickets[index]  = ticket;
+        map->buffer_keys[index]     = arbitration_key(header);
+        map->buffer_latest[index]   = latest;
+        map->buffer_replaced[index] = false;
+    }
+    return buffer;
+}
+
+/**
+ * 把一帧放入软件发送队列，调用前需处于临界区内；队列满时按 tx_drop_policy 处理
+ * @return 新帧是否入队
+ */
+bool queue_tx_message(CAN_CallbackMap*             map,
+                      const FDCAN_TxHeaderTypeDef* header,
+                      const uint8_t                data[],
+                      const CAN_TxTicket           ticket,
+                      const bool                   latest)
+{
+    CAN_TxTicket evicted = CAN_TX_TICKET_INVALID;
+    const auto   result  = map->tx_queue.push(header, data, map->tx_drop_policy, ticket, latest, &evicted);
+    if (result == CAN_TxQueue::PushResult::Rejected)
+    {
+        finish_tx(map, ticket, CAN_TX_STATUS_DROPPED);
+        return false;
+    }
+    if (result == CAN_TxQueue::PushResult::Evicted)
+        finish_tx(map, evicted, CAN_TX_STATUS_DROPPED);
+    return true;
+}
+
+/**
+ * 取消 TX Buffer 中同 ID、以 latest 方式发送的旧值，调用前需处于临界区内
+ *
+ * 尚未开始发送的旧帧取消后立即以 CAN_TX_STATUS_REPLACED 结束；正在发送的旧帧无法取消，
+ * 发送成功时照常以 SENT 结束，失败时在中止回调中以 REPLACED 结束
+ * @return 是否已取消 Buffer 中的旧帧
+ */
+bool replace_buffer_latest(FDCAN_HandleTypeDef* hcan, CAN_CallbackMap* map, const FDCAN_TxHeaderTypeDef* header)
+{
+    const uint32_t key = arbitration_key(header);
+    for (size_t i = 0; i < CAN_FD_TX_BUFFER_NUM; i++)
+    {
+        if (map->buffer_tickets[i] == CAN_TX_TICKET_INVALID || !map->buffer_latest[i] || map->buffer_replaced[i] ||
+            map->buffer_keys[i] != key)
+            continue;
+
+        const uint32_t bit = 1U << i;
+        (void) HAL_FDCAN_AbortTxRequest(hcan, bit);
+        // 没有在发送的 Buffer 取消后立即清除 TXBRP 并置位 TXBCF；否则等待中止回调
+        if ((hcan->Instance->TXBCF & bit) == 0 || (hcan->Instance->TXBTO & bit) != 0)
+        {
+            map->buffer_replaced[i] = true;
+            return false;
+        }
+        const CAN_TxTicket replaced = map->buffer_tickets[i];
+        map->buffer_tickets[i]      = CAN_TX_TICKET_INVALID;
+        finish_tx(map, replaced, CAN_TX_STATUS_REPLACED);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * 用软件队列中最紧急的帧填满空闲 TX Buffer，调用前需处于临界区内
+ *
+ * 先结束已发完但中断尚未处理的 Buffer（见 reap_buffers），补满 Buffer 后再通知它们的结果，
+ * 回调中发送的下一帧不会越过队列中已在等待的帧
+ */
+void refill_buffers(FDCAN_HandleTypeDef* hcan, CAN_CallbackMap* map)
+{
+    CAN_TxStatusRecord reaped[CAN_FD_TX_BUFFER_NUM];
+    const size_t       reaped_count = reap_buffers(hcan, map, reaped);
+
+    // 每次都装入当前最紧急的一帧；装入后会越过 Buffer 中同 ID 的帧时，等该 Buffer 发完
+    while (!map->tx_queue.empty() && !tx_fifo_full(hcan))
+    {
+        const auto msg = map->tx_queue.top();
+        if (!buffer_accepts(hcan, map, arbitration_key(&msg->header)))
+            break;
+        if (add_tx_message(hcan, map, &msg->header, msg->data, map->tx_queue.top_ticket(), map->tx_queue.top_latest()) ==
+            CAN_SEND_FAILED)
+            break;
+        map->tx_queue.pop();
+    }
+
+    for (size_t i = 0; i < reaped_count; i++)
+        finish_tx(map, reaped[i].ticket, reaped[i].status);
+}
+
+/**
+ * 发送一帧：有空闲 TX Buffer 时直接装入，否则进入软件发送队列，调用前需处于临界区内
+ * @param latest 是否以“最新值”方式发送，见 CAN_SendLatest
+ * @return TX Buffer 位掩码 / CAN_SEND_QUEUED / CAN_SEND_FAILED
+ */
+uint32_t send_locked(FDCAN_HandleTypeDef*         hcan,
+                     CAN_CallbackMap*             map,
+                     const FDCAN_TxHeaderTypeDef* header,
+                     const uint8_t                data[],
+                     const CAN_TxTicket           ticket,
+                     const bool                   latest)
+{
+    if (map != nullptr)
+    {
+        // 先结束中断尚未处理的 Buffer，并让队列中等待的帧优先装入
+        refill_buffers(hcan, map);
+
+        // 队列中已有同 ID 的旧值时必须覆盖它，否则旧值会在新值之后被发出
+        bool replaced_buffer = false;
+        if (latest)
+        {
+            const CAN_TxTicket replaced = map->tx_queue.replace_latest(header, data, ticket);
+            if (replaced != CAN_TX_TICKET_INVALID)
+            {
+                finish_tx(map, replaced, CAN_TX_STATUS_REPLACED);
+                return CAN_SEND_QUEUED;
+            }
+            // 总线繁忙时旧值可能还停在 Buffer 里，同样要取消，新值随后装入空出的 Buffer
+            replaced_buffer = replace_buffer_latest(hcan, map, header);
+        }
+
+        // 覆盖旧值不增加总线上的帧数，只有新增的帧才受限速约束
+        if (!replaced_buffer && !rate_limit_allow(map, header, ticket))
+            return CAN_SEND_FAILED;
+    }
+
+    // 直接执行发送；装入后会越过 Buffer 中同 ID 的帧时排队
+    if (!tx_fifo_full(hcan) && buffer_accepts(hcan, map, arbitration_key(header)))
+    {
+        const uint32_t buffer = add_tx_message(hcan, map, header, data, ticket, latest);
+        if (buffer == CAN_SEND_FAILED && map != nullptr)
+            finish_tx(map, ticket, CAN_TX_STATUS_ABORTED);
+        return buffer;
+    }
+    // 已满，加入队列
+    if (map != nullptr && queue_tx_message(map, header, data, ticket, latest))
+        return CAN_SEND_QUEUED;
+    return CAN_SEND_FAILED;
+}
+
+/**
+ * TX Buffer 结束发送：记录结束状态，并用队列中最紧急的帧填充空闲 Buffer
+ */
+void complete_buffers(FDCAN_HandleTypeDef* hcan)
+{
+    // 接收回调可能在更高优先级的中断中发送，这里同样需要临界区
+    ISRGuard         guard;
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map != nullptr)
+        refill_buffers(hcan, map);
+}
+
+} // namespace
+
+/**
+ * FDCAN DataLength 编码转换为数据长度
+ * @param data_length FDCAN_DLC_BYTES_x
+ * @return 数据长度，0 ~ 64
+ */
+uint8_t CAN_DlcToLength(const uint32_t data_length)
+{
+    return CAN_DLC_LENGTH[(data_length >> CAN_DLC_SHIFT) & 0xF];
+}
+
+/**
+ * 数据长度转换为 FDCAN DataLength 编码
+ *
+ * CAN FD 只支持 0 ~ 8、12、16、20、24、32、48、64 字节，其余长度向上取整，超过 64 按 64 处理
+ * @param length 数据长度
+ * @return FDCAN_DLC_BYTES_x
+ */
+uint32_t CAN_LengthToDlc(const size_t length)
+{
+    uint32_t dlc = 0;
+    while (dlc < 15 && CAN_DLC_LENGTH[dlc] < length)
+        dlc++;
+    return dlc << CAN_DLC_SHIFT;
+}
+
+/**
+ * 发送一条 CAN 消息
+ *
+ * 有空闲 TX Buffer 时直接装入硬件 TX FIFO / Queue，否则按仲裁优先级进入软件发送队列，
+ * Buffer 空出时总是先发送队列中 ID 最小的帧
+ * @param hcan can handle
+ * @param header FDCAN_TxHeaderTypeDef，CAN FD 帧需设置 FDFormat = FDCAN_FD_CAN，
+ *               BitRateSwitch = FDCAN_BRS_ON 时数据段使用 CubeMX 中配置的数据段波特率
+ * @param data 数据，长度由 header->DataLength 决定
+ * @param ticket 可为 nullptr；否则写入该帧的发送票据，可用于 CAN_GetTxStatus 查询，
+ *               未调用 CAN_InitMainCallback 时为 CAN_TX_TICKET_INVALID
+ * @note 本函数是线程安全的，可在任意优先级的中断中调用
+ * @return TX Buffer 位掩码（FDCAN_TX_BUFFERx）；CAN_SEND_QUEUED 表示已进入软件发送队列；CAN_SEND_FAILED 表示发送失败
+ */
+uint32_t CAN_SendMessage(FDCAN_HandleTypeDef*         hcan,
+                         const FDCAN_TxHeaderTypeDef* header,
+                         const uint8_t                data[],
+                         CAN_TxTicket*                ticket)
+{
+    // 锁定中断，保证装入 Buffer 与记录票据之间不会进入发送完成中断
+    ISRGuard           guard;
+    CAN_CallbackMap*   map = get_map(hcan);
+    const CAN_TxTicket t   = map != nullptr ? new_ticket(map) : CAN_TX_TICKET_INVALID;
+    if (ticket != nullptr)
+        *ticket = t;
+
+    return send_locked(hcan, map, header, data, t, false);
+}
+
+size_t can_driver_detail::send_batch(FDCAN_HandleTypeDef* hcan,
+                                     const void*          msgs,
+                                     const size_t         stride,
+                                     const size_t         data_offset,
+                                     const size_t         count,
+                                     uint32_t*            buffers,
+                                     CAN_TxTicket*        tickets)
+{
+    assert(msgs != nullptr || count == 0);
+
+    ISRGuard         guard;
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map != nullptr)
+        refill_buffers(hcan, map);
+
+    size_t accepted = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto*        msg    = static_cast<const uint8_t*>(msgs) + i * stride;
+        const auto*        header = reinterpret_cast<const FDCAN_TxHeaderTypeDef*>(msg);
+        const uint8_t*     data   = msg + data_offset;
+        uint32_t           buffer = CAN_SEND_FAILED;
+        const CAN_TxTicket ticket = map != nullptr ? new_ticket(map) : CAN_TX_TICKET_INVALID;
+        if (map != nullptr && !rate_limit_allow(map, header, ticket))
+        {
+            // 被限速，不占用 Buffer
+        }
+        else if (!tx_fifo_full(hcan) && buffer_accepts(hcan, map, arbitration_key(header)))
+        {
+            buffer = add_tx_message(hcan, map, header, data, ticket);
+            if (buffer != CAN_SEND_FAILED)
+                accepted++;
+            else if (map != nullptr)
+                finish_tx(map, ticket, CAN_TX_STATUS_ABORTED);
+        }
+        else if (map != nullptr && queue_tx_message(map, header, data, ticket, false))
+        {
+            buffer = CAN_SEND_QUEUED;
+            accepted++;
+        }
+        if (buffers != nullptr)
+            buffers[i] = buffer;
+        if (tickets != nullptr)
+            tickets[i] = ticket;
+    }
+    return accepted;
+}
+
+/**
+ * 以“最新值”方式发送一条 CAN 消息
+ *
+ * 适用于周期性的设定值帧（如电机电流指令）：每条 CAN 上每个 ID 最多只有一帧在等待发送，
+ * 新帧直接覆盖尚未发出的旧帧，而不是再次排队。旧帧在软件队列中时原位覆盖；已装入 TX Buffer 但尚未
+ * 开始发送时取消该 Buffer，新帧重新装入。总线过载时不会积压过期指令，也不会因为队列被旧指令占满而丢掉新指令
+ * @param hcan can handle
+ * @param header FDCAN_TxHeaderTypeDef
+ * @param data 数据
+ * @param ticket 可为 nullptr；否则写入新帧的发送票据，被覆盖的旧帧以 CAN_TX_STATUS_REPLACED 结束
+ * @note 本函数是线程安全的；正在总线上发送的旧帧无法取消，会先于新帧发出
+ * @note 同一 ID 请不要混用 CAN_SendMessage 与本函数，前者发送的帧不会被覆盖
+ * @return TX Buffer 位掩码；CAN_SEND_QUEUED 表示已入队或已覆盖队列中的旧值；CAN_SEND_FAILED 表示发送失败
+ */
+uint32_t CAN_SendLatest(FDCAN_HandleTypeDef*         hcan,
+                        const FDCAN_TxHeaderTypeDef* header,
+                        const uint8_t                data[],
+                        CAN_TxTicket*                ticket)
+{
+    ISRGuard           guard;
+    CAN_CallbackMap*   map = get_map(hcan);
+    const CAN_TxTicket t   = map != nullptr ? new_ticket(map) : CAN_TX_TICKET_INVALID;
+    if (ticket != nullptr)
+        *ticket = t;
+
+    return send_locked(hcan, map, header, data, t, true);
+}
+
+/**
+ * 为一段 ID 设置发送限速
+ *
+ * 令牌桶限速：平均不超过 frames_per_second 帧 / s，允许连续突发 burst 帧。
+ * 超出限速的帧直接拒绝（返回 CAN_SEND_FAILED，状态为 CAN_TX_STATUS_RATE_LIMITED），
+ * 不进入发送队列，因此遥测等低优先级流量不会挤占控制帧的 TX Buffer 与队列。
+ * 一帧按设置顺序匹配第一条规则，未匹配任何规则的帧不受限制
+ * @attention 本函数非线程安全，请在开始发送前完成设置
+ * @param hcan can handle
+ * @param ide FDCAN_STANDARD_ID / FDCAN_EXTENDED_ID
+ * @param id_low ID 下限（含）
+ * @param id_high ID 上限（含）
+ * @param frames_per_second 平均速率，单位 帧 / s
+ * @param burst 最大突发帧数，至少为 1
+ * @return 规则表已满或参数无效时返回 false
+ */
+bool CAN_SetRateLimit(FDCAN_HandleTypeDef* hcan,
+                      const uint32_t       ide,
+                      const uint32_t       id_low,
+                      const uint32_t       id_high,
+                      const uint32_t       frames_per_second,
+                      const uint32_t       burst)
+{
+    if (id_low > id_high || burst == 0 || burst > UINT32_MAX / 1000)
+        return false;
+
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr || map->rate_limit_count >= CAN_MAX_RATE_LIMIT_NUM)
+        return false;
+
+    // 初始时令牌桶是满的
+    map->rate_limits[map->rate_limit_count++] = { ide,
+                                                  id_low,
+                                                  id_high,
+                                                  frames_per_second,
+                                                  burst * 1000,
+                                                  burst * 1000,
+                                                  HAL_GetTick() };
+    return true;
+}
+
+/**
+ * 获取 CAN 控制器的错误状态
+ * @param hcan can handle
+ * @param tec 可为 nullptr；否则写入发送错误计数
+ * @param rec 可为 nullptr；否则写入接收错误计数
+ * @return 错误状态
+ */
+CAN_ErrorState CAN_GetErrorState(FDCAN_HandleTypeDef* hcan, uint8_t* tec, uint8_t* rec)
+{
+    if (tec != nullptr || rec != nullptr)
+    {
+        FDCAN_ErrorCountersTypeDef counters{};
+        (void) HAL_FDCAN_GetErrorCounters(hcan, &counters);
+        if (tec != nullptr)
+            *tec = static_cast<uint8_t>(counters.TxErrorCnt);
+        if (rec != nullptr)
+            *rec = static_cast<uint8_t>(counters.RxErrorCnt);
+    }
+
+    FDCAN_ProtocolStatusTypeDef status{};
+    (void) HAL_FDCAN_GetProtocolStatus(hcan, &status);
+    if (status.BusOff)
+        return CAN_BUS_OFF;
+    if (status.ErrorPassive)
+        return CAN_ERROR_PASSIVE;
+    if (status.Warning)
+        return CAN_ERROR_WARNING;
+    return CAN_ERROR_ACTIVE;
+}
+
+/**
+ * 设置 bus-off 恢复方式
+ *
+ * FDCAN 进入 bus-off 后停留在初始化模式，没有 bxCAN 的 ABOM；自动恢复由驱动在 bus-off 中断中退出初始化模式
+ * @param hcan can handle
+ * @param recovery CAN_BUS_OFF_RECOVERY_AUTO（默认）/ CAN_BUS_OFF_RECOVERY_MANUAL
+ */
+void CAN_SetBusOffRecovery(FDCAN_HandleTypeDef* hcan, const CAN_BusOffRecovery recovery)
+{
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return;
+
+    map->bus_off_recovery = recovery;
+}
+
+/**
+ * 手动从 bus-off 恢复
+ *
+ * 退出初始化模式，之后硬件检测到 129 × 11 个隐性位即重新加入总线。
+ * 仅在 CAN_BUS_OFF_RECOVERY_MANUAL 下需要调用
+ * @param hcan can handle
+ * @return 当前不处于 bus-off 时返回 false
+ */
+bool CAN_RecoverBusOff(FDCAN_HandleTypeDef* hcan)
+{
+    if (CAN_GetErrorState(hcan, nullptr, nullptr) != CAN_BUS_OFF)
+        return false;
+    CLEAR_BIT(hcan->Instance->CCCR, FDCAN_CCCR_INIT);
+    return true;
+}
+
+/**
+ * 查询一帧的发送状态
+ *
+ * 结束发送（SENT / ABORTED / DROPPED / REPLACED / RATE_LIMITED）的状态只保留最近 CAN_TX_STATUS_HISTORY_SIZE 个票据，
+ * 更早的票据返回 CAN_TX_STATUS_UNKNOWN
+ * @param hcan can handle
+ * @param ticket 发送时获得的票据
+ * @note 本函数是线程安全的
+ * @return 发送状态
+ */
+CAN_TxStatus CAN_GetTxStatus(const FDCAN_HandleTypeDef* hcan, const CAN_TxTicket ticket)
+{
+    if (ticket == CAN_TX_TICKET_INVALID)
+        return CAN_TX_STATUS_UNKNOWN;
+
+    ISRGuard               guard;
+    const CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return CAN_TX_STATUS_UNKNOWN;
+
+    for (const CAN_TxTicket t : map->buffer_tickets)
+        if (t == ticket)
+            return CAN_TX_STATUS_PENDING;
+    if (map->tx_queue.contains(ticket))
+        return CAN_TX_STATUS_QUEUED;
+
+    const CAN_TxStatusRecord& record = map->tx_history[ticket & (CAN_TX_STATUS_HISTORY_SIZE - 1)];
+    return record.ticket == ticket ? record.status : CAN_TX_STATUS_UNKNOWN;
+}
+
+/**
+ * 查询一帧是否已成功发送
+ * @param hcan can handle
+ * @param ticket 发送时获得的票据
+ * @return 已成功发送返回 true
+ */
+bool CAN_IsSent(const FDCAN_HandleTypeDef* hcan, const CAN_TxTicket ticket)
+{
+    return CAN_GetTxStatus(hcan, ticket) == CAN_TX_STATUS_SENT;
+}
+
+/**
+ * 设置帧发送结束回调
+ * @param hcan can handle
+ * @param callback 回调函数，nullptr 表示取消
+ * @param ctx 用户上下文，回调时原样传回
+ */
+void CAN_SetTxCompleteCallback(FDCAN_HandleTypeDef* hcan, const CAN_TxCompleteCallback_t callback, void* ctx)
+{
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return;
+
+    ISRGuard guard;
+    map->tx_complete_callback = callback;
+    map->tx_complete_ctx      = ctx;
+}
+
+/**
+ * 获取当前的帧发送结束回调，用于在接管回调时保留原有的回调
+ * @param hcan can handle
+ * @param callback 写入回调函数，未设置时为 nullptr
+ * @param ctx 写入用户上下文
+ */
+void CAN_GetTxCompleteCallback(const FDCAN_HandleTypeDef* hcan, CAN_TxCompleteCallback_t* callback, void** ctx)
+{
+    *callback = nullptr;
+    *ctx      = nullptr;
+    CAN_CallbackMap* map = get_map(hcan);
+    if (map == nullptr)
+        return;
+
+    ISRGuard guard;
+    *callback = map->tx_complete_callback;
+    *ctx      = map->tx_complete_ctx;
+}
+
+/**
+ * 设置发送队列已满时的处理策略
+ *
+ * @param hcan can handle
+ * @param policy CAN_TX_DROP_LOWEST_PRIORITY（默认）/ CAN_TX_REJECT_NEW
+ */
+void CAN_SetTxDropPolicy(FDCAN_HandleTypeDef* hcan, const CAN_TxDropPolicy policy)
+{
+    if (CAN_CallbackMap* map = get_or_create_map(hcan); map != nullptr)
+    {
+        ISRGuard guard;
+        map->tx_drop_policy = policy;
+    }
+}
+
+/**
+ * CAN 初始化
+ *
+ * 使用水位中断时（H7），只有 FIFO 中的帧数达到 CAN_FD_RX_WATERMARK 才会触发接收，适合高帧率的数据流；
+ * 对单帧延迟敏感的 FIFO 请使用新消息中断
+ * @param hcan can handle
+ * @param ActiveITs FDCAN_IT_RX_FIFO0_NEW_MESSAGE / FDCAN_IT_RX_FIFO0_WATERMARK 以及 FIFO1 对应的中断
+ */
+void CAN_Start(FDCAN_HandleTypeDef* hcan, const uint32_t ActiveITs)
+{
+#if CAN_FD_RX_WATERMARK > 0 && defined(FDCAN_IT_RX_FIFO0_WATERMARK)
+    // 水位只能在初始化模式下配置，需在启动前完成
+    if ((ActiveITs & FDCAN_IT_RX_FIFO0_WATERMARK) &&
+        HAL_FDCAN_ConfigFifoWatermark(hcan, FDCAN_CFG_RX_FIFO0, CAN_FD_RX_WATERMARK) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    if ((ActiveITs & FDCAN_IT_RX_FIFO1_WATERMARK) &&
+        HAL_FDCAN_ConfigFifoWatermark(hcan, FDCAN_CFG_RX_FIFO1, CAN_FD_RX_WATERMARK) != HAL_OK)
+    {
+        Error_Handler();
+    }
+#endif
+
+    // 启动 CAN
+    if (HAL_FDCAN_Start(hcan) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // 开启 CAN 中断
+    // 发送票据依赖发送完成 / 中止中断，bus-off 自动恢复依赖 bus-off 中断，所以必须开启
+    const uint32_t its = ActiveITs | FDCAN_IT_TX_COMPLETE | FDCAN_IT_TX_ABORT_COMPLETE | FDCAN_IT_BUS_OFF;
+    if (HAL_FDCAN_ActivateNotification(hcan, its, CAN_TX_BUFFER_ALL) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+
+/**
+ * 注册 CAN Fifo 处理回调
+ *
+ * @attention 本函数非线程安全，调用时请注意
+ * @param hcan hcan
+ * @param callback 回调函数指针
+ */
+void CAN_RegisterCallback(FDCAN_HandleTypeDef* hcan, const CAN_FifoReceiveCallback_t callback)
+{
+    // 查找回调函数表，如果表未创建则新建一个
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return;
+
+    // 如果回调函数表未满，则将回调函数注册到末尾
+    if (map->callback_count < CAN_MAX_CALLBACK_NUM)
+        map->callbacks[map->callback_count++] = callback;
+    else
+        Error_Handler();
+}
+
+/**
+ * 按标准帧 ID 注册 CAN Fifo 处理回调
+ *
+ * 所有满足 (Identifier & mask) == (id & mask) 的标准帧都会分发到该回调
+ *
+ * @attention 本函数非线程安全，调用时请注意
+ * @param hcan can handle
+ * @param id 标准帧 ID
+ * @param mask ID 掩码，0x7FF 表示精确匹配
+ * @param callback 回调函数指针
+ * @param ctx 用户上下文，回调时原样传回
+ * @return 是否注册成功；回调表已满或与已注册的 ID 冲突时返回 false
+ */
+bool CAN_RegisterIdCallback(FDCAN_HandleTypeDef*   hcan,
+                            const uint32_t         id,
+                            uint32_t               mask,
+                            const CAN_IdCallback_t callback,
+                            void*                  ctx)
+{
+    assert(callback != nullptr);
+
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return false;
+
+    mask &= CAN_STD_ID_MASK;
+    const uint32_t match = id & mask;
+
+    // 先检查冲突，再写表，避免注册失败时留下一半的表项
+    for (uint32_t i = 0; i < CAN_STD_ID_NUM; i++)
+        if ((i & mask) == match && map->std_id_table[i] != 0)
+            return false;
+
+    const uint8_t handler = add_id_handler(map, callback, ctx);
+    if (handler == 0)
+        return false;
+
+    for (uint32_t i = 0; i < CAN_STD_ID_NUM; i++)
+        if ((i & mask) == match)
+            map->std_id_table[i] = handler;
+    return true;
+}
+
+/**
+ * 按扩展帧 ID 注册 CAN Fifo 处理回调（精确匹配）
+ *
+ * @attention 本函数非线程安全，调用时请注意
+ * @param hcan can handle
+ * @param ext_id 扩展帧 ID
+ * @param callback 回调函数指针
+ * @param ctx 用户上下文，回调时原样传回
+ * @return 是否注册成功；回调表或哈希表已满、ID 已注册时返回 false
+ */
+bool CAN_RegisterExtIdCallback(FDCAN_HandleTypeDef*   hcan,
+                               uint32_t               ext_id,
+                               const CAN_IdCallback_t callback,
+                               void*                  ctx)
+{
+    assert(callback != nullptr);
+
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return false;
+
+    ext_id &= CAN_EXT_ID_MASK;
+    for (uint32_t i = 0, h = ext_id_hash(ext_id); i < CAN_EXT_ID_TABLE_SIZE;
+         i++, h = (h + 1) & (CAN_EXT_ID_TABLE_SIZE - 1))
+    {
+        CAN_ExtIdSlot& slot = map->ext_id_table[h];
+        if (slot.handler != 0)
+        {
+            if (slot.id == ext_id)
+                return false;
+            continue;
+        }
+        const uint8_t handler = add_id_handler(map, callback, ctx);
+        if (handler == 0)
+            return false;
+        slot = { ext_id, handler };
+        return true;
+    }
+    // 哈希表已满
+    return false;
+}
+
+/**
+ * 根据路由表配置硬件过滤器元素，并按过滤器元素编号（FilterIndex）分发
+ *
+ * 标准帧路由从 std_start_index、扩展帧路由从 ext_start_index 开始依次各占用一个 ID + 掩码过滤器元素。
+ * 过滤器元素按编号顺序匹配，第一个命中的元素决定去向，更具体的路由应放在前面；
+ * 命中的帧在中断中通过 FilterIndex 查表即可找到回调，不需要任何软件过滤。
+ * 未命中任何过滤器元素的帧按全局过滤处理，用 HAL_FDCAN_ConfigGlobalFilter 设为 FDCAN_REJECT 后由硬件直接丢弃，
+ * 不会进入中断
+ *
+ * @attention 本函数非线程安全，调用时请注意
+ * @note HAL_FDCAN_Init 会清空消息 RAM，需在其之后调用
+ * @param hcan can handle
+ * @param routes 路由表
+ * @param count 路由表长度
+ * @param std_start_index 起始标准帧过滤器元素编号
+ * @param ext_start_index 起始扩展帧过滤器元素编号
+ * @return 是否配置成功；过滤器元素编号超出 Init.StdFiltersNbr / ExtFiltersNbr 或
+ *         CAN_FD_STD_FILTER_NUM / CAN_FD_EXT_FILTER_NUM 时返回 false
+ */
+bool CAN_ConfigFilterRoutes(FDCAN_HandleTypeDef*   hcan,
+                            const CAN_FilterRoute* routes,
+                            const size_t           count,
+                            const uint32_t         std_start_index,
+                            const uint32_t         ext_start_index)
+{
+    assert(routes != nullptr || count == 0);
+
+    CAN_CallbackMap* map = get_or_create_map(hcan);
+    if (map == nullptr)
+        return false;
+
+    uint32_t std_index = std_start_index;
+    uint32_t ext_index = ext_start_index;
+    for (size_t i = 0; i < count; i++)
+    {
+        const CAN_FilterRoute& route = routes[i];
+        assert(route.callback != nullptr);
+        assert(route.fifo == FDCAN_RX_FIFO0 || route.fifo == FDCAN_RX_FIFO1);
+
+        const bool     ext   = route.ide == FDCAN_EXTENDED_ID;
+        const uint32_t index = ext ? ext_index++ : std_index++;
+        // 超出 Init 中过滤器列表长度的元素不参与匹配
+        if (ext ? index >= hcan->Init.ExtFiltersNbr || index >= CAN_FD_EXT_FILTER_NUM
+                : index >= hcan->Init.StdFiltersNbr || index >= CAN_FD_STD_FILTER_NUM)
+            return false;
+
+        FDCAN_FilterTypeDef filter{};
+        filter.IdType       = route.ide;
+        filter.FilterIndex  = index;
+        filter.FilterType   = FDCAN_FILTER_MASK;
+        filter.FilterConfig = route.fifo == FDCAN_RX_FIFO0 ? FDCAN_FILTER_TO_RXFIFO0 : FDCAN_FILTER_TO_RXFIFO1;
+        filter.FilterID1    = route.id;
+        filter.FilterID2    = route.mask;
+        if (HAL_FDCAN_ConfigFilter(hcan, &filter) != HAL_OK)
+            return false;
+
+        CAN_IdHandler* handlers = ext ? map->ext_filter_handlers : map->std_filter_handlers;
+        handlers[index]         = { route.callback, route.ctx };
+    }
+    return true;
+}
+
+/**
+ * FDCAN Rx Fifo0 中断处理函数，新消息与水位中断都会清空整个 FIFO
+ * @param hcan can handle
+ * @param RxFifo0ITs 触发的中断
+ */
+void CAN_RxFifo0Callback(FDCAN_HandleTypeDef* hcan, const uint32_t RxFifo0ITs)
+{
+    (void) RxFifo0ITs;
+    receive_fifo(hcan, FDCAN_RX_FIFO0);
+}
+/**
+ * FDCAN Rx Fifo1 中断处理函数，新消息与水位中断都会清空整个 FIFO
+ * @param hcan can handle
+ * @param RxFifo1ITs 触发的中断
+ */
+void CAN_RxFifo1Callback(FDCAN_HandleTypeDef* hcan, const uint32_t RxFifo1ITs)
+{
+    (void) RxFifo1ITs;
+    receive_fifo(hcan, FDCAN_RX_FIFO1);
+}
+
+/**
+ * HAL FDCAN TX Buffer 发送完成回调
+ *
+ * 结束的 Buffer 以 TXBTO / TXBCF 为准（见 reap_buffers），随后用软件队列中的帧补满空出的 Buffer
+ * @param hcan can handle
+ * @param BufferIndexes 完成发送的 Buffer 位掩码
+ */
+void CAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef* hcan, const uint32_t BufferIndexes)
+{
+    (void) BufferIndexes;
+    complete_buffers(hcan);
+}
+
+/**
+ * HAL FDCAN TX Buffer 发送中止回调
+ *
+ * 取消请求到达时帧已在总线上发送的，发送成功后 TXBTO 与 TXBCF 同时置位，而 HAL 先分发中止回调，
+ * 这些 Buffer 按发送成功处理
+ * @param hcan can handle
+ * @param BufferIndexes 中止发送的 Buffer 位掩码
+ */
+void CAN_TxBufferAbortCallback(FDCAN_HandleTypeDef* hcan, const uint32_t BufferIndexes)
+{
+    (void) BufferIndexes;
+    complete_buffers(hcan);
+}
+
+/**
+ * HAL FDCAN 错误状态回调
+ *
+ * 自动恢复模式下进入 bus-off 时立即退出初始化模式，由硬件完成恢复序列
+ * @param hcan can handle
+ * @param ErrorStatusITs 触发的中断
+ */
+void CAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hcan, const uint32_t ErrorStatusITs)
+{
+    if (!(ErrorStatusITs & FDCAN_IT_BUS_OFF))
+        return;
+
+    const CAN_CallbackMap* map = get_map(hcan);
+    if (map != nullptr && map->bus_off_recovery == CAN_BUS_OFF_RECOVERY_AUTO)
+        (void) CAN_RecoverBusOff(hcan);
+}
+
+/**
+ * 注册 CAN 主回调函数
+ * @param hcan can handle
+ */
+void CAN_InitMainCallback(FDCAN_HandleTypeDef* hcan)
+{
+    assert(hcan != nullptr);
+
+    // 发送票据挂在回调函数表上，未注册接收回调的总线也需要建表
+    (void) get_or_create_map(hcan);
+
+    HAL_FDCAN_RegisterRxFifo0Callback(hcan, CAN_RxFifo0Callback);
+    HAL_FDCAN_RegisterRxFifo1Callback(hcan, CAN_RxFifo1Callback);
+    HAL_FDCAN_RegisterTxBufferCompleteCallback(hcan, CAN_TxBufferCompleteCallback);
+    HAL_FDCAN_RegisterTxBufferAbortCallback(hcan, CAN_TxBufferAbortCallback);
+    HAL_FDCAN_RegisterErrorStatusCallback(hcan, CAN_ErrorStatusCallback);
+}
+
+#endif // HAL_FDCAN_MODULE_ENABLED
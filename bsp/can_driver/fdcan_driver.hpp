@@ -0,0 +1,391 @@
+/**
+ * @file    fdcan_driver.hpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   CAN wrapper based on HAL FDCAN library
+ *
+ * can_driver 的 FDCAN 后端，由 can_driver.hpp 在 HAL_FDCAN_MODULE_ENABLED 时包含，请勿直接包含本文件。
+ *
+ * 接口与 bxCAN 后端保持同名同义，句柄与帧头换成 FDCAN_HandleTypeDef / FDCAN_TxHeaderTypeDef /
+ * FDCAN_RxHeaderTypeDef。发送优先装入硬件 TX FIFO / Queue（CubeMX 中 Tx Fifo Queue Mode 选择 Queue 时由硬件
+ * 按 ID 仲裁优先级发送），TX Buffer 全部占满时进入按仲裁优先级排序的软件发送队列，Buffer 空出时由发送完成 / 中止中断
+ * 补入；接收在 FIFO 新消息或水位中断中清空 FIFO。
+ *
+ * 与 bxCAN 后端相比尚未移植的功能（打开对应的配置宏会直接编译失败，而不是静默失效）：
+ *
+ * - CAN_SetRecoveryPolicy：bus-off 恢复后 TX Buffer 与软件队列中的帧总是继续发送（相当于 CAN_RECOVERY_REPLAY）；
+ * - 接收帧池与 CAN_RetainFrame / CAN_ReleaseFrame：接收回调的 header / data 只在回调期间有效；
+ * - 延迟接收（CAN_ENABLE_RX_DEFERRED、CAN_ENABLE_RX_WORKER、CAN_Poll）：接收回调总是在中断中调用；
+ * - 接收时间戳（CAN_ENABLE_RX_TIMESTAMP）：可直接使用 FDCAN_RxHeaderTypeDef::RxTimestamp（外设时间戳计数器）；
+ * - 最新值缓存（CAN_ENABLE_RX_LATEST）；
+ * - 收发记录（CAN_ENABLE_RECORDER）；
+ * - 总线负载估计（CAN_ENABLE_BUS_LOAD）；
+ * - 统计信息（CAN_ENABLE_STATS）；
+ * - CAN_FAST_PATH 与 CAN_TX_LOCK_PRIORITY：收发总是经过 HAL，临界区总是关闭全部中断。
+ *
+ * --------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Project repository: https://github.com/HITSZ-WTRobot-Packages/BasicComponents
+ */
+#pragma once
+
+#include "main.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if !defined(HAL_FDCAN_MODULE_ENABLED)
+#    error "fdcan_driver.hpp requires HAL_FDCAN_MODULE_ENABLED, include can_driver.hpp instead"
+#endif
+
+#if !(USE_HAL_FDCAN_REGISTER_CALLBACKS)
+#    error "CAN driver requires HAL FDCAN RegisterCallback enabled. Please enable it in CubeMX: Project Manager -> Advanced Settings -> Register Callbacks -> FDCAN"
+#endif
+
+#if (defined(CAN_ENABLE_RX_DEFERRED) && CAN_ENABLE_RX_DEFERRED) || (defined(CAN_ENABLE_RX_WORKER) && CAN_ENABLE_RX_WORKER) || \
+        (defined(CAN_ENABLE_RX_TIMESTAMP) && CAN_ENABLE_RX_TIMESTAMP) ||                                                  \
+        (defined(CAN_ENABLE_RX_LATEST) && CAN_ENABLE_RX_LATEST) || (defined(CAN_ENABLE_RECORDER) && CAN_ENABLE_RECORDER) ||  \
+        (defined(CAN_ENABLE_BUS_LOAD) && CAN_ENABLE_BUS_LOAD) || (defined(CAN_ENABLE_STATS) && CAN_ENABLE_STATS) ||          \
+        (defined(CAN_FAST_PATH) && CAN_FAST_PATH) || (defined(CAN_TX_LOCK_PRIORITY) && CAN_TX_LOCK_PRIORITY)
+#    error "this option is not supported by the FDCAN backend yet, see the list at the top of fdcan_driver.hpp"
+#endif
+
+#define CAN_SEND_FAILED (0xFFFF)
+#define CAN_SEND_QUEUED (0xFFFE) ///< 未直接装入 TX Buffer，已进入软件发送队列
+
+#define CAN_TX_TICKET_INVALID (0)
+
+// 每条 CAN 保存最近结束发送的帧状态的条数（2 的幂），超出后 CAN_GetTxStatus 返回 CAN_TX_STATUS_UNKNOWN
+#ifndef CAN_TX_STATUS_HISTORY_SIZE
+#    define CAN_TX_STATUS_HISTORY_SIZE (16)
+#endif
+
+// 一条 CAN 最多注册的回调数量
+#ifndef CAN_MAX_CALLBACK_NUM
+#    define CAN_MAX_CALLBACK_NUM (14)
+#endif
+
+// 一条 CAN 最多注册的按 ID 分发回调数量（不超过 254）
+#ifndef CAN_MAX_ID_CALLBACK_NUM
+#    define CAN_MAX_ID_CALLBACK_NUM (16)
+#endif
+
+// 扩展帧 ID 哈希表大小，必须为 2 的幂，且应大于扩展帧 ID 回调数量以保证查找效率
+#ifndef CAN_EXT_ID_TABLE_SIZE
+#    define CAN_EXT_ID_TABLE_SIZE (16)
+#endif
+
+// 是否使用 CAN FD 帧格式；关闭时收发缓冲区按经典 CAN 的 8 字节分配
+#ifndef CAN_FD_ENABLE
+#    define CAN_FD_ENABLE (1)
+#endif
+
+// 硬件 TX Buffer 数量：G4 固定为 3，H7 与 CubeMX 中 Tx Fifo Queue Elmts Nbr 保持一致（不超过 32）
+#ifndef CAN_FD_TX_BUFFER_NUM
+#    define CAN_FD_TX_BUFFER_NUM (3)
+#endif
+
+// 可按过滤器元素编号（FilterIndex）直接分发的标准帧 / 扩展帧过滤器数量：G4 固定为 28 / 8，
+// H7 与 CubeMX 中 Std / Ext Filters Nbr 保持一致
+#ifndef CAN_FD_STD_FILTER_NUM
+#    define CAN_FD_STD_FILTER_NUM (28)
+#endif
+#ifndef CAN_FD_EXT_FILTER_NUM
+#    define CAN_FD_EXT_FILTER_NUM (8)
+#endif
+
+// RX FIFO 水位中断的触发水位（仅 H7 等支持水位中断的型号），0 表示不配置
+#ifndef CAN_FD_RX_WATERMARK
+#    define CAN_FD_RX_WATERMARK (0)
+#endif
+
+// 一条 CAN 最多设置的发送限速规则数量
+#ifndef CAN_MAX_RATE_LIMIT_NUM
+#    define CAN_MAX_RATE_LIMIT_NUM (4)
+#endif
+
+// FDCAN 数量
+#ifndef CAN_NUM
+#    define CAN_NUM (3)
+#endif
+
+// CAN 发送 软件缓冲区大小（按仲裁优先级排序，不超过 254）；每项按 CAN_MAX_DATA_LENGTH 分配数据区
+#ifndef CAN_TX_QUEUE_SIZE
+#    define CAN_TX_QUEUE_SIZE (8)
+#endif
+
+// 单帧最大数据长度
+#if CAN_FD_ENABLE
+#    define CAN_MAX_DATA_LENGTH (64)
+#else
+#    define CAN_MAX_DATA_LENGTH (8)
+#endif
+
+typedef void (*CAN_FifoReceiveCallback_t)(const FDCAN_HandleTypeDef*   hcan,
+                                          const FDCAN_RxHeaderTypeDef* header,
+                                          const uint8_t*               data);
+
+/**
+ * 发送票据
+ *
+ * 每条提交发送的帧都会获得一个单调递增的编号（每条 CAN 独立计数，跳过 CAN_TX_TICKET_INVALID），
+ * 用于查询该帧的发送状态或在发送结束回调中识别该帧
+ */
+typedef uint32_t CAN_TxTicket;
+
+typedef enum
+{
+    CAN_TX_STATUS_UNKNOWN = 0, ///< 无效票据，或状态记录已被新帧覆盖
+    CAN_TX_STATUS_QUEUED,      ///< 在软件发送队列中等待
+    CAN_TX_STATUS_PENDING,     ///< 已装入硬件 TX Buffer，等待总线发送
+    CAN_TX_STATUS_SENT,        ///< 已成功发送
+    CAN_TX_STATUS_ABORTED,     ///< 发送请求被中止，或关闭自动重传时仲裁丢失 / 发送错误
+    CAN_TX_STATUS_DROPPED,     ///< 队列已满未能入队，或在队列中被更高优先级的帧挤出
+    CAN_TX_STATUS_REPLACED,    ///< 在队列或 TX Buffer 中被 CAN_SendLatest 的新值覆盖
+    CAN_TX_STATUS_RATE_LIMITED ///< 超出 CAN_SetRateLimit 设置的速率，未发送
+} CAN_TxStatus;
+
+/**
+ * 帧发送结束回调，在帧进入 SENT / ABORTED / DROPPED / REPLACED / RATE_LIMITED 状态时调用
+ * @attention 可能在中断或发送函数的临界区中调用，请尽量简短；可以在回调中发送下一帧
+ */
+typedef void (*CAN_TxCompleteCallback_t)(const FDCAN_HandleTypeDef* hcan,
+                                         CAN_TxTicket               ticket,
+                                         CAN_TxStatus               status,
+                                         void*                      ctx);
+
+/**
+ * 按 ID 分发的接收回调
+ *
+ * @param ctx 注册时传入的用户上下文
+ */
+typedef void (*CAN_IdCallback_t)(const FDCAN_HandleTypeDef*   hcan,
+                                 const FDCAN_RxHeaderTypeDef* header,
+                                 const uint8_t*               data,
+                                 void*                        ctx);
+
+/**
+ * CAN 发送消息类型
+ *
+ * 数据区按 N 字节分配，CAN_MessageDef 在开启 CAN_FD_ENABLE 时为 64 字节，否则为 8 字节；
+ * 只发送经典帧的批量消息可以直接使用 CAN_BasicMessage<8> 节省内存
+ */
+template <size_t N> struct CAN_BasicMessage
+{
+    static_assert(N >= 8 && N <= 64, "CAN message payload must be 8 ~ 64 bytes");
+
+    FDCAN_TxHeaderTypeDef header;
+    uint8_t               data[N];
+};
+
+typedef CAN_BasicMessage<CAN_MAX_DATA_LENGTH> CAN_MessageDef;
+
+/*
+ * 与后端无关的句柄、帧头类型与帧头访问，与 bxCAN 后端同名同义；
+ * CanIsoTp 等建立在本驱动之上的协议只通过它们构造与解析帧头
+ */
+typedef FDCAN_HandleTypeDef   CAN_Handle;
+typedef FDCAN_TxHeaderTypeDef CAN_TxHeader;
+typedef FDCAN_RxHeaderTypeDef CAN_RxHeader;
+
+uint8_t CAN_DlcToLength(uint32_t data_length);
+
+uint32_t CAN_LengthToDlc(size_t length);
+
+/**
+ * 构造一个经典 CAN 数据帧的帧头
+ * @param id 标准帧或扩展帧 ID
+ * @param extended 是否为扩展帧
+ * @param length 数据长度，超过 8 按 8 处理
+ */
+inline CAN_TxHeader CAN_MakeDataHeader(const uint32_t id, const bool extended, const size_t length)
+{
+    CAN_TxHeader header{};
+    header.Identifier          = id;
+    header.IdType              = extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+    header.TxFrameType         = FDCAN_DATA_FRAME;
+    header.DataLength          = CAN_LengthToDlc(length > 8 ? 8 : length);
+    header.ErrorStateIndicator = FDCAN_ESI_ACTIVE;
+    header.BitRateSwitch       = FDCAN_BRS_OFF;
+    header.FDFormat            = FDCAN_CLASSIC_CAN;
+    header.TxEventFifoControl  = FDCAN_NO_TX_EVENTS;
+    header.MessageMarker       = 0;
+    return header;
+}
+
+/// 是否为数据帧（不是远程帧）
+inline bool CAN_IsDataFrame(const CAN_RxHeader* header)
+{
+    return header->RxFrameType == FDCAN_DATA_FRAME;
+}
+
+/// 数据长度，0 ~ 64
+inline size_t CAN_GetDataLength(const CAN_RxHeader* header)
+{
+    return CAN_DlcToLength(header->DataLength);
+}
+
+/**
+ * 发送队列已满时的处理策略
+ */
+typedef enum
+{
+    CAN_TX_DROP_LOWEST_PRIORITY, ///< 丢弃队列中 ID 最大的帧；新帧本身优先级最低时丢弃新帧
+    CAN_TX_REJECT_NEW,           ///< 拒绝新帧
+} CAN_TxDropPolicy;
+
+/**
+ * CAN 控制器错误状态，按严重程度递增
+ */
+typedef enum
+{
+    CAN_ERROR_ACTIVE = 0, ///< 正常
+    CAN_ERROR_WARNING,    ///< TEC 或 REC 达到 96
+    CAN_ERROR_PASSIVE,    ///< TEC 或 REC 达到 128，只能发送隐性错误帧
+    CAN_BUS_OFF,          ///< TEC 超过 255，已脱离总线
+} CAN_ErrorState;
+
+/**
+ * bus-off 恢复方式
+ */
+typedef enum
+{
+    CAN_BUS_OFF_RECOVERY_AUTO,   ///< 在 bus-off 中断中退出初始化模式，硬件检测到 129 × 11 个隐性位后恢复
+    CAN_BUS_OFF_RECOVERY_MANUAL, ///< 需要调用 CAN_RecoverBusOff 恢复
+} CAN_BusOffRecovery;
+
+/**
+ * 硬件过滤路由表项
+ *
+ * 每一项占用 FDCAN 的一个 ID + 掩码过滤器元素，命中后按 FilterIndex 直接分发到 callback
+ */
+typedef struct
+{
+    uint32_t         id;       ///< 标准帧或扩展帧 ID
+    uint32_t         mask;     ///< ID 掩码，标准帧 0x7FF / 扩展帧 0x1FFFFFFF 表示精确匹配
+    uint32_t         ide;      ///< FDCAN_STANDARD_ID / FDCAN_EXTENDED_ID
+    uint32_t         fifo;     ///< FDCAN_RX_FIFO0 / FDCAN_RX_FIFO1
+    CAN_IdCallback_t callback; ///< 命中后调用的回调函数
+    void*            ctx;      ///< 用户上下文，回调时原样传回
+} CAN_FilterRoute;
+
+uint32_t CAN_SendMessage(FDCAN_HandleTypeDef*         hcan,
+                         const FDCAN_TxHeaderTypeDef* header,
+                         const uint8_t                data[],
+                         CAN_TxTicket*                ticket = nullptr);
+
+namespace can_driver_detail
+{
+// CAN_SendBatch 的实现：msgs 为 count 个间隔 stride 字节的 CAN_BasicMessage<N>，帧头位于开头，数据位于 data_offset
+size_t send_batch(FDCAN_HandleTypeDef* hcan,
+                  const void*          msgs,
+                  size_t               stride,
+                  size_t               data_offset,
+                  size_t               count,
+                  uint32_t*            buffers,
+                  CAN_TxTicket*        tickets);
+} // namespace can_driver_detail
+
+/**
+ * 批量发送 CAN 消息
+ *
+ * 整批只进入一次临界区：先按顺序装满所有空闲 TX Buffer，其余帧进入软件发送队列。
+ * 控制周期内需要连续发送多帧时，比逐帧调用 CAN_SendMessage 关中断的次数和总时长都更少
+ * @param hcan can handle
+ * @param msgs 待发送的消息数组
+ * @param count 消息数量
+ * @param buffers 可为 nullptr；否则逐帧写入与 CAN_SendMessage 相同含义的返回值
+ * @param tickets 可为 nullptr；否则逐帧写入发送票据
+ * @note 本函数是线程安全的
+ * @return 成功装入 TX Buffer 或进入队列的帧数
+ */
+template <size_t N>
+size_t CAN_SendBatch(FDCAN_HandleTypeDef*       hcan,
+                     const CAN_BasicMessage<N>* msgs,
+                     size_t                     count,
+                     uint32_t*                  buffers,
+                     CAN_TxTicket*              tickets = nullptr)
+{
+    return can_driver_detail::send_batch(hcan,
+                                         msgs,
+                                         sizeof(CAN_BasicMessage<N>),
+                                         offsetof(CAN_BasicMessage<N>, data),
+                                         count,
+                                         buffers,
+                                         tickets);
+}
+
+uint32_t CAN_SendLatest(FDCAN_HandleTypeDef*         hcan,
+                        const FDCAN_TxHeaderTypeDef* header,
+                        const uint8_t                data[],
+                        CAN_TxTicket*                ticket = nullptr);
+
+bool CAN_SetRateLimit(FDCAN_HandleTypeDef* hcan,
+                      uint32_t             ide,
+                      uint32_t             id_low,
+                      uint32_t             id_high,
+                      uint32_t             frames_per_second,
+                      uint32_t             burst);
+
+CAN_ErrorState CAN_GetErrorState(FDCAN_HandleTypeDef* hcan, uint8_t* tec, uint8_t* rec);
+
+void CAN_SetBusOffRecovery(FDCAN_HandleTypeDef* hcan, CAN_BusOffRecovery recovery);
+
+bool CAN_RecoverBusOff(FDCAN_HandleTypeDef* hcan);
+
+CAN_TxStatus CAN_GetTxStatus(const FDCAN_HandleTypeDef* hcan, CAN_TxTicket ticket);
+
+bool CAN_IsSent(const FDCAN_HandleTypeDef* hcan, CAN_TxTicket ticket);
+
+void CAN_SetTxCompleteCallback(FDCAN_HandleTypeDef* hcan, CAN_TxCompleteCallback_t callback, void* ctx);
+
+void CAN_GetTxCompleteCallback(const FDCAN_HandleTypeDef* hcan, CAN_TxCompleteCallback_t* callback, void** ctx);
+
+void CAN_SetTxDropPolicy(FDCAN_HandleTypeDef* hcan, CAN_TxDropPolicy policy);
+
+void CAN_InitMainCallback(FDCAN_HandleTypeDef* hcan);
+
+void CAN_Start(FDCAN_HandleTypeDef* hcan, uint32_t ActiveITs);
+
+void CAN_RegisterCallback(FDCAN_HandleTypeDef* hcan, CAN_FifoReceiveCallback_t callback);
+
+bool CAN_RegisterIdCallback(FDCAN_HandleTypeDef* hcan,
+                            uint32_t             id,
+                            uint32_t             mask,
+                            CAN_IdCallback_t     callback,
+                            void*                ctx);
+
+bool CAN_RegisterExtIdCallback(FDCAN_HandleTypeDef* hcan,
+                               uint32_t             ext_id,
+                               CAN_IdCallback_t     callback,
+                               void*                ctx);
+
+bool CAN_ConfigFilterRoutes(FDCAN_HandleTypeDef*   hcan,
+                            const CAN_FilterRoute* routes,
+                            size_t                 count,
+                            uint32_t               std_start_index,
+                            uint32_t               ext_start_index);
+
+/*
+ * HAL 中断回调入口
+ *
+ * CAN_InitMainCallback 会把它们注册到 HAL；不经过 HAL 中断分发时（例如在主机上用模拟的外设驱动本驱动）
+ * 可以直接调用，行为与对应的中断完全相同
+ */
+void CAN_RxFifo0Callback(FDCAN_HandleTypeDef* hcan, uint32_t RxFifo0ITs);
+void CAN_RxFifo1Callback(FDCAN_HandleTypeDef* hcan, uint32_t RxFifo1ITs);
+void CAN_TxBufferCompleteCallback(FDCAN_HandleTypeDef* hcan, uint32_t BufferIndexes);
+void CAN_TxBufferAbortCallback(FDCAN_HandleTypeDef* hcan, uint32_t BufferIndexes);
+void CAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hcan, uint32_t ErrorStatusITs);
@@ -0,0 +1,1380 @@
+/**
+ * @file    bxcan_sim.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   bxCAN 外设模型与基于它的 HAL_CAN_* 实现。
+ *
+ * 寄存器语义按 RM0090 第 32 章实现，HAL 函数按 stm32f4xx_hal_can.c 的寄存器访问顺序实现，
+ * 包括其读-改-写方式带来的副作用（例如 HAL_CAN_AbortTxRequest 会顺带清除其他邮箱的 RQCP）。
+ */
+#include "can_sim.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+namespace can_sim
+{
+
+namespace
+{
+
+// 测试常把控制器定义为全局对象，构造与析构时本文件的全局对象可能尚未构造或已经析构，用函数内静态对象保证先于使用构造
+std::vector<BxCan*>& controllers()
+{
+    static std::vector<BxCan*> list;
+    return list;
+}
+
+// 寄存器下标（以 SimReg 为单位）
+constexpr size_t reg_index(const size_t offset)
+{
+    return offset / sizeof(SimReg);
+}
+
+constexpr size_t MCR   = reg_index(CAN_REG_OFFSET(MCR));
+constexpr size_t MSR   = reg_index(CAN_REG_OFFSET(MSR));
+constexpr size_t TSR   = reg_index(CAN_REG_OFFSET(TSR));
+constexpr size_t RF0R  = reg_index(CAN_REG_OFFSET(RF0R));
+constexpr size_t RF1R  = reg_index(CAN_REG_OFFSET(RF1R));
+constexpr size_t IER   = reg_index(CAN_REG_OFFSET(IER));
+constexpr size_t ESR   = reg_index(CAN_REG_OFFSET(ESR));
+constexpr size_t BTR   = reg_index(CAN_REG_OFFSET(BTR));
+constexpr size_t TX    = reg_index(CAN_REG_OFFSET(sTxMailBox));
+constexpr size_t RX    = reg_index(CAN_REG_OFFSET(sFIFOMailBox));
+constexpr size_t FMR   = reg_index(CAN_REG_OFFSET(FMR));
+constexpr size_t FM1R  = reg_index(CAN_REG_OFFSET(FM1R));
+constexpr size_t FS1R  = reg_index(CAN_REG_OFFSET(FS1R));
+constexpr size_t FFA1R = reg_index(CAN_REG_OFFSET(FFA1R));
+constexpr size_t FA1R  = reg_index(CAN_REG_OFFSET(FA1R));
+
+constexpr uint32_t TSR_STATUS_MASK = 0x0F0F0FU; // 各邮箱的 RQCP / TXOK / ALST / TERR
+constexpr uint32_t RFR_FLAGS       = CAN_RF0R_FULL0 | CAN_RF0R_FOVR0;
+constexpr uint32_t MSR_RC_W1       = CAN_MSR_ERRI | CAN_MSR_WKUI | CAN_MSR_SLAKI;
+
+constexpr uint32_t LEC_NONE = 0;
+constexpr uint32_t LEC_ACK  = 3;
+constexpr uint32_t LEC_BD   = 5; // bit dominant error
+
+void no_callback(CAN_HandleTypeDef* hcan)
+{
+    (void) hcan;
+}
+
+} // namespace
+
+BxCan::BxCan(Bus& bus) : Node(bus)
+{
+    auto*        regs  = reinterpret_cast<SimReg*>(&regs_);
+    const size_t count = sizeof(CAN_TypeDef) / sizeof(SimReg);
+    for (size_t i = 0; i < count; ++i)
+        regs[i].bind(this);
+
+    // 复位值
+    regs_.MCR.set_raw(CAN_MCR_SLEEP | 0x00010000U);
+    regs_.BTR.set_raw(0x01230000U);
+    regs_.FMR.set_raw(14U << CAN_FMR_CAN2SB_Pos | CAN_FMR_FINIT);
+    controllers().push_back(this);
+
+    // APB1 42 MHz，优先每位 14 tq（采样点 85.7 %）
+    const uint32_t pclk = HAL_RCC_GetPCLK1Freq();
+    uint32_t       tq   = 14;
+    for (const uint32_t candidate : { 14U, 16U, 12U, 20U, 10U, 21U, 8U, 24U, 25U })
+        if (pclk % (candidate * bus.bitrate()) == 0)
+        {
+            tq = candidate;
+            break;
+        }
+    const uint32_t bs2 = std::max(1U, (tq * 15 + 50) / 100);
+    const uint32_t bs1 = tq - 1 - bs2;
+
+    hcan_.Instance                  = &regs_;
+    hcan_.Init.Prescaler            = pclk / (tq * bus.bitrate());
+    hcan_.Init.Mode                 = CAN_MODE_NORMAL;
+    hcan_.Init.SyncJumpWidth        = CAN_SJW_1TQ;
+    hcan_.Init.TimeSeg1             = (bs1 - 1) << CAN_BTR_TS1_Pos;
+    hcan_.Init.TimeSeg2             = (bs2 - 1) << CAN_BTR_TS2_Pos;
+    hcan_.Init.TimeTriggeredMode    = DISABLE;
+    hcan_.Init.AutoBusOff           = DISABLE;
+    hcan_.Init.AutoWakeUp           = DISABLE;
+    hcan_.Init.AutoRetransmission   = ENABLE;
+    hcan_.Init.ReceiveFifoLocked    = DISABLE;
+    hcan_.Init.TransmitFifoPriority = DISABLE;
+    if (HAL_CAN_Init(&hcan_) != HAL_OK)
+        Error_Handler();
+}
+
+BxCan::~BxCan()
+{
+    controllers().erase(std::remove(controllers().begin(), controllers().end(), this), controllers().end());
+}
+
+BxCan* BxCan::from(const CAN_HandleTypeDef* hcan)
+{
+    for (BxCan* can : controllers())
+        if (&can->regs_ == hcan->Instance)
+            return can;
+    return nullptr;
+}
+
+void BxCan::set_error_counters(const uint32_t tec, const uint32_t rec)
+{
+    rec_ = std::min(rec, 255U);
+    if (tec > 255)
+    {
+        enter_bus_off();
+        return;
+    }
+    tec_ = tec;
+    update_error_flags();
+}
+
+void BxCan::accept_all(const uint32_t fifo, const uint32_t bank)
+{
+    CAN_FilterTypeDef filter{};
+    filter.FilterBank           = bank;
+    filter.FilterMode           = CAN_FILTERMODE_IDMASK;
+    filter.FilterScale          = CAN_FILTERSCALE_32BIT;
+    filter.FilterFIFOAssignment = fifo;
+    filter.FilterActivation     = CAN_FILTER_ENABLE;
+    filter.SlaveStartFilterBank = 14;
+    if (HAL_CAN_ConfigFilter(&hcan_, &filter) != HAL_OK)
+        Error_Handler();
+}
+
+size_t BxCan::offset(const SimReg& reg) const
+{
+    return static_cast<size_t>(&reg - reinterpret_cast<const SimReg*>(&regs_));
+}
+
+uint32_t BxCan::bitrate() const
+{
+    const uint32_t btr = regs_.BTR.raw();
+    const uint32_t brp = ((btr & CAN_BTR_BRP) >> CAN_BTR_BRP_Pos) + 1;
+    const uint32_t ts1 = ((btr & CAN_BTR_TS1) >> CAN_BTR_TS1_Pos) + 1;
+    const uint32_t ts2 = ((btr & CAN_BTR_TS2) >> CAN_BTR_TS2_Pos) + 1;
+    return HAL_RCC_GetPCLK1Freq() / (brp * (1 + ts1 + ts2));
+}
+
+/*
+ * 寄存器
+ */
+
+uint32_t BxCan::read(const SimReg& reg)
+{
+    ++register_accesses_;
+    const size_t index = offset(reg);
+    switch (index)
+    {
+    case MSR:
+    {
+        uint32_t value = reg.raw() & MSR_RC_W1;
+        if (initializing())
+            value |= CAN_MSR_INAK;
+        else if ((regs_.MCR.raw() & CAN_MCR_SLEEP) != 0)
+            value |= CAN_MSR_SLAK;
+        return value;
+    }
+    case TSR:
+    {
+        uint32_t value = reg.raw() & TSR_STATUS_MASK;
+        int      free  = -1;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            if (mailboxes_[k].state == MailboxState::Empty)
+            {
+                value |= CAN_TSR_TME0 << k;
+                if (free < 0)
+                    free = static_cast<int>(k);
+            }
+            else if (mailboxes_[k].abort)
+            {
+                value |= CAN_TSR_ABRQ0 << (8 * k);
+            }
+        }
+
+        // 没有空闲邮箱时 CODE 给出优先级最低的邮箱
+        int lowest  = -1;
+        int pending = 0;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            if (mailboxes_[k].state == MailboxState::Empty)
+                continue;
+            ++pending;
+            if (lowest < 0)
+            {
+                lowest = static_cast<int>(k);
+                continue;
+            }
+            const bool txfp = (regs_.MCR.raw() & CAN_MCR_TXFP) != 0;
+            const uint32_t key_k = txfp ? static_cast<uint32_t>(mailboxes_[k].sequence)
+                                        : regs_.sTxMailBox[k].TIR.raw() >> 1;
+            const uint32_t key_l = txfp ? static_cast<uint32_t>(mailboxes_[lowest].sequence)
+                                        : regs_.sTxMailBox[lowest].TIR.raw() >> 1;
+            if (key_k >= key_l)
+                lowest = static_cast<int>(k);
+        }
+        if (free >= 0)
+            value |= static_cast<uint32_t>(free) << CAN_TSR_CODE_Pos;
+        else if (lowest >= 0)
+            value |= static_cast<uint32_t>(lowest) << CAN_TSR_CODE_Pos;
+        if (pending > 1)
+            value |= CAN_TSR_LOW0 << lowest;
+        return value;
+    }
+    case RF0R:
+    case RF1R:
+    {
+        const uint32_t fifo = index == RF0R ? 0 : 1;
+        return (reg.raw() & RFR_FLAGS) | fifo_count_[fifo];
+    }
+    case ESR:
+    {
+        uint32_t value = reg.raw() & CAN_ESR_LEC;
+        if (tec_ >= 96 || rec_ >= 96)
+            value |= CAN_ESR_EWGF;
+        if (tec_ >= 128 || rec_ >= 128)
+            value |= CAN_ESR_EPVF;
+        if (bus_off_)
+            value |= CAN_ESR_BOFF;
+        value |= std::min(tec_, 255U) << CAN_ESR_TEC_Pos;
+        value |= std::min(rec_, 255U) << CAN_ESR_REC_Pos;
+        return value;
+    }
+    default:
+        break;
+    }
+
+    if (index >= RX && index < RX + 8)
+    {
+        // 接收 FIFO 输出邮箱：FIFO 为空时内容无定义，这里读 0
+        const size_t fifo = (index - RX) / 4;
+        if (fifo_count_[fifo] == 0)
+            return 0;
+        const RxEntry& entry = fifo_[fifo][0];
+        switch ((index - RX) % 4)
+        {
+        case 0:
+            return entry.rir;
+        case 1:
+            return entry.rdtr;
+        case 2:
+            return entry.rdlr;
+        default:
+            return entry.rdhr;
+        }
+    }
+    return reg.raw();
+}
+
+void BxCan::write(SimReg& reg, const uint32_t value)
+{
+    ++register_accesses_;
+    const size_t index = offset(reg);
+    switch (index)
+    {
+    case MCR:
+        write_mcr(value);
+        break;
+    case MSR:
+        reg.set_raw(reg.raw() & ~(value & MSR_RC_W1));
+        break;
+    case TSR:
+        write_tsr(value);
+        break;
+    case RF0R:
+        write_rfr(0, value);
+        break;
+    case RF1R:
+        write_rfr(1, value);
+        break;
+    case ESR:
+        // 只有 LEC 可写
+        reg.set_raw((reg.raw() & ~CAN_ESR_LEC) | (value & CAN_ESR_LEC));
+        break;
+    case BTR:
+        // 只能在初始化模式下修改
+        if (initializing())
+            reg.set_raw(value);
+        break;
+    default:
+        if (index >= TX && index < TX + 12)
+        {
+            const size_t box = (index - TX) / 4;
+            if ((index - TX) % 4 == 0)
+                write_tir(box, value);
+            else if (mailboxes_[box].state == MailboxState::Empty) // 非空邮箱写保护
+                reg.set_raw(value);
+        }
+        else if (index >= RX && index < RX + 8)
+        {
+            // 只读
+        }
+        else
+        {
+            reg.set_raw(value);
+        }
+        break;
+    }
+
+    // 写寄存器可能使中断条件成立（使能中断、中止邮箱等），与硬件一样立即响应
+    if (!in_interrupt())
+        bus().service_interrupts();
+}
+
+void BxCan::write_mcr(const uint32_t value)
+{
+    if ((value & CAN_MCR_RESET) != 0)
+    {
+        // 软件复位：除 SLEEP 外与上电相同，过滤器不受影响
+        for (auto& mailbox : mailboxes_)
+            mailbox = {};
+        fifo_count_[0] = fifo_count_[1] = 0;
+        regs_.TSR.set_raw(0);
+        regs_.RF0R.set_raw(0);
+        regs_.RF1R.set_raw(0);
+        regs_.IER.set_raw(0);
+        regs_.ESR.set_raw(0);
+        regs_.MSR.set_raw(0);
+        regs_.BTR.set_raw(0x01230000U);
+        regs_.MCR.set_raw(CAN_MCR_SLEEP | 0x00010000U);
+        tec_ = rec_         = 0;
+        bus_off_            = false;
+        recovery_sequences_ = 0;
+        esr_flags_          = 0;
+        transmitting_       = -1;
+        return;
+    }
+
+    const uint32_t old = regs_.MCR.raw();
+    regs_.MCR.set_raw(value);
+
+    // 离开初始化模式：处于 bus-off 时开始（或重新开始）监测 128 次 11 个连续隐性位
+    const bool was_active = (old & (CAN_MCR_INRQ | CAN_MCR_SLEEP)) == 0;
+    const bool now_active = (value & (CAN_MCR_INRQ | CAN_MCR_SLEEP)) == 0;
+    if (!was_active && now_active && bus_off_)
+    {
+        recovery_sequences_ = 128;
+        recovery_mark_ns_   = now_ns();
+    }
+}
+
+void BxCan::write_tsr(const uint32_t value)
+{
+    uint32_t status = regs_.TSR.raw();
+    for (size_t k = 0; k < 3; ++k)
+    {
+        // RQCP 写 1 同时清除 TXOK / ALST / TERR
+        if ((value & (CAN_TSR_RQCP0 << (8 * k))) != 0)
+            status &= ~(0x0FU << (8 * k));
+    }
+    regs_.TSR.set_raw(status);
+
+    for (size_t k = 0; k < 3; ++k)
+        if ((value & (CAN_TSR_ABRQ0 << (8 * k))) != 0)
+            abort_mailbox(k);
+}
+
+void BxCan::abort_mailbox(const size_t index)
+{
+    Mailbox& mailbox = mailboxes_[index];
+    if (mailbox.state == MailboxState::Pending)
+        complete_mailbox(index, CAN_TSR_RQCP0);
+    else if (mailbox.state == MailboxState::Transmitting)
+        mailbox.abort = true; // 等待正在进行的发送结束
+}
+
+void BxCan::write_tir(const size_t index, const uint32_t value)
+{
+    Mailbox& mailbox = mailboxes_[index];
+    if (mailbox.state != MailboxState::Empty)
+        return;
+    regs_.sTxMailBox[index].TIR.set_raw(value);
+    if ((value & CAN_TI0R_TXRQ) != 0)
+    {
+        mailbox.state    = MailboxState::Pending;
+        mailbox.abort    = false;
+        mailbox.sequence = next_sequence_++;
+    }
+}
+
+void BxCan::write_rfr(const uint32_t fifo, const uint32_t value)
+{
+    SimReg& reg = fifo == 0 ? regs_.RF0R : regs_.RF1R;
+    reg.set_raw(reg.raw() & ~(value & RFR_FLAGS));
+    if ((value & CAN_RF0R_RFOM0) != 0 && fifo_count_[fifo] > 0)
+    {
+        for (uint32_t i = 1; i < fifo_count_[fifo]; ++i)
+            fifo_[fifo][i - 1] = fifo_[fifo][i];
+        --fifo_count_[fifo];
+    }
+}
+
+/*
+ * 发送
+ */
+
+int BxCan::select_mailbox() const
+{
+    const bool txfp = (regs_.MCR.raw() & CAN_MCR_TXFP) != 0;
+    int        best = -1;
+    uint64_t   best_key{};
+    for (size_t k = 0; k < 3; ++k)
+    {
+        if (mailboxes_[k].state != MailboxState::Pending)
+            continue;
+        // TXFP = 0 按标识符（TIR 的 STID / EXID / IDE / RTR 恰好按仲裁顺序排列），相同时编号小的邮箱优先
+        const uint64_t key = txfp ? mailboxes_[k].sequence : regs_.sTxMailBox[k].TIR.raw() >> 1;
+        if (best < 0 || key < best_key)
+        {
+            best     = static_cast<int>(k);
+            best_key = key;
+        }
+    }
+    return best;
+}
+
+Frame BxCan::mailbox_frame(const size_t index) const
+{
+    const auto&    box = regs_.sTxMailBox[index];
+    const uint32_t tir = box.TIR.raw();
+    Frame          frame;
+    frame.ext = (tir & CAN_TI0R_IDE) != 0;
+    frame.rtr = (tir & CAN_TI0R_RTR) != 0;
+    frame.id  = frame.ext ? (tir >> CAN_TI0R_EXID_Pos) & 0x1FFFFFFF : (tir >> CAN_TI0R_STID_Pos) & 0x7FF;
+    frame.dlc = static_cast<uint8_t>(box.TDTR.raw() & 0xF);
+    const uint32_t low = box.TDLR.raw(), high = box.TDHR.raw();
+    for (size_t i = 0; i < 4; ++i)
+    {
+        frame.data[i]     = static_cast<uint8_t>(low >> (8 * i));
+        frame.data[i + 4] = static_cast<uint8_t>(high >> (8 * i));
+    }
+    return frame;
+}
+
+bool BxCan::tx_pending(Frame* frame)
+{
+    // 静默模式不能发起发送
+    if (!participating() || (regs_.BTR.raw() & CAN_BTR_SILM) != 0 || transmitting_ >= 0)
+        return false;
+    candidate_ = select_mailbox();
+    if (candidate_ < 0)
+        return false;
+    *frame = mailbox_frame(static_cast<size_t>(candidate_));
+    return true;
+}
+
+bool BxCan::tx_begin()
+{
+    transmitting_                      = candidate_;
+    mailboxes_[transmitting_].state = MailboxState::Transmitting;
+    if (injected_tx_errors_ > 0)
+    {
+        --injected_tx_errors_;
+        return true;
+    }
+    return false;
+}
+
+void BxCan::tx_lost()
+{
+    // NART 时仲裁失败不重发
+    if (candidate_ >= 0 && (regs_.MCR.raw() & CAN_MCR_NART) != 0)
+        complete_mailbox(static_cast<size_t>(candidate_), CAN_TSR_RQCP0 | CAN_TSR_ALST0);
+}
+
+void BxCan::tx_end(const Transfer::Result result)
+{
+    if (transmitting_ < 0)
+        return;
+    const auto index = static_cast<size_t>(transmitting_);
+    transmitting_    = -1;
+
+    if (result == Transfer::Result::Ok)
+    {
+        if (tec_ > 0)
+            --tec_;
+        set_lec(LEC_NONE);
+        // 环回模式接收自己发送的帧
+        if ((regs_.BTR.raw() & CAN_BTR_LBKM) != 0)
+            receive(mailbox_frame(index), now_ns());
+        complete_mailbox(index, CAN_TSR_RQCP0 | CAN_TSR_TXOK0);
+        update_error_flags();
+        return;
+    }
+
+    // error passive 的发送方 ACK 错误不增加 TEC
+    if (result == Transfer::Result::BitError || !error_passive())
+        add_tec(8);
+    set_lec(result == Transfer::Result::AckError ? LEC_ACK : LEC_BD);
+
+    if (mailboxes_[index].abort)
+        complete_mailbox(index, CAN_TSR_RQCP0);
+    else if (!bus_off_ && (regs_.MCR.raw() & CAN_MCR_NART) != 0)
+        complete_mailbox(index, CAN_TSR_RQCP0 | CAN_TSR_TERR0);
+    else
+        mailboxes_[index].state = MailboxState::Pending; // 自动重发；bus-off 时保留到恢复后
+    update_error_flags();
+}
+
+void BxCan::complete_mailbox(const size_t index, const uint32_t flags)
+{
+    mailboxes_[index] = {};
+    auto& tir         = regs_.sTxMailBox[index].TIR;
+    tir.set_raw(tir.raw() & ~CAN_TI0R_TXRQ);
+    regs_.TSR.set_raw(regs_.TSR.raw() | flags << (8 * index));
+}
+
+bool BxCan::acknowledges() const
+{
+    return participating() && (regs_.BTR.raw() & (CAN_BTR_LBKM | CAN_BTR_SILM)) == 0;
+}
+
+bool BxCan::self_acknowledges() const
+{
+    return (regs_.BTR.raw() & CAN_BTR_LBKM) != 0;
+}
+
+bool BxCan::synchronized() const
+{
+    // 允许 0.5 % 的波特率误差
+    const uint64_t own = bitrate(), bus_rate = bus().bitrate();
+    const uint64_t diff = own > bus_rate ? own - bus_rate : bus_rate - own;
+    return diff * 200 <= bus_rate;
+}
+
+/*
+ * 接收
+ */
+
+void BxCan::rx(const Frame& frame, const uint64_t sof_ns)
+{
+    // 环回模式下接收端与总线断开；CAN FD 帧按 FD 容忍处理，不接收也不计错
+    if (!participating() || (regs_.BTR.raw() & CAN_BTR_LBKM) != 0 || frame.fd)
+        return;
+    if (rec_ > 127)
+        rec_ = 120;
+    else if (rec_ > 0)
+        --rec_;
+    set_lec(LEC_NONE);
+    update_error_flags();
+    receive(frame, sof_ns);
+}
+
+void BxCan::rx_error()
+{
+    if (!participating() || (regs_.BTR.raw() & CAN_BTR_LBKM) != 0)
+        return;
+    if (rec_ < 255)
+        ++rec_;
+    set_lec(LEC_BD);
+    update_error_flags();
+}
+
+void BxCan::receive(const Frame& frame, const uint64_t sof_ns)
+{
+    uint32_t fifo, fmi;
+    if ((regs_.FMR.raw() & CAN_FMR_FINIT) != 0 || !match_filters(frame, &fifo, &fmi))
+        return;
+
+    RxEntry entry{};
+    entry.rir = frame.ext ? (frame.id & 0x1FFFFFFF) << CAN_RI0R_EXID_Pos | CAN_RI0R_IDE
+                          : (frame.id & 0x7FF) << CAN_RI0R_STID_Pos;
+    if (frame.rtr)
+        entry.rir |= CAN_RI0R_RTR;
+    // TIME 为 SOF 时刻的 16 位位时间计数
+    const uint32_t time = static_cast<uint32_t>(sof_ns * bus().bitrate() / 1000000000ULL) & 0xFFFF;
+    entry.rdtr          = (frame.dlc & 0xFU) | fmi << CAN_RDT0R_FMI_Pos | time << CAN_RDT0R_TIME_Pos;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        entry.rdlr |= static_cast<uint32_t>(frame.data[i]) << (8 * i);
+        entry.rdhr |= static_cast<uint32_t>(frame.data[i + 4]) << (8 * i);
+    }
+    push_fifo(fifo, entry);
+}
+
+bool BxCan::match_filters(const Frame& frame, uint32_t* fifo, uint32_t* fmi) const
+{
+    const uint32_t banks = (regs_.FMR.raw() & CAN_FMR_CAN2SB) >> CAN_FMR_CAN2SB_Pos;
+    const uint32_t fm1r = regs_.FM1R.raw(), fs1r = regs_.FS1R.raw();
+    const uint32_t ffa1r = regs_.FFA1R.raw(), fa1r = regs_.FA1R.raw();
+
+    // 32 / 16 位过滤器看到的帧标识
+    const uint32_t rtr   = frame.rtr ? 1U : 0U;
+    const uint32_t word  = frame.ext ? (frame.id & 0x1FFFFFFF) << 3 | 4U | rtr << 1 : (frame.id & 0x7FF) << 21 | rtr << 1;
+    const uint32_t half  = frame.ext ? ((frame.id >> 18) & 0x7FF) << 5 | rtr << 4 | 1U << 3 | ((frame.id >> 15) & 7U)
+                                     : (frame.id & 0x7FF) << 5 | rtr << 4;
+
+    // 优先级：32 位优先于 16 位，列表优先于掩码，最后比较 FMI
+    bool     found = false;
+    uint32_t best_rank{}, best_fifo{}, best_fmi{};
+    auto     consider = [&](const bool scale32, const bool list, const uint32_t f, const uint32_t n) {
+        const uint32_t rank = (scale32 ? 0U : 2U) + (list ? 0U : 1U);
+        if (!found || rank < best_rank || (rank == best_rank && n < best_fmi))
+        {
+            found     = true;
+            best_rank = rank;
+            best_fifo = f;
+            best_fmi  = n;
+        }
+    };
+
+    uint32_t next_fmi[2] = { 0, 0 };
+    for (uint32_t bank = 0; bank < banks && bank < 28; ++bank)
+    {
+        const uint32_t f       = (ffa1r >> bank) & 1U;
+        const bool     scale32 = ((fs1r >> bank) & 1U) != 0;
+        const bool     list    = ((fm1r >> bank) & 1U) != 0;
+        const bool     active  = ((fa1r >> bank) & 1U) != 0;
+        const uint32_t base    = next_fmi[f];
+        // 未激活的过滤器组同样占用 FMI 编号
+        next_fmi[f] += scale32 ? (list ? 2 : 1) : (list ? 4 : 2);
+        if (!active)
+            continue;
+
+        const uint32_t fr1 = regs_.sFilterRegister[bank].FR1.raw();
+        const uint32_t fr2 = regs_.sFilterRegister[bank].FR2.raw();
+        if (scale32)
+        {
+            if (!list)
+            {
+                if (((word ^ fr1) & fr2 & ~1U) == 0)
+                    consider(true, false, f, base);
+            }
+            else
+            {
+                if (((word ^ fr1) & ~1U) == 0)
+                    consider(true, true, f, base);
+                if (((word ^ fr2) & ~1U) == 0)
+                    consider(true, true, f, base + 1);
+            }
+        }
+        else
+        {
+            const uint32_t ids[4] = { fr1 & 0xFFFF, fr1 >> 16, fr2 & 0xFFFF, fr2 >> 16 };
+            if (!list)
+            {
+                // FR1 = 掩码 1 : 标识 1，FR2 = 掩码 2 : 标识 2
+                if (((half ^ ids[0]) & ids[1]) == 0)
+                    consider(false, false, f, base);
+                if (((half ^ ids[2]) & ids[3]) == 0)
+                    consider(false, false, f, base + 1);
+            }
+            else
+            {
+                for (uint32_t i = 0; i < 4; ++i)
+                    if (half == ids[i])
+                        consider(false, true, f, base + i);
+            }
+        }
+    }
+
+    if (found)
+    {
+        *fifo = best_fifo;
+        *fmi  = best_fmi;
+    }
+    return found;
+}
+
+void BxCan::push_fifo(const uint32_t fifo, const RxEntry& entry)
+{
+    SimReg& reg = fifo == 0 ? regs_.RF0R : regs_.RF1R;
+    if (fifo_count_[fifo] == 3)
+    {
+        // 溢出：RFLM = 0 时新帧覆盖最后一帧，RFLM = 1 时丢弃新帧
+        ++overruns_[fifo];
+        reg.set_raw(reg.raw() | CAN_RF0R_FOVR0);
+        if ((regs_.MCR.raw() & CAN_MCR_RFLM) == 0)
+            fifo_[fifo][2] = entry;
+        return;
+    }
+    fifo_[fifo][fifo_count_[fifo]++] = entry;
+    if (fifo_count_[fifo] == 3)
+        reg.set_raw(reg.raw() | CAN_RF0R_FULL0);
+}
+
+/*
+ * 错误处理
+ */
+
+void BxCan::add_tec(const uint32_t amount)
+{
+    if (bus_off_)
+        return;
+    tec_ += amount;
+    if (tec_ > 255)
+        enter_bus_off();
+}
+
+void BxCan::set_lec(const uint32_t lec)
+{
+    const uint32_t esr = regs_.ESR.raw();
+    regs_.ESR.set_raw((esr & ~CAN_ESR_LEC) | lec << CAN_ESR_LEC_Pos);
+    if (lec != LEC_NONE && (regs_.IER.raw() & CAN_IER_LECIE) != 0)
+        regs_.MSR.set_raw(regs_.MSR.raw() | CAN_MSR_ERRI);
+}
+
+void BxCan::update_error_flags()
+{
+    uint32_t flags = 0;
+    if (tec_ >= 96 || rec_ >= 96)
+        flags |= CAN_ESR_EWGF;
+    if (tec_ >= 128 || rec_ >= 128)
+        flags |= CAN_ESR_EPVF;
+    if (bus_off_)
+        flags |= CAN_ESR_BOFF;
+
+    // 状态标志置位时产生 ERRI，清除时不产生
+    const uint32_t rising = flags & ~esr_flags_;
+    esr_flags_            = flags;
+    const uint32_t ier    = regs_.IER.raw();
+    if (((rising & CAN_ESR_EWGF) != 0 && (ier & CAN_IER_EWGIE) != 0) ||
+        ((rising & CAN_ESR_EPVF) != 0 && (ier & CAN_IER_EPVIE) != 0) ||
+        ((rising & CAN_ESR_BOFF) != 0 && (ier & CAN_IER_BOFIE) != 0))
+        regs_.MSR.set_raw(regs_.MSR.raw() | CAN_MSR_ERRI);
+}
+
+void BxCan::enter_bus_off()
+{
+    bus_off_            = true;
+    tec_                = 256;
+    recovery_sequences_ = 0;
+    if ((regs_.MCR.raw() & CAN_MCR_ABOM) != 0)
+    {
+        recovery_sequences_ = 128;
+        recovery_mark_ns_   = now_ns();
+    }
+    update_error_flags();
+}
+
+void BxCan::leave_bus_off()
+{
+    bus_off_            = false;
+    tec_                = 0;
+    rec_                = 0;
+    recovery_sequences_ = 0;
+    update_error_flags();
+}
+
+void BxCan::on_transfer(const Transfer& transfer)
+{
+    // 进入 bus-off 的那一帧不计入
+    if (recovery_sequences_ == 0 || (regs_.MCR.raw() & (CAN_MCR_INRQ | CAN_MCR_SLEEP)) != 0 ||
+        transfer.end_ns <= recovery_mark_ns_)
+        return;
+    // 帧前的空闲时间，加上帧尾的 ACK 界定符、EOF 与帧间隔（或错误界定符与帧间隔）构成的 11 个隐性位
+    const uint64_t idle = transfer.sof_ns > recovery_mark_ns_ ? transfer.sof_ns - recovery_mark_ns_ : 0;
+    const uint64_t seen = idle / bus().bits_ns(11) + 1;
+    recovery_mark_ns_   = transfer.end_ns;
+    if (seen >= recovery_sequences_)
+        leave_bus_off();
+    else
+        recovery_sequences_ -= static_cast<uint32_t>(seen);
+}
+
+uint64_t BxCan::next_event_ns() const
+{
+    if (recovery_sequences_ == 0 || bus().transferring() ||
+        (regs_.MCR.raw() & (CAN_MCR_INRQ | CAN_MCR_SLEEP)) != 0)
+        return NEVER;
+    return recovery_mark_ns_ + bus().bits_ns(11ULL * recovery_sequences_);
+}
+
+void BxCan::on_time()
+{
+    const uint64_t deadline = next_event_ns();
+    if (deadline != NEVER && now_ns() >= deadline)
+        leave_bus_off();
+}
+
+/*
+ * 中断
+ */
+
+IRQn_Type BxCan::pending_irq() const
+{
+    const uint32_t ier  = regs_.IER.raw();
+    const uint32_t rf0r = regs_.RF0R.raw(), rf1r = regs_.RF1R.raw();
+
+    IRQn_Type irqs[4];
+    size_t    count = 0;
+    if ((ier & CAN_IER_TMEIE) != 0 && (regs_.TSR.raw() & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2)) != 0)
+        irqs[count++] = CAN1_TX_IRQn;
+    if (((ier & CAN_IER_FMPIE0) != 0 && fifo_count_[0] != 0) || ((ier & CAN_IER_FFIE0) != 0 && (rf0r & CAN_RF0R_FULL0)) ||
+        ((ier & CAN_IER_FOVIE0) != 0 && (rf0r & CAN_RF0R_FOVR0)))
+        irqs[count++] = CAN1_RX0_IRQn;
+    if (((ier & CAN_IER_FMPIE1) != 0 && fifo_count_[1] != 0) || ((ier & CAN_IER_FFIE1) != 0 && (rf1r & CAN_RF0R_FULL0)) ||
+        ((ier & CAN_IER_FOVIE1) != 0 && (rf1r & CAN_RF0R_FOVR0)))
+        irqs[count++] = CAN1_RX1_IRQn;
+    if ((ier & CAN_IER_ERRIE) != 0 && (regs_.MSR.raw() & CAN_MSR_ERRI) != 0)
+        irqs[count++] = CAN1_SCE_IRQn;
+
+    // 优先级数值小的先响应，相同时中断号小的先响应
+    IRQn_Type best = SIM_IRQ_NUM;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint32_t priority = NVIC_GetPriority(irqs[i]);
+        if (detail::irq_masked(priority))
+            continue;
+        if (best == SIM_IRQ_NUM || priority < NVIC_GetPriority(best))
+            best = irqs[i];
+    }
+    return best;
+}
+
+void BxCan::set_irq_handler(const IRQn_Type irqn, std::function<void()> handler)
+{
+    irq_handlers_[irqn - CAN1_TX_IRQn] = std::move(handler);
+}
+
+void BxCan::service_interrupts()
+{
+    if (in_interrupt() || hcan_.State == HAL_CAN_STATE_RESET)
+        return;
+    for (uint32_t round = 0;; ++round)
+    {
+        const IRQn_Type irqn = pending_irq();
+        if (irqn == SIM_IRQ_NUM)
+            return;
+        if (round == 100000)
+        {
+            std::fprintf(stderr, "can_sim: interrupt storm on IRQ %d (flag never cleared)\n", irqn);
+            std::abort();
+        }
+        const uint64_t               start   = detail::host_ns();
+        const std::function<void()>& handler = irq_handlers_[irqn - CAN1_TX_IRQn];
+        {
+            detail::InterruptScope scope(irqn);
+            if (handler)
+                handler();
+            else
+                HAL_CAN_IRQHandler(&hcan_);
+        }
+        isr_stats_.add(detail::host_ns() - start);
+    }
+}
+
+} // namespace can_sim
+
+/*
+ * HAL
+ */
+
+using can_sim::no_callback;
+
+namespace
+{
+
+bool wait_msr(CAN_HandleTypeDef* hcan, const uint32_t flag, const bool set)
+{
+    // 仿真中模式切换立即完成，保留 HAL 的等待结构
+    const uint32_t tickstart = HAL_GetTick();
+    while (((hcan->Instance->MSR & flag) != 0) != set)
+    {
+        if (HAL_GetTick() - tickstart > 10U)
+            return false;
+        HAL_Delay(1);
+    }
+    return true;
+}
+
+bool ready_or_listening(const CAN_HandleTypeDef* hcan)
+{
+    return hcan->State == HAL_CAN_STATE_READY || hcan->State == HAL_CAN_STATE_LISTENING;
+}
+
+} // namespace
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef* hcan)
+{
+    if (hcan == nullptr)
+        return HAL_ERROR;
+
+    if (hcan->State == HAL_CAN_STATE_RESET)
+    {
+        hcan->TxMailbox0CompleteCallback = no_callback;
+        hcan->TxMailbox1CompleteCallback = no_callback;
+        hcan->TxMailbox2CompleteCallback = no_callback;
+        hcan->TxMailbox0AbortCallback    = no_callback;
+        hcan->TxMailbox1AbortCallback    = no_callback;
+        hcan->TxMailbox2AbortCallback    = no_callback;
+        hcan->RxFifo0MsgPendingCallback  = no_callback;
+        hcan->RxFifo0FullCallback        = no_callback;
+        hcan->RxFifo1MsgPendingCallback  = no_callback;
+        hcan->RxFifo1FullCallback        = no_callback;
+        hcan->SleepCallback              = no_callback;
+        hcan->WakeUpFromRxMsgCallback    = no_callback;
+        hcan->ErrorCallback              = no_callback;
+    }
+
+    hcan->Instance->MCR &= ~CAN_MCR_SLEEP;
+    if (!wait_msr(hcan, CAN_MSR_SLAK, false))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_TIMEOUT;
+        hcan->State = HAL_CAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+    hcan->Instance->MCR |= CAN_MCR_INRQ;
+    if (!wait_msr(hcan, CAN_MSR_INAK, true))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_TIMEOUT;
+        hcan->State = HAL_CAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+
+    auto set_bit = [hcan](const uint32_t bit, const bool on) {
+        if (on)
+            hcan->Instance->MCR |= bit;
+        else
+            hcan->Instance->MCR &= ~bit;
+    };
+    set_bit(CAN_MCR_TTCM, hcan->Init.TimeTriggeredMode == ENABLE);
+    set_bit(CAN_MCR_ABOM, hcan->Init.AutoBusOff == ENABLE);
+    set_bit(CAN_MCR_AWUM, hcan->Init.AutoWakeUp == ENABLE);
+    set_bit(CAN_MCR_NART, hcan->Init.AutoRetransmission != ENABLE);
+    set_bit(CAN_MCR_RFLM, hcan->Init.ReceiveFifoLocked == ENABLE);
+    set_bit(CAN_MCR_TXFP, hcan->Init.TransmitFifoPriority == ENABLE);
+
+    hcan->Instance->BTR = hcan->Init.Mode | hcan->Init.SyncJumpWidth | hcan->Init.TimeSeg1 | hcan->Init.TimeSeg2 |
+                          (hcan->Init.Prescaler - 1U);
+
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    hcan->State     = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeInit(CAN_HandleTypeDef* hcan)
+{
+    if (hcan == nullptr)
+        return HAL_ERROR;
+    (void) HAL_CAN_Stop(hcan);
+    hcan->Instance->MCR |= CAN_MCR_RESET;
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    hcan->State     = HAL_CAN_STATE_RESET;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_RegisterCallback(CAN_HandleTypeDef*              hcan,
+                                           const HAL_CAN_CallbackIDTypeDef CallbackID,
+                                           const pCAN_CallbackTypeDef      pCallback)
+{
+    if (pCallback == nullptr)
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_INVALID_CALLBACK;
+        return HAL_ERROR;
+    }
+    if (hcan->State != HAL_CAN_STATE_READY)
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_INVALID_CALLBACK;
+        return HAL_ERROR;
+    }
+
+    switch (CallbackID)
+    {
+    case HAL_CAN_TX_MAILBOX0_COMPLETE_CB_ID:
+        hcan->TxMailbox0CompleteCallback = pCallback;
+        break;
+    case HAL_CAN_TX_MAILBOX1_COMPLETE_CB_ID:
+        hcan->TxMailbox1CompleteCallback = pCallback;
+        break;
+    case HAL_CAN_TX_MAILBOX2_COMPLETE_CB_ID:
+        hcan->TxMailbox2CompleteCallback = pCallback;
+        break;
+    case HAL_CAN_TX_MAILBOX0_ABORT_CB_ID:
+        hcan->TxMailbox0AbortCallback = pCallback;
+        break;
+    case HAL_CAN_TX_MAILBOX1_ABORT_CB_ID:
+        hcan->TxMailbox1AbortCallback = pCallback;
+        break;
+    case HAL_CAN_TX_MAILBOX2_ABORT_CB_ID:
+        hcan->TxMailbox2AbortCallback = pCallback;
+        break;
+    case HAL_CAN_RX_FIFO0_MSG_PENDING_CB_ID:
+        hcan->RxFifo0MsgPendingCallback = pCallback;
+        break;
+    case HAL_CAN_RX_FIFO0_FULL_CB_ID:
+        hcan->RxFifo0FullCallback = pCallback;
+        break;
+    case HAL_CAN_RX_FIFO1_MSG_PENDING_CB_ID:
+        hcan->RxFifo1MsgPendingCallback = pCallback;
+        break;
+    case HAL_CAN_RX_FIFO1_FULL_CB_ID:
+        hcan->RxFifo1FullCallback = pCallback;
+        break;
+    case HAL_CAN_SLEEP_CB_ID:
+        hcan->SleepCallback = pCallback;
+        break;
+    case HAL_CAN_WAKEUP_FROM_RX_MSG_CB_ID:
+        hcan->WakeUpFromRxMsgCallback = pCallback;
+        break;
+    case HAL_CAN_ERROR_CB_ID:
+        hcan->ErrorCallback = pCallback;
+        break;
+    default:
+        hcan->ErrorCode |= HAL_CAN_ERROR_INVALID_CALLBACK;
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, const CAN_FilterTypeDef* sFilterConfig)
+{
+    if (!ready_or_listening(hcan))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+
+    CAN_TypeDef*   can = hcan->Instance;
+    const uint32_t pos = 1U << (sFilterConfig->FilterBank & 0x1FU);
+
+    can->FMR |= CAN_FMR_FINIT;
+    can->FA1R &= ~pos;
+
+    if (sFilterConfig->FilterScale == CAN_FILTERSCALE_16BIT)
+    {
+        can->FS1R &= ~pos;
+        can->sFilterRegister[sFilterConfig->FilterBank].FR1 =
+                ((0x0000FFFFU & sFilterConfig->FilterMaskIdLow) << 16U) | (0x0000FFFFU & sFilterConfig->FilterIdLow);
+        can->sFilterRegister[sFilterConfig->FilterBank].FR2 =
+                ((0x0000FFFFU & sFilterConfig->FilterMaskIdHigh) << 16U) | (0x0000FFFFU & sFilterConfig->FilterIdHigh);
+    }
+    else
+    {
+        can->FS1R |= pos;
+        can->sFilterRegister[sFilterConfig->FilterBank].FR1 =
+                ((0x0000FFFFU & sFilterConfig->FilterIdHigh) << 16U) | (0x0000FFFFU & sFilterConfig->FilterIdLow);
+        can->sFilterRegister[sFilterConfig->FilterBank].FR2 =
+                ((0x0000FFFFU & sFilterConfig->FilterMaskIdHigh) << 16U) | (0x0000FFFFU & sFilterConfig->FilterMaskIdLow);
+    }
+
+    if (sFilterConfig->FilterMode == CAN_FILTERMODE_IDMASK)
+        can->FM1R &= ~pos;
+    else
+        can->FM1R |= pos;
+
+    if (sFilterConfig->FilterFIFOAssignment == CAN_FILTER_FIFO0)
+        can->FFA1R &= ~pos;
+    else
+        can->FFA1R |= pos;
+
+    if (sFilterConfig->FilterActivation == CAN_FILTER_ENABLE)
+        can->FA1R |= pos;
+
+    can->FMR &= ~CAN_FMR_FINIT;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef* hcan)
+{
+    if (hcan->State != HAL_CAN_STATE_READY)
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    hcan->State = HAL_CAN_STATE_LISTENING;
+    hcan->Instance->MCR &= ~CAN_MCR_INRQ;
+    if (!wait_msr(hcan, CAN_MSR_INAK, false))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_TIMEOUT;
+        hcan->State = HAL_CAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef* hcan)
+{
+    if (hcan->State != HAL_CAN_STATE_LISTENING)
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    hcan->Instance->MCR |= CAN_MCR_INRQ;
+    if (!wait_msr(hcan, CAN_MSR_INAK, true))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_TIMEOUT;
+        hcan->State = HAL_CAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+    hcan->Instance->MCR &= ~CAN_MCR_SLEEP;
+    hcan->State = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef*         hcan,
+                                       const CAN_TxHeaderTypeDef* pHeader,
+                                       const uint8_t              aData[],
+                                       uint32_t*                  pTxMailbox)
+{
+    if (!ready_or_listening(hcan))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+
+    const uint32_t tsr = hcan->Instance->TSR;
+    if ((tsr & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)) == 0)
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+
+    const uint32_t index = (tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+    *pTxMailbox          = 1U << index;
+
+    CAN_TxMailBox_TypeDef& box = hcan->Instance->sTxMailBox[index];
+    if (pHeader->IDE == CAN_ID_STD)
+        box.TIR = (pHeader->StdId << CAN_TI0R_STID_Pos) | pHeader->RTR;
+    else
+        box.TIR = (pHeader->ExtId << CAN_TI0R_EXID_Pos) | pHeader->IDE | pHeader->RTR;
+    box.TDTR = pHeader->DLC;
+    if (pHeader->TransmitGlobalTime == ENABLE)
+        box.TDTR |= CAN_TDT0R_TGT;
+    box.TDHR = static_cast<uint32_t>(aData[7]) << 24 | static_cast<uint32_t>(aData[6]) << 16 |
+               static_cast<uint32_t>(aData[5]) << 8 | aData[4];
+    box.TDLR = static_cast<uint32_t>(aData[3]) << 24 | static_cast<uint32_t>(aData[2]) << 16 |
+               static_cast<uint32_t>(aData[1]) << 8 | aData[0];
+    box.TIR |= CAN_TI0R_TXRQ;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef* hcan, const uint32_t TxMailboxes)
+{
+    if (!ready_or_listening(hcan))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    // 与 HAL 一样用 SET_BIT（读-改-写），会把读到的 RQCP 写回 1 而清除它们
+    if ((TxMailboxes & CAN_TX_MAILBOX0) != 0)
+        hcan->Instance->TSR |= CAN_TSR_ABRQ0;
+    if ((TxMailboxes & CAN_TX_MAILBOX1) != 0)
+        hcan->Instance->TSR |= CAN_TSR_ABRQ1;
+    if ((TxMailboxes & CAN_TX_MAILBOX2) != 0)
+        hcan->Instance->TSR |= CAN_TSR_ABRQ2;
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(const CAN_HandleTypeDef* hcan)
+{
+    if (!ready_or_listening(hcan))
+        return 0;
+    const uint32_t tsr = hcan->Instance->TSR;
+    return ((tsr & CAN_TSR_TME0) ? 1U : 0U) + ((tsr & CAN_TSR_TME1) ? 1U : 0U) + ((tsr & CAN_TSR_TME2) ? 1U : 0U);
+}
+
+uint32_t HAL_CAN_IsTxMessagePending(const CAN_HandleTypeDef* hcan, const uint32_t TxMailboxes)
+{
+    if (!ready_or_listening(hcan))
+        return 0;
+    const uint32_t tme = (hcan->Instance->TSR & CAN_TSR_TME) >> 26U;
+    return (tme & TxMailboxes) != TxMailboxes ? 1U : 0U;
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef*   hcan,
+                                       const uint32_t       RxFifo,
+                                       CAN_RxHeaderTypeDef* pHeader,
+                                       uint8_t              aData[])
+{
+    if (!ready_or_listening(hcan))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    if (((RxFifo == CAN_RX_FIFO0 ? hcan->Instance->RF0R : hcan->Instance->RF1R) & CAN_RF0R_FMP0) == 0)
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+
+    // 与 HAL 一样每个字段都重新读一次寄存器（HAL 源码逐字段访问 volatile 寄存器，编译器不能合并），
+    // 基准比较 CAN_FAST_PATH 时寄存器访问次数才与目标板一致
+    const CAN_FIFOMailBox_TypeDef& box = hcan->Instance->sFIFOMailBox[RxFifo];
+    pHeader->IDE                       = CAN_RI0R_IDE & box.RIR;
+    if (pHeader->IDE == CAN_ID_STD)
+        pHeader->StdId = (CAN_RI0R_STID & box.RIR) >> CAN_TI0R_STID_Pos;
+    else
+        pHeader->ExtId = ((CAN_RI0R_EXID | CAN_RI0R_STID) & box.RIR) >> CAN_RI0R_EXID_Pos;
+    pHeader->RTR = CAN_RI0R_RTR & box.RIR;
+    if (((CAN_RDT0R_DLC & box.RDTR) >> CAN_RDT0R_DLC_Pos) >= 8U)
+        pHeader->DLC = 8U;
+    else
+        pHeader->DLC = (CAN_RDT0R_DLC & box.RDTR) >> CAN_RDT0R_DLC_Pos;
+    pHeader->FilterMatchIndex = (CAN_RDT0R_FMI & box.RDTR) >> CAN_RDT0R_FMI_Pos;
+    pHeader->Timestamp        = (CAN_RDT0R_TIME & box.RDTR) >> CAN_RDT0R_TIME_Pos;
+
+    for (size_t i = 0; i < 4; ++i)
+        aData[i] = static_cast<uint8_t>(box.RDLR >> (8 * i));
+    for (size_t i = 0; i < 4; ++i)
+        aData[i + 4] = static_cast<uint8_t>(box.RDHR >> (8 * i));
+
+    // 与 HAL 一样用 SET_BIT 释放输出邮箱，读到的 FULL / FOVR 会被一并清除
+    if (RxFifo == CAN_RX_FIFO0)
+        hcan->Instance->RF0R |= CAN_RF0R_RFOM0;
+    else
+        hcan->Instance->RF1R |= CAN_RF1R_RFOM1;
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetRxFifoFillLevel(const CAN_HandleTypeDef* hcan, const uint32_t RxFifo)
+{
+    if (!ready_or_listening(hcan))
+        return 0;
+    return (RxFifo == CAN_RX_FIFO0 ? hcan->Instance->RF0R : hcan->Instance->RF1R) & CAN_RF0R_FMP0;
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef* hcan, const uint32_t ActiveITs)
+{
+    if (!ready_or_listening(hcan))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    hcan->Instance->IER |= ActiveITs;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef* hcan, const uint32_t InactiveITs)
+{
+    if (!ready_or_listening(hcan))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    hcan->Instance->IER &= ~InactiveITs;
+    return HAL_OK;
+}
+
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef* hcan)
+{
+    uint32_t     errorcode  = HAL_CAN_ERROR_NONE;
+    CAN_TypeDef* can        = hcan->Instance;
+    const uint32_t interrupts = can->IER;
+    const uint32_t msrflags   = can->MSR;
+    const uint32_t tsrflags   = can->TSR;
+    const uint32_t rf0rflags  = can->RF0R;
+    const uint32_t rf1rflags  = can->RF1R;
+    const uint32_t esrflags   = can->ESR;
+
+    if ((interrupts & CAN_IT_TX_MAILBOX_EMPTY) != 0U)
+    {
+        if ((tsrflags & CAN_TSR_RQCP0) != 0U)
+        {
+            can->TSR = CAN_TSR_RQCP0;
+            if ((tsrflags & CAN_TSR_TXOK0) != 0U)
+                hcan->TxMailbox0CompleteCallback(hcan);
+            else if ((tsrflags & CAN_TSR_ALST0) != 0U)
+                errorcode |= HAL_CAN_ERROR_TX_ALST0;
+            else if ((tsrflags & CAN_TSR_TERR0) != 0U)
+                errorcode |= HAL_CAN_ERROR_TX_TERR0;
+            else
+                hcan->TxMailbox0AbortCallback(hcan);
+        }
+        if ((tsrflags & CAN_TSR_RQCP1) != 0U)
+        {
+            can->TSR = CAN_TSR_RQCP1;
+            if ((tsrflags & CAN_TSR_TXOK1) != 0U)
+                hcan->TxMailbox1CompleteCallback(hcan);
+            else if ((tsrflags & CAN_TSR_ALST1) != 0U)
+                errorcode |= HAL_CAN_ERROR_TX_ALST1;
+            else if ((tsrflags & CAN_TSR_TERR1) != 0U)
+                errorcode |= HAL_CAN_ERROR_TX_TERR1;
+            else
+                hcan->TxMailbox1AbortCallback(hcan);
+        }
+        if ((tsrflags & CAN_TSR_RQCP2) != 0U)
+        {
+            can->TSR = CAN_TSR_RQCP2;
+            if ((tsrflags & CAN_TSR_TXOK2) != 0U)
+                hcan->TxMailbox2CompleteCallback(hcan);
+            else if ((tsrflags & CAN_TSR_ALST2) != 0U)
+                errorcode |= HAL_CAN_ERROR_TX_ALST2;
+            else if ((tsrflags & CAN_TSR_TERR2) != 0U)
+                errorcode |= HAL_CAN_ERROR_TX_TERR2;
+            else
+                hcan->TxMailbox2AbortCallback(hcan);
+        }
+    }
+
+    if ((interrupts & CAN_IT_RX_FIFO0_OVERRUN) != 0U && (rf0rflags & CAN_RF0R_FOVR0) != 0U)
+    {
+        errorcode |= HAL_CAN_ERROR_RX_FOV0;
+        can->RF0R = CAN_RF0R_FOVR0;
+    }
+    if ((interrupts & CAN_IT_RX_FIFO0_FULL) != 0U && (rf0rflags & CAN_RF0R_FULL0) != 0U)
+    {
+        can->RF0R = CAN_RF0R_FULL0;
+        hcan->RxFifo0FullCallback(hcan);
+    }
+    if ((interrupts & CAN_IT_RX_FIFO0_MSG_PENDING) != 0U && (can->RF0R & CAN_RF0R_FMP0) != 0U)
+        hcan->RxFifo0MsgPendingCallback(hcan);
+
+    if ((interrupts & CAN_IT_RX_FIFO1_OVERRUN) != 0U && (rf1rflags & CAN_RF1R_FOVR1) != 0U)
+    {
+        errorcode |= HAL_CAN_ERROR_RX_FOV1;
+        can->RF1R = CAN_RF1R_FOVR1;
+    }
+    if ((interrupts & CAN_IT_RX_FIFO1_FULL) != 0U && (rf1rflags & CAN_RF1R_FULL1) != 0U)
+    {
+        can->RF1R = CAN_RF1R_FULL1;
+        hcan->RxFifo1FullCallback(hcan);
+    }
+    if ((interrupts & CAN_IT_RX_FIFO1_MSG_PENDING) != 0U && (can->RF1R & CAN_RF1R_FMP1) != 0U)
+        hcan->RxFifo1MsgPendingCallback(hcan);
+
+    if ((interrupts & CAN_IT_ERROR) != 0U && (msrflags & CAN_MSR_ERRI) != 0U)
+    {
+        if ((interrupts & CAN_IT_ERROR_WARNING) != 0U && (esrflags & CAN_ESR_EWGF) != 0U)
+            errorcode |= HAL_CAN_ERROR_EWG;
+        if ((interrupts & CAN_IT_ERROR_PASSIVE) != 0U && (esrflags & CAN_ESR_EPVF) != 0U)
+            errorcode |= HAL_CAN_ERROR_EPV;
+        if ((interrupts & CAN_IT_BUSOFF) != 0U && (esrflags & CAN_ESR_BOFF) != 0U)
+            errorcode |= HAL_CAN_ERROR_BOF;
+        if ((interrupts & CAN_IT_LAST_ERROR_CODE) != 0U && (esrflags & CAN_ESR_LEC) != 0U)
+        {
+            static constexpr uint32_t codes[8] = { 0,
+                                                   HAL_CAN_ERROR_STF,
+                                                   HAL_CAN_ERROR_FOR,
+                                                   HAL_CAN_ERROR_ACK,
+                                                   HAL_CAN_ERROR_BR,
+                                                   HAL_CAN_ERROR_BD,
+                                                   HAL_CAN_ERROR_CRC,
+                                                   0 };
+            errorcode |= codes[(esrflags & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos];
+            can->ESR &= ~CAN_ESR_LEC;
+        }
+        can->MSR = CAN_MSR_ERRI;
+    }
+
+    if (errorcode != HAL_CAN_ERROR_NONE)
+    {
+        hcan->ErrorCode |= errorcode;
+        hcan->ErrorCallback(hcan);
+    }
+}
+
+HAL_CAN_StateTypeDef HAL_CAN_GetState(const CAN_HandleTypeDef* hcan)
+{
+    return hcan->State;
+}
+
+uint32_t HAL_CAN_GetError(const CAN_HandleTypeDef* hcan)
+{
+    return hcan->ErrorCode;
+}
+
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef* hcan)
+{
+    if (!ready_or_listening(hcan))
+    {
+        hcan->ErrorCode |= HAL_CAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    return HAL_OK;
+}
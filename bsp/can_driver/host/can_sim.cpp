@@ -0,0 +1,683 @@
+/**
+ * @file    can_sim.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   仿真时钟、CMSIS 内核接口与虚拟总线。
+ */
+#include "can_sim.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace can_sim
+{
+
+namespace
+{
+
+uint64_t now_ns_ = 0;
+Bus*     bus_    = nullptr;
+
+uint32_t primask_    = 0;
+uint32_t basepri_    = 0;
+uint32_t ipsr_       = 0;
+uint64_t masked_at_  = 0; // 开始屏蔽中断时的主机时间
+uint64_t primask_at_ = 0; // 置位 PRIMASK 时的主机时间
+
+TimingStats masked_stats_;
+TimingStats primask_stats_;
+
+uint8_t nvic_priority_[SIM_IRQ_NUM];
+
+// 未设置的中断使用 FreeRTOS 工程中常见的优先级 5
+struct NvicDefaults
+{
+    NvicDefaults() { std::fill(std::begin(nvic_priority_), std::end(nvic_priority_), 5); }
+} nvic_defaults_;
+
+bool masked()
+{
+    return primask_ != 0 || basepri_ != 0;
+}
+
+/**
+ * 屏蔽状态变化前后调用，统计屏蔽时长；从屏蔽变为不屏蔽时调用挂起的中断
+ */
+void mask_changed(const bool was_masked)
+{
+    const bool now_masked = masked();
+    if (!was_masked && now_masked)
+    {
+        masked_at_ = detail::host_ns();
+    }
+    else if (was_masked && !now_masked)
+    {
+        masked_stats_.add(detail::host_ns() - masked_at_);
+    }
+
+    // BASEPRI 降低后可能有原先被屏蔽的中断可以响应
+    if (!now_masked || basepri_ != 0)
+        if (ipsr_ == 0 && bus_ != nullptr)
+            bus_->service_interrupts();
+}
+
+} // namespace
+
+namespace detail
+{
+
+bool irq_masked(const uint32_t priority)
+{
+    if (ipsr_ != 0 || primask_ != 0)
+        return true;
+    return basepri_ != 0 && (priority << (8U - __NVIC_PRIO_BITS)) >= basepri_;
+}
+
+uint64_t host_ns()
+{
+    return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
+}
+
+void set_now(const uint64_t time_ns)
+{
+    if (time_ns > now_ns_)
+        now_ns_ = time_ns;
+}
+
+InterruptScope::InterruptScope(const IRQn_Type irqn) : saved_(ipsr_)
+{
+    ipsr_ = static_cast<uint32_t>(static_cast<int32_t>(irqn) + 16);
+}
+
+InterruptScope::~InterruptScope()
+{
+    ipsr_ = saved_;
+}
+
+} // namespace detail
+
+uint64_t now_ns()
+{
+    return now_ns_;
+}
+
+void TimingStats::add(const uint64_t ns)
+{
+    ++count;
+    total_ns += ns;
+    if (ns > max_ns)
+        max_ns = ns;
+}
+
+TimingStats& masked_stats()
+{
+    return masked_stats_;
+}
+
+TimingStats& primask_stats()
+{
+    return primask_stats_;
+}
+
+bool in_interrupt()
+{
+    return ipsr_ != 0;
+}
+
+void call_in_interrupt(const IRQn_Type irqn, const std::function<void()>& fn)
+{
+    {
+        detail::InterruptScope scope(irqn);
+        fn();
+    }
+    if (ipsr_ == 0 && !masked() && bus_ != nullptr)
+        bus_->service_interrupts();
+}
+
+/*
+ * 帧格式
+ */
+
+namespace
+{
+
+/**
+ * 按位收集帧的填充区（SOF 到 CRC），计算 CRC-15 与填充位数
+ */
+class BitStream
+{
+public:
+    void push(const uint32_t value, const uint32_t bits)
+    {
+        for (uint32_t i = bits; i-- > 0;)
+            push_bit(((value >> i) & 1U) != 0);
+    }
+
+    void push_crc()
+    {
+        const uint16_t crc = crc_;
+        push(crc, 15);
+    }
+
+    [[nodiscard]] uint32_t bits() const { return bits_ + stuff_bits_; }
+
+private:
+    void push_bit(const bool bit)
+    {
+        // CRC 只覆盖 SOF 到数据段，CRC 字段本身不参与计算，但参与位填充
+        if (!crc_done_)
+        {
+            const bool next = bit != (((crc_ >> 14) & 1U) != 0);
+            crc_            = static_cast<uint16_t>((crc_ << 1) & 0x7FFF);
+            if (next)
+                crc_ ^= 0x4599;
+        }
+
+        ++bits_;
+        if (run_ > 0 && bit == last_)
+            ++run_;
+        else
+            run_ = 1;
+        last_ = bit;
+        if (run_ == 5)
+        {
+            // 插入一个相反的填充位，它开始新的一段
+            ++stuff_bits_;
+            last_ = !bit;
+            run_  = 1;
+        }
+    }
+
+    friend uint32_t can_sim::frame_bits(const Frame& frame);
+
+    uint16_t crc_{ 0 };
+    bool     crc_done_{ false };
+    uint32_t bits_{ 0 };
+    uint32_t stuff_bits_{ 0 };
+    uint32_t run_{ 0 };
+    bool     last_{ false };
+};
+
+// CAN FD 的 DLC 编码 -> 数据长度
+constexpr uint8_t FD_DLC_LENGTH[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+/**
+ * CAN FD 帧的位数，data_bits 写入按数据段波特率发送的位数
+ *
+ * 动态填充只覆盖 SOF 到数据段；CRC 字段由 4 位填充计数与 17 / 21 位 CRC 组成，
+ * 每 4 位插入一个固定填充位（含填充计数之前的一个，共 6 / 7 位），其长度与帧内容无关
+ */
+uint32_t fd_frame_bits(const Frame& frame, uint32_t* data_bits)
+{
+    BitStream stream;
+    stream.push(0, 1); // SOF
+    if (!frame.ext)
+    {
+        stream.push(frame.id & 0x7FF, 11);
+        stream.push(0, 1); // RRS
+        stream.push(0, 1); // IDE
+    }
+    else
+    {
+        stream.push((frame.id >> 18) & 0x7FF, 11);
+        stream.push(1, 1); // SRR
+        stream.push(1, 1); // IDE
+        stream.push(frame.id & 0x3FFFF, 18);
+        stream.push(0, 1); // RRS
+    }
+    stream.push(1, 1);                 // FDF
+    stream.push(0, 1);                 // res
+    stream.push(frame.brs ? 1 : 0, 1); // BRS
+    const uint32_t arbitration = stream.bits();
+
+    stream.push(0, 1); // ESI
+    stream.push(frame.dlc & 0xF, 4);
+    const uint32_t len = FD_DLC_LENGTH[frame.dlc & 0xF];
+    for (uint32_t i = 0; i < len; ++i)
+        stream.push(frame.data[i], 8);
+
+    const uint32_t crc_field = len <= 16 ? 4 + 17 + 6 : 4 + 21 + 7;
+    // 数据段到 CRC 界定符为止
+    *data_bits = frame.brs ? stream.bits() - arbitration + crc_field + 1 : 0;
+    // CRC 界定符、ACK 槽、ACK 界定符、7 位 EOF、3 位帧间隔
+    return stream.bits() + crc_field + 13;
+}
+
+} // namespace
+
+uint8_t frame_length(const Frame& frame)
+{
+    if (frame.fd)
+        return FD_DLC_LENGTH[frame.dlc & 0xF];
+    return frame.rtr ? 0 : (frame.dlc > 8 ? 8 : frame.dlc);
+}
+
+uint32_t frame_bits(const Frame& frame)
+{
+    if (frame.fd)
+    {
+        uint32_t data_bits;
+        return fd_frame_bits(frame, &data_bits);
+    }
+
+    BitStream stream;
+    stream.push(0, 1); // SOF
+    if (!frame.ext)
+    {
+        stream.push(frame.id & 0x7FF, 11);
+        stream.push(frame.rtr ? 1 : 0, 1); // RTR
+        stream.push(0, 1);                 // IDE
+        stream.push(0, 1);                 // r0
+    }
+    else
+    {
+        stream.push((frame.id >> 18) & 0x7FF, 11);
+        stream.push(1, 1); // SRR
+        stream.push(1, 1); // IDE
+        stream.push(frame.id & 0x3FFFF, 18);
+        stream.push(frame.rtr ? 1 : 0, 1); // RTR
+        stream.push(0, 2);                 // r1 r0
+    }
+    stream.push(frame.dlc & 0xF, 4);
+    if (!frame.rtr)
+    {
+        const uint32_t len = frame.dlc > 8 ? 8 : frame.dlc;
+        for (uint32_t i = 0; i < len; ++i)
+            stream.push(frame.data[i], 8);
+    }
+    stream.crc_done_ = true;
+    stream.push_crc();
+    // CRC 界定符、ACK 槽、ACK 界定符、7 位 EOF、3 位帧间隔
+    return stream.bits() + 13;
+}
+
+uint32_t frame_data_bits(const Frame& frame)
+{
+    uint32_t data_bits = 0;
+    if (frame.fd)
+        (void) fd_frame_bits(frame, &data_bits);
+    return data_bits;
+}
+
+uint32_t arbitration_key(const Frame& frame)
+{
+    // 与 can_driver 的软件队列排序一致
+    if (!frame.ext)
+        return (frame.id & 0x7FF) << 21 | (frame.rtr ? 1U : 0U);
+    return ((frame.id >> 18) & 0x7FF) << 21 | 1U << 20 | (frame.id & 0x3FFFF) << 1 | (frame.rtr ? 1U : 0U);
+}
+
+/*
+ * 总线
+ */
+
+Node::Node(Bus& bus) : bus_(bus)
+{
+    bus_.attach(this);
+}
+
+Node::~Node()
+{
+    bus_.detach(this);
+}
+
+Bus::Bus(const uint32_t bitrate, const uint32_t data_bitrate)
+    : bitrate_(bitrate), data_bitrate_(data_bitrate != 0 ? data_bitrate : bitrate)
+{
+    if (bus_ != nullptr)
+    {
+        std::fprintf(stderr, "can_sim: only one Bus may exist at a time\n");
+        std::abort();
+    }
+    bus_ = this;
+}
+
+Bus::~Bus()
+{
+    bus_ = nullptr;
+}
+
+Bus* Bus::current()
+{
+    return bus_;
+}
+
+uint64_t Bus::bits_ns(const uint64_t bits) const
+{
+    return (bits * 1000000000ULL + bitrate_ / 2) / bitrate_;
+}
+
+uint64_t Bus::frame_ns(const Frame& frame) const
+{
+    const uint64_t bits      = frame_bits(frame);
+    const uint64_t data_bits = frame_data_bits(frame);
+    return bits_ns(bits - data_bits) + (data_bits * 1000000000ULL + data_bitrate_ / 2) / data_bitrate_;
+}
+
+void Bus::attach(Node* node)
+{
+    nodes_.push_back(node);
+}
+
+void Bus::detach(Node* node)
+{
+    nodes_.erase(std::remove(nodes_.begin(), nodes_.end(), node), nodes_.end());
+    if (transmitter_ == node)
+        transmitter_ = nullptr;
+}
+
+void Bus::service_interrupts()
+{
+    if (ipsr_ != 0)
+        return;
+    for (size_t i = 0; i < nodes_.size(); ++i)
+        nodes_[i]->service_interrupts();
+}
+
+void Bus::advance(const uint64_t time_ns)
+{
+    detail::set_now(time_ns);
+}
+
+void Bus::start_transfer()
+{
+    Node*    winner = nullptr;
+    Frame    best{};
+    uint32_t best_key = 0;
+
+    Node* contenders[16];
+    size_t count = 0;
+    for (Node* node : nodes_)
+    {
+        Frame frame;
+        if (!node->tx_pending(&frame))
+            continue;
+        if (count < std::size(contenders))
+            contenders[count++] = node;
+        const uint32_t key = arbitration_key(frame);
+        // 两个节点同时发送相同的仲裁场时真实总线上会在数据段出现位错误，这里简化为先挂接的节点获胜
+        if (winner == nullptr || key < best_key)
+        {
+            winner   = node;
+            best     = frame;
+            best_key = key;
+        }
+    }
+    if (winner == nullptr)
+        return;
+
+    for (size_t i = 0; i < count; ++i)
+        if (contenders[i] != winner)
+            contenders[i]->tx_lost();
+
+    const uint64_t now     = now_ns_;
+    const uint32_t bits    = frame_bits(best);
+    const bool     corrupt = winner->tx_begin() || !winner->synchronized();
+
+    bool acknowledged = winner->self_acknowledges();
+    for (const Node* node : nodes_)
+        if (node != winner && node->acknowledges() && node->synchronized())
+            acknowledged = true;
+
+    transfer_        = {};
+    transfer_.frame  = best;
+    transfer_.sender = winner;
+    transfer_.sof_ns = now;
+
+    // 错误帧：6 位错误标志、8 位错误界定符、3 位帧间隔，error passive 的发送方再暂停 8 位
+    // CAN FD 帧的数据段可能使用另一个波特率，按时间而不是位数截取
+    const uint32_t error_tail = 6 + 8 + 3 + (winner->error_passive() ? 8 : 0);
+    const uint64_t body_ns    = frame_ns(best) - bits_ns(13);
+    if (corrupt)
+    {
+        transfer_.result = Transfer::Result::BitError;
+        transfer_.end_ns = now + (best.fd ? body_ns / 2 + bits_ns(error_tail) : bits_ns((bits - 13) / 2 + error_tail));
+    }
+    else if (!acknowledged)
+    {
+        // 在 ACK 槽检测到错误，错误标志从 ACK 界定符开始
+        transfer_.result = Transfer::Result::AckError;
+        transfer_.end_ns = now + (best.fd ? body_ns + bits_ns(2 + error_tail) : bits_ns(bits - 13 + 2 + error_tail));
+    }
+    else
+    {
+        transfer_.result = Transfer::Result::Ok;
+        transfer_.end_ns = now + frame_ns(best);
+    }
+    transmitter_ = winner;
+    active_      = true;
+}
+
+void Bus::finish_transfer()
+{
+    active_                 = false;
+    const Transfer transfer = transfer_;
+    Node*          sender   = transmitter_;
+    transmitter_            = nullptr;
+
+    busy_ns_ += transfer.end_ns - transfer.sof_ns;
+    if (transfer.result == Transfer::Result::Ok)
+    {
+        ++frames_;
+        for (size_t i = 0; i < nodes_.size(); ++i)
+            if (nodes_[i] != sender && nodes_[i]->synchronized())
+                nodes_[i]->rx(transfer.frame, transfer.sof_ns);
+    }
+    else
+    {
+        ++error_frames_;
+        for (size_t i = 0; i < nodes_.size(); ++i)
+            if (nodes_[i] != sender && nodes_[i]->synchronized())
+                nodes_[i]->rx_error();
+    }
+    if (sender != nullptr)
+        sender->tx_end(transfer.result);
+
+    for (size_t i = 0; i < nodes_.size(); ++i)
+        nodes_[i]->on_transfer(transfer);
+    if (monitor_)
+        monitor_(transfer);
+}
+
+void Bus::run_until(const uint64_t time_ns)
+{
+    for (;;)
+    {
+        service_interrupts();
+        if (!active_)
+            start_transfer();
+
+        const uint64_t next = next_event_ns();
+        if (next > time_ns)
+            break;
+
+        advance(next);
+        if (active_ && transfer_.end_ns <= now_ns_)
+            finish_transfer();
+        for (size_t i = 0; i < nodes_.size(); ++i)
+            nodes_[i]->on_time();
+    }
+
+    advance(time_ns);
+    for (size_t i = 0; i < nodes_.size(); ++i)
+        nodes_[i]->on_time();
+    service_interrupts();
+}
+
+void Bus::run_for(const uint64_t duration_ns)
+{
+    run_until(now_ns_ + duration_ns);
+}
+
+bool Bus::idle()
+{
+    if (active_)
+        return false;
+    // 仍有帧待发送，或有节点在等待定时事件（例如 bus-off 恢复）都不算空闲
+    for (Node* node : nodes_)
+    {
+        Frame frame;
+        if (node->tx_pending(&frame) || node->next_event_ns() != NEVER)
+            return false;
+    }
+    return true;
+}
+
+uint64_t Bus::next_event_ns() const
+{
+    uint64_t next = active_ ? transfer_.end_ns : NEVER;
+    for (const Node* node : nodes_)
+        next = std::min(next, node->next_event_ns());
+    return next;
+}
+
+bool Bus::run_until_idle(const uint64_t timeout_ns)
+{
+    const uint64_t deadline = now_ns_ + timeout_ns;
+    for (;;)
+    {
+        service_interrupts();
+        if (idle())
+            return true;
+        if (now_ns_ >= deadline)
+            return false;
+
+        if (!active_)
+            start_transfer();
+        const uint64_t next = next_event_ns();
+        // 有待发送帧但无法发送（例如 bus-off 且未在恢复）时一直等到超时
+        run_until(std::min(next, deadline));
+    }
+}
+
+/*
+ * 外部节点
+ */
+
+VirtualNode::VirtualNode(Bus& bus, const bool acknowledge) : Node(bus), acknowledge_(acknowledge) {}
+
+void VirtualNode::send(const Frame& frame)
+{
+    tx_queue_.push_back(frame);
+}
+
+bool VirtualNode::tx_pending(Frame* frame)
+{
+    if (tx_head_ == tx_queue_.size())
+        return false;
+    *frame = tx_queue_[tx_head_];
+    return true;
+}
+
+void VirtualNode::tx_end(const Transfer::Result result)
+{
+    // 出错时自动重发
+    if (result != Transfer::Result::Ok)
+        return;
+    ++tx_count_;
+    if (++tx_head_ == tx_queue_.size())
+    {
+        tx_queue_.clear();
+        tx_head_ = 0;
+    }
+}
+
+void VirtualNode::rx(const Frame& frame, const uint64_t sof_ns)
+{
+    received_.push_back({ frame, sof_ns, now_ns_ });
+    if (rx_callback_)
+        rx_callback_(frame);
+}
+
+} // namespace can_sim
+
+/*
+ * CMSIS 与 HAL 公共部分
+ */
+
+extern "C"
+{
+uint32_t sim_get_primask()
+{
+    return can_sim::primask_;
+}
+
+void sim_set_primask(const uint32_t primask)
+{
+    const bool was_masked = can_sim::masked();
+    if (can_sim::primask_ == 0 && (primask & 1U) != 0)
+        can_sim::primask_at_ = can_sim::detail::host_ns();
+    else if (can_sim::primask_ != 0 && (primask & 1U) == 0)
+        can_sim::primask_stats_.add(can_sim::detail::host_ns() - can_sim::primask_at_);
+    can_sim::primask_ = primask & 1U;
+    can_sim::mask_changed(was_masked);
+}
+
+uint32_t sim_get_basepri()
+{
+    return can_sim::basepri_;
+}
+
+void sim_set_basepri(const uint32_t basepri)
+{
+    const bool was_masked = can_sim::masked();
+    can_sim::basepri_     = basepri & 0xFFU;
+    can_sim::mask_changed(was_masked);
+}
+
+uint32_t sim_get_ipsr()
+{
+    return can_sim::ipsr_;
+}
+}
+
+uint32_t NVIC_GetPriority(const IRQn_Type irqn)
+{
+    if (irqn < 0 || irqn >= SIM_IRQ_NUM)
+        return 0;
+    return can_sim::nvic_priority_[irqn];
+}
+
+void NVIC_SetPriority(const IRQn_Type irqn, const uint32_t priority)
+{
+    if (irqn >= 0 && irqn < SIM_IRQ_NUM)
+        can_sim::nvic_priority_[irqn] = static_cast<uint8_t>(priority & ((1U << __NVIC_PRIO_BITS) - 1));
+}
+
+DWT_Type       sim_dwt;
+CoreDebug_Type sim_core_debug;
+uint32_t       SystemCoreClock = 168000000;
+
+SimCycleCounter::operator uint32_t() const
+{
+    return static_cast<uint32_t>(static_cast<unsigned __int128>(can_sim::now_ns_) * SystemCoreClock / 1000000000U);
+}
+
+uint32_t HAL_GetTick()
+{
+    return static_cast<uint32_t>(can_sim::now_ns_ / 1000000U);
+}
+
+void HAL_Delay(const uint32_t delay_ms)
+{
+    const uint64_t duration = static_cast<uint64_t>(delay_ms) * 1000000U;
+    if (can_sim::bus_ != nullptr)
+        can_sim::bus_->run_for(duration);
+    else
+        can_sim::detail::set_now(can_sim::now_ns_ + duration);
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq()
+{
+    return 42000000U;
+}
+
+void sim_error_handler(const char* file, const int line)
+{
+    std::fprintf(stderr, "Error_Handler() called at %s:%d\n", file, line);
+    std::abort();
+}
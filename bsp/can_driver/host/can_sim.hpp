@@ -0,0 +1,710 @@
+/**
+ * @file    can_sim.hpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   主机上的 CAN 总线与 bxCAN / FDCAN 外设仿真。
+ *
+ * 用于在主机上运行 can_driver 与其上层协议（CanIsoTp 等）的测试和基准，不需要开发板：
+ *
+ * - Bus：一条虚拟总线，按位时间推进仿真时钟。总线空闲时所有节点的待发送帧按 CAN 仲裁规则竞争，
+ *   帧长按实际位填充计算，收发结束、错误帧、bus-off 恢复都发生在确定的仿真时刻；
+ * - BxCan：一个 bxCAN 控制器。寄存器（见 host/include/can_hal.h）按参考手册的语义实现：
+ *   3 个发送邮箱（TXFP 决定按 ID 还是按请求顺序发送，相同 ID 时编号小的邮箱优先）、
+ *   两个 3 级接收 FIFO（溢出按 RFLM 覆盖最后一帧或丢弃新帧）、28 组过滤器与 FMI 编号、
+ *   TEC / REC 错误计数与 error warning / passive / bus-off 状态、ABOM 自动恢复或手动恢复（128 × 11 个隐性位）、
+ *   NART、静默与环回模式；HAL_CAN_* 与 HAL_CAN_IRQHandler 基于这些寄存器实现，与 HAL 行为一致；
+ * - FdCan：一个 STM32G4 的 FDCAN 控制器（主机构建定义 SIM_FDCAN=1 时代替 BxCan，寄存器见 host/include/fdcan_hal.h）：
+ *   3 个 TX Buffer 组成的 TX FIFO / Queue（TXBC.TFQM 选择按请求顺序还是按 ID 发送）、TXBCR 取消与 TXBTO / TXBCF、
+ *   28 + 8 个过滤器元素与 RXGFC 的全局过滤、两个 3 元素的接收 FIFO（阻塞或覆盖模式）、CAN FD 帧与数据段波特率切换、
+ *   TEC / REC 与 PSR 的 EW / EP / BO、bus-off 后硬件置位 CCCR.INIT，清除后检测 129 × 11 个隐性位恢复；
+ *   HAL_FDCAN_* 与 HAL_FDCAN_IRQHandler 的分发顺序与 G4 HAL 一致；
+ * - VirtualNode：由测试脚本驱动的外部节点，可发送任意帧并记录收到的帧，也可以不应答；
+ * - SocketCanBridge（仅 Linux）：把一个 SocketCAN 接口接入虚拟总线，可以用 can-utils 观察或注入仿真总线的流量；
+ * - LogReplayer（log_replay.hpp）：把记录器输出的日志按记录时间回放到虚拟总线。
+ *
+ * 中断模型：仿真是单线程的，中断在以下时刻由仿真调用：每个总线事件之后，以及 PRIMASK / BASEPRI
+ * 恢复为不屏蔽时（临界区中到达的中断在退出临界区后立即响应）。中断处理本身不消耗仿真时间，
+ * 但按主机时间统计耗时（BxCan::isr_stats），关中断时长同样按主机时间统计（masked_stats），
+ * 可以用来比较不同实现的中断与临界区开销。
+ *
+ * 典型用法：
+ *
+ * ```cpp
+ * can_sim::Bus    bus(1000000);
+ * can_sim::BxCan  can1(bus);
+ * can_sim::VirtualNode peer(bus);
+ *
+ * CAN_InitMainCallback(can1.handle());
+ * CAN_Start(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+ *
+ * CAN_SendMessage(can1.handle(), &header, data);
+ * bus.run_for(1'000'000); // 1 ms
+ * ```
+ */
+#pragma once
+
+#include "main.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace can_sim
+{
+
+constexpr uint64_t NEVER = UINT64_MAX;
+
+/**
+ * 当前仿真时间，单位纳秒
+ */
+uint64_t now_ns();
+
+/**
+ * 总线上的一帧
+ *
+ * 经典帧的 dlc 为 0 ~ 15，超过 8 仍只有 8 字节数据；CAN FD 帧（fd）没有远程帧，dlc 9 ~ 15 对应 12 ~ 64 字节，
+ * brs 表示数据段使用总线的数据段波特率。只支持经典 CAN 的节点（BxCan、SocketCanBridge）忽略 CAN FD 帧
+ */
+struct Frame
+{
+    uint32_t id{ 0 };
+    bool     ext{ false };
+    bool     rtr{ false };
+    uint8_t  dlc{ 0 };
+    uint8_t  data[64]{};
+    bool     fd{ false };
+    bool     brs{ false };
+};
+
+/**
+ * 帧的数据字节数
+ */
+uint8_t frame_length(const Frame& frame);
+
+/**
+ * 帧在总线上占用的位数：按帧内容计算实际的位填充，含 CRC 界定符、ACK、EOF 与 3 位帧间隔；
+ * CAN FD 帧的 CRC 字段使用固定填充（含填充计数）
+ */
+uint32_t frame_bits(const Frame& frame);
+
+/**
+ * 其中按数据段波特率发送的位数：开启 BRS 的 CAN FD 帧从 BRS 之后到 CRC 界定符，其余帧为 0
+ */
+uint32_t frame_data_bits(const Frame& frame);
+
+/**
+ * 仲裁优先级，数值越小越优先：11 位基本 ID，标准帧优先于同基本 ID 的扩展帧，再比较扩展 ID 低 18 位，数据帧优先于远程帧
+ */
+uint32_t arbitration_key(const Frame& frame);
+
+/**
+ * 按主机时间统计的耗时
+ */
+struct TimingStats
+{
+    uint64_t count{ 0 };
+    uint64_t total_ns{ 0 };
+    uint64_t max_ns{ 0 };
+
+    void add(uint64_t ns);
+    void reset() { *this = {}; }
+
+    [[nodiscard]] double avg_ns() const { return count == 0 ? 0.0 : static_cast<double>(total_ns) / count; }
+};
+
+/**
+ * 中断被屏蔽（PRIMASK 或 BASEPRI 非 0）的时长，统计所有临界区（含中断中的临界区）
+ */
+TimingStats& masked_stats();
+
+/**
+ * PRIMASK 置位（屏蔽全部可配置优先级的中断）的时长，不含只提升 BASEPRI 的临界区
+ */
+TimingStats& primask_stats();
+
+/**
+ * 当前是否在仿真调用的中断处理中
+ */
+bool in_interrupt();
+
+/**
+ * 以中断 irqn 的身份调用 fn（IPSR 置为对应值，期间不响应其他中断），用于测试在中断中调用驱动接口
+ */
+void call_in_interrupt(IRQn_Type irqn, const std::function<void()>& fn);
+
+namespace detail
+{
+/// 优先级为 priority 的中断当前是否被屏蔽（PRIMASK、BASEPRI，或正在处理其他中断）
+bool irq_masked(uint32_t priority);
+
+/// 主机单调时钟，单位纳秒
+uint64_t host_ns();
+
+/// 推进仿真时钟（只会向前）
+void set_now(uint64_t time_ns);
+
+/**
+ * 以中断身份执行期间设置 IPSR
+ */
+class InterruptScope
+{
+public:
+    explicit InterruptScope(IRQn_Type irqn);
+    ~InterruptScope();
+
+    InterruptScope(const InterruptScope&)            = delete;
+    InterruptScope& operator=(const InterruptScope&) = delete;
+
+private:
+    uint32_t saved_;
+};
+} // namespace detail
+
+class Bus;
+
+/**
+ * 一次总线传输（成功的帧或以错误帧结束的帧）
+ */
+struct Transfer
+{
+    enum class Result : uint8_t
+    {
+        Ok,
+        AckError, ///< 没有节点应答
+        BitError, ///< 发送节点检测到位错误（故障注入或波特率不一致）
+    };
+
+    Frame       frame;
+    const void* sender{ nullptr }; ///< 发送节点
+    uint64_t    sof_ns{ 0 };
+    uint64_t    end_ns{ 0 }; ///< 含帧间隔，此刻总线重新空闲
+    Result      result{ Result::Ok };
+};
+
+/**
+ * 总线上的一个节点
+ */
+class Node
+{
+public:
+    explicit Node(Bus& bus);
+    virtual ~Node();
+
+    Node(const Node&)            = delete;
+    Node& operator=(const Node&) = delete;
+
+    [[nodiscard]] Bus& bus() const { return bus_; }
+
+protected:
+    friend class Bus;
+
+    /**
+     * 下一次仲裁时要发送的帧
+     * @return 没有待发送帧时返回 false
+     */
+    virtual bool tx_pending(Frame* frame) = 0;
+
+    /**
+     * 赢得仲裁，帧开始发送
+     * @return 本次发送会被破坏（以位错误结束）时返回 true
+     */
+    virtual bool tx_begin() { return false; }
+
+    /// 参与了仲裁但输给了更高优先级的帧
+    virtual void tx_lost() {}
+
+    /// 本节点的帧发送结束
+    virtual void tx_end(Transfer::Result result) = 0;
+
+    /// 能否应答其他节点的帧
+    [[nodiscard]] virtual bool acknowledges() const { return true; }
+
+    /// 发送时不需要其他节点应答（环回模式）
+    [[nodiscard]] virtual bool self_acknowledges() const { return false; }
+
+    /// 与总线波特率一致，能正确收发
+    [[nodiscard]] virtual bool synchronized() const { return true; }
+
+    /// 处于 error passive 状态：发送错误帧后需要额外的 8 位暂停发送
+    [[nodiscard]] virtual bool error_passive() const { return false; }
+
+    /// 收到其他节点成功发送的帧
+    virtual void rx(const Frame& frame, uint64_t sof_ns) = 0;
+
+    /// 其他节点的帧以错误帧结束
+    virtual void rx_error() {}
+
+    /// 每次传输结束后通知所有节点（含发送节点）
+    virtual void on_transfer(const Transfer& transfer) { (void) transfer; }
+
+    /// 下一个定时事件的仿真时刻，没有时返回 NEVER
+    [[nodiscard]] virtual uint64_t next_event_ns() const { return NEVER; }
+
+    /// 仿真时间推进后调用
+    virtual void on_time() {}
+
+    /// 调用所有已挂起且未被屏蔽的中断
+    virtual void service_interrupts() {}
+
+private:
+    Bus& bus_;
+};
+
+/**
+ * 一条虚拟 CAN 总线
+ *
+ * 同一时刻只允许存在一条 Bus，它负责推进全局的仿真时钟
+ */
+class Bus
+{
+public:
+    /**
+     * @param bitrate 仲裁段波特率
+     * @param data_bitrate CAN FD 数据段波特率，0 表示与仲裁段相同
+     */
+    explicit Bus(uint32_t bitrate = 1000000, uint32_t data_bitrate = 0);
+    ~Bus();
+
+    Bus(const Bus&)            = delete;
+    Bus& operator=(const Bus&) = delete;
+
+    [[nodiscard]] uint32_t bitrate() const { return bitrate_; }
+    [[nodiscard]] uint32_t data_bitrate() const { return data_bitrate_; }
+
+    /// bits 个位时间，单位纳秒
+    [[nodiscard]] uint64_t bits_ns(uint64_t bits) const;
+
+    /// 一帧成功发送占用总线的时间（含帧间隔），开启 BRS 的 CAN FD 帧数据段按数据段波特率计算
+    [[nodiscard]] uint64_t frame_ns(const Frame& frame) const;
+
+    /**
+     * 推进仿真时间，期间按时间顺序处理所有总线事件并调用中断
+     */
+    void run_for(uint64_t duration_ns);
+    void run_until(uint64_t time_ns);
+
+    /**
+     * 运行到总线空闲、没有节点有待发送帧或待处理的定时事件
+     * @return timeout_ns 内未能空闲时返回 false
+     */
+    bool run_until_idle(uint64_t timeout_ns = 1000000000ULL);
+
+    /// 当前没有帧在发送，且没有节点有待发送帧或待处理的定时事件
+    [[nodiscard]] bool idle();
+
+    /// 下一个总线事件（当前传输结束或节点的定时事件）的仿真时刻，没有时返回 NEVER
+    [[nodiscard]] uint64_t next_event_ns() const;
+
+    /// 调用所有节点已挂起的中断
+    void service_interrupts();
+
+    /// 每次传输结束时调用，用于记录总线上的全部流量
+    void set_monitor(std::function<void(const Transfer&)> monitor) { monitor_ = std::move(monitor); }
+
+    /// 当前有帧正在发送
+    [[nodiscard]] bool transferring() const { return active_; }
+
+    [[nodiscard]] uint64_t frames() const { return frames_; }
+    [[nodiscard]] uint64_t error_frames() const { return error_frames_; }
+    /// 总线被占用（含错误帧与帧间隔）的累计时间
+    [[nodiscard]] uint64_t busy_ns() const { return busy_ns_; }
+
+    /// 当前存在的总线，没有时返回 nullptr
+    static Bus* current();
+
+private:
+    friend class Node;
+
+    void attach(Node* node);
+    void detach(Node* node);
+
+    void start_transfer();
+    void finish_transfer();
+    void advance(uint64_t time_ns);
+
+    uint32_t              bitrate_;
+    uint32_t              data_bitrate_;
+    std::vector<Node*>    nodes_;
+    bool                  active_{ false };
+    Transfer              transfer_{};
+    Node*                 transmitter_{ nullptr };
+    uint64_t              frames_{ 0 };
+    uint64_t              error_frames_{ 0 };
+    uint64_t              busy_ns_{ 0 };
+    std::function<void(const Transfer&)> monitor_;
+};
+
+#if defined(HAL_CAN_MODULE_ENABLED)
+
+/**
+ * 一个 bxCAN 控制器
+ *
+ * 构造时按总线波特率填好 handle()->Init（APB1 42 MHz，每位 14 tq）并调用 HAL_CAN_Init，
+ * 之后的用法与 CubeMX 生成的 hcan 相同
+ */
+class BxCan final : public Node, private SimRegisterHook
+{
+public:
+    explicit BxCan(Bus& bus);
+    ~BxCan() override;
+
+    [[nodiscard]] CAN_HandleTypeDef* handle() { return &hcan_; }
+    [[nodiscard]] CAN_TypeDef*       instance() { return &regs_; }
+
+    /**
+     * 用一个 32 位 mask 模式过滤器组接收所有帧，代替应用中通常由 CubeMX 用户代码完成的过滤器配置
+     */
+    void accept_all(uint32_t fifo = CAN_FILTER_FIFO0, uint32_t bank = 0);
+
+    /**
+     * 之后 count 次发送尝试都以位错误结束（每次 TEC + 8），用于制造 error passive 与 bus-off
+     */
+    void inject_tx_errors(uint32_t count) { injected_tx_errors_ = count; }
+
+    /**
+     * 直接设置错误计数，tec 超过 255 时立即进入 bus-off
+     */
+    void set_error_counters(uint32_t tec, uint32_t rec);
+
+    [[nodiscard]] uint32_t tec() const { return tec_; }
+    [[nodiscard]] uint32_t rec() const { return rec_; }
+    [[nodiscard]] bool     bus_off() const { return bus_off_; }
+
+    /// 接收 FIFO 因已满而溢出的帧数
+    [[nodiscard]] uint32_t rx_overruns(uint32_t fifo) const { return overruns_[fifo]; }
+
+    /**
+     * 替换中断向量的处理函数（CAN1_TX_IRQn、CAN1_RX0_IRQn、CAN1_RX1_IRQn、CAN1_SCE_IRQn），
+     * 默认都调用 HAL_CAN_IRQHandler，与 CubeMX 生成的 stm32xx_it.c 相同；传入空函数恢复默认
+     */
+    void set_irq_handler(IRQn_Type irqn, std::function<void()> handler);
+
+    /// 每次中断处理的主机耗时
+    [[nodiscard]] const TimingStats& isr_stats() const { return isr_stats_; }
+    void                             reset_isr_stats() { isr_stats_.reset(); }
+
+    /// 经由 SimReg 的寄存器读写次数（外设模型自身的 raw() 访问不计），目标板上每次外设访问都要走 APB 总线
+    [[nodiscard]] uint64_t register_accesses() const { return register_accesses_; }
+    void                   reset_register_accesses() { register_accesses_ = 0; }
+
+    /// 按 Instance 查找控制器
+    static BxCan* from(const CAN_HandleTypeDef* hcan);
+
+private:
+    enum class MailboxState : uint8_t
+    {
+        Empty,
+        Pending,
+        Transmitting,
+    };
+
+    struct Mailbox
+    {
+        MailboxState state{ MailboxState::Empty };
+        bool         abort{ false };
+        uint64_t     sequence{ 0 }; // 请求发送的顺序，TXFP = 1 时按它发送
+    };
+
+    struct RxEntry
+    {
+        uint32_t rir;
+        uint32_t rdtr;
+        uint32_t rdlr;
+        uint32_t rdhr;
+    };
+
+    // SimRegisterHook
+    uint32_t read(const SimReg& reg) override;
+    void     write(SimReg& reg, uint32_t value) override;
+
+    // Node
+    bool     tx_pending(Frame* frame) override;
+    bool     tx_begin() override;
+    void     tx_lost() override;
+    void     tx_end(Transfer::Result result) override;
+    bool     acknowledges() const override;
+    bool     self_acknowledges() const override;
+    bool     synchronized() const override;
+    bool     error_passive() const override { return tec_ >= 128; }
+    void     rx(const Frame& frame, uint64_t sof_ns) override;
+    void     rx_error() override;
+    void     on_transfer(const Transfer& transfer) override;
+    uint64_t next_event_ns() const override;
+    void     on_time() override;
+    void     service_interrupts() override;
+
+    [[nodiscard]] size_t offset(const SimReg& reg) const;
+    [[nodiscard]] bool   initializing() const { return (regs_.MCR.raw() & CAN_MCR_INRQ) != 0; }
+    [[nodiscard]] bool   participating() const
+    {
+        return (regs_.MCR.raw() & (CAN_MCR_INRQ | CAN_MCR_SLEEP)) == 0 && !bus_off_;
+    }
+    [[nodiscard]] uint32_t bitrate() const;
+
+    int   select_mailbox() const;
+    Frame mailbox_frame(size_t index) const;
+    void complete_mailbox(size_t index, uint32_t flags);
+    void write_tsr(uint32_t value);
+    void write_tir(size_t index, uint32_t value);
+    void write_rfr(uint32_t fifo, uint32_t value);
+    void write_mcr(uint32_t value);
+
+    void abort_mailbox(size_t index);
+    void receive(const Frame& frame, uint64_t sof_ns);
+    bool match_filters(const Frame& frame, uint32_t* fifo, uint32_t* fmi) const;
+    void push_fifo(uint32_t fifo, const RxEntry& entry);
+
+    void add_tec(uint32_t amount);
+    void update_error_flags();
+    void set_lec(uint32_t lec);
+    void enter_bus_off();
+    void leave_bus_off();
+
+    [[nodiscard]] IRQn_Type pending_irq() const;
+
+    CAN_TypeDef       regs_{};
+    CAN_HandleTypeDef hcan_{};
+
+    Mailbox  mailboxes_[3]{};
+    int      candidate_{ -1 }; // tx_pending 选出的邮箱
+    int      transmitting_{ -1 };
+    uint64_t next_sequence_{ 1 };
+
+    RxEntry  fifo_[2][3]{};
+    uint32_t fifo_count_[2]{};
+    uint32_t overruns_[2]{};
+
+    uint32_t tec_{ 0 };
+    uint32_t rec_{ 0 };
+    bool     bus_off_{ false };
+    uint32_t esr_flags_{ 0 }; // 上一次的 EWGF / EPVF / BOFF，用于检测状态变化
+    // bus-off 恢复：还需要检测到的 11 个连续隐性位的次数，0 表示未在恢复
+    uint32_t recovery_sequences_{ 0 };
+    uint64_t recovery_mark_ns_{ 0 }; // 上次计入隐性位序列的时刻
+
+    uint32_t injected_tx_errors_{ 0 };
+
+    std::function<void()> irq_handlers_[4];
+    TimingStats isr_stats_;
+    uint64_t    register_accesses_{ 0 };
+};
+
+#endif // HAL_CAN_MODULE_ENABLED
+
+#if defined(HAL_FDCAN_MODULE_ENABLED)
+
+/**
+ * 一个 STM32G4 的 FDCAN 控制器
+ *
+ * 构造时按总线的两个波特率填好 handle()->Init（内核时钟 80 MHz，采样点 80 %）并调用 HAL_FDCAN_Init，
+ * 之后的用法与 CubeMX 生成的 hfdcan 相同；修改 Init 后再次调用 HAL_FDCAN_Init 即可改变帧格式、TX FIFO / Queue 等配置。
+ * 接收先按 RXGFC.LSS / LSE 个过滤器元素依次匹配，都不匹配时按 RXGFC 的全局过滤（复位值为全部进入 FIFO0）；
+ * 不模拟高优先级消息（HPM），FDCAN_FILTER_HP 匹配后不存储，TO_RXFIFOx_HP 与 TO_RXFIFOx 相同
+ */
+class FdCan final : public Node, private SimRegisterHook
+{
+public:
+    /// 仿真的 FDCAN 内核时钟
+    static constexpr uint32_t KERNEL_CLOCK = 80000000U;
+
+    /**
+     * 消息 RAM：HAL 按 G4 的元素格式读写，外设模型据此收发
+     */
+    struct MessageRam
+    {
+        uint32_t         std_filter[FDCAN_SIM_STD_FILTERS];
+        uint32_t         ext_filter[FDCAN_SIM_EXT_FILTERS][2];
+        FDCAN_SimElement rx_fifo[2][FDCAN_SIM_RX_FIFO_ELEMENTS];
+        FDCAN_SimElement tx_buffer[FDCAN_SIM_TX_BUFFERS];
+    };
+
+    /**
+     * @param frame_format FDCAN_FRAME_CLASSIC / FDCAN_FRAME_FD_NO_BRS / FDCAN_FRAME_FD_BRS
+     */
+    explicit FdCan(Bus& bus, uint32_t frame_format = FDCAN_FRAME_FD_BRS);
+    ~FdCan() override;
+
+    [[nodiscard]] FDCAN_HandleTypeDef* handle() { return &hfdcan_; }
+    [[nodiscard]] FDCAN_GlobalTypeDef* instance() { return &regs_; }
+    [[nodiscard]] MessageRam&          message_ram() { return ram_; }
+
+    /**
+     * 之后 count 次发送尝试都以位错误结束（每次 TEC + 8），用于制造 error passive 与 bus-off
+     */
+    void inject_tx_errors(uint32_t count) { injected_tx_errors_ = count; }
+
+    /**
+     * 直接设置错误计数，tec 超过 255 时立即进入 bus-off
+     */
+    void set_error_counters(uint32_t tec, uint32_t rec);
+
+    [[nodiscard]] uint32_t tec() const { return tec_; }
+    [[nodiscard]] uint32_t rec() const { return rec_; }
+    [[nodiscard]] bool     bus_off() const { return bus_off_; }
+
+    /// 接收 FIFO 因已满而丢弃或覆盖的帧数
+    [[nodiscard]] uint32_t rx_overruns(uint32_t fifo) const { return overruns_[fifo]; }
+
+    /**
+     * 替换中断向量的处理函数（FDCAN1_IT0_IRQn、FDCAN1_IT1_IRQn），默认调用 HAL_FDCAN_IRQHandler；传入空函数恢复默认
+     */
+    void set_irq_handler(IRQn_Type irqn, std::function<void()> handler);
+
+    /// 每次中断处理的主机耗时
+    [[nodiscard]] const TimingStats& isr_stats() const { return isr_stats_; }
+    void                             reset_isr_stats() { isr_stats_.reset(); }
+
+    /// 经由 SimReg 的寄存器读写次数（外设模型自身的 raw() 访问不计）
+    [[nodiscard]] uint64_t register_accesses() const { return register_accesses_; }
+    void                   reset_register_accesses() { register_accesses_ = 0; }
+
+    /// 按 Instance 查找控制器
+    static FdCan* from(const FDCAN_HandleTypeDef* hfdcan);
+
+private:
+    enum class BufferState : uint8_t
+    {
+        Empty,
+        Pending,
+        Transmitting,
+    };
+
+    struct TxBuffer
+    {
+        BufferState state{ BufferState::Empty };
+        bool        cancel{ false };
+        uint64_t    sequence{ 0 }; // 请求发送的顺序，FIFO 模式按它发送
+    };
+
+    // SimRegisterHook
+    uint32_t read(const SimReg& reg) override;
+    void     write(SimReg& reg, uint32_t value) override;
+
+    // Node
+    bool     tx_pending(Frame* frame) override;
+    bool     tx_begin() override;
+    void     tx_lost() override;
+    void     tx_end(Transfer::Result result) override;
+    bool     acknowledges() const override;
+    bool     self_acknowledges() const override;
+    bool     synchronized() const override;
+    bool     error_passive() const override { return tec_ >= 128; }
+    void     rx(const Frame& frame, uint64_t sof_ns) override;
+    void     rx_error() override;
+    void     on_transfer(const Transfer& transfer) override;
+    uint64_t next_event_ns() const override;
+    void     on_time() override;
+    void     service_interrupts() override;
+
+    [[nodiscard]] size_t offset(const SimReg& reg) const;
+    [[nodiscard]] bool   participating() const { return (regs_.CCCR.raw() & FDCAN_CCCR_INIT) == 0 && !bus_off_; }
+    [[nodiscard]] bool   monitoring() const { return (regs_.CCCR.raw() & FDCAN_CCCR_MON) != 0; }
+    [[nodiscard]] bool   loopback() const;
+    [[nodiscard]] uint32_t nominal_bitrate() const;
+    [[nodiscard]] uint32_t data_bitrate() const;
+
+    [[nodiscard]] uint32_t read_txfqs() const;
+    [[nodiscard]] uint32_t read_rxfs(uint32_t fifo) const;
+    [[nodiscard]] uint32_t pending_buffers() const;
+    void                   write_cccr(uint32_t value);
+    void                   request_buffers(uint32_t buffers);
+    void                   cancel_buffers(uint32_t buffers);
+    void                   acknowledge_fifo(uint32_t fifo, uint32_t index);
+
+    int   select_buffer() const;
+    Frame buffer_frame(size_t index) const;
+    void  finish_buffer(size_t index, bool sent, bool cancelled);
+
+    void receive(const Frame& frame, uint64_t sof_ns);
+    void set_ir(uint32_t flags);
+
+    void add_tec(uint32_t amount);
+    void set_lec(uint32_t lec);
+    void update_error_flags();
+    void enter_bus_off();
+    void leave_bus_off();
+
+    [[nodiscard]] IRQn_Type pending_irq() const;
+
+    FDCAN_GlobalTypeDef regs_{};
+    FDCAN_HandleTypeDef hfdcan_{};
+    MessageRam          ram_{};
+
+    TxBuffer buffers_[FDCAN_SIM_TX_BUFFERS]{};
+    int      candidate_{ -1 }; // tx_pending 选出的 Buffer
+    int      transmitting_{ -1 };
+    uint64_t next_sequence_{ 1 };
+    uint32_t put_index_{ 0 }; // FIFO 模式的下一个放入位置
+
+    uint32_t fifo_get_[2]{};
+    uint32_t fifo_count_[2]{};
+    uint32_t overruns_[2]{};
+
+    uint32_t tec_{ 0 };
+    uint32_t rec_{ 0 };
+    bool     bus_off_{ false };
+    uint32_t lec_{ FDCAN_PROTOCOL_ERROR_NO_CHANGE };
+    uint32_t psr_flags_{ 0 }; // 上一次的 EW / EP / BO，用于检测状态变化
+    // bus-off 恢复：还需要检测到的 11 个连续隐性位的次数，0 表示未在恢复
+    uint32_t recovery_sequences_{ 0 };
+    uint64_t recovery_mark_ns_{ 0 }; // 上次计入隐性位序列的时刻
+
+    uint32_t injected_tx_errors_{ 0 };
+
+    std::function<void()> irq_handlers_[2];
+    TimingStats           isr_stats_;
+    uint64_t              register_accesses_{ 0 };
+};
+
+#endif // HAL_FDCAN_MODULE_ENABLED
+
+/**
+ * 由测试脚本驱动的外部节点
+ *
+ * 发送队列按先入先出发送（相当于一个只有单个发送缓冲的简单控制器），收到的帧全部记录
+ */
+class VirtualNode : public Node
+{
+public:
+    struct Received
+    {
+        Frame    frame;
+        uint64_t sof_ns;
+        uint64_t end_ns;
+    };
+
+    /**
+     * @param acknowledge 是否应答其他节点的帧；总线上只剩不应答的节点时发送方会持续 ACK 错误
+     */
+    explicit VirtualNode(Bus& bus, bool acknowledge = true);
+
+    /// 排队发送一帧
+    void send(const Frame& frame);
+
+    /// 收到帧时调用（在总线事件中，不在中断上下文）
+    void set_rx_callback(std::function<void(const Frame&)> callback) { rx_callback_ = std::move(callback); }
+
+    [[nodiscard]] const std::vector<Received>& received() const { return received_; }
+    void                                       clear_received() { received_.clear(); }
+
+    [[nodiscard]] size_t   tx_backlog() const { return tx_queue_.size() - tx_head_; }
+    [[nodiscard]] uint64_t tx_count() const { return tx_count_; }
+
+    void set_acknowledge(bool acknowledge) { acknowledge_ = acknowledge; }
+
+protected:
+    bool tx_pending(Frame* frame) override;
+    void tx_end(Transfer::Result result) override;
+    bool acknowledges() const override { return acknowledge_; }
+    void rx(const Frame& frame, uint64_t sof_ns) override;
+
+private:
+    std::vector<Frame>                 tx_queue_;
+    size_t                             tx_head_{ 0 };
+    uint64_t                           tx_count_{ 0 };
+    bool                               acknowledge_;
+    std::vector<Received>              received_;
+    std::function<void(const Frame&)>  rx_callback_;
+};
+
+} // namespace can_sim
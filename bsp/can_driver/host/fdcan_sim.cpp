@@ -0,0 +1,1437 @@
+/**
+ * @file    fdcan_sim.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   FDCAN 外设模型与基于它的 HAL_FDCAN_* 实现。
+ *
+ * 寄存器语义按 RM0440 的 FDCAN 章节（STM32G4）实现，HAL 函数按 stm32g4xx_hal_fdcan.c 的寄存器访问顺序实现，
+ * 包括 HAL_FDCAN_IRQHandler 的分发顺序：先取消完成（TCF），再接收 FIFO，最后发送完成（TC），
+ * 且发送完成回调收到的是 TXBTO & TXBTIE，其中可能含有早先已经报告过的 Buffer。
+ */
+#include "can_sim.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+namespace can_sim
+{
+
+namespace
+{
+
+// 测试常把控制器定义为全局对象，构造时本文件的全局对象可能尚未初始化，用函数内静态对象保证先于使用构造
+std::vector<FdCan*>& controllers()
+{
+    static std::vector<FdCan*> list;
+    return list;
+}
+
+// 寄存器下标（以 SimReg 为单位）
+constexpr size_t reg_index(const size_t offset)
+{
+    return offset / sizeof(SimReg);
+}
+
+constexpr size_t CCCR  = reg_index(FDCAN_REG_OFFSET(CCCR));
+constexpr size_t NBTP  = reg_index(FDCAN_REG_OFFSET(NBTP));
+constexpr size_t DBTP  = reg_index(FDCAN_REG_OFFSET(DBTP));
+constexpr size_t ECR   = reg_index(FDCAN_REG_OFFSET(ECR));
+constexpr size_t PSR   = reg_index(FDCAN_REG_OFFSET(PSR));
+constexpr size_t IR    = reg_index(FDCAN_REG_OFFSET(IR));
+constexpr size_t RXGFC = reg_index(FDCAN_REG_OFFSET(RXGFC));
+constexpr size_t XIDAM = reg_index(FDCAN_REG_OFFSET(XIDAM));
+constexpr size_t RXF0S = reg_index(FDCAN_REG_OFFSET(RXF0S));
+constexpr size_t RXF0A = reg_index(FDCAN_REG_OFFSET(RXF0A));
+constexpr size_t RXF1S = reg_index(FDCAN_REG_OFFSET(RXF1S));
+constexpr size_t RXF1A = reg_index(FDCAN_REG_OFFSET(RXF1A));
+constexpr size_t TXBC  = reg_index(FDCAN_REG_OFFSET(TXBC));
+constexpr size_t TXFQS = reg_index(FDCAN_REG_OFFSET(TXFQS));
+constexpr size_t TXBRP = reg_index(FDCAN_REG_OFFSET(TXBRP));
+constexpr size_t TXBAR = reg_index(FDCAN_REG_OFFSET(TXBAR));
+constexpr size_t TXBCR = reg_index(FDCAN_REG_OFFSET(TXBCR));
+constexpr size_t TXBTO = reg_index(FDCAN_REG_OFFSET(TXBTO));
+constexpr size_t TXBCF = reg_index(FDCAN_REG_OFFSET(TXBCF));
+
+constexpr uint32_t FIFO_ELEMENTS = FDCAN_SIM_RX_FIFO_ELEMENTS;
+constexpr uint32_t TX_BUFFERS    = FDCAN_SIM_TX_BUFFERS;
+
+// 只有 INIT 与 CCE 同时为 1 时才能修改的 CCCR 位
+constexpr uint32_t CCCR_PROTECTED = FDCAN_CCCR_ASM | FDCAN_CCCR_MON | FDCAN_CCCR_DAR | FDCAN_CCCR_TEST |
+                                    FDCAN_CCCR_FDOE | FDCAN_CCCR_BRSE | FDCAN_CCCR_PXHD | FDCAN_CCCR_EFBI |
+                                    FDCAN_CCCR_TXP | FDCAN_CCCR_NISO;
+
+constexpr uint32_t PSR_STATUS = FDCAN_PSR_EW | FDCAN_PSR_EP | FDCAN_PSR_BO;
+
+// bus-off 后需要检测到的 11 个连续隐性位的次数
+constexpr uint32_t RECOVERY_SEQUENCES = 129;
+
+constexpr uint8_t DLC_LENGTH[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+/**
+ * ILS 中被选中的中断组包含的 IR 标志
+ */
+uint32_t group_flags(const uint32_t groups)
+{
+    uint32_t flags = 0;
+    if ((groups & FDCAN_ILS_RXFIFO0) != 0)
+        flags |= FDCAN_IR_RF0N | FDCAN_IR_RF0F | FDCAN_IR_RF0L;
+    if ((groups & FDCAN_ILS_RXFIFO1) != 0)
+        flags |= FDCAN_IR_RF1N | FDCAN_IR_RF1F | FDCAN_IR_RF1L;
+    if ((groups & FDCAN_ILS_SMSG) != 0)
+        flags |= FDCAN_IR_HPM | FDCAN_IR_TC | FDCAN_IR_TCF;
+    if ((groups & FDCAN_ILS_TFERR) != 0)
+        flags |= FDCAN_IR_TFE | FDCAN_IR_TEFN | FDCAN_IR_TEFF | FDCAN_IR_TEFL;
+    if ((groups & FDCAN_ILS_MISC) != 0)
+        flags |= FDCAN_IR_TSW | FDCAN_IR_MRAF | FDCAN_IR_TOO;
+    if ((groups & FDCAN_ILS_BERR) != 0)
+        flags |= FDCAN_IR_ELO;
+    if ((groups & FDCAN_ILS_PERR) != 0)
+        flags |= FDCAN_IR_EP | FDCAN_IR_EW | FDCAN_IR_BO | FDCAN_IR_WDI | FDCAN_IR_PEA | FDCAN_IR_PED | FDCAN_IR_ARA;
+    return flags;
+}
+
+struct BitTiming
+{
+    uint32_t prescaler;
+    uint32_t seg1;
+    uint32_t seg2;
+};
+
+/**
+ * 选择最小的分频，使每位不超过 max_tq 个 tq，采样点 80 %
+ */
+BitTiming bit_timing(const uint32_t bitrate, const uint32_t max_prescaler, const uint32_t max_tq)
+{
+    for (uint32_t prescaler = 1; prescaler <= max_prescaler; ++prescaler)
+    {
+        if (FdCan::KERNEL_CLOCK % (prescaler * bitrate) != 0)
+            continue;
+        const uint32_t tq = FdCan::KERNEL_CLOCK / (prescaler * bitrate);
+        if (tq > max_tq)
+            continue;
+        if (tq < 4)
+            break;
+        const uint32_t seg2 = std::max(1U, tq / 5);
+        return { prescaler, tq - 1 - seg2, seg2 };
+    }
+    std::fprintf(stderr, "can_sim: %u bit/s cannot be derived from the %u Hz FDCAN kernel clock\n", bitrate,
+                 FdCan::KERNEL_CLOCK);
+    std::abort();
+}
+
+/**
+ * 过滤器元素的 ID 匹配：范围、双 ID 或经典的 ID + 掩码
+ */
+bool filter_matches(const uint32_t type, const uint32_t id, const uint32_t id1, const uint32_t id2)
+{
+    switch (type)
+    {
+    case FDCAN_FILTER_RANGE:
+    case FDCAN_FILTER_RANGE_NO_EIDM:
+        return id1 <= id && id <= id2;
+    case FDCAN_FILTER_DUAL:
+        return id == id1 || id == id2;
+    case FDCAN_FILTER_MASK:
+        return (id & id2) == (id1 & id2);
+    default:
+        return false;
+    }
+}
+
+void no_callback(FDCAN_HandleTypeDef* hfdcan, const uint32_t its)
+{
+    (void) hfdcan;
+    (void) its;
+}
+
+} // namespace
+
+FdCan::FdCan(Bus& bus, const uint32_t frame_format) : Node(bus)
+{
+    auto*        regs  = reinterpret_cast<SimReg*>(&regs_);
+    const size_t count = sizeof(FDCAN_GlobalTypeDef) / sizeof(SimReg);
+    for (size_t i = 0; i < count; ++i)
+        regs[i].bind(this);
+
+    // 复位值
+    regs_.CCCR.set_raw(FDCAN_CCCR_INIT);
+    regs_.NBTP.set_raw(0x06000A03U);
+    regs_.DBTP.set_raw(0x00000A33U);
+    regs_.XIDAM.set_raw(0x1FFFFFFFU);
+    controllers().push_back(this);
+
+    const BitTiming nominal = bit_timing(bus.bitrate(), 512, 80);
+    const BitTiming data    = bit_timing(bus.data_bitrate(), 32, 40);
+
+    hfdcan_.Instance                  = &regs_;
+    hfdcan_.Init.ClockDivider         = 0;
+    hfdcan_.Init.FrameFormat          = frame_format;
+    hfdcan_.Init.Mode                 = FDCAN_MODE_NORMAL;
+    hfdcan_.Init.AutoRetransmission   = ENABLE;
+    hfdcan_.Init.TransmitPause        = DISABLE;
+    hfdcan_.Init.ProtocolException    = DISABLE;
+    hfdcan_.Init.NominalPrescaler     = nominal.prescaler;
+    hfdcan_.Init.NominalSyncJumpWidth = nominal.seg2;
+    hfdcan_.Init.NominalTimeSeg1      = nominal.seg1;
+    hfdcan_.Init.NominalTimeSeg2      = nominal.seg2;
+    hfdcan_.Init.DataPrescaler        = data.prescaler;
+    hfdcan_.Init.DataSyncJumpWidth    = data.seg2;
+    hfdcan_.Init.DataTimeSeg1         = data.seg1;
+    hfdcan_.Init.DataTimeSeg2         = data.seg2;
+    hfdcan_.Init.StdFiltersNbr        = 0;
+    hfdcan_.Init.ExtFiltersNbr        = 0;
+    hfdcan_.Init.TxFifoQueueMode      = FDCAN_TX_FIFO_OPERATION;
+    if (HAL_FDCAN_Init(&hfdcan_) != HAL_OK)
+        Error_Handler();
+}
+
+FdCan::~FdCan()
+{
+    controllers().erase(std::remove(controllers().begin(), controllers().end(), this), controllers().end());
+}
+
+FdCan* FdCan::from(const FDCAN_HandleTypeDef* hfdcan)
+{
+    for (FdCan* can : controllers())
+        if (&can->regs_ == hfdcan->Instance)
+            return can;
+    return nullptr;
+}
+
+void FdCan::set_error_counters(const uint32_t tec, const uint32_t rec)
+{
+    rec_ = std::min(rec, 255U);
+    if (tec > 255)
+    {
+        enter_bus_off();
+        return;
+    }
+    tec_ = tec;
+    update_error_flags();
+}
+
+size_t FdCan::offset(const SimReg& reg) const
+{
+    return static_cast<size_t>(&reg - reinterpret_cast<const SimReg*>(&regs_));
+}
+
+bool FdCan::loopback() const
+{
+    return (regs_.CCCR.raw() & FDCAN_CCCR_TEST) != 0 && (regs_.TEST.raw() & FDCAN_TEST_LBCK) != 0;
+}
+
+uint32_t FdCan::nominal_bitrate() const
+{
+    const uint32_t nbtp = regs_.NBTP.raw();
+    const uint32_t brp  = ((nbtp & FDCAN_NBTP_NBRP) >> FDCAN_NBTP_NBRP_Pos) + 1;
+    const uint32_t seg1 = ((nbtp & FDCAN_NBTP_NTSEG1) >> FDCAN_NBTP_NTSEG1_Pos) + 1;
+    const uint32_t seg2 = ((nbtp & FDCAN_NBTP_NTSEG2) >> FDCAN_NBTP_NTSEG2_Pos) + 1;
+    return KERNEL_CLOCK / (brp * (1 + seg1 + seg2));
+}
+
+uint32_t FdCan::data_bitrate() const
+{
+    const uint32_t dbtp = regs_.DBTP.raw();
+    const uint32_t brp  = ((dbtp >> FDCAN_DBTP_DBRP_Pos) & 0x1FU) + 1;
+    const uint32_t seg1 = ((dbtp >> FDCAN_DBTP_DTSEG1_Pos) & 0x1FU) + 1;
+    const uint32_t seg2 = ((dbtp >> FDCAN_DBTP_DTSEG2_Pos) & 0xFU) + 1;
+    return KERNEL_CLOCK / (brp * (1 + seg1 + seg2));
+}
+
+/*
+ * 寄存器
+ */
+
+uint32_t FdCan::read(const SimReg& reg)
+{
+    ++register_accesses_;
+    switch (offset(reg))
+    {
+    case CCCR:
+    {
+        // 仿真中时钟停止请求立即得到应答
+        uint32_t value = reg.raw() & ~FDCAN_CCCR_CSA;
+        if ((value & FDCAN_CCCR_CSR) != 0)
+            value |= FDCAN_CCCR_CSA;
+        return value;
+    }
+    case PSR:
+    {
+        uint32_t value = psr_flags_ | lec_ << FDCAN_PSR_LEC_Pos | FDCAN_PROTOCOL_ERROR_NO_CHANGE << FDCAN_PSR_DLEC_Pos;
+        if (participating())
+            value |= 1U << FDCAN_PSR_ACT_Pos; // idle
+        // 读 PSR 后 LEC 置为 7（无变化）
+        lec_ = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+        return value;
+    }
+    case ECR:
+    {
+        uint32_t value = std::min(tec_, 255U) << FDCAN_ECR_TEC_Pos | std::min(rec_, 127U) << FDCAN_ECR_REC_Pos;
+        if (rec_ >= 128)
+            value |= FDCAN_ECR_RP;
+        return value;
+    }
+    case RXF0S:
+        return read_rxfs(0);
+    case RXF1S:
+        return read_rxfs(1);
+    case TXFQS:
+        return read_txfqs();
+    case TXBRP:
+        return pending_buffers();
+    default:
+        return reg.raw();
+    }
+}
+
+void FdCan::write(SimReg& reg, const uint32_t value)
+{
+    ++register_accesses_;
+    const bool configurable = (regs_.CCCR.raw() & (FDCAN_CCCR_INIT | FDCAN_CCCR_CCE)) ==
+                              (FDCAN_CCCR_INIT | FDCAN_CCCR_CCE);
+    switch (offset(reg))
+    {
+    case CCCR:
+        write_cccr(value);
+        break;
+    case IR:
+        reg.set_raw(reg.raw() & ~value);
+        break;
+    case NBTP:
+    case DBTP:
+    case RXGFC:
+    case XIDAM:
+    case TXBC:
+        if (configurable)
+            reg.set_raw(value);
+        break;
+    case RXF0A:
+        acknowledge_fifo(0, value & 0x3U);
+        break;
+    case RXF1A:
+        acknowledge_fifo(1, value & 0x3U);
+        break;
+    case TXBAR:
+        // 配置期间写入无效
+        if (!configurable)
+            request_buffers(value & ((1U << TX_BUFFERS) - 1));
+        break;
+    case TXBCR:
+        if (!configurable)
+            cancel_buffers(value & ((1U << TX_BUFFERS) - 1));
+        break;
+    case PSR:
+    case ECR:
+    case RXF0S:
+    case RXF1S:
+    case TXFQS:
+    case TXBRP:
+    case TXBTO:
+    case TXBCF:
+        // 只读
+        break;
+    default:
+        reg.set_raw(value);
+        break;
+    }
+
+    // 写寄存器可能使中断条件成立（使能中断、取消发送等），与硬件一样立即响应
+    if (!in_interrupt())
+        bus().service_interrupts();
+}
+
+void FdCan::write_cccr(uint32_t value)
+{
+    const uint32_t old = regs_.CCCR.raw();
+    // CCE 只能在 INIT 为 1 时置位，清除 INIT 时一并清除
+    if ((value & FDCAN_CCCR_INIT) == 0 || (old & FDCAN_CCCR_INIT) == 0)
+        value &= ~FDCAN_CCCR_CCE;
+    if ((old & (FDCAN_CCCR_INIT | FDCAN_CCCR_CCE)) != (FDCAN_CCCR_INIT | FDCAN_CCCR_CCE))
+        value = (value & ~CCCR_PROTECTED) | (old & CCCR_PROTECTED);
+    regs_.CCCR.set_raw(value);
+
+    // 离开初始化模式：处于 bus-off 时开始（或重新开始）监测 129 次 11 个连续隐性位
+    if ((old & FDCAN_CCCR_INIT) != 0 && (value & FDCAN_CCCR_INIT) == 0 && bus_off_)
+    {
+        recovery_sequences_ = RECOVERY_SEQUENCES;
+        recovery_mark_ns_   = now_ns();
+    }
+}
+
+uint32_t FdCan::pending_buffers() const
+{
+    uint32_t pending = 0;
+    for (size_t k = 0; k < TX_BUFFERS; ++k)
+        if (buffers_[k].state != BufferState::Empty)
+            pending |= 1U << k;
+    return pending;
+}
+
+uint32_t FdCan::read_txfqs() const
+{
+    const bool queue = (regs_.TXBC.raw() & FDCAN_TXBC_TFQM) != 0;
+
+    uint32_t free = 0;
+    int      get  = -1;
+    for (size_t k = 0; k < TX_BUFFERS; ++k)
+    {
+        if (buffers_[k].state == BufferState::Empty)
+            ++free;
+        else if (get < 0 || buffers_[k].sequence < buffers_[static_cast<size_t>(get)].sequence)
+            get = static_cast<int>(k);
+    }
+
+    // Queue 模式放入编号最小的空 Buffer；FIFO 模式按环形顺序放入
+    uint32_t put = put_index_;
+    if (queue)
+    {
+        put = 0;
+        while (put < TX_BUFFERS && buffers_[put].state != BufferState::Empty)
+            ++put;
+    }
+    const bool full = put >= TX_BUFFERS || buffers_[put].state != BufferState::Empty;
+
+    uint32_t value = (full ? 0U : put) << FDCAN_TXFQS_TFQPI_Pos;
+    if (full)
+        value |= FDCAN_TXFQS_TFQF;
+    // Queue 模式下 TFFL 与 TFGI 读为 0
+    if (!queue)
+        value |= free << FDCAN_TXFQS_TFFL_Pos | static_cast<uint32_t>(std::max(get, 0)) << FDCAN_TXFQS_TFGI_Pos;
+    return value;
+}
+
+uint32_t FdCan::read_rxfs(const uint32_t fifo) const
+{
+    const uint32_t count = fifo_count_[fifo];
+    uint32_t       value = count << FDCAN_RXF0S_F0FL_Pos | fifo_get_[fifo] << FDCAN_RXF0S_F0GI_Pos |
+                     ((fifo_get_[fifo] + count) % FIFO_ELEMENTS) << FDCAN_RXF0S_F0PI_Pos;
+    if (count == FIFO_ELEMENTS)
+        value |= FDCAN_RXF0S_F0F;
+    if ((regs_.IR.raw() & (fifo == 0 ? FDCAN_IR_RF0L : FDCAN_IR_RF1L)) != 0)
+        value |= FDCAN_RXF0S_RF0L;
+    return value;
+}
+
+void FdCan::acknowledge_fifo(const uint32_t fifo, const uint32_t index)
+{
+    // 确认一个元素会释放从 get index 到它为止的所有元素
+    const uint32_t released = (index + FIFO_ELEMENTS - fifo_get_[fifo]) % FIFO_ELEMENTS + 1;
+    if (index >= FIFO_ELEMENTS || released > fifo_count_[fifo])
+        return;
+    fifo_count_[fifo] -= released;
+    fifo_get_[fifo] = (index + 1) % FIFO_ELEMENTS;
+}
+
+void FdCan::request_buffers(const uint32_t buffers)
+{
+    for (size_t k = 0; k < TX_BUFFERS; ++k)
+    {
+        const uint32_t bit = 1U << k;
+        if ((buffers & bit) == 0 || buffers_[k].state != BufferState::Empty)
+            continue;
+        buffers_[k] = { BufferState::Pending, false, next_sequence_++ };
+        // 重新请求发送时清除上一帧的发送完成 / 取消完成标志
+        regs_.TXBTO.set_raw(regs_.TXBTO.raw() & ~bit);
+        regs_.TXBCF.set_raw(regs_.TXBCF.raw() & ~bit);
+        if (static_cast<uint32_t>(k) == put_index_)
+            put_index_ = (put_index_ + 1) % TX_BUFFERS;
+    }
+}
+
+void FdCan::cancel_buffers(const uint32_t buffers)
+{
+    for (size_t k = 0; k < TX_BUFFERS; ++k)
+    {
+        if ((buffers & (1U << k)) == 0)
+            continue;
+        switch (buffers_[k].state)
+        {
+        case BufferState::Empty:
+        case BufferState::Pending:
+            // 没有待发送的帧时同样立即置位 TXBCF
+            finish_buffer(k, false, true);
+            break;
+        case BufferState::Transmitting:
+            buffers_[k].cancel = true; // 等待正在进行的发送结束
+            break;
+        }
+    }
+}
+
+/*
+ * 发送
+ */
+
+int FdCan::select_buffer() const
+{
+    const bool queue = (regs_.TXBC.raw() & FDCAN_TXBC_TFQM) != 0;
+    int        best  = -1;
+    uint64_t   best_key{};
+    for (size_t k = 0; k < TX_BUFFERS; ++k)
+    {
+        if (buffers_[k].state != BufferState::Pending)
+            continue;
+        // Queue 模式按 ID 仲裁优先级，相同时编号小的 Buffer 优先；FIFO 模式按请求顺序
+        const uint64_t key = queue ? arbitration_key(buffer_frame(k)) : buffers_[k].sequence;
+        if (best < 0 || key < best_key)
+        {
+            best     = static_cast<int>(k);
+            best_key = key;
+        }
+    }
+    return best;
+}
+
+Frame FdCan::buffer_frame(const size_t index) const
+{
+    const FDCAN_SimElement& element = ram_.tx_buffer[index];
+    const uint32_t          w1 = element.header[0], w2 = element.header[1];
+    const uint32_t          cccr = regs_.CCCR.raw();
+
+    Frame frame;
+    frame.ext = (w1 & FDCAN_ELEMENT_MASK_XTD) != 0;
+    frame.id  = frame.ext ? w1 & FDCAN_ELEMENT_MASK_EXTID : (w1 & FDCAN_ELEMENT_MASK_STDID) >> 18;
+    // 经典 CAN 模式下 FDF / BRS 被忽略，按经典帧发送
+    frame.fd  = (cccr & FDCAN_CCCR_FDOE) != 0 && (w2 & FDCAN_ELEMENT_MASK_FDF) != 0;
+    frame.brs = frame.fd && (cccr & FDCAN_CCCR_BRSE) != 0 && (w2 & FDCAN_ELEMENT_MASK_BRS) != 0;
+    frame.rtr = !frame.fd && (w1 & FDCAN_ELEMENT_MASK_RTR) != 0;
+    frame.dlc = static_cast<uint8_t>((w2 & FDCAN_ELEMENT_MASK_DLC) >> 16);
+    const uint8_t len = frame_length(frame);
+    for (size_t i = 0; i < len; ++i)
+        frame.data[i] = static_cast<uint8_t>(element.data[i / 4] >> (8 * (i % 4)));
+    return frame;
+}
+
+bool FdCan::tx_pending(Frame* frame)
+{
+    // 总线监视模式不能发起发送
+    if (!participating() || monitoring() || transmitting_ >= 0)
+        return false;
+    candidate_ = select_buffer();
+    if (candidate_ < 0)
+        return false;
+    *frame = buffer_frame(static_cast<size_t>(candidate_));
+    return true;
+}
+
+bool FdCan::tx_begin()
+{
+    transmitting_                     = candidate_;
+    buffers_[transmitting_].state = BufferState::Transmitting;
+    if (injected_tx_errors_ > 0)
+    {
+        --injected_tx_errors_;
+        return true;
+    }
+    return false;
+}
+
+void FdCan::tx_lost()
+{
+    // DAR 时仲裁失败不重发，按取消结束
+    if (candidate_ >= 0 && (regs_.CCCR.raw() & FDCAN_CCCR_DAR) != 0)
+        finish_buffer(static_cast<size_t>(candidate_), false, true);
+}
+
+void FdCan::tx_end(const Transfer::Result result)
+{
+    if (transmitting_ < 0)
+        return;
+    const auto index = static_cast<size_t>(transmitting_);
+    transmitting_    = -1;
+
+    if (result == Transfer::Result::Ok)
+    {
+        if (tec_ > 0)
+            --tec_;
+        set_lec(FDCAN_PROTOCOL_ERROR_NONE);
+        // 环回模式接收自己发送的帧
+        if (loopback())
+            receive(buffer_frame(index), now_ns());
+        // 发送期间收到的取消请求：帧已发出，TXBTO 与 TXBCF 同时置位
+        finish_buffer(index, true, buffers_[index].cancel);
+        update_error_flags();
+        return;
+    }
+
+    // error passive 的发送方 ACK 错误不增加 TEC
+    if (result == Transfer::Result::BitError || !error_passive())
+        add_tec(8);
+    set_lec(result == Transfer::Result::AckError ? FDCAN_PROTOCOL_ERROR_ACK : FDCAN_PROTOCOL_ERROR_BIT0);
+
+    if (buffers_[index].cancel || (!bus_off_ && (regs_.CCCR.raw() & FDCAN_CCCR_DAR) != 0))
+        finish_buffer(index, false, true);
+    else
+        buffers_[index].state = BufferState::Pending; // 自动重发；bus-off 时保留到恢复后
+    update_error_flags();
+}
+
+void FdCan::finish_buffer(const size_t index, const bool sent, const bool cancelled)
+{
+    const uint32_t bit = 1U << index;
+    buffers_[index]    = {};
+    if (sent)
+    {
+        regs_.TXBTO.set_raw(regs_.TXBTO.raw() | bit);
+        if ((regs_.TXBTIE.raw() & bit) != 0)
+            set_ir(FDCAN_IR_TC);
+    }
+    if (cancelled)
+    {
+        regs_.TXBCF.set_raw(regs_.TXBCF.raw() | bit);
+        if ((regs_.TXBCIE.raw() & bit) != 0)
+            set_ir(FDCAN_IR_TCF);
+    }
+    if (pending_buffers() == 0)
+        set_ir(FDCAN_IR_TFE);
+}
+
+bool FdCan::acknowledges() const
+{
+    return participating() && !monitoring() && !loopback();
+}
+
+bool FdCan::self_acknowledges() const
+{
+    return loopback();
+}
+
+bool FdCan::synchronized() const
+{
+    // 允许 0.5 % 的波特率误差；开启 BRS 时数据段波特率也要一致
+    auto close = [](const uint64_t own, const uint64_t bus_rate) {
+        const uint64_t diff = own > bus_rate ? own - bus_rate : bus_rate - own;
+        return diff * 200 <= bus_rate;
+    };
+    if (!close(nominal_bitrate(), bus().bitrate()))
+        return false;
+    const uint32_t fd_brs = FDCAN_CCCR_FDOE | FDCAN_CCCR_BRSE;
+    return (regs_.CCCR.raw() & fd_brs) != fd_brs || close(data_bitrate(), bus().data_bitrate());
+}
+
+/*
+ * 接收
+ */
+
+void FdCan::rx(const Frame& frame, const uint64_t sof_ns)
+{
+    // 环回模式下接收端与总线断开；经典 CAN 模式收到 CAN FD 帧是协议异常，这里简化为不接收
+    if (!participating() || loopback() || (frame.fd && (regs_.CCCR.raw() & FDCAN_CCCR_FDOE) == 0))
+        return;
+    if (rec_ > 127)
+        rec_ = 120;
+    else if (rec_ > 0)
+        --rec_;
+    set_lec(FDCAN_PROTOCOL_ERROR_NONE);
+    update_error_flags();
+    receive(frame, sof_ns);
+}
+
+void FdCan::rx_error()
+{
+    if (!participating() || loopback())
+        return;
+    if (rec_ < 255)
+        ++rec_;
+    set_lec(FDCAN_PROTOCOL_ERROR_BIT0);
+    update_error_flags();
+}
+
+void FdCan::receive(const Frame& frame, const uint64_t sof_ns)
+{
+    const uint32_t rxgfc = regs_.RXGFC.raw();
+    if (frame.rtr && (rxgfc & (frame.ext ? FDCAN_RXGFC_RRFE : FDCAN_RXGFC_RRFS)) != 0)
+        return;
+
+    // 按顺序匹配过滤器元素，第一个匹配的元素决定去向；都不匹配时按 RXGFC 的全局过滤处理
+    uint32_t       fifo  = frame.ext ? (rxgfc & FDCAN_RXGFC_ANFE) >> FDCAN_RXGFC_ANFE_Pos
+                                     : (rxgfc & FDCAN_RXGFC_ANFS) >> FDCAN_RXGFC_ANFS_Pos;
+    uint32_t       match = FDCAN_ELEMENT_MASK_ANMF;
+    const uint32_t size  = frame.ext ? (rxgfc & FDCAN_RXGFC_LSE) >> FDCAN_RXGFC_LSE_Pos
+                                     : (rxgfc & FDCAN_RXGFC_LSS) >> FDCAN_RXGFC_LSS_Pos;
+    const uint32_t filters = std::min<uint32_t>(size, frame.ext ? FDCAN_SIM_EXT_FILTERS : FDCAN_SIM_STD_FILTERS);
+    for (uint32_t i = 0; i < filters; ++i)
+    {
+        uint32_t type, config, id1, id2;
+        uint32_t id = frame.id;
+        if (frame.ext)
+        {
+            const uint32_t f0 = ram_.ext_filter[i][0];
+            const uint32_t f1 = ram_.ext_filter[i][1];
+            type              = f1 >> 30;
+            config            = f0 >> 29;
+            id1               = f0 & FDCAN_ELEMENT_MASK_EXTID;
+            id2               = f1 & FDCAN_ELEMENT_MASK_EXTID;
+            // 除 RANGE_NO_EIDM 外，扩展 ID 先与 XIDAM 相与再匹配
+            if (type != FDCAN_FILTER_RANGE_NO_EIDM)
+                id &= regs_.XIDAM.raw();
+        }
+        else
+        {
+            const uint32_t f0 = ram_.std_filter[i];
+            type              = f0 >> 30;
+            config            = (f0 >> 27) & 0x7U;
+            id1               = (f0 >> 16) & 0x7FFU;
+            id2               = f0 & 0x7FFU;
+            // 标准 ID 过滤器的 SFT = 11 表示元素禁用
+            if (type == FDCAN_FILTER_RANGE_NO_EIDM)
+                continue;
+        }
+        if (config == FDCAN_FILTER_DISABLE || !filter_matches(type, id, id1, id2))
+            continue;
+        if (config == FDCAN_FILTER_REJECT || config == FDCAN_FILTER_HP)
+            return;
+        fifo  = config == FDCAN_FILTER_TO_RXFIFO1 || config == FDCAN_FILTER_TO_RXFIFO1_HP ? 1 : 0;
+        match = i << 24;
+        break;
+    }
+    if (fifo > 1)
+        return;
+
+    FDCAN_SimElement element{};
+    element.header[0] = frame.ext ? (frame.id & FDCAN_ELEMENT_MASK_EXTID) | FDCAN_ELEMENT_MASK_XTD
+                                  : (frame.id & 0x7FFU) << 18;
+    if (frame.rtr)
+        element.header[0] |= FDCAN_ELEMENT_MASK_RTR;
+    // RXTS 为 SOF 时刻的 16 位位时间计数
+    const uint32_t time = static_cast<uint32_t>(sof_ns * bus().bitrate() / 1000000000ULL) & 0xFFFF;
+    element.header[1]   = time | static_cast<uint32_t>(frame.dlc & 0xF) << 16 | match;
+    if (frame.fd)
+        element.header[1] |= FDCAN_ELEMENT_MASK_FDF;
+    if (frame.brs)
+        element.header[1] |= FDCAN_ELEMENT_MASK_BRS;
+    const uint8_t len = frame_length(frame);
+    for (size_t i = 0; i < len; ++i)
+        element.data[i / 4] |= static_cast<uint32_t>(frame.data[i]) << (8 * (i % 4));
+
+    const uint32_t new_flag  = fifo == 0 ? FDCAN_IR_RF0N : FDCAN_IR_RF1N;
+    const uint32_t full_flag = fifo == 0 ? FDCAN_IR_RF0F : FDCAN_IR_RF1F;
+    const uint32_t lost_flag = fifo == 0 ? FDCAN_IR_RF0L : FDCAN_IR_RF1L;
+    if (fifo_count_[fifo] == FIFO_ELEMENTS)
+    {
+        // FIFO 已满：阻塞模式丢弃新帧，覆盖模式新帧覆盖最早的一帧
+        ++overruns_[fifo];
+        if ((rxgfc & (fifo == 0 ? FDCAN_RXGFC_F0OM : FDCAN_RXGFC_F1OM)) == 0)
+        {
+            set_ir(lost_flag);
+            return;
+        }
+        ram_.rx_fifo[fifo][fifo_get_[fifo]] = element;
+        fifo_get_[fifo]                     = (fifo_get_[fifo] + 1) % FIFO_ELEMENTS;
+        set_ir(new_flag);
+        return;
+    }
+    ram_.rx_fifo[fifo][(fifo_get_[fifo] + fifo_count_[fifo]) % FIFO_ELEMENTS] = element;
+    ++fifo_count_[fifo];
+    set_ir(new_flag);
+    if (fifo_count_[fifo] == FIFO_ELEMENTS)
+        set_ir(full_flag);
+}
+
+void FdCan::set_ir(const uint32_t flags)
+{
+    regs_.IR.set_raw(regs_.IR.raw() | flags);
+}
+
+/*
+ * 错误处理
+ */
+
+void FdCan::add_tec(const uint32_t amount)
+{
+    if (bus_off_)
+        return;
+    tec_ += amount;
+    if (tec_ > 255)
+        enter_bus_off();
+}
+
+void FdCan::set_lec(const uint32_t lec)
+{
+    lec_ = lec;
+}
+
+void FdCan::update_error_flags()
+{
+    uint32_t flags = 0;
+    if (tec_ >= 96 || rec_ >= 96)
+        flags |= FDCAN_PSR_EW;
+    if (tec_ >= 128 || rec_ >= 128)
+        flags |= FDCAN_PSR_EP;
+    if (bus_off_)
+        flags |= FDCAN_PSR_BO;
+
+    // EW / EP / BO 在状态变化（置位或清除）时产生中断
+    const uint32_t changed = (flags ^ psr_flags_) & PSR_STATUS;
+    psr_flags_             = flags;
+    if ((changed & FDCAN_PSR_EW) != 0)
+        set_ir(FDCAN_IR_EW);
+    if ((changed & FDCAN_PSR_EP) != 0)
+        set_ir(FDCAN_IR_EP);
+    if ((changed & FDCAN_PSR_BO) != 0)
+        set_ir(FDCAN_IR_BO);
+}
+
+void FdCan::enter_bus_off()
+{
+    bus_off_            = true;
+    tec_                = 256;
+    recovery_sequences_ = 0;
+    // 硬件置位 INIT，停止一切总线活动，需软件清除 INIT 后才开始恢复
+    regs_.CCCR.set_raw(regs_.CCCR.raw() | FDCAN_CCCR_INIT);
+    update_error_flags();
+}
+
+void FdCan::leave_bus_off()
+{
+    bus_off_            = false;
+    tec_                = 0;
+    rec_                = 0;
+    recovery_sequences_ = 0;
+    update_error_flags();
+}
+
+void FdCan::on_transfer(const Transfer& transfer)
+{
+    // 进入 bus-off 的那一帧不计入
+    if (recovery_sequences_ == 0 || (regs_.CCCR.raw() & FDCAN_CCCR_INIT) != 0 ||
+        transfer.end_ns <= recovery_mark_ns_)
+        return;
+    // 帧前的空闲时间，加上帧尾的 ACK 界定符、EOF 与帧间隔（或错误界定符与帧间隔）构成的 11 个隐性位
+    const uint64_t idle = transfer.sof_ns > recovery_mark_ns_ ? transfer.sof_ns - recovery_mark_ns_ : 0;
+    const uint64_t seen = idle / bus().bits_ns(11) + 1;
+    recovery_mark_ns_   = transfer.end_ns;
+    if (seen >= recovery_sequences_)
+        leave_bus_off();
+    else
+        recovery_sequences_ -= static_cast<uint32_t>(seen);
+}
+
+uint64_t FdCan::next_event_ns() const
+{
+    if (recovery_sequences_ == 0 || bus().transferring() || (regs_.CCCR.raw() & FDCAN_CCCR_INIT) != 0)
+        return NEVER;
+    return recovery_mark_ns_ + bus().bits_ns(11ULL * recovery_sequences_);
+}
+
+void FdCan::on_time()
+{
+    const uint64_t deadline = next_event_ns();
+    if (deadline != NEVER && now_ns() >= deadline)
+        leave_bus_off();
+}
+
+/*
+ * 中断
+ */
+
+IRQn_Type FdCan::pending_irq() const
+{
+    const uint32_t active = regs_.IR.raw() & regs_.IE.raw();
+    const uint32_t line1  = group_flags(regs_.ILS.raw());
+    const uint32_t ile    = regs_.ILE.raw();
+
+    IRQn_Type irqs[2];
+    size_t    count = 0;
+    if ((ile & FDCAN_ILE_EINT0) != 0 && (active & ~line1) != 0)
+        irqs[count++] = FDCAN1_IT0_IRQn;
+    if ((ile & FDCAN_ILE_EINT1) != 0 && (active & line1) != 0)
+        irqs[count++] = FDCAN1_IT1_IRQn;
+
+    // 优先级数值小的先响应，相同时中断号小的先响应
+    IRQn_Type best = SIM_IRQ_NUM;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint32_t priority = NVIC_GetPriority(irqs[i]);
+        if (detail::irq_masked(priority))
+            continue;
+        if (best == SIM_IRQ_NUM || priority < NVIC_GetPriority(best))
+            best = irqs[i];
+    }
+    return best;
+}
+
+void FdCan::set_irq_handler(const IRQn_Type irqn, std::function<void()> handler)
+{
+    irq_handlers_[irqn - FDCAN1_IT0_IRQn] = std::move(handler);
+}
+
+void FdCan::service_interrupts()
+{
+    if (in_interrupt() || hfdcan_.State == HAL_FDCAN_STATE_RESET)
+        return;
+    for (uint32_t round = 0;; ++round)
+    {
+        const IRQn_Type irqn = pending_irq();
+        if (irqn == SIM_IRQ_NUM)
+            return;
+        if (round == 100000)
+        {
+            std::fprintf(stderr, "can_sim: interrupt storm on IRQ %d (flag never cleared)\n", irqn);
+            std::abort();
+        }
+        const uint64_t               start   = detail::host_ns();
+        const std::function<void()>& handler = irq_handlers_[irqn - FDCAN1_IT0_IRQn];
+        {
+            detail::InterruptScope scope(irqn);
+            if (handler)
+                handler();
+            else
+                HAL_FDCAN_IRQHandler(&hfdcan_);
+        }
+        isr_stats_.add(detail::host_ns() - start);
+    }
+}
+
+} // namespace can_sim
+
+/*
+ * HAL
+ */
+
+using can_sim::FdCan;
+
+namespace
+{
+
+bool wait_cccr(FDCAN_HandleTypeDef* hfdcan, const uint32_t flag, const bool set)
+{
+    // 仿真中模式切换立即完成，保留 HAL 的等待结构
+    const uint32_t tickstart = HAL_GetTick();
+    while (((hfdcan->Instance->CCCR & flag) != 0) != set)
+    {
+        if (HAL_GetTick() - tickstart > 10U)
+            return false;
+        HAL_Delay(1);
+    }
+    return true;
+}
+
+bool ready_or_busy(const FDCAN_HandleTypeDef* hfdcan)
+{
+    return hfdcan->State == HAL_FDCAN_STATE_READY || hfdcan->State == HAL_FDCAN_STATE_BUSY;
+}
+
+template <typename Callback>
+HAL_StatusTypeDef register_callback(FDCAN_HandleTypeDef* hfdcan, Callback& slot, const Callback callback)
+{
+    if (callback == nullptr || hfdcan->State != HAL_FDCAN_STATE_READY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_INVALID_CALLBACK;
+        return HAL_ERROR;
+    }
+    slot = callback;
+    return HAL_OK;
+}
+
+} // namespace
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef* hfdcan)
+{
+    if (hfdcan == nullptr)
+        return HAL_ERROR;
+
+    if (hfdcan->State == HAL_FDCAN_STATE_RESET)
+    {
+        hfdcan->RxFifo0Callback          = can_sim::no_callback;
+        hfdcan->RxFifo1Callback          = can_sim::no_callback;
+        hfdcan->TxBufferCompleteCallback = can_sim::no_callback;
+        hfdcan->TxBufferAbortCallback    = can_sim::no_callback;
+        hfdcan->ErrorStatusCallback      = can_sim::no_callback;
+    }
+
+    FDCAN_GlobalTypeDef* can = hfdcan->Instance;
+    can->CCCR &= ~FDCAN_CCCR_CSR;
+    if (!wait_cccr(hfdcan, FDCAN_CCCR_CSA, false))
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_TIMEOUT;
+        hfdcan->State = HAL_FDCAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+    can->CCCR |= FDCAN_CCCR_INIT;
+    if (!wait_cccr(hfdcan, FDCAN_CCCR_INIT, true))
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_TIMEOUT;
+        hfdcan->State = HAL_FDCAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+    can->CCCR |= FDCAN_CCCR_CCE;
+
+    auto set_bit = [can](const uint32_t bit, const bool on) {
+        if (on)
+            can->CCCR |= bit;
+        else
+            can->CCCR &= ~bit;
+    };
+    set_bit(FDCAN_CCCR_DAR, hfdcan->Init.AutoRetransmission != ENABLE);
+    set_bit(FDCAN_CCCR_TXP, hfdcan->Init.TransmitPause == ENABLE);
+    set_bit(FDCAN_CCCR_PXHD, hfdcan->Init.ProtocolException != ENABLE);
+    can->CCCR &= ~(FDCAN_CCCR_FDOE | FDCAN_CCCR_BRSE);
+    can->CCCR |= hfdcan->Init.FrameFormat;
+
+    can->CCCR &= ~(FDCAN_CCCR_ASM | FDCAN_CCCR_TEST | FDCAN_CCCR_MON);
+    can->TEST &= ~FDCAN_TEST_LBCK;
+    if (hfdcan->Init.Mode == FDCAN_MODE_RESTRICTED_OPERATION)
+    {
+        can->CCCR |= FDCAN_CCCR_ASM;
+    }
+    else if (hfdcan->Init.Mode != FDCAN_MODE_NORMAL)
+    {
+        if (hfdcan->Init.Mode != FDCAN_MODE_BUS_MONITORING)
+        {
+            can->CCCR |= FDCAN_CCCR_TEST;
+            can->TEST |= FDCAN_TEST_LBCK;
+            if (hfdcan->Init.Mode == FDCAN_MODE_INTERNAL_LOOPBACK)
+                can->CCCR |= FDCAN_CCCR_MON;
+        }
+        else
+        {
+            can->CCCR |= FDCAN_CCCR_MON;
+        }
+    }
+
+    can->NBTP = (hfdcan->Init.NominalSyncJumpWidth - 1U) << FDCAN_NBTP_NSJW_Pos |
+                (hfdcan->Init.NominalTimeSeg1 - 1U) << FDCAN_NBTP_NTSEG1_Pos |
+                (hfdcan->Init.NominalTimeSeg2 - 1U) << FDCAN_NBTP_NTSEG2_Pos |
+                (hfdcan->Init.NominalPrescaler - 1U) << FDCAN_NBTP_NBRP_Pos;
+    if (hfdcan->Init.FrameFormat == FDCAN_FRAME_FD_BRS)
+        can->DBTP = (hfdcan->Init.DataTimeSeg1 - 1U) << FDCAN_DBTP_DTSEG1_Pos |
+                    (hfdcan->Init.DataTimeSeg2 - 1U) << FDCAN_DBTP_DTSEG2_Pos |
+                    (hfdcan->Init.DataSyncJumpWidth - 1U) << FDCAN_DBTP_DSJW_Pos |
+                    (hfdcan->Init.DataPrescaler - 1U) << FDCAN_DBTP_DBRP_Pos;
+
+    // 与 HAL 一样只置位 TFQM，不会从 Queue 模式切回 FIFO 模式
+    can->TXBC |= hfdcan->Init.TxFifoQueueMode;
+
+    // G4 的消息 RAM 布局固定，HAL 在此写入过滤器列表的长度并清零整个消息 RAM
+    can->RXGFC &= ~(FDCAN_RXGFC_LSS | FDCAN_RXGFC_LSE);
+    can->RXGFC |= hfdcan->Init.StdFiltersNbr << FDCAN_RXGFC_LSS_Pos | hfdcan->Init.ExtFiltersNbr << FDCAN_RXGFC_LSE_Pos;
+    if (FdCan* sim = FdCan::from(hfdcan); sim != nullptr)
+        sim->message_ram() = {};
+
+    hfdcan->LatestTxFifoQRequest = 0;
+    hfdcan->ErrorCode            = HAL_FDCAN_ERROR_NONE;
+    hfdcan->State                = HAL_FDCAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_DeInit(FDCAN_HandleTypeDef* hfdcan)
+{
+    if (hfdcan == nullptr)
+        return HAL_ERROR;
+    (void) HAL_FDCAN_Stop(hfdcan);
+    hfdcan->Instance->IE  = 0;
+    hfdcan->Instance->ILE = 0;
+    hfdcan->ErrorCode     = HAL_FDCAN_ERROR_NONE;
+    hfdcan->State         = HAL_FDCAN_STATE_RESET;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef* hfdcan, const FDCAN_FilterTypeDef* sFilterConfig)
+{
+    if (hfdcan->State != HAL_FDCAN_STATE_READY && hfdcan->State != HAL_FDCAN_STATE_BUSY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    FdCan::MessageRam& ram = FdCan::from(hfdcan)->message_ram();
+    if (sFilterConfig->IdType == FDCAN_STANDARD_ID)
+    {
+        if (sFilterConfig->FilterIndex >= FDCAN_SIM_STD_FILTERS)
+        {
+            hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+            return HAL_ERROR;
+        }
+        ram.std_filter[sFilterConfig->FilterIndex] = sFilterConfig->FilterType << 30U |
+                                                     sFilterConfig->FilterConfig << 27U |
+                                                     sFilterConfig->FilterID1 << 16U | sFilterConfig->FilterID2;
+    }
+    else
+    {
+        if (sFilterConfig->FilterIndex >= FDCAN_SIM_EXT_FILTERS)
+        {
+            hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+            return HAL_ERROR;
+        }
+        ram.ext_filter[sFilterConfig->FilterIndex][0] = sFilterConfig->FilterConfig << 29U | sFilterConfig->FilterID1;
+        ram.ext_filter[sFilterConfig->FilterIndex][1] = sFilterConfig->FilterType << 30U | sFilterConfig->FilterID2;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef* hfdcan,
+                                               const uint32_t       NonMatchingStd,
+                                               const uint32_t       NonMatchingExt,
+                                               const uint32_t       RejectRemoteStd,
+                                               const uint32_t       RejectRemoteExt)
+{
+    if (hfdcan->State != HAL_FDCAN_STATE_READY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    const uint32_t mask = FDCAN_RXGFC_ANFS | FDCAN_RXGFC_ANFE | FDCAN_RXGFC_RRFS | FDCAN_RXGFC_RRFE;
+    hfdcan->Instance->RXGFC &= ~mask;
+    hfdcan->Instance->RXGFC |= NonMatchingStd << FDCAN_RXGFC_ANFS_Pos | NonMatchingExt << FDCAN_RXGFC_ANFE_Pos |
+                               RejectRemoteStd << 1U | RejectRemoteExt;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigRxFifoOverwrite(FDCAN_HandleTypeDef* hfdcan,
+                                                  const uint32_t       RxFifo,
+                                                  const uint32_t       OperationMode)
+{
+    if (hfdcan->State != HAL_FDCAN_STATE_READY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    const uint32_t bit = RxFifo == FDCAN_RX_FIFO0 ? FDCAN_RXGFC_F0OM : FDCAN_RXGFC_F1OM;
+    if (OperationMode == FDCAN_RX_FIFO_OVERWRITE)
+        hfdcan->Instance->RXGFC |= bit;
+    else
+        hfdcan->Instance->RXGFC &= ~bit;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef* hfdcan)
+{
+    if (hfdcan->State != HAL_FDCAN_STATE_READY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_READY;
+        return HAL_ERROR;
+    }
+    hfdcan->State = HAL_FDCAN_STATE_BUSY;
+    hfdcan->Instance->CCCR &= ~FDCAN_CCCR_INIT;
+    hfdcan->ErrorCode = HAL_FDCAN_ERROR_NONE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef* hfdcan)
+{
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    hfdcan->Instance->CCCR |= FDCAN_CCCR_INIT;
+    if (!wait_cccr(hfdcan, FDCAN_CCCR_INIT, true))
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_TIMEOUT;
+        hfdcan->State = HAL_FDCAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+    hfdcan->Instance->CCCR &= ~FDCAN_CCCR_CSR;
+    if (!wait_cccr(hfdcan, FDCAN_CCCR_CSA, false))
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_TIMEOUT;
+        hfdcan->State = HAL_FDCAN_STATE_ERROR;
+        return HAL_ERROR;
+    }
+    hfdcan->Instance->CCCR |= FDCAN_CCCR_CCE;
+    hfdcan->LatestTxFifoQRequest = 0;
+    hfdcan->State                = HAL_FDCAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef*         hfdcan,
+                                                const FDCAN_TxHeaderTypeDef* pTxHeader,
+                                                const uint8_t*               pTxData)
+{
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    if ((hfdcan->Instance->TXFQS & FDCAN_TXFQS_TFQF) != 0U)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_FULL;
+        return HAL_ERROR;
+    }
+
+    const uint32_t put = (hfdcan->Instance->TXFQS & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+
+    // FDCAN_CopyMessageToRAM
+    FDCAN_SimElement& element = FdCan::from(hfdcan)->message_ram().tx_buffer[put];
+    if (pTxHeader->IdType == FDCAN_STANDARD_ID)
+        element.header[0] = pTxHeader->ErrorStateIndicator | FDCAN_STANDARD_ID | pTxHeader->TxFrameType |
+                            pTxHeader->Identifier << 18U;
+    else
+        element.header[0] = pTxHeader->ErrorStateIndicator | FDCAN_EXTENDED_ID | pTxHeader->TxFrameType |
+                            pTxHeader->Identifier;
+    element.header[1] = pTxHeader->MessageMarker << 24U | pTxHeader->TxEventFifoControl | pTxHeader->FDFormat |
+                        pTxHeader->BitRateSwitch | pTxHeader->DataLength << 16U;
+    // HAL 按字写入，可能读到数据长度之后的字节；这里只复制有效字节，消息 RAM 中的结果相同
+    const uint8_t len = can_sim::DLC_LENGTH[pTxHeader->DataLength & 0xFU];
+    for (size_t i = 0; i < 16; ++i)
+        element.data[i] = 0;
+    for (size_t i = 0; i < len; ++i)
+        element.data[i / 4] |= static_cast<uint32_t>(pTxData[i]) << (8 * (i % 4));
+
+    hfdcan->Instance->TXBAR      = 1U << put;
+    hfdcan->LatestTxFifoQRequest = 1U << put;
+    return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetLatestTxFifoQRequestBuffer(const FDCAN_HandleTypeDef* hfdcan)
+{
+    return hfdcan->LatestTxFifoQRequest;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_AbortTxRequest(FDCAN_HandleTypeDef* hfdcan, const uint32_t BufferIndex)
+{
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    hfdcan->Instance->TXBCR = BufferIndex;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef*   hfdcan,
+                                         const uint32_t         RxLocation,
+                                         FDCAN_RxHeaderTypeDef* pRxHeader,
+                                         uint8_t*               pRxData)
+{
+    if (hfdcan->State != HAL_FDCAN_STATE_BUSY)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_STARTED;
+        return HAL_ERROR;
+    }
+    if (RxLocation != FDCAN_RX_FIFO0 && RxLocation != FDCAN_RX_FIFO1)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_PARAM;
+        return HAL_ERROR;
+    }
+
+    const uint32_t fifo   = RxLocation == FDCAN_RX_FIFO0 ? 0 : 1;
+    const uint32_t status = fifo == 0 ? hfdcan->Instance->RXF0S : hfdcan->Instance->RXF1S;
+    if ((status & FDCAN_RXF0S_F0FL) == 0U)
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_FIFO_EMPTY;
+        return HAL_ERROR;
+    }
+
+    // 与 HAL 一样：FIFO 已满且为覆盖模式时跳过最早的一帧，它可能正在被覆盖
+    uint32_t       index = 0;
+    const uint32_t om    = fifo == 0 ? FDCAN_RXGFC_F0OM : FDCAN_RXGFC_F1OM;
+    if ((status & FDCAN_RXF0S_F0F) != 0U && (hfdcan->Instance->RXGFC & om) != 0U)
+        index = 1;
+    index = (index + ((status & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos)) % FDCAN_SIM_RX_FIFO_ELEMENTS;
+
+    const FDCAN_SimElement& element = FdCan::from(hfdcan)->message_ram().rx_fifo[fifo][index];
+    pRxHeader->IdType               = element.header[0] & FDCAN_ELEMENT_MASK_XTD;
+    if (pRxHeader->IdType == FDCAN_STANDARD_ID)
+        pRxHeader->Identifier = (element.header[0] & FDCAN_ELEMENT_MASK_STDID) >> 18U;
+    else
+        pRxHeader->Identifier = element.header[0] & FDCAN_ELEMENT_MASK_EXTID;
+    pRxHeader->RxFrameType           = element.header[0] & FDCAN_ELEMENT_MASK_RTR;
+    pRxHeader->ErrorStateIndicator   = element.header[0] & FDCAN_ELEMENT_MASK_ESI;
+    pRxHeader->RxTimestamp           = element.header[1] & FDCAN_ELEMENT_MASK_TS;
+    pRxHeader->DataLength            = (element.header[1] & FDCAN_ELEMENT_MASK_DLC) >> 16U;
+    pRxHeader->BitRateSwitch         = element.header[1] & FDCAN_ELEMENT_MASK_BRS;
+    pRxHeader->FDFormat              = element.header[1] & FDCAN_ELEMENT_MASK_FDF;
+    pRxHeader->FilterIndex           = (element.header[1] & FDCAN_ELEMENT_MASK_FIDX) >> 24U;
+    pRxHeader->IsFilterMatchingFrame = (element.header[1] & FDCAN_ELEMENT_MASK_ANMF) >> 31U;
+
+    const uint8_t len = can_sim::DLC_LENGTH[pRxHeader->DataLength & 0xFU];
+    for (size_t i = 0; i < len; ++i)
+        pRxData[i] = static_cast<uint8_t>(element.data[i / 4] >> (8 * (i % 4)));
+
+    if (fifo == 0)
+        hfdcan->Instance->RXF0A = index;
+    else
+        hfdcan->Instance->RXF1A = index;
+    return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(const FDCAN_HandleTypeDef* hfdcan, const uint32_t RxFifo)
+{
+    return (RxFifo == FDCAN_RX_FIFO0 ? hfdcan->Instance->RXF0S : hfdcan->Instance->RXF1S) & FDCAN_RXF0S_F0FL;
+}
+
+uint32_t HAL_FDCAN_GetTxFifoFreeLevel(const FDCAN_HandleTypeDef* hfdcan)
+{
+    return hfdcan->Instance->TXFQS & FDCAN_TXFQS_TFFL;
+}
+
+uint32_t HAL_FDCAN_IsTxBufferMessagePending(const FDCAN_HandleTypeDef* hfdcan, const uint32_t TxBufferIndex)
+{
+    return (hfdcan->Instance->TXBRP & TxBufferIndex) != 0U ? 1U : 0U;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetProtocolStatus(const FDCAN_HandleTypeDef*   hfdcan,
+                                              FDCAN_ProtocolStatusTypeDef* ProtocolStatus)
+{
+    const uint32_t status               = hfdcan->Instance->PSR;
+    ProtocolStatus->LastErrorCode       = status & FDCAN_PSR_LEC;
+    ProtocolStatus->DataLastErrorCode   = (status & FDCAN_PSR_DLEC) >> FDCAN_PSR_DLEC_Pos;
+    ProtocolStatus->Activity            = status & FDCAN_PSR_ACT;
+    ProtocolStatus->ErrorPassive        = (status & FDCAN_PSR_EP) >> 5U;
+    ProtocolStatus->Warning             = (status & FDCAN_PSR_EW) >> 6U;
+    ProtocolStatus->BusOff              = (status & FDCAN_PSR_BO) >> 7U;
+    ProtocolStatus->RxESIflag           = (status & FDCAN_PSR_RESI) >> 11U;
+    ProtocolStatus->RxBRSflag           = (status & FDCAN_PSR_RBRS) >> 12U;
+    ProtocolStatus->RxFDFflag           = (status & FDCAN_PSR_REDL) >> 13U;
+    ProtocolStatus->ProtocolException   = (status & FDCAN_PSR_PXE) >> 14U;
+    ProtocolStatus->TDCvalue            = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetErrorCounters(const FDCAN_HandleTypeDef* hfdcan,
+                                             FDCAN_ErrorCountersTypeDef* ErrorCounters)
+{
+    const uint32_t counters       = hfdcan->Instance->ECR;
+    ErrorCounters->TxErrorCnt     = (counters & FDCAN_ECR_TEC) >> FDCAN_ECR_TEC_Pos;
+    ErrorCounters->RxErrorCnt     = (counters & FDCAN_ECR_REC) >> FDCAN_ECR_REC_Pos;
+    ErrorCounters->RxErrorPassive = (counters & FDCAN_ECR_RP) >> 15U;
+    ErrorCounters->ErrorLogging   = (counters & FDCAN_ECR_CEL) >> FDCAN_ECR_CEL_Pos;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef* hfdcan,
+                                                 const uint32_t       ActiveITs,
+                                                 const uint32_t       BufferIndexes)
+{
+    if (!ready_or_busy(hfdcan))
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    // 按 ILS 打开中断所在的中断线
+    const uint32_t line1 = can_sim::group_flags(hfdcan->Instance->ILS);
+    if ((ActiveITs & ~line1) != 0U)
+        hfdcan->Instance->ILE |= FDCAN_INTERRUPT_LINE0;
+    if ((ActiveITs & line1) != 0U)
+        hfdcan->Instance->ILE |= FDCAN_INTERRUPT_LINE1;
+    if ((ActiveITs & FDCAN_IT_TX_COMPLETE) != 0U)
+        hfdcan->Instance->TXBTIE |= BufferIndexes;
+    if ((ActiveITs & FDCAN_IT_TX_ABORT_COMPLETE) != 0U)
+        hfdcan->Instance->TXBCIE |= BufferIndexes;
+    hfdcan->Instance->IE |= ActiveITs;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef* hfdcan, const uint32_t InactiveITs)
+{
+    if (!ready_or_busy(hfdcan))
+    {
+        hfdcan->ErrorCode |= HAL_FDCAN_ERROR_NOT_INITIALIZED;
+        return HAL_ERROR;
+    }
+    const uint32_t remaining = hfdcan->Instance->IE & ~InactiveITs;
+    const uint32_t line1     = can_sim::group_flags(hfdcan->Instance->ILS);
+    if ((remaining & ~line1) == 0U)
+        hfdcan->Instance->ILE &= ~FDCAN_INTERRUPT_LINE0;
+    if ((remaining & line1) == 0U)
+        hfdcan->Instance->ILE &= ~FDCAN_INTERRUPT_LINE1;
+    if ((InactiveITs & FDCAN_IT_TX_COMPLETE) != 0U)
+        hfdcan->Instance->TXBTIE = 0;
+    if ((InactiveITs & FDCAN_IT_TX_ABORT_COMPLETE) != 0U)
+        hfdcan->Instance->TXBCIE = 0;
+    hfdcan->Instance->IE = remaining;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_RegisterRxFifo0Callback(FDCAN_HandleTypeDef*                hfdcan,
+                                                    const pFDCAN_RxFifo0CallbackTypeDef pCallback)
+{
+    return register_callback(hfdcan, hfdcan->RxFifo0Callback, pCallback);
+}
+
+HAL_StatusTypeDef HAL_FDCAN_RegisterRxFifo1Callback(FDCAN_HandleTypeDef*                hfdcan,
+                                                    const pFDCAN_RxFifo1CallbackTypeDef pCallback)
+{
+    return register_callback(hfdcan, hfdcan->RxFifo1Callback, pCallback);
+}
+
+HAL_StatusTypeDef HAL_FDCAN_RegisterTxBufferCompleteCallback(FDCAN_HandleTypeDef*                         hfdcan,
+                                                             const pFDCAN_TxBufferCompleteCallbackTypeDef pCallback)
+{
+    return register_callback(hfdcan, hfdcan->TxBufferCompleteCallback, pCallback);
+}
+
+HAL_StatusTypeDef HAL_FDCAN_RegisterTxBufferAbortCallback(FDCAN_HandleTypeDef*                      hfdcan,
+                                                          const pFDCAN_TxBufferAbortCallbackTypeDef pCallback)
+{
+    return register_callback(hfdcan, hfdcan->TxBufferAbortCallback, pCallback);
+}
+
+HAL_StatusTypeDef HAL_FDCAN_RegisterErrorStatusCallback(FDCAN_HandleTypeDef*                    hfdcan,
+                                                        const pFDCAN_ErrorStatusCallbackTypeDef pCallback)
+{
+    return register_callback(hfdcan, hfdcan->ErrorStatusCallback, pCallback);
+}
+
+void HAL_FDCAN_IRQHandler(FDCAN_HandleTypeDef* hfdcan)
+{
+    FDCAN_GlobalTypeDef* can = hfdcan->Instance;
+
+    constexpr uint32_t rx_fifo0_mask     = FDCAN_IR_RF0L | FDCAN_IR_RF0F | FDCAN_IR_RF0N;
+    constexpr uint32_t rx_fifo1_mask     = FDCAN_IR_RF1L | FDCAN_IR_RF1F | FDCAN_IR_RF1N;
+    constexpr uint32_t error_mask        = FDCAN_IR_ELO | FDCAN_IR_WDI | FDCAN_IR_PEA | FDCAN_IR_PED | FDCAN_IR_ARA;
+    constexpr uint32_t error_status_mask = FDCAN_IR_EP | FDCAN_IR_EW | FDCAN_IR_BO;
+
+    const uint32_t rx_fifo0_its     = can->IR & rx_fifo0_mask & can->IE;
+    const uint32_t rx_fifo1_its     = can->IR & rx_fifo1_mask & can->IE;
+    const uint32_t errors           = can->IR & error_mask & can->IE;
+    const uint32_t error_status_its = can->IR & error_status_mask & can->IE;
+    const uint32_t itsource         = can->IE;
+    const uint32_t itflag           = can->IR;
+
+    // 发送取消完成
+    if ((itflag & FDCAN_IR_TCF) != 0U && (itsource & FDCAN_IT_TX_ABORT_COMPLETE) != 0U)
+    {
+        const uint32_t aborted = can->TXBCF & can->TXBCIE;
+        can->IR                = FDCAN_IR_TCF;
+        hfdcan->TxBufferAbortCallback(hfdcan, aborted);
+    }
+
+    if (rx_fifo0_its != 0U)
+    {
+        can->IR = rx_fifo0_its;
+        hfdcan->RxFifo0Callback(hfdcan, rx_fifo0_its);
+    }
+    if (rx_fifo1_its != 0U)
+    {
+        can->IR = rx_fifo1_its;
+        hfdcan->RxFifo1Callback(hfdcan, rx_fifo1_its);
+    }
+
+    // TX FIFO 空（没有注册对应的回调，只清除标志）
+    if ((itflag & FDCAN_IR_TFE) != 0U && (itsource & FDCAN_IT_TX_FIFO_EMPTY) != 0U)
+        can->IR = FDCAN_IR_TFE;
+
+    // 发送完成：TXBTO 只在 Buffer 重新请求发送时清除，这里会带上早先已经报告过的 Buffer
+    if ((itflag & FDCAN_IR_TC) != 0U && (itsource & FDCAN_IT_TX_COMPLETE) != 0U)
+    {
+        const uint32_t transmitted = can->TXBTO & can->TXBTIE;
+        can->IR                    = FDCAN_IR_TC;
+        hfdcan->TxBufferCompleteCallback(hfdcan, transmitted);
+    }
+
+    if (error_status_its != 0U)
+    {
+        can->IR = error_status_its;
+        hfdcan->ErrorStatusCallback(hfdcan, error_status_its);
+    }
+
+    if (errors != 0U)
+    {
+        can->IR = errors;
+        hfdcan->ErrorCode |= errors;
+    }
+}
+
+HAL_FDCAN_StateTypeDef HAL_FDCAN_GetState(const FDCAN_HandleTypeDef* hfdcan)
+{
+    return hfdcan->State;
+}
+
+uint32_t HAL_FDCAN_GetError(const FDCAN_HandleTypeDef* hfdcan)
+{
+    return hfdcan->ErrorCode;
+}
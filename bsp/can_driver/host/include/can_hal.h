@@ -0,0 +1,417 @@
+/**
+ * @file    can_hal.h
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   主机仿真用的 bxCAN 寄存器定义与 HAL_CAN 接口。
+ *
+ * 寄存器布局、位定义、类型和函数签名与 STM32F4 的 CMSIS 设备头文件及 stm32f4xx_hal_can.h 一致，
+ * 函数由 bxcan_sim.cpp 基于寄存器模型实现，行为（状态检查、邮箱选择、中断处理顺序）与 HAL 相同。
+ */
+#pragma once
+
+#define HAL_CAN_MODULE_ENABLED
+#define USE_HAL_CAN_REGISTER_CALLBACKS (1U)
+
+/*
+ * 寄存器
+ */
+
+typedef struct
+{
+    __IO SimReg TIR;
+    __IO SimReg TDTR;
+    __IO SimReg TDLR;
+    __IO SimReg TDHR;
+} CAN_TxMailBox_TypeDef;
+
+typedef struct
+{
+    __IO SimReg RIR;
+    __IO SimReg RDTR;
+    __IO SimReg RDLR;
+    __IO SimReg RDHR;
+} CAN_FIFOMailBox_TypeDef;
+
+typedef struct
+{
+    __IO SimReg FR1;
+    __IO SimReg FR2;
+} CAN_FilterRegister_TypeDef;
+
+typedef struct
+{
+    __IO SimReg                MCR;              // 0x000
+    __IO SimReg                MSR;              // 0x004
+    __IO SimReg                TSR;              // 0x008
+    __IO SimReg                RF0R;             // 0x00C
+    __IO SimReg                RF1R;             // 0x010
+    __IO SimReg                IER;              // 0x014
+    __IO SimReg                ESR;              // 0x018
+    __IO SimReg                BTR;              // 0x01C
+    SimReg                     RESERVED0[88];    // 0x020
+    CAN_TxMailBox_TypeDef      sTxMailBox[3];    // 0x180
+    CAN_FIFOMailBox_TypeDef    sFIFOMailBox[2];  // 0x1B0
+    SimReg                     RESERVED1[12];    // 0x1D0
+    __IO SimReg                FMR;              // 0x200
+    __IO SimReg                FM1R;             // 0x204
+    SimReg                     RESERVED2;        // 0x208
+    __IO SimReg                FS1R;             // 0x20C
+    SimReg                     RESERVED3;        // 0x210
+    __IO SimReg                FFA1R;            // 0x214
+    SimReg                     RESERVED4;        // 0x218
+    __IO SimReg                FA1R;             // 0x21C
+    SimReg                     RESERVED5[8];     // 0x220
+    CAN_FilterRegister_TypeDef sFilterRegister[28]; // 0x240
+} CAN_TypeDef;
+
+// 寄存器在仿真 CAN_TypeDef 中的偏移，外设模型据此区分寄存器
+#define CAN_REG_OFFSET(reg) (offsetof(CAN_TypeDef, reg))
+
+#define CAN_MCR_INRQ (0x1UL << 0U)
+#define CAN_MCR_SLEEP (0x1UL << 1U)
+#define CAN_MCR_TXFP (0x1UL << 2U)
+#define CAN_MCR_RFLM (0x1UL << 3U)
+#define CAN_MCR_NART (0x1UL << 4U)
+#define CAN_MCR_AWUM (0x1UL << 5U)
+#define CAN_MCR_ABOM (0x1UL << 6U)
+#define CAN_MCR_TTCM (0x1UL << 7U)
+#define CAN_MCR_RESET (0x1UL << 15U)
+
+#define CAN_MSR_INAK (0x1UL << 0U)
+#define CAN_MSR_SLAK (0x1UL << 1U)
+#define CAN_MSR_ERRI (0x1UL << 2U)
+#define CAN_MSR_WKUI (0x1UL << 3U)
+#define CAN_MSR_SLAKI (0x1UL << 4U)
+
+#define CAN_TSR_RQCP0 (0x1UL << 0U)
+#define CAN_TSR_TXOK0 (0x1UL << 1U)
+#define CAN_TSR_ALST0 (0x1UL << 2U)
+#define CAN_TSR_TERR0 (0x1UL << 3U)
+#define CAN_TSR_ABRQ0 (0x1UL << 7U)
+#define CAN_TSR_RQCP1 (0x1UL << 8U)
+#define CAN_TSR_TXOK1 (0x1UL << 9U)
+#define CAN_TSR_ALST1 (0x1UL << 10U)
+#define CAN_TSR_TERR1 (0x1UL << 11U)
+#define CAN_TSR_ABRQ1 (0x1UL << 15U)
+#define CAN_TSR_RQCP2 (0x1UL << 16U)
+#define CAN_TSR_TXOK2 (0x1UL << 17U)
+#define CAN_TSR_ALST2 (0x1UL << 18U)
+#define CAN_TSR_TERR2 (0x1UL << 19U)
+#define CAN_TSR_ABRQ2 (0x1UL << 23U)
+#define CAN_TSR_CODE_Pos (24U)
+#define CAN_TSR_CODE (0x3UL << CAN_TSR_CODE_Pos)
+#define CAN_TSR_TME0 (0x1UL << 26U)
+#define CAN_TSR_TME1 (0x1UL << 27U)
+#define CAN_TSR_TME2 (0x1UL << 28U)
+#define CAN_TSR_TME (0x7UL << 26U)
+#define CAN_TSR_LOW0 (0x1UL << 29U)
+#define CAN_TSR_LOW1 (0x1UL << 30U)
+#define CAN_TSR_LOW2 (0x1UL << 31U)
+
+#define CAN_RF0R_FMP0 (0x3UL << 0U)
+#define CAN_RF0R_FULL0 (0x1UL << 3U)
+#define CAN_RF0R_FOVR0 (0x1UL << 4U)
+#define CAN_RF0R_RFOM0 (0x1UL << 5U)
+#define CAN_RF1R_FMP1 (0x3UL << 0U)
+#define CAN_RF1R_FULL1 (0x1UL << 3U)
+#define CAN_RF1R_FOVR1 (0x1UL << 4U)
+#define CAN_RF1R_RFOM1 (0x1UL << 5U)
+
+#define CAN_IER_TMEIE (0x1UL << 0U)
+#define CAN_IER_FMPIE0 (0x1UL << 1U)
+#define CAN_IER_FFIE0 (0x1UL << 2U)
+#define CAN_IER_FOVIE0 (0x1UL << 3U)
+#define CAN_IER_FMPIE1 (0x1UL << 4U)
+#define CAN_IER_FFIE1 (0x1UL << 5U)
+#define CAN_IER_FOVIE1 (0x1UL << 6U)
+#define CAN_IER_EWGIE (0x1UL << 8U)
+#define CAN_IER_EPVIE (0x1UL << 9U)
+#define CAN_IER_BOFIE (0x1UL << 10U)
+#define CAN_IER_LECIE (0x1UL << 11U)
+#define CAN_IER_ERRIE (0x1UL << 15U)
+#define CAN_IER_WKUIE (0x1UL << 16U)
+#define CAN_IER_SLKIE (0x1UL << 17U)
+
+#define CAN_ESR_EWGF (0x1UL << 0U)
+#define CAN_ESR_EPVF (0x1UL << 1U)
+#define CAN_ESR_BOFF (0x1UL << 2U)
+#define CAN_ESR_LEC_Pos (4U)
+#define CAN_ESR_LEC (0x7UL << CAN_ESR_LEC_Pos)
+#define CAN_ESR_TEC_Pos (16U)
+#define CAN_ESR_TEC (0xFFUL << CAN_ESR_TEC_Pos)
+#define CAN_ESR_REC_Pos (24U)
+#define CAN_ESR_REC (0xFFUL << CAN_ESR_REC_Pos)
+
+#define CAN_BTR_BRP_Pos (0U)
+#define CAN_BTR_BRP (0x3FFUL << CAN_BTR_BRP_Pos)
+#define CAN_BTR_TS1_Pos (16U)
+#define CAN_BTR_TS1 (0xFUL << CAN_BTR_TS1_Pos)
+#define CAN_BTR_TS2_Pos (20U)
+#define CAN_BTR_TS2 (0x7UL << CAN_BTR_TS2_Pos)
+#define CAN_BTR_SJW_Pos (24U)
+#define CAN_BTR_SJW (0x3UL << CAN_BTR_SJW_Pos)
+#define CAN_BTR_LBKM (0x1UL << 30U)
+#define CAN_BTR_SILM (0x1UL << 31U)
+
+#define CAN_TI0R_TXRQ (0x1UL << 0U)
+#define CAN_TI0R_RTR (0x1UL << 1U)
+#define CAN_TI0R_IDE (0x1UL << 2U)
+#define CAN_TI0R_EXID_Pos (3U)
+#define CAN_TI0R_EXID (0x3FFFFUL << CAN_TI0R_EXID_Pos)
+#define CAN_TI0R_STID_Pos (21U)
+#define CAN_TI0R_STID (0x7FFUL << CAN_TI0R_STID_Pos)
+#define CAN_TDT0R_DLC_Pos (0U)
+#define CAN_TDT0R_DLC (0xFUL << CAN_TDT0R_DLC_Pos)
+#define CAN_TDT0R_TGT (0x1UL << 8U)
+#define CAN_TDT0R_TIME_Pos (16U)
+#define CAN_TDT0R_TIME (0xFFFFUL << CAN_TDT0R_TIME_Pos)
+
+#define CAN_RI0R_RTR (0x1UL << 1U)
+#define CAN_RI0R_IDE (0x1UL << 2U)
+#define CAN_RI0R_EXID_Pos (3U)
+#define CAN_RI0R_EXID (0x3FFFFUL << CAN_RI0R_EXID_Pos)
+#define CAN_RI0R_STID_Pos (21U)
+#define CAN_RI0R_STID (0x7FFUL << CAN_RI0R_STID_Pos)
+#define CAN_RDT0R_DLC_Pos (0U)
+#define CAN_RDT0R_DLC (0xFUL << CAN_RDT0R_DLC_Pos)
+#define CAN_RDT0R_FMI_Pos (8U)
+#define CAN_RDT0R_FMI (0xFFUL << CAN_RDT0R_FMI_Pos)
+#define CAN_RDT0R_TIME_Pos (16U)
+#define CAN_RDT0R_TIME (0xFFFFUL << CAN_RDT0R_TIME_Pos)
+
+#define CAN_FMR_FINIT (0x1UL << 0U)
+#define CAN_FMR_CAN2SB_Pos (8U)
+#define CAN_FMR_CAN2SB (0x3FUL << CAN_FMR_CAN2SB_Pos)
+
+/*
+ * HAL 类型
+ */
+
+typedef enum
+{
+    HAL_CAN_STATE_RESET         = 0x00U,
+    HAL_CAN_STATE_READY         = 0x01U,
+    HAL_CAN_STATE_LISTENING     = 0x02U,
+    HAL_CAN_STATE_SLEEP_PENDING = 0x03U,
+    HAL_CAN_STATE_SLEEP_ACTIVE  = 0x04U,
+    HAL_CAN_STATE_ERROR         = 0x05U
+} HAL_CAN_StateTypeDef;
+
+typedef struct
+{
+    uint32_t        Prescaler;
+    uint32_t        Mode;
+    uint32_t        SyncJumpWidth;
+    uint32_t        TimeSeg1;
+    uint32_t        TimeSeg2;
+    FunctionalState TimeTriggeredMode;
+    FunctionalState AutoBusOff;
+    FunctionalState AutoWakeUp;
+    FunctionalState AutoRetransmission;
+    FunctionalState ReceiveFifoLocked;
+    FunctionalState TransmitFifoPriority;
+} CAN_InitTypeDef;
+
+typedef struct
+{
+    uint32_t FilterIdHigh;
+    uint32_t FilterIdLow;
+    uint32_t FilterMaskIdHigh;
+    uint32_t FilterMaskIdLow;
+    uint32_t FilterFIFOAssignment;
+    uint32_t FilterBank;
+    uint32_t FilterMode;
+    uint32_t FilterScale;
+    uint32_t FilterActivation;
+    uint32_t SlaveStartFilterBank;
+} CAN_FilterTypeDef;
+
+typedef struct
+{
+    uint32_t        StdId;
+    uint32_t        ExtId;
+    uint32_t        IDE;
+    uint32_t        RTR;
+    uint32_t        DLC;
+    FunctionalState TransmitGlobalTime;
+} CAN_TxHeaderTypeDef;
+
+typedef struct
+{
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t Timestamp;
+    uint32_t FilterMatchIndex;
+} CAN_RxHeaderTypeDef;
+
+typedef struct __CAN_HandleTypeDef
+{
+    CAN_TypeDef*                  Instance;
+    CAN_InitTypeDef               Init;
+    __IO HAL_CAN_StateTypeDef     State;
+    __IO uint32_t                 ErrorCode;
+
+    void (*TxMailbox0CompleteCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*TxMailbox1CompleteCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*TxMailbox2CompleteCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*TxMailbox0AbortCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*TxMailbox1AbortCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*TxMailbox2AbortCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*RxFifo0MsgPendingCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*RxFifo0FullCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*RxFifo1MsgPendingCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*RxFifo1FullCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*SleepCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*WakeUpFromRxMsgCallback)(struct __CAN_HandleTypeDef* hcan);
+    void (*ErrorCallback)(struct __CAN_HandleTypeDef* hcan);
+} CAN_HandleTypeDef;
+
+typedef enum
+{
+    HAL_CAN_TX_MAILBOX0_COMPLETE_CB_ID = 0x00U,
+    HAL_CAN_TX_MAILBOX1_COMPLETE_CB_ID = 0x01U,
+    HAL_CAN_TX_MAILBOX2_COMPLETE_CB_ID = 0x02U,
+    HAL_CAN_TX_MAILBOX0_ABORT_CB_ID    = 0x03U,
+    HAL_CAN_TX_MAILBOX1_ABORT_CB_ID    = 0x04U,
+    HAL_CAN_TX_MAILBOX2_ABORT_CB_ID    = 0x05U,
+    HAL_CAN_RX_FIFO0_MSG_PENDING_CB_ID = 0x06U,
+    HAL_CAN_RX_FIFO0_FULL_CB_ID        = 0x07U,
+    HAL_CAN_RX_FIFO1_MSG_PENDING_CB_ID = 0x08U,
+    HAL_CAN_RX_FIFO1_FULL_CB_ID        = 0x09U,
+    HAL_CAN_SLEEP_CB_ID                = 0x0AU,
+    HAL_CAN_WAKEUP_FROM_RX_MSG_CB_ID   = 0x0BU,
+    HAL_CAN_ERROR_CB_ID                = 0x0CU,
+} HAL_CAN_CallbackIDTypeDef;
+
+typedef void (*pCAN_CallbackTypeDef)(CAN_HandleTypeDef* hcan);
+
+#define HAL_CAN_ERROR_NONE (0x00000000U)
+#define HAL_CAN_ERROR_EWG (0x00000001U)
+#define HAL_CAN_ERROR_EPV (0x00000002U)
+#define HAL_CAN_ERROR_BOF (0x00000004U)
+#define HAL_CAN_ERROR_STF (0x00000008U)
+#define HAL_CAN_ERROR_FOR (0x00000010U)
+#define HAL_CAN_ERROR_ACK (0x00000020U)
+#define HAL_CAN_ERROR_BR (0x00000040U)
+#define HAL_CAN_ERROR_BD (0x00000080U)
+#define HAL_CAN_ERROR_CRC (0x00000100U)
+#define HAL_CAN_ERROR_RX_FOV0 (0x00000200U)
+#define HAL_CAN_ERROR_RX_FOV1 (0x00000400U)
+#define HAL_CAN_ERROR_TX_ALST0 (0x00000800U)
+#define HAL_CAN_ERROR_TX_TERR0 (0x00001000U)
+#define HAL_CAN_ERROR_TX_ALST1 (0x00002000U)
+#define HAL_CAN_ERROR_TX_TERR1 (0x00004000U)
+#define HAL_CAN_ERROR_TX_ALST2 (0x00008000U)
+#define HAL_CAN_ERROR_TX_TERR2 (0x00010000U)
+#define HAL_CAN_ERROR_TIMEOUT (0x00020000U)
+#define HAL_CAN_ERROR_NOT_INITIALIZED (0x00040000U)
+#define HAL_CAN_ERROR_NOT_READY (0x00080000U)
+#define HAL_CAN_ERROR_NOT_STARTED (0x00100000U)
+#define HAL_CAN_ERROR_PARAM (0x00200000U)
+#define HAL_CAN_ERROR_INVALID_CALLBACK (0x00400000U)
+
+#define CAN_MODE_NORMAL (0x00000000U)
+#define CAN_MODE_LOOPBACK (CAN_BTR_LBKM)
+#define CAN_MODE_SILENT (CAN_BTR_SILM)
+#define CAN_MODE_SILENT_LOOPBACK (CAN_BTR_LBKM | CAN_BTR_SILM)
+
+#define CAN_SJW_1TQ (0x00000000U)
+#define CAN_SJW_2TQ (0x01000000U)
+#define CAN_SJW_3TQ (0x02000000U)
+#define CAN_SJW_4TQ (0x03000000U)
+
+#define CAN_BS1_1TQ (0x00000000U)
+#define CAN_BS1_2TQ (0x00010000U)
+#define CAN_BS1_3TQ (0x00020000U)
+#define CAN_BS1_4TQ (0x00030000U)
+#define CAN_BS1_5TQ (0x00040000U)
+#define CAN_BS1_6TQ (0x00050000U)
+#define CAN_BS1_7TQ (0x00060000U)
+#define CAN_BS1_8TQ (0x00070000U)
+#define CAN_BS1_9TQ (0x00080000U)
+#define CAN_BS1_10TQ (0x00090000U)
+#define CAN_BS1_11TQ (0x000A0000U)
+#define CAN_BS1_12TQ (0x000B0000U)
+#define CAN_BS1_13TQ (0x000C0000U)
+#define CAN_BS1_14TQ (0x000D0000U)
+#define CAN_BS1_15TQ (0x000E0000U)
+#define CAN_BS1_16TQ (0x000F0000U)
+
+#define CAN_BS2_1TQ (0x00000000U)
+#define CAN_BS2_2TQ (0x00100000U)
+#define CAN_BS2_3TQ (0x00200000U)
+#define CAN_BS2_4TQ (0x00300000U)
+#define CAN_BS2_5TQ (0x00400000U)
+#define CAN_BS2_6TQ (0x00500000U)
+#define CAN_BS2_7TQ (0x00600000U)
+#define CAN_BS2_8TQ (0x00700000U)
+
+#define CAN_FILTERMODE_IDMASK (0x00000000U)
+#define CAN_FILTERMODE_IDLIST (0x00000001U)
+#define CAN_FILTERSCALE_16BIT (0x00000000U)
+#define CAN_FILTERSCALE_32BIT (0x00000001U)
+#define CAN_FILTER_DISABLE (0x00000000U)
+#define CAN_FILTER_ENABLE (0x00000001U)
+#define CAN_FILTER_FIFO0 (0x00000000U)
+#define CAN_FILTER_FIFO1 (0x00000001U)
+
+#define CAN_ID_STD (0x00000000U)
+#define CAN_ID_EXT (0x00000004U)
+#define CAN_RTR_DATA (0x00000000U)
+#define CAN_RTR_REMOTE (0x00000002U)
+
+#define CAN_RX_FIFO0 (0x00000000U)
+#define CAN_RX_FIFO1 (0x00000001U)
+
+#define CAN_TX_MAILBOX0 (0x00000001U)
+#define CAN_TX_MAILBOX1 (0x00000002U)
+#define CAN_TX_MAILBOX2 (0x00000004U)
+
+#define CAN_IT_TX_MAILBOX_EMPTY (CAN_IER_TMEIE)
+#define CAN_IT_RX_FIFO0_MSG_PENDING (CAN_IER_FMPIE0)
+#define CAN_IT_RX_FIFO0_FULL (CAN_IER_FFIE0)
+#define CAN_IT_RX_FIFO0_OVERRUN (CAN_IER_FOVIE0)
+#define CAN_IT_RX_FIFO1_MSG_PENDING (CAN_IER_FMPIE1)
+#define CAN_IT_RX_FIFO1_FULL (CAN_IER_FFIE1)
+#define CAN_IT_RX_FIFO1_OVERRUN (CAN_IER_FOVIE1)
+#define CAN_IT_WAKEUP (CAN_IER_WKUIE)
+#define CAN_IT_SLEEP_ACK (CAN_IER_SLKIE)
+#define CAN_IT_ERROR_WARNING (CAN_IER_EWGIE)
+#define CAN_IT_ERROR_PASSIVE (CAN_IER_EPVIE)
+#define CAN_IT_BUSOFF (CAN_IER_BOFIE)
+#define CAN_IT_LAST_ERROR_CODE (CAN_IER_LECIE)
+#define CAN_IT_ERROR (CAN_IER_ERRIE)
+
+/*
+ * HAL 接口
+ */
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_DeInit(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_RegisterCallback(CAN_HandleTypeDef*        hcan,
+                                           HAL_CAN_CallbackIDTypeDef CallbackID,
+                                           pCAN_CallbackTypeDef      pCallback);
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, const CAN_FilterTypeDef* sFilterConfig);
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef*         hcan,
+                                       const CAN_TxHeaderTypeDef* pHeader,
+                                       const uint8_t              aData[],
+                                       uint32_t*                  pTxMailbox);
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef* hcan, uint32_t TxMailboxes);
+uint32_t          HAL_CAN_GetTxMailboxesFreeLevel(const CAN_HandleTypeDef* hcan);
+uint32_t          HAL_CAN_IsTxMessagePending(const CAN_HandleTypeDef* hcan, uint32_t TxMailboxes);
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef*   hcan,
+                                       uint32_t             RxFifo,
+                                       CAN_RxHeaderTypeDef* pHeader,
+                                       uint8_t              aData[]);
+uint32_t          HAL_CAN_GetRxFifoFillLevel(const CAN_HandleTypeDef* hcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef* hcan, uint32_t ActiveITs);
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef* hcan, uint32_t InactiveITs);
+void              HAL_CAN_IRQHandler(CAN_HandleTypeDef* hcan);
+HAL_CAN_StateTypeDef HAL_CAN_GetState(const CAN_HandleTypeDef* hcan);
+uint32_t             HAL_CAN_GetError(const CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef    HAL_CAN_ResetError(CAN_HandleTypeDef* hcan);
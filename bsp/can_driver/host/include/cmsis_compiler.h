@@ -0,0 +1,71 @@
+/**
+ * @file    cmsis_compiler.h
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   主机仿真用的 CMSIS 内核指令。
+ *
+ * CAN 仿真是单线程的：中断只在仿真推进时间，或者 PRIMASK / BASEPRI 恢复为不屏蔽时由仿真依次调用，
+ * 与真实芯片上“临界区退出后挂起的中断立即响应”一致。屏蔽状态的持续时间按主机时间统计，
+ * 用于比较不同实现的关中断时长（见 can_sim::masked_stats）。
+ */
+#pragma once
+
+// isr_lock.h 在 extern "C" 中包含本文件，这里只能使用 C 头文件
+#include <stdint.h>
+
+extern "C"
+{
+uint32_t sim_get_primask();
+void     sim_set_primask(uint32_t primask);
+uint32_t sim_get_basepri();
+void     sim_set_basepri(uint32_t basepri);
+uint32_t sim_get_ipsr();
+}
+
+static inline uint32_t __get_PRIMASK()
+{
+    return sim_get_primask();
+}
+
+static inline void __set_PRIMASK(const uint32_t primask)
+{
+    sim_set_primask(primask);
+}
+
+static inline void __disable_irq()
+{
+    sim_set_primask(1);
+}
+
+static inline void __enable_irq()
+{
+    sim_set_primask(0);
+}
+
+static inline uint32_t __get_BASEPRI()
+{
+    return sim_get_basepri();
+}
+
+static inline void __set_BASEPRI(const uint32_t basepri)
+{
+    sim_set_basepri(basepri);
+}
+
+// 只提高屏蔽级别，与 BASEPRI_MAX 相同
+static inline void __set_BASEPRI_MAX(const uint32_t basepri)
+{
+    const uint32_t current = sim_get_basepri();
+    if (basepri != 0 && (current == 0 || basepri < current))
+        sim_set_basepri(basepri);
+}
+
+static inline uint32_t __get_IPSR()
+{
+    return sim_get_ipsr();
+}
+
+static inline void __DSB() {}
+static inline void __ISB() {}
+static inline void __DMB() {}
+static inline void __NOP() {}
@@ -0,0 +1,492 @@
+/**
+ * @file    fdcan_hal.h
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   主机仿真用的 FDCAN 寄存器定义与 HAL_FDCAN 接口。
+ *
+ * 寄存器布局、位定义、类型和函数签名与 STM32G4 的 CMSIS 设备头文件及 stm32g4xx_hal_fdcan.h 一致
+ * （DataLength 使用新版 G4 HAL 的 [3:0] 编码），只包含 can_driver 与测试用到的部分。
+ * 函数由 fdcan_sim.cpp 基于外设模型实现：发送 / 接收元素按 HAL 的格式写入与读出仿真的消息 RAM，
+ * 中断处理的分发顺序与 HAL_FDCAN_IRQHandler 相同。
+ *
+ * 主机构建定义 SIM_FDCAN=1 时由 main.h 代替 can_hal.h 包含。
+ */
+#pragma once
+
+#define HAL_FDCAN_MODULE_ENABLED
+#define USE_HAL_FDCAN_REGISTER_CALLBACKS (1U)
+
+/*
+ * 寄存器
+ */
+
+typedef struct
+{
+    __IO SimReg CREL;         // 0x000
+    __IO SimReg ENDN;         // 0x004
+    SimReg      RESERVED1;    // 0x008
+    __IO SimReg DBTP;         // 0x00C
+    __IO SimReg TEST;         // 0x010
+    __IO SimReg RWD;          // 0x014
+    __IO SimReg CCCR;         // 0x018
+    __IO SimReg NBTP;         // 0x01C
+    __IO SimReg TSCC;         // 0x020
+    __IO SimReg TSCV;         // 0x024
+    __IO SimReg TOCC;         // 0x028
+    __IO SimReg TOCV;         // 0x02C
+    SimReg      RESERVED2[4]; // 0x030
+    __IO SimReg ECR;          // 0x040
+    __IO SimReg PSR;          // 0x044
+    __IO SimReg TDCR;         // 0x048
+    SimReg      RESERVED3;    // 0x04C
+    __IO SimReg IR;           // 0x050
+    __IO SimReg IE;           // 0x054
+    __IO SimReg ILS;          // 0x058
+    __IO SimReg ILE;          // 0x05C
+    SimReg      RESERVED4[8]; // 0x060
+    __IO SimReg RXGFC;        // 0x080
+    __IO SimReg XIDAM;        // 0x084
+    __IO SimReg HPMS;         // 0x088
+    SimReg      RESERVED5;    // 0x08C
+    __IO SimReg RXF0S;        // 0x090
+    __IO SimReg RXF0A;        // 0x094
+    __IO SimReg RXF1S;        // 0x098
+    __IO SimReg RXF1A;        // 0x09C
+    SimReg      RESERVED6[8]; // 0x0A0
+    __IO SimReg TXBC;         // 0x0C0
+    __IO SimReg TXFQS;        // 0x0C4
+    __IO SimReg TXBRP;        // 0x0C8
+    __IO SimReg TXBAR;        // 0x0CC
+    __IO SimReg TXBCR;        // 0x0D0
+    __IO SimReg TXBTO;        // 0x0D4
+    __IO SimReg TXBCF;        // 0x0D8
+    __IO SimReg TXBTIE;       // 0x0DC
+    __IO SimReg TXBCIE;       // 0x0E0
+    __IO SimReg TXEFS;        // 0x0E4
+    __IO SimReg TXEFA;        // 0x0E8
+} FDCAN_GlobalTypeDef;
+
+// 寄存器在仿真 FDCAN_GlobalTypeDef 中的偏移，外设模型据此区分寄存器
+#define FDCAN_REG_OFFSET(reg) (offsetof(FDCAN_GlobalTypeDef, reg))
+
+#define FDCAN_CCCR_INIT (0x1UL << 0U)
+#define FDCAN_CCCR_CCE (0x1UL << 1U)
+#define FDCAN_CCCR_ASM (0x1UL << 2U)
+#define FDCAN_CCCR_CSA (0x1UL << 3U)
+#define FDCAN_CCCR_CSR (0x1UL << 4U)
+#define FDCAN_CCCR_MON (0x1UL << 5U)
+#define FDCAN_CCCR_DAR (0x1UL << 6U)
+#define FDCAN_CCCR_TEST (0x1UL << 7U)
+#define FDCAN_CCCR_FDOE (0x1UL << 8U)
+#define FDCAN_CCCR_BRSE (0x1UL << 9U)
+#define FDCAN_CCCR_PXHD (0x1UL << 12U)
+#define FDCAN_CCCR_EFBI (0x1UL << 13U)
+#define FDCAN_CCCR_TXP (0x1UL << 14U)
+#define FDCAN_CCCR_NISO (0x1UL << 15U)
+
+#define FDCAN_NBTP_NTSEG2_Pos (0U)
+#define FDCAN_NBTP_NTSEG2 (0x7FUL << FDCAN_NBTP_NTSEG2_Pos)
+#define FDCAN_NBTP_NTSEG1_Pos (8U)
+#define FDCAN_NBTP_NTSEG1 (0xFFUL << FDCAN_NBTP_NTSEG1_Pos)
+#define FDCAN_NBTP_NBRP_Pos (16U)
+#define FDCAN_NBTP_NBRP (0x1FFUL << FDCAN_NBTP_NBRP_Pos)
+#define FDCAN_NBTP_NSJW_Pos (25U)
+#define FDCAN_NBTP_NSJW (0x7FUL << FDCAN_NBTP_NSJW_Pos)
+
+#define FDCAN_DBTP_DSJW_Pos (0U)
+#define FDCAN_DBTP_DTSEG2_Pos (4U)
+#define FDCAN_DBTP_DTSEG1_Pos (8U)
+#define FDCAN_DBTP_DBRP_Pos (16U)
+
+#define FDCAN_ECR_TEC_Pos (0U)
+#define FDCAN_ECR_TEC (0xFFUL << FDCAN_ECR_TEC_Pos)
+#define FDCAN_ECR_REC_Pos (8U)
+#define FDCAN_ECR_REC (0x7FUL << FDCAN_ECR_REC_Pos)
+#define FDCAN_ECR_RP (0x1UL << 15U)
+#define FDCAN_ECR_CEL_Pos (16U)
+#define FDCAN_ECR_CEL (0xFFUL << FDCAN_ECR_CEL_Pos)
+
+#define FDCAN_PSR_LEC_Pos (0U)
+#define FDCAN_PSR_LEC (0x7UL << FDCAN_PSR_LEC_Pos)
+#define FDCAN_PSR_ACT_Pos (3U)
+#define FDCAN_PSR_ACT (0x3UL << FDCAN_PSR_ACT_Pos)
+#define FDCAN_PSR_EP (0x1UL << 5U)
+#define FDCAN_PSR_EW (0x1UL << 6U)
+#define FDCAN_PSR_BO (0x1UL << 7U)
+#define FDCAN_PSR_DLEC_Pos (8U)
+#define FDCAN_PSR_DLEC (0x7UL << FDCAN_PSR_DLEC_Pos)
+#define FDCAN_PSR_RESI (0x1UL << 11U)
+#define FDCAN_PSR_RBRS (0x1UL << 12U)
+#define FDCAN_PSR_REDL (0x1UL << 13U)
+#define FDCAN_PSR_PXE (0x1UL << 14U)
+
+#define FDCAN_IR_RF0N (0x1UL << 0U)
+#define FDCAN_IR_RF0F (0x1UL << 1U)
+#define FDCAN_IR_RF0L (0x1UL << 2U)
+#define FDCAN_IR_RF1N (0x1UL << 3U)
+#define FDCAN_IR_RF1F (0x1UL << 4U)
+#define FDCAN_IR_RF1L (0x1UL << 5U)
+#define FDCAN_IR_HPM (0x1UL << 6U)
+#define FDCAN_IR_TC (0x1UL << 7U)
+#define FDCAN_IR_TCF (0x1UL << 8U)
+#define FDCAN_IR_TFE (0x1UL << 9U)
+#define FDCAN_IR_TEFN (0x1UL << 10U)
+#define FDCAN_IR_TEFF (0x1UL << 11U)
+#define FDCAN_IR_TEFL (0x1UL << 12U)
+#define FDCAN_IR_TSW (0x1UL << 13U)
+#define FDCAN_IR_MRAF (0x1UL << 14U)
+#define FDCAN_IR_TOO (0x1UL << 15U)
+#define FDCAN_IR_ELO (0x1UL << 16U)
+#define FDCAN_IR_EP (0x1UL << 17U)
+#define FDCAN_IR_EW (0x1UL << 18U)
+#define FDCAN_IR_BO (0x1UL << 19U)
+#define FDCAN_IR_WDI (0x1UL << 20U)
+#define FDCAN_IR_PEA (0x1UL << 21U)
+#define FDCAN_IR_PED (0x1UL << 22U)
+#define FDCAN_IR_ARA (0x1UL << 23U)
+
+#define FDCAN_TEST_LBCK (0x1UL << 4U)
+
+// ILS 按中断组选择中断线（G4）
+#define FDCAN_ILS_RXFIFO0 (0x1UL << 0U)
+#define FDCAN_ILS_RXFIFO1 (0x1UL << 1U)
+#define FDCAN_ILS_SMSG (0x1UL << 2U)
+#define FDCAN_ILS_TFERR (0x1UL << 3U)
+#define FDCAN_ILS_MISC (0x1UL << 4U)
+#define FDCAN_ILS_BERR (0x1UL << 5U)
+#define FDCAN_ILS_PERR (0x1UL << 6U)
+
+#define FDCAN_ILE_EINT0 (0x1UL << 0U)
+#define FDCAN_ILE_EINT1 (0x1UL << 1U)
+
+#define FDCAN_RXGFC_RRFE (0x1UL << 0U)
+#define FDCAN_RXGFC_RRFS (0x1UL << 1U)
+#define FDCAN_RXGFC_ANFE_Pos (2U)
+#define FDCAN_RXGFC_ANFE (0x3UL << FDCAN_RXGFC_ANFE_Pos)
+#define FDCAN_RXGFC_ANFS_Pos (4U)
+#define FDCAN_RXGFC_ANFS (0x3UL << FDCAN_RXGFC_ANFS_Pos)
+#define FDCAN_RXGFC_F1OM (0x1UL << 8U)
+#define FDCAN_RXGFC_F0OM (0x1UL << 9U)
+#define FDCAN_RXGFC_LSS_Pos (16U)
+#define FDCAN_RXGFC_LSS (0x1FUL << FDCAN_RXGFC_LSS_Pos)
+#define FDCAN_RXGFC_LSE_Pos (24U)
+#define FDCAN_RXGFC_LSE (0xFUL << FDCAN_RXGFC_LSE_Pos)
+
+#define FDCAN_RXF0S_F0FL_Pos (0U)
+#define FDCAN_RXF0S_F0FL (0xFUL << FDCAN_RXF0S_F0FL_Pos)
+#define FDCAN_RXF0S_F0GI_Pos (8U)
+#define FDCAN_RXF0S_F0GI (0x3UL << FDCAN_RXF0S_F0GI_Pos)
+#define FDCAN_RXF0S_F0PI_Pos (16U)
+#define FDCAN_RXF0S_F0PI (0x3UL << FDCAN_RXF0S_F0PI_Pos)
+#define FDCAN_RXF0S_F0F (0x1UL << 24U)
+#define FDCAN_RXF0S_RF0L (0x1UL << 25U)
+
+#define FDCAN_TXBC_TFQM (0x1UL << 24U)
+
+#define FDCAN_TXFQS_TFFL_Pos (0U)
+#define FDCAN_TXFQS_TFFL (0x7UL << FDCAN_TXFQS_TFFL_Pos)
+#define FDCAN_TXFQS_TFGI_Pos (8U)
+#define FDCAN_TXFQS_TFGI (0x3UL << FDCAN_TXFQS_TFGI_Pos)
+#define FDCAN_TXFQS_TFQPI_Pos (16U)
+#define FDCAN_TXFQS_TFQPI (0x3UL << FDCAN_TXFQS_TFQPI_Pos)
+#define FDCAN_TXFQS_TFQF (0x1UL << 21U)
+
+#define CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+#define READ_BIT(REG, BIT) ((REG) & (BIT))
+
+/*
+ * 消息 RAM 元素（G4：28 个标准 ID 过滤器、8 个扩展 ID 过滤器，每个 FIFO 3 个接收元素，3 个发送 Buffer，每个收发元素 18 个字）
+ */
+
+#define FDCAN_SIM_RX_FIFO_ELEMENTS (3U)
+#define FDCAN_SIM_TX_BUFFERS (3U)
+#define FDCAN_SIM_STD_FILTERS (28U)
+#define FDCAN_SIM_EXT_FILTERS (8U)
+
+#define FDCAN_ELEMENT_MASK_STDID (0x1FFC0000U)
+#define FDCAN_ELEMENT_MASK_EXTID (0x1FFFFFFFU)
+#define FDCAN_ELEMENT_MASK_RTR (0x20000000U)
+#define FDCAN_ELEMENT_MASK_XTD (0x40000000U)
+#define FDCAN_ELEMENT_MASK_ESI (0x80000000U)
+#define FDCAN_ELEMENT_MASK_TS (0x0000FFFFU)
+#define FDCAN_ELEMENT_MASK_DLC (0x000F0000U)
+#define FDCAN_ELEMENT_MASK_BRS (0x00100000U)
+#define FDCAN_ELEMENT_MASK_FDF (0x00200000U)
+#define FDCAN_ELEMENT_MASK_EFC (0x00800000U)
+#define FDCAN_ELEMENT_MASK_MM (0xFF000000U)
+#define FDCAN_ELEMENT_MASK_FIDX (0x7F000000U)
+#define FDCAN_ELEMENT_MASK_ANMF (0x80000000U)
+
+typedef struct
+{
+    uint32_t header[2];
+    uint32_t data[16];
+} FDCAN_SimElement;
+
+/*
+ * HAL
+ */
+
+typedef enum
+{
+    HAL_FDCAN_STATE_RESET = 0x00U,
+    HAL_FDCAN_STATE_READY = 0x01U,
+    HAL_FDCAN_STATE_BUSY  = 0x02U,
+    HAL_FDCAN_STATE_ERROR = 0x03U
+} HAL_FDCAN_StateTypeDef;
+
+typedef struct
+{
+    uint32_t        ClockDivider;
+    uint32_t        FrameFormat;
+    uint32_t        Mode;
+    FunctionalState AutoRetransmission;
+    FunctionalState TransmitPause;
+    FunctionalState ProtocolException;
+    uint32_t        NominalPrescaler;
+    uint32_t        NominalSyncJumpWidth;
+    uint32_t        NominalTimeSeg1;
+    uint32_t        NominalTimeSeg2;
+    uint32_t        DataPrescaler;
+    uint32_t        DataSyncJumpWidth;
+    uint32_t        DataTimeSeg1;
+    uint32_t        DataTimeSeg2;
+    uint32_t        StdFiltersNbr;
+    uint32_t        ExtFiltersNbr;
+    uint32_t        TxFifoQueueMode;
+} FDCAN_InitTypeDef;
+
+typedef struct
+{
+    uint32_t Identifier;
+    uint32_t IdType;
+    uint32_t TxFrameType;
+    uint32_t DataLength;
+    uint32_t ErrorStateIndicator;
+    uint32_t BitRateSwitch;
+    uint32_t FDFormat;
+    uint32_t TxEventFifoControl;
+    uint32_t MessageMarker;
+} FDCAN_TxHeaderTypeDef;
+
+typedef struct
+{
+    uint32_t Identifier;
+    uint32_t IdType;
+    uint32_t RxFrameType;
+    uint32_t DataLength;
+    uint32_t ErrorStateIndicator;
+    uint32_t BitRateSwitch;
+    uint32_t FDFormat;
+    uint32_t RxTimestamp;
+    uint32_t FilterIndex;
+    uint32_t IsFilterMatchingFrame;
+} FDCAN_RxHeaderTypeDef;
+
+typedef struct
+{
+    uint32_t IdType;
+    uint32_t FilterIndex;
+    uint32_t FilterType;
+    uint32_t FilterConfig;
+    uint32_t FilterID1;
+    uint32_t FilterID2;
+} FDCAN_FilterTypeDef;
+
+typedef struct
+{
+    uint32_t LastErrorCode;
+    uint32_t DataLastErrorCode;
+    uint32_t Activity;
+    uint32_t ErrorPassive;
+    uint32_t Warning;
+    uint32_t BusOff;
+    uint32_t RxESIflag;
+    uint32_t RxBRSflag;
+    uint32_t RxFDFflag;
+    uint32_t ProtocolException;
+    uint32_t TDCvalue;
+} FDCAN_ProtocolStatusTypeDef;
+
+typedef struct
+{
+    uint32_t TxErrorCnt;
+    uint32_t RxErrorCnt;
+    uint32_t RxErrorPassive;
+    uint32_t ErrorLogging;
+} FDCAN_ErrorCountersTypeDef;
+
+typedef struct __FDCAN_HandleTypeDef
+{
+    FDCAN_GlobalTypeDef*            Instance;
+    FDCAN_InitTypeDef               Init;
+    uint32_t                        msgRam; // 仿真中不使用
+    uint32_t                        LatestTxFifoQRequest;
+    volatile HAL_FDCAN_StateTypeDef State;
+    volatile uint32_t               ErrorCode;
+
+    void (*RxFifo0Callback)(struct __FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs);
+    void (*RxFifo1Callback)(struct __FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo1ITs);
+    void (*TxBufferCompleteCallback)(struct __FDCAN_HandleTypeDef* hfdcan, uint32_t BufferIndexes);
+    void (*TxBufferAbortCallback)(struct __FDCAN_HandleTypeDef* hfdcan, uint32_t BufferIndexes);
+    void (*ErrorStatusCallback)(struct __FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs);
+} FDCAN_HandleTypeDef;
+
+typedef void (*pFDCAN_RxFifo0CallbackTypeDef)(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs);
+typedef void (*pFDCAN_RxFifo1CallbackTypeDef)(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo1ITs);
+typedef void (*pFDCAN_TxBufferCompleteCallbackTypeDef)(FDCAN_HandleTypeDef* hfdcan, uint32_t BufferIndexes);
+typedef void (*pFDCAN_TxBufferAbortCallbackTypeDef)(FDCAN_HandleTypeDef* hfdcan, uint32_t BufferIndexes);
+typedef void (*pFDCAN_ErrorStatusCallbackTypeDef)(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs);
+
+#define HAL_FDCAN_ERROR_NONE (0x00000000U)
+#define HAL_FDCAN_ERROR_TIMEOUT (0x00000001U)
+#define HAL_FDCAN_ERROR_NOT_INITIALIZED (0x00000002U)
+#define HAL_FDCAN_ERROR_NOT_READY (0x00000004U)
+#define HAL_FDCAN_ERROR_NOT_STARTED (0x00000008U)
+#define HAL_FDCAN_ERROR_PARAM (0x00000020U)
+#define HAL_FDCAN_ERROR_FIFO_EMPTY (0x00000100U)
+#define HAL_FDCAN_ERROR_FIFO_FULL (0x00000200U)
+#define HAL_FDCAN_ERROR_INVALID_CALLBACK (0x00000100U)
+
+#define FDCAN_FRAME_CLASSIC (0x00000000U)
+#define FDCAN_FRAME_FD_NO_BRS (FDCAN_CCCR_FDOE)
+#define FDCAN_FRAME_FD_BRS (FDCAN_CCCR_FDOE | FDCAN_CCCR_BRSE)
+
+#define FDCAN_MODE_NORMAL (0x00000000U)
+#define FDCAN_MODE_RESTRICTED_OPERATION (0x00000001U)
+#define FDCAN_MODE_BUS_MONITORING (0x00000002U)
+#define FDCAN_MODE_INTERNAL_LOOPBACK (0x00000003U)
+#define FDCAN_MODE_EXTERNAL_LOOPBACK (0x00000004U)
+
+#define FDCAN_TX_FIFO_OPERATION (0x00000000U)
+#define FDCAN_TX_QUEUE_OPERATION (FDCAN_TXBC_TFQM)
+
+#define FDCAN_STANDARD_ID (0x00000000U)
+#define FDCAN_EXTENDED_ID (0x40000000U)
+
+#define FDCAN_DATA_FRAME (0x00000000U)
+#define FDCAN_REMOTE_FRAME (0x20000000U)
+
+#define FDCAN_DLC_BYTES_0 (0x00000000U)
+#define FDCAN_DLC_BYTES_1 (0x00000001U)
+#define FDCAN_DLC_BYTES_2 (0x00000002U)
+#define FDCAN_DLC_BYTES_3 (0x00000003U)
+#define FDCAN_DLC_BYTES_4 (0x00000004U)
+#define FDCAN_DLC_BYTES_5 (0x00000005U)
+#define FDCAN_DLC_BYTES_6 (0x00000006U)
+#define FDCAN_DLC_BYTES_7 (0x00000007U)
+#define FDCAN_DLC_BYTES_8 (0x00000008U)
+#define FDCAN_DLC_BYTES_12 (0x00000009U)
+#define FDCAN_DLC_BYTES_16 (0x0000000AU)
+#define FDCAN_DLC_BYTES_20 (0x0000000BU)
+#define FDCAN_DLC_BYTES_24 (0x0000000CU)
+#define FDCAN_DLC_BYTES_32 (0x0000000DU)
+#define FDCAN_DLC_BYTES_48 (0x0000000EU)
+#define FDCAN_DLC_BYTES_64 (0x0000000FU)
+
+#define FDCAN_ESI_ACTIVE (0x00000000U)
+#define FDCAN_ESI_PASSIVE (0x80000000U)
+
+#define FDCAN_BRS_OFF (0x00000000U)
+#define FDCAN_BRS_ON (0x00100000U)
+
+#define FDCAN_CLASSIC_CAN (0x00000000U)
+#define FDCAN_FD_CAN (0x00200000U)
+
+#define FDCAN_NO_TX_EVENTS (0x00000000U)
+#define FDCAN_STORE_TX_EVENTS (0x00800000U)
+
+#define FDCAN_RX_FIFO0 (0x00000040U)
+#define FDCAN_RX_FIFO1 (0x00000041U)
+
+#define FDCAN_TX_BUFFER0 (0x00000001U)
+#define FDCAN_TX_BUFFER1 (0x00000002U)
+#define FDCAN_TX_BUFFER2 (0x00000004U)
+
+#define FDCAN_FILTER_RANGE (0x00000000U)
+#define FDCAN_FILTER_DUAL (0x00000001U)
+#define FDCAN_FILTER_MASK (0x00000002U)
+#define FDCAN_FILTER_RANGE_NO_EIDM (0x00000003U)
+
+#define FDCAN_FILTER_DISABLE (0x00000000U)
+#define FDCAN_FILTER_TO_RXFIFO0 (0x00000001U)
+#define FDCAN_FILTER_TO_RXFIFO1 (0x00000002U)
+#define FDCAN_FILTER_REJECT (0x00000003U)
+#define FDCAN_FILTER_HP (0x00000004U)
+#define FDCAN_FILTER_TO_RXFIFO0_HP (0x00000005U)
+#define FDCAN_FILTER_TO_RXFIFO1_HP (0x00000006U)
+
+#define FDCAN_ACCEPT_IN_RX_FIFO0 (0x00000000U)
+#define FDCAN_ACCEPT_IN_RX_FIFO1 (0x00000001U)
+#define FDCAN_REJECT (0x00000002U)
+
+#define FDCAN_FILTER_REMOTE (0x00000000U)
+#define FDCAN_REJECT_REMOTE (0x00000001U)
+
+#define FDCAN_RX_FIFO_BLOCKING (0x00000000U)
+#define FDCAN_RX_FIFO_OVERWRITE (0x00000001U)
+
+#define FDCAN_PROTOCOL_ERROR_NONE (0x00000000U)
+#define FDCAN_PROTOCOL_ERROR_ACK (0x00000003U)
+#define FDCAN_PROTOCOL_ERROR_BIT0 (0x00000005U)
+#define FDCAN_PROTOCOL_ERROR_NO_CHANGE (0x00000007U)
+
+#define FDCAN_IT_RX_FIFO0_NEW_MESSAGE (FDCAN_IR_RF0N)
+#define FDCAN_IT_RX_FIFO0_FULL (FDCAN_IR_RF0F)
+#define FDCAN_IT_RX_FIFO0_MESSAGE_LOST (FDCAN_IR_RF0L)
+#define FDCAN_IT_RX_FIFO1_NEW_MESSAGE (FDCAN_IR_RF1N)
+#define FDCAN_IT_RX_FIFO1_FULL (FDCAN_IR_RF1F)
+#define FDCAN_IT_RX_FIFO1_MESSAGE_LOST (FDCAN_IR_RF1L)
+#define FDCAN_IT_TX_COMPLETE (FDCAN_IR_TC)
+#define FDCAN_IT_TX_ABORT_COMPLETE (FDCAN_IR_TCF)
+#define FDCAN_IT_TX_FIFO_EMPTY (FDCAN_IR_TFE)
+#define FDCAN_IT_ERROR_PASSIVE (FDCAN_IR_EP)
+#define FDCAN_IT_ERROR_WARNING (FDCAN_IR_EW)
+#define FDCAN_IT_BUS_OFF (FDCAN_IR_BO)
+
+#define FDCAN_INTERRUPT_LINE0 (FDCAN_ILE_EINT0)
+#define FDCAN_INTERRUPT_LINE1 (FDCAN_ILE_EINT1)
+
+#define FDCAN_CFG_RX_FIFO0 (0x00000000U)
+#define FDCAN_CFG_RX_FIFO1 (0x00000001U)
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_DeInit(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef* hfdcan, const FDCAN_FilterTypeDef* sFilterConfig);
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef* hfdcan,
+                                               uint32_t             NonMatchingStd,
+                                               uint32_t             NonMatchingExt,
+                                               uint32_t             RejectRemoteStd,
+                                               uint32_t             RejectRemoteExt);
+HAL_StatusTypeDef HAL_FDCAN_ConfigRxFifoOverwrite(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo, uint32_t OperationMode);
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_AddMessageToTxFifoQ(FDCAN_HandleTypeDef*         hfdcan,
+                                                const FDCAN_TxHeaderTypeDef* pTxHeader,
+                                                const uint8_t*               pTxData);
+uint32_t          HAL_FDCAN_GetLatestTxFifoQRequestBuffer(const FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_AbortTxRequest(FDCAN_HandleTypeDef* hfdcan, uint32_t BufferIndex);
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef*   hfdcan,
+                                         uint32_t               RxLocation,
+                                         FDCAN_RxHeaderTypeDef* pRxHeader,
+                                         uint8_t*               pRxData);
+uint32_t          HAL_FDCAN_GetRxFifoFillLevel(const FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo);
+uint32_t          HAL_FDCAN_GetTxFifoFreeLevel(const FDCAN_HandleTypeDef* hfdcan);
+uint32_t          HAL_FDCAN_IsTxBufferMessagePending(const FDCAN_HandleTypeDef* hfdcan, uint32_t TxBufferIndex);
+HAL_StatusTypeDef HAL_FDCAN_GetProtocolStatus(const FDCAN_HandleTypeDef*   hfdcan,
+                                              FDCAN_ProtocolStatusTypeDef* ProtocolStatus);
+HAL_StatusTypeDef HAL_FDCAN_GetErrorCounters(const FDCAN_HandleTypeDef* hfdcan, FDCAN_ErrorCountersTypeDef* ErrorCounters);
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t ActiveITs, uint32_t BufferIndexes);
+HAL_StatusTypeDef HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t InactiveITs);
+HAL_StatusTypeDef HAL_FDCAN_RegisterRxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, pFDCAN_RxFifo0CallbackTypeDef pCallback);
+HAL_StatusTypeDef HAL_FDCAN_RegisterRxFifo1Callback(FDCAN_HandleTypeDef* hfdcan, pFDCAN_RxFifo1CallbackTypeDef pCallback);
+HAL_StatusTypeDef HAL_FDCAN_RegisterTxBufferCompleteCallback(FDCAN_HandleTypeDef*                   hfdcan,
+                                                             pFDCAN_TxBufferCompleteCallbackTypeDef pCallback);
+HAL_StatusTypeDef HAL_FDCAN_RegisterTxBufferAbortCallback(FDCAN_HandleTypeDef*                hfdcan,
+                                                          pFDCAN_TxBufferAbortCallbackTypeDef pCallback);
+HAL_StatusTypeDef HAL_FDCAN_RegisterErrorStatusCallback(FDCAN_HandleTypeDef*              hfdcan,
+                                                        pFDCAN_ErrorStatusCallbackTypeDef pCallback);
+void              HAL_FDCAN_IRQHandler(FDCAN_HandleTypeDef* hfdcan);
+HAL_FDCAN_StateTypeDef HAL_FDCAN_GetState(const FDCAN_HandleTypeDef* hfdcan);
+uint32_t               HAL_FDCAN_GetError(const FDCAN_HandleTypeDef* hfdcan);
@@ -0,0 +1,212 @@
+/**
+ * @file    main.h
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   主机仿真用的 main.h，代替 CubeMX 生成的同名头文件。
+ *
+ * 只提供 can_driver 用到的那部分 CMSIS / HAL：内核寄存器（DWT、CoreDebug、NVIC）、HAL_GetTick，
+ * 以及 can_hal.h 中的 bxCAN 寄存器与 HAL_CAN_* 接口（定义 SIM_FDCAN=1 时换成 fdcan_hal.h 中 G4 的 FDCAN 与 HAL_FDCAN_* 接口，
+ * 与目标板上一样两者只存在其一）。所有外设寄存器都是 SimReg，
+ * 读写由 can_sim.hpp 中的外设模型实现，驱动代码（包括 CAN_FAST_PATH 的直接寄存器访问）无需任何修改。
+ *
+ * 时间全部来自仿真时钟：HAL_GetTick 与 DWT->CYCCNT 只在仿真推进时间时变化，测试结果与主机负载无关。
+ *
+ * 本头文件只用于 C++ 的主机构建。
+ */
+#pragma once
+
+#ifndef __cplusplus
+#    error "the host simulation headers are C++ only"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * 寄存器代理
+ */
+
+class SimReg;
+
+/**
+ * 寄存器读写的实现者，由外设模型实现
+ */
+class SimRegisterHook
+{
+public:
+    virtual uint32_t read(const SimReg& reg)           = 0;
+    virtual void     write(SimReg& reg, uint32_t value) = 0;
+
+protected:
+    ~SimRegisterHook() = default;
+};
+
+/**
+ * 一个 32 位外设寄存器
+ *
+ * 未绑定外设模型时就是一个普通的 32 位存储；绑定后读写转交给外设模型，
+ * 以实现写 1 清零、只读位、触发发送等硬件语义
+ */
+class SimReg
+{
+public:
+    SimReg() = default;
+
+    SimReg(const SimReg&)            = delete;
+    SimReg& operator=(const SimReg&) = delete;
+
+    operator uint32_t() const { return hook_ != nullptr ? hook_->read(*this) : value_; }
+
+    SimReg& operator=(const uint32_t value)
+    {
+        if (hook_ != nullptr)
+            hook_->write(*this, value);
+        else
+            value_ = value;
+        return *this;
+    }
+
+    // 主机上 unsigned long 是 64 位，`reg &= ~CAN_MCR_ABOM` 的右值比 32 位宽，这里显式截断，与目标板结果相同
+    template <typename T>
+    SimReg& operator|=(const T value)
+    {
+        return *this = static_cast<uint32_t>(static_cast<uint32_t>(*this) | value);
+    }
+    template <typename T>
+    SimReg& operator&=(const T value)
+    {
+        return *this = static_cast<uint32_t>(static_cast<uint32_t>(*this) & value);
+    }
+    template <typename T>
+    SimReg& operator^=(const T value)
+    {
+        return *this = static_cast<uint32_t>(static_cast<uint32_t>(*this) ^ value);
+    }
+
+    /// 不经过外设模型的原始值，供外设模型自身使用
+    [[nodiscard]] uint32_t raw() const { return value_; }
+    void                   set_raw(const uint32_t value) { value_ = value; }
+
+    void bind(SimRegisterHook* hook) { hook_ = hook; }
+
+private:
+    uint32_t         value_{ 0 };
+    SimRegisterHook* hook_{ nullptr };
+};
+
+#define __IO
+#define __I
+#define __O
+
+#define UNUSED(X) (void) (X)
+
+/*
+ * Cortex-M 内核
+ */
+
+#define __CORTEX_M (4U)
+#define __NVIC_PRIO_BITS (4U)
+
+typedef enum
+{
+    NonMaskableInt_IRQn   = -14,
+    HardFault_IRQn        = -13,
+    MemoryManagement_IRQn = -12,
+    BusFault_IRQn         = -11,
+    UsageFault_IRQn       = -10,
+    SVCall_IRQn           = -5,
+    DebugMonitor_IRQn     = -4,
+    PendSV_IRQn           = -2,
+    SysTick_IRQn          = -1,
+#if defined(SIM_FDCAN) && SIM_FDCAN
+    FDCAN1_IT0_IRQn       = 21,
+    FDCAN1_IT1_IRQn       = 22,
+#else
+    CAN1_TX_IRQn          = 19,
+    CAN1_RX0_IRQn         = 20,
+    CAN1_RX1_IRQn         = 21,
+    CAN1_SCE_IRQn         = 22,
+#endif
+    SIM_IRQ_NUM           = 96,
+} IRQn_Type;
+
+/**
+ * 中断优先级（与 NVIC_GetPriority 一样未左移），由仿真设置
+ */
+uint32_t NVIC_GetPriority(IRQn_Type irqn);
+void     NVIC_SetPriority(IRQn_Type irqn, uint32_t priority);
+
+/**
+ * DWT CYCCNT：按 SystemCoreClock 由仿真时钟换算，只读
+ */
+class SimCycleCounter
+{
+public:
+    operator uint32_t() const;
+};
+
+typedef struct
+{
+    SimReg          CTRL;
+    SimCycleCounter CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    SimReg DHCSR;
+    SimReg DCRSR;
+    SimReg DCRDR;
+    SimReg DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type       sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_core_debug)
+
+#define DWT_CTRL_CYCCNTENA_Pos (0U)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << DWT_CTRL_CYCCNTENA_Pos)
+#define CoreDebug_DEMCR_TRCENA_Pos (24U)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << CoreDebug_DEMCR_TRCENA_Pos)
+
+extern uint32_t SystemCoreClock;
+
+/*
+ * HAL 公共部分
+ */
+
+typedef enum
+{
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    DISABLE = 0U,
+    ENABLE  = !DISABLE
+} FunctionalState;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+/// 仿真时钟的毫秒数
+uint32_t HAL_GetTick();
+
+/// 推进仿真时间（期间总线照常收发），不能在中断中调用
+void HAL_Delay(uint32_t delay_ms);
+
+/// APB1 时钟，CAN 的位时间由它和 BTR 决定
+uint32_t HAL_RCC_GetPCLK1Freq();
+
+/// 仿真中的 Error_Handler 打印调用位置后终止测试
+#define Error_Handler() sim_error_handler(__FILE__, __LINE__)
+[[noreturn]] void sim_error_handler(const char* file, int line);
+
+#if defined(SIM_FDCAN) && SIM_FDCAN
+#    include "fdcan_hal.h"
+#else
+#    include "can_hal.h"
+#endif
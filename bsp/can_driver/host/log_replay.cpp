@@ -0,0 +1,129 @@
+/**
+ * @file    log_replay.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   记录器日志的解码与按时间回放。
+ */
+#include "log_replay.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace can_sim
+{
+
+std::vector<can_log::Record> decode_log(const uint8_t* data, const size_t size, LogSummary* summary)
+{
+    LogSummary                   result{};
+    std::vector<can_log::Record> records;
+    size_t                       offset = 0;
+    while (offset + can_log::BLOCK_HEADER_SIZE <= size)
+    {
+        can_log::BlockHeader header{};
+        if (!can_log::decode_block_header(data + offset, size - offset, header))
+        {
+            offset++;
+            continue;
+        }
+        result.blocks++;
+        result.dropped += header.dropped;
+
+        const size_t begin   = offset + can_log::BLOCK_HEADER_SIZE;
+        const size_t end     = std::min(begin + header.length, size);
+        bool         damaged = begin + header.length > size;
+
+        uint64_t prev_us = header.base_us;
+        size_t   pos     = begin;
+        while (pos < end)
+        {
+            can_log::Record record{};
+            const size_t    used = can_log::decode_record(data + pos, end - pos, prev_us, record);
+            if (used == 0)
+            {
+                damaged = true;
+                break;
+            }
+            records.push_back(record);
+            pos += used;
+        }
+        result.damaged += damaged ? 1 : 0;
+        // 记录区损坏时从下一个字节开始重新寻找块头
+        offset = pos == end ? end : pos + 1;
+    }
+
+    std::stable_sort(records.begin(),
+                     records.end(),
+                     [](const can_log::Record& a, const can_log::Record& b) { return a.time_us < b.time_us; });
+    if (summary != nullptr)
+        *summary = result;
+    return records;
+}
+
+Frame to_frame(const can_log::Record& record)
+{
+    Frame frame;
+    frame.id  = record.id;
+    frame.ext = record.ext;
+    frame.rtr = record.rtr;
+    frame.dlc = record.dlc;
+    if (!record.rtr)
+        std::memcpy(frame.data, record.data, record.dlc);
+    return frame;
+}
+
+LogReplayer::LogReplayer(Bus& bus, std::vector<can_log::Record> records, const uint64_t start_ns)
+    : Node(bus), records_(std::move(records)), start_ns_(start_ns)
+{
+}
+
+uint64_t LogReplayer::due_ns(const size_t index) const
+{
+    // 第 index 帧应当在 start_ns_ + 第一帧帧长 + 两者记录时间之差 时结束
+    const uint64_t first_us = records_.front().time_us;
+    const uint64_t time_us  = records_[index].time_us;
+    const uint64_t end_ns   = start_ns_ + bus().frame_ns(to_frame(records_.front())) +
+                            (time_us > first_us ? time_us - first_us : 0) * 1000;
+    const uint64_t frame_ns = bus().frame_ns(to_frame(records_[index]));
+    return end_ns > start_ns_ + frame_ns ? end_ns - frame_ns : start_ns_;
+}
+
+uint64_t LogReplayer::next_due_ns() const
+{
+    return done() ? NEVER : due_ns(next_);
+}
+
+bool LogReplayer::tx_pending(Frame* frame)
+{
+    if (done() || next_due_ns() > now_ns())
+        return false;
+    *frame = to_frame(records_[next_]);
+    return true;
+}
+
+bool LogReplayer::tx_begin()
+{
+    max_lateness_ns_ = std::max(max_lateness_ns_, now_ns() - next_due_ns());
+    return false;
+}
+
+void LogReplayer::tx_end(const Transfer::Result result)
+{
+    // 出错时自动重发
+    if (result == Transfer::Result::Ok)
+        ++next_;
+}
+
+void LogReplayer::rx(const Frame& frame, const uint64_t sof_ns)
+{
+    (void) frame;
+    (void) sof_ns;
+}
+
+uint64_t LogReplayer::next_event_ns() const
+{
+    // 已到提交时刻的帧由 tx_pending 交给总线，不再作为定时事件
+    const uint64_t due = next_due_ns();
+    return due > now_ns() ? due : NEVER;
+}
+
+} // namespace can_sim
@@ -0,0 +1,97 @@
+/**
+ * @file    log_replay.hpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   把记录器输出的日志（can_log.hpp 格式）按记录时间回放到虚拟总线。
+ *
+ * - decode_log：解码日志中所有块的记录，块头损坏或数据截断时跳到下一个魔数继续，并按时间稳定排序。
+ *   延迟分发的接收帧在日志中排在之后才记录的发送帧后面，重排后与现场的先后一致；
+ * - LogReplayer：总线上的一个节点，按记录时间把帧提交到总线。记录的时间是帧结束（接收到达、发送完成）的时刻，
+ *   所以每帧都提前它自己在仿真总线上的帧长提交：第一帧在 start_ns 开始发送，之后第 i 帧的结束时刻比第一帧晚
+ *   time_us[i] - time_us[0]。提交时总线正忙或仲裁失败就照常等待，实际开始发送比提交时刻晚多少由
+ *   max_lateness_ns() 给出（现场总线波特率更高或帧被重排时不为 0）。
+ *
+ * 测试中用它把现场日志回放给被测驱动；tools/can_log_tool.cpp 再挂一个 SocketCanBridge，按主机时间推进仿真，
+ * 把日志回放到 SocketCAN 接口。
+ *
+ * ```cpp
+ * std::vector<can_log::Record> records = can_sim::decode_log(log.data(), log.size());
+ * records.erase(std::remove_if(records.begin(), records.end(), [](const can_log::Record& r) { return r.tx; }),
+ *               records.end());
+ * can_sim::LogReplayer replay(bus, std::move(records));
+ * bus.run_until_idle();
+ * ```
+ */
+#pragma once
+
+#include "../can_log.hpp"
+#include "can_sim.hpp"
+
+#include <vector>
+
+namespace can_sim
+{
+
+/**
+ * decode_log 遇到的问题
+ */
+struct LogSummary
+{
+    size_t   blocks{ 0 };  ///< 找到的块数
+    size_t   damaged{ 0 }; ///< 数据截断或记录损坏的块数
+    uint64_t dropped{ 0 }; ///< 各块块头记下的丢弃帧数之和
+};
+
+/**
+ * 解码日志中的全部记录
+ * @param summary 可选，输出块数、损坏的块数与丢弃帧数
+ * @return 按 time_us 稳定排序的记录
+ */
+std::vector<can_log::Record> decode_log(const uint8_t* data, size_t size, LogSummary* summary = nullptr);
+
+/**
+ * 记录对应的总线帧
+ */
+Frame to_frame(const can_log::Record& record);
+
+/**
+ * 按记录时间发送日志中的帧的节点
+ *
+ * 同一时刻只有一帧在提交：前一帧发送成功之后才轮到下一条记录，出错时自动重发，与 VirtualNode 相同
+ */
+class LogReplayer final : public Node
+{
+public:
+    /**
+     * @param records 要回放的记录，按时间排序（decode_log 的结果）；按方向或总线编号筛选由调用方完成
+     * @param start_ns 第一条记录提交发送的仿真时刻，默认为当前时刻
+     */
+    LogReplayer(Bus& bus, std::vector<can_log::Record> records, uint64_t start_ns = now_ns());
+
+    /// 下一条记录提交发送的仿真时刻，全部发送后返回 NEVER
+    [[nodiscard]] uint64_t next_due_ns() const;
+
+    [[nodiscard]] bool   done() const { return next_ == records_.size(); }
+    [[nodiscard]] size_t sent() const { return next_; }
+    [[nodiscard]] size_t size() const { return records_.size(); }
+
+    /// 开始发送（赢得仲裁）的时刻比提交时刻晚的最大值
+    [[nodiscard]] uint64_t max_lateness_ns() const { return max_lateness_ns_; }
+
+protected:
+    bool     tx_pending(Frame* frame) override;
+    bool     tx_begin() override;
+    void     tx_end(Transfer::Result result) override;
+    void     rx(const Frame& frame, uint64_t sof_ns) override;
+    uint64_t next_event_ns() const override;
+
+private:
+    [[nodiscard]] uint64_t due_ns(size_t index) const;
+
+    std::vector<can_log::Record> records_;
+    uint64_t                     start_ns_;
+    size_t                       next_{ 0 };
+    uint64_t                     max_lateness_ns_{ 0 };
+};
+
+} // namespace can_sim
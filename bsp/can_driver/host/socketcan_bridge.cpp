@@ -0,0 +1,86 @@
+/**
+ * @file    socketcan_bridge.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   SocketCAN 桥接节点。
+ */
+#include "socketcan_bridge.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <linux/can.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace can_sim
+{
+
+SocketCanBridge::SocketCanBridge(Bus& bus, const char* ifname) : VirtualNode(bus)
+{
+    const int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (fd < 0)
+        return;
+
+    ifreq ifr{};
+    std::strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    sockaddr_can addr{};
+    addr.can_family = AF_CAN;
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0 ||
+        (addr.can_ifindex = ifr.ifr_ifindex, bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) < 0)
+    {
+        close(fd);
+        return;
+    }
+    fd_ = fd;
+}
+
+SocketCanBridge::~SocketCanBridge()
+{
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+size_t SocketCanBridge::poll()
+{
+    if (fd_ < 0)
+        return 0;
+
+    size_t    count = 0;
+    can_frame raw{};
+    while (read(fd_, &raw, sizeof(raw)) == static_cast<ssize_t>(sizeof(raw)))
+    {
+        // 忽略错误帧
+        if ((raw.can_id & CAN_ERR_FLAG) != 0)
+            continue;
+        Frame frame;
+        frame.ext = (raw.can_id & CAN_EFF_FLAG) != 0;
+        frame.rtr = (raw.can_id & CAN_RTR_FLAG) != 0;
+        frame.id  = raw.can_id & (frame.ext ? CAN_EFF_MASK : CAN_SFF_MASK);
+        frame.dlc = raw.can_dlc > 8 ? 8 : raw.can_dlc;
+        std::memcpy(frame.data, raw.data, frame.dlc);
+        send(frame);
+        ++count;
+    }
+    return count;
+}
+
+void SocketCanBridge::rx(const Frame& frame, const uint64_t sof_ns)
+{
+    // 只桥接经典帧
+    if (frame.fd)
+        return;
+    VirtualNode::rx(frame, sof_ns);
+    if (fd_ < 0)
+        return;
+
+    can_frame raw{};
+    raw.can_id = frame.id | (frame.ext ? CAN_EFF_FLAG : 0U) | (frame.rtr ? CAN_RTR_FLAG : 0U);
+    raw.can_dlc = frame.dlc > 8 ? 8 : frame.dlc;
+    std::memcpy(raw.data, frame.data, raw.can_dlc);
+    (void) write(fd_, &raw, sizeof(raw));
+}
+
+} // namespace can_sim
@@ -0,0 +1,47 @@
+/**
+ * @file    socketcan_bridge.hpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   把 Linux SocketCAN 接口接入虚拟总线。
+ *
+ * 仿真总线上其他节点发送成功的帧写到接口上，接口上读到的帧由本节点发送到仿真总线，
+ * 于是可以用 candump / cansend 观察或驱动仿真中的驱动。一般配合 vcan 使用：
+ *
+ * ```sh
+ * sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+ * ```
+ *
+ * 仿真时间不随主机时间推进，poll() 需要由测试循环定期调用。
+ */
+#pragma once
+
+#include "can_sim.hpp"
+
+namespace can_sim
+{
+
+class SocketCanBridge final : public VirtualNode
+{
+public:
+    /**
+     * @param ifname 接口名，例如 "vcan0"；打开失败时 is_open() 返回 false
+     */
+    SocketCanBridge(Bus& bus, const char* ifname);
+    ~SocketCanBridge() override;
+
+    [[nodiscard]] bool is_open() const { return fd_ >= 0; }
+
+    /**
+     * 读出接口上已到达的全部帧，排队发送到仿真总线
+     * @return 读到的帧数
+     */
+    size_t poll();
+
+protected:
+    void rx(const Frame& frame, uint64_t sof_ns) override;
+
+private:
+    int fd_{ -1 };
+};
+
+} // namespace can_sim
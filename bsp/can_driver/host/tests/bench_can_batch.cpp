@@ -0,0 +1,113 @@
+/**
+ * @file    bench_can_batch.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   控制周期批量发送基准：逐帧 CAN_SendMessage 与一次 CAN_SendBatch 的关中断开销对比。
+ *
+ * 每个控制周期提交 4 帧与 8 帧（超过 3 个邮箱的部分进入软件队列），分别统计：
+ * - 关中断的次数（确定的，批量发送每周期只有一次）；
+ * - 关中断的总时长与单次最长时长（主机时间，只打印）；
+ * - 提交期间经由 SimReg 的寄存器访问次数（确定的，目标板上每次访问都要走 APB 总线）。
+ *
+ * 分别链接 HAL 路径与 CAN_FAST_PATH 的驱动编译。
+ *
+ * 用法：can_batch_bench_hal [周期数]，can_batch_bench_fast [周期数]
+ */
+#include "can_driver.hpp"
+#include "can_sim.hpp"
+#include "host_test.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace can_sim;
+
+namespace
+{
+
+Bus         bus(1000000);
+BxCan       can1(bus);
+VirtualNode peer(bus);
+
+struct CycleCost
+{
+    uint64_t masked_sections;
+    uint64_t masked_ns;
+    uint64_t masked_max_ns;
+    uint64_t register_accesses;
+};
+
+/**
+ * 每周期提交 frames 帧，共 cycles 个周期；每个周期结束后让总线发完，发送不计入统计
+ */
+CycleCost run(const char* label, const size_t frames, const uint32_t cycles, const bool batch)
+{
+    CAN_MessageDef msgs[8]{};
+    for (size_t i = 0; i < frames; ++i)
+    {
+        msgs[i].header.StdId = 0x200 + static_cast<uint32_t>(i);
+        msgs[i].header.IDE   = CAN_ID_STD;
+        msgs[i].header.RTR   = CAN_RTR_DATA;
+        msgs[i].header.DLC   = 8;
+    }
+
+    CycleCost cost{};
+    peer.clear_received();
+    for (uint32_t cycle = 0; cycle < cycles; ++cycle)
+    {
+        for (size_t i = 0; i < frames; ++i)
+            msgs[i].data[0] = static_cast<uint8_t>(cycle);
+
+        masked_stats().reset();
+        can1.reset_register_accesses();
+        if (batch)
+        {
+            CHECK_EQ(CAN_SendBatch(can1.handle(), msgs, frames, nullptr), frames);
+        }
+        else
+        {
+            for (size_t i = 0; i < frames; ++i)
+                CHECK(CAN_SendMessage(can1.handle(), &msgs[i].header, msgs[i].data) != 0);
+        }
+        const TimingStats& masked = masked_stats();
+        cost.masked_sections += masked.count;
+        cost.masked_ns += masked.total_ns;
+        cost.masked_max_ns = std::max(cost.masked_max_ns, masked.max_ns);
+        cost.register_accesses += can1.register_accesses();
+
+        CHECK(bus.run_until_idle());
+    }
+    CHECK_EQ(peer.received().size(), static_cast<size_t>(frames) * cycles);
+
+    std::printf("%-20s frames/cycle=%zu masked_sections/cycle=%.2f masked_ns/cycle=%.1f masked_ns_max=%llu "
+                "register_accesses/cycle=%.2f\n",
+                label,
+                frames,
+                cycles == 0 ? 0.0 : static_cast<double>(cost.masked_sections) / cycles,
+                cycles == 0 ? 0.0 : static_cast<double>(cost.masked_ns) / cycles,
+                static_cast<unsigned long long>(cost.masked_max_ns),
+                cycles == 0 ? 0.0 : static_cast<double>(cost.register_accesses) / cycles);
+    return cost;
+}
+
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    const uint32_t cycles = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 0)) : 10000U;
+
+    CAN_InitMainCallback(can1.handle());
+    CAN_Start(can1.handle(), 0);
+
+    for (const size_t frames : { static_cast<size_t>(4), static_cast<size_t>(8) })
+    {
+        const CycleCost single = run("CAN_SendMessage x N", frames, cycles, false);
+        const CycleCost batch  = run("CAN_SendBatch", frames, cycles, true);
+        // 关中断次数与寄存器访问次数是确定的：批量发送每周期只关一次中断，且只查询一次邮箱空闲数
+        CHECK_EQ(batch.masked_sections, static_cast<uint64_t>(cycles));
+        CHECK(single.masked_sections >= static_cast<uint64_t>(cycles) * frames);
+        CHECK(batch.register_accesses < single.register_accesses);
+    }
+    return host_test::result();
+}
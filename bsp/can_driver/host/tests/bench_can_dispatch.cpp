@@ -0,0 +1,140 @@
+/**
+ * @file    bench_can_dispatch.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   接收分发基准：广播回调逐个按 StdId 过滤，对比按 ID 表直接分发。
+ *
+ * 同一条总线上挂两个控制器，收到完全相同的帧：
+ * - can_broadcast 注册 CAN_MAX_CALLBACK_NUM 个广播回调，每个回调自己比较 StdId（改造前的用法）；
+ * - can_table 用 CAN_RegisterIdCallback 注册 CAN_MAX_ID_CALLBACK_NUM 个按 ID 分发的回调。
+ *
+ * 每帧统计中断的主机耗时与回调调用次数。前者只打印，后者是确定的：广播每帧调用全部回调，
+ * ID 表每帧只调用一个，且与注册数量无关。
+ *
+ * 用法：can_dispatch_bench [帧数]
+ */
+#include "can_driver.hpp"
+#include "can_sim.hpp"
+#include "host_test.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+using namespace can_sim;
+
+namespace
+{
+
+Bus         bus(1000000);
+BxCan       can_broadcast(bus);
+BxCan       can_table(bus);
+VirtualNode peer(bus);
+
+constexpr uint32_t BASE_ID = 0x201;
+
+// 模拟电机反馈解码
+struct Motor
+{
+    uint32_t id;
+    int32_t  position;
+};
+
+Motor    broadcast_motors[CAN_MAX_CALLBACK_NUM];
+Motor    table_motors[CAN_MAX_ID_CALLBACK_NUM];
+uint64_t broadcast_calls;
+uint64_t table_calls;
+
+void decode(Motor& motor, const uint8_t* data)
+{
+    motor.position = static_cast<int16_t>(data[0] << 8 | data[1]);
+}
+
+// 广播回调不能携带上下文，每个电机一个函数，按下标取对应的电机
+template <size_t N> void on_broadcast(const CAN_HandleTypeDef* /*hcan*/, const CAN_RxHeaderTypeDef* header, const uint8_t* data)
+{
+    ++broadcast_calls;
+    if (header->StdId != broadcast_motors[N].id)
+        return;
+    decode(broadcast_motors[N], data);
+}
+
+template <size_t... N> void register_broadcast(std::index_sequence<N...>)
+{
+    (CAN_RegisterCallback(can_broadcast.handle(), on_broadcast<N>), ...);
+}
+
+void on_id(const CAN_HandleTypeDef* /*hcan*/, const CAN_RxHeaderTypeDef* /*header*/, const uint8_t* data, void* ctx)
+{
+    ++table_calls;
+    decode(*static_cast<Motor*>(ctx), data);
+}
+
+void setup()
+{
+    for (BxCan* can : { &can_broadcast, &can_table })
+    {
+        can->accept_all();
+        CAN_InitMainCallback(can->handle());
+    }
+
+    for (size_t i = 0; i < CAN_MAX_CALLBACK_NUM; ++i)
+        broadcast_motors[i].id = BASE_ID + static_cast<uint32_t>(i);
+    register_broadcast(std::make_index_sequence<CAN_MAX_CALLBACK_NUM>{});
+
+    for (size_t i = 0; i < CAN_MAX_ID_CALLBACK_NUM; ++i)
+    {
+        table_motors[i].id = BASE_ID + static_cast<uint32_t>(i);
+        CHECK(CAN_RegisterIdCallback(can_table.handle(), table_motors[i].id, 0x7FF, on_id, &table_motors[i]));
+    }
+
+    for (BxCan* can : { &can_broadcast, &can_table })
+        CAN_Start(can->handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+}
+
+void report(const char* label, const BxCan& can, const uint64_t calls, const uint32_t frames)
+{
+    const TimingStats& isr = can.isr_stats();
+    std::printf("%-24s frames=%u isr_ns/frame=%.1f isr_ns_max=%llu callbacks/frame=%.2f\n",
+                label,
+                frames,
+                frames == 0 ? 0.0 : static_cast<double>(isr.total_ns) / frames,
+                static_cast<unsigned long long>(isr.max_ns),
+                frames == 0 ? 0.0 : static_cast<double>(calls) / frames);
+}
+
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 0)) : 100000U;
+
+    setup();
+    can_broadcast.reset_isr_stats();
+    can_table.reset_isr_stats();
+
+    // 8 个电机轮流反馈，与 1 kHz 控制周期下的典型总线一致
+    Frame frame{};
+    frame.dlc = 8;
+    for (uint32_t sent = 0; sent < frames;)
+    {
+        for (uint32_t i = 0; i < 64 && sent < frames; ++i, ++sent)
+        {
+            frame.id      = BASE_ID + (sent & 7);
+            frame.data[0] = static_cast<uint8_t>(sent >> 8);
+            frame.data[1] = static_cast<uint8_t>(sent);
+            peer.send(frame);
+        }
+        CHECK(bus.run_until_idle());
+    }
+
+    report("broadcast + StdId filter", can_broadcast, broadcast_calls, frames);
+    report("CAN_RegisterIdCallback", can_table, table_calls, frames);
+
+    // 两种分发解码出的结果相同；回调调用次数分别为每帧全部回调与每帧一个
+    for (size_t i = 0; i < 8; ++i)
+        CHECK_EQ(broadcast_motors[i].position, table_motors[i].position);
+    CHECK_EQ(broadcast_calls, static_cast<uint64_t>(frames) * CAN_MAX_CALLBACK_NUM);
+    CHECK_EQ(table_calls, static_cast<uint64_t>(frames));
+    return host_test::result();
+}
@@ -0,0 +1,118 @@
+/**
+ * @file    bench_can_lock.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   临界区开销基准：驱动临界区关闭全部中断（PRIMASK）与只提升 BASEPRI（CAN_TX_LOCK_PRIORITY）的对比。
+ *
+ * 每个控制周期由线程提交 8 帧（超过 3 个邮箱的部分进入软件队列），再由优先级高于 CAN 的中断发送 1 帧，
+ * 然后让总线发完（发送完成中断中的临界区同样计入）。分别统计：
+ * - PRIMASK 置位的次数与时长：这段时间内高优先级中断同样无法响应。BASEPRI 构建中应为 0（确定的）；
+ * - 任意屏蔽（PRIMASK 或 BASEPRI）的次数与时长（主机时间，只打印）。
+ *
+ * 两种构建都打开 CAN_ENABLE_STATS，时基读取同样经过临界区。
+ *
+ * 用法：can_lock_bench_stats [周期数]，can_lock_bench_lock [周期数]
+ */
+#include "can_driver.hpp"
+#include "can_sim.hpp"
+#include "host_test.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace can_sim;
+
+namespace
+{
+
+Bus         bus(1000000);
+BxCan       can1(bus);
+VirtualNode peer(bus);
+
+// 优先级高于 CAN 的中断（仿真中未设置的中断均为 5）
+constexpr auto HIGH_PRIORITY_IRQn = static_cast<IRQn_Type>(40);
+
+constexpr size_t FRAMES_PER_CYCLE = 8;
+
+CAN_TxHeaderTypeDef std_header(const uint32_t id)
+{
+    CAN_TxHeaderTypeDef header{};
+    header.StdId = id;
+    header.IDE   = CAN_ID_STD;
+    header.RTR   = CAN_RTR_DATA;
+    header.DLC   = 8;
+    return header;
+}
+
+struct LockCost
+{
+    uint64_t primask_sections;
+    uint64_t primask_ns;
+    uint64_t primask_max_ns;
+    uint64_t masked_sections;
+    uint64_t masked_ns;
+};
+
+LockCost run(const uint32_t cycles)
+{
+    LockCost cost{};
+    peer.clear_received();
+    for (uint32_t cycle = 0; cycle < cycles; ++cycle)
+    {
+        masked_stats().reset();
+        primask_stats().reset();
+
+        uint8_t data[8] = { static_cast<uint8_t>(cycle) };
+        for (size_t i = 0; i < FRAMES_PER_CYCLE; ++i)
+        {
+            const CAN_TxHeaderTypeDef header = std_header(0x200 + static_cast<uint32_t>(i));
+            CHECK(CAN_SendMessage(can1.handle(), &header, data) != 0);
+        }
+        call_in_interrupt(HIGH_PRIORITY_IRQn, [&data] {
+            const CAN_TxHeaderTypeDef header = std_header(0x100);
+            CHECK(CAN_SendMessage(can1.handle(), &header, data) != 0);
+        });
+        CHECK(bus.run_until_idle());
+
+        const TimingStats& primask = primask_stats();
+        const TimingStats& masked  = masked_stats();
+        cost.primask_sections += primask.count;
+        cost.primask_ns += primask.total_ns;
+        cost.primask_max_ns = primask.max_ns > cost.primask_max_ns ? primask.max_ns : cost.primask_max_ns;
+        cost.masked_sections += masked.count;
+        cost.masked_ns += masked.total_ns;
+    }
+    CHECK_EQ(peer.received().size(), (FRAMES_PER_CYCLE + 1) * cycles);
+
+    std::printf("%-10s primask_sections/cycle=%.2f primask_ns/cycle=%.1f primask_ns_max=%llu "
+                "masked_sections/cycle=%.2f masked_ns/cycle=%.1f\n",
+                CAN_TX_LOCK_PRIORITY > 0 ? "BASEPRI" : "PRIMASK",
+                cycles == 0 ? 0.0 : static_cast<double>(cost.primask_sections) / cycles,
+                cycles == 0 ? 0.0 : static_cast<double>(cost.primask_ns) / cycles,
+                static_cast<unsigned long long>(cost.primask_max_ns),
+                cycles == 0 ? 0.0 : static_cast<double>(cost.masked_sections) / cycles,
+                cycles == 0 ? 0.0 : static_cast<double>(cost.masked_ns) / cycles);
+    return cost;
+}
+
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    const uint32_t cycles = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 0)) : 10000U;
+
+    NVIC_SetPriority(HIGH_PRIORITY_IRQn, 2);
+    can1.accept_all();
+    CAN_InitMainCallback(can1.handle());
+    CAN_Start(can1.handle(), 0);
+
+    const LockCost cost = run(cycles);
+    // 屏蔽次数是确定的：BASEPRI 构建中高优先级中断从不被驱动屏蔽，PRIMASK 构建中每次提交至少关一次中断
+#if CAN_TX_LOCK_PRIORITY > 0
+    CHECK_EQ(cost.primask_sections, 0U);
+#else
+    CHECK(cost.primask_sections >= static_cast<uint64_t>(cycles) * (FRAMES_PER_CYCLE + 1));
+#endif
+    CHECK(cost.masked_sections >= static_cast<uint64_t>(cycles) * (FRAMES_PER_CYCLE + 1));
+    return host_test::result();
+}
@@ -0,0 +1,97 @@
+/**
+ * @file    bench_can_rx.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   接收中断的逐帧开销基准，分别链接 HAL 路径与 CAN_FAST_PATH 的驱动编译，比较两者的输出。
+ *
+ * 每帧统计两项：HAL_CAN_IRQHandler 的主机耗时，以及中断中经由 SimReg 的外设寄存器访问次数。
+ * 后者与主机无关，目标板上每次访问都要走 APB 总线，是接收中断开销的主要部分。
+ *
+ * CAN_FAST_PATH 版本分别测量经过 HAL_CAN_IRQHandler 分发与直接使用 CAN_RxFifoIRQHandler 两种接法。
+ *
+ * 用法：can_rx_bench_hal [帧数]，can_rx_bench_fast [帧数]
+ */
+#include "can_driver.hpp"
+#include "can_sim.hpp"
+#include "host_test.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace can_sim;
+
+namespace
+{
+
+Bus         bus(1000000);
+BxCan       can1(bus);
+VirtualNode peer(bus);
+
+uint32_t received;
+uint32_t checksum;
+
+void on_receive(const CAN_HandleTypeDef* /*hcan*/, const CAN_RxHeaderTypeDef* header, const uint8_t* data)
+{
+    ++received;
+    checksum += header->StdId + data[0] + data[7];
+}
+
+/**
+ * 让对端背靠背发送 frames 帧（每批 64 帧，接收中断按总线节奏逐帧触发），输出逐帧开销
+ * @return 每帧的寄存器访问次数
+ */
+double run(const char* label, const uint32_t frames)
+{
+    received = 0;
+    can1.reset_isr_stats();
+    can1.reset_register_accesses();
+
+    Frame frame{};
+    frame.dlc = 8;
+    for (uint32_t sent = 0; sent < frames;)
+    {
+        for (uint32_t i = 0; i < 64 && sent < frames; ++i, ++sent)
+        {
+            frame.id      = 0x100 + (sent & 0xFF);
+            frame.data[0] = static_cast<uint8_t>(sent);
+            frame.data[7] = static_cast<uint8_t>(sent >> 8);
+            peer.send(frame);
+        }
+        CHECK(bus.run_until_idle());
+    }
+    CHECK_EQ(received, frames);
+
+    const TimingStats& isr      = can1.isr_stats();
+    const double       accesses = frames == 0 ? 0.0 : static_cast<double>(can1.register_accesses()) / frames;
+    std::printf("%-40s frames=%u isr_calls=%llu isr_ns/frame=%.1f register_accesses/frame=%.2f\n",
+                label,
+                frames,
+                static_cast<unsigned long long>(isr.count),
+                frames == 0 ? 0.0 : static_cast<double>(isr.total_ns) / frames,
+                accesses);
+    return accesses;
+}
+
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 0)) : 100000U;
+
+    can1.accept_all();
+    CAN_InitMainCallback(can1.handle());
+    CAN_RegisterCallback(can1.handle(), on_receive);
+    CAN_Start(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+
+#if CAN_FAST_PATH
+    const double via_hal = run("FAST_PATH + HAL_CAN_IRQHandler", frames);
+    can1.set_irq_handler(CAN1_RX0_IRQn, [] { CAN_RxFifoIRQHandler(can1.handle(), CAN_RX_FIFO0); });
+    const double direct = run("FAST_PATH + CAN_RxFifoIRQHandler", frames);
+    // 寄存器访问次数是确定的，直接入口必须比经过 HAL 中断分发少
+    CHECK(direct < via_hal);
+#else
+    (void) run("HAL", frames);
+#endif
+    std::printf("checksum %u\n", checksum);
+    return host_test::result();
+}
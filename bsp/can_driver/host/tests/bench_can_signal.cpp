@@ -0,0 +1,104 @@
+/**
+ * @file    bench_can_signal.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   can_signal::Message 整帧解码与手写移位解码的逐帧耗时对比。
+ *
+ * 两种解码对同一批随机帧各跑若干遍，结果必须逐字段一致；耗时只打印不断言。
+ *
+ * 用法：can_signal_bench [遍数]
+ */
+#include "can_signal.hpp"
+#include "host_test.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace can_signal;
+
+namespace
+{
+
+struct Feedback
+{
+    uint16_t angle;
+    int16_t  rpm;
+    float    current;
+    uint8_t  temperature;
+};
+
+using FeedbackFrame =
+    Message<Field<&Feedback::angle, Signal<7, 16, ByteOrder::Motorola>>,
+            Field<&Feedback::rpm, Signal<23, 16, ByteOrder::Motorola, true>>,
+            Field<&Feedback::current, Signal<39, 16, ByteOrder::Motorola, true, std::ratio<20, 16384>>>,
+            Field<&Feedback::temperature, Signal<55, 8, ByteOrder::Motorola>>>;
+
+struct Frame
+{
+    uint8_t data[8];
+};
+
+// 不内联，两边都付出一次调用开销，比较的是解码本身
+__attribute__((noinline)) void decode_by_hand(const uint8_t* data, Feedback& fb)
+{
+    fb.angle       = static_cast<uint16_t>(data[0] << 8 | data[1]);
+    fb.rpm         = static_cast<int16_t>(data[2] << 8 | data[3]);
+    fb.current     = static_cast<float>(static_cast<int16_t>(data[4] << 8 | data[5])) * (20.0f / 16384.0f);
+    fb.temperature = data[6];
+}
+
+__attribute__((noinline)) void decode_by_message(const uint8_t* data, Feedback& fb)
+{
+    FeedbackFrame::unpack(data, fb);
+}
+
+template <typename Decode> double run(const char* label, const std::vector<Frame>& frames, uint32_t passes, Decode decode)
+{
+    Feedback fb{};
+    uint64_t sum   = 0;
+    const auto t0  = std::chrono::steady_clock::now();
+    for (uint32_t p = 0; p < passes; ++p)
+        for (const Frame& f : frames)
+        {
+            decode(f.data, fb);
+            sum += fb.angle + static_cast<uint16_t>(fb.rpm) + static_cast<uint64_t>(fb.current * 16) + fb.temperature;
+        }
+    const auto   t1 = std::chrono::steady_clock::now();
+    const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / (static_cast<double>(passes) * frames.size());
+    std::printf("%-24s ns/frame=%.2f checksum=%llu\n", label, ns, static_cast<unsigned long long>(sum));
+    return ns;
+}
+
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    const uint32_t passes = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 0)) : 10000U;
+
+    std::vector<Frame> frames(1024);
+    std::mt19937       rng(3);
+    for (Frame& f : frames)
+        for (auto& b : f.data)
+            b = static_cast<uint8_t>(rng());
+
+    // 先核对结果，再计时
+    for (const Frame& f : frames)
+    {
+        Feedback a{};
+        Feedback b{};
+        decode_by_hand(f.data, a);
+        decode_by_message(f.data, b);
+        CHECK_EQ(a.angle, b.angle);
+        CHECK_EQ(a.rpm, b.rpm);
+        CHECK(a.current == b.current);
+        CHECK_EQ(a.temperature, b.temperature);
+    }
+
+    const double hand    = run("hand-written", frames, passes, decode_by_hand);
+    const double message = run("can_signal::Message", frames, passes, decode_by_message);
+    std::printf("ratio message/hand=%.2f\n", hand > 0 ? message / hand : 0.0);
+    return host_test::result();
+}
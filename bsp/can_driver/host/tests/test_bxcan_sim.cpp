@@ -0,0 +1,471 @@
+/**
+ * @file    test_bxcan_sim.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   bxCAN 仿真本身的测试：只经 HAL_CAN_* 访问，验证帧时序、仲裁、FIFO、过滤器、错误处理与中断模型。
+ */
+#include "can_sim.hpp"
+#include "cmsis_compiler.h"
+#include "host_test.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+using namespace can_sim;
+
+namespace
+{
+
+CAN_TxHeaderTypeDef std_header(const uint32_t id, const uint32_t dlc = 8)
+{
+    CAN_TxHeaderTypeDef header{};
+    header.StdId = id;
+    header.IDE   = CAN_ID_STD;
+    header.RTR   = CAN_RTR_DATA;
+    header.DLC   = dlc;
+    return header;
+}
+
+uint32_t add_tx(BxCan& can, const uint32_t id, const uint8_t fill = 0)
+{
+    const CAN_TxHeaderTypeDef header  = std_header(id);
+    uint8_t                   data[8] = { fill, fill, fill, fill, fill, fill, fill, fill };
+    uint32_t                  mailbox = 0;
+    CHECK(HAL_CAN_AddTxMessage(can.handle(), &header, data, &mailbox) == HAL_OK);
+    return mailbox;
+}
+
+std::vector<Transfer> transfers;
+
+void record(const Transfer& transfer)
+{
+    transfers.push_back(transfer);
+}
+
+void test_frame_bits()
+{
+    Frame frame;
+    frame.dlc = 8;
+    // 无填充时 8 字节标准帧为 111 位（含 3 位帧间隔），最坏填充不超过 24 位
+    for (const uint8_t fill : { 0x00, 0x55, 0xAA, 0xFF })
+    {
+        for (uint32_t id : { 0x000U, 0x123U, 0x555U, 0x7FFU })
+        {
+            frame.id = id;
+            std::fill(std::begin(frame.data), std::end(frame.data), fill);
+            const uint32_t bits = frame_bits(frame);
+            CHECK(bits >= 111 && bits <= 111 + 24);
+        }
+    }
+    // 全 0 数据每 5 位就要填充一位，交替数据不需要填充
+    frame.id = 0x555;
+    std::fill(std::begin(frame.data), std::end(frame.data), 0x00);
+    const uint32_t zeros = frame_bits(frame);
+    std::fill(std::begin(frame.data), std::end(frame.data), 0x55);
+    CHECK(zeros > frame_bits(frame) + 10);
+
+    Frame ext     = frame;
+    ext.ext       = true;
+    ext.id        = 0x1ABCDEF;
+    CHECK(frame_bits(ext) >= 131);
+}
+
+void test_transfer_and_timing()
+{
+    Bus   bus(1000000);
+    BxCan a(bus), b(bus);
+    b.accept_all();
+    CHECK(HAL_CAN_Start(a.handle()) == HAL_OK);
+    CHECK(HAL_CAN_Start(b.handle()) == HAL_OK);
+    transfers.clear();
+    bus.set_monitor(record);
+
+    const uint64_t start = now_ns();
+    add_tx(a, 0x123, 0x5A);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(transfers.size(), 1U);
+    CHECK(transfers[0].result == Transfer::Result::Ok);
+    // 1 Mbit/s 下每位 1 µs，帧结束时间等于帧位数
+    CHECK_EQ(transfers[0].end_ns - start, frame_bits(transfers[0].frame) * 1000ULL);
+
+    CHECK_EQ(HAL_CAN_GetRxFifoFillLevel(b.handle(), CAN_RX_FIFO0), 1U);
+    CAN_RxHeaderTypeDef header{};
+    uint8_t             data[8]{};
+    CHECK(HAL_CAN_GetRxMessage(b.handle(), CAN_RX_FIFO0, &header, data) == HAL_OK);
+    CHECK_EQ(header.StdId, 0x123U);
+    CHECK_EQ(header.DLC, 8U);
+    CHECK_EQ(data[7], 0x5A);
+    CHECK_EQ(HAL_CAN_GetRxFifoFillLevel(b.handle(), CAN_RX_FIFO0), 0U);
+
+    // 发送成功后 RQCP / TXOK 置位，直到软件清除
+    CHECK((a.instance()->TSR & (CAN_TSR_RQCP0 | CAN_TSR_TXOK0)) == (CAN_TSR_RQCP0 | CAN_TSR_TXOK0));
+    a.instance()->TSR = CAN_TSR_RQCP0;
+    CHECK((a.instance()->TSR & CAN_TSR_RQCP0) == 0);
+}
+
+void test_mailbox_priority()
+{
+    Bus   bus(1000000);
+    BxCan a(bus), b(bus);
+    b.accept_all();
+    HAL_CAN_Start(a.handle());
+    HAL_CAN_Start(b.handle());
+    transfers.clear();
+    bus.set_monitor(record);
+
+    // TXFP = 0：按 ID 发送
+    add_tx(a, 0x300);
+    add_tx(a, 0x100);
+    add_tx(a, 0x200);
+    CHECK_EQ(HAL_CAN_GetTxMailboxesFreeLevel(a.handle()), 0U);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(transfers.size(), 3U);
+    CHECK_EQ(transfers[0].frame.id, 0x100U);
+    CHECK_EQ(transfers[1].frame.id, 0x200U);
+    CHECK_EQ(transfers[2].frame.id, 0x300U);
+
+    // TXFP = 1：按请求顺序发送
+    HAL_CAN_Stop(a.handle());
+    a.handle()->Init.TransmitFifoPriority = ENABLE;
+    HAL_CAN_Init(a.handle());
+    HAL_CAN_Start(a.handle());
+    transfers.clear();
+    add_tx(a, 0x300);
+    add_tx(a, 0x100);
+    add_tx(a, 0x200);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(transfers.size(), 3U);
+    CHECK_EQ(transfers[0].frame.id, 0x300U);
+    CHECK_EQ(transfers[1].frame.id, 0x100U);
+    CHECK_EQ(transfers[2].frame.id, 0x200U);
+}
+
+void test_bus_arbitration()
+{
+    Bus         bus(500000);
+    BxCan       a(bus);
+    VirtualNode peer(bus);
+    HAL_CAN_Start(a.handle());
+    transfers.clear();
+    bus.set_monitor(record);
+
+    // 同一时刻请求发送的帧按 ID 竞争，标准帧优先于基本 ID 相同的扩展帧
+    Frame ext;
+    ext.ext = true;
+    ext.id  = 0x100U << 18;
+    peer.send(ext);
+    Frame low;
+    low.id = 0x050;
+    peer.send(low);
+    add_tx(a, 0x100);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(transfers.size(), 3U);
+    CHECK(!transfers[0].frame.ext);
+    CHECK_EQ(transfers[0].frame.id, 0x100U);
+    CHECK(transfers[1].frame.ext);
+    CHECK_EQ(transfers[2].frame.id, 0x050U);
+    CHECK_EQ(peer.received().size(), 1U);
+    // 500 kbit/s 下每位 2 µs
+    CHECK_EQ(transfers[0].end_ns - transfers[0].sof_ns, frame_bits(transfers[0].frame) * 2000ULL);
+}
+
+void test_fifo_overrun()
+{
+    for (const bool locked : { false, true })
+    {
+        Bus         bus(1000000);
+        BxCan       a(bus);
+        VirtualNode peer(bus);
+        a.handle()->Init.ReceiveFifoLocked = locked ? ENABLE : DISABLE;
+        HAL_CAN_Init(a.handle());
+        a.accept_all();
+        HAL_CAN_Start(a.handle());
+
+        for (uint8_t i = 0; i < 5; ++i)
+        {
+            Frame frame;
+            frame.id      = 0x10 + i;
+            frame.dlc     = 1;
+            frame.data[0] = i;
+            peer.send(frame);
+        }
+        CHECK(bus.run_until_idle());
+        CHECK_EQ(a.instance()->RF0R & (CAN_RF0R_FMP0 | CAN_RF0R_FULL0 | CAN_RF0R_FOVR0),
+                 3U | CAN_RF0R_FULL0 | CAN_RF0R_FOVR0);
+        CHECK_EQ(a.rx_overruns(0), 2U);
+
+        // RFLM = 0 时最后一帧被新帧覆盖，RFLM = 1 时丢弃新帧
+        CAN_RxHeaderTypeDef header{};
+        uint8_t             data[8]{};
+        HAL_CAN_GetRxMessage(a.handle(), CAN_RX_FIFO0, &header, data);
+        CHECK_EQ(header.StdId, 0x10U);
+        // HAL 用读-改-写释放邮箱，FULL / FOVR 被一并清除
+        CHECK_EQ(a.instance()->RF0R & (CAN_RF0R_FULL0 | CAN_RF0R_FOVR0), 0U);
+        HAL_CAN_GetRxMessage(a.handle(), CAN_RX_FIFO0, &header, data);
+        HAL_CAN_GetRxMessage(a.handle(), CAN_RX_FIFO0, &header, data);
+        CHECK_EQ(header.StdId, locked ? 0x12U : 0x14U);
+    }
+}
+
+void test_filter_match_index()
+{
+    Bus         bus(1000000);
+    BxCan       a(bus);
+    VirtualNode peer(bus);
+
+    // 组 0：FIFO1 的 32 位 mask；组 1：FIFO0 的 16 位 list；组 2：FIFO0 的 32 位 list
+    CAN_FilterTypeDef filter{};
+    filter.FilterBank           = 0;
+    filter.FilterMode           = CAN_FILTERMODE_IDMASK;
+    filter.FilterScale          = CAN_FILTERSCALE_32BIT;
+    filter.FilterIdHigh         = 0x200 << 5;
+    filter.FilterMaskIdHigh     = 0x700 << 5;
+    filter.FilterFIFOAssignment = CAN_FILTER_FIFO1;
+    filter.FilterActivation     = CAN_FILTER_ENABLE;
+    CHECK(HAL_CAN_ConfigFilter(a.handle(), &filter) == HAL_OK);
+
+    filter                      = {};
+    filter.FilterBank           = 1;
+    filter.FilterMode           = CAN_FILTERMODE_IDLIST;
+    filter.FilterScale          = CAN_FILTERSCALE_16BIT;
+    filter.FilterIdLow          = 0x101 << 5;
+    filter.FilterMaskIdLow      = 0x102 << 5;
+    filter.FilterIdHigh         = 0x103 << 5;
+    filter.FilterMaskIdHigh     = 0x104 << 5;
+    filter.FilterFIFOAssignment = CAN_FILTER_FIFO0;
+    filter.FilterActivation     = CAN_FILTER_ENABLE;
+    CHECK(HAL_CAN_ConfigFilter(a.handle(), &filter) == HAL_OK);
+
+    filter                      = {};
+    filter.FilterBank           = 2;
+    filter.FilterMode           = CAN_FILTERMODE_IDLIST;
+    filter.FilterScale          = CAN_FILTERSCALE_32BIT;
+    filter.FilterIdHigh         = 0x104 << 5;
+    filter.FilterMaskIdHigh     = 0x105 << 5;
+    filter.FilterFIFOAssignment = CAN_FILTER_FIFO0;
+    filter.FilterActivation     = CAN_FILTER_ENABLE;
+    CHECK(HAL_CAN_ConfigFilter(a.handle(), &filter) == HAL_OK);
+    HAL_CAN_Start(a.handle());
+
+    struct
+    {
+        uint32_t id, fifo, fmi;
+    } cases[] = {
+        { 0x2AB, 1, 0 }, // 组 0 是 FIFO1 的第一个过滤器
+        { 0x101, 0, 0 }, // 组 1：FIFO0 的 0..3
+        { 0x103, 0, 2 },
+        { 0x104, 0, 4 }, // 同时命中 16 位 list 的 3 号与 32 位 list 的 4 号，32 位优先
+        { 0x105, 0, 5 },
+    };
+    for (const auto& c : cases)
+    {
+        Frame frame;
+        frame.id = c.id;
+        peer.send(frame);
+        CHECK(bus.run_until_idle());
+        CHECK_EQ(HAL_CAN_GetRxFifoFillLevel(a.handle(), c.fifo), 1U);
+        CAN_RxHeaderTypeDef header{};
+        uint8_t             data[8];
+        HAL_CAN_GetRxMessage(a.handle(), c.fifo, &header, data);
+        CHECK_EQ(header.StdId, c.id);
+        CHECK_EQ(header.FilterMatchIndex, c.fmi);
+    }
+
+    // 不匹配的帧仍会被应答，但不进入 FIFO
+    Frame other;
+    other.id = 0x000;
+    peer.send(other);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(HAL_CAN_GetRxFifoFillLevel(a.handle(), CAN_RX_FIFO0), 0U);
+    CHECK_EQ(bus.error_frames(), 0U);
+}
+
+uint32_t                rx_calls;
+std::vector<IRQn_Type>  rx_ipsr;
+
+void count_rx(CAN_HandleTypeDef* hcan)
+{
+    ++rx_calls;
+    rx_ipsr.push_back(static_cast<IRQn_Type>(static_cast<int32_t>(__get_IPSR()) - 16));
+    CAN_RxHeaderTypeDef header{};
+    uint8_t             data[8];
+    while (HAL_CAN_GetRxFifoFillLevel(hcan, CAN_RX_FIFO0) > 0)
+        HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &header, data);
+}
+
+void test_interrupt_masking()
+{
+    Bus         bus(1000000);
+    BxCan       a(bus);
+    VirtualNode peer(bus);
+    a.accept_all();
+    HAL_CAN_RegisterCallback(a.handle(), HAL_CAN_RX_FIFO0_MSG_PENDING_CB_ID, count_rx);
+    HAL_CAN_Start(a.handle());
+    HAL_CAN_ActivateNotification(a.handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+    rx_calls = 0;
+    rx_ipsr.clear();
+
+    Frame frame;
+    frame.id = 0x42;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(rx_calls, 1U);
+    CHECK_EQ(rx_ipsr[0], CAN1_RX0_IRQn);
+    CHECK_EQ(__get_IPSR(), 0U);
+
+    // 关中断期间到达的帧在开中断时立即处理
+    __disable_irq();
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(rx_calls, 1U);
+    __enable_irq();
+    CHECK_EQ(rx_calls, 2U);
+
+    // BASEPRI 只屏蔽优先级不高于它的中断
+    NVIC_SetPriority(CAN1_RX0_IRQn, 5);
+    __set_BASEPRI(6 << 4);
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(rx_calls, 3U);
+    __set_BASEPRI(5 << 4);
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(rx_calls, 3U);
+    __set_BASEPRI(0);
+    CHECK_EQ(rx_calls, 4U);
+    CHECK(masked_stats().count >= 2);
+}
+
+uint32_t error_codes;
+
+void record_error(CAN_HandleTypeDef* hcan)
+{
+    error_codes |= hcan->ErrorCode;
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+}
+
+void test_ack_error_passive()
+{
+    // 总线上没有其他节点应答：TEC 每次 + 8，到 error passive 后 ACK 错误不再增加 TEC，不会 bus-off
+    Bus   bus(1000000);
+    BxCan a(bus);
+    HAL_CAN_RegisterCallback(a.handle(), HAL_CAN_ERROR_CB_ID, record_error);
+    HAL_CAN_Start(a.handle());
+    HAL_CAN_ActivateNotification(a.handle(), CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF | CAN_IT_ERROR);
+    error_codes = 0;
+
+    add_tx(a, 0x100);
+    bus.run_for(10000000);
+    CHECK_EQ(a.tec(), 128U);
+    CHECK(!a.bus_off());
+    CHECK((a.instance()->ESR & (CAN_ESR_EWGF | CAN_ESR_EPVF)) == (CAN_ESR_EWGF | CAN_ESR_EPVF));
+    CHECK_EQ((a.instance()->ESR & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos, 3U);
+    CHECK((error_codes & (HAL_CAN_ERROR_EWG | HAL_CAN_ERROR_EPV)) == (HAL_CAN_ERROR_EWG | HAL_CAN_ERROR_EPV));
+    CHECK_EQ(HAL_CAN_GetTxMailboxesFreeLevel(a.handle()), 2U);
+
+    // 中止正在重发的邮箱：当前这次尝试结束后邮箱变空，RQCP 置位而 TXOK 不置位
+    HAL_CAN_AbortTxRequest(a.handle(), CAN_TX_MAILBOX0);
+    bus.run_for(1000000);
+    CHECK_EQ(HAL_CAN_GetTxMailboxesFreeLevel(a.handle()), 3U);
+    CHECK((a.instance()->TSR & (CAN_TSR_RQCP0 | CAN_TSR_TXOK0)) == CAN_TSR_RQCP0);
+}
+
+void test_bus_off_recovery()
+{
+    for (const bool automatic : { false, true })
+    {
+        Bus         bus(1000000);
+        BxCan       a(bus);
+        VirtualNode peer(bus);
+        a.handle()->Init.AutoBusOff = automatic ? ENABLE : DISABLE;
+        HAL_CAN_Init(a.handle());
+        HAL_CAN_Start(a.handle());
+
+        a.inject_tx_errors(32);
+        add_tx(a, 0x100);
+        for (int i = 0; i < 10000 && !a.bus_off(); ++i)
+            bus.run_for(1000);
+        CHECK(a.bus_off());
+        CHECK((a.instance()->ESR & CAN_ESR_BOFF) != 0);
+        CHECK_EQ(peer.received().size(), 0U);
+
+        if (!automatic)
+        {
+            // ABOM = 0：不经软件处理一直保持 bus-off
+            bus.run_for(100000000);
+            CHECK(a.bus_off());
+            HAL_CAN_Stop(a.handle());
+            HAL_CAN_Start(a.handle());
+        }
+        const uint64_t off_at = now_ns();
+
+        // 128 × 11 个隐性位后恢复，待发送的帧随后发出
+        CHECK(bus.run_until_idle(10000000));
+        CHECK(!a.bus_off());
+        CHECK_EQ(a.tec(), 0U);
+        CHECK_EQ(peer.received().size(), 1U);
+        CHECK(!peer.received().empty() && peer.received()[0].sof_ns - off_at >= 128 * 11 * 1000ULL - 1000);
+    }
+}
+
+void test_bitrate_mismatch()
+{
+    // 波特率不一致的节点既不应答也收不到帧
+    Bus         bus(1000000);
+    BxCan       a(bus), b(bus);
+    VirtualNode peer(bus);
+    b.handle()->Init.Prescaler = 6;
+    HAL_CAN_Init(b.handle());
+    a.accept_all();
+    b.accept_all();
+    HAL_CAN_Start(a.handle());
+    HAL_CAN_Start(b.handle());
+
+    Frame frame;
+    frame.id = 0x1;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(HAL_CAN_GetRxFifoFillLevel(a.handle(), CAN_RX_FIFO0), 1U);
+    CHECK_EQ(HAL_CAN_GetRxFifoFillLevel(b.handle(), CAN_RX_FIFO0), 0U);
+
+    // b 发送时出现位错误，直到 bus-off
+    add_tx(b, 0x10);
+    bus.run_for(5000000);
+    CHECK(b.bus_off());
+    CHECK_EQ(HAL_CAN_GetRxFifoFillLevel(a.handle(), CAN_RX_FIFO0), 1U);
+}
+
+void test_loopback()
+{
+    Bus   bus(1000000);
+    BxCan a(bus);
+    a.handle()->Init.Mode = CAN_MODE_LOOPBACK;
+    HAL_CAN_Init(a.handle());
+    a.accept_all();
+    HAL_CAN_Start(a.handle());
+
+    // 环回模式不需要应答，收到自己发送的帧
+    add_tx(a, 0x77, 0x11);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(a.tec(), 0U);
+    CHECK_EQ(HAL_CAN_GetRxFifoFillLevel(a.handle(), CAN_RX_FIFO0), 1U);
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_frame_bits);
+    RUN_TEST(test_transfer_and_timing);
+    RUN_TEST(test_mailbox_priority);
+    RUN_TEST(test_bus_arbitration);
+    RUN_TEST(test_fifo_overrun);
+    RUN_TEST(test_filter_match_index);
+    RUN_TEST(test_interrupt_masking);
+    RUN_TEST(test_ack_error_passive);
+    RUN_TEST(test_bus_off_recovery);
+    RUN_TEST(test_bitrate_mismatch);
+    RUN_TEST(test_loopback);
+    return host_test::result();
+}
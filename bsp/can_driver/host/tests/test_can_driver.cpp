@@ -0,0 +1,938 @@
+/**
+ * @file    test_can_driver.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   can_driver 在 bxCAN 仿真上的基本收发、发送队列丢弃策略、发送限速、接收帧池、接收时间戳与最新值缓存测试，分别以 HAL 路径、CAN_FAST_PATH、全部可选功能打开
+ *          与 CAN_TX_LOCK_PRIORITY 的配置编译。
+ */
+#include "can_driver.hpp"
+#include "can_sim.hpp"
+#include "cmsis_compiler.h"
+#include "host_test.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace can_sim;
+
+namespace
+{
+
+// 驱动的回调表是全局的，整个测试程序共用一条总线和一个控制器
+Bus         bus(1000000);
+BxCan       can1(bus);
+VirtualNode peer(bus);
+
+std::vector<uint32_t> received_ids;
+
+void on_receive(const CAN_HandleTypeDef* hcan, const CAN_RxHeaderTypeDef* header, const uint8_t* data)
+{
+    (void) hcan;
+    (void) data;
+    received_ids.push_back(header->IDE == CAN_ID_STD ? header->StdId : header->ExtId);
+}
+
+struct TxResult
+{
+    CAN_TxTicket ticket;
+    CAN_TxStatus status;
+};
+std::vector<TxResult> tx_results;
+
+void on_tx_complete(const CAN_HandleTypeDef* hcan, const CAN_TxTicket ticket, const CAN_TxStatus status, void* ctx)
+{
+    (void) hcan;
+    (void) ctx;
+    tx_results.push_back({ ticket, status });
+}
+
+CAN_TxHeaderTypeDef std_header(const uint32_t id)
+{
+    CAN_TxHeaderTypeDef header{};
+    header.StdId = id;
+    header.IDE   = CAN_ID_STD;
+    header.RTR   = CAN_RTR_DATA;
+    header.DLC   = 8;
+    return header;
+}
+
+void poll_rx()
+{
+#if CAN_ENABLE_RX_DEFERRED
+    (void) CAN_Poll(can1.handle(), 0);
+#endif
+}
+
+void setup()
+{
+    can1.accept_all();
+    CAN_InitMainCallback(can1.handle());
+    CAN_RegisterCallback(can1.handle(), on_receive);
+    CAN_SetTxCompleteCallback(can1.handle(), on_tx_complete, nullptr);
+    CAN_Start(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+}
+
+void test_send_and_receive()
+{
+    peer.clear_received();
+    received_ids.clear();
+
+    const CAN_TxHeaderTypeDef header  = std_header(0x123);
+    const uint8_t             data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    CAN_TxTicket              ticket  = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendMessage(can1.handle(), &header, data, &ticket) != 0);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 1U);
+    CHECK_EQ(peer.received()[0].frame.id, 0x123U);
+    CHECK_EQ(peer.received()[0].frame.data[7], 8);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+
+    Frame frame;
+    frame.id  = 0x321;
+    frame.dlc = 2;
+    peer.send(frame);
+    frame.id  = 0x1234567;
+    frame.ext = true;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    poll_rx();
+    CHECK_EQ(received_ids.size(), 2U);
+    CHECK_EQ(received_ids[0], 0x321U);
+    CHECK_EQ(received_ids[1], 0x1234567U);
+}
+
+void test_queue_priority_order()
+{
+    peer.clear_received();
+    tx_results.clear();
+
+    // 前 3 帧直接装入邮箱，之后的帧在软件队列中按 ID 排序，ID 依次减小
+    std::vector<CAN_TxTicket> tickets;
+    for (uint32_t i = 0; i < CAN_TX_QUEUE_SIZE + 3; ++i)
+    {
+        const CAN_TxHeaderTypeDef header  = std_header(0x400 - i * 0x10);
+        const uint8_t             data[8] = { static_cast<uint8_t>(i) };
+        CAN_TxTicket              ticket  = CAN_TX_TICKET_INVALID;
+        CHECK(CAN_SendMessage(can1.handle(), &header, data, &ticket) != 0);
+        tickets.push_back(ticket);
+    }
+    CHECK(bus.run_until_idle());
+
+    const auto& rx = peer.received();
+    CHECK_EQ(rx.size(), static_cast<size_t>(CAN_TX_QUEUE_SIZE + 3));
+    // 邮箱中 ID 最小的帧先发出，此后空出的邮箱由队列补入更高优先级的帧，总线上始终按 ID 升序
+    CHECK_EQ(rx[0].frame.id, 0x400U - 2 * 0x10);
+    for (size_t i = 2; i < rx.size(); ++i)
+        CHECK(rx[i - 1].frame.id < rx[i].frame.id);
+
+    CHECK_EQ(tx_results.size(), tickets.size());
+    for (const CAN_TxTicket ticket : tickets)
+        CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+}
+
+// 第一帧发完时发送完成中断被屏蔽，此时再发送会复用刚空出的邮箱：旧票据必须先按 SENT 结束，
+// 解除屏蔽后迟到的完成中断不能把新帧当作已发完
+void test_reuse_mailbox_with_masked_irq()
+{
+    peer.clear_received();
+    tx_results.clear();
+
+    const CAN_TxHeaderTypeDef first   = std_header(0x100);
+    const CAN_TxHeaderTypeDef second  = std_header(0x200);
+    const uint8_t             data[8] = {};
+    CAN_TxTicket              a       = CAN_TX_TICKET_INVALID;
+    CAN_TxTicket              b       = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendMessage(can1.handle(), &first, data, &a) != 0);
+
+    __disable_irq();
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 1U);
+    CHECK(CAN_SendMessage(can1.handle(), &second, data, &b) != 0);
+    // 旧票据在发送时结束；新帧还在邮箱中
+    CHECK(CAN_GetTxStatus(can1.handle(), a) == CAN_TX_STATUS_SENT);
+    CHECK(CAN_GetTxStatus(can1.handle(), b) == CAN_TX_STATUS_PENDING);
+    __enable_irq();
+    CHECK(CAN_GetTxStatus(can1.handle(), b) == CAN_TX_STATUS_PENDING);
+
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 2U);
+    CHECK(CAN_GetTxStatus(can1.handle(), b) == CAN_TX_STATUS_SENT);
+    CHECK_EQ(tx_results.size(), 2U);
+    if (tx_results.size() == 2)
+    {
+        CHECK_EQ(tx_results[0].ticket, a);
+        CHECK_EQ(tx_results[1].ticket, b);
+        CHECK(tx_results[0].status == CAN_TX_STATUS_SENT);
+        CHECK(tx_results[1].status == CAN_TX_STATUS_SENT);
+    }
+}
+
+#if CAN_TX_LOCK_PRIORITY > 0
+// 优先级高于 CAN 的中断（仿真中未设置的中断均为 5）
+constexpr auto HIGH_PRIORITY_IRQn = static_cast<IRQn_Type>(40);
+
+struct LockedSend
+{
+    CAN_TxTicket trigger{ CAN_TX_TICKET_INVALID };
+    bool         in_thread{ false };
+    uint32_t     result{ CAN_SEND_FAILED };
+    CAN_TxTicket ticket{ CAN_TX_TICKET_INVALID };
+} locked_send;
+
+// trigger 结束时以高优先级中断的身份发送一帧
+void send_from_high_priority_isr(const CAN_HandleTypeDef* hcan,
+                                 const CAN_TxTicket       ticket,
+                                 const CAN_TxStatus       status,
+                                 void*                    ctx)
+{
+    on_tx_complete(hcan, ticket, status, ctx);
+    if (ticket != locked_send.trigger)
+        return;
+    locked_send.in_thread = !in_interrupt();
+    call_in_interrupt(HIGH_PRIORITY_IRQn, [] {
+        const CAN_TxHeaderTypeDef header  = std_header(0x300);
+        const uint8_t             data[8] = {};
+        locked_send.result                = CAN_SendMessage(can1.handle(), &header, data, &locked_send.ticket);
+    });
+}
+
+// 线程持有 tx_lock 时高优先级中断发送：帧经提交队列转交，线程释放锁时装入邮箱
+void test_isr_send_while_lock_held()
+{
+    peer.clear_received();
+    tx_results.clear();
+    locked_send = LockedSend{};
+    NVIC_SetPriority(HIGH_PRIORITY_IRQn, 2);
+    CAN_SetTxCompleteCallback(can1.handle(), send_from_high_priority_isr, nullptr);
+
+    // 发送完成中断被 BASEPRI 屏蔽，第一帧由下一次发送在持锁的线程中结束，结束回调也在其中执行
+    const CAN_TxHeaderTypeDef first   = std_header(0x100);
+    const CAN_TxHeaderTypeDef second  = std_header(0x200);
+    const uint8_t             data[8] = {};
+    CAN_TxTicket              b       = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendMessage(can1.handle(), &first, data, &locked_send.trigger) != 0);
+    __set_BASEPRI(CAN_TX_LOCK_PRIORITY << (8U - __NVIC_PRIO_BITS));
+    CHECK(bus.run_until_idle());
+    CHECK(CAN_SendMessage(can1.handle(), &second, data, &b) != 0);
+    __set_BASEPRI(0);
+
+    CHECK(locked_send.in_thread);
+    CHECK_EQ(locked_send.result, static_cast<uint32_t>(CAN_SEND_QUEUED));
+    CHECK(locked_send.ticket != CAN_TX_TICKET_INVALID);
+    CHECK(CAN_GetTxStatus(can1.handle(), locked_send.ticket) == CAN_TX_STATUS_PENDING);
+
+    CHECK(bus.run_until_idle());
+    const auto& rx = peer.received();
+    CHECK_EQ(rx.size(), 3U);
+    if (rx.size() == 3)
+    {
+        CHECK_EQ(rx[0].frame.id, 0x100U);
+        CHECK_EQ(rx[1].frame.id, 0x200U);
+        CHECK_EQ(rx[2].frame.id, 0x300U);
+    }
+    CHECK_EQ(tx_results.size(), 3U);
+    CHECK(CAN_GetTxStatus(can1.handle(), b) == CAN_TX_STATUS_SENT);
+    CHECK(CAN_GetTxStatus(can1.handle(), locked_send.ticket) == CAN_TX_STATUS_SENT);
+
+    CAN_SetTxCompleteCallback(can1.handle(), on_tx_complete, nullptr);
+}
+#endif
+
+#if CAN_ENABLE_STATS
+// 一次提交 5 帧，后 2 帧在队列中等待：延迟从提交算起，到各自在总线上发完为止
+void test_tx_latency_stats()
+{
+    peer.clear_received();
+    CAN_ResetStats(can1.handle());
+
+    const uint64_t submit_ns = now_ns();
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        const CAN_TxHeaderTypeDef header  = std_header(0x100 + i);
+        const uint8_t             data[8] = {};
+        CHECK(CAN_SendMessage(can1.handle(), &header, data) != 0);
+    }
+    CHECK(bus.run_until_idle());
+
+    const auto& rx = peer.received();
+    CHECK_EQ(rx.size(), 5U);
+    uint64_t max_ns = 0, total_ns = 0;
+    for (const auto& r : rx)
+    {
+        max_ns = std::max(max_ns, r.end_ns - submit_ns);
+        total_ns += r.end_ns - submit_ns;
+    }
+
+    CAN_Stats stats{};
+    CHECK(CAN_GetStats(can1.handle(), &stats));
+    std::printf("tx latency max=%u us avg=%u us (bus: max=%llu us avg=%llu us)\n",
+                stats.tx_latency_us_max,
+                stats.tx_latency_us_avg,
+                static_cast<unsigned long long>(max_ns / 1000),
+                static_cast<unsigned long long>(total_ns / rx.size() / 1000));
+    // 发送完成中断在帧结束后才处理，时基精度 1 us
+    CHECK(stats.tx_latency_us_max + 1 >= max_ns / 1000);
+    CHECK(stats.tx_latency_us_max <= max_ns / 1000 + 10);
+    CHECK(stats.tx_latency_us_avg + 1 >= total_ns / rx.size() / 1000);
+    CHECK(stats.tx_latency_us_avg <= total_ns / rx.size() / 1000 + 10);
+
+    CAN_ResetStats(can1.handle());
+    CHECK(CAN_GetStats(can1.handle(), &stats));
+    CHECK_EQ(stats.tx_latency_us_max, 0U);
+    CHECK_EQ(stats.tx_latency_us_avg, 0U);
+}
+#endif
+
+#if CAN_ENABLE_BUS_LOAD
+// 只有发送成功的帧计入总线负载：在邮箱中被 CAN_SendLatest 覆盖而中止的帧没有上总线
+void test_bus_load_counts_sent_only()
+{
+    // 之前的帧移出 1 s 统计窗口
+    bus.run_for(1100000000ULL);
+    peer.clear_received();
+
+    const CAN_TxHeaderTypeDef header  = std_header(0x10);
+    uint8_t                   data[8] = {};
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+        data[0] = i;
+        CHECK(CAN_SendLatest(can1.handle(), &header, data) != 0);
+    }
+    CHECK(bus.run_until_idle());
+    bus.run_for(20000000);
+    const size_t sent = peer.received().size();
+    CHECK(sent < 3U);
+    const float replaced_load = CAN_GetBusLoad(can1.handle(), 1000);
+
+    // 再发一帧相同的帧，得到每帧的负载
+    CHECK(CAN_SendMessage(can1.handle(), &header, data) != 0);
+    CHECK(bus.run_until_idle());
+    bus.run_for(20000000);
+    const float frame_load = CAN_GetBusLoad(can1.handle(), 1000) - replaced_load;
+    CHECK(frame_load > 0.0f);
+    CHECK(std::fabs(replaced_load - static_cast<float>(sent) * frame_load) < frame_load * 0.01f);
+}
+#endif
+
+void test_bus_off_and_recover()
+{
+    peer.clear_received();
+    CAN_SetBusOffRecovery(can1.handle(), CAN_BUS_OFF_RECOVERY_MANUAL);
+    CAN_SetRecoveryPolicy(can1.handle(), CAN_RECOVERY_REPLAY);
+
+    can1.inject_tx_errors(32);
+    const CAN_TxHeaderTypeDef header  = std_header(0x10);
+    const uint8_t             data[8] = {};
+    CAN_TxTicket              ticket  = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendMessage(can1.handle(), &header, data, &ticket) != 0);
+    bus.run_for(10000000);
+    CHECK(can1.bus_off());
+    CHECK(CAN_GetErrorState(can1.handle(), nullptr, nullptr) == CAN_BUS_OFF);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_PENDING);
+
+    // REPLAY：恢复后邮箱中的帧继续发送
+    CHECK(CAN_RecoverBusOff(can1.handle()));
+    CHECK(bus.run_until_idle(10000000));
+    CHECK(!can1.bus_off());
+    CHECK(CAN_GetErrorState(can1.handle(), nullptr, nullptr) == CAN_ERROR_ACTIVE);
+    CHECK_EQ(peer.received().size(), 1U);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+}
+
+void test_bus_off_latest_only()
+{
+    peer.clear_received();
+    tx_results.clear();
+    CAN_SetBusOffRecovery(can1.handle(), CAN_BUS_OFF_RECOVERY_AUTO);
+    CAN_SetRecoveryPolicy(can1.handle(), CAN_RECOVERY_LATEST_ONLY);
+
+    // 邮箱与队列中都混有普通帧和最新值：邮箱 0x10 / 0x20(latest) / 0x30，队列 0x40(latest) / 0x50
+    can1.inject_tx_errors(32);
+    const uint8_t data[8] = {};
+    CAN_TxTicket  tickets[5]{};
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        const CAN_TxHeaderTypeDef header = std_header(0x10 * (i + 1));
+        if (i % 2 == 1)
+            CHECK(CAN_SendLatest(can1.handle(), &header, data, &tickets[i]) != CAN_SEND_FAILED);
+        else
+            CHECK(CAN_SendMessage(can1.handle(), &header, data, &tickets[i]) != 0);
+    }
+
+    // 以 1 bit 为步长找出进入与离开 bus-off 的时刻
+    const uint64_t step     = bus.bits_ns(1);
+    uint64_t       waited   = 0;
+    while (!can1.bus_off() && waited < 10000000)
+    {
+        bus.run_for(step);
+        waited += step;
+    }
+    CHECK(can1.bus_off());
+    const uint64_t bus_off_ns = now_ns();
+    while (can1.bus_off() && waited < 20000000)
+    {
+        bus.run_for(step);
+        waited += step;
+    }
+    CHECK(!can1.bus_off());
+    const uint64_t recovered_ns = now_ns();
+    CHECK(bus.run_until_idle());
+
+    // 恢复后只发出最新值，普通帧在进入 bus-off 时全部丢弃，包括已在邮箱中的
+    const auto& rx = peer.received();
+    CHECK_EQ(rx.size(), 2U);
+    CHECK_EQ(rx[0].frame.id, 0x20U);
+    CHECK_EQ(rx[1].frame.id, 0x40U);
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        const CAN_TxStatus status = CAN_GetTxStatus(can1.handle(), tickets[i]);
+        if (i % 2 == 1)
+            CHECK(status == CAN_TX_STATUS_SENT);
+        else
+            CHECK(status == CAN_TX_STATUS_DROPPED || status == CAN_TX_STATUS_ABORTED);
+    }
+
+    // 恢复至少需要 128 × 11 个隐性位
+    const uint64_t recovery_ns = recovered_ns - bus_off_ns;
+    CHECK(recovery_ns >= bus.bits_ns(128 * 11));
+    CHECK(rx[0].sof_ns >= recovered_ns);
+#if CAN_ENABLE_STATS
+    CAN_Stats stats{};
+    CHECK(CAN_GetStats(can1.handle(), &stats));
+    CHECK(stats.recovery_ms_last >= recovery_ns / 1000000);
+#endif
+    std::printf("bus-off recovery: %.1f us (128 x 11 bits = %.1f us), first frame after %.1f us\n",
+                recovery_ns / 1000.0,
+                bus.bits_ns(128 * 11) / 1000.0,
+                (rx[0].sof_ns - bus_off_ns) / 1000.0);
+
+    CAN_SetRecoveryPolicy(can1.handle(), CAN_RECOVERY_REPLAY);
+}
+
+void test_send_latest_saturated_bus()
+{
+    peer.clear_received();
+    tx_results.clear();
+
+    // 对端持续发送更高优先级的帧，0x100 的设定值一直停在邮箱里；之后总线空闲，设定值按帧时间发出
+    Frame flood;
+    flood.id  = 0x001;
+    flood.dlc = 8;
+    for (int i = 0; i < 30; ++i)
+        peer.send(flood);
+    bus.run_for(bus.bits_ns(20));
+
+    const CAN_TxHeaderTypeDef header = std_header(0x100);
+    const uint64_t            tick   = bus.frame_ns(flood) / 2;
+    constexpr uint32_t        values = 100;
+    std::vector<CAN_TxTicket> tickets;
+    for (uint32_t value = 0; value < values; ++value)
+    {
+        const uint8_t data[8] = { static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8) };
+        CAN_TxTicket  ticket  = CAN_TX_TICKET_INVALID;
+        CHECK(CAN_SendLatest(can1.handle(), &header, data, &ticket) != CAN_SEND_FAILED);
+        tickets.push_back(ticket);
+        bus.run_for(tick);
+    }
+    CHECK(bus.run_until_idle());
+
+    // 总线上的设定值严格递增：旧值不会在新值之后发出，最后一个值一定发出
+    std::vector<uint32_t> sent_values;
+    for (const auto& rx : peer.received())
+        if (rx.frame.id == 0x100)
+            sent_values.push_back(rx.frame.data[0] | rx.frame.data[1] << 8);
+    CHECK(!sent_values.empty());
+    for (size_t i = 1; i < sent_values.size(); ++i)
+        CHECK(sent_values[i - 1] < sent_values[i]);
+    CHECK_EQ(sent_values.back(), values - 1);
+    // 对端的 30 帧发完之前 0x100 一直仲裁失败，邮箱中的旧值全部被覆盖
+    CHECK(sent_values.size() < values - 30);
+
+    // 每个票据恰好结束一次：发出的以 SENT 结束，其余都被新值覆盖
+    size_t sent = 0, replaced = 0;
+    CHECK_EQ(tx_results.size(), tickets.size());
+    for (const TxResult& result : tx_results)
+    {
+        if (result.status == CAN_TX_STATUS_SENT)
+            ++sent;
+        else if (result.status == CAN_TX_STATUS_REPLACED)
+            ++replaced;
+    }
+    CHECK_EQ(sent, sent_values.size());
+    CHECK_EQ(replaced, tickets.size() - sent);
+}
+
+#if CAN_FAST_PATH
+void test_rx_fifo_irq_handler()
+{
+    received_ids.clear();
+    can1.set_irq_handler(CAN1_RX0_IRQn, [] { CAN_RxFifoIRQHandler(can1.handle(), CAN_RX_FIFO0); });
+#    if CAN_ENABLE_STATS
+    CAN_ResetStats(can1.handle());
+#    endif
+
+    // 关中断期间到达 5 帧，3 级 FIFO 溢出：直接入口取走 3 帧并清除 FULL / FOVR
+    const uint32_t overruns = can1.rx_overruns(0);
+    __disable_irq();
+    Frame frame;
+    frame.dlc = 1;
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        frame.id = 0x200 + i;
+        peer.send(frame);
+    }
+    CHECK(bus.run_until_idle());
+    __enable_irq();
+    poll_rx();
+    CHECK_EQ(received_ids.size(), 3U);
+    CHECK_EQ(can1.rx_overruns(0) - overruns, 2U);
+    CHECK((can1.instance()->RF0R & (CAN_RF0R_FMP0 | CAN_RF0R_FULL0 | CAN_RF0R_FOVR0)) == 0);
+#    if CAN_ENABLE_STATS
+    CAN_Stats stats{};
+    CHECK(CAN_GetStats(can1.handle(), &stats));
+    CHECK_EQ(stats.rx_overrun[0], 1U);
+    CHECK_EQ(stats.rx_fifo[0], 3U);
+#    endif
+    can1.set_irq_handler(CAN1_RX0_IRQn, nullptr);
+}
+#endif
+
+// 前面的过滤器组已用满 FMI 表时，路由配置失败且不激活过滤器组，命中的帧不会绕过路由落到广播回调
+void test_filter_routes_fmi_overflow()
+{
+    // 7 个 16 位 list 组各占 4 个编号，FIFO0 的编号 0 ~ 27 用完
+    for (uint32_t bank = 0; bank < CAN_FMI_TABLE_SIZE / 4; ++bank)
+    {
+        CAN_FilterTypeDef filter{};
+        filter.FilterBank           = bank;
+        filter.FilterMode           = CAN_FILTERMODE_IDLIST;
+        filter.FilterScale          = CAN_FILTERSCALE_16BIT;
+        filter.FilterFIFOAssignment = CAN_FILTER_FIFO0;
+        filter.FilterActivation     = CAN_FILTER_ENABLE;
+        filter.SlaveStartFilterBank = 14;
+        CHECK(HAL_CAN_ConfigFilter(can1.handle(), &filter) == HAL_OK);
+    }
+
+    const uint32_t  bank = CAN_FMI_TABLE_SIZE / 4;
+    CAN_FilterRoute route{};
+    route.id       = 0x300;
+    route.mask     = 0x7F0;
+    route.ide      = CAN_ID_STD;
+    route.fifo     = CAN_RX_FIFO0;
+    route.callback = [](const CAN_HandleTypeDef*, const CAN_RxHeaderTypeDef* header, const uint8_t*, void*)
+    { received_ids.push_back(header->StdId); };
+    CHECK(!CAN_ConfigFilterRoutes(can1.handle(), &route, 1, bank, 14));
+    CHECK((can1.instance()->FA1R & 1U << bank) == 0);
+
+    received_ids.clear();
+    Frame frame;
+    frame.id  = 0x301;
+    frame.dlc = 1;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    poll_rx();
+    CHECK(received_ids.empty());
+
+    // 恢复全部接收
+    can1.instance()->FA1R &= ~((1U << bank) - 1);
+    can1.accept_all();
+}
+
+// 回调中保留的帧在回调返回后仍然有效且不被后续接收覆盖；帧池耗尽时回调照常收到帧，但无法保留
+void test_retain_frame_pool_exhaustion()
+{
+    static std::vector<const CAN_RxFrame*> retained;
+    static size_t                          delivered;
+    retained.clear();
+    delivered = 0;
+    CHECK(CAN_RegisterIdCallback(
+            can1.handle(),
+            0x600,
+            0x7F0,
+            [](const CAN_HandleTypeDef*, const CAN_RxHeaderTypeDef* header, const uint8_t*, void*)
+            {
+                ++delivered;
+                retained.push_back(CAN_RetainFrame(header));
+            },
+            nullptr));
+#if CAN_ENABLE_STATS
+    CAN_ResetStats(can1.handle());
+#endif
+
+    Frame frame;
+    frame.dlc = 1;
+    for (uint32_t i = 0; i < CAN_RX_POOL_SIZE + 2; ++i)
+    {
+        frame.id      = 0x600 + (i & 0xF);
+        frame.data[0] = static_cast<uint8_t>(i);
+        peer.send(frame);
+    }
+    CHECK(bus.run_until_idle());
+    poll_rx();
+
+    CHECK_EQ(delivered, static_cast<size_t>(CAN_RX_POOL_SIZE + 2));
+    CHECK_EQ(retained.size(), delivered);
+    for (uint32_t i = 0; i < CAN_RX_POOL_SIZE; ++i)
+    {
+        CHECK(retained[i] != nullptr);
+        CHECK_EQ(retained[i]->header.StdId, 0x600U + (i & 0xF));
+        CHECK_EQ(retained[i]->data[0], i);
+    }
+    // 所有槽位都被保留，最后两帧只能放在栈上临时帧中
+    CHECK(retained[CAN_RX_POOL_SIZE] == nullptr);
+    CHECK(retained[CAN_RX_POOL_SIZE + 1] == nullptr);
+#if CAN_ENABLE_STATS
+    CAN_Stats stats{};
+    CHECK(CAN_GetStats(can1.handle(), &stats));
+    CHECK_EQ(stats.rx_pool_empty, 2U);
+#endif
+
+    // 全部归还后帧池恢复可用
+    for (const CAN_RxFrame* retained_frame : retained)
+        CAN_ReleaseFrame(retained_frame);
+    retained.clear();
+    frame.id = 0x600;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    poll_rx();
+    CHECK_EQ(retained.size(), 1U);
+    CHECK(retained[0] != nullptr);
+    CAN_ReleaseFrame(retained[0]);
+}
+
+#if CAN_ENABLE_RX_LATEST
+// 最新值缓存：未注册或尚未收到时读取失败，读到的是最后一帧及其年龄
+void test_read_latest()
+{
+    CHECK(CAN_RegisterLatest(can1.handle(), 0x700));
+    CAN_LatestFrame latest{};
+    uint32_t        age_us = 0;
+    CHECK(!CAN_ReadLatest(can1.handle(), 0x700, &latest, &age_us));
+    CHECK(!CAN_ReadLatest(can1.handle(), 0x701, &latest, &age_us));
+
+    Frame frame;
+    frame.id  = 0x700;
+    frame.dlc = 8;
+    for (const uint8_t value : { 0xAA, 0xBB })
+    {
+        std::fill(frame.data, frame.data + 8, value);
+        peer.send(frame);
+    }
+    CHECK(bus.run_until_idle());
+    poll_rx();
+    bus.run_for(1000000);
+
+    CHECK(CAN_ReadLatest(can1.handle(), 0x700, &latest, &age_us));
+    CHECK_EQ(latest.sequence, 2U);
+    CHECK_EQ(latest.header.StdId, 0x700U);
+    CHECK_EQ(latest.data[7], 0xBB);
+    CHECK(age_us >= 1000 && age_us < 1500);
+}
+
+// 线程不断读取最新值，同时接收中断连续写入：每次读到的快照都必须来自同一帧，序号不回退
+void test_read_latest_torn()
+{
+    constexpr uint32_t ROUNDS = 30000;
+    // 接收中断只由 call_in_interrupt 触发，每次取走 FIFO 中的 3 帧，连续写入同一个缓存
+    CHECK(HAL_CAN_DeactivateNotification(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING) == HAL_OK);
+
+    CAN_LatestFrame first{};
+    CHECK(CAN_ReadLatest(can1.handle(), 0x700, &first, nullptr));
+
+    std::atomic<bool>     stop{ false };
+    std::atomic<uint32_t> reads{ 0 };
+    std::atomic<uint32_t> torn{ 0 };
+    std::thread           reader(
+            [&]
+            {
+                uint32_t last = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    CAN_LatestFrame snapshot{};
+                    bool            ok = CAN_ReadLatest(can1.handle(), 0x700, &snapshot, nullptr) &&
+                                snapshot.header.StdId == 0x700 && snapshot.sequence >= last;
+                    // 之后写入的第 n 帧的 8 个字节都是 n 的低 8 位
+                    const uint8_t expected = snapshot.sequence == first.sequence
+                                                     ? first.data[0]
+                                                     : static_cast<uint8_t>(snapshot.sequence);
+                    for (const uint8_t byte : snapshot.data)
+                        ok = ok && byte == expected;
+                    last = snapshot.sequence;
+                    if (!ok)
+                        torn.fetch_add(1, std::memory_order_relaxed);
+                    reads.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+
+    Frame frame;
+    frame.id  = 0x700;
+    frame.dlc = 8;
+    bool idle = true;
+    for (uint32_t n = 0; n < ROUNDS; n += 3)
+    {
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            std::fill(frame.data, frame.data + 8, static_cast<uint8_t>(first.sequence + n + i + 1));
+            peer.send(frame);
+        }
+        idle = bus.run_until_idle() && idle;
+        call_in_interrupt(CAN1_RX0_IRQn, [] { CAN_Fifo0ReceiveCallback(can1.handle()); });
+    }
+    stop.store(true, std::memory_order_relaxed);
+    reader.join();
+    CHECK(idle);
+
+    CHECK(reads.load() > 0);
+    CHECK_EQ(torn.load(), 0U);
+    CAN_LatestFrame latest{};
+    CHECK(CAN_ReadLatest(can1.handle(), 0x700, &latest, nullptr));
+    CHECK_EQ(latest.sequence, first.sequence + ROUNDS);
+
+    CHECK(HAL_CAN_ActivateNotification(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING) == HAL_OK);
+}
+#endif
+
+#if CAN_ENABLE_RX_TIMESTAMP
+struct RxStamp
+{
+    uint64_t timestamp_us; ///< CAN_GetRxTimestamp
+    uint64_t isr_us;       ///< 回调中的 CAN_GetTimeUs
+    uint32_t isr_tick;     ///< 回调中的 HAL_GetTick
+};
+std::vector<RxStamp> rx_stamps;
+
+void send_and_stamp(const uint32_t id)
+{
+    Frame frame;
+    frame.id  = id;
+    frame.dlc = 8;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    poll_rx();
+}
+
+// 接收时间戳：默认为接收中断的时刻；开启时间触发模式后按硬件 SOF 时间戳换算，不受中断延迟影响；
+// CAN_TimestampToTick 把时间戳换回当时的 HAL_GetTick
+void test_rx_timestamp()
+{
+    rx_stamps.clear();
+    CHECK(CAN_RegisterIdCallback(
+            can1.handle(),
+            0x720,
+            0x7F0,
+            [](const CAN_HandleTypeDef*, const CAN_RxHeaderTypeDef* header, const uint8_t*, void*)
+            { rx_stamps.push_back({ CAN_GetRxTimestamp(header), CAN_GetTimeUs(), HAL_GetTick() }); },
+            nullptr));
+
+    send_and_stamp(0x720);
+    bus.run_for(5000000);
+    send_and_stamp(0x721);
+    CHECK_EQ(rx_stamps.size(), 2U);
+    for (const RxStamp& stamp : rx_stamps)
+        CHECK_EQ(stamp.timestamp_us, stamp.isr_us);
+    const uint64_t frame_us = bus.frame_ns(Frame{ 0x720, false, false, 8 }) / 1000;
+    const uint64_t gap_us   = rx_stamps[1].timestamp_us - rx_stamps[0].timestamp_us;
+    CHECK(gap_us + 5 >= 5000 + frame_us && gap_us <= 5000 + frame_us + 5);
+
+    // 3 ms 之后换算回接收时的 tick；尚未到来的时刻换算为当前 tick
+    bus.run_for(3000000);
+    CHECK_EQ(CAN_TimestampToTick(rx_stamps[1].timestamp_us), rx_stamps[1].isr_tick);
+    CHECK_EQ(CAN_TimestampToTick(CAN_GetTimeUs() + 5000), HAL_GetTick());
+
+    // 时间触发模式：第二帧到达后中断被屏蔽 2 ms，时间戳仍为两帧 SOF 之差
+    CHECK(HAL_CAN_Stop(can1.handle()) == HAL_OK);
+    can1.handle()->Init.TimeTriggeredMode = ENABLE;
+    CHECK(HAL_CAN_Init(can1.handle()) == HAL_OK);
+    CAN_Start(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+
+    rx_stamps.clear();
+    send_and_stamp(0x722);
+    bus.run_for(1000000 - bus.frame_ns(Frame{ 0x722, false, false, 8 }));
+    __disable_irq();
+    send_and_stamp(0x723);
+    bus.run_for(2000000);
+    __enable_irq();
+    poll_rx();
+    CHECK_EQ(rx_stamps.size(), 2U);
+    CHECK(rx_stamps[1].isr_us - rx_stamps[0].isr_us >= 3000);
+    const uint64_t sof_gap_us = rx_stamps[1].timestamp_us - rx_stamps[0].timestamp_us;
+    CHECK(sof_gap_us + 5 >= 1000 && sof_gap_us <= 1000 + 5);
+
+    CHECK(HAL_CAN_Stop(can1.handle()) == HAL_OK);
+    can1.handle()->Init.TimeTriggeredMode = DISABLE;
+    CHECK(HAL_CAN_Init(can1.handle()) == HAL_OK);
+    CAN_Start(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+}
+#endif
+
+// 令牌桶限速：突发 burst 帧后按速率每 1000 / rate ms 补充一帧，空闲再久也只攒下 burst 帧；
+// 超限的帧直接拒绝并以 CAN_TX_STATUS_RATE_LIMITED 结束，范围外或帧类型不同的帧不受限制
+void test_rate_limit()
+{
+    peer.clear_received();
+    tx_results.clear();
+    CHECK(!CAN_SetRateLimit(can1.handle(), CAN_ID_STD, 0x68F, 0x680, 100, 3));
+    CHECK(!CAN_SetRateLimit(can1.handle(), CAN_ID_STD, 0x680, 0x68F, 100, 0));
+    CHECK(CAN_SetRateLimit(can1.handle(), CAN_ID_STD, 0x680, 0x68F, 100, 3));
+#if CAN_ENABLE_STATS
+    CAN_ResetStats(can1.handle());
+#endif
+
+    const CAN_TxHeaderTypeDef limited = std_header(0x685);
+    const uint8_t             data[8] = {};
+    auto                      send    = [&limited, &data] { return CAN_SendMessage(can1.handle(), &limited, data); };
+    for (int i = 0; i < 3; ++i)
+        CHECK(send() != CAN_SEND_FAILED);
+    CAN_TxTicket ticket = CAN_TX_TICKET_INVALID;
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &limited, data, &ticket), static_cast<uint32_t>(CAN_SEND_FAILED));
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_RATE_LIMITED);
+    CHECK(std::any_of(tx_results.begin(),
+                      tx_results.end(),
+                      [ticket](const TxResult& r)
+                      { return r.ticket == ticket && r.status == CAN_TX_STATUS_RATE_LIMITED; }));
+
+    // 范围外的 ID 与同一数值的扩展帧不受限制
+    const CAN_TxHeaderTypeDef other = std_header(0x690);
+    CAN_TxHeaderTypeDef       ext   = std_header(0);
+    ext.IDE                         = CAN_ID_EXT;
+    ext.ExtId                       = 0x685;
+    CHECK(CAN_SendMessage(can1.handle(), &other, data) != CAN_SEND_FAILED);
+    CHECK(CAN_SendMessage(can1.handle(), &ext, data) != CAN_SEND_FAILED);
+    CHECK(bus.run_until_idle());
+
+    // 5 ms 只补充半帧，10 ms 补充一帧
+    bus.run_for(5000000);
+    CHECK_EQ(send(), static_cast<uint32_t>(CAN_SEND_FAILED));
+    bus.run_for(5000000);
+    CHECK(send() != CAN_SEND_FAILED);
+    CHECK_EQ(send(), static_cast<uint32_t>(CAN_SEND_FAILED));
+
+    // 空闲 1 s 后同样只允许突发 3 帧
+    CHECK(bus.run_until_idle());
+    bus.run_for(1000000000);
+    for (int i = 0; i < 3; ++i)
+        CHECK(send() != CAN_SEND_FAILED);
+    CHECK_EQ(send(), static_cast<uint32_t>(CAN_SEND_FAILED));
+    CHECK(bus.run_until_idle());
+
+    CHECK_EQ(peer.received().size(), 9U);
+#if CAN_ENABLE_STATS
+    CAN_Stats stats{};
+    CHECK(CAN_GetStats(can1.handle(), &stats));
+    CHECK_EQ(stats.tx_rate_limited, 4U);
+#endif
+}
+
+// 队列已满：默认挤出队列中 ID 最大的帧，新帧本身最低时拒绝新帧；CAN_TX_REJECT_NEW 一律拒绝新帧。
+// 被丢弃的帧以 CAN_TX_STATUS_DROPPED 结束，留在队列中的帧照常按 ID 顺序发出
+void test_tx_drop_policy()
+{
+    peer.clear_received();
+    tx_results.clear();
+#if CAN_ENABLE_STATS
+    CAN_ResetStats(can1.handle());
+#endif
+
+    const uint8_t data[8] = {};
+    auto          send    = [&data](const uint32_t id, CAN_TxTicket* ticket)
+    {
+        const CAN_TxHeaderTypeDef header = std_header(id);
+        return CAN_SendMessage(can1.handle(), &header, data, ticket);
+    };
+    auto dropped = [](const CAN_TxTicket ticket)
+    {
+        return CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_DROPPED &&
+               std::any_of(tx_results.begin(),
+                           tx_results.end(),
+                           [ticket](const TxResult& r)
+                           { return r.ticket == ticket && r.status == CAN_TX_STATUS_DROPPED; });
+    };
+
+    // 3 帧装入邮箱，之后 CAN_TX_QUEUE_SIZE 帧排满软件队列
+    for (uint32_t i = 0; i < 3; ++i)
+        CHECK(send(0x500 + i, nullptr) != CAN_SEND_FAILED);
+    std::vector<CAN_TxTicket> queued;
+    for (uint32_t i = 0; i < CAN_TX_QUEUE_SIZE; ++i)
+    {
+        CAN_TxTicket ticket = CAN_TX_TICKET_INVALID;
+        CHECK_EQ(send(0x510 + i, &ticket), static_cast<uint32_t>(CAN_SEND_QUEUED));
+        queued.push_back(ticket);
+    }
+    CHECK(tx_results.empty());
+
+    // 默认策略：更高优先级的新帧挤出 ID 最大的帧
+    const uint32_t worst_id = 0x510 + CAN_TX_QUEUE_SIZE - 1;
+    CAN_TxTicket   ticket   = CAN_TX_TICKET_INVALID;
+    CHECK_EQ(send(0x508, &ticket), static_cast<uint32_t>(CAN_SEND_QUEUED));
+    CHECK(dropped(queued.back()));
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_QUEUED);
+
+    // 新帧本身最低时拒绝新帧，队列不变
+    CHECK_EQ(send(0x5F0, &ticket), static_cast<uint32_t>(CAN_SEND_FAILED));
+    CHECK(dropped(ticket));
+
+    // CAN_TX_REJECT_NEW：即使新帧优先级更高也拒绝
+    CAN_SetTxDropPolicy(can1.handle(), CAN_TX_REJECT_NEW);
+    CHECK_EQ(send(0x505, &ticket), static_cast<uint32_t>(CAN_SEND_FAILED));
+    CHECK(dropped(ticket));
+    CAN_SetTxDropPolicy(can1.handle(), CAN_TX_DROP_LOWEST_PRIORITY);
+    CHECK_EQ(tx_results.size(), 3U);
+
+    CHECK(bus.run_until_idle());
+    const auto& rx = peer.received();
+    CHECK_EQ(rx.size(), static_cast<size_t>(CAN_TX_QUEUE_SIZE + 3));
+    CHECK_EQ(rx[3].frame.id, 0x508U);
+    for (size_t i = 1; i < rx.size(); ++i)
+    {
+        CHECK(rx[i - 1].frame.id < rx[i].frame.id);
+        CHECK(rx[i].frame.id != worst_id);
+    }
+    for (size_t i = 0; i + 1 < queued.size(); ++i)
+        CHECK(CAN_GetTxStatus(can1.handle(), queued[i]) == CAN_TX_STATUS_SENT);
+#if CAN_ENABLE_STATS
+    CAN_Stats stats{};
+    CHECK(CAN_GetStats(can1.handle(), &stats));
+    CHECK_EQ(stats.tx_dropped, 3U);
+#endif
+}
+
+} // namespace
+
+int main()
+{
+    setup();
+    RUN_TEST(test_send_and_receive);
+    RUN_TEST(test_queue_priority_order);
+    RUN_TEST(test_tx_drop_policy);
+    RUN_TEST(test_reuse_mailbox_with_masked_irq);
+#if CAN_TX_LOCK_PRIORITY > 0
+    RUN_TEST(test_isr_send_while_lock_held);
+#endif
+#if CAN_ENABLE_STATS
+    RUN_TEST(test_tx_latency_stats);
+#endif
+    RUN_TEST(test_bus_off_and_recover);
+    RUN_TEST(test_bus_off_latest_only);
+    RUN_TEST(test_send_latest_saturated_bus);
+#if CAN_ENABLE_BUS_LOAD
+    RUN_TEST(test_bus_load_counts_sent_only);
+#endif
+#if CAN_FAST_PATH
+    RUN_TEST(test_rx_fifo_irq_handler);
+#endif
+    RUN_TEST(test_filter_routes_fmi_overflow);
+    RUN_TEST(test_retain_frame_pool_exhaustion);
+    RUN_TEST(test_rate_limit);
+#if CAN_ENABLE_RX_TIMESTAMP
+    RUN_TEST(test_rx_timestamp);
+#endif
+#if CAN_ENABLE_RX_LATEST
+    RUN_TEST(test_read_latest);
+    RUN_TEST(test_read_latest_torn);
+#endif
+    return host_test::result();
+}
@@ -0,0 +1,331 @@
+/**
+ * @file    test_can_isotp.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   两个节点之间的 ISO-TP 回环测试。
+ *
+ * 同一条总线上两个 bxCAN 控制器各挂一个 IsoTpBus 与一个会话，发送 / 接收 ID 互换：
+ * - 单帧与 4095 字节多帧传输，数据逐字节一致；
+ * - STmin 为 0 时同时有多个连续帧在邮箱中，总线上连续帧首尾相接；
+ * - 接收端要求 BS / STmin 时，发送端按块等待流控，连续帧间隔不小于 STmin；
+ * - 两个方向同时传输；
+ * - 构造 IsoTpBus 前设置的发送结束回调仍能收到非 ISO-TP 帧的事件。
+ */
+#include "CanIsoTp.hpp"
+#include "can_driver.hpp"
+#include "can_sim.hpp"
+#include "host_test.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+using namespace can_sim;
+using protocol::IsoTpBus;
+using protocol::IsoTpChannel;
+
+namespace
+{
+
+constexpr uint32_t ID_A = 0x7E0; // A 发送、B 接收
+constexpr uint32_t ID_B = 0x7E8; // B 发送、A 接收
+// 第二对会话，B 接收时要求 BS = 4、STmin = 2 ms
+constexpr uint32_t SLOW_ID_A = 0x7E1;
+constexpr uint32_t SLOW_ID_B = 0x7E9;
+
+Bus   bus(1000000);
+BxCan can_a(bus);
+BxCan can_b(bus);
+
+// 应用在 ISO-TP 之前设置的发送结束回调
+std::vector<CAN_TxTicket> app_tickets;
+
+void on_app_tx_complete(const CAN_HandleTypeDef* /*hcan*/, const CAN_TxTicket ticket, CAN_TxStatus /*status*/, void* /*ctx*/)
+{
+    app_tickets.push_back(ticket);
+}
+
+struct Endpoint
+{
+    IsoTpBus*     isotp;
+    IsoTpChannel* channel;
+
+    bool                 tx_done;
+    IsoTpChannel::Result tx_result;
+    bool                 rx_done;
+    IsoTpChannel::Result rx_result;
+    size_t               rx_length;
+    std::vector<uint8_t> rx_buffer;
+};
+
+Endpoint node_a{};
+Endpoint node_b{};
+Endpoint slow_a{};
+Endpoint slow_b{};
+
+void on_tx(IsoTpChannel& /*channel*/, const IsoTpChannel::Result result, void* ctx)
+{
+    auto* node      = static_cast<Endpoint*>(ctx);
+    node->tx_done   = true;
+    node->tx_result = result;
+}
+
+void on_rx(IsoTpChannel& /*channel*/, const IsoTpChannel::Result result, const size_t length, void* ctx)
+{
+    auto* node      = static_cast<Endpoint*>(ctx);
+    node->rx_done   = true;
+    node->rx_result = result;
+    node->rx_length = length;
+}
+
+// 总线上每一帧的 ID 与起止时刻
+struct BusFrame
+{
+    uint32_t id;
+    uint8_t  pci;
+    uint64_t sof_ns;
+    uint64_t end_ns;
+};
+std::vector<BusFrame> bus_frames;
+
+void setup()
+{
+    for (BxCan* can : { &can_a, &can_b })
+    {
+        can->accept_all();
+        CAN_InitMainCallback(can->handle());
+        CAN_Start(can->handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+    }
+    CAN_SetTxCompleteCallback(can_a.handle(), on_app_tx_complete, nullptr);
+
+    bus.set_monitor([](const Transfer& transfer) {
+        if (transfer.result == Transfer::Result::Ok)
+            bus_frames.push_back({ transfer.frame.id,
+                                   static_cast<uint8_t>(transfer.frame.data[0] >> 4),
+                                   transfer.sof_ns,
+                                   transfer.end_ns });
+    });
+}
+
+/**
+ * 推进总线直到 done 返回 true，每 1 ms 调用一次两端的 poll；step 回调在每 10 us 调用一次
+ */
+bool run_until(const std::function<bool()>& done,
+               const uint32_t               timeout_ms,
+               const std::function<void()>& step = nullptr)
+{
+    constexpr uint64_t step_ns = 10000;
+    for (uint32_t ms = 0; ms < timeout_ms; ++ms)
+    {
+        for (uint64_t t = 0; t < 1000000; t += step_ns)
+        {
+            bus.run_for(step_ns);
+            if (step)
+                step();
+        }
+        node_a.isotp->poll();
+        node_b.isotp->poll();
+        if (done())
+            return true;
+    }
+    return false;
+}
+
+std::vector<uint8_t> pattern(const size_t length, const uint8_t seed)
+{
+    std::vector<uint8_t> data(length);
+    for (size_t i = 0; i < length; ++i)
+        data[i] = static_cast<uint8_t>(seed + i * 7);
+    return data;
+}
+
+void arm(Endpoint& node, const size_t capacity)
+{
+    node.rx_done   = false;
+    node.rx_length = 0;
+    node.rx_buffer.assign(capacity, 0);
+    CHECK(node.channel->receive(node.rx_buffer.data(), capacity, on_rx, &node));
+}
+
+/**
+ * 从 from 发送 data 到 to，返回双方都结束时的结果
+ */
+bool transfer(Endpoint& from, Endpoint& to, const std::vector<uint8_t>& data)
+{
+    arm(to, 4095);
+    from.tx_done = false;
+    CHECK(from.channel->send(data.data(), data.size(), on_tx, &from));
+    return run_until([&] { return from.tx_done && to.rx_done; }, 5000);
+}
+
+size_t mailboxes_in_use(BxCan& can)
+{
+    const uint32_t tsr = can.instance()->TSR;
+    return 3 - (((tsr & CAN_TSR_TME0) ? 1 : 0) + ((tsr & CAN_TSR_TME1) ? 1 : 0) + ((tsr & CAN_TSR_TME2) ? 1 : 0));
+}
+
+void test_single_frame()
+{
+    const auto data = pattern(5, 0x10);
+    CHECK(transfer(node_a, node_b, data));
+    CHECK(node_a.tx_result == IsoTpChannel::Result::Ok);
+    CHECK(node_b.rx_result == IsoTpChannel::Result::Ok);
+    CHECK_EQ(node_b.rx_length, data.size());
+    CHECK(std::equal(data.begin(), data.end(), node_b.rx_buffer.begin()));
+}
+
+void test_multi_frame_window()
+{
+    const auto data = pattern(4095, 0x20);
+    bus_frames.clear();
+
+    arm(node_b, 4095);
+    node_a.tx_done = false;
+    CHECK(node_a.channel->send(data.data(), data.size(), on_tx, &node_a));
+    size_t max_in_use = 0;
+    CHECK(run_until([] { return node_a.tx_done && node_b.rx_done; },
+                    5000,
+                    [&] { max_in_use = std::max(max_in_use, mailboxes_in_use(can_a)); }));
+
+    CHECK(node_a.tx_result == IsoTpChannel::Result::Ok);
+    CHECK(node_b.rx_result == IsoTpChannel::Result::Ok);
+    CHECK_EQ(node_b.rx_length, data.size());
+    CHECK(std::equal(data.begin(), data.end(), node_b.rx_buffer.begin()));
+
+    // 同时有 ISOTP_TX_WINDOW 个连续帧在邮箱中排队
+    CHECK_EQ(max_in_use, static_cast<size_t>(std::min(ISOTP_TX_WINDOW, 3)));
+
+    // 连续帧首尾相接：两帧之间只有 3 位帧间隔
+    std::vector<BusFrame> cf;
+    for (const BusFrame& frame : bus_frames)
+        if (frame.id == ID_A && frame.pci == 0x2)
+            cf.push_back(frame);
+    CHECK_EQ(cf.size(), static_cast<size_t>((4095 - 6 + 6) / 7));
+    uint64_t max_gap = 0;
+    for (size_t i = 1; i < cf.size(); ++i)
+        max_gap = std::max(max_gap, cf[i].sof_ns - cf[i - 1].end_ns);
+    CHECK(max_gap <= bus.bits_ns(3));
+
+    const uint64_t elapsed = cf.back().end_ns - bus_frames.front().sof_ns;
+    std::printf("4095 bytes: %zu frames in %.1f ms, %.1f kB/s, max gap %.1f us, mailboxes in use %zu\n",
+                cf.size() + 1,
+                elapsed / 1e6,
+                data.size() / (elapsed / 1e9) / 1000.0,
+                max_gap / 1000.0,
+                max_in_use);
+}
+
+void test_block_size_and_st_min()
+{
+    // 第二对会话：接收端要求每 4 帧一次流控，连续帧间隔至少 2 ms
+    const auto data = pattern(100, 0x30);
+    bus_frames.clear();
+    CHECK(transfer(slow_a, slow_b, data));
+    CHECK(slow_a.tx_result == IsoTpChannel::Result::Ok);
+    CHECK(slow_b.rx_result == IsoTpChannel::Result::Ok);
+    CHECK_EQ(slow_b.rx_length, data.size());
+    CHECK(std::equal(data.begin(), data.end(), slow_b.rx_buffer.begin()));
+
+    // 首帧之后 1 次流控，此后每 4 个连续帧 1 次；块内连续帧间隔不小于 STmin，流控帧之后立即发送
+    size_t   fc = 0, cf = 0;
+    uint64_t last_cf_end = 0, min_gap = UINT64_MAX;
+    bool     after_fc    = false;
+    for (const BusFrame& frame : bus_frames)
+    {
+        if (frame.id == SLOW_ID_B && frame.pci == 0x3)
+        {
+            ++fc;
+            after_fc = true;
+        }
+        if (frame.id == SLOW_ID_A && frame.pci == 0x2)
+        {
+            if (!after_fc)
+                min_gap = std::min(min_gap, frame.sof_ns - last_cf_end);
+            ++cf;
+            after_fc    = false;
+            last_cf_end = frame.end_ns;
+        }
+    }
+    CHECK_EQ(cf, static_cast<size_t>((100 - 6 + 6) / 7));
+    CHECK_EQ(fc, 1 + (cf - 1) / 4);
+    CHECK(min_gap >= 2000000);
+}
+
+void test_both_directions()
+{
+    const auto a_to_b = pattern(300, 0x40);
+    const auto b_to_a = pattern(500, 0x50);
+    arm(node_a, 4095);
+    arm(node_b, 4095);
+    node_a.tx_done = node_b.tx_done = false;
+    CHECK(node_a.channel->send(a_to_b.data(), a_to_b.size(), on_tx, &node_a));
+    CHECK(node_b.channel->send(b_to_a.data(), b_to_a.size(), on_tx, &node_b));
+    CHECK(run_until([] { return node_a.tx_done && node_b.tx_done && node_a.rx_done && node_b.rx_done; }, 5000));
+
+    CHECK(node_a.tx_result == IsoTpChannel::Result::Ok);
+    CHECK(node_b.tx_result == IsoTpChannel::Result::Ok);
+    CHECK_EQ(node_b.rx_length, a_to_b.size());
+    CHECK_EQ(node_a.rx_length, b_to_a.size());
+    CHECK(std::equal(a_to_b.begin(), a_to_b.end(), node_b.rx_buffer.begin()));
+    CHECK(std::equal(b_to_a.begin(), b_to_a.end(), node_a.rx_buffer.begin()));
+}
+
+void test_app_callback_chained()
+{
+    // ISO-TP 的帧不会转发给应用的回调
+    CHECK(app_tickets.empty());
+
+    const CAN_TxHeader  header  = CAN_MakeDataHeader(0x123, false, 8);
+    const uint8_t       data[8] = {};
+    CAN_TxTicket        ticket  = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendMessage(can_a.handle(), &header, data, &ticket) != CAN_SEND_FAILED);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(app_tickets.size(), 1U);
+    CHECK_EQ(app_tickets[0], ticket);
+}
+
+} // namespace
+
+int main()
+{
+    setup();
+
+    IsoTpChannel::Config config_a;
+    config_a.tx_id = ID_A;
+    config_a.rx_id = ID_B;
+    IsoTpChannel::Config config_b;
+    config_b.tx_id = ID_B;
+    config_b.rx_id = ID_A;
+
+    IsoTpChannel::Config slow_config_a;
+    slow_config_a.tx_id = SLOW_ID_A;
+    slow_config_a.rx_id = SLOW_ID_B;
+    IsoTpChannel::Config slow_config_b;
+    slow_config_b.tx_id      = SLOW_ID_B;
+    slow_config_b.rx_id      = SLOW_ID_A;
+    slow_config_b.block_size = 4;
+    slow_config_b.st_min     = 2;
+
+    IsoTpBus     isotp_a(can_a.handle());
+    IsoTpBus     isotp_b(can_b.handle());
+    IsoTpChannel channel_a(config_a);
+    IsoTpChannel channel_b(config_b);
+    IsoTpChannel slow_channel_a(slow_config_a);
+    IsoTpChannel slow_channel_b(slow_config_b);
+    CHECK(isotp_a.attach(channel_a));
+    CHECK(isotp_b.attach(channel_b));
+    CHECK(isotp_a.attach(slow_channel_a));
+    CHECK(isotp_b.attach(slow_channel_b));
+    node_a = { &isotp_a, &channel_a };
+    node_b = { &isotp_b, &channel_b };
+    slow_a = { &isotp_a, &slow_channel_a };
+    slow_b = { &isotp_b, &slow_channel_b };
+
+    RUN_TEST(test_single_frame);
+    RUN_TEST(test_multi_frame_window);
+    RUN_TEST(test_block_size_and_st_min);
+    RUN_TEST(test_both_directions);
+    RUN_TEST(test_app_callback_chained);
+    return host_test::result();
+}
@@ -0,0 +1,327 @@
+/**
+ * @file    test_can_recorder.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   收发记录：日志编解码往返、输出回调持有的块在重新启动后不被改写、延迟分发的接收帧时间。
+ *
+ * - 编解码往返：标准帧、扩展帧、远程帧、短帧、总线编号、收发方向、时间倒退与大跨度时间差；
+ * - 输出回调未归还缓冲区时重新 CAN_RecorderStart，已交出的块在归还前保持不变，新帧按丢弃计数；
+ * - 延迟接收模式下接收帧在其后发送的帧之后才记录，解码出的时间仍是到达时间；
+ * - 记录 → 解码 → 按记录时间回放到仿真总线（LogReplayer）并再次记录，两份日志的帧与帧间隔一致。
+ */
+#include "can_driver.hpp"
+#include "can_log.hpp"
+#include "can_sim.hpp"
+#include "host_test.hpp"
+#include "log_replay.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace can_sim;
+
+namespace
+{
+
+Bus         bus(1000000);
+BxCan       can1(bus);
+VirtualNode peer(bus);
+
+// 输出回调收到的块；hold 为 true 时不归还，模拟尚未完成的异步输出
+struct Sink
+{
+    bool                 hold{ false };
+    uint32_t             blocks{ 0 };
+    const uint8_t*       data{ nullptr };
+    std::vector<uint8_t> copy;
+} sink;
+
+void on_block(const uint8_t* data, const size_t size, void* ctx)
+{
+    auto* s = static_cast<Sink*>(ctx);
+    s->blocks++;
+    s->data = data;
+    s->copy.assign(data, data + size);
+    if (!s->hold)
+        CAN_RecorderRelease();
+}
+
+// 把收到的块全部拼接起来，与 UART 抓取的原始日志相同
+void append_block(const uint8_t* data, const size_t size, void* ctx)
+{
+    auto* log = static_cast<std::vector<uint8_t>*>(ctx);
+    log->insert(log->end(), data, data + size);
+    CAN_RecorderRelease();
+}
+
+std::vector<can_log::Record> decode_block(const std::vector<uint8_t>& block)
+{
+    std::vector<can_log::Record> records;
+    can_log::BlockHeader         header{};
+    CHECK(can_log::decode_block_header(block.data(), block.size(), header));
+    CHECK_EQ(static_cast<size_t>(header.length) + can_log::BLOCK_HEADER_SIZE, block.size());
+
+    uint64_t prev_us = header.base_us;
+    size_t   offset  = can_log::BLOCK_HEADER_SIZE;
+    while (offset < block.size())
+    {
+        can_log::Record record{};
+        const size_t    n = can_log::decode_record(block.data() + offset, block.size() - offset, prev_us, record);
+        CHECK(n != 0);
+        if (n == 0)
+            break;
+        records.push_back(record);
+        offset += n;
+    }
+    return records;
+}
+
+void send_burst(const uint32_t count)
+{
+    Frame frame;
+    frame.id  = 0x100;
+    frame.dlc = 8;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        frame.data[0] = static_cast<uint8_t>(i);
+        peer.send(frame);
+    }
+    CHECK(bus.run_until_idle());
+}
+
+void setup()
+{
+    can1.accept_all();
+    CAN_InitMainCallback(can1.handle());
+    CAN_Start(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+}
+
+void test_record_round_trip()
+{
+    std::vector<can_log::Record> records(6);
+    records[0] = { 1000, 0x123, false, false, false, 0, 8, { 1, 2, 3, 4, 5, 6, 7, 8 } };
+    records[1] = { 1100, 0x1ABCDEF0, true, false, true, 1, 8, { 8, 7, 6, 5, 4, 3, 2, 1 } };
+    records[2] = { 1050, 0x7FF, false, true, false, 2, 4, {} };              // 时间倒退的远程帧
+    records[3] = { 1050, 0x001, false, false, true, 3, 0, {} };              // 无数据
+    records[4] = { 900, 0x18FF50E5, true, false, false, 0, 3, { 9, 9, 9 } }; // 再次倒退
+    records[5] = { 900 + (1ULL << 40), 0x200, false, false, true, 1, 8, { 0xFF } };
+
+    uint8_t  buffer[can_log::BLOCK_HEADER_SIZE + 6 * can_log::MAX_RECORD_SIZE];
+    size_t   used    = can_log::encode_block_header(buffer, records[0].time_us, 7);
+    uint64_t prev_us = records[0].time_us;
+    for (const can_log::Record& r : records)
+    {
+        const size_t n = can_log::encode_record(buffer + used, r, prev_us);
+        CHECK(n <= can_log::MAX_RECORD_SIZE);
+        used += n;
+        prev_us = r.time_us;
+    }
+    can_log::set_block_length(buffer, used);
+
+    can_log::BlockHeader header{};
+    CHECK(can_log::decode_block_header(buffer, used, header));
+    CHECK_EQ(header.dropped, 7U);
+    CHECK_EQ(header.base_us, records[0].time_us);
+
+    const std::vector<can_log::Record> decoded = decode_block(std::vector<uint8_t>(buffer, buffer + used));
+    CHECK_EQ(decoded.size(), records.size());
+    for (size_t i = 0; i < decoded.size() && i < records.size(); ++i)
+    {
+        const can_log::Record& a = records[i];
+        const can_log::Record& b = decoded[i];
+        CHECK_EQ(b.time_us, a.time_us);
+        CHECK_EQ(b.id, a.id);
+        CHECK_EQ(b.ext, a.ext);
+        CHECK_EQ(b.rtr, a.rtr);
+        CHECK_EQ(b.tx, a.tx);
+        CHECK_EQ(b.bus, a.bus);
+        CHECK_EQ(b.dlc, a.dlc);
+        if (!a.rtr)
+            CHECK(memcmp(a.data, b.data, a.dlc) == 0);
+    }
+
+    // 截断的记录解码失败
+    uint64_t        prev = records[0].time_us;
+    can_log::Record record{};
+    CHECK_EQ(can_log::decode_record(buffer + can_log::BLOCK_HEADER_SIZE, 5, prev, record), 0U);
+}
+
+void test_restart_keeps_held_block()
+{
+    sink      = Sink{};
+    sink.hold = true;
+    CAN_RecorderStart(on_block, &sink);
+
+    // 写满第一块，交给输出回调后不归还
+    while (sink.blocks == 0)
+        send_burst(8);
+    const uint8_t*             held = sink.data;
+    const std::vector<uint8_t> snapshot(held, held + sink.copy.size());
+
+    // 重新启动后写满另一块：已交出的块尚未归还，不能切换过去，之后的帧全部丢弃
+    CAN_RecorderStart(on_block, &sink);
+    send_burst(2 * CAN_RECORDER_BUFFER_SIZE / 10);
+    CHECK_EQ(sink.blocks, 1U);
+    CHECK(CAN_RecorderGetDropped() > 0);
+    CHECK(memcmp(held, snapshot.data(), snapshot.size()) == 0);
+    CHECK(!CAN_RecorderFlush());
+
+    // 归还后写满的那一块随下一帧输出，下一块的块头记下丢弃的帧数
+    sink.hold = false;
+    CAN_RecorderRelease();
+    send_burst(1);
+    CHECK_EQ(sink.blocks, 2U);
+    CHECK(CAN_RecorderFlush());
+    CHECK_EQ(sink.blocks, 3U);
+    can_log::BlockHeader header{};
+    CHECK(can_log::decode_block_header(sink.copy.data(), sink.copy.size(), header));
+    CHECK_EQ(header.dropped, static_cast<uint16_t>(CAN_RecorderGetDropped()));
+    CAN_RecorderStop();
+}
+
+void test_deferred_rx_time()
+{
+    sink = Sink{};
+    CAN_RecorderStart(on_block, &sink);
+    CAN_SetRxDeferred(can1.handle(), true);
+
+    // 接收帧到达后 1 ms 才发送一帧，发送完成后才分发接收帧
+    Frame rx;
+    rx.id  = 0x100;
+    rx.dlc = 8;
+    peer.send(rx);
+    CHECK(bus.run_until_idle());
+    bus.run_for(1000000);
+
+    CAN_TxHeaderTypeDef header{};
+    header.StdId   = 0x200;
+    header.IDE     = CAN_ID_STD;
+    header.RTR     = CAN_RTR_DATA;
+    header.DLC     = 8;
+    uint8_t data[8]{};
+    CHECK(CAN_SendMessage(can1.handle(), &header, data) != 0);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(CAN_Poll(can1.handle(), 0), 1U);
+    CHECK(CAN_RecorderFlush());
+    CAN_SetRxDeferred(can1.handle(), false);
+    CAN_RecorderStop();
+
+    const std::vector<can_log::Record> records = decode_block(sink.copy);
+    CHECK_EQ(records.size(), 2U);
+    if (records.size() != 2)
+        return;
+    CHECK(records[0].tx);
+    CHECK(!records[1].tx);
+    CHECK_EQ(records[1].id, 0x100U);
+
+    // 接收帧记录在后，时间早于发送帧至少 1 ms 加一帧的传输时间
+    Frame tx;
+    tx.id  = 0x200;
+    tx.dlc = 8;
+    CHECK(records[1].time_us < records[0].time_us);
+    CHECK(records[0].time_us - records[1].time_us >= 1000 + bus.frame_ns(tx) / 1000);
+}
+
+void test_replay_round_trip()
+{
+    std::vector<uint8_t> first;
+    CAN_RecorderStart(append_block, &first);
+
+    // 现场：连发的一串帧、间隔不等的单帧、扩展帧与远程帧，中间夹着本节点发送的一帧
+    Frame frame;
+    frame.id  = 0x120;
+    frame.dlc = 8;
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+        frame.data[0] = i;
+        peer.send(frame);
+    }
+    CHECK(bus.run_until_idle());
+    bus.run_for(250000);
+
+    Frame ext;
+    ext.id  = 0x18FF50E5;
+    ext.ext = true;
+    ext.dlc = 3;
+    peer.send(ext);
+    CHECK(bus.run_until_idle());
+
+    CAN_TxHeaderTypeDef header{};
+    header.StdId = 0x300;
+    header.IDE   = CAN_ID_STD;
+    header.RTR   = CAN_RTR_DATA;
+    header.DLC   = 2;
+    uint8_t data[8]{ 0xAA, 0x55 };
+    CHECK(CAN_SendMessage(can1.handle(), &header, data) != 0);
+    CHECK(bus.run_until_idle());
+    bus.run_for(1700000);
+
+    Frame remote;
+    remote.id  = 0x7FF;
+    remote.rtr = true;
+    remote.dlc = 4;
+    peer.send(remote);
+    CHECK(bus.run_until_idle());
+    bus.run_for(40000000);
+    frame.dlc = 1;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    CHECK(CAN_RecorderFlush());
+    CAN_RecorderStop();
+
+    can_sim::LogSummary                summary{};
+    const std::vector<can_log::Record> recorded = can_sim::decode_log(first.data(), first.size(), &summary);
+    CHECK_EQ(summary.damaged, 0U);
+    CHECK_EQ(summary.dropped, 0U);
+    CHECK_EQ(recorded.size(), 7U);
+
+    // 只回放接收的帧：它们由回放节点发出，被测节点再次接收并记录
+    std::vector<can_log::Record> rx = recorded;
+    rx.erase(std::remove_if(rx.begin(), rx.end(), [](const can_log::Record& r) { return r.tx; }), rx.end());
+    CHECK_EQ(rx.size(), 6U);
+
+    std::vector<uint8_t> second;
+    CAN_RecorderStart(append_block, &second);
+    can_sim::LogReplayer replay(bus, rx, can_sim::now_ns() + 1000000);
+    CHECK(bus.run_until_idle());
+    CHECK(replay.done());
+    CHECK(CAN_RecorderFlush());
+    CAN_RecorderStop();
+
+    // 回放总线与现场波特率相同：连发的帧同样首尾相接，每帧都在提交时刻开始发送
+    CHECK_EQ(replay.max_lateness_ns(), 0U);
+
+    const std::vector<can_log::Record> replayed = can_sim::decode_log(second.data(), second.size());
+    CHECK_EQ(replayed.size(), rx.size());
+    if (replayed.size() != rx.size())
+        return;
+    for (size_t i = 0; i < rx.size(); ++i)
+    {
+        const can_log::Record& a = rx[i];
+        const can_log::Record& b = replayed[i];
+        CHECK(!b.tx);
+        CHECK_EQ(b.id, a.id);
+        CHECK_EQ(b.ext, a.ext);
+        CHECK_EQ(b.rtr, a.rtr);
+        CHECK_EQ(b.dlc, a.dlc);
+        if (!a.rtr)
+            CHECK(memcmp(a.data, b.data, a.dlc) == 0);
+        // 相对第一帧的时间一致，允许 1 us 的取整误差
+        const int64_t expected = static_cast<int64_t>(a.time_us - rx[0].time_us);
+        const int64_t actual   = static_cast<int64_t>(b.time_us - replayed[0].time_us);
+        CHECK(actual - expected <= 1 && expected - actual <= 1);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    setup();
+    RUN_TEST(test_record_round_trip);
+    RUN_TEST(test_restart_keeps_held_block);
+    RUN_TEST(test_deferred_rx_time);
+    RUN_TEST(test_replay_round_trip);
+    return host_test::result();
+}
@@ -0,0 +1,210 @@
+/**
+ * @file    test_can_rx_deferred.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   延迟接收模式在突发负载下的中断耗时、丢帧与分发延迟。
+ *
+ * - 慢回调：即时模式下回调在中断中执行，延迟模式下中断只拷贝帧，回调全部移到 CAN_Poll；
+ * - 突发超过帧池：丢帧数等于超出帧池（或队列）容量的帧数，已入队的帧按到达顺序分发；
+ * - 周期轮询：突发到达、每 500 us 调用一次 CAN_Poll，不丢帧，分发延迟不超过轮询周期。
+ *
+ * 中断的主机耗时只打印，不做断言；断言只针对确定的量（回调所在上下文、丢帧数、仿真时间）。
+ */
+#include "can_driver.hpp"
+#include "can_sim.hpp"
+#include "host_test.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace can_sim;
+
+namespace
+{
+
+Bus         bus(1000000);
+BxCan       can1(bus);
+VirtualNode peer(bus);
+
+// 延迟接收队列最多缓存的帧数受帧池与队列容量共同限制
+constexpr uint32_t RX_CAPACITY = std::min<uint32_t>(CAN_RX_POOL_SIZE, CAN_RX_QUEUE_SIZE - 1);
+
+uint64_t              slow_callback_ns;
+uint32_t              callbacks_in_isr;
+std::vector<uint32_t> received_seq;
+std::vector<uint64_t> frame_end_ns; // 按序号记录帧在总线上结束的时刻
+uint64_t              max_latency_ns;
+uint64_t              total_latency_ns;
+
+uint32_t sequence(const uint8_t* data)
+{
+    return static_cast<uint32_t>(data[0] | data[1] << 8);
+}
+
+void on_receive(const CAN_HandleTypeDef* /*hcan*/, const CAN_RxHeaderTypeDef* /*header*/, const uint8_t* data)
+{
+    if (in_interrupt())
+        ++callbacks_in_isr;
+    const uint32_t seq = sequence(data);
+    received_seq.push_back(seq);
+    if (seq < frame_end_ns.size())
+    {
+        const uint64_t latency = now_ns() - frame_end_ns[seq];
+        max_latency_ns         = std::max(max_latency_ns, latency);
+        total_latency_ns += latency;
+    }
+
+    // 模拟耗时的解码
+    const uint64_t until = detail::host_ns() + slow_callback_ns;
+    while (detail::host_ns() < until)
+    {
+    }
+}
+
+void reset()
+{
+    callbacks_in_isr = 0;
+    received_seq.clear();
+    frame_end_ns.clear();
+    max_latency_ns   = 0;
+    total_latency_ns = 0;
+    can1.reset_isr_stats();
+}
+
+void send_burst(const uint32_t first, const uint32_t count)
+{
+    Frame frame;
+    frame.id  = 0x100;
+    frame.dlc = 8;
+    for (uint32_t seq = first; seq < first + count; ++seq)
+    {
+        frame.data[0] = static_cast<uint8_t>(seq);
+        frame.data[1] = static_cast<uint8_t>(seq >> 8);
+        peer.send(frame);
+    }
+}
+
+void setup()
+{
+    can1.accept_all();
+    CAN_InitMainCallback(can1.handle());
+    CAN_RegisterCallback(can1.handle(), on_receive);
+    CAN_Start(can1.handle(), CAN_IT_RX_FIFO0_MSG_PENDING);
+
+    bus.set_monitor([](const Transfer& transfer) {
+        if (transfer.result != Transfer::Result::Ok)
+            return;
+        const uint32_t seq = sequence(transfer.frame.data);
+        if (frame_end_ns.size() <= seq)
+            frame_end_ns.resize(seq + 1);
+        frame_end_ns[seq] = transfer.end_ns;
+    });
+}
+
+void test_slow_callback_leaves_isr()
+{
+    constexpr uint32_t frames = 8;
+    slow_callback_ns          = 20000;
+
+    reset();
+    CAN_SetRxDeferred(can1.handle(), false);
+    send_burst(0, frames);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(callbacks_in_isr, frames);
+    const uint64_t immediate_max = can1.isr_stats().max_ns;
+
+    reset();
+    CAN_SetRxDeferred(can1.handle(), true);
+    send_burst(0, frames);
+    CHECK(bus.run_until_idle());
+    CHECK(received_seq.empty());
+    const uint64_t deferred_max = can1.isr_stats().max_ns;
+    CHECK_EQ(CAN_Poll(can1.handle(), 0), static_cast<size_t>(frames));
+    CHECK_EQ(callbacks_in_isr, 0U);
+    CHECK_EQ(received_seq.size(), static_cast<size_t>(frames));
+
+    std::printf("slow callback %llu ns: isr_ns_max immediate=%llu deferred=%llu\n",
+                static_cast<unsigned long long>(slow_callback_ns),
+                static_cast<unsigned long long>(immediate_max),
+                static_cast<unsigned long long>(deferred_max));
+    slow_callback_ns = 0;
+}
+
+void test_burst_exceeding_capacity()
+{
+    constexpr uint32_t burst = RX_CAPACITY + 24;
+
+    reset();
+    CAN_SetRxDeferred(can1.handle(), true);
+    const uint32_t dropped = CAN_GetRxDropCount(can1.handle());
+    CAN_Stats      before{};
+    CHECK(CAN_GetStats(can1.handle(), &before));
+
+    // 整个突发期间不分发：容量以内的帧入队，其余帧在中断中取出后丢弃，硬件 FIFO 不会溢出
+    send_burst(0, burst);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(CAN_GetRxDropCount(can1.handle()) - dropped, burst - RX_CAPACITY);
+
+    CAN_Stats after{};
+    CHECK(CAN_GetStats(can1.handle(), &after));
+    CHECK_EQ(after.rx_dropped - before.rx_dropped, burst - RX_CAPACITY);
+    CHECK_EQ(after.rx_overrun[0], before.rx_overrun[0]);
+    CHECK_EQ(after.rx_fifo[0] - before.rx_fifo[0], burst);
+
+    CHECK_EQ(CAN_Poll(can1.handle(), 0), static_cast<size_t>(RX_CAPACITY));
+    CHECK_EQ(received_seq.size(), static_cast<size_t>(RX_CAPACITY));
+    for (uint32_t i = 0; i < received_seq.size(); ++i)
+        CHECK_EQ(received_seq[i], i);
+
+    std::printf("burst %u frames: dropped=%u isr_ns_max=%llu\n",
+                burst,
+                burst - RX_CAPACITY,
+                static_cast<unsigned long long>(can1.isr_stats().max_ns));
+}
+
+void test_periodic_poll_latency()
+{
+    constexpr uint64_t poll_ns = 500000;
+    constexpr uint32_t ticks   = 100;
+    constexpr uint32_t burst   = 6; // 每个 1 ms 控制周期 6 个节点同时回复
+
+    reset();
+    CAN_SetRxDeferred(can1.handle(), true);
+    const uint32_t dropped = CAN_GetRxDropCount(can1.handle());
+
+    for (uint32_t tick = 0; tick < ticks; ++tick)
+    {
+        send_burst(tick * burst, burst);
+        for (int i = 0; i < 2; ++i)
+        {
+            bus.run_for(poll_ns);
+            (void) CAN_Poll(can1.handle(), 0);
+        }
+    }
+    CHECK(bus.run_until_idle());
+    (void) CAN_Poll(can1.handle(), 0);
+
+    CHECK_EQ(CAN_GetRxDropCount(can1.handle()) - dropped, 0U);
+    CHECK_EQ(received_seq.size(), static_cast<size_t>(ticks * burst));
+    CHECK_EQ(callbacks_in_isr, 0U);
+    // 帧结束后最迟在下一次轮询中分发
+    CHECK(max_latency_ns <= poll_ns);
+
+    std::printf("poll every %llu us: latency avg=%.1f us max=%.1f us isr_ns_max=%llu\n",
+                static_cast<unsigned long long>(poll_ns / 1000),
+                received_seq.empty() ? 0.0 : total_latency_ns / 1000.0 / received_seq.size(),
+                max_latency_ns / 1000.0,
+                static_cast<unsigned long long>(can1.isr_stats().max_ns));
+}
+
+} // namespace
+
+int main()
+{
+    setup();
+    RUN_TEST(test_slow_callback_leaves_isr);
+    RUN_TEST(test_burst_exceeding_capacity);
+    RUN_TEST(test_periodic_poll_latency);
+    return host_test::result();
+}
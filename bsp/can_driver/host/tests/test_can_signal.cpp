@@ -0,0 +1,219 @@
+/**
+ * @file    test_can_signal.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   can_signal.hpp 的主机测试：与手写移位解码逐帧对照、符号扩展、打包保留其余位、to_raw 舍入与饱和。
+ */
+#include "can_signal.hpp"
+#include "host_test.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+
+using namespace can_signal;
+
+namespace
+{
+
+using Angle   = Signal<7, 16, ByteOrder::Motorola>;
+using Speed   = Signal<23, 16, ByteOrder::Motorola, true>;
+using Current = Signal<39, 16, ByteOrder::Motorola, true, std::ratio<20, 16384>>;
+using Temp    = Signal<55, 8, ByteOrder::Motorola>;
+
+struct Feedback
+{
+    uint16_t angle;
+    int16_t  rpm;
+    float    current;
+    uint8_t  temperature;
+};
+
+using FeedbackFrame = Message<Field<&Feedback::angle, Angle>,
+                              Field<&Feedback::rpm, Speed>,
+                              Field<&Feedback::current, Current>,
+                              Field<&Feedback::temperature, Temp>>;
+
+// 编译期即可求值
+constexpr uint8_t kFrame[8] = { 0x12, 0x34, 0xFF, 0x38, 0x80, 0x00, 0x2A, 0x00 };
+static_assert(Angle::unpack_raw(kFrame) == 0x1234);
+static_assert(Speed::unpack_raw(kFrame) == -200);
+static_assert(Current::unpack_raw(kFrame) == -32768);
+static_assert(Temp::unpack_raw(kFrame) == 42);
+static_assert(Signal<0, 12>::unpack_raw(kFrame) == 0x412);
+static_assert(Signal<0, 64>::raw_max == std::numeric_limits<uint64_t>::max());
+static_assert(Signal<0, 64, ByteOrder::Intel, true>::raw_min == std::numeric_limits<int64_t>::min());
+
+// 手写解码，与电机驱动里常见的写法一致
+Feedback decode_by_hand(const uint8_t* data)
+{
+    Feedback fb{};
+    fb.angle       = static_cast<uint16_t>(data[0] << 8 | data[1]);
+    fb.rpm         = static_cast<int16_t>(data[2] << 8 | data[3]);
+    fb.current     = static_cast<float>(static_cast<int16_t>(data[4] << 8 | data[5])) * (20.0f / 16384.0f);
+    fb.temperature = data[6];
+    return fb;
+}
+
+void test_unpack_matches_hand_written_decode()
+{
+    std::mt19937 rng(1);
+    for (int n = 0; n < 10000; ++n)
+    {
+        uint8_t data[8];
+        for (auto& b : data)
+            b = static_cast<uint8_t>(rng());
+
+        Feedback fb{};
+        FeedbackFrame::unpack(data, fb);
+        const Feedback expected = decode_by_hand(data);
+        CHECK_EQ(fb.angle, expected.angle);
+        CHECK_EQ(fb.rpm, expected.rpm);
+        CHECK(fb.current == expected.current);
+        CHECK_EQ(fb.temperature, expected.temperature);
+    }
+}
+
+void test_sign_extension()
+{
+    uint8_t data[8] = {};
+    // Intel 3 位有符号，位 5..7
+    using S3 = Signal<5, 3, ByteOrder::Intel, true>;
+    for (int v = -4; v < 4; ++v)
+    {
+        S3::pack_raw(data, v);
+        CHECK_EQ(S3::unpack_raw(data), v);
+    }
+    // 64 位有符号整帧
+    using S64 = Signal<0, 64, ByteOrder::Intel, true>;
+    S64::pack_raw(data, std::numeric_limits<int64_t>::min());
+    CHECK_EQ(S64::unpack_raw(data), std::numeric_limits<int64_t>::min());
+    CHECK_EQ(data[7], 0x80);
+    // 跨字节的 Motorola 12 位有符号：起始位 3（字节 0 位 3）向下延伸到字节 1
+    using M12 = Signal<3, 12, ByteOrder::Motorola, true>;
+    std::memset(data, 0, sizeof(data));
+    M12::pack_raw(data, -1);
+    CHECK_EQ(data[0], 0x0F);
+    CHECK_EQ(data[1], 0xFF);
+    CHECK_EQ(data[2], 0x00);
+    CHECK_EQ(M12::unpack_raw(data), -1);
+}
+
+void test_pack_keeps_other_bits()
+{
+    std::mt19937 rng(2);
+    for (int n = 0; n < 1000; ++n)
+    {
+        uint8_t data[8];
+        for (auto& b : data)
+            b = static_cast<uint8_t>(rng());
+        uint8_t before[8];
+        std::memcpy(before, data, sizeof(data));
+
+        const auto speed = static_cast<int32_t>(static_cast<int16_t>(rng()));
+        Speed::pack_raw(data, speed);
+        CHECK_EQ(Speed::unpack_raw(data), speed);
+        // Speed 只占字节 2、3
+        for (const int i : { 0, 1, 4, 5, 6, 7 })
+            CHECK_EQ(data[i], before[i]);
+
+        using Mid = Signal<13, 9>; // Intel，位 13..21，跨字节 1、2
+        std::memcpy(before, data, sizeof(data));
+        const uint32_t mid = rng() & Mid::mask;
+        Mid::pack_raw(data, mid);
+        CHECK_EQ(Mid::unpack_raw(data), mid);
+        CHECK_EQ(data[1] & 0x1F, before[1] & 0x1F);
+        CHECK_EQ(data[2] & 0xC0, before[2] & 0xC0);
+        for (const int i : { 0, 3, 4, 5, 6, 7 })
+            CHECK_EQ(data[i], before[i]);
+    }
+}
+
+void test_message_round_trip()
+{
+    const Feedback in{ 0xBEEF, -1234, -3.5f, 77 };
+    uint8_t        data[8] = { 0, 0, 0, 0, 0, 0, 0, 0x5A };
+    FeedbackFrame::pack(in, data);
+    CHECK_EQ(data[0], 0xBE);
+    CHECK_EQ(data[1], 0xEF);
+    CHECK_EQ(data[7], 0x5A); // 没有字段覆盖的字节保持不变
+
+    Feedback out{};
+    FeedbackFrame::unpack(data, out);
+    CHECK_EQ(out.angle, in.angle);
+    CHECK_EQ(out.rpm, in.rpm);
+    CHECK_EQ(out.temperature, in.temperature);
+    // -3.5 A 对应原始值 -2867.2，舍入到 -2867
+    CHECK_EQ(Current::unpack_raw(data), -2867);
+    CHECK(std::fabs(out.current - in.current) <= Current::scale / 2);
+}
+
+void test_to_raw_rounds_half_away_from_zero()
+{
+    using S8 = Signal<0, 8, ByteOrder::Intel, true>;
+    CHECK_EQ(S8::to_raw(2.5f), 3);
+    CHECK_EQ(S8::to_raw(-2.5f), -3);
+    CHECK_EQ(S8::to_raw(2.49f), 2);
+    CHECK_EQ(S8::to_raw(-127.6f), -128);
+    CHECK_EQ(S8::to_raw(126.5f), 127);
+    CHECK_EQ(Current::to_raw(1.0f), 819); // 819.2
+    CHECK_EQ(Current::to_raw(-1.0f), -819);
+
+    // 24 位：2^23 以上 float 已不能表示 x.5，改用 double 后仍按整数保留
+    using U24 = Signal<0, 24>;
+    CHECK_EQ(U24::to_raw(16777214.0f), 16777214u);
+    CHECK_EQ(U24::to_raw(8388609.0f), 8388609u);
+}
+
+template <typename Sig> void check_saturation()
+{
+    using raw_type = typename Sig::raw_type;
+    CHECK(Sig::to_raw(1e30f) == Sig::raw_max);
+    CHECK(Sig::to_raw(std::numeric_limits<float>::infinity()) == Sig::raw_max);
+    CHECK(Sig::to_raw(-1e30f) == Sig::raw_min);
+    CHECK(Sig::to_raw(-std::numeric_limits<float>::infinity()) == Sig::raw_min);
+    CHECK(Sig::to_raw(std::numeric_limits<float>::quiet_NaN()) == Sig::raw_min);
+    // 刚好是边界值（转 float 后可能被向上取整）
+    CHECK(Sig::to_raw(static_cast<float>(Sig::raw_max)) == Sig::raw_max);
+    CHECK(Sig::to_raw(static_cast<float>(Sig::raw_min)) == Sig::raw_min);
+    CHECK(Sig::to_raw(0.0f) == raw_type{ 0 });
+}
+
+void test_to_raw_saturates_every_width()
+{
+    check_saturation<Signal<0, 8>>();
+    check_saturation<Signal<0, 8, ByteOrder::Intel, true>>();
+    check_saturation<Signal<0, 23>>();
+    check_saturation<Signal<0, 25>>();
+    check_saturation<Signal<0, 25, ByteOrder::Intel, true>>();
+    check_saturation<Signal<0, 32>>();
+    check_saturation<Signal<0, 32, ByteOrder::Intel, true>>();
+    check_saturation<Signal<0, 40, ByteOrder::Intel, true>>();
+    check_saturation<Signal<0, 64>>();
+    check_saturation<Signal<0, 64, ByteOrder::Intel, true>>();
+    check_saturation<Current>();
+
+    // 32 位边界附近：2^32 - 1 转 float 得 2^32，仍然饱和到 raw_max 而不是回绕为 0
+    using U32 = Signal<0, 32>;
+    using U64 = Signal<0, 64>;
+    using S64 = Signal<0, 64, ByteOrder::Intel, true>;
+    CHECK_EQ(U32::to_raw(4294967040.0f), 4294967040u);
+    CHECK_EQ(U32::to_raw(4294967296.0f), 4294967295u);
+    CHECK(U64::to_raw(1e19f) == static_cast<uint64_t>(1e19f));
+    CHECK_EQ(S64::to_raw(-9.3e18f), std::numeric_limits<int64_t>::min());
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_unpack_matches_hand_written_decode);
+    RUN_TEST(test_sign_extension);
+    RUN_TEST(test_pack_keeps_other_bits);
+    RUN_TEST(test_message_round_trip);
+    RUN_TEST(test_to_raw_rounds_half_away_from_zero);
+    RUN_TEST(test_to_raw_saturates_every_width);
+    return host_test::result();
+}
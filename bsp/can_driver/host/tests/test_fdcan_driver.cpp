@@ -0,0 +1,571 @@
+/**
+ * @file    test_fdcan_driver.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   can_driver 的 FDCAN 后端在 FDCAN 仿真上的收发、软件发送队列、取消、bus-off 恢复与过滤路由测试。
+ */
+#include "can_driver.hpp"
+#include "can_sim.hpp"
+#include "cmsis_compiler.h"
+#include "host_test.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace can_sim;
+
+namespace
+{
+
+// 驱动的回调表是全局的，整个测试程序共用一条总线和一个控制器；仲裁段 1 Mbit/s，数据段 5 Mbit/s
+Bus         bus(1000000, 5000000);
+FdCan       can1(bus);
+VirtualNode peer(bus);
+
+std::vector<uint32_t> received_ids;
+std::vector<uint32_t> id_callback_ids;
+
+void on_receive(const FDCAN_HandleTypeDef* hcan, const FDCAN_RxHeaderTypeDef* header, const uint8_t* data)
+{
+    (void) hcan;
+    (void) data;
+    received_ids.push_back(header->Identifier);
+}
+
+void on_id(const FDCAN_HandleTypeDef* hcan, const FDCAN_RxHeaderTypeDef* header, const uint8_t* data, void* ctx)
+{
+    (void) hcan;
+    (void) data;
+    (void) ctx;
+    id_callback_ids.push_back(header->Identifier);
+}
+
+struct TxResult
+{
+    CAN_TxTicket ticket;
+    CAN_TxStatus status;
+};
+std::vector<TxResult> tx_results;
+
+void on_tx_complete(const FDCAN_HandleTypeDef* hcan, const CAN_TxTicket ticket, const CAN_TxStatus status, void* ctx)
+{
+    (void) hcan;
+    (void) ctx;
+    tx_results.push_back({ ticket, status });
+}
+
+void setup()
+{
+    CAN_InitMainCallback(can1.handle());
+    CAN_RegisterCallback(can1.handle(), on_receive);
+    (void) CAN_RegisterIdCallback(can1.handle(), 0x321, 0x7FF, on_id, nullptr);
+    CAN_SetTxCompleteCallback(can1.handle(), on_tx_complete, nullptr);
+    CAN_Start(can1.handle(), FDCAN_IT_RX_FIFO0_NEW_MESSAGE);
+}
+
+void test_send_and_receive()
+{
+    peer.clear_received();
+    received_ids.clear();
+    id_callback_ids.clear();
+
+    const CAN_TxHeader header  = CAN_MakeDataHeader(0x123, false, 8);
+    const uint8_t      data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    CAN_TxTicket       ticket  = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendMessage(can1.handle(), &header, data, &ticket) != CAN_SEND_FAILED);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 1U);
+    CHECK_EQ(peer.received()[0].frame.id, 0x123U);
+    CHECK(!peer.received()[0].frame.fd);
+    CHECK_EQ(peer.received()[0].frame.data[7], 8);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+
+    Frame frame;
+    frame.id  = 0x321;
+    frame.dlc = 2;
+    peer.send(frame);
+    frame.id  = 0x1234567;
+    frame.ext = true;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(received_ids.size(), 2U);
+    CHECK_EQ(received_ids[0], 0x321U);
+    CHECK_EQ(received_ids[1], 0x1234567U);
+    CHECK_EQ(id_callback_ids.size(), 1U);
+}
+
+void test_fd_frame_with_bit_rate_switch()
+{
+    peer.clear_received();
+    received_ids.clear();
+
+    FDCAN_TxHeaderTypeDef header = CAN_MakeDataHeader(0x200, false, 8);
+    header.FDFormat              = FDCAN_FD_CAN;
+    header.BitRateSwitch         = FDCAN_BRS_ON;
+    header.DataLength            = CAN_LengthToDlc(64);
+    uint8_t data[64];
+    for (size_t i = 0; i < sizeof(data); ++i)
+        data[i] = static_cast<uint8_t>(i);
+    CHECK(CAN_SendMessage(can1.handle(), &header, data) != CAN_SEND_FAILED);
+    CHECK(bus.run_until_idle());
+
+    CHECK_EQ(peer.received().size(), 1U);
+    const VirtualNode::Received& rx = peer.received()[0];
+    CHECK(rx.frame.fd);
+    CHECK(rx.frame.brs);
+    CHECK_EQ(frame_length(rx.frame), 64U);
+    CHECK_EQ(rx.frame.data[63], 63);
+    // 数据段按 5 Mbit/s 计时，比不切换波特率的同一帧短
+    CHECK_EQ(rx.end_ns - rx.sof_ns, bus.frame_ns(rx.frame));
+    Frame slow = rx.frame;
+    slow.brs   = false;
+    CHECK(bus.frame_ns(rx.frame) * 2 < bus.frame_ns(slow));
+
+    // 对端发出的 FD 帧按 64 字节交给回调
+    Frame frame = rx.frame;
+    frame.id    = 0x201;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(received_ids.size(), 1U);
+}
+
+void test_fifo_full_queues_and_abort_pending()
+{
+    peer.clear_received();
+    tx_results.clear();
+
+    // FIFO 模式按请求顺序发送；3 个 TX Buffer 装满后进入软件发送队列
+    CAN_TxTicket tickets[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        const CAN_TxHeader header  = CAN_MakeDataHeader(0x300 - i * 0x100, false, 1);
+        const uint8_t      data[8] = { static_cast<uint8_t>(i) };
+        CHECK(CAN_SendMessage(can1.handle(), &header, data, &tickets[i]) != CAN_SEND_FAILED);
+    }
+    const CAN_TxHeader header  = CAN_MakeDataHeader(0x50, false, 1);
+    const uint8_t      data[8] = {};
+    CAN_TxTicket       ticket  = CAN_TX_TICKET_INVALID;
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &header, data, &ticket), static_cast<uint32_t>(CAN_SEND_QUEUED));
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_QUEUED);
+
+    // 取消最后一帧：尚未开始发送，立即以 ABORTED 结束。FIFO 模式的放入位置按环形前进，
+    // 队列中的帧等放入位置上的 Buffer 发完后补入
+    const uint32_t last = HAL_FDCAN_GetLatestTxFifoQRequestBuffer(can1.handle());
+    CHECK(HAL_FDCAN_AbortTxRequest(can1.handle(), last) == HAL_OK);
+    CHECK(CAN_GetTxStatus(can1.handle(), tickets[2]) == CAN_TX_STATUS_ABORTED);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_QUEUED);
+
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 3U);
+    CHECK_EQ(peer.received()[0].frame.id, 0x300U);
+    CHECK_EQ(peer.received()[1].frame.id, 0x200U);
+    CHECK_EQ(peer.received()[2].frame.id, 0x50U);
+    CHECK(CAN_GetTxStatus(can1.handle(), tickets[0]) == CAN_TX_STATUS_SENT);
+    CHECK(CAN_GetTxStatus(can1.handle(), tickets[1]) == CAN_TX_STATUS_SENT);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+    CHECK_EQ(tx_results.size(), 4U);
+}
+
+// Buffer 占满后软件队列按仲裁优先级发送；队列已满时按 CAN_SetTxDropPolicy 丢弃优先级最低的帧或拒绝新帧
+void test_queue_order_and_drop_policy()
+{
+    peer.clear_received();
+    tx_results.clear();
+
+    const uint8_t data[8] = {};
+    for (uint32_t i = 0; i < CAN_FD_TX_BUFFER_NUM; ++i)
+    {
+        const CAN_TxHeader header = CAN_MakeDataHeader(0x700 + i, false, 8);
+        CHECK(CAN_SendMessage(can1.handle(), &header, data) != CAN_SEND_FAILED);
+    }
+    CAN_TxTicket queued[CAN_TX_QUEUE_SIZE];
+    for (uint32_t i = 0; i < CAN_TX_QUEUE_SIZE; ++i)
+    {
+        const CAN_TxHeader header = CAN_MakeDataHeader(0x680 - i * 0x10, false, 8);
+        CHECK_EQ(CAN_SendMessage(can1.handle(), &header, data, &queued[i]), static_cast<uint32_t>(CAN_SEND_QUEUED));
+    }
+
+    // 默认丢弃队列中优先级最低的帧
+    const CAN_TxHeader urgent = CAN_MakeDataHeader(0x10, false, 8);
+    CAN_TxTicket       ticket = CAN_TX_TICKET_INVALID;
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &urgent, data, &ticket), static_cast<uint32_t>(CAN_SEND_QUEUED));
+    CHECK(CAN_GetTxStatus(can1.handle(), queued[0]) == CAN_TX_STATUS_DROPPED);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_QUEUED);
+
+    // 新帧优先级最低时丢弃新帧
+    const CAN_TxHeader low = CAN_MakeDataHeader(0x7FF, false, 8);
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &low, data, &ticket), static_cast<uint32_t>(CAN_SEND_FAILED));
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_DROPPED);
+
+    // 拒绝新帧时即使新帧更紧急也不挤出队列中的帧
+    CAN_SetTxDropPolicy(can1.handle(), CAN_TX_REJECT_NEW);
+    const CAN_TxHeader urgent2 = CAN_MakeDataHeader(0x11, false, 8);
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &urgent2, data, &ticket), static_cast<uint32_t>(CAN_SEND_FAILED));
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_DROPPED);
+    CHECK(CAN_GetTxStatus(can1.handle(), queued[1]) == CAN_TX_STATUS_QUEUED);
+    CAN_SetTxDropPolicy(can1.handle(), CAN_TX_DROP_LOWEST_PRIORITY);
+
+    CHECK(bus.run_until_idle());
+    const std::vector<VirtualNode::Received>& rx = peer.received();
+    CHECK_EQ(rx.size(), static_cast<size_t>(CAN_FD_TX_BUFFER_NUM + CAN_TX_QUEUE_SIZE));
+    // Buffer 中的帧先按请求顺序发出，之后队列中的帧按 ID 从小到大发出
+    for (size_t i = 0; i < CAN_FD_TX_BUFFER_NUM; ++i)
+        CHECK_EQ(rx[i].frame.id, 0x700U + i);
+    CHECK_EQ(rx[CAN_FD_TX_BUFFER_NUM].frame.id, 0x10U);
+    for (size_t i = CAN_FD_TX_BUFFER_NUM + 1; i < rx.size(); ++i)
+        CHECK(rx[i - 1].frame.id < rx[i].frame.id);
+    for (size_t i = 1; i < CAN_TX_QUEUE_SIZE; ++i)
+        CHECK(CAN_GetTxStatus(can1.handle(), queued[i]) == CAN_TX_STATUS_SENT);
+}
+
+// 同一 ID 的最新值覆盖队列或 Buffer 中尚未发出的旧值，总线上只出现最后一个值
+void test_send_latest()
+{
+    peer.clear_received();
+    tx_results.clear();
+
+    // Buffer 空闲：旧值已装入 Buffer、尚未开始发送，新值取消它并重新装入
+    const CAN_TxHeader header = CAN_MakeDataHeader(0x20, false, 1);
+    uint8_t            data[8] = { 1 };
+    CAN_TxTicket       first   = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendLatest(can1.handle(), &header, data, &first) != CAN_SEND_FAILED);
+    CHECK(CAN_GetTxStatus(can1.handle(), first) == CAN_TX_STATUS_PENDING);
+    data[0]             = 2;
+    CAN_TxTicket second = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendLatest(can1.handle(), &header, data, &second) != CAN_SEND_FAILED);
+    CHECK(CAN_GetTxStatus(can1.handle(), first) == CAN_TX_STATUS_REPLACED);
+    CHECK(CAN_GetTxStatus(can1.handle(), second) == CAN_TX_STATUS_PENDING);
+
+    // Buffer 占满：新值在队列中原位覆盖旧值
+    const uint8_t filler[8] = {};
+    for (uint32_t i = 0; i + 1 < CAN_FD_TX_BUFFER_NUM; ++i)
+    {
+        const CAN_TxHeader busy = CAN_MakeDataHeader(0x700 + i, false, 8);
+        CHECK(CAN_SendMessage(can1.handle(), &busy, filler) != CAN_SEND_FAILED);
+    }
+    const CAN_TxHeader other = CAN_MakeDataHeader(0x30, false, 1);
+    data[0]                  = 3;
+    CAN_TxTicket third       = CAN_TX_TICKET_INVALID;
+    CHECK_EQ(CAN_SendLatest(can1.handle(), &other, data, &third), static_cast<uint32_t>(CAN_SEND_QUEUED));
+    data[0]             = 4;
+    CAN_TxTicket fourth = CAN_TX_TICKET_INVALID;
+    CHECK_EQ(CAN_SendLatest(can1.handle(), &other, data, &fourth), static_cast<uint32_t>(CAN_SEND_QUEUED));
+    CHECK(CAN_GetTxStatus(can1.handle(), third) == CAN_TX_STATUS_REPLACED);
+    CHECK(CAN_GetTxStatus(can1.handle(), fourth) == CAN_TX_STATUS_QUEUED);
+
+    CHECK(bus.run_until_idle());
+    std::vector<uint32_t> values;
+    for (const VirtualNode::Received& rx : peer.received())
+        if (rx.frame.id == 0x20 || rx.frame.id == 0x30)
+            values.push_back(rx.frame.data[0]);
+    CHECK_EQ(values.size(), 2U);
+    CHECK_EQ(values[0], 2U);
+    CHECK_EQ(values[1], 4U);
+    CHECK(CAN_GetTxStatus(can1.handle(), second) == CAN_TX_STATUS_SENT);
+    CHECK(CAN_GetTxStatus(can1.handle(), fourth) == CAN_TX_STATUS_SENT);
+    CHECK_EQ(std::count_if(tx_results.begin(),
+                           tx_results.end(),
+                           [](const TxResult& r) { return r.status == CAN_TX_STATUS_REPLACED; }),
+             2);
+}
+
+// 令牌桶：突发 burst 帧之后按 frames_per_second 补充，超出的帧不进入队列
+void test_rate_limit()
+{
+    peer.clear_received();
+    CHECK(CAN_SetRateLimit(can1.handle(), FDCAN_STANDARD_ID, 0x600, 0x6FF, 100, 2));
+    CHECK(!CAN_SetRateLimit(can1.handle(), FDCAN_STANDARD_ID, 0x6FF, 0x600, 100, 2));
+
+    const CAN_TxHeader header  = CAN_MakeDataHeader(0x610, false, 8);
+    const uint8_t      data[8] = {};
+    for (int i = 0; i < 2; ++i)
+        CHECK(CAN_SendMessage(can1.handle(), &header, data) != CAN_SEND_FAILED);
+    CAN_TxTicket ticket = CAN_TX_TICKET_INVALID;
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &header, data, &ticket), static_cast<uint32_t>(CAN_SEND_FAILED));
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_RATE_LIMITED);
+
+    // 范围外的 ID 不受限制
+    const CAN_TxHeader free = CAN_MakeDataHeader(0x700, false, 8);
+    CHECK(CAN_SendMessage(can1.handle(), &free, data) != CAN_SEND_FAILED);
+
+    // 10 ms 补充一帧
+    CHECK(bus.run_until_idle());
+    bus.run_for(10000000);
+    CHECK(CAN_SendMessage(can1.handle(), &header, data, &ticket) != CAN_SEND_FAILED);
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &header, data), static_cast<uint32_t>(CAN_SEND_FAILED));
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 4U);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+}
+
+// 整批只进入一次临界区，Buffer 占满后的帧进入软件队列
+void test_send_batch()
+{
+    peer.clear_received();
+
+    CAN_BasicMessage<8> msgs[5];
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        msgs[i].header  = CAN_MakeDataHeader(0x500 + i, false, 8);
+        msgs[i].data[0] = static_cast<uint8_t>(i);
+    }
+    uint32_t     buffers[5];
+    CAN_TxTicket tickets[5];
+    masked_stats().reset();
+    CHECK_EQ(CAN_SendBatch(can1.handle(), msgs, 5, buffers, tickets), 5U);
+    CHECK_EQ(masked_stats().count, 1U);
+    for (uint32_t i = 0; i < 5; ++i)
+        CHECK_EQ(buffers[i] == CAN_SEND_QUEUED, i >= CAN_FD_TX_BUFFER_NUM);
+
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 5U);
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        CHECK_EQ(peer.received()[i].frame.id, 0x500U + i);
+        CHECK_EQ(peer.received()[i].frame.data[0], i);
+        CHECK(CAN_GetTxStatus(can1.handle(), tickets[i]) == CAN_TX_STATUS_SENT);
+    }
+}
+
+void test_abort_while_transmitting()
+{
+    peer.clear_received();
+    tx_results.clear();
+
+    const CAN_TxHeader header  = CAN_MakeDataHeader(0x400, false, 8);
+    const uint8_t      data[8] = {};
+    CAN_TxTicket       ticket  = CAN_TX_TICKET_INVALID;
+    const uint32_t     buffer  = CAN_SendMessage(can1.handle(), &header, data, &ticket);
+    CHECK(buffer != CAN_SEND_FAILED);
+
+    // 帧已在总线上时取消：帧照常发出，TXBTO 与 TXBCF 同时置位，按发送成功只报告一次
+    bus.run_for(10000);
+    CHECK(bus.transferring());
+    CHECK(HAL_FDCAN_AbortTxRequest(can1.handle(), buffer) == HAL_OK);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_PENDING);
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 1U);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+    CHECK_EQ(tx_results.size(), 1U);
+    CHECK(tx_results[0].status == CAN_TX_STATUS_SENT);
+}
+
+// 3 帧发完时发送完成中断被屏蔽，再发送 3 帧会依次复用这些 Buffer：写 TXBAR 清除 TXBTO 之前旧票据必须先结束，
+// 每个票据恰好通知一次
+void test_reuse_buffer_with_masked_irq()
+{
+    peer.clear_received();
+    tx_results.clear();
+
+    std::vector<CAN_TxTicket> tickets;
+    const uint8_t             data[8] = {};
+    __disable_irq();
+    for (uint32_t i = 0; i < 2 * CAN_FD_TX_BUFFER_NUM; ++i)
+    {
+        const CAN_TxHeader header = CAN_MakeDataHeader(0x100 + i, false, 8);
+        CAN_TxTicket       ticket = CAN_TX_TICKET_INVALID;
+        CHECK(CAN_SendMessage(can1.handle(), &header, data, &ticket) != CAN_SEND_FAILED);
+        tickets.push_back(ticket);
+        if (i + 1 == CAN_FD_TX_BUFFER_NUM)
+            CHECK(bus.run_until_idle());
+    }
+    // 前 3 帧在复用 Buffer 时结束
+    CHECK_EQ(tx_results.size(), static_cast<size_t>(CAN_FD_TX_BUFFER_NUM));
+    for (uint32_t i = 0; i < CAN_FD_TX_BUFFER_NUM; ++i)
+        CHECK(CAN_GetTxStatus(can1.handle(), tickets[i]) == CAN_TX_STATUS_SENT);
+    __enable_irq();
+
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), tickets.size());
+    CHECK_EQ(tx_results.size(), tickets.size());
+    for (const CAN_TxTicket ticket : tickets)
+    {
+        CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+        CHECK_EQ(std::count_if(tx_results.begin(),
+                               tx_results.end(),
+                               [ticket](const TxResult& r) { return r.ticket == ticket && r.status == CAN_TX_STATUS_SENT; }),
+                 1);
+    }
+}
+
+void test_bus_off_recovery()
+{
+    const CAN_TxHeader header  = CAN_MakeDataHeader(0x10, false, 8);
+    const uint8_t      data[8] = {};
+
+    // 自动恢复：bus-off 中断中退出初始化模式，129 × 11 个隐性位后重新加入总线并继续发送
+    peer.clear_received();
+    CAN_SetBusOffRecovery(can1.handle(), CAN_BUS_OFF_RECOVERY_AUTO);
+    can1.inject_tx_errors(32);
+    CAN_TxTicket ticket = CAN_TX_TICKET_INVALID;
+    CHECK(CAN_SendMessage(can1.handle(), &header, data, &ticket) != CAN_SEND_FAILED);
+    CHECK(bus.run_until_idle(10000000));
+    CHECK(!can1.bus_off());
+    CHECK_EQ(peer.received().size(), 1U);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+
+    // 手动恢复：停留在 bus-off，直到调用 CAN_RecoverBusOff
+    peer.clear_received();
+    CAN_SetBusOffRecovery(can1.handle(), CAN_BUS_OFF_RECOVERY_MANUAL);
+    can1.inject_tx_errors(32);
+    CHECK(CAN_SendMessage(can1.handle(), &header, data, &ticket) != CAN_SEND_FAILED);
+    bus.run_for(10000000);
+    CHECK(can1.bus_off());
+    CHECK(CAN_GetErrorState(can1.handle(), nullptr, nullptr) == CAN_BUS_OFF);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_PENDING);
+
+    const uint64_t start = now_ns();
+    CHECK(CAN_RecoverBusOff(can1.handle()));
+    CHECK(bus.run_until_idle(10000000));
+    CHECK(!can1.bus_off());
+    CHECK(now_ns() - start >= bus.bits_ns(129 * 11));
+    CHECK(CAN_GetErrorState(can1.handle(), nullptr, nullptr) == CAN_ERROR_ACTIVE);
+    CHECK_EQ(peer.received().size(), 1U);
+    CHECK(CAN_GetTxStatus(can1.handle(), ticket) == CAN_TX_STATUS_SENT);
+    CAN_SetBusOffRecovery(can1.handle(), CAN_BUS_OFF_RECOVERY_AUTO);
+}
+
+void test_queue_mode_priority()
+{
+    // 重新初始化为 Queue 模式：硬件按 ID 仲裁优先级发送
+    CHECK(HAL_FDCAN_Stop(can1.handle()) == HAL_OK);
+    can1.handle()->Init.TxFifoQueueMode = FDCAN_TX_QUEUE_OPERATION;
+    CHECK(HAL_FDCAN_Init(can1.handle()) == HAL_OK);
+    CAN_Start(can1.handle(), FDCAN_IT_RX_FIFO0_NEW_MESSAGE);
+
+    peer.clear_received();
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        const CAN_TxHeader header  = CAN_MakeDataHeader(0x300 - i * 0x100, false, 1);
+        const uint8_t      data[8] = {};
+        CHECK(CAN_SendMessage(can1.handle(), &header, data) != CAN_SEND_FAILED);
+    }
+    // 队列中的 0x50 在第一个 Buffer 空出时补入，仍按优先级先于 Buffer 中的 0x200、0x300 发出
+    const CAN_TxHeader header  = CAN_MakeDataHeader(0x50, false, 1);
+    const uint8_t      data[8] = {};
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &header, data), static_cast<uint32_t>(CAN_SEND_QUEUED));
+
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 4U);
+    CHECK_EQ(peer.received()[0].frame.id, 0x100U);
+    CHECK_EQ(peer.received()[1].frame.id, 0x50U);
+    CHECK_EQ(peer.received()[2].frame.id, 0x200U);
+    CHECK_EQ(peer.received()[3].frame.id, 0x300U);
+}
+
+// Queue 模式下相同 ID 的 Buffer 按编号发送：新帧不能装入编号更小的空 Buffer 而越过先提交的同 ID 帧
+void test_queue_mode_same_id_order()
+{
+    peer.clear_received();
+
+    const uint8_t      data[8] = {};
+    const CAN_TxHeader high    = CAN_MakeDataHeader(0x100, false, 8);
+    const CAN_TxHeader same    = CAN_MakeDataHeader(0x200, false, 1);
+    // Buffer 0 / 1 / 2 依次装入 0x100、0x200(0)、0x200(1)；0x100 发完后 Buffer 0 空出
+    CHECK(CAN_SendMessage(can1.handle(), &high, data) != CAN_SEND_FAILED);
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        const uint8_t seq[8] = { i };
+        CHECK(CAN_SendMessage(can1.handle(), &same, seq) != CAN_SEND_FAILED);
+    }
+    bus.run_for(bus.frame_ns(Frame{ 0x100, false, false, 8 }) + 1000);
+    CHECK_EQ(peer.received().size(), 1U);
+
+    // 第 3 帧 0x200 应当排在 Buffer 1 / 2 之后
+    const uint8_t seq[8] = { 2 };
+    CHECK_EQ(CAN_SendMessage(can1.handle(), &same, seq), static_cast<uint32_t>(CAN_SEND_QUEUED));
+    CHECK(bus.run_until_idle());
+    CHECK_EQ(peer.received().size(), 4U);
+    for (uint8_t i = 0; i < 3; ++i)
+        CHECK_EQ(peer.received()[i + 1].frame.data[0], i);
+}
+
+// 过滤路由：命中的帧按 FilterIndex 分发（优先于 ID 表），未命中的帧由全局过滤在硬件中丢弃
+void test_filter_routes()
+{
+    CHECK(HAL_FDCAN_Stop(can1.handle()) == HAL_OK);
+    can1.handle()->Init.StdFiltersNbr = 2;
+    can1.handle()->Init.ExtFiltersNbr = 1;
+    CHECK(HAL_FDCAN_Init(can1.handle()) == HAL_OK);
+
+    struct Hit
+    {
+        uintptr_t route;
+        uint32_t  id;
+        uint32_t  filter_index;
+    };
+    static std::vector<Hit> hits;
+    const CAN_IdCallback_t  on_route =
+            [](const FDCAN_HandleTypeDef*, const FDCAN_RxHeaderTypeDef* header, const uint8_t*, void* ctx)
+    { hits.push_back({ reinterpret_cast<uintptr_t>(ctx), header->Identifier, header->FilterIndex }); };
+
+    const CAN_FilterRoute routes[] = {
+        { 0x3A0, 0x7F0, FDCAN_STANDARD_ID, FDCAN_RX_FIFO1, on_route, reinterpret_cast<void*>(0) },
+        // 0x321 在 ID 表中也注册了 on_id，按过滤器元素分发时不再查 ID 表
+        { 0x321, 0x7FF, FDCAN_STANDARD_ID, FDCAN_RX_FIFO0, on_route, reinterpret_cast<void*>(1) },
+        { 0x1ABCDEF, 0x1FFFFFFF, FDCAN_EXTENDED_ID, FDCAN_RX_FIFO0, on_route, reinterpret_cast<void*>(2) },
+    };
+    CHECK(CAN_ConfigFilterRoutes(can1.handle(), routes, 3, 0, 0));
+    // 超出 Init.StdFiltersNbr 的元素不参与匹配
+    CHECK(!CAN_ConfigFilterRoutes(can1.handle(), routes, 1, 2, 0));
+    CHECK(HAL_FDCAN_ConfigGlobalFilter(can1.handle(), FDCAN_REJECT, FDCAN_REJECT, FDCAN_FILTER_REMOTE,
+                                       FDCAN_FILTER_REMOTE) == HAL_OK);
+    CAN_Start(can1.handle(), FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_NEW_MESSAGE);
+
+    received_ids.clear();
+    id_callback_ids.clear();
+    Frame frame;
+    frame.dlc = 1;
+    for (const uint32_t id : { 0x3A5U, 0x321U, 0x124U })
+    {
+        frame.id = id;
+        peer.send(frame);
+    }
+    frame.id  = 0x1ABCDEF;
+    frame.ext = true;
+    peer.send(frame);
+    frame.id = 0x1ABCDEE;
+    peer.send(frame);
+    CHECK(bus.run_until_idle());
+
+    CHECK_EQ(hits.size(), 3U);
+    CHECK_EQ(hits[0].route, 0U);
+    CHECK_EQ(hits[0].id, 0x3A5U);
+    CHECK_EQ(hits[1].route, 1U);
+    CHECK_EQ(hits[1].filter_index, 1U);
+    CHECK_EQ(hits[2].route, 2U);
+    CHECK_EQ(hits[2].filter_index, 0U);
+    CHECK(id_callback_ids.empty());
+    // 0x124 与 0x1ABCDEE 未命中任何过滤器元素，不会进入中断
+    CHECK((received_ids == std::vector<uint32_t>{ 0x3A5U, 0x321U, 0x1ABCDEFU }));
+
+    // 恢复全部进入 FIFO0、不使用过滤器元素
+    CHECK(HAL_FDCAN_Stop(can1.handle()) == HAL_OK);
+    can1.handle()->Init.StdFiltersNbr = 0;
+    can1.handle()->Init.ExtFiltersNbr = 0;
+    CHECK(HAL_FDCAN_Init(can1.handle()) == HAL_OK);
+    CHECK(HAL_FDCAN_ConfigGlobalFilter(can1.handle(), FDCAN_ACCEPT_IN_RX_FIFO0, FDCAN_ACCEPT_IN_RX_FIFO0,
+                                       FDCAN_FILTER_REMOTE, FDCAN_FILTER_REMOTE) == HAL_OK);
+    CAN_Start(can1.handle(), FDCAN_IT_RX_FIFO0_NEW_MESSAGE);
+}
+
+} // namespace
+
+int main()
+{
+    setup();
+    RUN_TEST(test_send_and_receive);
+    RUN_TEST(test_fd_frame_with_bit_rate_switch);
+    RUN_TEST(test_fifo_full_queues_and_abort_pending);
+    RUN_TEST(test_queue_order_and_drop_policy);
+    RUN_TEST(test_send_latest);
+    RUN_TEST(test_rate_limit);
+    RUN_TEST(test_send_batch);
+    RUN_TEST(test_abort_while_transmitting);
+    RUN_TEST(test_reuse_buffer_with_masked_irq);
+    RUN_TEST(test_bus_off_recovery);
+    RUN_TEST(test_queue_mode_priority);
+    RUN_TEST(test_queue_mode_same_id_order);
+    RUN_TEST(test_filter_routes);
+    return host_test::result();
+}
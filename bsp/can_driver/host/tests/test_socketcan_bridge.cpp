@@ -0,0 +1,115 @@
+/**
+ * @file    test_socketcan_bridge.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   SocketCAN 桥接测试：仿真帧写到 vcan0，vcan0 上的帧进入仿真总线。没有 vcan0 时跳过。
+ */
+#include "can_sim.hpp"
+#include "host_test.hpp"
+#include "socketcan_bridge.hpp"
+
+#include <cstring>
+#include <linux/can.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace can_sim;
+
+namespace
+{
+
+// 另一端：直接打开同一个接口，充当 cansend / candump
+int open_raw(const char* ifname)
+{
+    const int fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+    if (fd < 0)
+        return -1;
+    ifreq ifr{};
+    std::strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    sockaddr_can addr{};
+    addr.can_family = AF_CAN;
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0 ||
+        (addr.can_ifindex = ifr.ifr_ifindex, bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+Bus* bus_ptr;
+SocketCanBridge* bridge_ptr;
+VirtualNode*     node_ptr;
+int              fd = -1;
+
+void test_sim_to_socket()
+{
+    Frame frame;
+    frame.id      = 0x155;
+    frame.dlc     = 3;
+    frame.data[2] = 0xAB;
+    node_ptr->send(frame);
+    CHECK(bus_ptr->run_until_idle());
+
+    can_frame out{};
+    bool      got = false;
+    for (int i = 0; i < 100 && !got; ++i)
+    {
+        got = read(fd, &out, sizeof(out)) == sizeof(out);
+        if (!got)
+            usleep(1000);
+    }
+    CHECK(got);
+    CHECK_EQ(out.can_id, 0x155U);
+    CHECK_EQ(out.can_dlc, 3);
+    CHECK_EQ(out.data[2], 0xAB);
+}
+
+void test_socket_to_sim()
+{
+    node_ptr->clear_received();
+    can_frame in{};
+    in.can_id  = 0x1ABCDEF | CAN_EFF_FLAG;
+    in.can_dlc = 1;
+    in.data[0] = 0x5A;
+    CHECK(write(fd, &in, sizeof(in)) == sizeof(in));
+
+    size_t polled = 0;
+    for (int i = 0; i < 100 && polled == 0; ++i)
+    {
+        polled = bridge_ptr->poll();
+        if (polled == 0)
+            usleep(1000);
+    }
+    CHECK_EQ(polled, 1U);
+    CHECK(bus_ptr->run_until_idle());
+    CHECK_EQ(node_ptr->received().size(), 1U);
+    CHECK(node_ptr->received()[0].frame.ext);
+    CHECK_EQ(node_ptr->received()[0].frame.id, 0x1ABCDEFU);
+    CHECK_EQ(node_ptr->received()[0].frame.data[0], 0x5A);
+}
+
+} // namespace
+
+int main()
+{
+    Bus             bus;
+    SocketCanBridge bridge(bus, "vcan0");
+    VirtualNode     node(bus);
+    fd = open_raw("vcan0");
+    if (!bridge.is_open() || fd < 0)
+    {
+        std::printf("vcan0 not available, skipped\n");
+        return HOST_TEST_SKIP;
+    }
+    bus_ptr    = &bus;
+    bridge_ptr = &bridge;
+    node_ptr   = &node;
+
+    RUN_TEST(test_sim_to_socket);
+    RUN_TEST(test_socket_to_sim);
+    close(fd);
+    return host_test::result();
+}
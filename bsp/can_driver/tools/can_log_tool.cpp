@@ -0,0 +1,214 @@
+/**
+ * @file    can_log_tool.cpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   CAN 收发记录的主机端解码 / 回放工具（Linux）。
+ *
+ * 读取 CAN_RecorderStart 输出的日志（can_log.hpp 格式的块依次拼接，例如 UART 抓取或 Flash 导出的原始数据），
+ * 块头损坏或数据截断时跳到下一个魔数继续解码（can_sim::decode_log）。
+ *
+ * 回放与主机测试共用 can_sim::LogReplayer：记录按原始时间提交到一条仿真总线，总线上挂一个 SocketCanBridge，
+ * 仿真时间跟随主机单调时钟推进，每帧在仿真总线上发送完毕时写到 SocketCAN 接口。仲裁与帧长都按仿真总线计算，
+ * 回放的总线比现场慢、帧堆积时会照常排队。
+ *
+ * 本工具随主机仿真一起构建（bsp/can_driver/host，仅 Linux）：
+ *
+ * ```sh
+ * cmake -S . -B build && cmake --build build --target can_log_tool
+ *
+ * # 解码为 candump -l 格式，可直接交给 can-utils 的 canplayer / log2asc 等工具
+ * ./can_log_tool decode match.bin > match.log
+ *
+ * # 按原始时间间隔把记录回放到 SocketCAN 接口（例如 vcan0），在主机上复现现场
+ * sudo ip link add dev vcan0 type vcan && sudo ip link set vcan0 up
+ * ./can_log_tool replay match.bin vcan0 --rx-only --bus 0 --bitrate 1000000
+ * ```
+ *
+ * --------------------------------------------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Project repository: https://github.com/HITSZ-WTRobot-Packages/BasicComponents
+ */
+#include "../can_log.hpp"
+#include "log_replay.hpp"
+#include "socketcan_bridge.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+bool read_file(const char* path, std::vector<uint8_t>& out)
+{
+    FILE* file = std::strcmp(path, "-") == 0 ? stdin : std::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "cannot open %s: %s\n", path, std::strerror(errno));
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t  n = 0;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        out.insert(out.end(), buffer, buffer + n);
+    if (file != stdin)
+        std::fclose(file);
+    return true;
+}
+
+/**
+ * 解码全部记录（按时间排序），并报告损坏的块与丢弃的帧
+ */
+std::vector<can_log::Record> decode_records(const std::vector<uint8_t>& log)
+{
+    can_sim::LogSummary                summary{};
+    const std::vector<can_log::Record> records = can_sim::decode_log(log.data(), log.size(), &summary);
+    if (summary.damaged != 0)
+        std::fprintf(stderr, "%zu of %zu block(s) truncated or corrupted\n", summary.damaged, summary.blocks);
+    if (summary.dropped != 0)
+        std::fprintf(stderr, "%" PRIu64 " frame(s) dropped by the recorder\n", summary.dropped);
+    return records;
+}
+
+int decode(const std::vector<uint8_t>& log)
+{
+    for (const can_log::Record& r : decode_records(log))
+    {
+        std::printf("(%" PRIu64 ".%06" PRIu64 ") can%u ", r.time_us / 1000000, r.time_us % 1000000, r.bus);
+        if (r.ext)
+            std::printf("%08" PRIX32 "#", r.id);
+        else
+            std::printf("%03" PRIX32 "#", r.id);
+        if (r.rtr)
+            std::printf("R");
+        else
+            for (size_t i = 0; i < r.dlc; i++)
+                std::printf("%02X", r.data[i]);
+        // candump 格式没有方向字段，行尾附加 T（本节点发送）/ R（接收），canplayer 会忽略
+        std::printf(r.tx ? " T\n" : " R\n");
+    }
+    return 0;
+}
+
+timespec add_ns(timespec t, const uint64_t ns)
+{
+    const uint64_t total = static_cast<uint64_t>(t.tv_nsec) + ns % 1000000000;
+    t.tv_sec += static_cast<time_t>(ns / 1000000000 + total / 1000000000);
+    t.tv_nsec = static_cast<long>(total % 1000000000);
+    return t;
+}
+
+/**
+ * 按记录的时间间隔回放：仿真总线的每个事件都先等到对应的主机时刻，以回放起点为基准，误差不会累积
+ */
+int replay(const std::vector<uint8_t>& log, const char* iface, const bool rx_only, const int bus_index,
+           const uint32_t bitrate)
+{
+    std::vector<can_log::Record> records = decode_records(log);
+    records.erase(std::remove_if(records.begin(),
+                                 records.end(),
+                                 [&](const can_log::Record& r)
+                                 { return (rx_only && r.tx) || (bus_index >= 0 && r.bus != bus_index); }),
+                  records.end());
+
+    can_sim::Bus             bus(bitrate);
+    can_sim::SocketCanBridge bridge(bus, iface);
+    if (!bridge.is_open())
+    {
+        std::fprintf(stderr, "cannot open interface %s\n", iface);
+        return 1;
+    }
+    can_sim::LogReplayer replayer(bus, std::move(records));
+
+    timespec start{};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const uint64_t sim_start = can_sim::now_ns();
+    for (;;)
+    {
+        // 开始已到提交时刻的传输，之后的下一个事件是传输结束或下一条记录的提交时刻
+        bus.run_until(can_sim::now_ns());
+        const uint64_t next = bus.next_event_ns();
+        if (next == can_sim::NEVER)
+            break;
+        const timespec due = add_ns(start, next - sim_start);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr) == EINTR)
+        {
+        }
+        bus.run_until(next);
+    }
+
+    std::fprintf(stderr,
+                 "%zu frame(s) replayed, max lateness %" PRIu64 " us\n",
+                 replayer.sent(),
+                 replayer.max_lateness_ns() / 1000);
+    return 0;
+}
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "usage: can_log_tool decode <log.bin|->\n"
+                 "       can_log_tool replay <log.bin|-> <iface> [--rx-only] [--bus N] [--bitrate B]\n");
+}
+
+} // namespace
+
+int main(const int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        usage();
+        return 2;
+    }
+
+    std::vector<uint8_t> log;
+    if (!read_file(argv[2], log))
+        return 1;
+
+    const std::string command = argv[1];
+    if (command == "decode")
+        return decode(log);
+
+    if (command == "replay" && argc >= 4)
+    {
+        bool     rx_only = false;
+        int      bus     = -1;
+        uint32_t bitrate = 1000000;
+        for (int i = 4; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--rx-only") == 0)
+                rx_only = true;
+            else if (std::strcmp(argv[i], "--bus") == 0 && i + 1 < argc)
+                bus = std::atoi(argv[++i]);
+            else if (std::strcmp(argv[i], "--bitrate") == 0 && i + 1 < argc)
+                bitrate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+            else
+            {
+                usage();
+                return 2;
+            }
+        }
+        return replay(log, argv[3], rx_only, bus, bitrate);
+    }
+
+    usage();
+    return 2;
+}
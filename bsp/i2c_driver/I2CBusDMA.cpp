@@ -4,6 +4,8 @@
  */
 #include "I2CBusDMA.hpp"
 
+#include "isr_lock.h"
+
 namespace
 {
 constexpr uint32_t TransferCompleteFlag = 1U << 0;
@@ -27,6 +29,24 @@ bool isThreadFlagsError(const uint32_t flags)
     return (flags & osFlagsError) != 0U;
 }
 
+void enableCycleCounter()
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+// 总线占用计时用的时钟：有 DWT 时为 CPU 周期，否则为 HAL tick（毫秒）
+uint32_t busClockNow()
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    return DWT->CYCCNT;
+#else
+    return HAL_GetTick();
+#endif
+}
+
 void shortDelay()
 {
     for (volatile uint32_t i = 0; i < BusPulseDelayCycles; ++i)
@@ -45,6 +65,7 @@ I2CBusDMA::I2CBusDMA(I2C_HandleTypeDef* hi2c, const BusPins pins) : hi2c_(hi2c),
     {
         last_error_ = Error::None;
     }
+    enableCycleCounter();
 }
 
 bool I2CBusDMA::isBusy() const
@@ -52,7 +73,13 @@ bool I2CBusDMA::isBusy() const
     if (hi2c_ == nullptr)
         return false;
 
-    return transmitting_ || (HAL_I2C_GetState(hi2c_) != HAL_I2C_STATE_READY);
+    return transmitting_ || queue_count_ != 0U || (HAL_I2C_GetState(hi2c_) != HAL_I2C_STATE_READY);
+}
+
+std::size_t I2CBusDMA::pendingCount() const
+{
+    ISRGuard guard;
+    return queue_count_ + (transmitting_ ? 1U : 0U);
 }
 
 bool I2CBusDMA::memRead(const uint8_t  device_addr_7bit,
@@ -61,19 +88,13 @@ bool I2CBusDMA::memRead(const uint8_t  device_addr_7bit,
                         const uint16_t len,
                         const uint32_t timeout_ms)
 {
-    // 发起 DMA 之前先确认总线空闲，并记录当前等待完成的线程。
-    if (!prepareTransfer())
-        return false;
-
-    const HAL_StatusTypeDef status =
-        HAL_I2C_Mem_Read_DMA(hi2c_, static_cast<uint16_t>(device_addr_7bit << 1U), reg, I2C_MEMADD_SIZE_8BIT, data, len);
-
-    if (status != HAL_OK)
-    {
-        return failAndRecover(Error::StartFailed, HAL_I2C_GetError(hi2c_));
-    }
-
-    return waitForTransfer(timeout_ms);
+    Transaction transaction{};
+    transaction.op               = Op::MemRead;
+    transaction.device_addr_7bit = device_addr_7bit;
+    transaction.reg              = reg;
+    transaction.data             = data;
+    transaction.len              = len;
+    return transfer(transaction, timeout_ms);
 }
 
 bool I2CBusDMA::memWrite(const uint8_t        device_addr_7bit,
@@ -82,23 +103,13 @@ bool I2CBusDMA::memWrite(const uint8_t        device_addr_7bit,
                          const uint16_t       len,
                          const uint32_t       timeout_ms)
 {
-    // mem write 和 mem read 使用同一套等待机制，区别只在 HAL 启动接口。
-    if (!prepareTransfer())
-        return false;
-
-    const HAL_StatusTypeDef status = HAL_I2C_Mem_Write_DMA(hi2c_,
-                                                           static_cast<uint16_t>(device_addr_7bit << 1U),
-                                                           device_reg,
-                                                           I2C_MEMADD_SIZE_8BIT,
-                                                           const_cast<uint8_t*>(data),
-                                                           len);
-
-    if (status != HAL_OK)
-    {
-        return failAndRecover(Error::StartFailed, HAL_I2C_GetError(hi2c_));
-    }
-
-    return waitForTransfer(timeout_ms);
+    Transaction transaction{};
+    transaction.op               = Op::MemWrite;
+    transaction.device_addr_7bit = device_addr_7bit;
+    transaction.reg              = device_reg;
+    transaction.data             = const_cast<uint8_t*>(data);
+    transaction.len              = len;
+    return transfer(transaction, timeout_ms);
 }
 
 bool I2CBusDMA::read(const uint8_t  device_addr_7bit,
@@ -106,18 +117,12 @@ bool I2CBusDMA::read(const uint8_t  device_addr_7bit,
                      const uint16_t len,
                      const uint32_t timeout_ms)
 {
-    if (!prepareTransfer())
-        return false;
-
-    const HAL_StatusTypeDef status =
-        HAL_I2C_Master_Receive_DMA(hi2c_, static_cast<uint16_t>(device_addr_7bit << 1U), data, len);
-
-    if (status != HAL_OK)
-    {
-        return failAndRecover(Error::StartFailed, HAL_I2C_GetError(hi2c_));
-    }
-
-    return waitForTransfer(timeout_ms);
+    Transaction transaction{};
+    transaction.op               = Op::Read;
+    transaction.device_addr_7bit = device_addr_7bit;
+    transaction.data             = data;
+    transaction.len              = len;
+    return transfer(transaction, timeout_ms);
 }
 
 bool I2CBusDMA::write(const uint8_t        device_addr_7bit,
@@ -125,18 +130,53 @@ bool I2CBusDMA::write(const uint8_t        device_addr_7bit,
                       const uint16_t       len,
                       const uint32_t       timeout_ms)
 {
-    if (!prepareTransfer())
+    Transaction transaction{};
+    transaction.op               = Op::Write;
+    transaction.device_addr_7bit = device_addr_7bit;
+    transaction.data             = const_cast<uint8_t*>(data);
+    transaction.len              = len;
+    return transfer(transaction, timeout_ms);
+}
+
+bool I2CBusDMA::runScript(const Step* const steps, const uint16_t count, const uint32_t timeout_ms)
+{
+    Transaction transaction{};
+    transaction.op    = Op::Script;
+    transaction.steps = steps;
+    transaction.len   = count;
+    return transfer(transaction, timeout_ms);
+}
+
+bool I2CBusDMA::submit(const Transaction& transaction)
+{
+    if (hi2c_ == nullptr)
+    {
+        last_error_ = Error::InvalidHandle;
         return false;
+    }
 
-    const HAL_StatusTypeDef status =
-        HAL_I2C_Master_Transmit_DMA(hi2c_, static_cast<uint16_t>(device_addr_7bit << 1U), const_cast<uint8_t*>(data), len);
+    if (transaction.op == Op::Script && (transaction.steps == nullptr || transaction.len == 0U))
+    {
+        // 空脚本不占用总线，直接视为完成。
+        if (transaction.callback != nullptr)
+            transaction.callback(transaction, Error::None, transaction.ctx);
+        return true;
+    }
 
-    if (status != HAL_OK)
     {
-        return failAndRecover(Error::StartFailed, HAL_I2C_GetError(hi2c_));
+        ISRGuard guard;
+        if (queue_count_ >= QueueSize)
+        {
+            last_error_ = Error::Busy;
+            return false;
+        }
+        queue_[(queue_head_ + queue_count_) % QueueSize] = transaction;
+        queue_count_                                     = queue_count_ + 1U;
     }
 
-    return waitForTransfer(timeout_ms);
+    // 总线空闲时由提交者直接启动；否则留给正在进行的事务的完成中断去接力。
+    startNext();
+    return true;
 }
 
 bool I2CBusDMA::recover()
@@ -147,8 +187,17 @@ bool I2CBusDMA::recover()
         return false;
     }
 
-    // 恢复前先把软件态清空，避免 manager 误以为还有旧事务未完成。
-    clearTransferState();
+    // 恢复期间暂停队列，并把仍在进行的事务（通常已经卡死）以 Aborted 结束，
+    // 之后晚到的完成中断会因为没有进行中的事务而被忽略。
+    const Error    saved_error     = last_error_;
+    const uint32_t saved_hal_error = last_hal_error_;
+    {
+        ISRGuard guard;
+        halted_ = true;
+    }
+    finishActive(Error::Aborted, HAL_I2C_ERROR_NONE);
+    last_error_     = saved_error;
+    last_hal_error_ = saved_hal_error;
 
     // 对超时和错误路径，先尽量终止底层 DMA，减少旧完成中断漂到后续事务。
     if (hi2c_->hdmarx != nullptr)
@@ -156,28 +205,39 @@ bool I2CBusDMA::recover()
     if (hi2c_->hdmatx != nullptr)
         (void) HAL_DMA_Abort(hi2c_->hdmatx);
 
+    bool     ok        = true;
+    uint32_t hal_error = HAL_I2C_ERROR_NONE;
     if (HAL_I2C_DeInit(hi2c_) != HAL_OK)
     {
-        last_error_     = Error::RecoveryFailed;
-        last_hal_error_ = HAL_I2C_GetError(hi2c_);
-        return false;
+        ok        = false;
+        hal_error = HAL_I2C_GetError(hi2c_);
     }
-
-    if (!recoverBusLines())
+    else if (!recoverBusLines())
     {
-        last_error_     = Error::RecoveryFailed;
-        last_hal_error_ = HAL_I2C_ERROR_TIMEOUT;
-        return false;
+        ok        = false;
+        hal_error = HAL_I2C_ERROR_TIMEOUT;
+    }
+    else if (HAL_I2C_Init(hi2c_) != HAL_OK)
+    {
+        ok        = false;
+        hal_error = HAL_I2C_GetError(hi2c_);
     }
 
-    if (HAL_I2C_Init(hi2c_) != HAL_OK)
+    if (!ok)
     {
+        // 总线回不到可用状态，排队的事务也不可能完成，直接通知它们失败。
+        abortQueued(Error::RecoveryFailed);
         last_error_     = Error::RecoveryFailed;
-        last_hal_error_ = HAL_I2C_GetError(hi2c_);
+        last_hal_error_ = hal_error;
         return false;
     }
 
     last_hal_error_ = HAL_I2C_ERROR_NONE;
+    {
+        ISRGuard guard;
+        halted_ = false;
+    }
+    startNext();
     return true;
 }
 
@@ -244,7 +304,7 @@ void I2CBusDMA::onErrorFromISR()
     completeFromISR(false, HAL_I2C_GetError(hi2c_));
 }
 
-bool I2CBusDMA::prepareTransfer()
+bool I2CBusDMA::transfer(Transaction transaction, const uint32_t timeout_ms)
 {
     if (hi2c_ == nullptr)
     {
@@ -258,102 +318,259 @@ bool I2CBusDMA::prepareTransfer()
         return false;
     }
 
-    if (transmitting_ || (HAL_I2C_GetState(hi2c_) != HAL_I2C_STATE_READY))
-    {
-        // 这套封装默认一条总线同一时刻只允许一个事务在飞。
-        last_error_ = Error::Busy;
-        return false;
-    }
-
-    // 记录当前调用线程，DMA 完成后通过线程标志把它唤醒。
-    waiting_thread_ = osThreadGetId();
-    if (waiting_thread_ == nullptr)
+    // 记录当前调用线程，事务完成回调通过线程标志把它唤醒。
+    Waiter waiter{};
+    waiter.bus    = this;
+    waiter.thread = osThreadGetId();
+    if (waiter.thread == nullptr)
     {
         last_error_ = Error::InvalidContext;
         return false;
     }
 
-    transmitting_          = true;
-    completed_             = false;
-    current_transfer_id_   = next_transfer_id_++;
-    completed_transfer_id_ = 0U;
-    last_error_            = Error::None;
-    last_hal_error_        = HAL_I2C_ERROR_NONE;
+    transaction.callback = &I2CBusDMA::wakeWaiter;
+    transaction.ctx      = &waiter;
 
     // 清掉可能残留的线程标志，避免把旧完成事件误当成本次 DMA 完成。
     (void) osThreadFlagsClear(TransferCompleteFlag);
-    return true;
+    if (!submit(transaction))
+        return false;
+
+    return waitForTransfer(waiter, timeout_ms);
 }
 
-bool I2CBusDMA::waitForTransfer(const uint32_t timeout_ms)
+bool I2CBusDMA::waitForTransfer(Waiter& waiter, const uint32_t timeout_ms)
 {
     const uint32_t timeout_ticks = kernelTicksFromMs(timeout_ms);
     const uint32_t start_ticks   = osKernelGetTickCount();
-    const uint32_t transfer_id   = current_transfer_id_;
 
     // 这里必须循环等待，而不能假设一次线程标志就对应当前事务。
-    // 超时恢复后的旧 DMA/IRQ 可能晚到；只有事务编号匹配时，这条完成记录
-    // 才能被当成当前事务的真实结束事件。
-    while (true)
+    // 之前超时事务的完成回调可能晚到并留下线程标志；只有 waiter.done
+    // 被置位时，才说明本次事务真的结束了。
+    Error error = Error::None;
+    while (!waiter.done)
     {
         const uint32_t elapsed_ticks = osKernelGetTickCount() - start_ticks;
         if (elapsed_ticks >= timeout_ticks)
         {
-            // 超时通常意味着 DMA 回调没回来，或者总线卡死，交给 recoverFromFailure 做恢复。
-            return failAndRecover(Error::Timeout, HAL_I2C_GetError(hi2c_));
+            error = Error::Timeout;
+            break;
         }
 
         const uint32_t remain_ticks = timeout_ticks - elapsed_ticks;
         const uint32_t wait_result  = osThreadFlagsWait(TransferCompleteFlag, osFlagsWaitAny, remain_ticks);
         if (wait_result == osFlagsErrorTimeout)
         {
-            return failAndRecover(Error::Timeout, HAL_I2C_GetError(hi2c_));
+            error = Error::Timeout;
+            break;
         }
         if (isThreadFlagsError(wait_result))
         {
-            return failAndRecover(Error::InvalidContext, HAL_I2C_ERROR_NONE);
+            error = Error::InvalidContext;
+            break;
         }
+    }
 
-        if (!completed_ || completed_transfer_id_ != transfer_id)
+    if (error != Error::None && !waiter.done)
+    {
+        // waiter 在本线程栈上，返回前必须保证事务不再引用它。
+        // 还在排队说明本事务没上过总线，是前面的事务占得久：直接移出队列报告超时，不打断别人的事务。
+        if (cancelQueued(&waiter))
         {
-            // 只接受当前事务的完成记录；旧事务晚到的线程标志直接丢弃。
-            continue;
+            last_script_step_ = 0U;
+            last_error_       = error;
+            last_hal_error_   = HAL_I2C_ERROR_NONE;
+            return false;
         }
 
-        waiting_thread_ = nullptr;
-        transmitting_   = false;
-        completed_      = false;
-        if (last_error_ != Error::None)
+        // 正在进行的就是本事务，通常是 DMA 回调没回来或总线卡死，交给 failAndRecover 以 Aborted 结束并恢复。
+        // 恢复流程结束事务时会写回 waiter，结束步骤在那之后才有效。
+        if (isActive(&waiter))
         {
-            return failAndRecover(last_error_, last_hal_error_);
+            const bool ok     = failAndRecover(error, HAL_I2C_GetError(hi2c_));
+            last_script_step_ = waiter.script_step;
+            return ok;
         }
 
-        return true;
+        // 两者都不是：事务刚好在超时后结束，完成回调正在路上（中断或其他线程的 recover()），等它写回结果。
+        while (!waiter.done)
+            (void) osThreadFlagsWait(TransferCompleteFlag, osFlagsWaitAny, 1U);
+    }
+
+    last_script_step_ = waiter.script_step;
+    if (waiter.error != Error::None)
+    {
+        return failAndRecover(waiter.error, waiter.hal_error);
     }
+
+    last_error_     = Error::None;
+    last_hal_error_ = HAL_I2C_ERROR_NONE;
+    return true;
+}
+
+void I2CBusDMA::wakeWaiter(const Transaction& transaction, const Error error, void* const ctx)
+{
+    auto* waiter = static_cast<Waiter*>(ctx);
+    // 先取出线程句柄：done 置位后等待线程可能立即返回，waiter 随之失效。
+    const osThreadId_t thread = waiter->thread;
+    waiter->error       = error;
+    waiter->hal_error   = waiter->bus->last_hal_error_;
+    waiter->script_step = transaction.step;
+    waiter->done        = true;
+    (void) osThreadFlagsSet(thread, TransferCompleteFlag);
+}
+
+HAL_StatusTypeDef I2CBusDMA::startTransfer(const Step& step)
+{
+    const auto address = static_cast<uint16_t>(step.device_addr_7bit << 1U);
+    switch (step.op)
+    {
+    case Op::MemRead:
+        return HAL_I2C_Mem_Read_DMA(hi2c_, address, step.reg, I2C_MEMADD_SIZE_8BIT, step.data, step.len);
+    case Op::MemWrite:
+        return HAL_I2C_Mem_Write_DMA(hi2c_, address, step.reg, I2C_MEMADD_SIZE_8BIT, step.data, step.len);
+    case Op::Read:
+        return HAL_I2C_Master_Receive_DMA(hi2c_, address, step.data, step.len);
+    case Op::Write:
+        return HAL_I2C_Master_Transmit_DMA(hi2c_, address, step.data, step.len);
+    case Op::Script:
+        // 脚本不能嵌套
+        break;
+    }
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef I2CBusDMA::startActiveStep()
+{
+    if (active_.op == Op::Script)
+        return startTransfer(active_.steps[script_step_]);
+
+    const Step step{ active_.op, active_.device_addr_7bit, active_.reg, active_.data, active_.len };
+    return startTransfer(step);
+}
+
+bool I2CBusDMA::advanceScript()
+{
+    {
+        ISRGuard guard;
+        if (!transmitting_ || active_.op != Op::Script || script_step_ + 1U >= active_.len)
+            return false;
+        script_step_ = script_step_ + 1U;
+    }
+
+    // 直接在完成中断里启动下一步，脚本中间不唤醒任何线程。
+    if (startActiveStep() != HAL_OK)
+        finishActive(Error::StartFailed, HAL_I2C_GetError(hi2c_));
+    return true;
+}
+
+void I2CBusDMA::startNext()
+{
+    {
+        ISRGuard guard;
+        // 这套封装一条总线同一时刻只允许一个事务在飞，其余事务在队列中等待。
+        if (transmitting_ || halted_ || queue_count_ == 0U)
+            return;
+
+        active_         = queue_[queue_head_];
+        queue_head_     = (queue_head_ + 1U) % QueueSize;
+        queue_count_    = queue_count_ - 1U;
+        script_step_    = 0U;
+        transmitting_   = true;
+        transfer_start_ = busClockNow();
+    }
+
+    if (startActiveStep() != HAL_OK)
+    {
+        // 启动失败说明 HAL 状态已经异常，暂停队列，等待线程上下文 recover()。
+        finishActive(Error::StartFailed, HAL_I2C_GetError(hi2c_));
+    }
+}
+
+void I2CBusDMA::finishActive(const Error error, const uint32_t hal_error)
+{
+    Transaction transaction{};
+    {
+        ISRGuard guard;
+        if (!transmitting_)
+            return;
+
+        // 结束步骤在临界区内随副本取走，退出临界区后下一笔事务可能立即启动并重置 script_step_
+        transaction      = active_;
+        transaction.step = script_step_;
+        transmitting_    = false;
+
+        // 总线占用按事务启动到结束计时，单次事务远短于 CYCCNT 回卷周期
+        const uint32_t elapsed = busClockNow() - transfer_start_;
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+        const uint32_t cycles_per_us = SystemCoreClock / 1000000U == 0U ? 1U : SystemCoreClock / 1000000U;
+        busy_remainder_ += elapsed;
+        busy_us_         = busy_us_ + busy_remainder_ / cycles_per_us;
+        busy_remainder_ %= cycles_per_us;
+#else
+        busy_us_ = busy_us_ + elapsed * 1000U;
+#endif
+        last_error_     = error;
+        last_hal_error_ = hal_error;
+        if (error != Error::None)
+            halted_ = true;
+    }
+
+    // 回调在临界区外调用，回调里可以再次 submit()。
+    if (transaction.callback != nullptr)
+        transaction.callback(transaction, error, transaction.ctx);
 }
 
 void I2CBusDMA::completeFromISR(const bool success, const uint32_t hal_error)
 {
-    // 这里运行在 HAL 的中断回调上下文，只做状态落盘和唤醒等待线程。
-    // 是否属于“当前事务”由等待侧根据 transfer id 再次确认，ISR 里不做复杂判断。
-    completed_transfer_id_ = current_transfer_id_;
-    completed_             = true;
-    last_hal_error_        = hal_error;
-    last_error_            = success ? Error::None : Error::HalError;
+    // 这里运行在 HAL 的中断回调上下文：HAL 在调用完成回调前已经把句柄状态置回 READY，
+    // 所以可以直接在中断里启动脚本的下一步或队列中的下一笔，不需要经过线程切换。
+    if (success && advanceScript())
+        return;
+
+    finishActive(success ? Error::None : Error::HalError, hal_error);
+    startNext();
+}
 
-    if (waiting_thread_ != nullptr)
+bool I2CBusDMA::cancelQueued(const void* const ctx)
+{
+    ISRGuard guard;
+    for (std::size_t i = 0; i < queue_count_; ++i)
     {
-        (void) osThreadFlagsSet(waiting_thread_, TransferCompleteFlag);
+        if (queue_[(queue_head_ + i) % QueueSize].ctx != ctx)
+            continue;
+
+        // 后面的事务依次前移，保持提交顺序。
+        for (std::size_t j = i + 1U; j < queue_count_; ++j)
+            queue_[(queue_head_ + j - 1U) % QueueSize] = queue_[(queue_head_ + j) % QueueSize];
+        queue_count_ = queue_count_ - 1U;
+        return true;
     }
+    return false;
 }
 
-void I2CBusDMA::clearTransferState()
+bool I2CBusDMA::isActive(const void* const ctx) const
 {
-    waiting_thread_        = nullptr;
-    transmitting_          = false;
-    completed_             = false;
-    current_transfer_id_   = 0U;
-    completed_transfer_id_ = 0U;
+    ISRGuard guard;
+    return transmitting_ && active_.ctx == ctx;
+}
+
+void I2CBusDMA::abortQueued(const Error error)
+{
+    while (true)
+    {
+        Transaction transaction{};
+        {
+            ISRGuard guard;
+            if (queue_count_ == 0U)
+                return;
+            transaction  = queue_[queue_head_];
+            queue_head_  = (queue_head_ + 1U) % QueueSize;
+            queue_count_ = queue_count_ - 1U;
+        }
+        if (transaction.callback != nullptr)
+            transaction.callback(transaction, error, transaction.ctx);
+    }
 }
 
 bool I2CBusDMA::failAndRecover(const Error error, const uint32_t hal_error)
@@ -362,7 +579,6 @@ bool I2CBusDMA::failAndRecover(const Error error, const uint32_t hal_error)
     // 即使恢复成功，对外也应当仍然看到“这次事务失败了”，不能把失败语义吞掉。
     last_error_     = error;
     last_hal_error_ = hal_error;
-    clearTransferState();
 
     if (!recover())
     {
@@ -370,7 +586,8 @@ bool I2CBusDMA::failAndRecover(const Error error, const uint32_t hal_error)
         return false;
     }
 
-    last_error_ = error;
+    last_error_     = error;
+    last_hal_error_ = hal_error;
     return false;
 }
 
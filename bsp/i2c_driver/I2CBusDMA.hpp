@@ -1,6 +1,6 @@
 /**
  * @file    I2CBusDMA.hpp
- * @brief   基于 STM32 HAL DMA 和 CMSIS-RTOS v2 线程标志的单 owner I2C 总线封装
+ * @brief   基于 STM32 HAL DMA 事务队列和 CMSIS-RTOS v2 线程标志的 I2C 总线封装
  */
 #pragma once
 
@@ -11,9 +11,10 @@
 
 // 一条 I2C 总线的 DMA 封装。
 //
-// 该类假设总线只有一个 owner thread。调用者通过 memRead()/memWrite() 等接口
-// 发起 DMA 事务，然后阻塞等待 HAL 回调通过线程标志唤醒自己。这样对上层
-// 看起来仍是同步接口，但底层传输期间不会忙等占用 CPU。
+// 所有事务都经过一个固定长度的提交队列：submit() 把事务描述符放入队列，
+// DMA 完成中断先调用该事务的完成回调，再直接在中断里启动下一笔事务，
+// 连续的传输之间不需要线程切换。memRead()/memWrite() 等同步接口只是
+// 提交一笔事务后用线程标志阻塞等待它的回调，多个线程可以同时调用。
 class I2CBusDMA final
 {
 public:
@@ -39,8 +40,70 @@ public:
         Timeout,        ///< 等待完成超时
         HalError,       ///< HAL 在事务过程中报告错误
         RecoveryFailed, ///< 失败后的恢复流程也未成功
+        Aborted,        ///< 事务在进行中或队列中被恢复流程取消
     };
 
+    /**
+     * @brief 事务类型
+     */
+    enum class Op : uint8_t
+    {
+        MemRead,  ///< 带寄存器地址的读（HAL_I2C_Mem_Read_DMA）
+        MemWrite, ///< 带寄存器地址的写（HAL_I2C_Mem_Write_DMA）
+        Read,     ///< 原始读（HAL_I2C_Master_Receive_DMA）
+        Write,    ///< 原始写（HAL_I2C_Master_Transmit_DMA）
+        Script,   ///< 依次执行一组 Step，只在全部完成或出错时回调一次
+    };
+
+    /**
+     * @brief 事务脚本中的一步
+     *
+     * 脚本是 Step 数组，由 DMA 完成中断逐步启动，中间不经过线程。
+     * 例如 IMU 的“写寄存器 A，读 B 起 6 字节，读 C 起 2 字节”可以写成三步。
+     */
+    struct Step
+    {
+        Op       op;               ///< 事务类型，不能为 Op::Script
+        uint8_t  device_addr_7bit; ///< 7 位设备地址
+        uint8_t  reg;              ///< 寄存器地址，仅 MemRead / MemWrite 使用
+        uint8_t* data;             ///< 数据缓冲区
+        uint16_t len;              ///< 数据字节数
+    };
+
+    struct Transaction;
+
+    /**
+     * @brief 事务完成回调
+     *
+     * 通常在 DMA 完成 / 错误中断中调用；启动失败时在提交者的上下文中调用，
+     * 被恢复流程取消时在调用 recover() 的线程中调用。回调中可以再次 submit()。
+     * @param transaction 已完成的事务（副本，回调返回后失效）
+     * @param error 事务结果，成功为 Error::None
+     * @param ctx 事务描述符中的用户上下文
+     */
+    using Callback = void (*)(const Transaction& transaction, Error error, void* ctx);
+
+    /**
+     * @brief 一笔事务的描述符，提交时按值拷贝进队列
+     *
+     * data 指向的缓冲区在事务完成回调之前必须保持有效；写事务不会修改其内容。
+     * Op::Script 事务使用 steps / len 描述脚本，steps 数组同样要保持有效到完成回调。
+     */
+    struct Transaction
+    {
+        Op          op{ Op::MemRead };      ///< 事务类型
+        uint8_t     device_addr_7bit{ 0U }; ///< 7 位设备地址
+        uint8_t     reg{ 0U };              ///< 寄存器地址，仅 MemRead / MemWrite 使用
+        uint8_t*    data{ nullptr };        ///< 数据缓冲区
+        uint16_t    len{ 0U };              ///< 数据字节数；Op::Script 时为步数
+        const Step* steps{ nullptr };       ///< 脚本，仅 Op::Script 使用
+        Callback    callback{ nullptr };    ///< 完成回调，可为空
+        void*       ctx{ nullptr };         ///< 用户上下文，回调时原样传回
+        uint16_t    step{ 0U };             ///< 由驱动填写：完成回调收到的副本中为脚本结束时所在的步骤
+    };
+
+    static constexpr std::size_t QueueSize = 8; ///< 提交队列长度（不含正在进行的事务）
+
     /**
      * @brief 使用 HAL I2C 句柄构造总线对象
      * @param hi2c 要绑定的 HAL I2C 句柄
@@ -56,7 +119,7 @@ public:
 
     /**
      * @brief 查询总线当前是否忙碌
-     * @return 当前是否仍有事务未完成，或 HAL 状态尚未回到 READY
+     * @return 当前是否仍有事务正在进行或排队，或 HAL 状态尚未回到 READY
      */
     [[nodiscard]] bool               isBusy() const;
 
@@ -71,6 +134,32 @@ public:
      */
     [[nodiscard]] uint32_t           lastHalError() const { return last_hal_error_; }
 
+    /**
+     * @brief 获取尚未完成的事务数量
+     * @return 正在进行和在队列中等待的事务总数
+     */
+    [[nodiscard]] std::size_t        pendingCount() const;
+
+    /**
+     * @brief 获取总线上有事务进行的累计时间
+     *
+     * 从事务启动到完成（或被恢复流程取消）计时，脚本按整段计。有 DWT 时按 CYCCNT 计时，否则精度为 1 ms。
+     * @return 累计占用时间，单位微秒，按 32 位回卷，两次读取的差值即为区间内的占用时间
+     */
+    [[nodiscard]] uint32_t           busyTimeUs() const { return busy_us_; }
+
+    /**
+     * @brief 提交一笔异步事务，可在线程或中断中调用
+     *
+     * 总线空闲时立即启动，否则排队，由前一笔事务的完成中断接着启动。
+     * 事务失败后队列暂停，直到有线程调用 recover() 恢复总线后才继续；
+     * 同步接口失败时会自动恢复，只使用异步接口时需要在完成回调报告错误后自行安排 recover()。
+     * 异步事务没有超时，总线卡死时同样需要由线程调用 recover() 取消。
+     * @param transaction 事务描述符
+     * @return 是否成功入队；队列已满时返回 false 并记录 Error::Busy
+     */
+    bool submit(const Transaction& transaction);
+
     /**
      * @brief 发起一次带寄存器地址的 DMA 读事务
      * @param device_addr_7bit 7 位设备地址
@@ -117,7 +206,31 @@ public:
     bool write(uint8_t device_addr_7bit, const uint8_t* data, uint16_t len, uint32_t timeout_ms);
 
     /**
-     * @brief 尝试恢复当前 I2C 总线
+     * @brief 执行一段事务脚本并阻塞等待全部完成
+     *
+     * 各步之间由 DMA 完成中断直接衔接，整段脚本只唤醒调用线程一次。
+     * 任一步失败时立即结束，后续步骤不再执行，失败的步骤可通过 lastScriptStep() 查询。
+     * 异步提交的脚本在完成回调收到的 Transaction::step 中得到同样的信息。
+     * @param steps 脚本步骤
+     * @param count 步数
+     * @param timeout_ms 整段脚本的等待超时时间，单位毫秒
+     * @return 脚本是否全部成功完成
+     */
+    bool runScript(const Step* steps, uint16_t count, uint32_t timeout_ms);
+
+    /**
+     * @brief 获取最近一次同步调用的脚本结束时所在的步骤
+     *
+     * 由等待线程从自己的等待记录中取回，之后总线上启动的其他事务不会改写它。
+     * @return 成功时为最后一步的下标，失败时为出错步骤的下标；脚本未启动就超时时为 0
+     */
+    [[nodiscard]] uint16_t lastScriptStep() const { return last_script_step_; }
+
+    /**
+     * @brief 尝试恢复当前 I2C 总线，只能在线程上下文调用
+     *
+     * 正在进行的事务以 Error::Aborted 结束。恢复成功后继续启动队列中的事务，
+     * 失败时队列中的事务全部以 Error::RecoveryFailed 结束。
      * @return 恢复后总线是否重新回到可用状态
      */
     bool recover();
@@ -146,29 +259,92 @@ private:
     static constexpr std::size_t MaxInstances = 4;
 
     /**
-     * @brief 在启动 DMA 前准备一次事务
-     * @return 当前是否允许启动新事务
+     * @brief 同步接口阻塞等待的一笔事务，位于等待线程的栈上
      */
-    bool prepareTransfer();
+    struct Waiter
+    {
+        I2CBusDMA*        bus{ nullptr };                   ///< 事务所在的总线
+        osThreadId_t      thread{ nullptr };                ///< 等待线程
+        volatile bool     done{ false };                    ///< 事务是否已经结束
+        volatile Error    error{ Error::None };             ///< 事务结果
+        volatile uint32_t hal_error{ HAL_I2C_ERROR_NONE };  ///< 事务结束时的 HAL 错误码
+        volatile uint16_t script_step{ 0U };                ///< 脚本事务结束时所在的步骤
+    };
 
     /**
-     * @brief 阻塞等待当前事务完成
+     * @brief 提交一笔事务并阻塞等待其完成，供同步接口使用
+     * @param transaction 事务描述符，回调字段会被替换
+     * @param timeout_ms 等待完成超时时间，单位毫秒
+     * @return 事务是否成功完成
+     */
+    bool transfer(Transaction transaction, uint32_t timeout_ms);
+
+    /**
+     * @brief 阻塞等待同步事务完成
+     * @param waiter 当前线程的等待记录
      * @param timeout_ms 等待完成超时时间，单位毫秒
      * @return 当前事务是否成功完成
      */
-    bool waitForTransfer(uint32_t timeout_ms);
+    bool waitForTransfer(Waiter& waiter, uint32_t timeout_ms);
+
+    /**
+     * @brief 同步事务的完成回调，记录结果并唤醒等待线程
+     */
+    static void wakeWaiter(const Transaction& transaction, Error error, void* ctx);
+
+    /**
+     * @brief 按事务类型调用对应的 HAL DMA 启动接口
+     */
+    HAL_StatusTypeDef startTransfer(const Step& step);
+
+    /**
+     * @brief 启动正在进行的事务的当前步骤（普通事务只有一步）
+     */
+    HAL_StatusTypeDef startActiveStep();
 
     /**
-     * @brief 在 ISR 中记录完成状态并唤醒等待线程
+     * @brief 脚本事务的一步成功后启动下一步
+     * @return 是否仍有后续步骤，false 表示事务已经全部完成
+     */
+    bool advanceScript();
+
+    /**
+     * @brief 总线空闲且队列未暂停时，取出队首事务并启动
+     */
+    void startNext();
+
+    /**
+     * @brief 结束正在进行的事务并调用其完成回调
+     * @param error 事务结果，非 None 时暂停队列
+     * @param hal_error HAL 层返回的错误码
+     */
+    void finishActive(Error error, uint32_t hal_error);
+
+    /**
+     * @brief 在 ISR 中结束当前事务并启动下一笔
      * @param success 本次完成是否成功
      * @param hal_error HAL 层返回的错误码
      */
     void completeFromISR(bool success, uint32_t hal_error);
 
     /**
-     * @brief 清空当前事务的软件状态
+     * @brief 从队列中移除尚未启动的事务
+     * @param ctx 要移除事务的用户上下文
+     * @return 是否找到并移除
+     */
+    bool cancelQueued(const void* ctx);
+
+    /**
+     * @brief 查询正在进行的事务是否属于给定的用户上下文
+     * @param ctx 事务的用户上下文
+     */
+    [[nodiscard]] bool isActive(const void* ctx) const;
+
+    /**
+     * @brief 结束队列中所有尚未启动的事务
+     * @param error 传给完成回调的结果
      */
-    void clearTransferState();
+    void abortQueued(Error error);
 
     /**
      * @brief 记录失败原因并执行恢复流程
@@ -189,14 +365,19 @@ private:
 
     I2C_HandleTypeDef* hi2c_{ nullptr };                     ///< 绑定的 HAL I2C 句柄
     BusPins            pins_{ nullptr, 0U, nullptr, 0U, 0U }; ///< 当前总线的引脚定义
-    osThreadId_t       waiting_thread_{ nullptr };           ///< 当前阻塞等待事务完成的线程句柄
+    Transaction        active_{};                            ///< 正在进行的事务
+    volatile uint16_t  script_step_{ 0U };                   ///< 脚本事务当前执行到的步骤
+    Transaction        queue_[QueueSize]{};                  ///< 等待启动的事务队列
+    volatile std::size_t queue_head_{ 0U };                  ///< 队首下标
+    volatile std::size_t queue_count_{ 0U };                 ///< 队列中的事务数量
     volatile bool      transmitting_{ false };               ///< 当前是否已有事务启动且尚未完成收敛
-    volatile bool      completed_{ false };                  ///< 当前事务是否已收到完成记录
-    volatile uint32_t  next_transfer_id_{ 1U };              ///< 下一次启动事务时要分配的事务编号
-    volatile uint32_t  current_transfer_id_{ 0U };           ///< 当前正在等待的事务编号
-    volatile uint32_t  completed_transfer_id_{ 0U };         ///< 最近一次完成记录对应的事务编号
+    volatile bool      halted_{ false };                     ///< 事务失败后暂停启动队列，等待 recover()
     volatile Error     last_error_{ Error::InvalidHandle };  ///< 最近一次事务记录的抽象错误状态
     volatile uint32_t  last_hal_error_{ HAL_I2C_ERROR_NONE }; ///< 最近一次事务记录的 HAL 错误码
+    uint16_t           last_script_step_{ 0U };              ///< 最近一次同步脚本结束时所在的步骤
+    uint32_t           transfer_start_{ 0U };                ///< 正在进行的事务启动时刻（CYCCNT 或 HAL tick）
+    volatile uint32_t  busy_us_{ 0U };                       ///< 总线累计占用时间，单位微秒
+    uint32_t           busy_remainder_{ 0U };                ///< 不足 1 us 的占用时间，单位 CPU 周期
 
     static I2CBusDMA* instances_[MaxInstances]; ///< 所有 bus 实例共享的 HAL 句柄反查表
 };
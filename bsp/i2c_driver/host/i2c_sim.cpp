@@ -0,0 +1,492 @@
+/**
+ * @file    i2c_sim.cpp
+ * @brief   I2C 总线与从机模型，以及基于它的 GPIO / DMA / I2C HAL 实现。
+ */
+#include "i2c_sim.hpp"
+
+#include "i2c.h"
+
+#include <algorithm>
+
+GPIO_TypeDef sim_gpio[8]{ { 0 }, { 1 }, { 2 }, { 3 }, { 4 }, { 5 }, { 6 }, { 7 } };
+I2C_TypeDef  sim_i2c[3]{ { 1 }, { 2 }, { 3 } };
+
+I2C_HandleTypeDef hi2c1{ I2C1, { 400000U }, nullptr, nullptr, HAL_UNLOCKED, HAL_I2C_STATE_RESET, 0U };
+I2C_HandleTypeDef hi2c2{ I2C2, { 400000U }, nullptr, nullptr, HAL_UNLOCKED, HAL_I2C_STATE_RESET, 0U };
+I2C_HandleTypeDef hi2c3{ I2C3, { 400000U }, nullptr, nullptr, HAL_UNLOCKED, HAL_I2C_STATE_RESET, 0U };
+
+namespace i2c_sim
+{
+
+namespace
+{
+
+// 用函数内静态变量，测试中的全局 Bus 对象构造时它们已经可用
+std::vector<Bus*>& buses()
+{
+    static std::vector<Bus*> list;
+    return list;
+}
+
+/**
+ * 一个引脚的 GPIO 配置与输出值；没有记录的引脚处于复位状态（输入）
+ */
+struct Pin
+{
+    const GPIO_TypeDef* port;
+    uint16_t            pin;
+    uint32_t            mode;
+    GPIO_PinState       output;
+};
+
+Pin& pin_state(const GPIO_TypeDef* port, const uint16_t pin)
+{
+    static std::vector<Pin> pins;
+    for (Pin& p : pins)
+        if (p.port == port && p.pin == pin)
+            return p;
+    pins.push_back({ port, pin, GPIO_MODE_INPUT, GPIO_PIN_RESET });
+    return pins.back();
+}
+
+bool is_output(const uint32_t mode)
+{
+    return mode == GPIO_MODE_OUTPUT_OD || mode == GPIO_MODE_OUTPUT_PP;
+}
+
+/// 引脚自身是否把线拉低（复用为 I2C 时由外设驱动，总线空闲时为高）
+bool driving_low(const GPIO_TypeDef* port, const uint16_t pin)
+{
+    const Pin& p = pin_state(port, pin);
+    return is_output(p.mode) && p.output == GPIO_PIN_RESET;
+}
+
+} // namespace
+
+/*
+ * 从机
+ */
+
+void Slave::set_registers(const uint8_t first, const uint8_t* data, const size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+        regs_[static_cast<uint8_t>(first + i)] = data[i];
+}
+
+void Slave::hold_sda(const uint32_t clocks)
+{
+    sda_clocks_ = clocks;
+    if (clocks != 0 && bus_ != nullptr)
+        bus_->sda_stuck();
+}
+
+void Slave::on_write(const uint8_t reg, const uint8_t* data, const uint16_t len)
+{
+    for (uint16_t i = 0; i < len; ++i)
+        regs_[static_cast<uint8_t>(reg + i)] = data[i];
+}
+
+void Slave::on_read(const uint8_t reg, uint8_t* data, const uint16_t len)
+{
+    for (uint16_t i = 0; i < len; ++i)
+        data[i] = regs_[static_cast<uint8_t>(reg + i)];
+}
+
+/*
+ * 总线
+ */
+
+Bus::Bus(I2C_HandleTypeDef* hi2c,
+         GPIO_TypeDef*      scl_port,
+         const uint16_t     scl_pin,
+         GPIO_TypeDef*      sda_port,
+         const uint16_t     sda_pin) :
+    hi2c_(hi2c), scl_port_(scl_port), scl_pin_(scl_pin), sda_port_(sda_port), sda_pin_(sda_pin)
+{
+    buses().push_back(this);
+    if (hi2c_->Init.ClockSpeed == 0U)
+        hi2c_->Init.ClockSpeed = 400000U;
+    (void) HAL_I2C_Init(hi2c_);
+
+    // CubeMX 的 MspInit 把两个引脚配置为复用开漏
+    GPIO_InitTypeDef init{};
+    init.Pin  = scl_pin_;
+    init.Mode = GPIO_MODE_AF_OD;
+    HAL_GPIO_Init(scl_port_, &init);
+    init.Pin = sda_pin_;
+    HAL_GPIO_Init(sda_port_, &init);
+}
+
+Bus::~Bus()
+{
+    if (active_)
+        (void) rtos_sim::cancel_isr(event_);
+    for (Slave* slave : slaves_)
+        slave->bus_ = nullptr;
+    buses().erase(std::remove(buses().begin(), buses().end(), this), buses().end());
+}
+
+void Bus::attach(Slave& slave)
+{
+    slave.bus_ = this;
+    slaves_.push_back(&slave);
+}
+
+uint64_t Bus::transfer_us(const bool mem, const bool read, const uint16_t len) const
+{
+    // START + 地址 + 数据 + STOP；寄存器读另有寄存器地址、重复 START 和第二次寻址
+    uint64_t bits = 1 + 9 + 9ULL * len + 1;
+    if (mem)
+        bits += read ? 9 + 1 + 9 : 9;
+    const uint64_t clock = hi2c_->Init.ClockSpeed != 0U ? hi2c_->Init.ClockSpeed : 100000U;
+    return (bits * 1000000ULL + clock - 1) / clock;
+}
+
+bool Bus::sda_low() const
+{
+    if (driving_low(sda_port_, sda_pin_))
+        return true;
+    return std::any_of(slaves_.begin(), slaves_.end(), [](const Slave* slave) { return slave->holding_sda(); });
+}
+
+bool Bus::scl_low() const
+{
+    return driving_low(scl_port_, scl_pin_);
+}
+
+Bus* Bus::from(const I2C_HandleTypeDef* hi2c)
+{
+    for (Bus* bus : buses())
+        if (bus->hi2c_ == hi2c)
+            return bus;
+    return nullptr;
+}
+
+Bus* Bus::from_pin(const GPIO_TypeDef* port, const uint16_t pin)
+{
+    for (Bus* bus : buses())
+        if (bus->is_scl(port, pin) || bus->is_sda(port, pin))
+            return bus;
+    return nullptr;
+}
+
+bool Bus::is_scl(const GPIO_TypeDef* port, const uint16_t pin) const
+{
+    return port == scl_port_ && pin == scl_pin_;
+}
+
+bool Bus::is_sda(const GPIO_TypeDef* port, const uint16_t pin) const
+{
+    return port == sda_port_ && pin == sda_pin_;
+}
+
+HAL_StatusTypeDef Bus::start(const Kind     kind,
+                             const uint16_t address_8bit,
+                             const uint16_t reg,
+                             uint8_t*       data,
+                             const uint16_t len)
+{
+    if (hi2c_->State != HAL_I2C_STATE_READY)
+        return HAL_BUSY;
+    if (data == nullptr || len == 0U)
+        return HAL_ERROR;
+
+    if (fail_starts_ > 0)
+    {
+        // DMA 通道配置失败：HAL 记录错误后回到 READY
+        --fail_starts_;
+        hi2c_->ErrorCode = HAL_I2C_ERROR_DMA_PARAM;
+        return HAL_ERROR;
+    }
+
+    if (sda_low() || scl_low())
+    {
+        // 线被拉低时 BUSY 标志一直置位，HAL 等满 25 ms 后放弃
+        rtos_sim::consume_us(25000);
+        hi2c_->ErrorCode |= HAL_I2C_ERROR_TIMEOUT;
+        return HAL_BUSY;
+    }
+
+    const bool read  = kind == Kind::MasterRx || kind == Kind::MemRx;
+    const bool mem   = kind == Kind::MemTx || kind == Kind::MemRx;
+    hi2c_->State     = read ? HAL_I2C_STATE_BUSY_RX : HAL_I2C_STATE_BUSY_TX;
+    hi2c_->ErrorCode = HAL_I2C_ERROR_NONE;
+
+    active_   = true;
+    kind_     = kind;
+    reg_      = static_cast<uint8_t>(reg);
+    data_     = data;
+    len_      = len;
+    start_us_ = rtos_sim::now_us();
+    slave_    = nullptr;
+    for (Slave* slave : slaves_)
+        if (slave->address_ == (address_8bit >> 1U))
+            slave_ = slave;
+
+    if (slave_ == nullptr || slave_->nack_count_ > 0)
+    {
+        // 地址阶段（START + 9 位）结束时发现 NACK
+        if (slave_ != nullptr)
+        {
+            --slave_->nack_count_;
+            ++slave_->nacks_;
+        }
+        const uint64_t clock = hi2c_->Init.ClockSpeed != 0U ? hi2c_->Init.ClockSpeed : 100000U;
+        event_ = rtos_sim::schedule_isr(start_us_ + (10ULL * 1000000ULL + clock - 1) / clock,
+                                        [this] { fail(HAL_I2C_ERROR_AF); });
+        return HAL_OK;
+    }
+
+    if (slave_->hang_count_ > 0)
+    {
+        // 从机停止响应：完成中断不会到来，等主机复位外设
+        --slave_->hang_count_;
+        event_ = 0;
+        return HAL_OK;
+    }
+
+    event_ = rtos_sim::schedule_isr(start_us_ + transfer_us(mem, read, len) + slave_->latency_us_,
+                                    [this] { complete(); });
+    return HAL_OK;
+}
+
+void Bus::complete()
+{
+    event_ = 0;
+    switch (kind_)
+    {
+    case Kind::MasterTx:
+        slave_->pointer_ = data_[0];
+        if (len_ > 1U)
+            slave_->on_write(slave_->pointer_, data_ + 1, static_cast<uint16_t>(len_ - 1U));
+        slave_->pointer_ = static_cast<uint8_t>(slave_->pointer_ + len_ - 1U);
+        ++slave_->writes_;
+        break;
+    case Kind::MemTx:
+        slave_->on_write(reg_, data_, len_);
+        slave_->pointer_ = static_cast<uint8_t>(reg_ + len_);
+        ++slave_->writes_;
+        break;
+    case Kind::MasterRx:
+        slave_->on_read(slave_->pointer_, data_, len_);
+        slave_->pointer_ = static_cast<uint8_t>(slave_->pointer_ + len_);
+        ++slave_->reads_;
+        break;
+    case Kind::MemRx:
+        slave_->on_read(reg_, data_, len_);
+        slave_->pointer_ = static_cast<uint8_t>(reg_ + len_);
+        ++slave_->reads_;
+        break;
+    }
+
+    const Kind kind = kind_;
+    end_transfer();
+    hi2c_->State = HAL_I2C_STATE_READY;
+    switch (kind)
+    {
+    case Kind::MasterTx:
+        HAL_I2C_MasterTxCpltCallback(hi2c_);
+        break;
+    case Kind::MasterRx:
+        HAL_I2C_MasterRxCpltCallback(hi2c_);
+        break;
+    case Kind::MemTx:
+        HAL_I2C_MemTxCpltCallback(hi2c_);
+        break;
+    case Kind::MemRx:
+        HAL_I2C_MemRxCpltCallback(hi2c_);
+        break;
+    }
+}
+
+void Bus::fail(const uint32_t error)
+{
+    event_ = 0;
+    end_transfer();
+    hi2c_->ErrorCode |= error;
+    hi2c_->State = HAL_I2C_STATE_READY;
+    HAL_I2C_ErrorCallback(hi2c_);
+}
+
+void Bus::end_transfer()
+{
+    busy_us_ += rtos_sim::now_us() - start_us_;
+    ++transfers_;
+    active_ = false;
+}
+
+void Bus::reset()
+{
+    if (active_)
+    {
+        if (event_ != 0)
+            (void) rtos_sim::cancel_isr(event_);
+        event_ = 0;
+        end_transfer();
+    }
+    ++resets_;
+}
+
+void Bus::scl_rising_edge()
+{
+    ++scl_pulses_;
+    for (Slave* slave : slaves_)
+        if (slave->sda_clocks_ != 0 && slave->sda_clocks_ != UINT32_MAX)
+            --slave->sda_clocks_;
+}
+
+void Bus::sda_stuck()
+{
+    if (!active_ || event_ == 0)
+        return;
+    // 主机发送隐性位时读到显性，仲裁丢失
+    (void) rtos_sim::cancel_isr(event_);
+    event_ = rtos_sim::schedule_isr(rtos_sim::now_us(), [this] { fail(HAL_I2C_ERROR_ARLO); });
+}
+
+} // namespace i2c_sim
+
+using i2c_sim::Bus;
+
+/*
+ * GPIO
+ */
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init)
+{
+    for (uint32_t bit = 0; bit < 16; ++bit)
+        if ((GPIO_Init->Pin & (1U << bit)) != 0)
+            i2c_sim::pin_state(GPIOx, static_cast<uint16_t>(1U << bit)).mode = GPIO_Init->Mode;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, const uint16_t GPIO_Pin, const GPIO_PinState PinState)
+{
+    for (uint32_t bit = 0; bit < 16; ++bit)
+    {
+        const auto pin = static_cast<uint16_t>(1U << bit);
+        if ((GPIO_Pin & pin) == 0)
+            continue;
+        i2c_sim::Pin& state    = i2c_sim::pin_state(GPIOx, pin);
+        const bool    rising   = state.output == GPIO_PIN_RESET && PinState == GPIO_PIN_SET;
+        state.output           = PinState;
+        if (Bus* bus = Bus::from_pin(GPIOx, pin); bus != nullptr && rising && i2c_sim::is_output(state.mode) &&
+                                                  bus->is_scl(GPIOx, pin))
+            bus->scl_rising_edge();
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, const uint16_t GPIO_Pin)
+{
+    if (Bus* bus = Bus::from_pin(GPIOx, GPIO_Pin); bus != nullptr)
+    {
+        const bool low = bus->is_scl(GPIOx, GPIO_Pin) ? bus->scl_low() : bus->sda_low();
+        return low ? GPIO_PIN_RESET : GPIO_PIN_SET;
+    }
+    return i2c_sim::pin_state(GPIOx, GPIO_Pin).output;
+}
+
+/*
+ * DMA
+ */
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef* hdma)
+{
+    // DMA 只在 I2C 事务内部使用，中止由 HAL_I2C_DeInit 一并处理
+    return hdma != nullptr ? HAL_OK : HAL_ERROR;
+}
+
+/*
+ * I2C
+ */
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c == nullptr)
+        return HAL_ERROR;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    hi2c->State     = HAL_I2C_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c == nullptr)
+        return HAL_ERROR;
+    if (Bus* bus = Bus::from(hi2c); bus != nullptr)
+        bus->reset();
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    hi2c->State     = HAL_I2C_STATE_RESET;
+    return HAL_OK;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(const I2C_HandleTypeDef* hi2c)
+{
+    return hi2c->State;
+}
+
+uint32_t HAL_I2C_GetError(const I2C_HandleTypeDef* hi2c)
+{
+    return hi2c->ErrorCode;
+}
+
+namespace
+{
+
+HAL_StatusTypeDef start(I2C_HandleTypeDef* hi2c,
+                        const Bus::Kind    kind,
+                        const uint16_t     address,
+                        const uint16_t     reg,
+                        uint8_t*           data,
+                        const uint16_t     len)
+{
+    Bus* bus = Bus::from(hi2c);
+    return bus != nullptr ? bus->start(kind, address, reg, data, len) : HAL_ERROR;
+}
+
+} // namespace
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef* hi2c,
+                                              const uint16_t     DevAddress,
+                                              uint8_t*           pData,
+                                              const uint16_t     Size)
+{
+    return start(hi2c, Bus::Kind::MasterTx, DevAddress, 0, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_DMA(I2C_HandleTypeDef* hi2c,
+                                             const uint16_t     DevAddress,
+                                             uint8_t*           pData,
+                                             const uint16_t     Size)
+{
+    return start(hi2c, Bus::Kind::MasterRx, DevAddress, 0, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef* hi2c,
+                                        const uint16_t     DevAddress,
+                                        const uint16_t     MemAddress,
+                                        uint16_t,
+                                        uint8_t*       pData,
+                                        const uint16_t Size)
+{
+    return start(hi2c, Bus::Kind::MemTx, DevAddress, MemAddress, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef* hi2c,
+                                       const uint16_t     DevAddress,
+                                       const uint16_t     MemAddress,
+                                       uint16_t,
+                                       uint8_t*       pData,
+                                       const uint16_t Size)
+{
+    return start(hi2c, Bus::Kind::MemRx, DevAddress, MemAddress, pData, Size);
+}
+
+// 与 HAL 相同，默认回调是弱符号，由驱动覆盖
+extern "C"
+{
+__attribute__((weak)) void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef*) {}
+__attribute__((weak)) void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef*) {}
+__attribute__((weak)) void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef*) {}
+__attribute__((weak)) void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef*) {}
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef*) {}
+}
@@ -0,0 +1,188 @@
+/**
+ * @file    i2c_sim.hpp
+ * @brief   主机仿真的 I2C 总线与可编程从机，实现 i2c_hal.h 中的 HAL_I2C_* / HAL_GPIO_* 接口。
+ *
+ * 一个 Bus 绑定一个 I2C_HandleTypeDef 和它的 SCL / SDA 引脚。DMA 启动接口按 SCL 频率计算事务时长
+ * （START、地址、寄存器地址、数据各 9 位、STOP，加上从机的时钟延展），在 rtos_sim 的仿真时钟上
+ * 安排完成中断；中断里先把句柄状态置回 READY，再调用 HAL 的全局回调，与真实 HAL 的顺序一致。
+ *
+ * 从机可以脚本化地制造故障：
+ *
+ * - nack_next(n)：之后 n 次寻址不应答，事务在地址阶段以 HAL_I2C_ERROR_AF 结束
+ * - hang_next(n)：之后 n 笔事务进行到一半停止响应，完成中断永远不来，直到主机 HAL_I2C_DeInit 复位外设
+ * - hold_sda(clocks)：把 SDA 拉低，进行中的事务以 HAL_I2C_ERROR_ARLO 结束；
+ *   新事务在 HAL 等 BUSY 标志的 25 ms 后返回 HAL_BUSY。收到 clocks 个 SCL 脉冲（恢复流程用 GPIO 产生）后释放，
+ *   UINT32_MAX 表示一直不释放
+ *
+ * GPIO 只模拟总线引脚：开漏输出低电平或从机拉低时读到低电平，其余引脚读回输出值。
+ */
+#pragma once
+
+#include "main.h"
+#include "rtos_sim.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace i2c_sim
+{
+
+class Bus;
+
+/**
+ * 一个带 256 字节寄存器表的从机
+ *
+ * 寄存器读写地址自动递增。原始写（不带寄存器地址）的第一个字节设置寄存器指针，其余字节从指针处写入；
+ * 原始读从寄存器指针处读出。需要其他行为时重写 on_write / on_read。
+ */
+class Slave
+{
+public:
+    explicit Slave(uint8_t address_7bit) : address_(address_7bit) {}
+    virtual ~Slave() = default;
+
+    Slave(const Slave&)            = delete;
+    Slave& operator=(const Slave&) = delete;
+
+    [[nodiscard]] uint8_t address() const { return address_; }
+
+    uint8_t&                reg(const uint8_t index) { return regs_[index]; }
+    [[nodiscard]] uint8_t   reg(const uint8_t index) const { return regs_[index]; }
+    void                    set_registers(uint8_t first, const uint8_t* data, size_t len);
+
+    /// 每笔事务额外的时钟延展时间
+    void set_latency_us(const uint32_t latency_us) { latency_us_ = latency_us; }
+
+    /// 之后 count 次寻址不应答
+    void nack_next(const uint32_t count = 1) { nack_count_ = count; }
+
+    /// 之后 count 笔事务停止响应，直到外设复位
+    void hang_next(const uint32_t count = 1) { hang_count_ = count; }
+
+    /// 拉低 SDA，收到 clocks 个 SCL 脉冲后释放；UINT32_MAX 表示一直不释放
+    void hold_sda(uint32_t clocks = UINT32_MAX);
+
+    [[nodiscard]] bool holding_sda() const { return sda_clocks_ != 0; }
+
+    /// 成功完成的读 / 写事务数
+    [[nodiscard]] uint32_t reads() const { return reads_; }
+    [[nodiscard]] uint32_t writes() const { return writes_; }
+    /// 不应答的寻址次数
+    [[nodiscard]] uint32_t nacks() const { return nacks_; }
+
+protected:
+    /**
+     * 主机写入，reg 为寄存器地址（原始写时为当前寄存器指针）
+     */
+    virtual void on_write(uint8_t reg, const uint8_t* data, uint16_t len);
+
+    /**
+     * 主机读出，reg 为寄存器地址（原始读时为当前寄存器指针）
+     */
+    virtual void on_read(uint8_t reg, uint8_t* data, uint16_t len);
+
+private:
+    friend class Bus;
+
+    uint8_t  address_;
+    uint8_t  regs_[256]{};
+    uint8_t  pointer_{ 0 };
+    uint32_t latency_us_{ 0 };
+    uint32_t nack_count_{ 0 };
+    uint32_t hang_count_{ 0 };
+    uint32_t sda_clocks_{ 0 };
+    uint32_t reads_{ 0 };
+    uint32_t writes_{ 0 };
+    uint32_t nacks_{ 0 };
+    Bus*     bus_{ nullptr };
+};
+
+/**
+ * 一条 I2C 总线，构造时绑定句柄并把句柄初始化为 READY
+ */
+class Bus
+{
+public:
+    Bus(I2C_HandleTypeDef* hi2c, GPIO_TypeDef* scl_port, uint16_t scl_pin, GPIO_TypeDef* sda_port, uint16_t sda_pin);
+    ~Bus();
+
+    Bus(const Bus&)            = delete;
+    Bus& operator=(const Bus&) = delete;
+
+    void attach(Slave& slave);
+
+    [[nodiscard]] I2C_HandleTypeDef* handle() const { return hi2c_; }
+
+    /// 之后 count 次 DMA 启动返回 HAL_ERROR
+    void fail_next_starts(const uint32_t count = 1) { fail_starts_ = count; }
+
+    /// 一笔事务在总线上的时长（不含从机延展）
+    [[nodiscard]] uint64_t transfer_us(bool mem, bool read, uint16_t len) const;
+
+    /// 已结束（成功、出错或被复位打断）的事务数
+    [[nodiscard]] uint32_t transfers() const { return transfers_; }
+    /// 总线上实际传输的累计时间，单位微秒
+    [[nodiscard]] uint64_t busy_us() const { return busy_us_; }
+    /// HAL_I2C_DeInit 的调用次数
+    [[nodiscard]] uint32_t resets() const { return resets_; }
+    /// 引脚处于 GPIO 输出模式时产生的 SCL 上升沿数
+    [[nodiscard]] uint32_t scl_pulses() const { return scl_pulses_; }
+    /// 当前是否有事务在进行
+    [[nodiscard]] bool     active() const { return active_; }
+
+    [[nodiscard]] bool sda_low() const;
+    [[nodiscard]] bool scl_low() const;
+
+    static Bus* from(const I2C_HandleTypeDef* hi2c);
+    static Bus* from_pin(const GPIO_TypeDef* port, uint16_t pin);
+
+    /*
+     * 以下供 HAL 实现调用
+     */
+
+    enum class Kind : uint8_t
+    {
+        MasterTx,
+        MasterRx,
+        MemTx,
+        MemRx,
+    };
+
+    HAL_StatusTypeDef start(Kind kind, uint16_t address_8bit, uint16_t reg, uint8_t* data, uint16_t len);
+    void              reset();
+    void              scl_rising_edge();
+    void              sda_stuck();
+
+    [[nodiscard]] bool is_scl(const GPIO_TypeDef* port, uint16_t pin) const;
+    [[nodiscard]] bool is_sda(const GPIO_TypeDef* port, uint16_t pin) const;
+
+private:
+    void complete();
+    void fail(uint32_t error);
+    void end_transfer();
+
+    I2C_HandleTypeDef*  hi2c_;
+    GPIO_TypeDef*       scl_port_;
+    uint16_t            scl_pin_;
+    GPIO_TypeDef*       sda_port_;
+    uint16_t            sda_pin_;
+    std::vector<Slave*> slaves_;
+
+    bool              active_{ false };
+    Kind              kind_{ Kind::MasterTx };
+    Slave*            slave_{ nullptr };
+    uint8_t           reg_{ 0 };
+    uint8_t*          data_{ nullptr };
+    uint16_t          len_{ 0 };
+    uint64_t          start_us_{ 0 };
+    rtos_sim::EventId event_{ 0 };
+
+    uint32_t fail_starts_{ 0 };
+    uint32_t transfers_{ 0 };
+    uint64_t busy_us_{ 0 };
+    uint32_t resets_{ 0 };
+    uint32_t scl_pulses_{ 0 };
+};
+
+} // namespace i2c_sim
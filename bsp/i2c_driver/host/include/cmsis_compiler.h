@@ -0,0 +1,54 @@
+/**
+ * @file    cmsis_compiler.h
+ * @brief   主机仿真用的 CMSIS 内核指令。
+ *
+ * 仿真的 RTOS 是单核的：任一时刻只有一个仿真线程在运行，中断也在这个“CPU”上执行，
+ * 所以 PRIMASK 是一个全局状态。PRIMASK 置位期间到期的中断挂起，恢复为 0 时立即依次响应。
+ */
+#pragma once
+
+// isr_lock.h 在 extern "C" 中包含本文件，这里只能使用 C 头文件
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+uint32_t sim_get_primask(void);
+void     sim_set_primask(uint32_t primask);
+uint32_t sim_get_ipsr(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return sim_get_primask();
+}
+
+static inline void __set_PRIMASK(const uint32_t primask)
+{
+    sim_set_primask(primask);
+}
+
+static inline void __disable_irq(void)
+{
+    sim_set_primask(1);
+}
+
+static inline void __enable_irq(void)
+{
+    sim_set_primask(0);
+}
+
+static inline uint32_t __get_IPSR(void)
+{
+    return sim_get_ipsr();
+}
+
+static inline void __DSB(void) {}
+static inline void __ISB(void) {}
+static inline void __DMB(void) {}
+static inline void __NOP(void) {}
@@ -0,0 +1,148 @@
+/**
+ * @file    cmsis_os2.h
+ * @brief   主机仿真用的 CMSIS-RTOS v2 子集，由 rtos_sim.cpp 在 pthread 上实现。
+ *
+ * 只包含 I2C 驱动和 I2CUpdateManager 用到的接口：内核状态与 tick、线程、线程标志、osDelay 和软件定时器。
+ * 语义按 CMSIS-RTOS v2 文档实现，与真实内核的差异见 rtos_sim.hpp。
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define osWaitForever 0xFFFFFFFFU
+
+#define osFlagsWaitAny 0x00000000U
+#define osFlagsWaitAll 0x00000001U
+#define osFlagsNoClear 0x00000002U
+
+#define osFlagsError 0x80000000U
+#define osFlagsErrorUnknown 0xFFFFFFFFU
+#define osFlagsErrorTimeout 0xFFFFFFFEU
+#define osFlagsErrorResource 0xFFFFFFFDU
+#define osFlagsErrorParameter 0xFFFFFFFCU
+#define osFlagsErrorISR 0xFFFFFFFAU
+
+typedef enum
+{
+    osKernelInactive  = 0,
+    osKernelReady     = 1,
+    osKernelRunning   = 2,
+    osKernelLocked    = 3,
+    osKernelSuspended = 4,
+    osKernelError     = -1,
+    osKernelReserved  = 0x7FFFFFFF
+} osKernelState_t;
+
+typedef enum
+{
+    osThreadInactive   = 0,
+    osThreadReady      = 1,
+    osThreadRunning    = 2,
+    osThreadBlocked    = 3,
+    osThreadTerminated = 4,
+    osThreadError      = -1,
+    osThreadReserved   = 0x7FFFFFFF
+} osThreadState_t;
+
+typedef enum
+{
+    osPriorityNone         = 0,
+    osPriorityIdle         = 1,
+    osPriorityLow          = 8,
+    osPriorityLow1         = 8 + 1,
+    osPriorityBelowNormal  = 16,
+    osPriorityBelowNormal1 = 16 + 1,
+    osPriorityNormal       = 24,
+    osPriorityNormal1      = 24 + 1,
+    osPriorityAboveNormal  = 32,
+    osPriorityAboveNormal1 = 32 + 1,
+    osPriorityHigh         = 40,
+    osPriorityHigh1        = 40 + 1,
+    osPriorityRealtime     = 48,
+    osPriorityRealtime1    = 48 + 1,
+    osPriorityISR          = 56,
+    osPriorityError        = -1,
+    osPriorityReserved     = 0x7FFFFFFF
+} osPriority_t;
+
+typedef enum
+{
+    osOK             = 0,
+    osError          = -1,
+    osErrorTimeout   = -2,
+    osErrorResource  = -3,
+    osErrorParameter = -4,
+    osErrorNoMemory  = -5,
+    osErrorISR       = -6,
+    osStatusReserved = 0x7FFFFFFF
+} osStatus_t;
+
+typedef enum
+{
+    osTimerOnce     = 0,
+    osTimerPeriodic = 1
+} osTimerType_t;
+
+typedef void* osThreadId_t;
+typedef void* osTimerId_t;
+
+typedef void (*osThreadFunc_t)(void* argument);
+typedef void (*osTimerFunc_t)(void* argument);
+
+typedef struct
+{
+    const char*  name;
+    uint32_t     attr_bits;
+    void*        cb_mem;
+    uint32_t     cb_size;
+    void*        stack_mem;
+    uint32_t     stack_size;
+    osPriority_t priority;
+    uint32_t     tz_module;
+    uint32_t     reserved;
+} osThreadAttr_t;
+
+typedef struct
+{
+    const char* name;
+    uint32_t    attr_bits;
+    void*       cb_mem;
+    uint32_t    cb_size;
+} osTimerAttr_t;
+
+osStatus_t      osKernelInitialize(void);
+osStatus_t      osKernelStart(void);
+osKernelState_t osKernelGetState(void);
+uint32_t        osKernelGetTickCount(void);
+uint32_t        osKernelGetTickFreq(void);
+
+osThreadId_t    osThreadNew(osThreadFunc_t func, void* argument, const osThreadAttr_t* attr);
+osThreadId_t    osThreadGetId(void);
+const char*     osThreadGetName(osThreadId_t thread_id);
+osThreadState_t osThreadGetState(osThreadId_t thread_id);
+osPriority_t    osThreadGetPriority(osThreadId_t thread_id);
+osStatus_t      osThreadYield(void);
+void            osThreadExit(void);
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags);
+uint32_t osThreadFlagsClear(uint32_t flags);
+uint32_t osThreadFlagsGet(void);
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout);
+
+osStatus_t osDelay(uint32_t ticks);
+osStatus_t osDelayUntil(uint32_t ticks);
+
+osTimerId_t osTimerNew(osTimerFunc_t func, osTimerType_t type, void* argument, const osTimerAttr_t* attr);
+osStatus_t  osTimerStart(osTimerId_t timer_id, uint32_t ticks);
+osStatus_t  osTimerStop(osTimerId_t timer_id);
+uint32_t    osTimerIsRunning(osTimerId_t timer_id);
+osStatus_t  osTimerDelete(osTimerId_t timer_id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,11 @@
+/**
+ * @file    i2c.h
+ * @brief   主机仿真用的 i2c.h，代替 CubeMX 生成的同名头文件。
+ */
+#pragma once
+
+#include "main.h"
+
+extern I2C_HandleTypeDef hi2c1;
+extern I2C_HandleTypeDef hi2c2;
+extern I2C_HandleTypeDef hi2c3;
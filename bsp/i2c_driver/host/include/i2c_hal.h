@@ -0,0 +1,207 @@
+/**
+ * @file    i2c_hal.h
+ * @brief   主机仿真用的 GPIO / DMA / I2C HAL 子集，接口与 STM32F4 HAL 同名同义。
+ *
+ * 外设没有寄存器模型：I2C 的 DMA 事务由 i2c_sim.cpp 按总线时序在仿真时钟上排期，
+ * 结束时像真实 HAL 一样先把句柄状态置回 READY，再在“中断”中调用 HAL_I2C_*CpltCallback / HAL_I2C_ErrorCallback。
+ * 这些回调在仿真中是弱符号，驱动提供的同名函数会覆盖它们。
+ */
+#pragma once
+
+#include <cstdint>
+
+/*
+ * GPIO
+ */
+
+typedef struct
+{
+    uint32_t id; ///< 仅用于区分端口，引脚电平由 i2c_sim 的线路模型维护
+} GPIO_TypeDef;
+
+typedef struct
+{
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0 ((uint16_t) 0x0001)
+#define GPIO_PIN_1 ((uint16_t) 0x0002)
+#define GPIO_PIN_2 ((uint16_t) 0x0004)
+#define GPIO_PIN_3 ((uint16_t) 0x0008)
+#define GPIO_PIN_4 ((uint16_t) 0x0010)
+#define GPIO_PIN_5 ((uint16_t) 0x0020)
+#define GPIO_PIN_6 ((uint16_t) 0x0040)
+#define GPIO_PIN_7 ((uint16_t) 0x0080)
+#define GPIO_PIN_8 ((uint16_t) 0x0100)
+#define GPIO_PIN_9 ((uint16_t) 0x0200)
+#define GPIO_PIN_10 ((uint16_t) 0x0400)
+#define GPIO_PIN_11 ((uint16_t) 0x0800)
+#define GPIO_PIN_12 ((uint16_t) 0x1000)
+#define GPIO_PIN_13 ((uint16_t) 0x2000)
+#define GPIO_PIN_14 ((uint16_t) 0x4000)
+#define GPIO_PIN_15 ((uint16_t) 0x8000)
+
+#define GPIO_MODE_INPUT 0x00000000U
+#define GPIO_MODE_OUTPUT_PP 0x00000001U
+#define GPIO_MODE_OUTPUT_OD 0x00000011U
+#define GPIO_MODE_AF_PP 0x00000002U
+#define GPIO_MODE_AF_OD 0x00000012U
+
+#define GPIO_NOPULL 0x00000000U
+#define GPIO_PULLUP 0x00000001U
+#define GPIO_PULLDOWN 0x00000002U
+
+#define GPIO_SPEED_FREQ_LOW 0x00000000U
+#define GPIO_SPEED_FREQ_MEDIUM 0x00000001U
+#define GPIO_SPEED_FREQ_HIGH 0x00000002U
+#define GPIO_SPEED_FREQ_VERY_HIGH 0x00000003U
+
+#define GPIO_AF4_I2C1 ((uint8_t) 0x04)
+#define GPIO_AF4_I2C2 ((uint8_t) 0x04)
+#define GPIO_AF4_I2C3 ((uint8_t) 0x04)
+
+extern GPIO_TypeDef sim_gpio[8];
+
+#define GPIOA (&sim_gpio[0])
+#define GPIOB (&sim_gpio[1])
+#define GPIOC (&sim_gpio[2])
+#define GPIOD (&sim_gpio[3])
+#define GPIOE (&sim_gpio[4])
+#define GPIOF (&sim_gpio[5])
+#define GPIOG (&sim_gpio[6])
+#define GPIOH (&sim_gpio[7])
+
+void          HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init);
+void          HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+
+/*
+ * DMA
+ */
+
+typedef enum
+{
+    HAL_DMA_STATE_RESET = 0x00U,
+    HAL_DMA_STATE_READY = 0x01U,
+    HAL_DMA_STATE_BUSY  = 0x02U,
+    HAL_DMA_STATE_ABORT = 0x05U
+} HAL_DMA_StateTypeDef;
+
+typedef struct
+{
+    void*                         Instance;
+    volatile HAL_DMA_StateTypeDef State;
+    volatile uint32_t             ErrorCode;
+} DMA_HandleTypeDef;
+
+#define HAL_DMA_ERROR_NONE 0x00000000U
+#define HAL_DMA_ERROR_NO_XFER 0x00000080U
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef* hdma);
+
+/*
+ * I2C
+ */
+
+typedef struct
+{
+    uint32_t id;
+} I2C_TypeDef;
+
+extern I2C_TypeDef sim_i2c[3];
+
+#define I2C1 (&sim_i2c[0])
+#define I2C2 (&sim_i2c[1])
+#define I2C3 (&sim_i2c[2])
+
+typedef struct
+{
+    uint32_t ClockSpeed; ///< SCL 频率，仿真据此计算事务时长
+    uint32_t DutyCycle;
+    uint32_t OwnAddress1;
+    uint32_t AddressingMode;
+    uint32_t DualAddressMode;
+    uint32_t OwnAddress2;
+    uint32_t GeneralCallMode;
+    uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef enum
+{
+    HAL_I2C_STATE_RESET   = 0x00U,
+    HAL_I2C_STATE_READY   = 0x20U,
+    HAL_I2C_STATE_BUSY    = 0x24U,
+    HAL_I2C_STATE_BUSY_TX = 0x21U,
+    HAL_I2C_STATE_BUSY_RX = 0x22U,
+    HAL_I2C_STATE_LISTEN  = 0x28U,
+    HAL_I2C_STATE_ABORT   = 0x60U,
+    HAL_I2C_STATE_TIMEOUT = 0xA0U,
+    HAL_I2C_STATE_ERROR   = 0xE0U
+} HAL_I2C_StateTypeDef;
+
+#define HAL_I2C_ERROR_NONE 0x00000000U
+#define HAL_I2C_ERROR_BERR 0x00000001U
+#define HAL_I2C_ERROR_ARLO 0x00000002U
+#define HAL_I2C_ERROR_AF 0x00000004U
+#define HAL_I2C_ERROR_OVR 0x00000008U
+#define HAL_I2C_ERROR_DMA 0x00000010U
+#define HAL_I2C_ERROR_TIMEOUT 0x00000020U
+#define HAL_I2C_ERROR_SIZE 0x00000040U
+#define HAL_I2C_ERROR_DMA_PARAM 0x00000080U
+#define HAL_I2C_WRONG_START 0x00000200U
+
+#define I2C_MEMADD_SIZE_8BIT 0x00000001U
+#define I2C_MEMADD_SIZE_16BIT 0x00000010U
+
+#define I2C_ADDRESSINGMODE_7BIT 0x00004000U
+#define I2C_DUTYCYCLE_2 0x00000000U
+
+typedef struct __I2C_HandleTypeDef
+{
+    I2C_TypeDef*                  Instance;
+    I2C_InitTypeDef               Init;
+    DMA_HandleTypeDef*            hdmatx;
+    DMA_HandleTypeDef*            hdmarx;
+    HAL_LockTypeDef               Lock;
+    volatile HAL_I2C_StateTypeDef State;
+    volatile uint32_t             ErrorCode;
+} I2C_HandleTypeDef;
+
+HAL_StatusTypeDef    HAL_I2C_Init(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef    HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(const I2C_HandleTypeDef* hi2c);
+uint32_t             HAL_I2C_GetError(const I2C_HandleTypeDef* hi2c);
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef* hi2c,
+                                        uint16_t           DevAddress,
+                                        uint16_t           MemAddress,
+                                        uint16_t           MemAddSize,
+                                        uint8_t*           pData,
+                                        uint16_t           Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef* hi2c,
+                                       uint16_t           DevAddress,
+                                       uint16_t           MemAddress,
+                                       uint16_t           MemAddSize,
+                                       uint8_t*           pData,
+                                       uint16_t           Size);
+
+extern "C"
+{
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c);
+}
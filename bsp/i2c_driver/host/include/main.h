@@ -0,0 +1,104 @@
+/**
+ * @file    main.h
+ * @brief   主机仿真用的 main.h，代替 CubeMX 生成的同名头文件。
+ *
+ * 只提供 I2C 驱动和 I2CUpdateManager 用到的那部分 CMSIS / HAL：DWT 周期计数器、HAL_GetTick / HAL_Delay，
+ * 以及 i2c_hal.h 中的 GPIO、DMA 和 I2C 接口。时间全部来自 rtos_sim 的仿真时钟。
+ *
+ * 本头文件只用于 C++ 的主机构建。
+ */
+#pragma once
+
+#ifndef __cplusplus
+#    error "the host simulation headers are C++ only"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#define __IO volatile
+#define __I volatile const
+#define __O volatile
+
+#define UNUSED(X) (void) (X)
+
+/*
+ * Cortex-M 内核
+ */
+
+/**
+ * DWT CYCCNT：按 SystemCoreClock 由仿真时钟换算，只读
+ *
+ * 线程每读一次计数器视为消耗一小段 CPU 时间（见 rtos_sim::ClockReadCostUs），
+ * 以 DWT 忙等的代码因此能在仿真中看到时间前进
+ */
+class SimCycleCounter
+{
+public:
+    operator uint32_t() const;
+};
+
+typedef struct
+{
+    uint32_t        CTRL;
+    SimCycleCounter CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    uint32_t DHCSR;
+    uint32_t DCRSR;
+    uint32_t DCRDR;
+    uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type       sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_core_debug)
+
+#define DWT_CTRL_CYCCNTENA_Pos (0U)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << DWT_CTRL_CYCCNTENA_Pos)
+#define CoreDebug_DEMCR_TRCENA_Pos (24U)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << CoreDebug_DEMCR_TRCENA_Pos)
+
+extern uint32_t SystemCoreClock;
+
+/*
+ * HAL 公共部分
+ */
+
+typedef enum
+{
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    HAL_UNLOCKED = 0x00U,
+    HAL_LOCKED   = 0x01U
+} HAL_LockTypeDef;
+
+typedef enum
+{
+    DISABLE = 0U,
+    ENABLE  = !DISABLE
+} FunctionalState;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+/// 仿真时钟的毫秒数
+uint32_t HAL_GetTick();
+
+/// 忙等 delay_ms 毫秒（调用线程占着 CPU，期间中断照常响应）
+void HAL_Delay(uint32_t delay_ms);
+
+/// 仿真中的 Error_Handler 打印调用位置后终止测试
+#define Error_Handler() sim_error_handler(__FILE__, __LINE__)
+[[noreturn]] void sim_error_handler(const char* file, int line);
+
+#include "i2c_hal.h"
@@ -0,0 +1,767 @@
+/**
+ * @file    rtos_sim.cpp
+ * @brief   单核虚拟时间的 CMSIS-RTOS v2 内核、CMSIS 内核指令与 HAL 时钟。
+ */
+#include "rtos_sim.hpp"
+
+#include "cmsis_compiler.h"
+#include "main.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rtos_sim
+{
+
+namespace
+{
+
+constexpr uint64_t TickUs  = 1000;
+constexpr uint32_t IsrIpsr = 16; // 外设中断的异常号从 16 开始
+
+enum class Wait : uint8_t
+{
+    None,
+    Flags,
+    Delay,
+};
+
+struct Thread
+{
+    std::string     name;
+    osPriority_t    priority{ osPriorityNormal };
+    osThreadFunc_t  func{ nullptr };
+    void*           argument{ nullptr };
+    osThreadState_t state{ osThreadReady };
+    uint64_t        ready_seq{ 0 };   // 进入就绪的先后，同优先级先就绪先运行
+    uint32_t        flags{ 0 };
+    Wait            wait{ Wait::None };
+    uint32_t        wait_flags{ 0 };
+    uint32_t        wait_options{ 0 };
+    uint64_t        wake_at{ NEVER }; // 等待超时时刻
+    uint32_t        wait_result{ 0 };
+    uint32_t        wakeups{ 0 };
+    std::condition_variable cv;       // 轮到本线程运行时通知
+};
+
+struct Timer
+{
+    osTimerFunc_t func{ nullptr };
+    void*         argument{ nullptr };
+    osTimerType_t type{ osTimerOnce };
+    uint32_t      ticks{ 0 };
+    uint64_t      expire_at{ NEVER }; // NEVER 表示未运行
+};
+
+struct Event
+{
+    uint64_t              at;
+    EventId               id;
+    std::function<void()> isr;
+};
+
+/**
+ * 内核状态
+ *
+ * 只有持有运行权（running == 自己）的线程会修改状态，互斥锁只用来配合条件变量交接运行权。
+ * 对象永不析构：进程退出时其他仿真线程仍阻塞在条件变量上。
+ */
+struct Kernel
+{
+    std::mutex           mutex;
+    osKernelState_t      state{ osKernelInactive };
+    uint64_t             now_us{ 0 };
+    std::vector<Thread*> threads;
+    std::vector<Timer*>  timers;
+    std::vector<Event>   events;
+    Thread*              running{ nullptr };
+    uint64_t             next_seq{ 0 };
+    EventId              next_event_id{ 0 };
+    uint32_t             primask{ 0 };
+    uint32_t             ipsr{ 0 };
+    bool                 in_timer{ false }; // 正在调用软件定时器回调
+};
+
+Kernel& kernel()
+{
+    static auto* k = new Kernel;
+    return *k;
+}
+
+thread_local Thread* self_ = nullptr;
+
+using Lock = std::unique_lock<std::mutex>;
+
+/// 调用者是否是正在运行的线程本身（而不是中断或定时器回调）
+bool thread_context(const Kernel& k)
+{
+    return k.ipsr == 0 && !k.in_timer && self_ != nullptr && k.running == self_ &&
+           self_->state == osThreadRunning;
+}
+
+uint64_t tick_deadline(const Kernel& k, const uint32_t ticks)
+{
+    return (k.now_us / TickUs + ticks) * TickUs;
+}
+
+void make_ready(Kernel& k, Thread* thread)
+{
+    if (thread->state == osThreadBlocked)
+        ++thread->wakeups;
+    thread->state     = osThreadReady;
+    thread->ready_seq = k.next_seq++;
+    thread->wait      = Wait::None;
+    thread->wake_at   = NEVER;
+}
+
+Thread* pick_ready(const Kernel& k)
+{
+    Thread* best = nullptr;
+    for (Thread* thread : k.threads)
+    {
+        if (thread->state != osThreadReady)
+            continue;
+        if (best == nullptr || thread->priority > best->priority ||
+            (thread->priority == best->priority && thread->ready_seq < best->ready_seq))
+            best = thread;
+    }
+    return best;
+}
+
+bool flags_satisfied(Thread* thread, const uint32_t flags, const uint32_t options, uint32_t* result)
+{
+    const bool all = (options & osFlagsWaitAll) != 0;
+    if (all ? (thread->flags & flags) != flags : (thread->flags & flags) == 0)
+        return false;
+    *result = thread->flags;
+    if ((options & osFlagsNoClear) == 0)
+        thread->flags &= ~flags;
+    return true;
+}
+
+uint64_t next_event_time(const Kernel& k)
+{
+    uint64_t next = NEVER;
+    for (const Event& event : k.events)
+        next = std::min(next, event.at);
+    for (const Thread* thread : k.threads)
+        if (thread->state == osThreadBlocked)
+            next = std::min(next, thread->wake_at);
+    for (const Timer* timer : k.timers)
+        next = std::min(next, timer->expire_at);
+    return next;
+}
+
+/**
+ * 处理一个已到期的事件：线程等待超时、定时器、中断，按时刻先后
+ * @return 是否处理了事件
+ */
+bool fire_one(Kernel& k, Lock& lock)
+{
+    Thread* timeout = nullptr;
+    for (Thread* thread : k.threads)
+        if (thread->state == osThreadBlocked && thread->wake_at <= k.now_us &&
+            (timeout == nullptr || thread->wake_at < timeout->wake_at))
+            timeout = thread;
+    Timer* timer = nullptr;
+    for (Timer* t : k.timers)
+        if (t->expire_at <= k.now_us && (timer == nullptr || t->expire_at < timer->expire_at))
+            timer = t;
+    const Event* event = nullptr;
+    for (const Event& e : k.events)
+        if (e.at <= k.now_us && (event == nullptr || e.at < event->at || (e.at == event->at && e.id < event->id)))
+            event = &e;
+
+    const uint64_t timeout_at = timeout != nullptr ? timeout->wake_at : NEVER;
+    const uint64_t timer_at   = timer != nullptr ? timer->expire_at : NEVER;
+    const uint64_t event_at   = event != nullptr ? event->at : NEVER;
+
+    if (timeout != nullptr && timeout_at <= timer_at && timeout_at <= event_at)
+    {
+        if (timeout->wait == Wait::Flags)
+            timeout->wait_result = osFlagsErrorTimeout;
+        make_ready(k, timeout);
+        return true;
+    }
+
+    if (timer != nullptr && timer_at <= event_at)
+    {
+        timer->expire_at = timer->type == osTimerPeriodic ? timer_at + timer->ticks * TickUs : NEVER;
+        const osTimerFunc_t func     = timer->func;
+        void* const         argument = timer->argument;
+        k.in_timer                   = true;
+        lock.unlock();
+        func(argument);
+        lock.lock();
+        k.in_timer = false;
+        return true;
+    }
+
+    if (event != nullptr)
+    {
+        const std::function<void()> isr = event->isr;
+        k.events.erase(k.events.begin() + (event - k.events.data()));
+        const uint32_t saved_ipsr = k.ipsr;
+        k.ipsr                    = IsrIpsr;
+        lock.unlock();
+        isr();
+        lock.lock();
+        k.ipsr = saved_ipsr;
+        return true;
+    }
+    return false;
+}
+
+void fire_due(Kernel& k, Lock& lock)
+{
+    while (fire_one(k, lock))
+    {
+    }
+}
+
+[[noreturn]] void deadlock(const Kernel& k)
+{
+    std::fprintf(stderr, "rtos_sim: all threads are blocked and no event is pending\n");
+    for (const Thread* thread : k.threads)
+        std::fprintf(stderr, "  %s: state %d\n", thread->name.c_str(), static_cast<int>(thread->state));
+    std::abort();
+}
+
+/**
+ * 当前线程（状态已设为就绪、阻塞或终止）让出 CPU，直到再次被调度
+ *
+ * 没有就绪线程时由本线程充当空闲的 CPU：推进时钟并处理到期事件，直到有线程就绪
+ */
+void reschedule(Kernel& k, Lock& lock, Thread* self)
+{
+    for (;;)
+    {
+        if (Thread* next = pick_ready(k); next != nullptr)
+        {
+            next->state = osThreadRunning;
+            k.running   = next;
+            if (next == self)
+                return;
+            next->cv.notify_one();
+            if (self->state == osThreadTerminated)
+                return;
+            self->cv.wait(lock, [&] { return k.running == self; });
+            return;
+        }
+
+        const uint64_t next_time = next_event_time(k);
+        if (next_time == NEVER)
+            deadlock(k);
+        k.now_us = std::max(k.now_us, next_time);
+        fire_due(k, lock);
+    }
+}
+
+/// 线程上下文中，有更高优先级的线程就绪时立即切换过去
+void preempt(Kernel& k, Lock& lock)
+{
+    if (!thread_context(k) || k.primask != 0)
+        return;
+    const Thread* best = pick_ready(k);
+    if (best == nullptr || best->priority <= self_->priority)
+        return;
+    make_ready(k, self_);
+    reschedule(k, lock, self_);
+}
+
+void consume(Kernel& k, Lock& lock, const uint64_t us)
+{
+    const uint64_t target = k.now_us + us;
+    // 中断上下文和定时器回调中不处理嵌套事件，只推进时间
+    if (!thread_context(k))
+    {
+        k.now_us = target;
+        return;
+    }
+
+    for (;;)
+    {
+        // 中断唤醒了更高优先级的线程时先让它运行，回来后继续忙等到 target
+        if (k.primask == 0)
+        {
+            fire_due(k, lock);
+            preempt(k, lock);
+        }
+        if (k.now_us >= target)
+            return;
+        const uint64_t next = next_event_time(k);
+        if (k.primask != 0 || next > target)
+            break;
+        k.now_us = std::max(k.now_us, next);
+    }
+    k.now_us = target;
+}
+
+void read_clock()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (thread_context(k))
+        consume(k, lock, ClockReadCostUs);
+}
+
+Thread* find_thread(const Kernel& k, const osThreadId_t id)
+{
+    for (Thread* thread : k.threads)
+        if (thread == id)
+            return thread;
+    return nullptr;
+}
+
+void terminate_self(Kernel& k, Lock& lock)
+{
+    self_->state = osThreadTerminated;
+    reschedule(k, lock, self_);
+}
+
+} // namespace
+
+uint64_t now_us()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    return k.now_us;
+}
+
+EventId schedule_isr(const uint64_t at_us, std::function<void()> isr)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    const EventId id = ++k.next_event_id;
+    k.events.push_back({ at_us, id, std::move(isr) });
+    return id;
+}
+
+bool cancel_isr(const EventId id)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    for (auto it = k.events.begin(); it != k.events.end(); ++it)
+    {
+        if (it->id == id)
+        {
+            k.events.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void consume_us(const uint64_t us)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    consume(k, lock, us);
+}
+
+bool in_isr()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    return k.ipsr != 0;
+}
+
+uint32_t wakeups(const osThreadId_t thread)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    const Thread* t = find_thread(k, thread);
+    return t != nullptr ? t->wakeups : 0;
+}
+
+} // namespace rtos_sim
+
+using namespace rtos_sim;
+
+/*
+ * CMSIS 内核指令
+ */
+
+extern "C" uint32_t sim_get_primask()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    return k.primask;
+}
+
+extern "C" void sim_set_primask(const uint32_t primask)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    const bool unmasked = k.primask != 0 && (primask & 1U) == 0;
+    k.primask           = primask & 1U;
+    // 临界区退出：挂起的中断立即响应
+    if (unmasked && thread_context(k))
+    {
+        fire_due(k, lock);
+        preempt(k, lock);
+    }
+}
+
+extern "C" uint32_t sim_get_ipsr()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    return k.ipsr;
+}
+
+/*
+ * 时钟
+ */
+
+uint32_t       SystemCoreClock = 168000000U;
+DWT_Type       sim_dwt{};
+CoreDebug_Type sim_core_debug{};
+
+SimCycleCounter::operator uint32_t() const
+{
+    read_clock();
+    const unsigned __int128 cycles = static_cast<unsigned __int128>(rtos_sim::now_us()) * SystemCoreClock / 1000000U;
+    return static_cast<uint32_t>(cycles);
+}
+
+uint32_t HAL_GetTick()
+{
+    read_clock();
+    return static_cast<uint32_t>(rtos_sim::now_us() / TickUs);
+}
+
+void HAL_Delay(const uint32_t delay_ms)
+{
+    consume_us(static_cast<uint64_t>(delay_ms) * TickUs);
+}
+
+void sim_error_handler(const char* file, const int line)
+{
+    std::fprintf(stderr, "Error_Handler called at %s:%d\n", file, line);
+    std::abort();
+}
+
+/*
+ * CMSIS-RTOS v2
+ */
+
+extern "C"
+{
+
+osStatus_t osKernelInitialize()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.state != osKernelInactive)
+        return osError;
+    k.state = osKernelReady;
+    return osOK;
+}
+
+osStatus_t osKernelStart()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.state != osKernelReady)
+        return osError;
+
+    // 把调用线程登记为 main 线程，之后与其他线程一样参与调度
+    auto* main_thread  = new Thread;
+    main_thread->name  = "main";
+    main_thread->state = osThreadRunning;
+    k.threads.push_back(main_thread);
+    self_     = main_thread;
+    k.running = main_thread;
+    k.state   = osKernelRunning;
+    preempt(k, lock);
+    return osOK;
+}
+
+osKernelState_t osKernelGetState()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    return k.state;
+}
+
+uint32_t osKernelGetTickCount()
+{
+    read_clock();
+    return static_cast<uint32_t>(rtos_sim::now_us() / TickUs);
+}
+
+uint32_t osKernelGetTickFreq()
+{
+    return 1000U;
+}
+
+osThreadId_t osThreadNew(const osThreadFunc_t func, void* const argument, const osThreadAttr_t* const attr)
+{
+    if (func == nullptr)
+        return nullptr;
+
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return nullptr;
+
+    auto* thread     = new Thread;
+    thread->name     = attr != nullptr && attr->name != nullptr ? attr->name : "thread";
+    thread->priority = attr != nullptr && attr->priority != osPriorityNone ? attr->priority : osPriorityNormal;
+    thread->func     = func;
+    thread->argument = argument;
+    make_ready(k, thread);
+    k.threads.push_back(thread);
+
+    std::thread([thread] {
+        Kernel& kern = kernel();
+        {
+            Lock wait_lock(kern.mutex);
+            thread->cv.wait(wait_lock, [&] { return kern.running == thread; });
+        }
+        self_ = thread;
+        thread->func(thread->argument);
+        osThreadExit();
+    }).detach();
+
+    preempt(k, lock);
+    return thread;
+}
+
+osThreadId_t osThreadGetId()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    return k.running;
+}
+
+const char* osThreadGetName(const osThreadId_t thread_id)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    const Thread* thread = find_thread(k, thread_id);
+    return thread != nullptr ? thread->name.c_str() : nullptr;
+}
+
+osThreadState_t osThreadGetState(const osThreadId_t thread_id)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    const Thread* thread = find_thread(k, thread_id);
+    return thread != nullptr ? thread->state : osThreadError;
+}
+
+osPriority_t osThreadGetPriority(const osThreadId_t thread_id)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    const Thread* thread = find_thread(k, thread_id);
+    return thread != nullptr ? thread->priority : osPriorityError;
+}
+
+osStatus_t osThreadYield()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (!thread_context(k))
+        return osErrorISR;
+    make_ready(k, self_);
+    reschedule(k, lock, self_);
+    return osOK;
+}
+
+void osThreadExit()
+{
+    Kernel& k = kernel();
+    {
+        Lock lock(k.mutex);
+        terminate_self(k, lock);
+    }
+    pthread_exit(nullptr);
+}
+
+uint32_t osThreadFlagsSet(const osThreadId_t thread_id, const uint32_t flags)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    Thread* thread = find_thread(k, thread_id);
+    if (thread == nullptr || thread->state == osThreadTerminated || (flags & osFlagsError) != 0)
+        return osFlagsErrorParameter;
+
+    thread->flags |= flags;
+    const uint32_t result = thread->flags;
+    uint32_t       wait_result;
+    if (thread->state == osThreadBlocked && thread->wait == Wait::Flags &&
+        flags_satisfied(thread, thread->wait_flags, thread->wait_options, &wait_result))
+    {
+        thread->wait_result = wait_result;
+        make_ready(k, thread);
+    }
+    preempt(k, lock);
+    return result;
+}
+
+uint32_t osThreadFlagsClear(const uint32_t flags)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return osFlagsErrorISR;
+    if (self_ == nullptr)
+        return osFlagsErrorUnknown;
+    const uint32_t result = self_->flags;
+    self_->flags &= ~flags;
+    return result;
+}
+
+uint32_t osThreadFlagsGet()
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    return k.ipsr == 0 && self_ != nullptr ? self_->flags : 0U;
+}
+
+uint32_t osThreadFlagsWait(const uint32_t flags, const uint32_t options, const uint32_t timeout)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return osFlagsErrorISR;
+    if (!thread_context(k))
+        return osFlagsErrorUnknown;
+    if ((flags & osFlagsError) != 0)
+        return osFlagsErrorParameter;
+
+    uint32_t result;
+    if (flags_satisfied(self_, flags, options, &result))
+        return result;
+    if (timeout == 0U)
+        return osFlagsErrorResource;
+
+    self_->state        = osThreadBlocked;
+    self_->wait         = Wait::Flags;
+    self_->wait_flags   = flags;
+    self_->wait_options = options;
+    self_->wake_at      = timeout == osWaitForever ? NEVER : tick_deadline(k, timeout);
+    reschedule(k, lock, self_);
+    return self_->wait_result;
+}
+
+osStatus_t osDelay(const uint32_t ticks)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return osErrorISR;
+    if (!thread_context(k))
+        return osError;
+    if (ticks == 0U)
+        return osOK;
+
+    self_->state   = osThreadBlocked;
+    self_->wait    = Wait::Delay;
+    self_->wake_at = tick_deadline(k, ticks);
+    reschedule(k, lock, self_);
+    return osOK;
+}
+
+osStatus_t osDelayUntil(const uint32_t ticks)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return osErrorISR;
+    if (!thread_context(k))
+        return osError;
+    const uint32_t delta = ticks - static_cast<uint32_t>(k.now_us / TickUs);
+    if (delta == 0U || delta > 0x7FFFFFFFU)
+        return osErrorParameter;
+
+    self_->state   = osThreadBlocked;
+    self_->wait    = Wait::Delay;
+    self_->wake_at = tick_deadline(k, delta);
+    reschedule(k, lock, self_);
+    return osOK;
+}
+
+osTimerId_t osTimerNew(const osTimerFunc_t func, const osTimerType_t type, void* const argument, const osTimerAttr_t*)
+{
+    if (func == nullptr)
+        return nullptr;
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return nullptr;
+    auto* timer     = new Timer;
+    timer->func     = func;
+    timer->argument = argument;
+    timer->type     = type;
+    k.timers.push_back(timer);
+    return timer;
+}
+
+osStatus_t osTimerStart(const osTimerId_t timer_id, const uint32_t ticks)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return osErrorISR;
+    auto* timer = static_cast<Timer*>(timer_id);
+    if (timer == nullptr || ticks == 0U)
+        return osErrorParameter;
+    timer->ticks     = ticks;
+    timer->expire_at = tick_deadline(k, ticks);
+    return osOK;
+}
+
+osStatus_t osTimerStop(const osTimerId_t timer_id)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return osErrorISR;
+    auto* timer = static_cast<Timer*>(timer_id);
+    if (timer == nullptr)
+        return osErrorParameter;
+    if (timer->expire_at == NEVER)
+        return osErrorResource;
+    timer->expire_at = NEVER;
+    return osOK;
+}
+
+uint32_t osTimerIsRunning(const osTimerId_t timer_id)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    const auto* timer = static_cast<const Timer*>(timer_id);
+    return timer != nullptr && timer->expire_at != NEVER ? 1U : 0U;
+}
+
+osStatus_t osTimerDelete(const osTimerId_t timer_id)
+{
+    Kernel& k = kernel();
+    Lock    lock(k.mutex);
+    if (k.ipsr != 0)
+        return osErrorISR;
+    for (auto it = k.timers.begin(); it != k.timers.end(); ++it)
+    {
+        if (*it == timer_id)
+        {
+            delete *it;
+            k.timers.erase(it);
+            return osOK;
+        }
+    }
+    return osErrorParameter;
+}
+
+} // extern "C"
@@ -0,0 +1,69 @@
+/**
+ * @file    rtos_sim.hpp
+ * @brief   主机仿真的 CMSIS-RTOS v2 内核：pthread 线程、仿真时钟与“中断”。
+ *
+ * 仿真的是一颗单核 MCU：
+ *
+ * - 每个 osThreadNew 创建的线程是一个 pthread（std::thread），但任一时刻只有一个在运行，
+ *   调度按优先级抢占、同优先级按就绪先后轮转。切换只发生在 CMSIS 调用、中断返回和读时钟处，
+ *   不会在任意一条语句之间发生。
+ * - 时间是虚拟的：所有线程都阻塞时，时钟直接跳到下一个事件（中断、等待超时、定时器到期）；
+ *   线程运行时只有 HAL_Delay、consume_us 和读时钟（ClockReadCostUs）会让时间前进。
+ *   所以测试的结果与主机负载无关，超时类测试也不需要真的等待。
+ * - 外设模型用 schedule_isr 在某个时刻安排一次“中断”。中断在当前 CPU 上下文中执行，
+ *   期间 __get_IPSR() 非 0；PRIMASK 置位时到期的中断挂起，恢复为 0 时立即响应。
+ * - tick 频率为 1 kHz；k 个 tick 的等待在第 k 个 tick 边界到期，即 (k - 1, k] ms 之后，与 FreeRTOS 相同。
+ * - 软件定时器的回调在推进时钟的上下文中直接调用，相当于一个优先级最高的定时器线程。
+ * - osKernelStart() 把调用线程（通常是测试的 main）登记为一个优先级为 osPriorityNormal 的线程后返回，
+ *   而不是像真实内核那样永不返回。
+ *
+ * 所有线程都阻塞且没有任何待发生的事件时，仿真打印死锁信息并终止进程。
+ */
+#pragma once
+
+#include "cmsis_os2.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace rtos_sim
+{
+
+constexpr uint64_t NEVER = UINT64_MAX;
+
+/// 线程每读一次时钟（HAL_GetTick、DWT->CYCCNT、osKernelGetTickCount）消耗的 CPU 时间，单位微秒
+constexpr uint64_t ClockReadCostUs = 1;
+
+using EventId = uint64_t;
+
+/// 当前仿真时间，单位微秒，不消耗 CPU 时间
+uint64_t now_us();
+
+/**
+ * 在 at_us 时刻触发一次中断
+ * @param at_us 触发时刻，不晚于当前时间时在下一个调度点触发
+ * @param isr 中断服务函数，在中断上下文中调用
+ * @return 事件编号，可用于 cancel_isr
+ */
+EventId schedule_isr(uint64_t at_us, std::function<void()> isr);
+
+/**
+ * 取消一次尚未触发的中断
+ * @return 事件是否仍未触发并已取消
+ */
+bool cancel_isr(EventId id);
+
+/**
+ * 当前线程占用 CPU 一段时间（忙等），期间到期的中断照常响应
+ */
+void consume_us(uint64_t us);
+
+/// 当前是否在中断上下文中
+bool in_isr();
+
+/**
+ * 线程从阻塞变为就绪的次数（被线程标志唤醒、等待超时或 osDelay 到期都算一次）
+ */
+uint32_t wakeups(osThreadId_t thread);
+
+} // namespace rtos_sim
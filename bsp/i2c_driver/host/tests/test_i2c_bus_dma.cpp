@@ -0,0 +1,388 @@
+/**
+ * @file    test_i2c_bus_dma.cpp
+ * @brief   I2CBusDMA 在仿真 HAL 与仿真 RTOS 上的测试：同步接口、异步队列、脚本、超时与 recover()。
+ */
+#include "I2CBusDMA.hpp"
+#include "host_test.hpp"
+#include "i2c_sim.hpp"
+
+#include <vector>
+
+namespace
+{
+
+constexpr uint8_t  ImuAddress  = 0x68;
+constexpr uint8_t  BaroAddress = 0x77;
+constexpr uint32_t TimeoutMs   = 5;
+
+i2c_sim::Bus*   sim;
+I2CBusDMA*      bus;
+i2c_sim::Slave* imu;
+i2c_sim::Slave* baro;
+
+struct Completion
+{
+    int              tag;
+    I2CBusDMA::Error error;
+    uint16_t         step;
+};
+std::vector<Completion> completions;
+
+void record(const I2CBusDMA::Transaction& transaction, const I2CBusDMA::Error error, void* ctx)
+{
+    completions.push_back({ static_cast<int>(reinterpret_cast<intptr_t>(ctx)), error, transaction.step });
+}
+
+I2CBusDMA::Transaction mem_read(const uint8_t address, const uint8_t reg, uint8_t* data, const uint16_t len, const int tag)
+{
+    I2CBusDMA::Transaction transaction{};
+    transaction.op               = I2CBusDMA::Op::MemRead;
+    transaction.device_addr_7bit = address;
+    transaction.reg              = reg;
+    transaction.data             = data;
+    transaction.len              = len;
+    transaction.callback         = record;
+    transaction.ctx              = reinterpret_cast<void*>(static_cast<intptr_t>(tag));
+    return transaction;
+}
+
+/// 等待总线上的事务全部结束
+void drain()
+{
+    for (int i = 0; i < 1000 && bus->isBusy(); ++i)
+        (void) osDelay(1);
+    CHECK(!bus->isBusy());
+}
+
+void test_requires_kernel()
+{
+    uint8_t data = 0;
+    CHECK(!bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+    CHECK(bus->lastError() == I2CBusDMA::Error::InvalidContext);
+    CHECK_EQ(sim->transfers(), 0U);
+}
+
+void test_mem_write_read()
+{
+    const uint8_t out[3] = { 0x11, 0x22, 0x33 };
+    CHECK(bus->memWrite(ImuAddress, 0x10, out, 3, TimeoutMs));
+    CHECK_EQ(imu->reg(0x10), 0x11);
+    CHECK_EQ(imu->reg(0x12), 0x33);
+
+    uint8_t        in[3] = {};
+    const uint64_t start = rtos_sim::now_us();
+    CHECK(bus->memRead(ImuAddress, 0x10, in, 3, TimeoutMs));
+    const uint64_t elapsed = rtos_sim::now_us() - start;
+    CHECK_EQ(in[0], 0x11);
+    CHECK_EQ(in[2], 0x33);
+    // 线程直到完成中断才被唤醒，耗时就是总线时间加上少量读时钟的开销
+    const uint64_t expected = sim->transfer_us(true, true, 3);
+    CHECK(elapsed >= expected);
+    CHECK(elapsed < expected + 20);
+    CHECK(bus->lastError() == I2CBusDMA::Error::None);
+}
+
+void test_busy_time_matches_wire_time()
+{
+    // 驱动记录的占用时间与仿真总线上实际传输的时间一致，不含线程唤醒与两次事务之间的空闲
+    const uint32_t driver_start = bus->busyTimeUs();
+    const uint64_t wire_start   = sim->busy_us();
+    uint8_t        data[6]      = {};
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK(bus->memRead(ImuAddress, 0x3B, data, 6, TimeoutMs));
+        (void) osDelay(1);
+    }
+    const uint64_t wire   = sim->busy_us() - wire_start;
+    const uint64_t driver = bus->busyTimeUs() - driver_start;
+    CHECK_EQ(wire, 5 * sim->transfer_us(true, true, 6));
+    CHECK(driver + 5 >= wire && driver <= wire + 5);
+}
+
+void test_raw_write_read()
+{
+    const uint8_t out[2] = { 0x20, 0xAB };
+    CHECK(bus->write(ImuAddress, out, 2, TimeoutMs));
+    CHECK_EQ(imu->reg(0x20), 0xAB);
+
+    // 先写寄存器指针，再原始读
+    CHECK(bus->write(ImuAddress, out, 1, TimeoutMs));
+    uint8_t in = 0;
+    CHECK(bus->read(ImuAddress, &in, 1, TimeoutMs));
+    CHECK_EQ(in, 0xAB);
+}
+
+void test_async_queue_order()
+{
+    completions.clear();
+    uint8_t data[4][2] = {};
+    for (int i = 0; i < 4; ++i)
+        CHECK(bus->submit(mem_read(ImuAddress, static_cast<uint8_t>(i * 2), data[i], 2, i)));
+    // 一笔在飞，三笔排队；完成中断直接接力启动，不经过线程
+    CHECK_EQ(bus->pendingCount(), 4U);
+    drain();
+    CHECK_EQ(completions.size(), 4U);
+    for (size_t i = 0; i < completions.size(); ++i)
+    {
+        CHECK_EQ(completions[i].tag, static_cast<int>(i));
+        CHECK(completions[i].error == I2CBusDMA::Error::None);
+    }
+}
+
+void test_queue_full()
+{
+    completions.clear();
+    uint8_t data = 0;
+    for (size_t i = 0; i < I2CBusDMA::QueueSize + 1; ++i)
+        CHECK(bus->submit(mem_read(ImuAddress, 0, &data, 1, static_cast<int>(i))));
+    CHECK(!bus->submit(mem_read(ImuAddress, 0, &data, 1, -1)));
+    CHECK(bus->lastError() == I2CBusDMA::Error::Busy);
+    drain();
+    CHECK_EQ(completions.size(), I2CBusDMA::QueueSize + 1);
+}
+
+void test_nack_recovers()
+{
+    const uint32_t resets = sim->resets();
+    imu->nack_next();
+    uint8_t data = 0;
+    CHECK(!bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+    CHECK(bus->lastError() == I2CBusDMA::Error::HalError);
+    CHECK_EQ(bus->lastHalError(), HAL_I2C_ERROR_AF);
+    CHECK_EQ(sim->resets(), resets + 1);
+    CHECK(bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+}
+
+void test_missing_device()
+{
+    uint8_t data = 0;
+    CHECK(!bus->memRead(0x42, 0x00, &data, 1, TimeoutMs));
+    CHECK_EQ(bus->lastHalError(), HAL_I2C_ERROR_AF);
+    CHECK(bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+}
+
+void test_timeout_recovers()
+{
+    const uint32_t resets = sim->resets();
+    imu->hang_next();
+    uint8_t        data  = 0;
+    const uint32_t start = HAL_GetTick();
+    CHECK(!bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+    const uint32_t elapsed = HAL_GetTick() - start;
+    CHECK(bus->lastError() == I2CBusDMA::Error::Timeout);
+    CHECK(elapsed >= TimeoutMs - 1 && elapsed <= TimeoutMs + 1);
+    CHECK_EQ(sim->resets(), resets + 1);
+    CHECK(!bus->isBusy());
+    CHECK(bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+}
+
+void test_queued_timeout_does_not_recover()
+{
+    // 前一笔事务占用总线 8 ms：排在后面的同步读超时只移出队列，不复位总线、不打断前一笔
+    completions.clear();
+    const uint32_t resets = sim->resets();
+    uint8_t        slow   = 0;
+    imu->set_latency_us(8000);
+    CHECK(bus->submit(mem_read(ImuAddress, 0x00, &slow, 1, 0)));
+    imu->set_latency_us(0);
+
+    uint8_t data = 0;
+    CHECK(!bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+    CHECK(bus->lastError() == I2CBusDMA::Error::Timeout);
+    CHECK_EQ(sim->resets(), resets);
+    CHECK_EQ(bus->pendingCount(), 1U);
+
+    drain();
+    CHECK_EQ(completions.size(), 1U);
+    CHECK(completions[0].error == I2CBusDMA::Error::None);
+    CHECK(bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+}
+
+void test_start_failure_recovers()
+{
+    sim->fail_next_starts();
+    uint8_t data = 0;
+    CHECK(!bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+    CHECK(bus->lastError() == I2CBusDMA::Error::StartFailed);
+    CHECK(bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+}
+
+void test_stuck_sda_released_by_recovery()
+{
+    // 从机在 3 个 SCL 脉冲后释放 SDA：启动失败，recover() 的脉冲把总线救回来
+    const uint32_t pulses = sim->scl_pulses();
+    imu->hold_sda(3);
+    uint8_t data = 0;
+    CHECK(!bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+    CHECK(bus->lastError() == I2CBusDMA::Error::StartFailed);
+    CHECK(!imu->holding_sda());
+    CHECK(sim->scl_pulses() - pulses >= 3U);
+    CHECK(bus->memRead(ImuAddress, 0x00, &data, 1, TimeoutMs));
+}
+
+void test_stuck_sda_fails_queued()
+{
+    completions.clear();
+    uint8_t data[3] = {};
+    imu->hang_next();
+    CHECK(bus->submit(mem_read(ImuAddress, 0, &data[0], 1, 0)));
+    CHECK(bus->submit(mem_read(ImuAddress, 0, &data[1], 1, 1)));
+    CHECK(bus->submit(mem_read(BaroAddress, 0, &data[2], 1, 2)));
+    (void) osDelay(2);
+    CHECK_EQ(completions.size(), 0U);
+
+    // SDA 一直不释放：进行中的事务被取消，排队的全部以 RecoveryFailed 结束
+    imu->hold_sda();
+    CHECK(!bus->recover());
+    CHECK(bus->lastError() == I2CBusDMA::Error::RecoveryFailed);
+    CHECK_EQ(completions.size(), 3U);
+    if (completions.size() == 3U)
+    {
+        CHECK(completions[0].error == I2CBusDMA::Error::Aborted);
+        CHECK(completions[1].error == I2CBusDMA::Error::RecoveryFailed);
+        CHECK(completions[2].error == I2CBusDMA::Error::RecoveryFailed);
+    }
+
+    imu->hold_sda(0);
+    CHECK(bus->recover());
+    CHECK(bus->memRead(ImuAddress, 0x00, &data[0], 1, TimeoutMs));
+}
+
+void test_script()
+{
+    uint8_t               power     = 0x01;
+    uint8_t               accel[6]  = {};
+    uint8_t               temp[2]   = {};
+    const uint8_t         regs[6]   = { 1, 2, 3, 4, 5, 6 };
+    imu->set_registers(0x3B, regs, 6);
+    const I2CBusDMA::Step steps[] = {
+        { I2CBusDMA::Op::MemWrite, ImuAddress, 0x6B, &power, 1 },
+        { I2CBusDMA::Op::MemRead, ImuAddress, 0x3B, accel, 6 },
+        { I2CBusDMA::Op::MemRead, BaroAddress, 0xFA, temp, 2 },
+    };
+    CHECK(bus->runScript(steps, 3, TimeoutMs));
+    CHECK_EQ(imu->reg(0x6B), 0x01);
+    CHECK_EQ(accel[5], 6);
+    CHECK_EQ(bus->lastScriptStep(), 2U);
+
+    baro->nack_next();
+    CHECK(!bus->runScript(steps, 3, TimeoutMs));
+    CHECK(bus->lastError() == I2CBusDMA::Error::HalError);
+    CHECK_EQ(bus->lastScriptStep(), 2U);
+}
+
+void test_script_step_survives_later_transfers()
+{
+    uint8_t               data[3] = {};
+    const I2CBusDMA::Step failing[] = {
+        { I2CBusDMA::Op::MemRead, ImuAddress, 0x00, &data[0], 1 },
+        { I2CBusDMA::Op::MemRead, BaroAddress, 0x00, &data[1], 1 },
+        { I2CBusDMA::Op::MemRead, ImuAddress, 0x01, &data[2], 1 },
+    };
+    baro->nack_next();
+    CHECK(!bus->runScript(failing, 3, TimeoutMs));
+
+    // 之后总线上跑的异步脚本不会改写同步调用取回的结束步骤；异步脚本的结束步骤由回调副本带回
+    completions.clear();
+    I2CBusDMA::Transaction script{};
+    script.op       = I2CBusDMA::Op::Script;
+    script.steps    = failing;
+    script.len      = 3;
+    script.callback = record;
+    CHECK(bus->submit(script));
+    drain();
+    CHECK_EQ(completions.size(), 1U);
+    CHECK(completions[0].error == I2CBusDMA::Error::None);
+    CHECK_EQ(completions[0].step, 2U);
+    CHECK_EQ(bus->lastScriptStep(), 1U);
+}
+
+void test_script_wakes_caller_once()
+{
+    // 三步脚本只唤醒调用线程一次，逐笔同步读则每笔一次
+    const osThreadId_t    self   = osThreadGetId();
+    uint8_t               buf[6] = {};
+    const I2CBusDMA::Step steps[] = {
+        { I2CBusDMA::Op::MemRead, ImuAddress, 0x00, &buf[0], 2 },
+        { I2CBusDMA::Op::MemRead, ImuAddress, 0x02, &buf[2], 2 },
+        { I2CBusDMA::Op::MemRead, BaroAddress, 0x04, &buf[4], 2 },
+    };
+    uint32_t before = rtos_sim::wakeups(self);
+    CHECK(bus->runScript(steps, 3, TimeoutMs));
+    CHECK_EQ(rtos_sim::wakeups(self) - before, 1U);
+
+    before = rtos_sim::wakeups(self);
+    for (const auto& step : steps)
+        CHECK(bus->memRead(step.device_addr_7bit, step.reg, step.data, step.len, TimeoutMs));
+    CHECK_EQ(rtos_sim::wakeups(self) - before, 3U);
+}
+
+osThreadId_t main_thread;
+int          worker_failures;
+
+void worker_entry(void* argument)
+{
+    const auto reg = static_cast<uint8_t>(reinterpret_cast<intptr_t>(argument));
+    for (int i = 0; i < 10; ++i)
+    {
+        uint8_t data = 0;
+        if (!bus->memRead(ImuAddress, reg, &data, 1, TimeoutMs) || data != imu->reg(reg))
+            ++worker_failures;
+    }
+    (void) osThreadFlagsSet(main_thread, 1U << reg);
+}
+
+void test_concurrent_threads()
+{
+    main_thread     = osThreadGetId();
+    worker_failures = 0;
+    imu->reg(1)     = 0x5A;
+    imu->reg(2)     = 0xA5;
+    const uint32_t reads = imu->reads();
+    (void) osThreadNew(worker_entry, reinterpret_cast<void*>(1), nullptr);
+    (void) osThreadNew(worker_entry, reinterpret_cast<void*>(2), nullptr);
+    CHECK_EQ(osThreadFlagsWait(0x6U, osFlagsWaitAll, 100), 0x6U);
+    CHECK_EQ(worker_failures, 0);
+    CHECK_EQ(imu->reads() - reads, 20U);
+}
+
+} // namespace
+
+int main()
+{
+    static i2c_sim::Bus   sim_bus(&hi2c1, GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7);
+    static i2c_sim::Slave imu_slave(ImuAddress);
+    static i2c_sim::Slave baro_slave(BaroAddress);
+    sim_bus.attach(imu_slave);
+    sim_bus.attach(baro_slave);
+    static I2CBusDMA dma_bus(&hi2c1, { GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7, GPIO_AF4_I2C1 });
+    static DMA_HandleTypeDef dma_rx{}, dma_tx{};
+    hi2c1.hdmarx = &dma_rx;
+    hi2c1.hdmatx = &dma_tx;
+    sim  = &sim_bus;
+    bus  = &dma_bus;
+    imu  = &imu_slave;
+    baro = &baro_slave;
+
+    RUN_TEST(test_requires_kernel);
+
+    (void) osKernelInitialize();
+    (void) osKernelStart();
+    RUN_TEST(test_mem_write_read);
+    RUN_TEST(test_busy_time_matches_wire_time);
+    RUN_TEST(test_raw_write_read);
+    RUN_TEST(test_async_queue_order);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_nack_recovers);
+    RUN_TEST(test_missing_device);
+    RUN_TEST(test_timeout_recovers);
+    RUN_TEST(test_queued_timeout_does_not_recover);
+    RUN_TEST(test_start_failure_recovers);
+    RUN_TEST(test_stuck_sda_released_by_recovery);
+    RUN_TEST(test_stuck_sda_fails_queued);
+    RUN_TEST(test_script);
+    RUN_TEST(test_script_step_survives_later_transfers);
+    RUN_TEST(test_script_wakes_caller_once);
+    RUN_TEST(test_concurrent_threads);
+    return host_test::result();
+}
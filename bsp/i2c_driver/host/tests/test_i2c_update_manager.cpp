@@ -0,0 +1,414 @@
+/**
+ * @file    test_i2c_update_manager.cpp
+ * @brief   I2CUpdateManager 在仿真 I2C 总线与仿真 RTOS 上的测试：EDF 顺序、转换等待后的重新释放、跳过周期、
+ *          释放抖动与响应时间统计、准入控制与实测总线利用率。
+ */
+#include "I2CBusDMA.hpp"
+#include "I2CUpdateManager.hpp"
+#include "host_test.hpp"
+#include "i2c_sim.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+constexpr uint8_t  ImuAddress  = 0x68;
+constexpr uint8_t  BaroAddress = 0x77;
+constexpr uint8_t  DataReg     = 0x20;
+constexpr uint8_t  TriggerReg  = 0x10;
+constexpr uint16_t ReadLen     = 6;
+// 准入测试用的一组设备，地址依次为 BankAddress + i
+constexpr uint8_t  BankAddress = 0x40;
+constexpr size_t   BankSize    = I2CUpdateManager::MaxDevices;
+
+i2c_sim::Bus* sim;
+I2CBusDMA*    bus;
+
+class SimDevice;
+
+// 各设备访问总线的时刻，按发生顺序记录
+struct Access
+{
+    const SimDevice* device;
+    bool             trigger;
+    uint64_t         at_us;
+};
+std::vector<Access> accesses;
+
+/**
+ * 读 ReadLen 字节的设备；conversion_ms 非 0 时先写一个字节触发转换
+ */
+class SimDevice final : public I2CDevice
+{
+public:
+    SimDevice(const char* name, const uint8_t address, const uint32_t conversion_ms = 0U)
+        : name_(name), address_(address), conversion_ms_(conversion_ms)
+    {
+    }
+
+    const char* name() const override { return name_; }
+    uint8_t     address7bit() const override { return address_; }
+
+    I2CBusCost busCost() const override
+    {
+        if (conversion_ms_ == 0U)
+            return { static_cast<uint16_t>(1U + ReadLen), 1U };
+        return { static_cast<uint16_t>(2U + 1U + ReadLen), 2U };
+    }
+
+    bool init(I2CBusDMA& bus, const uint32_t timeout_ms) override
+    {
+        uint8_t id = 0;
+        return bus.memRead(address_, 0x00, &id, 1, timeout_ms);
+    }
+
+    /// 下一次读取前额外占用 CPU 的时间，模拟一次异常缓慢的更新
+    uint32_t stall_next_read_us{ 0U };
+
+protected:
+    bool onTrigger(I2CBusDMA& bus, const uint32_t timeout_ms) override
+    {
+        if (conversion_ms_ == 0U)
+            return true;
+        accesses.push_back({ this, true, rtos_sim::now_us() });
+        const uint8_t command = 0x01;
+        return bus.memWrite(address_, TriggerReg, &command, 1, timeout_ms);
+    }
+
+    uint32_t conversionMs() const override { return conversion_ms_; }
+
+    bool onRead(I2CBusDMA& bus, const uint32_t /*now_ms*/, const uint32_t timeout_ms) override
+    {
+        accesses.push_back({ this, false, rtos_sim::now_us() });
+        if (stall_next_read_us != 0U)
+        {
+            rtos_sim::consume_us(stall_next_read_us);
+            stall_next_read_us = 0U;
+        }
+        uint8_t data[ReadLen];
+        return bus.memRead(address_, DataReg, data, ReadLen, timeout_ms);
+    }
+
+private:
+    const char* name_;
+    uint8_t     address_;
+    uint32_t    conversion_ms_;
+};
+
+/// 运行调度器 run_ms 后停止，并等调度线程退出
+void run_for(I2CUpdateManager& manager, const I2CUpdateManager::Config& config, const uint32_t run_ms)
+{
+    accesses.clear();
+    CHECK(manager.start(config));
+    (void) osDelay(run_ms);
+    manager.stop();
+    (void) osDelay(50);
+}
+
+/// BankSize 个不需要转换等待的设备，每轮读 ReadLen 字节
+std::vector<std::unique_ptr<SimDevice>> make_bank()
+{
+    static const char* const names[BankSize] = { "dev0", "dev1", "dev2", "dev3", "dev4", "dev5", "dev6", "dev7" };
+    std::vector<std::unique_ptr<SimDevice>> devices;
+    for (size_t i = 0; i < BankSize; ++i)
+        devices.push_back(std::make_unique<SimDevice>(names[i], static_cast<uint8_t>(BankAddress + i)));
+    return devices;
+}
+
+std::vector<uint64_t> reads_of(const SimDevice& device)
+{
+    std::vector<uint64_t> times;
+    for (const Access& access : accesses)
+        if (access.device == &device && !access.trigger)
+            times.push_back(access.at_us);
+    return times;
+}
+
+// 两个设备在同一时刻释放时，截止时间早（周期短）的先访问总线
+void test_edf_order()
+{
+    SimDevice        slow("slow", ImuAddress);
+    SimDevice        fast("fast", BaroAddress);
+    I2CUpdateManager manager(*bus);
+    // 先注册周期长的设备，顺序不能决定服务顺序
+    CHECK(manager.registerDevice(slow, 10U));
+    CHECK(manager.registerDevice(fast, 5U));
+
+    I2CUpdateManager::Config config;
+    config.tick_aligned = true;
+    run_for(manager, config, 100U);
+
+    const std::vector<uint64_t> slow_reads = reads_of(slow);
+    const std::vector<uint64_t> fast_reads = reads_of(fast);
+    // 第一个周期用于初始化，之后每个周期读一次
+    CHECK(slow_reads.size() >= 8U && slow_reads.size() <= 10U);
+    CHECK(fast_reads.size() >= 18U && fast_reads.size() <= 20U);
+
+    // 每 10 ms 两者同时释放：fast 的截止时间早 5 ms，总在 slow 之前
+    size_t together = 0;
+    for (size_t i = 1; i < accesses.size(); ++i)
+    {
+        if (accesses[i].device != &slow)
+            continue;
+        CHECK(accesses[i - 1].device == &fast);
+        CHECK(accesses[i].at_us - accesses[i - 1].at_us < 1000U);
+        ++together;
+    }
+    CHECK_EQ(together, slow_reads.size());
+
+    I2CUpdateManager::Stats stats{};
+    CHECK(manager.getStats(slow, stats));
+    CHECK_EQ(stats.deadline_misses, 0U);
+    CHECK_EQ(stats.skipped_cycles, 0U);
+}
+
+// 转换等待期间总线让给其他设备，转换完成后以原来的截止时间重新释放，不算一个新周期
+void test_conversion_rerelease()
+{
+    SimDevice        baro("baro", BaroAddress, 3U);
+    SimDevice        imu("imu", ImuAddress);
+    I2CUpdateManager manager(*bus);
+    CHECK(manager.registerDevice(baro, 10U));
+    CHECK(manager.registerDevice(imu, 10U, 1U));
+
+    I2CUpdateManager::Config config;
+    config.tick_aligned = true;
+    run_for(manager, config, 55U);
+
+    // 跳过初始化周期后，每轮依次是 baro 触发、imu 读取、baro 读取
+    CHECK(accesses.size() >= 12U);
+    size_t checked = 0;
+    for (size_t i = 0; i + 2 < accesses.size(); ++i)
+    {
+        if (accesses[i].device != &baro || !accesses[i].trigger)
+            continue;
+        const Access& imu_read  = accesses[i + 1];
+        const Access& baro_read = accesses[i + 2];
+        CHECK(imu_read.device == &imu && !imu_read.trigger);
+        CHECK(baro_read.device == &baro && !baro_read.trigger);
+        // tick 对齐：转换完成时刻向后取整到 tick 边界，读取恰好在 3 ms 之后
+        CHECK(baro_read.at_us - accesses[i].at_us >= 3000U);
+        CHECK(baro_read.at_us - accesses[i].at_us < 3000U + 1000U);
+        ++checked;
+    }
+    CHECK(checked >= 4U);
+
+    I2CUpdateManager::Stats stats{};
+    CHECK(manager.getStats(baro, stats));
+    // 每个周期只计一次释放；响应时间含 3 ms 转换等待
+    uint32_t triggers = 0;
+    for (const Access& access : accesses)
+        triggers += access.device == &baro && access.trigger ? 1U : 0U;
+    CHECK_EQ(stats.releases, triggers);
+    CHECK(stats.response_last_us >= 3000U);
+    CHECK(stats.response_max_us < 10000U);
+    CHECK_EQ(stats.deadline_misses, 0U);
+}
+
+// 一次更新拖过了后面的周期：跳到未来最近的周期点，保持相位，不补跑历史周期
+void test_skipped_cycles()
+{
+    SimDevice        imu("imu", ImuAddress);
+    I2CUpdateManager manager(*bus);
+    CHECK(manager.registerDevice(imu, 10U));
+
+    I2CUpdateManager::Config config;
+    config.tick_aligned = true;
+    CHECK(manager.start(config));
+    accesses.clear();
+    (void) osDelay(35U);
+    imu.stall_next_read_us = 25000U;
+    (void) osDelay(80U);
+    manager.stop();
+    (void) osDelay(50U);
+
+    I2CUpdateManager::Stats stats{};
+    CHECK(manager.getStats(imu, stats));
+    // 拖慢的一轮和紧接着补上的一轮都超过截止时间，之后跳过已经错过的那个周期
+    CHECK_EQ(stats.deadline_misses, 2U);
+    CHECK_EQ(stats.skipped_cycles, 1U);
+
+    // 恢复后仍按原来的相位每 10 ms 读一次
+    const std::vector<uint64_t> reads = reads_of(imu);
+    CHECK(reads.size() >= 5U);
+    for (size_t i = reads.size() - 3; i < reads.size(); ++i)
+    {
+        CHECK(reads[i] - reads[i - 1] >= 9990U);
+        CHECK(reads[i] - reads[i - 1] <= 10010U);
+    }
+    CHECK_EQ(reads.back() % 1000U, reads.front() % 1000U);
+}
+
+// 释放时刻落在两个 tick 之间时，只靠定时器唤醒的抖动接近一个 tick；tick 对齐后只剩线程唤醒的开销
+void test_release_jitter()
+{
+    const uint64_t wire_us = sim->transfer_us(true, true, ReadLen);
+
+    SimDevice        imu("imu", ImuAddress);
+    I2CUpdateManager unaligned(*bus);
+    // 注册时刻不在 tick 边界上，之后的释放时刻也都不在
+    rtos_sim::consume_us(400U);
+    CHECK(unaligned.registerDevice(imu, 10U));
+    run_for(unaligned, I2CUpdateManager::Config{}, 100U);
+
+    I2CUpdateManager::Stats stats{};
+    CHECK(unaligned.getStats(imu, stats));
+    std::printf("timer only:   jitter max=%u us, response max=%u us\n", stats.jitter_max_us, stats.response_max_us);
+    CHECK(stats.releases >= 8U);
+    CHECK(stats.jitter_max_us >= 100U);
+    CHECK(stats.jitter_max_us <= 1000U);
+
+    SimDevice        imu2("imu", ImuAddress);
+    I2CUpdateManager aligned(*bus);
+    rtos_sim::consume_us(400U);
+    CHECK(aligned.registerDevice(imu2, 10U));
+    I2CUpdateManager::Config config;
+    config.tick_aligned = true;
+    run_for(aligned, config, 100U);
+
+    CHECK(aligned.getStats(imu2, stats));
+    std::printf("tick aligned: jitter max=%u us, response max=%u us\n", stats.jitter_max_us, stats.response_max_us);
+    CHECK(stats.releases >= 8U);
+    // 仿真中唤醒没有延迟，抖动只有读时钟的开销
+    CHECK(stats.jitter_max_us <= 5U);
+    // 响应时间 = 抖动 + 总线时间 + 等待完成中断与读时钟的开销
+    CHECK(stats.response_last_us >= stats.jitter_last_us + wire_us);
+    CHECK(stats.response_last_us <= stats.jitter_last_us + wire_us + 20U);
+    CHECK_EQ(stats.deadline_misses, 0U);
+}
+
+// 400 kHz 下每轮 7 字节、1 笔事务，估算 C = ceil((7 * 9 + 21) / 0.4) + 20 = 230 us。
+// 周期 2 ms 时 n 个设备的响应时间上界为 n * C + C（阻塞），最多容纳 7 个
+constexpr uint32_t BankCostUs   = 230U;
+constexpr uint32_t BankPeriodMs = 2U;
+
+// 严格准入：第 8 个设备会让整组超过周期，注册被拒绝，且不留下任何半注册的条目
+void test_strict_admission()
+{
+    const std::vector<std::unique_ptr<SimDevice>> devices = make_bank();
+    I2CUpdateManager                              manager(*bus, 400000U);
+    manager.setStrictAdmission(true);
+    for (size_t i = 0; i + 1 < BankSize; ++i)
+        CHECK(manager.registerDevice(*devices[i], BankPeriodMs));
+    CHECK(manager.isSchedulable());
+
+    const float                planned = manager.plannedUtilization();
+    I2CUpdateManager::Analysis before{};
+    CHECK(manager.getAnalysis(*devices[0], before));
+    CHECK_EQ(before.response_bound_us, static_cast<uint32_t>(BankSize) * BankCostUs);
+
+    SimDevice& last = *devices[BankSize - 1];
+    CHECK(!manager.registerDevice(last, BankPeriodMs));
+    CHECK(manager.isSchedulable());
+    CHECK_EQ(manager.plannedUtilization(), planned);
+    I2CUpdateManager::Analysis analysis{};
+    I2CUpdateManager::Stats    stats{};
+    CHECK(!manager.getAnalysis(last, analysis));
+    CHECK(!manager.getStats(last, stats));
+    CHECK(manager.getAnalysis(*devices[0], analysis));
+    CHECK_EQ(analysis.response_bound_us, before.response_bound_us);
+
+    // 空出的位置可以再用：周期放宽到 10 ms 后同一设备可以注册
+    CHECK(manager.registerDevice(last, 10U));
+    CHECK(manager.isSchedulable());
+
+    I2CUpdateManager::Config config;
+    config.tick_aligned = true;
+    run_for(manager, config, 50U);
+
+    // 被拒绝的那次注册没有留下释放：每 10 ms 读一次，第一个周期用于初始化
+    const std::vector<uint64_t> reads = reads_of(last);
+    CHECK(reads.size() >= 3U && reads.size() <= 4U);
+    for (size_t i = 1; i < reads.size(); ++i)
+        CHECK(reads[i] - reads[i - 1] >= 9000U);
+    for (size_t i = 0; i + 1 < BankSize; ++i)
+    {
+        CHECK(manager.getStats(*devices[i], stats));
+        CHECK_EQ(stats.deadline_misses, 0U);
+    }
+}
+
+// 只报告：同样的 8 个设备全部注册成功，过载通过 isSchedulable() / getAnalysis() 报告
+void test_overload_reported()
+{
+    const std::vector<std::unique_ptr<SimDevice>> devices = make_bank();
+    I2CUpdateManager                              manager(*bus, 400000U);
+    for (size_t i = 0; i < BankSize; ++i)
+    {
+        CHECK(manager.registerDevice(*devices[i], BankPeriodMs));
+        CHECK_EQ(manager.isSchedulable(), i + 1 < BankSize);
+    }
+
+    const float expected = static_cast<float>(BankSize * BankCostUs) / static_cast<float>(BankPeriodMs * 1000U);
+    CHECK(std::fabs(manager.plannedUtilization() - expected) < 1e-4f);
+    for (size_t i = 0; i < BankSize; ++i)
+    {
+        I2CUpdateManager::Analysis analysis{};
+        CHECK(manager.getAnalysis(*devices[i], analysis));
+        CHECK_EQ(analysis.cost_us, BankCostUs);
+        CHECK_EQ(analysis.response_bound_us, static_cast<uint32_t>(BankSize + 1) * BankCostUs);
+        CHECK(!analysis.schedulable);
+    }
+}
+
+// 实测利用率只统计总线上有事务的时间，应与仿真总线的传输时间一致，并低于含驱动开销的估算值
+void test_measured_utilization()
+{
+    constexpr size_t                              Count   = 4;
+    const std::vector<std::unique_ptr<SimDevice>> devices = make_bank();
+    I2CUpdateManager                              manager(*bus, 400000U);
+    for (size_t i = 0; i < Count; ++i)
+        CHECK(manager.registerDevice(*devices[i], BankPeriodMs));
+
+    I2CUpdateManager::Config config;
+    config.tick_aligned          = true;
+    config.utilization_window_ms = 100U;
+    run_for(manager, config, 250U);
+
+    // 窗口内每个设备每个周期读一次
+    const float wire     = static_cast<float>(sim->transfer_us(true, true, ReadLen));
+    const float expected = static_cast<float>(Count) * wire / static_cast<float>(BankPeriodMs * 1000U);
+    const float measured = manager.busUtilization();
+    std::printf("utilization: measured=%.4f sim=%.4f planned=%.4f\n", static_cast<double>(measured),
+                static_cast<double>(expected), static_cast<double>(manager.plannedUtilization()));
+    CHECK(std::fabs(measured - expected) <= 0.02f * expected);
+    CHECK(measured < manager.plannedUtilization());
+}
+
+} // namespace
+
+int main()
+{
+    // 总线析构时会访问挂在上面的从机，从机要先构造、后析构
+    static i2c_sim::Slave                               imu_slave(ImuAddress);
+    static i2c_sim::Slave                               baro_slave(BaroAddress);
+    static std::vector<std::unique_ptr<i2c_sim::Slave>> bank_slaves;
+    for (size_t i = 0; i < BankSize; ++i)
+        bank_slaves.push_back(std::make_unique<i2c_sim::Slave>(static_cast<uint8_t>(BankAddress + i)));
+    static i2c_sim::Bus sim_bus(&hi2c1, GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7);
+    sim_bus.attach(imu_slave);
+    sim_bus.attach(baro_slave);
+    for (const std::unique_ptr<i2c_sim::Slave>& slave : bank_slaves)
+        sim_bus.attach(*slave);
+    static I2CBusDMA         dma_bus(&hi2c1, { GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7, GPIO_AF4_I2C1 });
+    static DMA_HandleTypeDef dma_rx{}, dma_tx{};
+    hi2c1.hdmarx = &dma_rx;
+    hi2c1.hdmatx = &dma_tx;
+    sim          = &sim_bus;
+    bus          = &dma_bus;
+
+    (void) osKernelInitialize();
+    (void) osKernelStart();
+    RUN_TEST(test_edf_order);
+    RUN_TEST(test_conversion_rerelease);
+    RUN_TEST(test_skipped_cycles);
+    RUN_TEST(test_release_jitter);
+    RUN_TEST(test_strict_admission);
+    RUN_TEST(test_overload_reported);
+    RUN_TEST(test_measured_utilization);
+    return host_test::result();
+}
@@ -0,0 +1,174 @@
+/**
+ * @file    test_rtos_sim.cpp
+ * @brief   仿真 RTOS 的调度、线程标志、tick 语义、中断与 PRIMASK 测试。
+ */
+#include "cmsis_compiler.h"
+#include "host_test.hpp"
+#include "main.h"
+#include "rtos_sim.hpp"
+
+#include <vector>
+
+namespace
+{
+
+std::vector<int> trace;
+
+void high_priority_entry(void*)
+{
+    trace.push_back(1);
+    (void) osThreadFlagsWait(1U, osFlagsWaitAny, osWaitForever);
+    trace.push_back(3);
+}
+
+void test_priority_preemption()
+{
+    trace.clear();
+    const osThreadAttr_t attr{ .name = "high", .priority = osPriorityHigh };
+    const osThreadId_t   high = osThreadNew(high_priority_entry, nullptr, &attr);
+    // 高优先级线程创建后立即运行，直到阻塞
+    trace.push_back(2);
+    (void) osThreadFlagsSet(high, 1U);
+    // 置标志后高优先级线程立即抢占
+    trace.push_back(4);
+    CHECK_EQ(trace.size(), 4U);
+    for (size_t i = 0; i < trace.size(); ++i)
+        CHECK_EQ(trace[i], static_cast<int>(i + 1));
+    CHECK_EQ(rtos_sim::wakeups(high), 1U);
+    CHECK(osThreadGetState(high) == osThreadTerminated);
+}
+
+void test_delay_tick_boundary()
+{
+    // k 个 tick 的延时在第 k 个 tick 边界结束
+    rtos_sim::consume_us(300);
+    const uint64_t start = rtos_sim::now_us();
+    CHECK(osDelay(3) == osOK);
+    CHECK_EQ(rtos_sim::now_us(), (start / 1000 + 3) * 1000);
+}
+
+void test_flags_wait_timeout()
+{
+    (void) osThreadFlagsClear(0xFFU);
+    const uint32_t start = osKernelGetTickCount();
+    CHECK_EQ(osThreadFlagsWait(1U, osFlagsWaitAny, 5), osFlagsErrorTimeout);
+    CHECK_EQ(osKernelGetTickCount() - start, 5U);
+    CHECK_EQ(osThreadFlagsWait(1U, osFlagsWaitAny, 0), osFlagsErrorResource);
+
+    // 已置位的标志立即返回，默认清除
+    const osThreadId_t self = osThreadGetId();
+    (void) osThreadFlagsSet(self, 3U);
+    CHECK_EQ(osThreadFlagsWait(3U, osFlagsWaitAll | osFlagsNoClear, 0), 3U);
+    CHECK_EQ(osThreadFlagsWait(1U, osFlagsWaitAny, 0), 3U);
+    CHECK_EQ(osThreadFlagsGet(), 2U);
+    (void) osThreadFlagsClear(2U);
+}
+
+osThreadId_t isr_target;
+bool         isr_context_seen;
+
+void test_isr_wakes_thread()
+{
+    isr_target            = osThreadGetId();
+    isr_context_seen      = false;
+    const uint64_t fire   = rtos_sim::now_us() + 250;
+    const uint32_t before = rtos_sim::wakeups(isr_target);
+    (void) rtos_sim::schedule_isr(fire, [] {
+        isr_context_seen = __get_IPSR() != 0 && rtos_sim::in_isr();
+        (void) osThreadFlagsSet(isr_target, 1U);
+    });
+    CHECK_EQ(osThreadFlagsWait(1U, osFlagsWaitAny, 10), 1U);
+    CHECK(isr_context_seen);
+    CHECK_EQ(rtos_sim::now_us(), fire);
+    CHECK_EQ(rtos_sim::wakeups(isr_target), before + 1);
+}
+
+void test_primask_defers_isr()
+{
+    bool fired = false;
+    (void) rtos_sim::schedule_isr(rtos_sim::now_us() + 10, [&fired] { fired = true; });
+    __disable_irq();
+    rtos_sim::consume_us(100);
+    CHECK(!fired);
+    // 退出临界区时挂起的中断立即响应
+    __enable_irq();
+    CHECK(fired);
+}
+
+void test_busy_wait_on_cycle_counter()
+{
+    // 忙等 DWT 的代码在仿真中也能结束
+    const uint32_t start = DWT->CYCCNT;
+    while (DWT->CYCCNT - start < SystemCoreClock / 1000U)
+    {
+    }
+    CHECK(HAL_GetTick() >= 1U);
+}
+
+int timer_count;
+
+void timer_entry(void*)
+{
+    ++timer_count;
+}
+
+void test_periodic_timer()
+{
+    timer_count            = 0;
+    const osTimerId_t timer = osTimerNew(timer_entry, osTimerPeriodic, nullptr, nullptr);
+    CHECK(osTimerStart(timer, 2) == osOK);
+    CHECK(osDelay(9) == osOK);
+    CHECK_EQ(timer_count, 4);
+    CHECK(osTimerStop(timer) == osOK);
+    CHECK(osTimerStop(timer) == osErrorResource);
+    CHECK(osDelay(5) == osOK);
+    CHECK_EQ(timer_count, 4);
+    CHECK(osTimerDelete(timer) == osOK);
+}
+
+int round_robin_turns[2];
+
+void round_robin_entry(void* argument)
+{
+    auto* turns = static_cast<int*>(argument);
+    for (int i = 0; i < 3; ++i)
+    {
+        ++*turns;
+        (void) osThreadYield();
+    }
+}
+
+void test_round_robin_yield()
+{
+    round_robin_turns[0] = round_robin_turns[1] = 0;
+    (void) osThreadNew(round_robin_entry, &round_robin_turns[0], nullptr);
+    (void) osThreadNew(round_robin_entry, &round_robin_turns[1], nullptr);
+    // 同优先级线程只有在 main 让出 CPU 时才运行
+    CHECK_EQ(round_robin_turns[0] + round_robin_turns[1], 0);
+    (void) osThreadYield();
+    CHECK_EQ(round_robin_turns[0], 1);
+    CHECK_EQ(round_robin_turns[1], 1);
+    CHECK(osDelay(1) == osOK);
+    CHECK_EQ(round_robin_turns[0], 3);
+    CHECK_EQ(round_robin_turns[1], 3);
+}
+
+} // namespace
+
+int main()
+{
+    CHECK(osKernelGetState() == osKernelInactive);
+    CHECK(osKernelInitialize() == osOK);
+    CHECK(osKernelStart() == osOK);
+    CHECK(osKernelGetState() == osKernelRunning);
+
+    RUN_TEST(test_priority_preemption);
+    RUN_TEST(test_delay_tick_boundary);
+    RUN_TEST(test_flags_wait_timeout);
+    RUN_TEST(test_isr_wakes_thread);
+    RUN_TEST(test_primask_defers_isr);
+    RUN_TEST(test_busy_wait_on_cycle_counter);
+    RUN_TEST(test_periodic_timer);
+    RUN_TEST(test_round_robin_yield);
+    return host_test::result();
+}
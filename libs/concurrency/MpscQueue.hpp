@@ -0,0 +1,102 @@
+/**
+ * @file    MpscQueue.hpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   有界无锁多生产者单消费者队列。
+ *
+ * 每个槽位带一个序号：生产者用 CAS 推进写位置抢占槽位，写完数据后发布序号；
+ * 消费者只在序号表明数据已写完时取出。Cortex-M3 及以上的 std::atomic 由 LDREX / STREX 实现，
+ * 不需要关中断，任意优先级的中断和线程都可以同时 push。
+ *
+ * 消费者必须唯一（或由调用者保证互斥）。生产者在抢到槽位后被打断时，
+ * 该槽位之后已写完的数据也要等它写完才能被取出。
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+template <typename T, size_t N> class MpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "MpscQueue size must be a power of 2");
+
+public:
+    MpscQueue()
+    {
+        for (size_t i = 0; i < N; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue&)            = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief 入队，可在任意上下文并发调用。
+     * @return 队列已满时返回 false
+     */
+    bool push(const T& value)
+    {
+        size_t pos  = head_.load(std::memory_order_relaxed);
+        Cell*  cell = nullptr;
+        for (;;)
+        {
+            cell             = &cells_[pos & (N - 1)];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto   dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0)
+            {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+            {
+                // 该槽位上一轮的数据还未被取走
+                return false;
+            }
+            else
+            {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 出队，只能由唯一的消费者调用。
+     * @return 队列为空（或队首槽位尚未写完）时返回 false
+     */
+    bool pop(T& out)
+    {
+        const size_t pos  = tail_.load(std::memory_order_relaxed);
+        Cell&        cell = cells_[pos & (N - 1)];
+        if (cell.seq.load(std::memory_order_acquire) != pos + 1)
+            return false;
+        out = cell.value;
+        cell.seq.store(pos + N, std::memory_order_release);
+        tail_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 队首是否有可取出的数据，任意上下文均可调用。
+     */
+    [[nodiscard]] bool empty() const
+    {
+        const size_t pos = tail_.load(std::memory_order_acquire);
+        return cells_[pos & (N - 1)].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq{ 0 };
+        T                   value{};
+    };
+
+    Cell                cells_[N];
+    std::atomic<size_t> head_{ 0 };
+    std::atomic<size_t> tail_{ 0 };
+};
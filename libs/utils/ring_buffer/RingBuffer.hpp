@@ -6,9 +6,14 @@
  *
  * 这个容器适合生产者和消费者之间做小规模缓存，尤其是在中断和任务之间传递短消息时。
  * 容量设计上会保留一个空槽位来区分“满”和“空”；如果 Overwrite=true，缓冲区满时会自动丢弃最旧元素。
+ *
+ * Overwrite=false 时是单生产者 / 单消费者（SPSC）无锁队列：head 只由生产者写，tail 只由消费者写，
+ * 两者以 acquire / release 发布，生产者在中断、消费者在线程中时不需要额外加锁。
+ * Overwrite=true 时生产者也会推进 tail，此时读写双方需要自行互斥。
  */
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <type_traits>
 namespace libs
@@ -28,14 +33,15 @@ public:
      */
     bool push(const T& value) noexcept
     {
-        const std::size_t next_head = next(head_);
+        const std::size_t head      = head_.load(std::memory_order_relaxed);
+        const std::size_t next_head = next(head);
 
-        if (next_head == tail_)
+        if (next_head == tail_.load(std::memory_order_acquire))
         {
             if constexpr (Overwrite)
             {
                 // 队列满时丢弃最旧数据，让新数据进入缓存。
-                tail_ = next(tail_);
+                tail_.store(next(next_head), std::memory_order_release);
             }
             else
             {
@@ -43,10 +49,10 @@ public:
             }
         }
 
-        buffer_[head_] = value;
+        buffer_[head] = value;
 
         // 先写数据，再移动 head，对外可见时元素已经就绪。
-        head_ = next_head;
+        head_.store(next_head, std::memory_order_release);
         return true;
     }
 
@@ -59,34 +65,42 @@ public:
               typename = std::enable_if_t<std::is_same_v<void, std::invoke_result_t<Builder, T&>>>>
     bool push(Builder&& builder) noexcept
     {
-        const std::size_t next_head = next(head_);
-        if (next_head == tail_)
+        const std::size_t head      = head_.load(std::memory_order_relaxed);
+        const std::size_t next_head = next(head);
+        if (next_head == tail_.load(std::memory_order_acquire))
         {
             if constexpr (Overwrite)
-                tail_ = next(tail_);
+                tail_.store(next(next_head), std::memory_order_release);
             else
                 return false;
         }
-        builder(buffer_[head_]);
-        head_ = next_head;
+        builder(buffer_[head]);
+        head_.store(next_head, std::memory_order_release);
         return true;
     }
 
+    /**
+     * @brief 预留一个槽位并立即发布。
+     *
+     * 槽位在写入前就已对消费者可见，因此只适合生产者和消费者不并发的场景；
+     * 并发场景请使用 push(builder)。
+     */
     T* emplace() noexcept
     {
         // 和 push(builder) 类似，但只把空槽位指针返回给调用者。
-        const std::size_t next_head = next(head_);
-        if (next_head == tail_)
+        const std::size_t head      = head_.load(std::memory_order_relaxed);
+        const std::size_t next_head = next(head);
+        if (next_head == tail_.load(std::memory_order_acquire))
         {
             if constexpr (Overwrite)
-                tail_ = next(tail_);
+                tail_.store(next(next_head), std::memory_order_release);
             else
                 return nullptr;
         }
 
-        T* out = &buffer_[head_];
+        T* out = &buffer_[head];
 
-        head_ = next_head;
+        head_.store(next_head, std::memory_order_release);
         return out;
     }
 
@@ -97,12 +111,14 @@ public:
      */
     bool pop(T& out) noexcept
     {
-        if (head_ == tail_)
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail)
             return false;
 
-        out = buffer_[tail_];
+        out = buffer_[tail];
 
-        tail_ = next(tail_);
+        // 先读数据，再移动 tail，槽位归还给生产者时数据已经取走。
+        tail_.store(next(tail), std::memory_order_release);
         return true;
     }
 
@@ -110,13 +126,15 @@ public:
      * @brief 返回队头元素指针并前移读指针。
      *
      * 调用方拿到的是缓冲区内部元素的直接地址，因此应该尽快消费，不要长期持有。
+     * 生产者并发运行时该槽位随时可能被覆写，此时应先用 front() 处理完再 pop()。
      */
     T* pop() noexcept
     {
-        if (head_ == tail_)
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail)
             return nullptr;
-        T* out = &buffer_[tail_];
-        tail_  = next(tail_);
+        T* out = &buffer_[tail];
+        tail_.store(next(tail), std::memory_order_release);
         return out;
     }
 
@@ -127,9 +145,10 @@ public:
      */
     [[nodiscard]] const T* front() const noexcept
     {
-        if (head_ == tail_)
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail)
             return nullptr;
-        return &buffer_[tail_];
+        return &buffer_[tail];
     }
 
     /**
@@ -139,9 +158,10 @@ public:
      */
     [[nodiscard]] const T* back() const noexcept
     {
-        if (head_ == tail_)
+        const std::size_t head = head_.load(std::memory_order_acquire);
+        if (head == tail_.load(std::memory_order_acquire))
             return nullptr;
-        return &buffer_[prev(head_)];
+        return &buffer_[prev(head)];
     }
 
     /**
@@ -151,21 +171,29 @@ public:
      */
     void clear() noexcept
     {
-        head_ = 0;
-        tail_ = 0;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_release);
     }
 
     /**
      * @brief 查询队列状态。
      */
-    [[nodiscard]] bool empty() const noexcept { return head_ == tail_; }
-    [[nodiscard]] bool full() const noexcept { return next(head_) == tail_; }
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+    [[nodiscard]] bool full() const noexcept
+    {
+        return next(head_.load(std::memory_order_acquire)) == tail_.load(std::memory_order_acquire);
+    }
 
     [[nodiscard]] std::size_t size() const noexcept
     {
-        if (head_ >= tail_)
-            return head_ - tail_;
-        return Capacity - (tail_ - head_);
+        const std::size_t head = head_.load(std::memory_order_acquire);
+        const std::size_t tail = tail_.load(std::memory_order_acquire);
+        if (head >= tail)
+            return head - tail;
+        return Capacity - (tail - head);
     }
 
     /**
@@ -178,8 +206,8 @@ public:
 private:
     alignas(T) T buffer_[Capacity];
 
-    volatile std::size_t head_{ 0 };
-    volatile std::size_t tail_{ 0 };
+    std::atomic<std::size_t> head_{ 0 };
+    std::atomic<std::size_t> tail_{ 0 };
 
 private:
     static constexpr std::size_t next(const std::size_t idx) noexcept
@@ -0,0 +1,467 @@
+/**
+ * @file    CanIsoTp.cpp
+ * @brief   ISO-TP 传输层实现
+ */
+#include "CanIsoTp.hpp"
+
+#include "isr_lock.h"
+
+#include <cstring>
+
+namespace protocol
+{
+
+namespace
+{
+
+constexpr uint8_t ISOTP_PCI_SF = 0x0; // 单帧
+constexpr uint8_t ISOTP_PCI_FF = 0x1; // 首帧
+constexpr uint8_t ISOTP_PCI_CF = 0x2; // 连续帧
+constexpr uint8_t ISOTP_PCI_FC = 0x3; // 流控帧
+
+constexpr uint8_t ISOTP_FC_CTS      = 0x0; // 继续发送
+constexpr uint8_t ISOTP_FC_WAIT     = 0x1; // 等待
+constexpr uint8_t ISOTP_FC_OVERFLOW = 0x2; // 溢出
+
+constexpr size_t  ISOTP_MAX_LENGTH = 0xFFF;
+constexpr uint8_t ISOTP_PADDING    = 0xCC;
+
+/**
+ * STmin 编码转换为毫秒
+ *
+ * 0x00 ~ 0x7F 为毫秒；0xF1 ~ 0xF9 为 100 ~ 900 us，按 1 ms 处理；其余为保留值，按最大值 127 ms 处理
+ */
+uint32_t st_min_to_ms(const uint8_t st_min)
+{
+    if (st_min <= 0x7F)
+        return st_min;
+    if (st_min >= 0xF1 && st_min <= 0xF9)
+        return 1;
+    return 0x7F;
+}
+
+} // namespace
+
+IsoTpBus::IsoTpBus(CAN_Handle* hcan) : hcan_(hcan)
+{
+    ISRGuard guard;
+    CAN_GetTxCompleteCallback(hcan_, &user_callback_, &user_ctx_);
+    CAN_SetTxCompleteCallback(hcan_, txCompleteCallback, this);
+}
+
+bool IsoTpBus::attach(IsoTpChannel& channel)
+{
+    if (channel_count_ >= ISOTP_MAX_CHANNEL_NUM || channel.hcan_ != nullptr)
+        return false;
+
+    const IsoTpChannel::Config& config = channel.config_;
+    const bool registered = !config.extended
+                                    ? CAN_RegisterIdCallback(hcan_, config.rx_id, 0x7FF, IsoTpChannel::rxCallback, &channel)
+                                    : CAN_RegisterExtIdCallback(hcan_, config.rx_id, IsoTpChannel::rxCallback, &channel);
+    if (!registered)
+        return false;
+
+    channel.hcan_                = hcan_;
+    channels_[channel_count_++] = &channel;
+    return true;
+}
+
+void IsoTpBus::poll()
+{
+    const uint32_t now = HAL_GetTick();
+    for (size_t i = 0; i < channel_count_; i++)
+        channels_[i]->poll(now);
+}
+
+void IsoTpBus::setTxCompleteCallback(const CAN_TxCompleteCallback_t callback, void* ctx)
+{
+    ISRGuard guard;
+    user_callback_ = callback;
+    user_ctx_      = ctx;
+}
+
+void IsoTpBus::txCompleteCallback(const CAN_Handle*  hcan,
+                                  const CAN_TxTicket ticket,
+                                  const CAN_TxStatus status,
+                                  void*              ctx)
+{
+    auto* bus = static_cast<IsoTpBus*>(ctx);
+    for (size_t i = 0; i < bus->channel_count_; i++)
+    {
+        IsoTpChannel* channel = bus->channels_[i];
+        if (channel->ownsTicket(ticket))
+        {
+            channel->onTxComplete(ticket, status);
+            return;
+        }
+        if (channel->rx_fc_ticket_ == ticket)
+        {
+            // 流控帧发送结束即可，发送失败由对方超时处理
+            channel->rx_fc_ticket_ = CAN_TX_TICKET_INVALID;
+            return;
+        }
+    }
+    if (bus->user_callback_ != nullptr)
+        bus->user_callback_(hcan, ticket, status, bus->user_ctx_);
+}
+
+IsoTpChannel::IsoTpChannel(const Config& config) : config_(config) {}
+
+bool IsoTpChannel::send(const uint8_t* data, const size_t length, const TxCallback callback, void* ctx)
+{
+    if (hcan_ == nullptr || data == nullptr || length == 0 || length > ISOTP_MAX_LENGTH)
+        return false;
+
+    ISRGuard guard;
+    if (tx_state_ != TxState::Idle)
+        return false;
+
+    tx_data_      = data;
+    tx_length_    = length;
+    tx_callback_  = callback;
+    tx_ctx_       = ctx;
+    tx_timer_     = HAL_GetTick();
+    tx_st_min_ms_ = 0;
+
+    uint8_t frame[8];
+    if (length <= 7)
+    {
+        // 单帧
+        frame[0] = static_cast<uint8_t>(ISOTP_PCI_SF << 4 | length);
+        memcpy(frame + 1, data, length);
+        if (!sendFrame(frame, 1 + length))
+            return false;
+        tx_offset_  = length;
+        tx_wait_fc_ = false;
+    }
+    else
+    {
+        // 首帧，之后等待对方的流控帧
+        frame[0] = static_cast<uint8_t>(ISOTP_PCI_FF << 4 | length >> 8);
+        frame[1] = static_cast<uint8_t>(length);
+        memcpy(frame + 2, data, 6);
+        if (!sendFrame(frame, 8))
+            return false;
+        tx_offset_  = 6;
+        tx_sn_      = 1;
+        tx_wait_fc_ = true;
+    }
+    tx_state_ = TxState::WaitSent;
+    return true;
+}
+
+bool IsoTpChannel::receive(uint8_t* buffer, const size_t capacity, const RxCallback callback, void* ctx)
+{
+    if (hcan_ == nullptr || buffer == nullptr || capacity == 0)
+        return false;
+
+    ISRGuard guard;
+    if (rx_state_ != RxState::Idle)
+        return false;
+
+    rx_buffer_   = buffer;
+    rx_capacity_ = capacity;
+    rx_callback_ = callback;
+    rx_ctx_      = ctx;
+    rx_state_    = RxState::Armed;
+    return true;
+}
+
+void IsoTpChannel::rxCallback(const CAN_Handle* /*hcan*/,
+                              const CAN_RxHeader* header,
+                              const uint8_t*      data,
+                              void*               ctx)
+{
+    const size_t length = CAN_GetDataLength(header);
+    if (!CAN_IsDataFrame(header) || length == 0)
+        return;
+    static_cast<IsoTpChannel*>(ctx)->onFrame(data, static_cast<uint32_t>(length > 8 ? 8 : length));
+}
+
+void IsoTpChannel::onFrame(const uint8_t* data, const uint32_t dlc)
+{
+    // 接收回调可能在中断中，也可能在 CAN_Poll 的线程中
+    ISRGuard guard;
+
+    switch (data[0] >> 4)
+    {
+    case ISOTP_PCI_SF:
+    {
+        const size_t length = data[0] & 0x0F;
+        if (length == 0 || length > dlc - 1)
+            return;
+        // 接收中收到新的单帧时按标准放弃当前数据，改为接收新帧
+        if (rx_state_ == RxState::Idle)
+            return;
+        if (length > rx_capacity_)
+        {
+            finishRx(Result::Overflow, 0);
+            return;
+        }
+        memcpy(rx_buffer_, data + 1, length);
+        finishRx(Result::Ok, length);
+        return;
+    }
+    case ISOTP_PCI_FF:
+    {
+        if (dlc < 8)
+            return;
+        const size_t length = (data[0] & 0x0F) << 8 | data[1];
+        if (length <= 7)
+            return;
+        if (rx_state_ == RxState::Idle)
+        {
+            // 没有接收缓冲区
+            sendFlowControl(ISOTP_FC_OVERFLOW);
+            return;
+        }
+        if (length > rx_capacity_)
+        {
+            sendFlowControl(ISOTP_FC_OVERFLOW);
+            finishRx(Result::Overflow, 0);
+            return;
+        }
+        memcpy(rx_buffer_, data + 2, 6);
+        rx_length_     = length;
+        rx_offset_     = 6;
+        rx_sn_         = 1;
+        rx_block_left_ = config_.block_size;
+        rx_timer_      = HAL_GetTick();
+        rx_state_      = RxState::Receiving;
+        sendFlowControl(ISOTP_FC_CTS);
+        return;
+    }
+    case ISOTP_PCI_CF:
+    {
+        if (rx_state_ != RxState::Receiving)
+            return;
+        if ((data[0] & 0x0F) != rx_sn_)
+        {
+            finishRx(Result::WrongSequence, 0);
+            return;
+        }
+        const size_t remain = rx_length_ - rx_offset_;
+        const size_t length = remain < 7 ? remain : 7;
+        if (length > dlc - 1)
+            return;
+        memcpy(rx_buffer_ + rx_offset_, data + 1, length);
+        rx_offset_ += length;
+        rx_sn_     = (rx_sn_ + 1) & 0x0F;
+        rx_timer_  = HAL_GetTick();
+        if (rx_offset_ >= rx_length_)
+        {
+            finishRx(Result::Ok, rx_length_);
+            return;
+        }
+        // 一个块收满，允许对方继续发送
+        if (config_.block_size != 0 && --rx_block_left_ == 0)
+        {
+            rx_block_left_ = config_.block_size;
+            sendFlowControl(ISOTP_FC_CTS);
+        }
+        return;
+    }
+    case ISOTP_PCI_FC:
+        if (dlc >= 3)
+            onFlowControl(data);
+        return;
+    default:
+        return;
+    }
+}
+
+void IsoTpChannel::onFlowControl(const uint8_t* data)
+{
+    // 流控帧可能先于块中最后一帧的发送完成中断到达
+    if (tx_state_ == TxState::Idle || !tx_wait_fc_)
+        return;
+
+    switch (data[0] & 0x0F)
+    {
+    case ISOTP_FC_CTS:
+        tx_block_size_ = data[1];
+        tx_block_left_ = data[1];
+        tx_st_min_ms_  = st_min_to_ms(data[2]);
+        tx_wait_fc_    = false;
+        pumpTx();
+        return;
+    case ISOTP_FC_WAIT:
+        // 重新开始等待流控帧
+        tx_timer_ = HAL_GetTick();
+        return;
+    case ISOTP_FC_OVERFLOW:
+        finishTx(Result::Overflow);
+        return;
+    default:
+        return;
+    }
+}
+
+bool IsoTpChannel::ownsTicket(const CAN_TxTicket ticket) const
+{
+    for (const CAN_TxTicket t : tx_tickets_)
+        if (t != CAN_TX_TICKET_INVALID && t == ticket)
+            return true;
+    return false;
+}
+
+void IsoTpChannel::onTxComplete(const CAN_TxTicket ticket, const CAN_TxStatus status)
+{
+    // 只处理已提交的帧；提交失败时驱动同步报告的 DROPPED / RATE_LIMITED 由 sendFrame 处理
+    size_t index = 0;
+    while (index < tx_in_flight_ && tx_tickets_[index] != ticket)
+        index++;
+    if (index == tx_in_flight_)
+        return;
+    tx_tickets_[index]         = tx_tickets_[--tx_in_flight_];
+    tx_tickets_[tx_in_flight_] = CAN_TX_TICKET_INVALID;
+
+    if (status != CAN_TX_STATUS_SENT)
+    {
+        finishTx(Result::Aborted);
+        return;
+    }
+
+    tx_timer_ = HAL_GetTick();
+    // STmin 不为 0 时窗口为 1，每帧发完后由 poll 计时
+    if (tx_st_min_ms_ != 0 && !tx_wait_fc_ && tx_offset_ < tx_length_)
+    {
+        tx_state_ = TxState::WaitStMin;
+        return;
+    }
+    // STmin 为 0 时直接在发送完成中断中补满窗口
+    pumpTx();
+}
+
+void IsoTpChannel::poll(const uint32_t now)
+{
+    ISRGuard guard;
+
+    switch (tx_state_)
+    {
+    case TxState::WaitSent:
+    case TxState::WaitFlowControl:
+        if (now - tx_timer_ > config_.timeout_ms)
+            finishTx(Result::Timeout);
+        break;
+    case TxState::WaitStMin:
+        // 严格大于，保证 1 ms 粒度的 tick 下间隔不小于 STmin
+        if (now - tx_timer_ > tx_st_min_ms_)
+            pumpTx();
+        break;
+    default:
+        break;
+    }
+
+    if (rx_state_ == RxState::Receiving)
+    {
+        if (rx_fc_pending_)
+            sendFlowControl(rx_fc_status_);
+        if (now - rx_timer_ > config_.timeout_ms)
+            finishRx(Result::Timeout, 0);
+    }
+}
+
+bool IsoTpChannel::sendFrame(uint8_t frame[8], const size_t used)
+{
+    memset(frame + used, ISOTP_PADDING, 8 - used);
+
+    const CAN_TxHeader header = CAN_MakeDataHeader(config_.tx_id, config_.extended, 8);
+
+    // 票据在提交前写入 tx_tickets_，驱动同步报告的发送结束事件仍能识别为本会话的帧并被忽略
+    CAN_TxTicket& ticket = tx_tickets_[tx_in_flight_];
+    if (CAN_SendMessage(hcan_, &header, frame, &ticket) == CAN_SEND_FAILED)
+    {
+        ticket = CAN_TX_TICKET_INVALID;
+        return false;
+    }
+    tx_in_flight_++;
+    return true;
+}
+
+void IsoTpChannel::pumpTx()
+{
+    // STmin 为 0 时窗口内的连续帧全部提交，邮箱与队列按提交顺序发出
+    const uint8_t window = tx_st_min_ms_ == 0 ? ISOTP_TX_WINDOW : 1;
+    while (tx_in_flight_ < window && tx_offset_ < tx_length_ && !tx_wait_fc_)
+    {
+        if (!sendConsecutive())
+            break;
+    }
+
+    if (tx_in_flight_ > 0)
+    {
+        tx_state_ = TxState::WaitSent;
+    }
+    else if (tx_wait_fc_)
+    {
+        tx_state_ = TxState::WaitFlowControl;
+    }
+    else if (tx_offset_ >= tx_length_)
+    {
+        finishTx(Result::Ok);
+    }
+    else
+    {
+        // 邮箱与发送队列都满或被限速，交给 poll 重试
+        tx_state_ = TxState::WaitStMin;
+        tx_timer_ = HAL_GetTick() - tx_st_min_ms_;
+    }
+}
+
+bool IsoTpChannel::sendConsecutive()
+{
+    const size_t remain = tx_length_ - tx_offset_;
+    const size_t length = remain < 7 ? remain : 7;
+
+    uint8_t frame[8];
+    frame[0] = static_cast<uint8_t>(ISOTP_PCI_CF << 4 | tx_sn_);
+    memcpy(frame + 1, tx_data_ + tx_offset_, length);
+
+    // 调用方都处于临界区内，发送完成回调不会在 CAN_SendMessage 返回前到来
+    if (!sendFrame(frame, 1 + length))
+        return false;
+
+    tx_offset_ += length;
+    tx_sn_ = (tx_sn_ + 1) & 0x0F;
+    // 块已发完，之后等待流控帧
+    if (tx_block_size_ != 0 && --tx_block_left_ == 0)
+        tx_wait_fc_ = tx_offset_ < tx_length_;
+    return true;
+}
+
+void IsoTpChannel::sendFlowControl(const uint8_t flow_status)
+{
+    uint8_t frame[8];
+    frame[0] = static_cast<uint8_t>(ISOTP_PCI_FC << 4 | flow_status);
+    frame[1] = config_.block_size;
+    frame[2] = config_.st_min;
+    memset(frame + 3, ISOTP_PADDING, 5);
+
+    const CAN_TxHeader header = CAN_MakeDataHeader(config_.tx_id, config_.extended, 8);
+
+    rx_fc_pending_ = CAN_SendMessage(hcan_, &header, frame, &rx_fc_ticket_) == CAN_SEND_FAILED;
+    rx_fc_status_  = flow_status;
+}
+
+void IsoTpChannel::finishTx(const Result result)
+{
+    // 票据保留到被下一次发送覆盖，仍在驱动中的帧结束时按本会话的帧忽略，不会转发给其他回调
+    tx_state_     = TxState::Idle;
+    tx_wait_fc_   = false;
+    tx_in_flight_ = 0;
+    tx_data_      = nullptr;
+    if (tx_callback_ != nullptr)
+        tx_callback_(*this, result, tx_ctx_);
+}
+
+void IsoTpChannel::finishRx(const Result result, const size_t length)
+{
+    rx_state_      = RxState::Idle;
+    rx_fc_pending_ = false;
+    rx_buffer_     = nullptr;
+    if (rx_callback_ != nullptr)
+        rx_callback_(*this, result, length, rx_ctx_);
+}
+
+} // namespace protocol
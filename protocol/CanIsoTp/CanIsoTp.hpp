@@ -0,0 +1,233 @@
+/**
+ * @file    CanIsoTp.hpp
+ * @brief   基于 can_driver 的 ISO-TP（ISO 15765-2）传输层
+ *
+ * 在 8 字节经典 CAN 帧上收发最长 4095 字节的数据：发送端自动分段并遵守接收端的流控（BS / STmin），
+ * 接收端把数据直接重组到调用者提供的缓冲区，发送端直接从调用者的数据中取帧，均不经过中间缓冲区。
+ *
+ * 发送由 CAN 发送完成中断推进：STmin 为 0 时同时提交最多 ISOTP_TX_WINDOW 个连续帧，一帧发送完成后
+ * 立即在中断中补上下一帧，邮箱中始终有帧在排队，吞吐接近总线带宽。
+ * 只有 STmin 等待、发送失败重试和超时检查依赖周期调用 IsoTpBus::poll()（建议 1 ms）。
+ *
+ * 仅支持普通寻址（normal addressing），发出的帧总是用 0xCC 填充到 8 字节。
+ *
+ * 只通过 can_driver 与后端无关的接口（CAN_Handle、CAN_MakeDataHeader 等）收发，bxCAN 与 FDCAN 后端均可使用；
+ * FDCAN 上同样收发 8 字节的经典帧。ISOTP_TX_WINDOW 大于 1 时依赖驱动按提交顺序发出相同 ID 的帧：
+ * bxCAN 驱动保证这一点；FDCAN 请使用 Tx FIFO 模式，Queue 模式下相同 ID 的帧按缓冲区编号发送，可能乱序。
+ */
+#pragma once
+
+#include "can_driver.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace protocol
+{
+
+// 一条 CAN 上最多挂载的 ISO-TP 会话数量
+#ifndef ISOTP_MAX_CHANNEL_NUM
+#    define ISOTP_MAX_CHANNEL_NUM (4)
+#endif
+
+// 每个会话同时在发送的连续帧数量上限，STmin 不为 0 时总是 1；设为 3 可占满 bxCAN 的全部邮箱
+#ifndef ISOTP_TX_WINDOW
+#    define ISOTP_TX_WINDOW (2)
+#endif
+
+class IsoTpChannel;
+
+/**
+ * @brief 一条 CAN 上的 ISO-TP 会话集合
+ *
+ * 占用该 CAN 的发送结束回调（CAN_SetTxCompleteCallback），按票据把发送结束事件分发给各会话；
+ * 不属于 ISO-TP 的票据转发给构造前已设置的回调，或 setTxCompleteCallback 设置的回调。
+ * 构造之后请不要再直接调用 CAN_SetTxCompleteCallback，否则 ISO-TP 收不到发送结束事件。
+ */
+class IsoTpBus final
+{
+public:
+    /**
+     * @brief 使用一条 CAN 构造，需在 CAN_InitMainCallback 之后调用
+     *
+     * 已经设置的发送结束回调会被保留，非 ISO-TP 的票据继续交给它
+     * @param hcan can handle
+     */
+    explicit IsoTpBus(CAN_Handle* hcan);
+
+    IsoTpBus(const IsoTpBus&)            = delete;
+    IsoTpBus& operator=(const IsoTpBus&) = delete;
+
+    /**
+     * @brief 挂载一个会话，并注册其接收 ID 的回调
+     * @attention 本函数非线程安全，请在开始收发前完成挂载
+     * @param channel 会话对象，生命周期需覆盖整个运行期
+     * @return 会话表已满或接收 ID 注册失败时返回 false
+     */
+    bool attach(IsoTpChannel& channel);
+
+    /**
+     * @brief 处理 STmin 等待、发送重试与超时，需周期调用（建议 1 ms）
+     */
+    void poll();
+
+    /**
+     * @brief 设置非 ISO-TP 帧的发送结束回调
+     */
+    void setTxCompleteCallback(CAN_TxCompleteCallback_t callback, void* ctx);
+
+    [[nodiscard]] CAN_Handle* hcan() const { return hcan_; }
+
+private:
+    static void txCompleteCallback(const CAN_Handle* hcan, CAN_TxTicket ticket, CAN_TxStatus status, void* ctx);
+
+    CAN_Handle*              hcan_;
+    IsoTpChannel*            channels_[ISOTP_MAX_CHANNEL_NUM]{};
+    size_t                   channel_count_{ 0 };
+    CAN_TxCompleteCallback_t user_callback_{ nullptr };
+    void*                    user_ctx_{ nullptr };
+};
+
+/**
+ * @brief 一个 ISO-TP 会话（一对发送 / 接收 ID）
+ *
+ * 同一会话可同时进行一次发送和一次接收；同一条 CAN 上的多个会话互不影响。
+ * 发送因超时或中止而结束时，仍在驱动中的帧照常发出，但不再影响本会话。
+ */
+class IsoTpChannel final
+{
+public:
+    enum class Result : uint8_t
+    {
+        Ok,            ///< 完成
+        Timeout,       ///< 等待流控帧或连续帧超时
+        Overflow,      ///< 接收缓冲区不足，或对方回复溢出
+        WrongSequence, ///< 连续帧序号错误
+        Aborted,       ///< 底层 CAN 帧发送失败（被丢弃、限速或中止）
+    };
+
+    /**
+     * @brief 发送结束回调，调用后 send 传入的数据不再被访问
+     * @attention 可能在中断中调用
+     */
+    using TxCallback = void (*)(IsoTpChannel& channel, Result result, void* ctx);
+
+    /**
+     * @brief 接收结束回调，调用后 receive 传入的缓冲区归还给调用者
+     * @param length 成功时为数据长度
+     * @attention 可能在中断中调用
+     */
+    using RxCallback = void (*)(IsoTpChannel& channel, Result result, size_t length, void* ctx);
+
+    struct Config
+    {
+        uint32_t tx_id{ 0 };              ///< 发送使用的 CAN ID
+        uint32_t rx_id{ 0 };              ///< 接收的 CAN ID
+        bool     extended{ false };       ///< 是否使用扩展帧 ID
+        uint8_t  block_size{ 0 };         ///< 接收时要求对方每发送多少帧等待一次流控，0 表示不等待
+        uint8_t  st_min{ 0 };             ///< 接收时要求的连续帧最小间隔（ISO-TP STmin 编码）
+        uint32_t timeout_ms{ 1000 };      ///< 等待流控帧 / 连续帧的超时时间，单位毫秒
+    };
+
+    explicit IsoTpChannel(const Config& config);
+
+    IsoTpChannel(const IsoTpChannel&)            = delete;
+    IsoTpChannel& operator=(const IsoTpChannel&) = delete;
+
+    /**
+     * @brief 开始发送一段数据
+     * @param data 数据，发送结束回调之前必须保持有效
+     * @param length 长度，1 ~ 4095
+     * @param callback 发送结束回调，可为 nullptr
+     * @param ctx 用户上下文
+     * @return 未挂载、正在发送或参数无效时返回 false
+     * @note 本函数是线程安全的
+     */
+    bool send(const uint8_t* data, size_t length, TxCallback callback, void* ctx);
+
+    /**
+     * @brief 提供接收缓冲区，接收下一段数据
+     *
+     * 单次有效：接收结束回调之后需要重新调用；未提供缓冲区时收到的首帧会以溢出流控拒绝
+     * @param buffer 接收缓冲区，接收结束回调之前必须保持有效
+     * @param capacity 缓冲区大小
+     * @param callback 接收结束回调
+     * @param ctx 用户上下文
+     * @return 未挂载或已有缓冲区时返回 false
+     * @note 本函数是线程安全的
+     */
+    bool receive(uint8_t* buffer, size_t capacity, RxCallback callback, void* ctx);
+
+    [[nodiscard]] bool isSending() const { return tx_state_ != TxState::Idle; }
+    [[nodiscard]] bool isReceiving() const { return rx_state_ != RxState::Idle; }
+
+private:
+    friend class IsoTpBus;
+
+    enum class TxState : uint8_t
+    {
+        Idle,
+        WaitSent,        ///< 有帧已提交，等待发送完成
+        WaitFlowControl, ///< 等待对方的流控帧
+        WaitStMin,       ///< 等待 STmin 后发送下一连续帧（也用于发送失败后的重试）
+    };
+
+    enum class RxState : uint8_t
+    {
+        Idle,      ///< 没有接收缓冲区
+        Armed,     ///< 已提供缓冲区，等待单帧或首帧
+        Receiving, ///< 正在接收连续帧
+    };
+
+    static void rxCallback(const CAN_Handle* hcan, const CAN_RxHeader* header, const uint8_t* data, void* ctx);
+
+    void onFrame(const uint8_t* data, uint32_t dlc);
+    void onFlowControl(const uint8_t* data);
+    [[nodiscard]] bool ownsTicket(CAN_TxTicket ticket) const;
+    void               onTxComplete(CAN_TxTicket ticket, CAN_TxStatus status);
+    void               poll(uint32_t now);
+
+    bool sendFrame(uint8_t frame[8], size_t used);
+    bool sendConsecutive();
+    void pumpTx();
+    void sendFlowControl(uint8_t flow_status);
+    void finishTx(Result result);
+    void finishRx(Result result, size_t length);
+
+    Config      config_;
+    CAN_Handle* hcan_{ nullptr };
+
+    // 发送
+    volatile TxState tx_state_{ TxState::Idle };
+    bool             tx_wait_fc_{ false }; // 已提交的帧发完后需要等待流控帧（首帧之后、块发完之后）
+    const uint8_t*   tx_data_{ nullptr };
+    size_t           tx_length_{ 0 };
+    size_t           tx_offset_{ 0 };
+    uint8_t          tx_sn_{ 0 };
+    uint8_t          tx_block_size_{ 0 };
+    uint8_t          tx_block_left_{ 0 };
+    uint32_t         tx_st_min_ms_{ 0 };
+    uint32_t         tx_timer_{ 0 };
+    // 已提交、尚未结束的帧的票据，前 tx_in_flight_ 个有效；tx_tickets_[tx_in_flight_] 为正在提交的帧
+    CAN_TxTicket     tx_tickets_[ISOTP_TX_WINDOW]{};
+    uint8_t          tx_in_flight_{ 0 };
+    TxCallback       tx_callback_{ nullptr };
+    void*            tx_ctx_{ nullptr };
+
+    // 接收
+    volatile RxState rx_state_{ RxState::Idle };
+    uint8_t*         rx_buffer_{ nullptr };
+    size_t           rx_capacity_{ 0 };
+    size_t           rx_length_{ 0 };
+    size_t           rx_offset_{ 0 };
+    uint8_t          rx_sn_{ 0 };
+    uint8_t          rx_block_left_{ 0 };
+    uint32_t         rx_timer_{ 0 };
+    bool             rx_fc_pending_{ false }; // 流控帧发送失败，等待 poll 重试
+    uint8_t          rx_fc_status_{ 0 };
+    CAN_TxTicket     rx_fc_ticket_{ CAN_TX_TICKET_INVALID };
+    RxCallback       rx_callback_{ nullptr };
+    void*            rx_ctx_{ nullptr };
+};
+
+} // namespace protocol
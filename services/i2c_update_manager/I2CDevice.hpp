@@ -15,6 +15,15 @@ class I2CUpdateManager;
  */
 enum class UpdateStatus : uint8_t { Complete, Pending, Failed };
 
+/**
+ * @brief 设备完成一轮更新（Trigger + Read）在总线上的开销，供 manager 做可调度性分析
+ */
+struct I2CBusCost
+{
+    uint16_t bytes{ 0 };        ///< 总字节数，含寄存器地址字节和数据字节，不含设备地址字节
+    uint8_t  transactions{ 0 }; ///< 总线事务数，每笔事务另计设备地址、START / STOP 和驱动开销
+};
+
 // I2C 周期设备的抽象基类。
 //
 // 这个基类内置了 Trigger -> Wait -> Read 三段状态机，子类只需要实现
@@ -41,6 +50,12 @@ public:
      */
     virtual uint8_t     address7bit() const = 0;
 
+    /**
+     * @brief 获取一轮更新的总线开销，转换等待时间由 conversionMs() 给出
+     * @return 总线开销；每个设备都必须声明，否则可调度性分析无从估算它的总线占用
+     */
+    virtual I2CBusCost  busCost() const = 0;
+
     /**
      * @brief 执行一次初始化或探活流程
      * @param bus 当前设备所在的 I2C 总线
@@ -6,12 +6,31 @@
 
 #include "main.h"
 
+#include <utility>
+
 namespace
 {
-// 处理 HAL_GetTick() 回卷后的“是否到期”判断。
-bool tickReached(const uint32_t now_ms, const uint32_t due_ms)
+// 调度线程的唤醒标志；bit0 已被 I2CBusDMA 的同步等待占用
+constexpr uint32_t WakeFlag = 1U << 1;
+
+// 微秒时间戳按 int32 差值比较，周期和相位必须远小于 2^31 us（约 35 分钟）
+constexpr uint32_t MaxPeriodMs = 30U * 60U * 1000U;
+
+// 处理微秒时间戳回卷后的“是否到期”判断。
+bool timeReached(const uint32_t now_us, const uint32_t due_us)
+{
+    return static_cast<int32_t>(now_us - due_us) >= 0;
+}
+
+bool earlier(const uint32_t a_us, const uint32_t b_us)
 {
-    return static_cast<int32_t>(now_ms - due_ms) >= 0;
+    return static_cast<int32_t>(a_us - b_us) < 0;
+}
+
+// 从 from_us 到 now_us 经过的时间；tick 对齐模式下线程可能在锚点换算出的时刻之前几微秒被唤醒，此时按 0 计。
+uint32_t elapsedUs(const uint32_t now_us, const uint32_t from_us)
+{
+    return timeReached(now_us, from_us) ? now_us - from_us : 0U;
 }
 
 uint32_t kernelTicksFromMs(uint32_t timeout_ms)
@@ -26,9 +45,64 @@ uint32_t kernelTicksFromMs(uint32_t timeout_ms)
     const uint64_t ticks = (static_cast<uint64_t>(timeout_ms) * tick_freq + 999ULL) / 1000ULL;
     return static_cast<uint32_t>(ticks == 0U ? 1ULL : ticks);
 }
+
+void enableCycleCounter()
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+// 隐式截止时间：本周期的截止时刻就是下一个周期的名义起点。
+uint32_t deadlineUs(const I2CUpdateManager::Entry& entry)
+{
+    return entry.cycle_start_us + entry.period_us;
+}
+
+// 调度表最多 MaxDevices 项，堆里直接存条目下标，key 返回排序用的时间戳。
+template <typename Key> void heapPush(uint8_t* heap, std::size_t& count, const uint8_t index, Key key)
+{
+    std::size_t i = count++;
+    heap[i]       = index;
+    while (i > 0U)
+    {
+        const std::size_t parent = (i - 1U) / 2U;
+        if (!earlier(key(heap[i]), key(heap[parent])))
+            break;
+        std::swap(heap[i], heap[parent]);
+        i = parent;
+    }
+}
+
+template <typename Key> uint8_t heapPop(uint8_t* heap, std::size_t& count, Key key)
+{
+    const uint8_t top = heap[0];
+    heap[0]           = heap[--count];
+
+    std::size_t i = 0;
+    while (true)
+    {
+        const std::size_t left     = 2U * i + 1U;
+        const std::size_t right    = left + 1U;
+        std::size_t       smallest = i;
+        if (left < count && earlier(key(heap[left]), key(heap[smallest])))
+            smallest = left;
+        if (right < count && earlier(key(heap[right]), key(heap[smallest])))
+            smallest = right;
+        if (smallest == i)
+            break;
+        std::swap(heap[i], heap[smallest]);
+        i = smallest;
+    }
+    return top;
+}
 } // namespace
 
-I2CUpdateManager::I2CUpdateManager(I2CBusDMA& bus) : bus_(bus) {}
+I2CUpdateManager::I2CUpdateManager(I2CBusDMA& bus, const uint32_t bus_clock_hz)
+    : bus_(bus), bus_clock_hz_(bus_clock_hz == 0U ? 100000U : bus_clock_hz)
+{
+}
 
 bool I2CUpdateManager::registerDevice(I2CDevice&       device,
                                       const uint32_t   period_ms,
@@ -39,18 +113,32 @@ bool I2CUpdateManager::registerDevice(I2CDevice&       device,
     if (run_flag_ || task_handle_ != nullptr)
         return false;
 
-    if (entry_count_ >= MaxDevices || period_ms == 0U)
+    if (entry_count_ >= MaxDevices || period_ms == 0U || period_ms > MaxPeriodMs || phase_ms > MaxPeriodMs)
         return false;
 
+    enableCycleCounter();
+
     // manager 只保存调度信息，设备对象本身不持有周期配置。
-    Entry& entry        = entries_[entry_count_++];
+    const auto index    = static_cast<uint8_t>(entry_count_++);
+    Entry&     entry    = entries_[index];
     entry.device        = &device;
-    entry.period_ms     = period_ms;
-    entry.phase_ms      = phase_ms;
+    entry.period_us     = period_ms * 1000U;
+    entry.phase_us      = phase_ms * 1000U;
     entry.timeout_ms    = timeout_ms;
-    entry.next_due_ms   = HAL_GetTick() + phase_ms;
     entry.enabled       = true;
     entry.initialized   = false;
+
+    // 新设备可能让已注册的设备也赶不上周期，所以每次都重新分析整组设备。
+    if (!analyze() && strict_admission_)
+    {
+        entry = Entry{};
+        --entry_count_;
+        (void) analyze();
+        return false;
+    }
+
+    entry.next_due_us = nowUs() + entry.phase_us;
+    pushRelease(index);
     return true;
 }
 
@@ -66,9 +154,31 @@ bool I2CUpdateManager::start(const Config& config)
     if (task_handle_ != nullptr)
         return false;
 
+    const uint32_t tick_freq = osKernelGetTickFreq() == 0U ? 1000U : osKernelGetTickFreq();
+    tick_us_                 = 1000000U / tick_freq;
+    if (config.tick_aligned)
+    {
+        for (std::size_t i = 0; i < entry_count_; ++i)
+        {
+            if (entries_[i].period_us % tick_us_ != 0U || entries_[i].phase_us % tick_us_ != 0U)
+                return false;
+        }
+    }
+
     // 先落盘配置，再启动后台线程，避免线程先跑起来但配置还没写完。
     config_   = config;
     run_flag_ = true;
+    enableCycleCounter();
+
+    if (wake_timer_ == nullptr)
+    {
+        wake_timer_ = osTimerNew(timerEntry, osTimerOnce, this, nullptr);
+        if (wake_timer_ == nullptr)
+        {
+            run_flag_ = false;
+            return false;
+        }
+    }
 
     const osThreadAttr_t attr{
         .name       = config_.task_name,
@@ -89,51 +199,222 @@ bool I2CUpdateManager::start(const Config& config)
 void I2CUpdateManager::stop()
 {
     run_flag_ = false;
+    // 立即唤醒正在休眠的调度线程，让它尽快退出。
+    if (const osThreadId_t thread = task_handle_; thread != nullptr)
+        (void) osThreadFlagsSet(thread, WakeFlag);
 }
 
-I2CUpdateManager::Entry* I2CUpdateManager::selectReadyEntry(const uint32_t now_ms)
+bool I2CUpdateManager::getAnalysis(const I2CDevice& device, Analysis& analysis) const
 {
-    Entry* best = nullptr;
     for (std::size_t i = 0; i < entry_count_; ++i)
     {
-        Entry& entry = entries_[i];
-        if (!entry.enabled || entry.device == nullptr)
-            continue;
+        if (entries_[i].device == &device)
+        {
+            analysis = entries_[i].analysis;
+            return true;
+        }
+    }
+    return false;
+}
 
-        if (!tickReached(now_ms, entry.next_due_ms))
-            continue;
+bool I2CUpdateManager::getStats(const I2CDevice& device, Stats& stats) const
+{
+    for (std::size_t i = 0; i < entry_count_; ++i)
+    {
+        if (entries_[i].device == &device)
+        {
+            stats = entries_[i].stats;
+            return true;
+        }
+    }
+    return false;
+}
 
-        // 这里选择“最早到期”的那一个，避免周期短的设备被周期长的设备持续挤压。
-        if (best == nullptr || tickReached(best->next_due_ms, entry.next_due_ms))
-            best = &entry;
+void I2CUpdateManager::resetStats()
+{
+    for (std::size_t i = 0; i < entry_count_; ++i)
+        entries_[i].stats = Stats{};
+}
+
+uint32_t I2CUpdateManager::busTimeUs(const I2CBusCost& cost) const
+{
+    // 每字节 8 位数据 + 1 位 ACK；每笔事务另有两个设备地址字节（写寄存器地址、重复起始后读）
+    // 以及 START / 重复 START / STOP 约 3 位，再加上驱动自身的固定开销。
+    const uint64_t bits    = static_cast<uint64_t>(cost.bytes) * 9U + static_cast<uint64_t>(cost.transactions) * (2U * 9U + 3U);
+    const uint64_t wire_us = (bits * 1000000ULL + bus_clock_hz_ - 1U) / bus_clock_hz_;
+    return static_cast<uint32_t>(wire_us + static_cast<uint64_t>(cost.transactions) * TransactionOverheadUs);
+}
+
+bool I2CUpdateManager::analyze()
+{
+    float utilization = 0.0f;
+    for (std::size_t i = 0; i < entry_count_; ++i)
+    {
+        Entry& entry           = entries_[i];
+        entry.analysis.cost_us = busTimeUs(entry.device->busCost());
+        utilization += static_cast<float>(entry.analysis.cost_us) / static_cast<float>(entry.period_us);
     }
-    return best;
+
+    // 总线上的更新不可抢占，按非抢占 EDF 估算响应时间上界（保守，不是精确值）：
+    // 在本设备一个周期内，截止时间不晚于它的其他设备最多各更新 floor(T_i / T_j) 次；
+    // 另外还可能被一笔已经开始的更新阻塞，需要转换等待的设备在 Trigger 和 Read 两个阶段各被阻塞一次。
+    bool schedulable = utilization <= 1.0f;
+    for (std::size_t i = 0; i < entry_count_; ++i)
+    {
+        Entry&   entry    = entries_[i];
+        uint64_t demand   = entry.analysis.cost_us;
+        uint32_t blocking = 0;
+        for (std::size_t j = 0; j < entry_count_; ++j)
+        {
+            if (j == i)
+                continue;
+            const Entry& other = entries_[j];
+            demand += static_cast<uint64_t>(entry.period_us / other.period_us) * other.analysis.cost_us;
+            if (other.analysis.cost_us > blocking)
+                blocking = other.analysis.cost_us;
+        }
+
+        const uint64_t conversion_us = static_cast<uint64_t>(entry.device->conversionMs()) * 1000U;
+        const uint64_t bound         = conversion_us + demand + (conversion_us > 0U ? 2U : 1U) * static_cast<uint64_t>(blocking);
+
+        entry.analysis.response_bound_us = bound > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(bound);
+        entry.analysis.schedulable       = bound <= entry.period_us;
+        schedulable                      = schedulable && entry.analysis.schedulable;
+    }
+
+    planned_utilization_ = utilization;
+    schedulable_         = schedulable;
+    return schedulable;
 }
 
-uint32_t I2CUpdateManager::computeSleepMs(const uint32_t now_ms) const
+uint32_t I2CUpdateManager::nowUs()
 {
-    uint32_t min_wait_ms = config_.max_sleep_ms;
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    // CYCCNT 只有 32 位，这里把增量累加成微秒；两次调用间隔必须小于 CYCCNT 回卷周期
+    // （168 MHz 约 25 s），调度线程每次休眠不超过 max_sleep_ms，自然满足。
+    const uint32_t cycles        = DWT->CYCCNT;
+    const uint32_t cycles_per_us = SystemCoreClock / 1000000U == 0U ? 1U : SystemCoreClock / 1000000U;
+    cycle_remainder_ += cycles - last_cycles_;
+    last_cycles_ = cycles;
+    now_us_ += cycle_remainder_ / cycles_per_us;
+    cycle_remainder_ %= cycles_per_us;
+    return now_us_;
+#else
+    return HAL_GetTick() * 1000U;
+#endif
+}
 
+void I2CUpdateManager::alignToTick()
+{
+    // 在 tick 边界之后立即读微秒时间，两者之差只有几次读时钟的开销；之后所有释放时刻都落在
+    // anchor_us_ + k * tick_us_ 上，对应 anchor_tick_ + k 这个 tick 边界。
+    const uint32_t start_tick = osKernelGetTickCount();
+    uint32_t       tick       = start_tick;
+    while (tick == start_tick)
+        tick = osKernelGetTickCount();
+    anchor_tick_ = tick;
+    anchor_us_   = nowUs();
+
+    ready_count_   = 0U;
+    release_count_ = 0U;
     for (std::size_t i = 0; i < entry_count_; ++i)
     {
-        const Entry& entry = entries_[i];
-        if (!entry.enabled || entry.device == nullptr)
-            continue;
+        entries_[i].next_due_us = anchor_us_ + entries_[i].phase_us;
+        pushRelease(static_cast<uint8_t>(i));
+    }
+}
+
+uint32_t I2CUpdateManager::alignUp(const uint32_t time_us) const
+{
+    if (!config_.tick_aligned)
+        return time_us;
+    const uint32_t offset_us = time_us - anchor_us_;
+    return anchor_us_ + (offset_us + tick_us_ - 1U) / tick_us_ * tick_us_;
+}
+
+void I2CUpdateManager::pushRelease(const uint8_t index)
+{
+    heapPush(release_heap_, release_count_, index, [this](const uint8_t i) { return entries_[i].next_due_us; });
+}
+
+void I2CUpdateManager::releaseDue(const uint32_t now_us)
+{
+    // tick 对齐时释放时刻都在 tick 边界上，被该 tick 唤醒时读到的时间可能比锚点换算出的时刻早几微秒，
+    // 放宽半个 tick 仍不会提前释放下一个 tick 的条目。
+    const uint32_t reach_us = config_.tick_aligned ? now_us + tick_us_ / 2U : now_us;
+    while (release_count_ > 0U && timeReached(reach_us, entries_[release_heap_[0]].next_due_us))
+    {
+        const uint8_t index = heapPop(
+                release_heap_, release_count_, [this](const uint8_t i) { return entries_[i].next_due_us; });
+        Entry& entry = entries_[index];
 
-        if (tickReached(now_ms, entry.next_due_ms))
-            // 只要已有设备到期，manager 就尽快醒来处理，不再继续长睡眠。
-            return 1U;
+        // 新周期开始：记录本轮的名义起点（即注册时或上一轮结束时算出的 next_due_us）。
+        // Pending 阶段会覆写 next_due_us，转换完成后重新释放时沿用原来的起点和截止时间。
+        if (!entry.pending_)
+            entry.cycle_start_us = entry.next_due_us;
 
-        const uint32_t wait_ms = entry.next_due_ms - now_ms;
-        if (wait_ms < min_wait_ms)
-            min_wait_ms = wait_ms;
+        heapPush(ready_heap_, ready_count_, index, [this](const uint8_t i) { return deadlineUs(entries_[i]); });
     }
+}
 
-    return min_wait_ms == 0U ? 1U : min_wait_ms;
+void I2CUpdateManager::sleepUntilNextRelease(const uint32_t now_us)
+{
+    const uint32_t tick_freq = osKernelGetTickFreq() == 0U ? 1000U : osKernelGetTickFreq();
+    uint32_t       sleep_us  = config_.max_sleep_ms * 1000U;
+    uint32_t       ticks     = 0U;
+    if (config_.tick_aligned)
+    {
+        // 释放时刻都在 anchor_tick_ + k 的边界上，剩余整数个 tick 的定时器恰好在这个边界到期，不需要忙等。
+        ticks = static_cast<uint32_t>(static_cast<uint64_t>(sleep_us) * tick_freq / 1000000ULL);
+        if (release_count_ > 0U)
+        {
+            const uint32_t due_tick = anchor_tick_ + (entries_[release_heap_[0]].next_due_us - anchor_us_) / tick_us_;
+            const auto     remain   = static_cast<int32_t>(due_tick - osKernelGetTickCount());
+            if (remain <= 0)
+                return;
+            if (static_cast<uint32_t>(remain) < ticks)
+                ticks = static_cast<uint32_t>(remain);
+        }
+    }
+    else
+    {
+        if (release_count_ > 0U)
+        {
+            // releaseDue 之后堆顶一定还没到期。
+            const uint32_t due_us    = entries_[release_heap_[0]].next_due_us;
+            const uint32_t remain_us = due_us - now_us;
+            if (remain_us <= config_.max_spin_us)
+            {
+                // 最后一小段用 DWT 忙等，把释放抖动压到微秒级。
+                while (!timeReached(nowUs(), due_us))
+                {
+                }
+                return;
+            }
+            if (remain_us - config_.max_spin_us < sleep_us)
+                sleep_us = remain_us - config_.max_spin_us;
+        }
+
+        // k 个 tick 的单次定时器会在 (k - 1, k] 个 tick 后到期，向下取整保证不会睡过头；
+        // 不足一个 tick 时只能睡一个 tick，max_spin_us 不小于一个 tick 时这种情况不会越过释放时刻。
+        ticks = static_cast<uint32_t>(static_cast<uint64_t>(sleep_us) * tick_freq / 1000000ULL);
+    }
+    if (ticks == 0U)
+        ticks = 1U;
+
+    if (osTimerStart(wake_timer_, ticks) != osOK)
+    {
+        (void) osDelay(ticks);
+        return;
+    }
+    (void) osThreadFlagsWait(WakeFlag, osFlagsWaitAny, kernelTicksFromMs(config_.max_sleep_ms) + ticks);
 }
 
-void I2CUpdateManager::serviceEntry(Entry& entry, const uint32_t now_ms)
+void I2CUpdateManager::serviceEntry(Entry& entry, const uint32_t now_us)
 {
+    // 设备侧的状态机和数据时间戳仍以毫秒为单位。
+    const uint32_t now_ms = HAL_GetTick();
+
     if (!entry.initialized)
     {
         const bool ok     = entry.device->init(bus_, entry.timeout_ms);
@@ -144,53 +425,94 @@ void I2CUpdateManager::serviceEntry(Entry& entry, const uint32_t now_ms)
         else {
             entry.device->markFailure(now_ms);
         }
-        entry.next_due_ms += entry.period_ms;
+        entry.next_due_us += entry.period_us;
         return;
     }
 
-    // 新周期开始：记录本轮的名义起点（即注册时或上一轮结束时算出的 next_due_ms）。
-    // Pending 阶段会覆写 next_due_ms，所以必须在第一次调用时先把它存起来。
     if (!entry.pending_)
-        entry.cycle_start_ms = entry.next_due_ms;
+    {
+        // 释放抖动：从名义起点到真正开始服务的延迟。
+        const uint32_t jitter_us     = elapsedUs(now_us, entry.cycle_start_us);
+        entry.stats.jitter_last_us   = jitter_us;
+        if (jitter_us > entry.stats.jitter_max_us)
+            entry.stats.jitter_max_us = jitter_us;
+        ++entry.stats.releases;
+    }
 
     const UpdateStatus status = entry.device->update(bus_, now_ms, entry.timeout_ms);
 
     if (status == UpdateStatus::Pending)
     {
         entry.pending_    = true;
-        // 把 next_due_ms 推到转换完成时刻，让 selectReadyEntry 和 computeSleepMs
-        // 知道这段时间内可以去调度其他设备或休眠，不再空转。
-        entry.next_due_ms = entry.device->conversionDeadlineMs();
+        // 把 next_due_us 推到转换完成时刻，这段时间内可以去调度其他设备或休眠，不再空转。
+        // 设备返回 Pending 说明转换至少还要 1 ms。
+        entry.next_due_us = alignUp(now_us + (entry.device->conversionDeadlineMs() - now_ms) * 1000U);
         return;
     }
 
     entry.pending_ = false;
     if (status == UpdateStatus::Complete) entry.device->markSuccess(now_ms);
     else                                  entry.device->markFailure(now_ms);
+
+    const uint32_t done_us     = nowUs();
+    const uint32_t response_us = elapsedUs(done_us, entry.cycle_start_us);
+    entry.stats.response_last_us = response_us;
+    if (response_us > entry.stats.response_max_us)
+        entry.stats.response_max_us = response_us;
+    if (response_us > entry.period_us)
+        ++entry.stats.deadline_misses;
+
     // 如果这一轮已经明显落后，就直接跳到未来最近的周期点，而不是补跑历史周期。
     // 这样能保留周期相位，又避免任务恢复后短时间内把旧周期全部重放一遍。
-    const uint32_t elapsed_ms    = now_ms - entry.cycle_start_ms;
-    const uint32_t missed_cycles = elapsed_ms / entry.period_ms;
-    entry.next_due_ms            = entry.cycle_start_ms + (missed_cycles + 1U) * entry.period_ms;
+    const uint32_t elapsed_us    = elapsedUs(now_us, entry.cycle_start_us);
+    const uint32_t missed_cycles = elapsed_us / entry.period_us;
+    entry.stats.skipped_cycles += missed_cycles;
+    entry.next_due_us            = entry.cycle_start_us + (missed_cycles + 1U) * entry.period_us;
+}
+
+void I2CUpdateManager::timerEntry(void* argument)
+{
+    auto* manager = static_cast<I2CUpdateManager*>(argument);
+    if (const osThreadId_t thread = manager->task_handle_; thread != nullptr)
+        (void) osThreadFlagsSet(thread, WakeFlag);
 }
 
 void I2CUpdateManager::run()
 {
+    if (config_.tick_aligned)
+        alignToTick();
+    window_start_us_ = nowUs();
+    window_busy_us_  = bus_.busyTimeUs();
     while (run_flag_)
     {
-        const uint32_t now_ms = HAL_GetTick();
-        if (Entry* entry = selectReadyEntry(now_ms); entry != nullptr)
+        const uint32_t now_us = nowUs();
+
+        // 实测利用率：每个窗口结束时取驱动记录的总线占用时间增量，折算成占比。
+        if (const uint32_t window_us = now_us - window_start_us_; window_us >= config_.utilization_window_ms * 1000U)
+        {
+            const uint32_t busy_us = bus_.busyTimeUs();
+            measured_utilization_  = static_cast<float>(busy_us - window_busy_us_) / static_cast<float>(window_us);
+            window_busy_us_        = busy_us;
+            window_start_us_       = now_us;
+        }
+
+        releaseDue(now_us);
+        if (ready_count_ > 0U)
         {
-            // 一次循环只推进一个设备，确保这条总线始终是串行访问。
-            serviceEntry(*entry, now_ms);
+            // 一次循环只推进截止时间最早的一个设备，确保这条总线始终是串行访问。
+            const uint8_t index =
+                    heapPop(ready_heap_, ready_count_, [this](const uint8_t i) { return deadlineUs(entries_[i]); });
+            serviceEntry(entries_[index], now_us);
+            pushRelease(index);
             osThreadYield();
             continue;
         }
 
-        // 当前没有到期设备时，按最近到期时间进入短暂休眠。
-        osDelay(kernelTicksFromMs(computeSleepMs(now_ms)));
+        // 当前没有到期设备时，休眠到最近的释放时刻。
+        sleepUntilNextRelease(now_us);
     }
 
+    (void) osTimerStop(wake_timer_);
     run_flag_    = false;
     task_handle_ = nullptr;
 }
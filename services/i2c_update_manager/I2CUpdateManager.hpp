@@ -10,16 +10,27 @@
 #include <cstddef>
 #include <cstdint>
 
-// 单条 I2C 总线的周期调度器。不保证精准，可能有1~2ms的时间误差，适用于不那么精确周期的数据获取
+// 单条 I2C 总线的周期调度器。
 //
 // 该类拥有一个 CMSIS-RTOS v2 后台线程，并串行调度注册到同一条总线上的所有设备。
 // 每个设备由一个 Entry 描述其周期、相位和超时。manager 每次只推进一个设备，
 // 从而保证总线上始终只有一个活跃事务。
+//
+// 调度按最早截止时间优先（EDF）：设备在释放时刻进入就绪堆，按截止时间（释放时刻 + 周期）排序；
+// 尚未释放的设备按释放时刻排在另一个堆里。时间基准为微秒（有 DWT 时用 CYCCNT，否则退化为 HAL_GetTick），
+// 空闲时由单次 RTOS 定时器在下一个释放时刻唤醒。定时器只有 tick 精度，释放时刻落在两个 tick 之间时
+// 抖动最坏接近一个 tick；降低抖动有两种方式：
+// - Config::tick_aligned：释放时刻全部对齐到 tick 边界，定时器恰好在释放时刻到期，不需要忙等。
+//   抖动只剩 tick 中断到调度线程运行的延迟（tick 中断、定时器服务线程和线程切换，
+//   168 MHz Cortex-M4 + FreeRTOS 下估计为十几微秒），与 tick 周期无关；周期和相位必须是整数个 tick；
+// - Config::max_spin_us：在到期前的最后一小段用 DWT 忙等，抖动为微秒级，代价是忙等期间占用 CPU。
 class I2CUpdateManager final
 {
 public:
     static constexpr std::size_t MaxDevices = 8;
 
+    static constexpr uint32_t TransactionOverheadUs = 20U; ///< 每笔事务的驱动开销估计（DMA 启动、完成中断、线程唤醒），单位微秒
+
     /**
      * @brief 描述 manager 自身线程的运行配置
      */
@@ -28,7 +39,36 @@ public:
         const char* task_name{ "I2CUpdate" };                  ///< 调度线程名称
         uint32_t    stack_size_bytes{ 512U * sizeof(uint32_t) }; ///< 调度线程栈大小，单位 byte
         osPriority_t priority{ osPriorityNormal }; ///< 调度线程优先级
-        uint32_t    max_sleep_ms{ 500U };          ///< 空闲时单次最长休眠时间，单位毫秒
+        uint32_t    max_sleep_ms{ 500U };          ///< 空闲时单次最长休眠时间，单位毫秒，需远小于 CYCCNT 回卷周期
+        uint32_t    max_spin_us{ 0U };             ///< 到期前允许忙等的最长时间，单位微秒；0 表示只靠定时器唤醒
+        bool        tick_aligned{ false };         ///< 释放时刻对齐到 RTOS tick 边界，要求周期和相位都是整数个 tick
+        uint32_t    utilization_window_ms{ 100U }; ///< busUtilization() 的统计窗口，单位毫秒
+    };
+
+    /**
+     * @brief 单个设备的静态可调度性分析结果，时间单位均为微秒
+     */
+    struct Analysis
+    {
+        uint32_t cost_us{ 0 };           ///< 一轮更新的总线占用时间估计
+        uint32_t response_bound_us{ 0 }; ///< 响应时间上界：转换等待 + 周期内更早截止的更新 + 非抢占阻塞
+        bool     schedulable{ true };    ///< 响应时间上界是否不超过周期
+    };
+
+    /**
+     * @brief 单个设备的调度统计，时间单位均为微秒
+     *
+     * 调度线程在运行中持续更新，其他线程读取时只保证单个字段完整。
+     */
+    struct Stats
+    {
+        uint32_t releases{ 0 };         ///< 已开始服务的周期数
+        uint32_t skipped_cycles{ 0 };   ///< 因落后而直接跳过的周期数
+        uint32_t deadline_misses{ 0 };  ///< 完成时刻晚于本周期截止时间的次数
+        uint32_t jitter_last_us{ 0 };   ///< 最近一次释放抖动：开始服务时刻 - 名义释放时刻
+        uint32_t jitter_max_us{ 0 };    ///< 最大释放抖动
+        uint32_t response_last_us{ 0 }; ///< 最近一次响应时间：完成时刻 - 名义释放时刻
+        uint32_t response_max_us{ 0 };  ///< 最大响应时间
     };
 
     /**
@@ -37,24 +77,31 @@ public:
     struct Entry
     {
         I2CDevice* device{ nullptr };      ///< 设备对象指针
-        uint32_t   period_ms{ 0 };         ///< 周期调度间隔，单位毫秒
-        uint32_t   phase_ms{ 0 };          ///< 初始错峰相位，单位毫秒
+        uint32_t   period_us{ 0 };         ///< 周期调度间隔，单位微秒
+        uint32_t   phase_us{ 0 };          ///< 初始错峰相位，单位微秒
         uint32_t   timeout_ms{ 20 };       ///< 单次设备事务超时时间，单位毫秒
-        uint32_t   next_due_ms{ 0 };       ///< 下次应被调度的时刻
-        uint32_t   cycle_start_ms{ 0 };    ///< 当前周期的名义起点
+        uint32_t   next_due_us{ 0 };       ///< 下次应被调度的时刻
+        uint32_t   cycle_start_us{ 0 };    ///< 当前周期的名义起点
         bool       enabled{ false };       ///< 当前条目是否启用
         bool       initialized{ false };   ///< 设备是否已经完成初始化
         bool       pending_{ false };      ///< 当前是否正处于 Trigger 到 Read 的等待阶段
+        Stats      stats{};                ///< 调度统计
+        Analysis   analysis{};             ///< 注册时的可调度性分析
     };
 
     /**
      * @brief 使用一条总线构造调度器
      * @param bus 要管理的 I2C 总线
+     * @param bus_clock_hz 总线 SCL 频率，用于估算设备的总线占用时间
      */
-    explicit I2CUpdateManager(I2CBusDMA& bus);
+    explicit I2CUpdateManager(I2CBusDMA& bus, uint32_t bus_clock_hz = 400000U);
 
     /**
      * @brief 注册一个周期设备
+     *
+     * 注册时按设备声明的 busCost() / conversionMs() 重新分析整组设备的总线利用率和响应时间上界。
+     * 严格准入（setStrictAdmission）时，会导致任何设备不可调度的注册被拒绝；
+     * 否则照常注册，通过 isSchedulable() / getAnalysis() 报告过载。
      * @param device 要注册的设备对象
      * @param period_ms 更新周期，单位毫秒
      * @param phase_ms 初始错峰相位，单位毫秒
@@ -63,6 +110,39 @@ public:
      */
     bool registerDevice(I2CDevice& device, uint32_t period_ms, uint32_t phase_ms = 0U, uint32_t timeout_ms = 20U);
 
+    /**
+     * @brief 设置是否拒绝会导致过载的注册，默认只报告不拒绝
+     * @param strict 是否严格准入
+     */
+    void setStrictAdmission(bool strict) { strict_admission_ = strict; }
+
+    /**
+     * @brief 查询当前设备组按静态分析是否可调度
+     * @return 总线利用率不超过 1 且每个设备的响应时间上界都不超过周期
+     */
+    [[nodiscard]] bool  isSchedulable() const { return schedulable_; }
+
+    /**
+     * @brief 获取按设备声明的开销估算的总线利用率
+     * @return Σ 总线占用时间 / 周期
+     */
+    [[nodiscard]] float plannedUtilization() const { return planned_utilization_; }
+
+    /**
+     * @brief 获取运行中实测的总线利用率
+     * @return 最近一个统计窗口内总线上有事务进行的时间占比（由 I2CBusDMA 按事务启动与结束计时），
+     *         启动后第一个窗口结束前为 0
+     */
+    [[nodiscard]] float busUtilization() const { return measured_utilization_; }
+
+    /**
+     * @brief 获取一个已注册设备的可调度性分析结果
+     * @param device 设备对象
+     * @param analysis 输出的分析结果
+     * @return 设备是否已注册
+     */
+    bool getAnalysis(const I2CDevice& device, Analysis& analysis) const;
+
     /**
      * @brief 使用默认配置创建并启动后台调度线程
      * @return 调度线程是否成功启动
@@ -72,7 +152,7 @@ public:
     /**
      * @brief 使用给定配置创建并启动后台调度线程
      * @param config 调度线程配置
-     * @return 调度线程是否成功启动
+     * @return 调度线程是否成功启动；tick_aligned 时有设备的周期或相位不是整数个 tick 也返回 false
      */
     bool start(const Config& config);
 
@@ -92,27 +172,81 @@ public:
      */
     [[nodiscard]] std::size_t deviceCount() const { return entry_count_; }
 
+    /**
+     * @brief 获取一个已注册设备的调度统计
+     * @param device 设备对象
+     * @param stats 输出的统计快照
+     * @return 设备是否已注册
+     */
+    bool getStats(const I2CDevice& device, Stats& stats) const;
+
+    /**
+     * @brief 清零所有设备的调度统计
+     */
+    void resetStats();
+
 private:
     /**
-     * @brief 选择当前已经到期且应优先调度的设备条目
-     * @param now_ms 当前时间戳，单位毫秒
-     * @return 选中的设备条目，若无可调度设备则返回空指针
+     * @brief 估算一轮更新的总线占用时间
+     * @param cost 设备声明的总线开销
+     * @return 占用时间，单位微秒
+     */
+    uint32_t busTimeUs(const I2CBusCost& cost) const;
+
+    /**
+     * @brief 重新分析所有已注册设备的可调度性
+     * @return 整组设备是否可调度
      */
-    Entry* selectReadyEntry(uint32_t now_ms);
+    bool     analyze();
 
     /**
-     * @brief 计算下一次轮询前最多可以休眠多久
-     * @param now_ms 当前时间戳，单位毫秒
-     * @return 推荐休眠时长，单位毫秒
+     * @brief 读取微秒时间基准，只能由调度线程（或 start() 前的注册流程）调用
+     * @return 当前时间戳，单位微秒，约 71 分钟回卷一次
      */
-    uint32_t computeSleepMs(uint32_t now_ms) const;
+    uint32_t nowUs();
+
+    /**
+     * @brief tick 对齐模式下，等到下一个 tick 边界记录时间锚点，并把所有条目按相位重新放到 tick 边界上
+     */
+    void     alignToTick();
+
+    /**
+     * @brief tick 对齐模式下把时刻向后取整到 tick 边界，否则原样返回
+     * @param time_us 时间戳，单位微秒
+     * @return 取整后的时间戳
+     */
+    uint32_t alignUp(uint32_t time_us) const;
+
+    /**
+     * @brief 把条目按下次释放时刻放入释放堆
+     * @param index 条目下标
+     */
+    void     pushRelease(uint8_t index);
+
+    /**
+     * @brief 把所有已到释放时刻的条目从释放堆移到就绪堆
+     * @param now_us 当前时间戳，单位微秒
+     */
+    void     releaseDue(uint32_t now_us);
+
+    /**
+     * @brief 没有就绪设备时休眠到下一个释放时刻
+     * @param now_us 当前时间戳，单位微秒
+     */
+    void     sleepUntilNextRelease(uint32_t now_us);
 
     /**
      * @brief 推进一个设备条目的初始化或更新流程
      * @param entry 要推进的设备条目
-     * @param now_ms 当前时间戳，单位毫秒
+     * @param now_us 当前时间戳，单位微秒
+     */
+    void     serviceEntry(Entry& entry, uint32_t now_us);
+
+    /**
+     * @brief 单次唤醒定时器的回调，在 RTOS 定时器线程中运行
+     * @param argument 调度器对象指针
      */
-    void     serviceEntry(Entry& entry, uint32_t now_ms);
+    static void timerEntry(void* argument);
 
     /**
      * @brief CMSIS-RTOS v2 线程入口的静态桥接函数
@@ -131,7 +265,25 @@ private:
     I2CBusDMA&   bus_;                        ///< 当前调度器独占管理的 I2C 总线
     Entry        entries_[MaxDevices]{};      ///< 已注册设备的调度表
     std::size_t  entry_count_{ 0 };           ///< 当前已注册设备数量
+    uint8_t      release_heap_[MaxDevices]{}; ///< 尚未释放的条目，按 next_due_us 排成小根堆
+    std::size_t  release_count_{ 0 };         ///< 释放堆中的条目数量
+    uint8_t      ready_heap_[MaxDevices]{};   ///< 已释放的条目，按截止时间排成小根堆
+    std::size_t  ready_count_{ 0 };           ///< 就绪堆中的条目数量
+    uint32_t     last_cycles_{ 0 };           ///< 上次读取的 CYCCNT
+    uint32_t     cycle_remainder_{ 0 };       ///< 尚未折算成微秒的周期数
+    uint32_t     now_us_{ 0 };                ///< 微秒时间基准
+    uint32_t     tick_us_{ 1000U };           ///< 一个 RTOS tick 的时长，单位微秒
+    uint32_t     anchor_tick_{ 0 };           ///< tick 对齐模式的锚点：某个 tick 边界的 tick 计数
+    uint32_t     anchor_us_{ 0 };             ///< 同一个 tick 边界的微秒时间戳
+    uint32_t     bus_clock_hz_;               ///< 总线 SCL 频率
+    bool         strict_admission_{ false };  ///< 是否拒绝会导致过载的注册
+    bool         schedulable_{ true };        ///< 当前设备组是否可调度
+    float        planned_utilization_{ 0.0f }; ///< 按声明开销估算的总线利用率
+    float        measured_utilization_{ 0.0f }; ///< 最近一个窗口实测的总线利用率
+    uint32_t     window_busy_us_{ 0 };        ///< 当前窗口起点时总线的累计占用时间
+    uint32_t     window_start_us_{ 0 };       ///< 当前统计窗口的起点
     osThreadId_t task_handle_{ nullptr };     ///< 后台调度线程句柄
+    osTimerId_t  wake_timer_{ nullptr };      ///< 空闲时唤醒调度线程的单次定时器
     Config       config_{};                   ///< 当前采用的线程配置
     bool         run_flag_{ false };          ///< 后台调度线程是否应继续运行
 };
@@ -0,0 +1,75 @@
+/**
+ * @file    host_test.hpp
+ * @author  syhanjin
+ * @date    2026-10-16
+ * @brief   主机测试用的最小断言与用例框架，不依赖第三方库。
+ *
+ * 每个测试程序是一个可执行文件，main 中依次 RUN_TEST，最后 return host_test::result()。
+ * 基准测试只打印测量值，不对主机耗时做断言，避免 CI 负载导致的偶发失败。
+ * 需要的环境不存在时（例如没有 vcan 接口）返回 HOST_TEST_SKIP，ctest 记为跳过。
+ */
+#pragma once
+
+#include <cstdio>
+
+#define HOST_TEST_SKIP 77
+
+namespace host_test
+{
+
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void run(const char* name, void (*test)())
+{
+    const int before = failures();
+    std::printf("[ RUN  ] %s\n", name);
+    test();
+    std::printf("[ %s ] %s\n", failures() == before ? " OK " : "FAIL", name);
+}
+
+inline int result()
+{
+    if (failures() != 0)
+    {
+        std::printf("%d check(s) failed\n", failures());
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace host_test
+
+#define RUN_TEST(test) host_test::run(#test, test)
+
+#define CHECK(cond)                                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(cond))                                                                                                   \
+        {                                                                                                              \
+            ++host_test::failures();                                                                                   \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                             \
+        }                                                                                                              \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                                 \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        const auto check_a_ = (a);                                                                                     \
+        const auto check_b_ = (b);                                                                                     \
+        if (!(check_a_ == check_b_))                                                                                   \
+        {                                                                                                              \
+            ++host_test::failures();                                                                                   \
+            std::fprintf(stderr,                                                                                       \
+                         "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",                                             \
+                         __FILE__,                                                                                     \
+                         __LINE__,                                                                                     \
+                         #a,                                                                                           \
+                         #b,                                                                                           \
+                         static_cast<long long>(check_a_),                                                             \
+                         static_cast<long long>(check_b_));                                                            \
+        }                                                                                                              \
+    } while (0)